@@ -0,0 +1,276 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Context-switch overhead benchmark.
+ *
+ * gem_ctx_exec and gem_ctx_basic check that HW contexts work; this
+ * measures what they cost.  Three phases:
+ *
+ *  - create: per-context creation latency for N contexts;
+ *  - switch: round-robin noop batches through all N contexts, so every
+ *    submission forces a context switch, with per-submit latency
+ *    percentiles and overall throughput;
+ *  - scaling: the switch loop repeated for 1, 2, 4, ... N contexts, to
+ *    show where throughput falls off as the context count grows.
+ *
+ * Output is human-readable or CSV (-c) for tracking across kernel
+ * releases.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+
+#define DEFAULT_CONTEXTS	64
+#define DEFAULT_ITERS		16384
+#define DEFAULT_WARMUP		256
+
+static drm_intel_bufmgr *bufmgr;
+static struct intel_batchbuffer *batch;
+static drm_intel_context **contexts;
+static int num_contexts;
+
+static double
+get_time_in_secs(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static double
+percentile(const double *sorted, int count, int pct)
+{
+	int idx = (count - 1) * pct / 100;
+
+	return sorted[idx];
+}
+
+static void
+emit_noop(drm_intel_context *context)
+{
+	BEGIN_BATCH(2);
+	OUT_BATCH(MI_NOOP);
+	OUT_BATCH(MI_NOOP);
+	ADVANCE_BATCH();
+
+	intel_batchbuffer_flush_with_context(batch, context);
+}
+
+static void
+measure_create(int csv)
+{
+	double *lat;
+	int i;
+
+	lat = malloc(num_contexts * sizeof(double));
+	assert(lat);
+
+	for (i = 0; i < num_contexts; i++) {
+		double t = get_time_in_secs();
+
+		contexts[i] = drm_intel_gem_context_create(bufmgr);
+		lat[i] = get_time_in_secs() - t;
+
+		if (!contexts[i]) {
+			fprintf(stderr,
+				"context creation failed at %d, "
+				"kernel too old?\n", i);
+			exit(77);
+		}
+	}
+
+	qsort(lat, num_contexts, sizeof(double), cmp_double);
+
+	if (csv)
+		printf("create,%d,,%.1f,%.1f,%.1f,%.1f\n", num_contexts,
+		       percentile(lat, num_contexts, 50) * 1e6,
+		       percentile(lat, num_contexts, 90) * 1e6,
+		       percentile(lat, num_contexts, 99) * 1e6,
+		       lat[num_contexts - 1] * 1e6);
+	else
+		printf("create: %d contexts, latency p50 %.1fus p90 %.1fus "
+		       "p99 %.1fus max %.1fus\n", num_contexts,
+		       percentile(lat, num_contexts, 50) * 1e6,
+		       percentile(lat, num_contexts, 90) * 1e6,
+		       percentile(lat, num_contexts, 99) * 1e6,
+		       lat[num_contexts - 1] * 1e6);
+
+	free(lat);
+}
+
+static void
+measure_switch(int nctx, int warmup, int iters, int csv)
+{
+	double *lat, start_time, secs;
+	int i;
+
+	lat = malloc(iters * sizeof(double));
+	assert(lat);
+
+	for (i = 0; i < warmup; i++)
+		emit_noop(contexts[i % nctx]);
+	intel_batchbuffer_flush(batch);
+	drm_intel_bo_wait_rendering(batch->bo);
+
+	start_time = get_time_in_secs();
+	for (i = 0; i < iters; i++) {
+		double t = get_time_in_secs();
+
+		emit_noop(contexts[i % nctx]);
+		lat[i] = get_time_in_secs() - t;
+	}
+	intel_batchbuffer_flush(batch);
+	drm_intel_bo_wait_rendering(batch->bo);
+	secs = get_time_in_secs() - start_time;
+
+	qsort(lat, iters, sizeof(double), cmp_double);
+
+	if (csv)
+		printf("switch,%d,%.0f,%.1f,%.1f,%.1f,%.1f\n",
+		       nctx, iters / secs,
+		       percentile(lat, iters, 50) * 1e6,
+		       percentile(lat, iters, 90) * 1e6,
+		       percentile(lat, iters, 99) * 1e6,
+		       lat[iters - 1] * 1e6);
+	else
+		printf("switch: %4d contexts: %.0f switches/sec, "
+		       "submit latency p50 %.1fus p90 %.1fus p99 %.1fus "
+		       "max %.1fus\n",
+		       nctx, iters / secs,
+		       percentile(lat, iters, 50) * 1e6,
+		       percentile(lat, iters, 90) * 1e6,
+		       percentile(lat, iters, 99) * 1e6,
+		       lat[iters - 1] * 1e6);
+
+	free(lat);
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-n contexts] [-w warmup_iters] [-i iters] [-s] [-c]\n"
+		"  -n  number of contexts (default %d)\n"
+		"  -s  sweep context counts 1,2,4,... n instead of one run\n"
+		"  -c  CSV output: phase,contexts,switches_per_sec,"
+		"p50_us,p90_us,p99_us,max_us\n",
+		name, DEFAULT_CONTEXTS);
+}
+
+int main(int argc, char **argv)
+{
+	int warmup = DEFAULT_WARMUP, iters = DEFAULT_ITERS;
+	int sweep = 0, csv = 0;
+	int fd, c, i;
+
+	num_contexts = DEFAULT_CONTEXTS;
+
+	while ((c = getopt(argc, argv, "n:w:i:sch")) != -1) {
+		switch (c) {
+		case 'n':
+			num_contexts = atoi(optarg);
+			break;
+		case 'w':
+			warmup = atoi(optarg);
+			break;
+		case 'i':
+			iters = atoi(optarg);
+			break;
+		case 's':
+			sweep = 1;
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (num_contexts < 1 || iters < 1 || warmup < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	fd = drm_open_any();
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+
+	contexts = calloc(num_contexts, sizeof(*contexts));
+	assert(contexts);
+
+	measure_create(csv);
+
+	if (sweep) {
+		for (i = 1; i <= num_contexts; i *= 2)
+			measure_switch(i, warmup, iters, csv);
+		if (num_contexts & (num_contexts - 1))
+			measure_switch(num_contexts, warmup, iters, csv);
+	} else {
+		measure_switch(num_contexts, warmup, iters, csv);
+	}
+
+	for (i = 0; i < num_contexts; i++)
+		drm_intel_gem_context_destroy(contexts[i]);
+	free(contexts);
+
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Combined resource storm: VMA churn, fence oversubscription and
+ * aperture pressure driven at the same time, each behind its own rate
+ * dial.  drm_vma_limiter and gem_fence_thrash each hammer one resource
+ * in isolation and keep passing; production incidents are always
+ * multi-resource.  The fenced page-access latency distribution is the
+ * probe - reported per cell of the storm matrix, it shows how fence
+ * behaviour degrades as the other axes ramp up.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_pace.h"
+
+#define CHURN_BO_SIZE	(64*1024)
+#define FENCE_BO_SIZE	(128*1024)
+#define APERTURE_BO_SIZE (4*1024*1024)
+#define MAX_APERTURE_SLOTS 128
+#define MAX_FENCE_THREADS 64
+
+#define MAX_SAMPLES (1<<20)
+
+static volatile int stop;
+
+struct axis {
+	int fd;
+	double gap_us;	/* 0 = flat out */
+	uint64_t ops;
+	pthread_t thread;
+	int running;
+};
+
+static int64_t time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* map, fault, unmap, close - every round trips through the vma and
+ * mmap offset bookkeeping */
+static void *vma_churn(void *arg)
+{
+	struct axis *axis = arg;
+	struct intel_pace pace;
+
+	memset(&pace, 0, sizeof(pace));
+	if (axis->gap_us)
+		intel_pace_init_fixed(&pace, axis->gap_us);
+
+	while (!stop) {
+		uint32_t handle;
+		char *ptr;
+
+		intel_pace_wait(&pace);
+		handle = gem_create(axis->fd, CHURN_BO_SIZE);
+		ptr = gem_mmap__gtt(axis->fd, handle, CHURN_BO_SIZE,
+				    PROT_READ | PROT_WRITE);
+		if (ptr) {
+			ptr[0] = axis->ops;
+			munmap(ptr, CHURN_BO_SIZE);
+		}
+		gem_close(axis->fd, handle);
+		axis->ops++;
+	}
+
+	intel_pace_fini(&pace);
+	return NULL;
+}
+
+/* cycle a working set bigger than the mappable aperture so every pass
+ * evicts and rebinds */
+static void *aperture_pressure(void *arg)
+{
+	struct axis *axis = arg;
+	struct intel_pace pace;
+	uint32_t handles[MAX_APERTURE_SLOTS];
+	int slots, i;
+
+	slots = gem_aperture_size(axis->fd) / APERTURE_BO_SIZE + 8;
+	if (slots > MAX_APERTURE_SLOTS)
+		slots = MAX_APERTURE_SLOTS;
+
+	for (i = 0; i < slots; i++)
+		handles[i] = gem_create(axis->fd, APERTURE_BO_SIZE);
+
+	memset(&pace, 0, sizeof(pace));
+	if (axis->gap_us)
+		intel_pace_init_fixed(&pace, axis->gap_us);
+
+	while (!stop) {
+		intel_pace_wait(&pace);
+		for (i = 0; i < slots && !stop; i++) {
+			char *ptr;
+			int page;
+
+			ptr = gem_mmap__gtt(axis->fd, handles[i],
+					    APERTURE_BO_SIZE,
+					    PROT_READ | PROT_WRITE);
+			if (ptr == NULL)
+				continue;
+			for (page = 0; page < APERTURE_BO_SIZE; page += 4096)
+				ptr[page] = page;
+			munmap(ptr, APERTURE_BO_SIZE);
+		}
+		axis->ops++;	/* full working-set cycles */
+	}
+
+	for (i = 0; i < slots; i++)
+		gem_close(axis->fd, handles[i]);
+	intel_pace_fini(&pace);
+	return NULL;
+}
+
+static char *fence_bo_create(int fd)
+{
+	uint32_t handle = gem_create(fd, FENCE_BO_SIZE);
+	char *ptr;
+
+	gem_set_tiling(fd, handle, I915_TILING_X, 1024);
+	ptr = gem_mmap(fd, handle, FENCE_BO_SIZE, PROT_READ | PROT_WRITE);
+	assert(ptr);
+	gem_sync(fd, handle);
+	gem_close(fd, handle);	/* mapping keeps it alive */
+
+	return ptr;
+}
+
+/* plain fence hogs; with enough of them the measured thread has to
+ * steal a fence for nearly every access */
+static void *fence_thrash(void *arg)
+{
+	struct axis *axis = arg;
+	char *a = fence_bo_create(axis->fd);
+	char *b = fence_bo_create(axis->fd);
+
+	while (!stop) {
+		memcpy(a, b, FENCE_BO_SIZE);
+		axis->ops++;
+		sched_yield();
+	}
+
+	munmap(a, FENCE_BO_SIZE);
+	munmap(b, FENCE_BO_SIZE);
+	return NULL;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+	int64_t ia = *(const int64_t *)a, ib = *(const int64_t *)b;
+
+	if (ia < ib)
+		return -1;
+	return ia > ib;
+}
+
+/* fenced page accesses, timed one by one in the main thread while the
+ * storm rages */
+static int measure_fence_latency(int fd, double seconds, int64_t *lat)
+{
+	char *a = fence_bo_create(fd);
+	char *b = fence_bo_create(fd);
+	int64_t deadline = time_ns() + seconds * 1e9;
+	int n = 0, page = 0;
+
+	while (time_ns() < deadline && n < MAX_SAMPLES) {
+		int64_t t = time_ns();
+
+		memcpy(a + (page << 12), b + (page << 12), 4096);
+		lat[n++] = time_ns() - t;
+
+		if (++page == FENCE_BO_SIZE >> 12) {
+			page = 0;
+			sched_yield();
+		}
+	}
+
+	munmap(a, FENCE_BO_SIZE);
+	munmap(b, FENCE_BO_SIZE);
+	return n;
+}
+
+static void run_cell(int fd, double churn_rate, int aperture_on,
+		     int fence_threads, double seconds, int64_t *lat)
+{
+	struct axis churn_axis, aperture_axis;
+	struct axis thrashers[MAX_FENCE_THREADS];
+	double churn_per_sec, aper_per_sec;
+	char churn_label[16];
+	int64_t t0;
+	int i, n, slow;
+
+	stop = 0;
+	memset(&churn_axis, 0, sizeof(churn_axis));
+	memset(&aperture_axis, 0, sizeof(aperture_axis));
+
+	if (churn_rate != 0) {
+		churn_axis.fd = fd;
+		churn_axis.gap_us = churn_rate > 0 ? 1e6 / churn_rate : 0;
+		pthread_create(&churn_axis.thread, NULL, vma_churn,
+			       &churn_axis);
+		churn_axis.running = 1;
+	}
+	if (aperture_on) {
+		aperture_axis.fd = fd;
+		pthread_create(&aperture_axis.thread, NULL, aperture_pressure,
+			       &aperture_axis);
+		aperture_axis.running = 1;
+	}
+	for (i = 0; i < fence_threads; i++) {
+		memset(&thrashers[i], 0, sizeof(thrashers[i]));
+		thrashers[i].fd = fd;
+		pthread_create(&thrashers[i].thread, NULL, fence_thrash,
+			       &thrashers[i]);
+	}
+
+	/* let the storm reach steady state before probing */
+	usleep(300000);
+
+	t0 = time_ns();
+	n = measure_fence_latency(fd, seconds, lat);
+	churn_per_sec = churn_axis.ops * 1e9 / (time_ns() - t0);
+	aper_per_sec = aperture_axis.ops * 1e9 / (time_ns() - t0);
+
+	stop = 1;
+	if (churn_axis.running)
+		pthread_join(churn_axis.thread, NULL);
+	if (aperture_axis.running)
+		pthread_join(aperture_axis.thread, NULL);
+	for (i = 0; i < fence_threads; i++)
+		pthread_join(thrashers[i].thread, NULL);
+
+	qsort(lat, n, sizeof(*lat), cmp_int64);
+	slow = 0;
+	for (i = n - 1; i >= 0 && lat[i] >= 1000000; i--)
+		slow++;
+
+	if (churn_rate > 0)
+		snprintf(churn_label, sizeof(churn_label), "%.0f/s",
+			 churn_rate);
+	else
+		snprintf(churn_label, sizeof(churn_label), "%s",
+			 churn_rate < 0 ? "max" : "off");
+	printf("churn %8s (got %7.0f/s), aperture %-3s (%4.1f cyc/s): "
+	       "fence p50 %6.1fus p99 %8.1fus max %8.1fus, "
+	       "%.2f%% stalls >1ms\n",
+	       churn_label, churn_per_sec,
+	       aperture_on ? "on" : "off", aper_per_sec,
+	       lat[n / 2] / 1e3,
+	       lat[n * 99 / 100] / 1e3,
+	       lat[n - 1] / 1e3,
+	       100.0 * slow / n);
+	fflush(stdout);
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [-t seconds] [-n threads] [-c rate] [-a]\n", name);
+	printf("\t-t : measurement seconds per cell (default 2)\n");
+	printf("\t-n : fence thrasher threads (default: fence count)\n");
+	printf("\t-c : single cell at this VMA churn rate (ops/s, -1 = max)\n");
+	printf("\t-a : with -c, add aperture pressure to the cell\n");
+	printf("\twithout -c, sweeps the full storm matrix\n");
+}
+
+int main(int argc, char **argv)
+{
+	static const double churn_rates[] = { 0, 1000, 10000, -1 };
+	drm_i915_getparam_t gp;
+	int64_t *lat;
+	double seconds = 2, churn_rate = 0;
+	int fd, c, i, aperture, num_fences;
+	int fence_threads = -1, single_cell = 0, single_aperture = 0;
+
+	while ((c = getopt(argc, argv, "t:n:c:ah")) != -1) {
+		switch (c) {
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 'n':
+			fence_threads = atoi(optarg);
+			break;
+		case 'c':
+			churn_rate = atof(optarg);
+			single_cell = 1;
+			break;
+		case 'a':
+			single_aperture = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c != 'h';
+		}
+	}
+
+	fd = drm_open_any();
+
+	gp.param = I915_PARAM_NUM_FENCES_AVAIL;
+	gp.value = &num_fences;
+	if (ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp))
+		return 77;
+
+	if (fence_threads < 0)
+		fence_threads = num_fences;
+	if (fence_threads > MAX_FENCE_THREADS)
+		fence_threads = MAX_FENCE_THREADS;
+
+	lat = malloc(MAX_SAMPLES * sizeof(*lat));
+	assert(lat);
+
+	printf("%d fences, %d fence thrashers\n", num_fences, fence_threads);
+
+	if (single_cell) {
+		run_cell(fd, churn_rate, single_aperture, fence_threads,
+			 seconds, lat);
+	} else {
+		for (aperture = 0; aperture <= 1; aperture++)
+			for (i = 0; i < sizeof(churn_rates)/sizeof(churn_rates[0]); i++)
+				run_cell(fd, churn_rates[i], aperture,
+					 fence_threads, seconds, lat);
+	}
+
+	free(lat);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Benchmark: cross-process contention on one flink-shared bo
+ *
+ * The compositor/client texture-sharing pattern: two processes with
+ * their own drm fds map the same object (shared via flink, as
+ * gem_flink checks for correctness) and write to it concurrently.
+ * For each mapping type this measures the achieved per-process and
+ * aggregate bandwidth with three region layouts - disjoint halves,
+ * interleaved cachelines and fully shared - plus a solo baseline, so
+ * the cacheline ping-pong penalty falls straight out of the
+ * solo/disjoint/shared comparison.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+
+#define BO_SIZE (4*1024*1024)
+#define RUN_SECS 0.5
+
+enum layout {
+	LAYOUT_SOLO,		/* parent writes everything, child idle */
+	LAYOUT_DISJOINT,	/* one half each */
+	LAYOUT_INTERLEAVED,	/* alternating cachelines */
+	LAYOUT_SHARED,		/* both write every cacheline */
+};
+
+static const char *layout_names[] = {
+	"solo", "disjoint", "interleaved", "shared",
+};
+
+struct shared_ctl {
+	volatile int ready[2];
+	volatile int go;
+	double bw[2];
+};
+
+static struct shared_ctl *ctl;
+
+static uint32_t bo_flink(int fd, uint32_t handle)
+{
+	struct drm_gem_flink flink;
+
+	flink.handle = handle;
+	do_or_die(ioctl(fd, DRM_IOCTL_GEM_FLINK, &flink));
+	return flink.name;
+}
+
+static uint32_t bo_open(int fd, uint32_t name)
+{
+	struct drm_gem_open open_struct;
+
+	open_struct.name = name;
+	do_or_die(ioctl(fd, DRM_IOCTL_GEM_OPEN, &open_struct));
+	return open_struct.handle;
+}
+
+static double now_sec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* write this role's share of the buffer once; one pass is the unit of
+ * bandwidth accounting */
+static size_t write_pass(uint32_t *ptr, enum layout layout, int role,
+			 uint32_t val)
+{
+	unsigned lines = BO_SIZE / 64;
+	unsigned i, j;
+	size_t bytes = 0;
+
+	switch (layout) {
+	case LAYOUT_SOLO:
+	case LAYOUT_SHARED:
+		for (i = 0; i < BO_SIZE / 4; i++)
+			ptr[i] = val;
+		bytes = BO_SIZE;
+		break;
+	case LAYOUT_DISJOINT:
+		for (i = role * BO_SIZE / 8; i < (role + 1) * BO_SIZE / 8; i++)
+			ptr[i] = val;
+		bytes = BO_SIZE / 2;
+		break;
+	case LAYOUT_INTERLEAVED:
+		for (i = role; i < lines; i += 2)
+			for (j = 0; j < 16; j++)
+				ptr[i * 16 + j] = val;
+		bytes = BO_SIZE / 2;
+		break;
+	}
+
+	return bytes;
+}
+
+static void run_role(int fd, uint32_t handle, enum layout layout, int role,
+		     int use_gtt)
+{
+	uint32_t *ptr;
+	double start, elapsed;
+	size_t bytes = 0;
+	uint32_t val = role ? 0xc0c0c0c0 : 0x3f3f3f3f;
+
+	if (use_gtt) {
+		ptr = gem_mmap(fd, handle, BO_SIZE, PROT_READ | PROT_WRITE);
+	} else {
+		ptr = gem_mmap__cpu(fd, handle, BO_SIZE,
+				    PROT_READ | PROT_WRITE);
+		gem_set_domain(fd, handle, I915_GEM_DOMAIN_CPU,
+			       I915_GEM_DOMAIN_CPU);
+	}
+	assert(ptr);
+
+	ctl->ready[role] = 1;
+	__sync_synchronize();
+	if (role == 0) {
+		while (!ctl->ready[1])
+			;
+		ctl->go = 1;
+	} else {
+		while (!ctl->go)
+			;
+	}
+
+	start = now_sec();
+	do {
+		bytes += write_pass(ptr, layout, role, val++);
+		elapsed = now_sec() - start;
+	} while (elapsed < RUN_SECS);
+
+	ctl->bw[role] = bytes / elapsed / (1024*1024);
+	__sync_synchronize();
+
+	munmap(ptr, BO_SIZE);
+}
+
+static void run_layout(int fd, uint32_t handle, uint32_t name,
+		       enum layout layout, int use_gtt)
+{
+	pid_t child;
+	int status;
+
+	memset((void *)ctl, 0, sizeof(*ctl));
+
+	child = fork();
+	assert(child != -1);
+	if (child == 0) {
+		int child_fd;
+		uint32_t child_handle;
+
+		if (layout == LAYOUT_SOLO) {
+			/* present but idle, so process count matches */
+			ctl->ready[1] = 1;
+			exit(0);
+		}
+
+		child_fd = drm_open_any();
+		child_handle = bo_open(child_fd, name);
+		run_role(child_fd, child_handle, layout, 1, use_gtt);
+		close(child_fd);
+		exit(0);
+	}
+
+	run_role(fd, handle, layout, 0, use_gtt);
+	waitpid(child, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	printf("%4s %12s %10.0f %10.0f %10.0f\n",
+	       use_gtt ? "gtt" : "cpu", layout_names[layout],
+	       ctl->bw[0], ctl->bw[1], ctl->bw[0] + ctl->bw[1]);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t handle, name;
+	int fd, use_gtt;
+	enum layout layout;
+
+	fd = drm_open_any();
+	handle = gem_create(fd, BO_SIZE);
+	name = bo_flink(fd, handle);
+
+	ctl = mmap(NULL, sizeof(*ctl), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(ctl != MAP_FAILED);
+
+	printf("%4s %12s %10s %10s %10s\n",
+	       "map", "layout", "MiB/s[0]", "MiB/s[1]", "aggregate");
+	for (use_gtt = 0; use_gtt <= 1; use_gtt++)
+		for (layout = LAYOUT_SOLO; layout <= LAYOUT_SHARED; layout++)
+			run_layout(fd, handle, name, layout, use_gtt);
+
+	gem_close(fd, handle);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Relocation-cost benchmark.
+ *
+ * gem_cpu_reloc checks that relocations are processed correctly; this
+ * measures how fast.  A tree of small bos with configurable depth and
+ * fanout is generated once up front - every internal node is a noop
+ * batch whose data dwords hold relocations to its children - together
+ * with all the relocation and exec-object arrays in a single arena.
+ * The timed loop just resets the presumed offsets (so the kernel can't
+ * short-circuit the patching) and replays the execbuf, through either
+ * the CPU or the GTT reloc path, reporting relocations per second.
+ * Rebuilding the arrays per iteration, as the test does, would swamp
+ * the number we're after.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+
+#define MAX_NODES	4096
+#define DEFAULT_DEPTH	2
+#define DEFAULT_FANOUT	8
+#define DEFAULT_ITERS	1024
+#define DEFAULT_WARMUP	16
+
+static int fd;
+static int depth = DEFAULT_DEPTH;
+static int fanout = DEFAULT_FANOUT;
+
+static uint32_t handles[MAX_NODES];
+static int num_nodes, num_internal, num_relocs;
+
+/* one arena for everything the replay loop touches */
+static struct drm_i915_gem_relocation_entry *reloc_arena;
+static struct drm_i915_gem_exec_object2 *exec_arena;
+
+static double
+get_time_in_secs(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* Nodes are laid out breadth-first: node n's children are at
+ * n*fanout+1 .. n*fanout+fanout.  Internal nodes come first, so
+ * everything below num_internal has relocations. */
+static void
+build_tree(void)
+{
+	const uint32_t end[2] = { MI_BATCH_BUFFER_END, 0 };
+	int n, j;
+
+	num_nodes = 1;
+	for (n = 0, j = 1; n < depth; n++) {
+		j *= fanout;
+		num_nodes += j;
+	}
+	if (num_nodes > MAX_NODES) {
+		fprintf(stderr,
+			"depth %d fanout %d needs %d bos, max is %d\n",
+			depth, fanout, num_nodes, MAX_NODES);
+		exit(1);
+	}
+	num_internal = (num_nodes - 1) / fanout;
+	num_relocs = num_internal * fanout;
+
+	reloc_arena = calloc(num_relocs, sizeof(*reloc_arena));
+	exec_arena = calloc(num_nodes, sizeof(*exec_arena));
+	assert(reloc_arena && exec_arena);
+
+	for (n = 0; n < num_nodes; n++) {
+		handles[n] = gem_create(fd, 4096);
+		/* batch ends immediately; the reloc targets live in the
+		 * data dwords behind the BB_END, which the GPU never
+		 * executes */
+		gem_write(fd, handles[n], 0, end, sizeof(end));
+	}
+
+	for (n = 0; n < num_internal; n++) {
+		struct drm_i915_gem_relocation_entry *reloc =
+			&reloc_arena[n * fanout];
+
+		for (j = 0; j < fanout; j++) {
+			reloc[j].offset = (2 + j) * sizeof(uint32_t);
+			reloc[j].delta = 0;
+			reloc[j].target_handle = handles[n * fanout + 1 + j];
+			reloc[j].read_domains = I915_GEM_DOMAIN_RENDER;
+			reloc[j].write_domain = 0;
+			reloc[j].presumed_offset = 0;
+		}
+	}
+
+	/* leaves first, root (the batch) last, as execbuf requires */
+	for (n = 0; n < num_nodes; n++) {
+		struct drm_i915_gem_exec_object2 *obj =
+			&exec_arena[num_nodes - 1 - n];
+
+		obj->handle = handles[n];
+		if (n < num_internal) {
+			obj->relocation_count = fanout;
+			obj->relocs_ptr = (uintptr_t)&reloc_arena[n * fanout];
+		}
+	}
+}
+
+static void
+replay(int use_cpu_path)
+{
+	struct drm_i915_gem_execbuffer2 execbuf;
+	int n;
+
+	/* stale presumed offsets force the kernel to verify and patch
+	 * every relocation rather than trusting the cached values */
+	for (n = 0; n < num_relocs; n++)
+		reloc_arena[n].presumed_offset = 0;
+
+	for (n = 0; n < num_internal; n++)
+		gem_set_domain(fd, handles[n],
+			       use_cpu_path ? I915_GEM_DOMAIN_CPU :
+					      I915_GEM_DOMAIN_GTT,
+			       use_cpu_path ? I915_GEM_DOMAIN_CPU :
+					      I915_GEM_DOMAIN_GTT);
+
+	memset(&execbuf, 0, sizeof(execbuf));
+	execbuf.buffers_ptr = (uintptr_t)exec_arena;
+	execbuf.buffer_count = num_nodes;
+	execbuf.batch_len = 8;
+
+	do_or_die(drmIoctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &execbuf));
+}
+
+static void
+run(const char *name, int use_cpu_path, int warmup, int iters, int csv)
+{
+	double start, secs;
+	int i;
+
+	for (i = 0; i < warmup; i++)
+		replay(use_cpu_path);
+	gem_sync(fd, handles[0]);
+
+	start = get_time_in_secs();
+	for (i = 0; i < iters; i++)
+		replay(use_cpu_path);
+	gem_sync(fd, handles[0]);
+	secs = get_time_in_secs() - start;
+
+	if (csv)
+		printf("%s,%d,%d,%d,%d,%.6f,%.0f\n",
+		       name, depth, fanout, num_relocs, iters, secs,
+		       (double)num_relocs * iters / secs);
+	else
+		printf("%-4s reloc path: depth %d fanout %d "
+		       "(%d relocs/exec), %d iterations in %.3f secs: "
+		       "%.0f relocs/sec\n",
+		       name, depth, fanout, num_relocs, iters, secs,
+		       (double)num_relocs * iters / secs);
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-d depth] [-f fanout] [-w warmup_iters] [-i iters] [-c]\n"
+		"  -d  tree depth (default %d)\n"
+		"  -f  children per node (default %d)\n"
+		"  -c  CSV output: path,depth,fanout,relocs_per_exec,"
+		"iters,secs,relocs_per_sec\n",
+		name, DEFAULT_DEPTH, DEFAULT_FANOUT);
+}
+
+int main(int argc, char **argv)
+{
+	int warmup = DEFAULT_WARMUP, iters = DEFAULT_ITERS;
+	int csv = 0;
+	int c, n;
+
+	while ((c = getopt(argc, argv, "d:f:w:i:ch")) != -1) {
+		switch (c) {
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 'f':
+			fanout = atoi(optarg);
+			break;
+		case 'w':
+			warmup = atoi(optarg);
+			break;
+		case 'i':
+			iters = atoi(optarg);
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (depth < 1 || fanout < 1 || iters < 1 || warmup < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	fd = drm_open_any();
+
+	build_tree();
+
+	run("cpu", 1, warmup, iters, csv);
+	run("gtt", 0, warmup, iters, csv);
+
+	for (n = 0; n < num_nodes; n++)
+		gem_close(fd, handles[n]);
+	free(reloc_arena);
+	free(exec_arena);
+
+	close(fd);
+
+	return 0;
+}
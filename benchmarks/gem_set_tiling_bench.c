@@ -0,0 +1,218 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * set_tiling transition cost benchmark.
+ *
+ * gem_set_tiling_vs_blt checks that tiling changes are correct under
+ * racing blits; this measures what they cost.  For each object size we
+ * report the latency of a NONE<->X toggle on an idle bo, the same
+ * toggle on a bo with outstanding blits (which is where the kernel may
+ * have to stall), the fence re-setup penalty - first GTT access after
+ * a change against a steady-state access - and the throughput lost by
+ * an independent blit stream when a third object toggles tiling
+ * beside it.  A texture atlas changing tiling at runtime pays exactly
+ * these costs, and they differ per generation.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_clock.h"
+#include "intel_gpu_tools.h"
+
+#define TOGGLE_REPS	256
+#define STREAM_BLITS	256
+#define BUSY_BLITS	64
+
+static int fd;
+static drm_intel_bufmgr *bufmgr;
+static struct intel_batchbuffer *batch;
+
+static const int sizes_kb[] = { 128, 1024, 4096, 16384 };
+
+/* 512 is a legal X-tiling stride on every generation and divides all
+ * the sizes above, so one stride serves the whole sweep */
+#define TEST_STRIDE 512
+
+static void toggle(uint32_t handle, int i, unsigned stride)
+{
+	gem_set_tiling(fd, handle, i & 1 ? I915_TILING_NONE : I915_TILING_X,
+		       i & 1 ? 0 : stride);
+}
+
+static uint64_t time_idle_toggle(uint32_t handle, unsigned stride)
+{
+	uint64_t start, total = 0;
+	int i;
+
+	for (i = 0; i < TOGGLE_REPS; i++) {
+		start = intel_clock_now();
+		toggle(handle, i, stride);
+		total += intel_clock_now() - start;
+	}
+
+	return total;
+}
+
+static uint64_t time_busy_toggle(drm_intel_bo *bo, unsigned stride,
+				 drm_intel_bo *src)
+{
+	uint64_t start, total = 0;
+	int i, j;
+
+	for (i = 0; i < TOGGLE_REPS; i++) {
+		/* queue enough copies that the object is reliably busy
+		 * when the ioctl lands */
+		for (j = 0; j < BUSY_BLITS; j++)
+			intel_copy_bo(batch, bo, src,
+				      stride / 4, bo->size / stride);
+
+		start = intel_clock_now();
+		toggle(bo->handle, i, stride);
+		total += intel_clock_now() - start;
+
+		drm_intel_bo_wait_rendering(bo);
+	}
+
+	return total;
+}
+
+static void time_fence_setup(uint32_t handle, int size, unsigned stride,
+			     double *first_us, double *steady_us)
+{
+	volatile uint32_t *map;
+	uint64_t start, first = 0, steady = 0;
+	uint32_t val = 0;
+	int i;
+
+	map = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
+	assert(map);
+
+	for (i = 0; i < TOGGLE_REPS; i++) {
+		toggle(handle, i, stride);
+
+		/* the first access re-establishes the fence */
+		start = intel_clock_now();
+		val += map[0];
+		first += intel_clock_now() - start;
+
+		start = intel_clock_now();
+		val += map[1];
+		steady += intel_clock_now() - start;
+	}
+
+	munmap((void *)map, size);
+
+	*first_us = intel_clock_to_us(first) / (double)TOGGLE_REPS;
+	*steady_us = intel_clock_to_us(steady) / (double)TOGGLE_REPS;
+	(void)val;
+}
+
+static uint64_t time_blit_stream(drm_intel_bo *dst, drm_intel_bo *src,
+				 int size, unsigned stride,
+				 uint32_t toggled_handle)
+{
+	uint64_t start;
+	int i;
+
+	start = intel_clock_now();
+	for (i = 0; i < STREAM_BLITS; i++) {
+		intel_copy_bo(batch, dst, src, stride / 4, size / stride);
+		if (toggled_handle && (i & 3) == 3)
+			toggle(toggled_handle, i, stride);
+	}
+	drm_intel_bo_wait_rendering(dst);
+
+	return intel_clock_now() - start;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned s;
+
+	fd = drm_open_any();
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+
+	printf("%8s %10s %10s %12s %12s %14s\n",
+	       "size_kb", "idle_us", "busy_us", "fence1st_us",
+	       "fence_us", "stream_loss_%");
+
+	for (s = 0; s < sizeof(sizes_kb)/sizeof(sizes_kb[0]); s++) {
+		int size = sizes_kb[s] * 1024;
+		unsigned stride = TEST_STRIDE;
+		drm_intel_bo *bo, *src, *sdst, *ssrc;
+		uint64_t idle, busy, clean, dirty;
+		double first_us, steady_us;
+
+		bo = drm_intel_bo_alloc(bufmgr, "victim", size, 4096);
+		src = drm_intel_bo_alloc(bufmgr, "fill src", size, 4096);
+		sdst = drm_intel_bo_alloc(bufmgr, "stream dst", size, 4096);
+		ssrc = drm_intel_bo_alloc(bufmgr, "stream src", size, 4096);
+
+		idle = time_idle_toggle(bo->handle, stride);
+		busy = time_busy_toggle(bo, stride, src);
+		time_fence_setup(bo->handle, size, stride,
+				 &first_us, &steady_us);
+
+		/* warm up, then measure the stream alone and beside
+		 * tiling churn */
+		time_blit_stream(sdst, ssrc, size, stride, 0);
+		clean = time_blit_stream(sdst, ssrc, size, stride, 0);
+		dirty = time_blit_stream(sdst, ssrc, size, stride,
+					 bo->handle);
+
+		printf("%8d %10.2f %10.2f %12.2f %12.2f %14.1f\n",
+		       sizes_kb[s],
+		       intel_clock_to_us(idle) / (double)TOGGLE_REPS,
+		       intel_clock_to_us(busy) / (double)TOGGLE_REPS,
+		       first_us, steady_us,
+		       100.0 * ((double)dirty - clean) / clean);
+
+		drm_intel_bo_unreference(ssrc);
+		drm_intel_bo_unreference(sdst);
+		drm_intel_bo_unreference(src);
+		drm_intel_bo_unreference(bo);
+	}
+
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+	close(fd);
+
+	return 0;
+}
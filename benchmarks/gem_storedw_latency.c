@@ -0,0 +1,214 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Benchmark: submit-to-visible latency via MI_STORE_DWORD_IMM ping-pong
+ *
+ * The gem_storedw_loop tests prove the stores land; this measures how
+ * long they take to become visible.  Per iteration the CPU timestamps
+ * right before flushing a single store batch, then spins on the target
+ * through a GTT mapping until the new value appears and timestamps
+ * again.  Timestamps are rdtsc, calibrated against gettimeofday, since
+ * the interesting latencies are a handful of microseconds.  Reported as
+ * percentiles per ring: the tail is what blows an input-to-photon
+ * budget, not the median.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+#include "intel_wait.h"
+
+#define DEFAULT_ITERS 4096
+#define WARMUP_ITERS 64
+
+static drm_intel_bufmgr *bufmgr;
+static drm_intel_bo *target_buffer;
+static int has_ppgtt;
+static double tsc_to_us;
+
+static inline uint64_t rdtsc(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return (uint64_t)hi << 32 | lo;
+}
+
+static double now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+static void calibrate_tsc(void)
+{
+	uint64_t t0, t1;
+	double u0, u1;
+
+	u0 = now_us();
+	t0 = rdtsc();
+	usleep(100000);
+	u1 = now_us();
+	t1 = rdtsc();
+
+	tsc_to_us = (u1 - u0) / (t1 - t0);
+}
+
+/* the store batch never changes apart from the payload dword, so build
+ * it once and let each iteration patch and resubmit the same bo */
+static struct intel_batch_template *create_store_template(void)
+{
+	struct intel_batch_template *tmpl;
+	uint32_t dwords[4];
+
+	dwords[0] = MI_STORE_DWORD_IMM;
+	if (!has_ppgtt)
+		dwords[0] |= MI_MEM_VIRTUAL;
+	dwords[1] = 0; /* reserved */
+	dwords[2] = 0; /* relocated */
+	dwords[3] = 0; /* payload, patched per iteration */
+
+	tmpl = intel_batch_template_create(bufmgr, dwords, 4);
+	intel_batch_template_add_reloc(tmpl, 2, target_buffer,
+				       I915_GEM_DOMAIN_INSTRUCTION,
+				       I915_GEM_DOMAIN_INSTRUCTION, 0);
+
+	return tmpl;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static void measure_ring(const char *name, int ring, int iters)
+{
+	struct intel_batch_template *tmpl;
+	volatile uint32_t *result;
+	static uint32_t val;
+	double *lat;
+	int i;
+
+	lat = malloc(iters * sizeof(*lat));
+	assert(lat);
+
+	tmpl = create_store_template();
+
+	/* uncached reads through the aperture see the store as soon as it
+	 * hits memory; a cacheable mapping could spin on a stale line */
+	do_or_die(drm_intel_gem_bo_map_gtt(target_buffer));
+	result = target_buffer->virtual;
+
+	for (i = -WARMUP_ITERS; i < iters; i++) {
+		uint64_t t0, t1;
+
+		val++;
+		intel_batch_template_set_dword(tmpl, 3, val);
+
+		t0 = rdtsc();
+		intel_batch_template_exec(tmpl, ring);
+		while (*result != val)
+			intel_wait_relax(); /* this wait is the measurement */
+		t1 = rdtsc();
+
+		if (i >= 0)
+			lat[i] = (t1 - t0) * tsc_to_us;
+	}
+
+	drm_intel_gem_bo_unmap_gtt(target_buffer);
+	intel_batch_template_free(tmpl);
+
+	qsort(lat, iters, sizeof(*lat), cmp_double);
+	printf("%-8s min %5.1fus  p50 %5.1fus  p90 %5.1fus  p99 %5.1fus  max %7.1fus\n",
+	       name, lat[0], lat[iters/2], lat[iters*9/10],
+	       lat[iters*99/100], lat[iters-1]);
+
+	free(lat);
+}
+
+int main(int argc, char **argv)
+{
+	int iters = DEFAULT_ITERS;
+	int fd, devid;
+
+	if (argc > 1)
+		iters = atoi(argv[1]);
+	if (iters < 100) {
+		fprintf(stderr, "usage: %s [iterations (>= 100)]\n", argv[0]);
+		exit(1);
+	}
+
+	fd = drm_open_any();
+	devid = intel_get_drm_devid(fd);
+
+	has_ppgtt = gem_uses_aliasing_ppgtt(fd);
+
+	if (intel_gen(devid) < 6) {
+		fprintf(stderr, "MI_STORE_DATA can only use GTT address on "
+			"gen4+/g33 and needs snoopable mem on pre-gen6\n");
+		return 77;
+	}
+
+	calibrate_tsc();
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	assert(bufmgr);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	target_buffer = drm_intel_bo_alloc(bufmgr, "target bo", 4096, 4096);
+	assert(target_buffer);
+
+	measure_ring("render", I915_EXEC_RENDER, iters);
+	if (HAS_BLT_RING(devid))
+		measure_ring("blt", I915_EXEC_BLT, iters);
+	if (HAS_BSD_RING(devid))
+		measure_ring("bsd", I915_EXEC_BSD, iters);
+
+	drm_intel_bo_unreference(target_buffer);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Benchmark: RC6 exit latency
+ *
+ * When the GPU races to idle, every new frame pays the RC6 wakeup
+ * before any real work starts, and that cost has only ever been
+ * guessed at.  Each sample here forces the GPU idle, polls the RC6
+ * residency counter (which only ticks while in RC6, and lives in the
+ * always-on half of the BAR so polling it doesn't wake anything) until
+ * the GT has demonstrably gone to sleep, then times one of two wake
+ * paths from cold:
+ *
+ *   mmio:    forcewake handshake plus the first GT register read
+ *   execbuf: a minimal batch from submission to completion
+ *
+ * The two are measured in separate runs so one probe's wake never
+ * hides the other's, and reported as percentile distributions - the
+ * tail is what lands in a user's input latency.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_gpu_tools.h"
+#include "intel_clock.h"
+#include "intel_results.h"
+
+#define DEFAULT_ITERS 200
+#define RC6_SETTLE_US 5000
+#define RC6_ENTRY_TIMEOUT_US 2000000
+
+static int drm_fd;
+static int devid;
+static uint32_t noop_handle;
+
+static int wait_for_rc6(void)
+{
+	uint64_t start = intel_clock_now();
+	uint32_t r0, r1;
+
+	/* the counter only advances while the GT is in RC6 */
+	do {
+		r0 = INREG(RC6_RESIDENCY_TIME);
+		usleep(RC6_SETTLE_US);
+		r1 = INREG(RC6_RESIDENCY_TIME);
+		if (r1 != r0)
+			return 0;
+	} while (intel_clock_to_us(intel_clock_now() - start) <
+		 RC6_ENTRY_TIMEOUT_US);
+
+	return -1;
+}
+
+static void exec_noop(void)
+{
+	struct drm_i915_gem_execbuffer2 execbuf;
+	struct drm_i915_gem_exec_object2 gem_exec;
+
+	memset(&gem_exec, 0, sizeof(gem_exec));
+	gem_exec.handle = noop_handle;
+
+	memset(&execbuf, 0, sizeof(execbuf));
+	execbuf.buffers_ptr = (uintptr_t)&gem_exec;
+	execbuf.buffer_count = 1;
+	execbuf.batch_len = 8;
+
+	do_or_die(drmIoctl(drm_fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &execbuf));
+	gem_sync(drm_fd, noop_handle);
+}
+
+static double probe_mmio(void)
+{
+	uint64_t t0, t1;
+
+	t0 = intel_clock_now();
+	if (intel_forcewake_get()) {
+		fprintf(stderr, "forcewake failed\n");
+		exit(1);
+	}
+	/* first GT read after the handshake; volatile sink so it stays */
+	(void)INREG(GEN6_RPSTAT1);
+	t1 = intel_clock_now();
+
+	intel_forcewake_put();
+
+	return intel_clock_to_us(t1 - t0);
+}
+
+static double probe_execbuf(void)
+{
+	uint64_t t0, t1;
+
+	t0 = intel_clock_now();
+	exec_noop();
+	t1 = intel_clock_now();
+
+	return intel_clock_to_us(t1 - t0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static void measure(const char *name, double (*probe)(void), int iters)
+{
+	double *lat;
+	char metric[32];
+	int i, skipped = 0;
+
+	lat = malloc(iters * sizeof(*lat));
+	assert(lat);
+
+	/* warm the one-time costs (debugfs lookup, batch setup) */
+	probe();
+
+	for (i = 0; i < iters; i++) {
+		gem_quiescent_gpu(drm_fd);
+		if (wait_for_rc6()) {
+			skipped++;
+			i--;
+			if (skipped > 5) {
+				fprintf(stderr, "GPU stopped entering RC6 "
+					"mid-run; is something else "
+					"holding it awake?\n");
+				exit(1);
+			}
+			continue;
+		}
+
+		lat[i] = probe();
+	}
+
+	qsort(lat, iters, sizeof(*lat), cmp_double);
+	printf("%-8s min %6.1fus  p50 %6.1fus  p90 %6.1fus  p99 %6.1fus  "
+	       "max %8.1fus\n",
+	       name, lat[0], lat[iters/2], lat[iters*9/10],
+	       lat[iters*99/100], lat[iters-1]);
+
+	snprintf(metric, sizeof(metric), "%s-p50", name);
+	intel_results_report(devid, "intel_rc6_latency", metric,
+			     lat[iters/2], "us");
+	snprintf(metric, sizeof(metric), "%s-p99", name);
+	intel_results_report(devid, "intel_rc6_latency", metric,
+			     lat[iters*99/100], "us");
+
+	free(lat);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t batch[2] = { MI_BATCH_BUFFER_END, 0 };
+	int iters = DEFAULT_ITERS;
+
+	if (argc > 1)
+		iters = atoi(argv[1]);
+	if (iters < 100) {
+		fprintf(stderr, "usage: %s [iterations (>= 100)]\n", argv[0]);
+		exit(1);
+	}
+
+	if (geteuid() != 0) {
+		fprintf(stderr, "needs root for register access\n");
+		return 77;
+	}
+
+	drm_fd = drm_open_any();
+	devid = intel_get_drm_devid(drm_fd);
+	if (intel_gen(devid) < 6) {
+		fprintf(stderr, "no RC6 residency counters before gen6\n");
+		return 77;
+	}
+
+	intel_register_access_init(intel_get_pci_device(), 0);
+
+	noop_handle = gem_create(drm_fd, 4096);
+	gem_write(drm_fd, noop_handle, 0, batch, sizeof(batch));
+
+	/* sanity: if RC6 is disabled the residency counter never moves
+	 * and there is nothing to measure */
+	gem_quiescent_gpu(drm_fd);
+	if (wait_for_rc6()) {
+		fprintf(stderr, "GPU never entered RC6 (disabled?)\n");
+		intel_register_access_fini();
+		return 77;
+	}
+
+	printf("RC6 exit latency over %d wakeups:\n", iters);
+	measure("mmio", probe_mmio, iters);
+	measure("execbuf", probe_execbuf, iters);
+
+	intel_register_access_fini();
+	gem_close(drm_fd, noop_handle);
+	close(drm_fd);
+
+	return 0;
+}
@@ -0,0 +1,574 @@
+/*
+ * Copyright © 2009,2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Authors:
+ *    Eric Anholt <eric@anholt.net>
+ *
+ */
+
+/**
+ * Upload-and-blit benchmark: simulates repeatedly uploading frames of
+ * image data and blitting them to a destination, the path exercised by
+ * pixmap upload for non-KMS and by sw-rendered frame presentation.
+ *
+ * This unifies the old intel_upload_blit_{large,large_gtt,large_map,
+ * small} programs into one harness: each upload strategy is an engine,
+ * every engine runs against the same frame size, warmup and timed
+ * iterations, and the per-iteration submit latency is recorded so the
+ * report can include percentiles rather than a single average that
+ * hides stalls.  Output is either human-readable or CSV for tracking
+ * across kernel releases.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+#include "intel_clock.h"
+#include "intel_results.h"
+
+#define DEFAULT_WIDTH	1280
+#define DEFAULT_HEIGHT	720
+#define DEFAULT_WARMUP	60
+#define DEFAULT_ITERS	200
+
+/* Pool of persistently GTT-mapped sources for the wc-pool engine; the
+ * rotation lets a frame be written while the previous one is still
+ * being blitted from. */
+#define NUM_WC_BOS	4
+
+static drm_intel_bufmgr *bufmgr;
+static struct intel_batchbuffer *batch;
+static drm_intel_bo *dst_bo;
+static int width, height;
+static uint32_t devid;
+
+static drm_intel_bo *wc_bos[NUM_WC_BOS];
+static int wc_next;
+
+static uint32_t seed = 1;
+
+typedef drm_intel_bo *(*upload_func)(void);
+
+struct upload_engine {
+	const char *name;
+	upload_func upload;
+};
+
+static double
+get_time_in_secs(void)
+{
+	/* calibrated TSC; the per-pass latencies below are well inside
+	 * gettimeofday jitter */
+	return intel_clock_to_ns(intel_clock_now()) * 1e-9;
+}
+
+/* pwrite: generate the frame in malloc memory, upload in one subdata */
+static drm_intel_bo *
+upload_pwrite(void)
+{
+	static uint32_t *data;
+	drm_intel_bo *src_bo;
+	int i;
+
+	if (data == NULL) {
+		data = malloc(width * height * 4);
+		assert(data);
+	}
+
+	for (i = 0; i < width * height; i++)
+		data[i] = seed++;
+
+	src_bo = drm_intel_bo_alloc(bufmgr, "src", width * height * 4, 4096);
+	drm_intel_bo_subdata(src_bo, 0, width * height * 4, data);
+
+	return src_bo;
+}
+
+/* pwrite-small: many subdata calls of 1-64 dwords, the VBO upload
+ * pattern of the i965 Mesa driver */
+static drm_intel_bo *
+upload_pwrite_small(void)
+{
+	uint32_t data[64];
+	drm_intel_bo *src_bo;
+	int i, j, size;
+
+	src_bo = drm_intel_bo_alloc(bufmgr, "src", width * height * 4, 4096);
+
+	for (i = 0; i < width * height;) {
+		/* Normal workloads have a size distribution with a large
+		 * tail; a uniform pick gets at the cost of the small
+		 * uploads. */
+		size = random() % 64 + 1;
+		if (i + size > width * height)
+			size = width * height - i;
+
+		for (j = 0; j < size; j++)
+			data[j] = seed++;
+
+		drm_intel_bo_subdata(src_bo, i * 4, size * 4, data);
+		i += size;
+	}
+
+	return src_bo;
+}
+
+/* gtt-map: map through the aperture per frame and write in place */
+static drm_intel_bo *
+upload_gtt_map(void)
+{
+	drm_intel_bo *src_bo;
+	uint32_t *data;
+	int i;
+
+	src_bo = drm_intel_bo_alloc(bufmgr, "src", width * height * 4, 4096);
+	drm_intel_gem_bo_map_gtt(src_bo);
+	data = src_bo->virtual;
+
+	for (i = 0; i < width * height; i++)
+		data[i] = seed++;
+
+	drm_intel_gem_bo_unmap_gtt(src_bo);
+
+	return src_bo;
+}
+
+/* cpu-map: cacheable CPU mmap per frame, clflushed on submit */
+static drm_intel_bo *
+upload_cpu_map(void)
+{
+	drm_intel_bo *src_bo;
+	uint32_t *data;
+	int i;
+
+	src_bo = drm_intel_bo_alloc(bufmgr, "src", width * height * 4, 4096);
+	drm_intel_bo_map(src_bo, 1);
+	data = src_bo->virtual;
+
+	for (i = 0; i < width * height; i++)
+		data[i] = seed++;
+
+	drm_intel_bo_unmap(src_bo);
+
+	return src_bo;
+}
+
+/* wc-pool: persistently GTT-mapped pool, only a set-domain per frame */
+static drm_intel_bo *
+upload_wc_pool(void)
+{
+	drm_intel_bo *src_bo;
+	uint32_t *map;
+	int i;
+
+	src_bo = wc_bos[wc_next];
+	wc_next = (wc_next + 1) % NUM_WC_BOS;
+	drm_intel_bo_reference(src_bo);
+
+	/* waits for any blit still reading from this pool slot */
+	drm_intel_gem_bo_start_gtt_access(src_bo, 1);
+
+	map = src_bo->virtual;
+	for (i = 0; i < width * height; i++)
+		map[i] = seed++;
+
+	return src_bo;
+}
+
+static const struct upload_engine engines[] = {
+	{ "pwrite", upload_pwrite },
+	{ "pwrite-small", upload_pwrite_small },
+	{ "gtt-map", upload_gtt_map },
+	{ "cpu-map", upload_cpu_map },
+	{ "wc-pool", upload_wc_pool },
+};
+
+#define NUM_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+static void
+do_render(const struct upload_engine *engine)
+{
+	drm_intel_bo *src_bo = engine->upload();
+
+	BEGIN_BATCH(8);
+	OUT_BATCH(XY_SRC_COPY_BLT_CMD |
+		  XY_SRC_COPY_BLT_WRITE_ALPHA |
+		  XY_SRC_COPY_BLT_WRITE_RGB);
+	OUT_BATCH((3 << 24) | /* 32 bits */
+		  (0xcc << 16) | /* copy ROP */
+		  (width * 4) /* dst pitch */);
+	OUT_BATCH(0); /* dst x1,y1 */
+	OUT_BATCH((height << 16) | width); /* dst x2,y2 */
+	OUT_RELOC(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_BATCH(0); /* src x1,y1 */
+	OUT_BATCH(width * 4); /* src pitch */
+	OUT_RELOC(src_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
+	ADVANCE_BATCH();
+
+	intel_batchbuffer_flush(batch);
+
+	drm_intel_bo_unreference(src_bo);
+}
+
+/* Glyph mode: UI toolkits upload thousands of tiny rectangles per frame,
+ * each traditionally its own pwrite into the atlas.  Compare that against
+ * packing every glyph back-to-back into one staging bo, uploading it with
+ * a single pwrite and scattering it into the atlas with one blit per
+ * destination rectangle, all queued in the same batch. */
+#define GLYPH_ATLAS_DIM	1024
+#define GLYPH_MAX_RECTS	1024
+#define GLYPH_TARGET_RECTS	16384
+
+static drm_intel_bo *atlas_bo;
+
+static double
+run_glyphs_naive(int dim, int nglyphs, int passes)
+{
+	static uint32_t row[GLYPH_ATLAS_DIM];
+	int per_row = GLYPH_ATLAS_DIM / dim;
+	double start;
+	int p, g, x, y;
+
+	start = get_time_in_secs();
+	for (p = 0; p < passes; p++) {
+		for (g = 0; g < nglyphs; g++) {
+			int gx = (g % per_row) * dim;
+			int gy = (g / per_row) * dim;
+
+			/* a glyph is dim rows in the atlas, each its own
+			 * pwrite - the ioctl storm we want to quantify */
+			for (y = 0; y < dim; y++) {
+				for (x = 0; x < dim; x++)
+					row[x] = seed++;
+				drm_intel_bo_subdata(atlas_bo,
+					(((gy + y) * GLYPH_ATLAS_DIM) + gx) * 4,
+					dim * 4, row);
+			}
+		}
+	}
+	drm_intel_bo_wait_rendering(atlas_bo);
+
+	return (double)passes * nglyphs / (get_time_in_secs() - start);
+}
+
+static double
+run_glyphs_batched(int dim, int nglyphs, int passes)
+{
+	int glyph_bytes = dim * dim * 4;
+	int per_row = GLYPH_ATLAS_DIM / dim;
+	drm_intel_bo *staging;
+	uint32_t *data;
+	double start;
+	int p, g, i;
+
+	data = malloc(glyph_bytes * nglyphs);
+	assert(data);
+
+	start = get_time_in_secs();
+	for (p = 0; p < passes; p++) {
+		for (i = 0; i < dim * dim * nglyphs; i++)
+			data[i] = seed++;
+
+		staging = drm_intel_bo_alloc(bufmgr, "glyph staging",
+					     glyph_bytes * nglyphs, 4096);
+		drm_intel_bo_subdata(staging, 0, glyph_bytes * nglyphs, data);
+
+		/* each packed glyph becomes a tiny dim-pitch surface via
+		 * the relocation delta, blitted to its atlas rectangle;
+		 * everything lands in one batch (the buffer flushes itself
+		 * if the rect index outgrows it) */
+		for (g = 0; g < nglyphs; g++) {
+			int gx = (g % per_row) * dim;
+			int gy = (g / per_row) * dim;
+
+			BEGIN_BATCH(8);
+			OUT_BATCH(XY_SRC_COPY_BLT_CMD |
+				  XY_SRC_COPY_BLT_WRITE_ALPHA |
+				  XY_SRC_COPY_BLT_WRITE_RGB);
+			OUT_BATCH((3 << 24) | /* 32 bits */
+				  (0xcc << 16) | /* copy ROP */
+				  (GLYPH_ATLAS_DIM * 4));
+			OUT_BATCH((gy << 16) | gx);
+			OUT_BATCH(((gy + dim) << 16) | (gx + dim));
+			OUT_RELOC(atlas_bo, I915_GEM_DOMAIN_RENDER,
+				  I915_GEM_DOMAIN_RENDER, 0);
+			OUT_BATCH(0); /* src x1,y1 */
+			OUT_BATCH(dim * 4); /* src pitch */
+			OUT_RELOC(staging, I915_GEM_DOMAIN_RENDER, 0,
+				  g * glyph_bytes);
+			ADVANCE_BATCH();
+		}
+		intel_batchbuffer_flush(batch);
+		drm_intel_bo_unreference(staging);
+	}
+	drm_intel_bo_wait_rendering(atlas_bo);
+
+	free(data);
+
+	return (double)passes * nglyphs / (get_time_in_secs() - start);
+}
+
+static void
+run_glyph_compare(void)
+{
+	static const int dims[] = { 8, 16, 32, 64 };
+	unsigned i;
+
+	atlas_bo = drm_intel_bo_alloc(bufmgr, "glyph atlas",
+				      GLYPH_ATLAS_DIM * GLYPH_ATLAS_DIM * 4,
+				      4096);
+
+	for (i = 0; i < sizeof(dims) / sizeof(dims[0]); i++) {
+		int dim = dims[i];
+		int nglyphs = (GLYPH_ATLAS_DIM / dim) * (GLYPH_ATLAS_DIM / dim);
+		double naive, batched;
+		int passes;
+
+		if (nglyphs > GLYPH_MAX_RECTS)
+			nglyphs = GLYPH_MAX_RECTS;
+		/* keep the total rect count comparable across sizes */
+		passes = GLYPH_TARGET_RECTS / nglyphs;
+		if (passes < 1)
+			passes = 1;
+
+		/* settle bo reuse and atlas backing pages */
+		run_glyphs_naive(dim, nglyphs, 1);
+		run_glyphs_batched(dim, nglyphs, 1);
+
+		naive = run_glyphs_naive(dim, nglyphs, passes);
+		batched = run_glyphs_batched(dim, nglyphs, passes);
+
+		printf("glyph %2dx%-2d (%4d rects/pass): naive %8.0f uploads/sec, "
+		       "batched %8.0f uploads/sec (%.1fx)\n",
+		       dim, dim, nglyphs, naive, batched, batched / naive);
+	}
+
+	drm_intel_bo_unreference(atlas_bo);
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static double
+percentile(const double *sorted, int count, int pct)
+{
+	int idx = (count - 1) * pct / 100;
+
+	return sorted[idx];
+}
+
+static void
+run_engine(const struct upload_engine *engine, int warmup, int iters, int csv)
+{
+	double *lat, start_time, end_time, secs, mb_per_sec;
+	int i;
+
+	lat = malloc(iters * sizeof(double));
+	assert(lat);
+
+	for (i = 0; i < warmup; i++)
+		do_render(engine);
+	drm_intel_bo_wait_rendering(dst_bo);
+
+	start_time = get_time_in_secs();
+	for (i = 0; i < iters; i++) {
+		double t = get_time_in_secs();
+
+		do_render(engine);
+		lat[i] = get_time_in_secs() - t;
+	}
+	drm_intel_bo_wait_rendering(dst_bo);
+	end_time = get_time_in_secs();
+
+	secs = end_time - start_time;
+	mb_per_sec = (double)iters * width * height * 4 /
+		1024.0 / 1024.0 / secs;
+
+	qsort(lat, iters, sizeof(double), cmp_double);
+
+	if (csv) {
+		printf("%s,%d,%d,%d,%.6f,%.1f,%.1f,%.1f,%.1f\n",
+		       engine->name, width, height, iters, secs, mb_per_sec,
+		       percentile(lat, iters, 50) * 1e6,
+		       percentile(lat, iters, 90) * 1e6,
+		       percentile(lat, iters, 99) * 1e6);
+	} else {
+		printf("%-12s %d iterations in %.03f secs: %.01f MB/sec, "
+		       "submit latency p50 %.1fus p90 %.1fus p99 %.1fus\n",
+		       engine->name, iters, secs, mb_per_sec,
+		       percentile(lat, iters, 50) * 1e6,
+		       percentile(lat, iters, 90) * 1e6,
+		       percentile(lat, iters, 99) * 1e6);
+	}
+
+	/* feed the results log so perf-report can trend and compare runs */
+	{
+		char metric[32];
+
+		snprintf(metric, sizeof(metric), "%s/%dx%d",
+			 engine->name, width, height);
+		intel_results_report(devid, "intel_upload_blit",
+				     metric, mb_per_sec, "MiB/s");
+		snprintf(metric, sizeof(metric), "%s/%dx%d/p99",
+			 engine->name, width, height);
+		intel_results_report(devid, "intel_upload_blit", metric,
+				     percentile(lat, iters, 99) * 1e6, "us");
+	}
+
+	free(lat);
+}
+
+static void
+usage(const char *name)
+{
+	unsigned i;
+
+	fprintf(stderr,
+		"usage: %s [-e engine] [-W width] [-H height]\n"
+		"       %*s [-w warmup_iters] [-i iters] [-c] [-g]\n"
+		"  -e  run only the named upload engine (default: all)\n"
+		"  -c  CSV output: engine,width,height,iters,secs,mb_per_sec,"
+		"p50_us,p90_us,p99_us\n"
+		"  -g  glyph mode: per-rect pwrites vs one staging write "
+		"plus batched blits\n"
+		"engines:", name, (int)strlen(name), "");
+	for (i = 0; i < NUM_ENGINES; i++)
+		fprintf(stderr, " %s", engines[i].name);
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *engine_name = NULL;
+	int warmup = DEFAULT_WARMUP, iters = DEFAULT_ITERS;
+	int csv = 0, glyphs = 0;
+	int fd, c;
+	unsigned i;
+
+	width = DEFAULT_WIDTH;
+	height = DEFAULT_HEIGHT;
+
+	while ((c = getopt(argc, argv, "e:W:H:w:i:cgh")) != -1) {
+		switch (c) {
+		case 'e':
+			engine_name = optarg;
+			break;
+		case 'W':
+			width = atoi(optarg);
+			break;
+		case 'H':
+			height = atoi(optarg);
+			break;
+		case 'w':
+			warmup = atoi(optarg);
+			break;
+		case 'i':
+			iters = atoi(optarg);
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		case 'g':
+			glyphs = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (width < 1 || height < 1 || iters < 1 || warmup < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (engine_name) {
+		for (i = 0; i < NUM_ENGINES; i++)
+			if (strcmp(engine_name, engines[i].name) == 0)
+				break;
+		if (i == NUM_ENGINES) {
+			fprintf(stderr, "unknown engine '%s'\n", engine_name);
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	fd = drm_open_any();
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	devid = intel_get_drm_devid(fd);
+	batch = intel_batchbuffer_alloc(bufmgr, devid);
+
+	dst_bo = drm_intel_bo_alloc(bufmgr, "dst", width * height * 4, 4096);
+
+	for (i = 0; i < NUM_WC_BOS; i++) {
+		wc_bos[i] = drm_intel_bo_alloc(bufmgr, "wc src",
+					       width * height * 4, 4096);
+		drm_intel_gem_bo_map_gtt(wc_bos[i]);
+		assert(wc_bos[i]->virtual);
+	}
+
+	if (glyphs) {
+		run_glyph_compare();
+	} else {
+		for (i = 0; i < NUM_ENGINES; i++) {
+			if (engine_name && strcmp(engine_name, engines[i].name))
+				continue;
+			run_engine(&engines[i], warmup, iters, csv);
+		}
+	}
+
+	for (i = 0; i < NUM_WC_BOS; i++) {
+		drm_intel_gem_bo_unmap_gtt(wc_bos[i]);
+		drm_intel_bo_unreference(wc_bos[i]);
+	}
+
+	drm_intel_bo_unreference(dst_bo);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
@@ -29,6 +29,8 @@
 
 #include <signal.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
@@ -142,6 +144,144 @@ struct debugger gt2 = {
 	.threads_per_eu = 5
 };
 
+/*
+ * Streaming capture (-s): instead of one file per EU thread with a
+ * synchronous write in the attention loop, records are appended to an
+ * in-memory ring (one memcpy plus a short critical section) and a
+ * background thread serializes them to disk.  When the ring is full the
+ * record is dropped and counted rather than stalling the capture - a
+ * blocked attention loop would skew the very timeline being captured.
+ * Use -r on the resulting file to format it offline.
+ */
+#define CAPTURE_MAGIC	0x45554442 /* 'EUDB' */
+#define CAPTURE_VERSION	1
+#define CAPTURE_RING	256
+
+struct capture_header {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct capture_record {
+	uint64_t time_us;
+	uint32_t euid;
+	uint32_t tid;
+	struct eu_state state;
+};
+
+static struct capture_record capture_ring[CAPTURE_RING];
+static int capture_head, capture_tail, capture_count;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capture_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_t capture_thread;
+static uint64_t capture_written, capture_dropped;
+static int capture_fd = -1;
+
+static uint64_t
+capture_time_us(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static void *
+capture_writer(void *arg) {
+	for (;;) {
+		int n;
+
+		pthread_mutex_lock(&capture_lock);
+		while (capture_count == 0 && !shutting_down)
+			pthread_cond_wait(&capture_not_empty, &capture_lock);
+
+		if (capture_count == 0) {
+			pthread_mutex_unlock(&capture_lock);
+			break;
+		}
+
+		/* the producer can't reuse these slots until the count
+		 * drops, so write the contiguous span unlocked */
+		n = capture_count;
+		if (capture_tail + n > CAPTURE_RING)
+			n = CAPTURE_RING - capture_tail;
+		pthread_mutex_unlock(&capture_lock);
+
+		if (write(capture_fd, &capture_ring[capture_tail],
+			  n * sizeof(struct capture_record)) !=
+		    (ssize_t)(n * sizeof(struct capture_record))) {
+			perror("capture write");
+			break;
+		}
+		capture_written += n;
+
+		pthread_mutex_lock(&capture_lock);
+		capture_tail = (capture_tail + n) % CAPTURE_RING;
+		capture_count -= n;
+		pthread_mutex_unlock(&capture_lock);
+	}
+
+	return NULL;
+}
+
+static int
+capture_append(int euid, int tid, struct eu_state *eu) {
+	struct capture_record *rec;
+
+	pthread_mutex_lock(&capture_lock);
+	if (capture_count == CAPTURE_RING) {
+		capture_dropped++;
+		pthread_mutex_unlock(&capture_lock);
+		return 0;
+	}
+
+	rec = &capture_ring[capture_head];
+	rec->time_us = capture_time_us();
+	rec->euid = euid;
+	rec->tid = tid;
+	memcpy(&rec->state, eu, sizeof(rec->state));
+
+	capture_head = (capture_head + 1) % CAPTURE_RING;
+	capture_count++;
+	pthread_cond_signal(&capture_not_empty);
+	pthread_mutex_unlock(&capture_lock);
+
+	return 0;
+}
+
+static int
+capture_init(const char *file_name) {
+	struct capture_header hdr = { CAPTURE_MAGIC, CAPTURE_VERSION };
+
+	capture_fd = open(file_name, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (capture_fd == -1) {
+		perror("open capture file");
+		return -1;
+	}
+
+	if (write(capture_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		perror("write capture header");
+		return -1;
+	}
+
+	return pthread_create(&capture_thread, NULL, capture_writer, NULL);
+}
+
+static void
+capture_fini(void) {
+	if (capture_fd == -1)
+		return;
+
+	pthread_mutex_lock(&capture_lock);
+	pthread_cond_signal(&capture_not_empty);
+	pthread_mutex_unlock(&capture_lock);
+	pthread_join(capture_thread, NULL);
+	close(capture_fd);
+
+	fprintf(stderr, "capture: %llu records written, %llu dropped\n",
+		(unsigned long long)capture_written,
+		(unsigned long long)capture_dropped);
+}
+
 static void
 dump_debug(void *buf, size_t count) {
 	if (!debug_fd)
@@ -264,7 +404,7 @@ collect_data(int bit, volatile uint8_t *buf) {
 
 	assert(eu_id(bit) != RSVD_EU);
 
-	if (eu_fd(bit) == -1) {
+	if (capture_fd == -1 && eu_fd(bit) == -1) {
 		char name[128];
 		sprintf(name, "dump_eu_%02d_%d.bin", eu_id(bit), eu_tid(bit));
 		eu_fd(bit) = open(name, O_CREAT | O_WRONLY | O_TRUNC, S_IRWXO);
@@ -284,6 +424,9 @@ collect_data(int bit, volatile uint8_t *buf) {
 	if (ret)
 		return ret;
 
+	if (capture_fd != -1)
+		return capture_append(eu_id(bit), eu_tid(bit), eu);
+
 	num = write(eu_fd(bit), (void *)eu, sizeof(*eu));
 	if (num != sizeof(*eu)) {
 		perror("unhandled write failure");
@@ -335,6 +478,8 @@ die(int reason) {
 	intel_register_write(EU_ATT_CLR, 0);
 	intel_register_write(EU_ATT_CLR + 4, 0);
 
+	capture_fini();
+
 	if (debug_fd)
 		close(debug_fd);
 
@@ -372,6 +517,36 @@ identify_device(int devid) {
 	return 0;
 }
 
+/* offline formatter for -s captures; timestamps are printed relative
+ * to the first record so hang progressions read naturally */
+static void
+parse_stream(void *map, size_t size) {
+	struct capture_header *hdr = map;
+	struct capture_record *rec = (struct capture_record *)(hdr + 1);
+	int i, elements;
+	uint64_t t0;
+
+	if (hdr->version != CAPTURE_VERSION) {
+		fprintf(stderr, "Unknown capture version %d\n", hdr->version);
+		return;
+	}
+
+	elements = (size - sizeof(*hdr)) / sizeof(*rec);
+	if (elements == 0) {
+		fprintf(stderr, "Capture holds no records\n");
+		return;
+	}
+
+	t0 = rec[0].time_us;
+	for (i = 0; i < elements; i++) {
+		printf("[%6llu.%06llu] eu %2d thread %d AIP: %x\n",
+		       (unsigned long long)(rec[i].time_us - t0) / 1000000,
+		       (unsigned long long)(rec[i].time_us - t0) % 1000000,
+		       rec[i].euid, rec[i].tid,
+		       ((uint32_t *)rec[i].state.cr0)[2]);
+	}
+}
+
 static void
 parse_data(const char *file_name) {
 	struct eu_state *eu_state = NULL;
@@ -391,18 +566,29 @@ parse_data(const char *file_name) {
 		goto out;
 	}
 
-	elements = st.st_size / sizeof(struct eu_state);
-	if (elements == 0) {
+	if (st.st_size < (off_t)sizeof(struct capture_header)) {
 		fprintf(stderr, "File not big enough for 1 entry\n");
 		goto out;
 	}
 
 	eu_state = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
 	if (eu_state == MAP_FAILED) {
+		eu_state = NULL;
 		perror("mmap");
 		goto out;
 	}
 
+	if (((struct capture_header *)eu_state)->magic == CAPTURE_MAGIC) {
+		parse_stream(eu_state, st.st_size);
+		goto out;
+	}
+
+	elements = st.st_size / sizeof(struct eu_state);
+	if (elements == 0) {
+		fprintf(stderr, "File not big enough for 1 entry\n");
+		goto out;
+	}
+
 	for(i = 0; i < elements; i++) {
 		printf("AIP: ");
 			printf("%x\n", ((uint32_t *)eu_state[i].cr0)[2]);
@@ -510,10 +696,14 @@ int main(int argc, char* argv[]) {
 	struct pci_device *pci_dev;
 	volatile uint8_t *scratch = NULL;
 	int bits[64];
+	const char *capture_file = NULL;
 	int devid = -1, opt;
 
-	while ((opt = getopt(argc, argv, "cdr:pf?h")) != -1) {
+	while ((opt = getopt(argc, argv, "cds:r:pf?h")) != -1) {
 		switch (opt) {
+		case 's':
+			capture_file = optarg;
+			break;
 		case 'c':
 			clear_waits = 1;
 			break;
@@ -571,6 +761,8 @@ int main(int argc, char* argv[]) {
 			fprintf(stderr, "Couldn't flink buffer\n");
 			abort();
 		}
+		if (capture_file && capture_init(capture_file))
+			abort();
 		signal(SIGINT, db_shutdown);
 		printf("Press Ctrl-C to stop\n");
 	} else {
@@ -542,6 +542,299 @@ static int prepare_sprite_surfaces(int fd, int sprite_width, int sprite_height,
 	return 0;
 }
 
+/*
+ * Frame pacing mode.
+ *
+ * Instead of the free-running bounce loop, flip the sprite once per
+ * vblank, driven by vblank events, and account for how late after each
+ * vblank the flip was actually queued plus how many vblanks were missed
+ * outright.  The optional deadline (-l) sleeps that long after every
+ * vblank before flipping, emulating a compositor waking at a fixed
+ * point in the frame; watching the missed-vblank rate climb as the
+ * deadline approaches the frame time separates scheduling margin
+ * problems from kernel flip latency.
+ */
+static int pace_seconds;
+static long long pace_delay_us;
+
+struct pace_ctx {
+	int fd;
+	unsigned int plane_id;
+	int crtc_id;
+	int pipe;
+	uint32_t *fb_ids;
+	int num_fbs;
+	int fb_index;
+	int x, y, out_w, out_h, w, h;
+	unsigned int last_seq;
+	long long start_us;
+	long long lat_sum, lat_min, lat_max;
+	int frames, missed, done;
+};
+
+static long long pace_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((long long)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+static int pace_request_vblank(struct pace_ctx *p)
+{
+	drmVBlank vbl;
+
+	memset(&vbl, 0, sizeof(vbl));
+	vbl.request.type = DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT |
+		(p->pipe << DRM_VBLANK_HIGH_CRTC_SHIFT);
+	vbl.request.sequence = 1;
+	vbl.request.signal = (unsigned long)p;
+
+	return drmWaitVBlank(p->fd, &vbl);
+}
+
+static void pace_vblank_handler(int fd, unsigned int seq,
+				unsigned int tv_sec, unsigned int tv_usec,
+				void *data)
+{
+	struct pace_ctx *p = data;
+	long long vbl_us = ((long long)tv_sec * 1000000) + tv_usec;
+	long long lat;
+
+	if (p->last_seq != 0 && seq > p->last_seq + 1)
+		p->missed += seq - p->last_seq - 1;
+	p->last_seq = seq;
+
+	if (pace_delay_us)
+		usleep(pace_delay_us);
+
+	if (drmModeSetPlane(fd, p->plane_id, p->crtc_id,
+			    p->fb_ids[p->fb_index], 0,
+			    p->x, p->y, p->out_w, p->out_h,
+			    0, 0, p->w << 16, p->h << 16))
+		printf("Failed to flip sprite plane: %s\n", strerror(errno));
+	p->fb_index = (p->fb_index + 1) % p->num_fbs;
+
+	lat = pace_time_us() - vbl_us;
+	p->lat_sum += lat;
+	if (lat > p->lat_max)
+		p->lat_max = lat;
+	if (p->frames == 0 || lat < p->lat_min)
+		p->lat_min = lat;
+	p->frames++;
+
+	if (pace_time_us() - p->start_us >=
+	    (long long)pace_seconds * 1000000) {
+		p->done = 1;
+		return;
+	}
+
+	if (pace_request_vblank(p) != 0)
+		p->done = 1;
+}
+
+static void run_pacing(int gfx_fd, struct connector *c,
+		       unsigned int plane_id, uint32_t *fb_ids, int num_fbs,
+		       int sprite_w, int sprite_h, int out_w, int out_h)
+{
+	struct pace_ctx p;
+	drmEventContext evctx;
+
+	memset(&p, 0, sizeof(p));
+	p.fd = gfx_fd;
+	p.plane_id = plane_id;
+	p.crtc_id = c->crtc;
+	p.pipe = c->pipe;
+	p.fb_ids = fb_ids;
+	p.num_fbs = num_fbs;
+	p.out_w = out_w;
+	p.out_h = out_h;
+	p.w = sprite_w;
+	p.h = sprite_h;
+	p.x = (c->mode.hdisplay / 2) - (out_w / 2);
+	p.y = (c->mode.vdisplay / 2) - (out_h / 2);
+	p.start_us = pace_time_us();
+
+	printf("Pacing one sprite flip per vblank for %d seconds "
+		"(flip deadline %lld us after vblank)\n",
+		pace_seconds, pace_delay_us);
+
+	if (pace_request_vblank(&p) != 0) {
+		printf("drmWaitVBlank (event) failed: %s\n", strerror(errno));
+		return;
+	}
+
+	memset(&evctx, 0, sizeof(evctx));
+	evctx.version = DRM_EVENT_CONTEXT_VERSION;
+	evctx.vblank_handler = pace_vblank_handler;
+
+	while (!p.done) {
+		struct timeval timeout = { 3, 0 };
+		fd_set fds;
+		int ret;
+
+		FD_ZERO(&fds);
+		FD_SET(gfx_fd, &fds);
+		ret = select(gfx_fd + 1, &fds, NULL, NULL, &timeout);
+		if (ret <= 0) {
+			printf("vblank event timed out or error (ret %d)\n",
+				ret);
+			break;
+		}
+		drmHandleEvent(gfx_fd, &evctx);
+	}
+
+	printf("%d frames @ %dHz: flip queued min %lld avg %lld max %lld us "
+		"after vblank, %d missed vblanks (%.2f%%)\n",
+		p.frames, c->mode.vrefresh,
+		p.frames ? p.lat_min : 0,
+		p.frames ? p.lat_sum / p.frames : 0,
+		p.lat_max, p.missed,
+		p.frames + p.missed ?
+			100.0 * p.missed / (p.frames + p.missed) : 0.0);
+}
+
+/*
+ * Update throughput mode.
+ *
+ * The video path issues one sprite update per frame, so what matters is
+ * how many drmModeSetPlane calls per second the kernel can retire and
+ * how long each one blocks the caller.  This mode hammers the plane
+ * with position updates across a sweep of plane sizes, first
+ * free-running (vsync-off, showing raw ioctl cost) and then gated on
+ * drmWaitVBlank (vsync-on, showing what a frame-paced client sees),
+ * and reports updates/sec plus per-call latency for each point.
+ */
+static int bench_seconds;
+
+struct bench_stats {
+	long long count, lat_sum, lat_min, lat_max;
+};
+
+static void bench_account(struct bench_stats *st, long long lat)
+{
+	st->lat_sum += lat;
+	if (lat > st->lat_max)
+		st->lat_max = lat;
+	if (st->count == 0 || lat < st->lat_min)
+		st->lat_min = lat;
+	st->count++;
+}
+
+static void bench_one_size(int gfx_fd, struct connector *c,
+			   unsigned int plane_id, int size, int tiled)
+{
+	const int num_surfaces = 2;
+	uint32_t sprite_handles[2], sprite_fb_id[2];
+	uint32_t sprite_stride, sprite_size;
+	uint32_t handles[4], pitches[4], offsets[4];
+	struct bench_stats st;
+	long long start, now, lat;
+	int x, y, i, vsync, fb_index;
+
+	if (size > c->mode.hdisplay / 2 || size > c->mode.vdisplay / 2)
+		return;
+
+	if (prepare_sprite_surfaces(gfx_fd, size, size, num_surfaces,
+				    sprite_handles, &sprite_stride,
+				    &sprite_size, tiled)) {
+		printf("Sprite surface preparation failed at %dx%d\n",
+			size, size);
+		return;
+	}
+
+	for (i = 0; i < num_surfaces; i++) {
+		handles[0] = handles[1] = handles[2] = handles[3] =
+			sprite_handles[i];
+		pitches[0] = pitches[1] = pitches[2] = pitches[3] =
+			sprite_stride;
+		memset(offsets, 0, sizeof(offsets));
+
+		if (drmModeAddFB2(gfx_fd, size, size, DRM_FORMAT_XRGB8888,
+				  handles, pitches, offsets,
+				  &sprite_fb_id[i], 0)) {
+			printf("Failed to add sprite fb (%dx%d): %s\n",
+				size, size, strerror(errno));
+			gem_close(gfx_fd, sprite_handles[i]);
+			while (--i >= 0)
+				drmModeRmFB(gfx_fd, sprite_fb_id[i]);
+			return;
+		}
+		gem_close(gfx_fd, sprite_handles[i]);
+	}
+
+	x = (c->mode.hdisplay / 2) - (size / 2);
+	y = (c->mode.vdisplay / 2) - (size / 2);
+
+	for (vsync = 0; vsync <= 1; vsync++) {
+		memset(&st, 0, sizeof(st));
+		fb_index = 0;
+
+		start = pace_time_us();
+		do {
+			if (vsync) {
+				drmVBlank vbl;
+
+				memset(&vbl, 0, sizeof(vbl));
+				vbl.request.type = DRM_VBLANK_RELATIVE |
+					(c->pipe <<
+					 DRM_VBLANK_HIGH_CRTC_SHIFT);
+				vbl.request.sequence = 1;
+				if (drmWaitVBlank(gfx_fd, &vbl)) {
+					printf("drmWaitVBlank failed: %s\n",
+						strerror(errno));
+					break;
+				}
+			}
+
+			/* wiggle the position so every call is a real
+			 * update, not a no-op the kernel could elide */
+			now = pace_time_us();
+			if (drmModeSetPlane(gfx_fd, plane_id, c->crtc,
+					    sprite_fb_id[fb_index], 0,
+					    x + (int)(st.count & 7), y,
+					    size, size,
+					    0, 0, size << 16, size << 16)) {
+				printf("Failed to update sprite plane: %s\n",
+					strerror(errno));
+				break;
+			}
+			lat = pace_time_us() - now;
+			fb_index ^= 1;
+
+			bench_account(&st, lat);
+		} while (pace_time_us() - start <
+			 (long long)bench_seconds * 1000000);
+
+		now = pace_time_us();
+		printf("%4dx%-4d %-9s %8.0f updates/s, call latency "
+			"min %lld avg %lld max %lld us\n",
+			size, size, vsync ? "vsync-on" : "vsync-off",
+			st.count * 1e6 / (now - start),
+			st.count ? st.lat_min : 0,
+			st.count ? st.lat_sum / st.count : 0,
+			st.lat_max);
+	}
+
+	for (i = 0; i < num_surfaces; i++)
+		drmModeRmFB(gfx_fd, sprite_fb_id[i]);
+}
+
+static void run_throughput(int gfx_fd, struct connector *c,
+			   unsigned int plane_id, int tiled)
+{
+	static const int sizes[] = { 64, 128, 256, 512, 1024 };
+	unsigned int i;
+
+	printf("Sprite update throughput, %d seconds per point "
+		"(mode %dx%d@%dHz)\n",
+		bench_seconds, c->mode.hdisplay, c->mode.vdisplay,
+		c->mode.vrefresh);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		bench_one_size(gfx_fd, c, plane_id, sizes[i], tiled);
+}
+
 static void ricochet(int tiled, int sprite_w, int sprite_h,
 		     int out_w, int out_h, int dump_info)
 {
@@ -794,6 +1087,21 @@ static void ricochet(int tiled, int sprite_w, int sprite_h,
 		sprite_x = (prim_width / 2) - (out_w / 2);
 		sprite_y = (prim_height / 2) - (out_h / 2);
 
+		// Pacing mode replaces the interactive bounce loop
+		if (pace_seconds != 0) {
+			run_pacing(gfx_fd, &curr_connector, sprite_plane_id,
+				   sprite_fb_id, num_surfaces,
+				   sprite_w, sprite_h, out_w, out_h);
+			goto out;
+		}
+
+		// As does throughput mode, which sweeps its own sizes
+		if (bench_seconds != 0) {
+			run_throughput(gfx_fd, &curr_connector,
+				       sprite_plane_id, tiled);
+			goto out;
+		}
+
 		currTime = 0;
 		prevFlipTime = 0;       // Will force immediate sprite flip
 		prevMoveTime = 0;       // Will force immediate sprite move
@@ -921,7 +1229,11 @@ static void usage(char *name)
 		"\t-d\t[optional] dump mode information\n"
 		"\t-h\t[optional] output help message\n"
 		"\t-t\t[optional] enable tiling\n"
-		"\t-o\t[optional] <output rect width>x<output rect height>\n\n"
+		"\t-o\t[optional] <output rect width>x<output rect height>\n"
+		"\t-p\t[optional] <secs> pace one flip per vblank, report latency\n"
+		"\t-l\t[optional] <usec> flip deadline after vblank (with -p)\n"
+		"\t-b\t[optional] <secs> per point: sweep plane sizes measuring\n"
+		"\t\t           update throughput with vsync off and on\n\n"
 		"Keyboard control for sprite movement and flip rate ...\n"
 		"\t'q' or 'Q' - Quit the program\n"
 		"\t'n' or 'N' - Switch to next display\n"
@@ -942,7 +1254,7 @@ int main(int argc, char **argv)
 			    plane_height = 0,
 			    out_width = 0,
 			    out_height = 0;
-	static char         optstr[] = "ds:o:th";
+	static char         optstr[] = "ds:o:thp:l:b:";
 
 	opterr = 0;
 	while ((c = getopt(argc, argv, optstr)) != -1) {
@@ -962,6 +1274,20 @@ int main(int argc, char **argv)
 			if (sscanf(optarg, "%dx%d", &out_width, &out_height) != 2)
 				usage(argv[0]);
 			break;
+		case 'p':               // Frame pacing duration
+			pace_seconds = atoi(optarg);
+			break;
+		case 'l':               // Flip deadline after vblank
+			pace_delay_us = atoll(optarg);
+			break;
+		case 'b':               // Throughput sweep duration
+			bench_seconds = atoi(optarg);
+			// Sweep picks its own sizes; satisfy -s check
+			if (plane_width == 0) {
+				plane_width = plane_height = 64;
+				test_overlay = 1;
+			}
+			break;
 		default:
 			printf("unknown option %c\n", c);
 			/* fall through */
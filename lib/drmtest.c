@@ -28,20 +28,34 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdarg.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/time.h>
 #include <signal.h>
 #include <pciaccess.h>
 #include <math.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/utsname.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <limits.h>
 
 #include "drmtest.h"
 #include "i915_drm.h"
 #include "intel_chipset.h"
+#include "intel_debugfs.h"
 #include "intel_gpu_tools.h"
+#include "intel_membw.h"
+#include "intel_profile.h"
 
 /* This file contains a bunch of wrapper functions to directly use gem ioctls.
  * Mostly useful to write kernel tests. */
@@ -227,9 +241,88 @@ int drm_open_any(void)
 
 	assert(is_intel(fd));
 
+	/* opt-in background memory load for latency-under-load runs */
+	intel_membw_from_env();
+
+	return fd;
+}
+
+/**
+ * drm_get_cards() - enumerate every intel card in the system
+ *
+ * Fills @cards with up to @max card numbers usable with
+ * drm_open_card(), returns how many were found.  drm_open_any() only
+ * ever returns the first card, which is useless on multi-GPU boxes.
+ */
+int drm_get_cards(int *cards, int max)
+{
+	int i, found = 0;
+
+	for (i = 0; i < 16 && found < max; i++) {
+		char *name;
+		int fd;
+
+		if (asprintf(&name, "/dev/dri/card%u", i) == -1)
+			return -1;
+		fd = open(name, O_RDWR);
+		free(name);
+		if (fd == -1)
+			continue;
+
+		if (is_intel(fd))
+			cards[found++] = i;
+		close(fd);
+	}
+
+	return found;
+}
+
+/** Open a specific intel card by number. */
+int drm_open_card(int card)
+{
+	char *name;
+	int ret, fd;
+
+	ret = asprintf(&name, "/dev/dri/card%d", card);
+	if (ret == -1)
+		return -1;
+
+	fd = open(name, O_RDWR);
+	free(name);
+
+	if (fd == -1) {
+		fprintf(stderr, "failed to open drm card %d\n", card);
+		return -1;
+	}
+
+	assert(is_intel(fd));
+
 	return fd;
 }
 
+/**
+ * drm_open_card_fds() - open @count independent fds on one card
+ *
+ * Each fd is a separate drm client with its own file private state, the
+ * same way production clients land on a card.  Returns 0 on success and
+ * closes nothing on failure, -1 otherwise.
+ */
+int drm_open_card_fds(int card, int *fds, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		fds[i] = drm_open_card(card);
+		if (fds[i] == -1) {
+			while (i--)
+				close(fds[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * Open the first DRM device we can find where we end up being the master.
  */
@@ -332,35 +425,41 @@ void gem_close(int fd, uint32_t handle)
 void gem_write(int fd, uint32_t handle, uint32_t offset, const void *buf, uint32_t size)
 {
 	struct drm_i915_gem_pwrite gem_pwrite;
+	INTEL_PROFILE_BEGIN(gem_write);
 
 	gem_pwrite.handle = handle;
 	gem_pwrite.offset = offset;
 	gem_pwrite.size = size;
 	gem_pwrite.data_ptr = (uintptr_t)buf;
 	do_ioctl(fd, DRM_IOCTL_I915_GEM_PWRITE, &gem_pwrite);
+	INTEL_PROFILE_END(gem_write);
 }
 
 void gem_read(int fd, uint32_t handle, uint32_t offset, void *buf, uint32_t length)
 {
 	struct drm_i915_gem_pread gem_pread;
+	INTEL_PROFILE_BEGIN(gem_read);
 
 	gem_pread.handle = handle;
 	gem_pread.offset = offset;
 	gem_pread.size = length;
 	gem_pread.data_ptr = (uintptr_t)buf;
 	do_ioctl(fd, DRM_IOCTL_I915_GEM_PREAD, &gem_pread);
+	INTEL_PROFILE_END(gem_read);
 }
 
 void gem_set_domain(int fd, uint32_t handle,
 		    uint32_t read_domains, uint32_t write_domain)
 {
 	struct drm_i915_gem_set_domain set_domain;
+	INTEL_PROFILE_BEGIN(gem_set_domain);
 
 	set_domain.handle = handle;
 	set_domain.read_domains = read_domains;
 	set_domain.write_domain = write_domain;
 
 	do_ioctl(fd, DRM_IOCTL_I915_GEM_SET_DOMAIN, &set_domain);
+	INTEL_PROFILE_END(gem_set_domain);
 }
 
 void gem_sync(int fd, uint32_t handle)
@@ -368,6 +467,63 @@ void gem_sync(int fd, uint32_t handle)
 	gem_set_domain(fd, handle, I915_GEM_DOMAIN_GTT, I915_GEM_DOMAIN_GTT);
 }
 
+/* Completion waiting with a selectable strategy.  gem_sync() always
+ * pays a blocking SET_DOMAIN round trip; latency-sensitive callers
+ * (and the tools characterizing wake-up jitter) want to choose between
+ * burning a core, yielding between polls, or the timed wait ioctl. */
+
+static int gem_busy(int fd, uint32_t handle)
+{
+	struct drm_i915_gem_busy busy;
+
+	busy.handle = handle;
+	do_ioctl(fd, DRM_IOCTL_I915_GEM_BUSY, &busy);
+
+	return !!busy.busy;
+}
+
+/* local copy so we don't depend on a wait-aware libdrm */
+struct local_drm_i915_gem_wait {
+	__u32 bo_handle;
+	__u32 flags;
+	__u64 timeout_ns;
+};
+#define LOCAL_IOCTL_I915_GEM_WAIT \
+	DRM_IOWR(DRM_COMMAND_BASE + 0x2c, struct local_drm_i915_gem_wait)
+
+int gem_wait_for_bo(int fd, uint32_t handle, enum gem_wait_strategy strategy)
+{
+	struct local_drm_i915_gem_wait wait;
+	int spins = 0;
+
+	switch (strategy) {
+	case GEM_WAIT_SPIN:
+		while (gem_busy(fd, handle))
+			;
+		return 0;
+	case GEM_WAIT_SPIN_YIELD:
+		/* poll hot for a little while in case completion is
+		 * imminent, then get out of the scheduler's way */
+		while (gem_busy(fd, handle))
+			if (++spins > 1000)
+				sched_yield();
+		return 0;
+	case GEM_WAIT_TIMED:
+		wait.bo_handle = handle;
+		wait.flags = 0;
+		wait.timeout_ns = -1ull;
+		if (ioctl(fd, LOCAL_IOCTL_I915_GEM_WAIT, &wait) == 0)
+			return 0;
+		if (errno != EINVAL)
+			return -errno;
+		/* fall through to blocking on pre-wait kernels */
+	case GEM_WAIT_BLOCK:
+	default:
+		gem_sync(fd, handle);
+		return 0;
+	}
+}
+
 uint32_t gem_create(int fd, int size)
 {
 	struct drm_i915_gem_create create;
@@ -380,6 +536,84 @@ uint32_t gem_create(int fd, int size)
 	return create.handle;
 }
 
+/* Bulk handle creation/teardown.
+ *
+ * Handle-scaling tests issue hundreds of thousands of create/close
+ * ioctls and end up measuring our syscall loop instead of the kernel's
+ * object management.  Stripe the handle array over a few threads so the
+ * ioctls are issued in parallel; handles are per-fd state and the ioctls
+ * are independent, so the workers can safely share the caller's fd.
+ */
+#define BULK_WORKERS 4
+
+struct bulk_work {
+	int fd;
+	int size;
+	uint32_t *handles;
+	int count;
+};
+
+static void *gem_create_bulk_worker(void *arg)
+{
+	struct bulk_work *work = arg;
+	int i;
+
+	for (i = 0; i < work->count; i++)
+		work->handles[i] = gem_create(work->fd, work->size);
+
+	return NULL;
+}
+
+static void *gem_close_bulk_worker(void *arg)
+{
+	struct bulk_work *work = arg;
+	int i;
+
+	for (i = 0; i < work->count; i++)
+		gem_close(work->fd, work->handles[i]);
+
+	return NULL;
+}
+
+static void gem_bulk_run(void *(*fn)(void *), int fd, int size,
+			 uint32_t *handles, int count)
+{
+	struct bulk_work work[BULK_WORKERS];
+	pthread_t threads[BULK_WORKERS];
+	int i, stripe;
+
+	/* not worth spinning up threads for a handful of objects */
+	if (count < BULK_WORKERS * 64) {
+		struct bulk_work all = { fd, size, handles, count };
+
+		fn(&all);
+		return;
+	}
+
+	stripe = count / BULK_WORKERS;
+	for (i = 0; i < BULK_WORKERS; i++) {
+		work[i].fd = fd;
+		work[i].size = size;
+		work[i].handles = handles + i * stripe;
+		work[i].count = stripe;
+		if (i == BULK_WORKERS - 1)
+			work[i].count = count - i * stripe;
+		assert(pthread_create(&threads[i], NULL, fn, &work[i]) == 0);
+	}
+	for (i = 0; i < BULK_WORKERS; i++)
+		pthread_join(threads[i], NULL);
+}
+
+void gem_create_bulk(int fd, int size, uint32_t *handles, int count)
+{
+	gem_bulk_run(gem_create_bulk_worker, fd, size, handles, count);
+}
+
+void gem_close_bulk(int fd, uint32_t *handles, int count)
+{
+	gem_bulk_run(gem_close_bulk_worker, fd, 0, handles, count);
+}
+
 void *gem_mmap__gtt(int fd, uint32_t handle, int size, int prot)
 {
 	struct drm_i915_gem_mmap_gtt mmap_arg;
@@ -409,6 +643,289 @@ void *gem_mmap__cpu(int fd, uint32_t handle, int size, int prot)
 	return (void *)(uintptr_t)mmap_arg.addr_ptr;
 }
 
+/* Failure-tolerant variants; see drmtest.h.  The policy is process
+ * global so a test flips it once and all its helpers inherit it. */
+static enum gem_retry_policy gem_retry_policy = GEM_RETRY_NONE;
+static int gem_retry_max = 8;
+static struct gem_retry_stats gem_retry_counters;
+
+void gem_retry_set_policy(enum gem_retry_policy policy, int max_retries)
+{
+	gem_retry_policy = policy;
+	if (max_retries > 0)
+		gem_retry_max = max_retries;
+}
+
+void gem_retry_get_stats(struct gem_retry_stats *stats)
+{
+	*stats = gem_retry_counters;
+}
+
+void gem_retry_reset_stats(void)
+{
+	memset(&gem_retry_counters, 0, sizeof(gem_retry_counters));
+}
+
+static int gem_retry_transient(int error)
+{
+	return error == ENOMEM || error == EAGAIN || error == ENOSPC;
+}
+
+/* Run attempt() until it succeeds or the policy is exhausted.  The
+ * callback returns 0 on success and leaves errno set on failure. */
+static int gem_retry_loop(int (*attempt)(void *), void *data)
+{
+	unsigned backoff_us = 1000;
+	int tries = 0;
+
+	for (;;) {
+		gem_retry_counters.attempts++;
+		if (attempt(data) == 0)
+			return 0;
+		if (!gem_retry_transient(errno))
+			return -1;
+
+		gem_retry_counters.denied++;
+		if (gem_retry_policy == GEM_RETRY_NONE ||
+		    tries++ >= gem_retry_max) {
+			gem_retry_counters.gave_up++;
+			return -1;
+		}
+
+		gem_retry_counters.retries++;
+		usleep(backoff_us);
+		gem_retry_counters.slept_us += backoff_us;
+		if (backoff_us < 256000)
+			backoff_us *= 2;
+	}
+}
+
+struct gem_try_args {
+	int fd;
+	uint32_t handle;
+	int size;
+	int prot;
+	void *ptr;
+};
+
+static int try_create_attempt(void *data)
+{
+	struct gem_try_args *args = data;
+	struct drm_i915_gem_create create;
+
+	create.handle = 0;
+	create.size = args->size;
+	if (drmIoctl(args->fd, DRM_IOCTL_I915_GEM_CREATE, &create))
+		return -1;
+
+	args->handle = create.handle;
+	return 0;
+}
+
+uint32_t gem_try_create(int fd, int size)
+{
+	struct gem_try_args args;
+
+	args.fd = fd;
+	args.size = size;
+	args.handle = 0;
+
+	if (gem_retry_loop(try_create_attempt, &args))
+		return 0;
+
+	return args.handle;
+}
+
+static int try_mmap_gtt_attempt(void *data)
+{
+	struct gem_try_args *args = data;
+
+	args->ptr = gem_mmap__gtt(args->fd, args->handle,
+				  args->size, args->prot);
+	return args->ptr ? 0 : -1;
+}
+
+static int try_mmap_cpu_attempt(void *data)
+{
+	struct gem_try_args *args = data;
+
+	args->ptr = gem_mmap__cpu(args->fd, args->handle,
+				  args->size, args->prot);
+	return args->ptr ? 0 : -1;
+}
+
+void *gem_try_mmap__gtt(int fd, uint32_t handle, int size, int prot)
+{
+	struct gem_try_args args;
+
+	args.fd = fd;
+	args.handle = handle;
+	args.size = size;
+	args.prot = prot;
+	args.ptr = NULL;
+
+	gem_retry_loop(try_mmap_gtt_attempt, &args);
+	return args.ptr;
+}
+
+void *gem_try_mmap__cpu(int fd, uint32_t handle, int size, int prot)
+{
+	struct gem_try_args args;
+
+	args.fd = fd;
+	args.handle = handle;
+	args.size = size;
+	args.prot = prot;
+	args.ptr = NULL;
+
+	gem_retry_loop(try_mmap_cpu_attempt, &args);
+	return args.ptr;
+}
+
+/* A fresh GTT map faults page-by-page on first touch, so a timed loop
+ * over it measures fault cost and access cost mixed together.  Touch
+ * every page up front when only the steady-state number is wanted. */
+void gem_mmap_prefault(void *ptr, int size)
+{
+	volatile char *p = ptr;
+	int page = getpagesize();
+	int i;
+
+	for (i = 0; i < size; i += page)
+		(void)p[i];
+	if (size)
+		(void)p[size - 1];
+}
+
+/* cumulative minor+major fault count of this process; sample before
+ * and after an access pattern to report how many pages it faulted */
+uint64_t gem_fault_count(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (uint64_t)ru.ru_minflt + ru.ru_majflt;
+}
+
+/*
+ * Mapping cache: production clients hold their mappings across frames,
+ * so a test that munmaps every cycle pays TLB shootdowns the real
+ * workload never sees.  These entry points keep mappings alive after
+ * gem_munmap_cached() and hand the same pointer back on the next
+ * matching request; only LRU eviction (when all slots are taken) or an
+ * explicit flush actually unmaps.  Handle ids recycle once a bo is
+ * closed, so flush the cache before a cached handle can be reused.
+ */
+#define MAP_CACHE_SLOTS 16
+
+struct map_cache_slot {
+	int fd;
+	uint32_t handle;
+	int is_gtt;
+	int size;
+	int prot;
+	void *ptr;
+	int live;	/* handed out and not yet returned */
+	unsigned stamp;
+};
+
+static struct map_cache_slot map_cache[MAP_CACHE_SLOTS];
+static unsigned map_cache_clock;
+
+static void *gem_mmap_cached(int fd, uint32_t handle, int size, int prot,
+			     int is_gtt)
+{
+	struct map_cache_slot *slot, *victim = NULL;
+	int i;
+
+	for (i = 0; i < MAP_CACHE_SLOTS; i++) {
+		slot = &map_cache[i];
+		if (slot->ptr && slot->fd == fd && slot->handle == handle &&
+		    slot->is_gtt == is_gtt && slot->size == size &&
+		    slot->prot == prot) {
+			slot->live = 1;
+			slot->stamp = ++map_cache_clock;
+			return slot->ptr;
+		}
+	}
+
+	/* miss: take a free slot, else evict the least recently used
+	 * mapping that isn't currently handed out */
+	for (i = 0; i < MAP_CACHE_SLOTS; i++) {
+		slot = &map_cache[i];
+		if (!slot->ptr) {
+			victim = slot;
+			break;
+		}
+		if (!slot->live && (!victim || slot->stamp < victim->stamp))
+			victim = slot;
+	}
+
+	/* every slot pinned: fall back to an uncached mapping, which
+	 * gem_munmap_cached() will simply munmap */
+	if (!victim)
+		return is_gtt ? gem_mmap__gtt(fd, handle, size, prot) :
+				gem_mmap__cpu(fd, handle, size, prot);
+
+	if (victim->ptr)
+		munmap(victim->ptr, victim->size);
+	memset(victim, 0, sizeof(*victim));
+
+	victim->ptr = is_gtt ? gem_mmap__gtt(fd, handle, size, prot) :
+			       gem_mmap__cpu(fd, handle, size, prot);
+	if (!victim->ptr)
+		return NULL;
+
+	victim->fd = fd;
+	victim->handle = handle;
+	victim->is_gtt = is_gtt;
+	victim->size = size;
+	victim->prot = prot;
+	victim->live = 1;
+	victim->stamp = ++map_cache_clock;
+
+	return victim->ptr;
+}
+
+void *gem_mmap_cached__gtt(int fd, uint32_t handle, int size, int prot)
+{
+	return gem_mmap_cached(fd, handle, size, prot, 1);
+}
+
+void *gem_mmap_cached__cpu(int fd, uint32_t handle, int size, int prot)
+{
+	return gem_mmap_cached(fd, handle, size, prot, 0);
+}
+
+void gem_munmap_cached(void *ptr, int size)
+{
+	int i;
+
+	for (i = 0; i < MAP_CACHE_SLOTS; i++) {
+		if (map_cache[i].ptr == ptr) {
+			map_cache[i].live = 0;
+			return;
+		}
+	}
+
+	/* overflow mapping from the pinned-cache fallback */
+	munmap(ptr, size);
+}
+
+void gem_mmap_cache_flush(void)
+{
+	int i;
+
+	/* mappings still handed out stay valid; everything parked is
+	 * dropped */
+	for (i = 0; i < MAP_CACHE_SLOTS; i++) {
+		if (map_cache[i].ptr && !map_cache[i].live) {
+			munmap(map_cache[i].ptr, map_cache[i].size);
+			memset(&map_cache[i], 0, sizeof(map_cache[i]));
+		}
+	}
+}
+
 uint64_t gem_aperture_size(int fd)
 {
 	struct drm_i915_gem_get_aperture aperture;
@@ -471,52 +988,775 @@ uint32_t prime_fd_to_handle(int fd, int dma_buf_fd)
 	return args.handle;
 }
 
-/* signal interrupt helpers */
-static pid_t signal_helper = -1;
+/* Background interference helpers.
+ *
+ * Forked children generating calibrated pressure against the parent:
+ * signal storms (the classic way to hit -EINTR/-ERESTARTSYS paths),
+ * cpu hogs, memory-bandwidth hogs and forced scheduler migrations.
+ * The rate is events per second per helper; cpu-flavoured helpers burn
+ * roughly a millisecond per event, so rate_hz maps to ~rate_hz/10
+ * percent of one core.  Helpers watch their parent via kill() and exit
+ * on its death, so a crashed test doesn't leave hogs behind. */
+#define INTERFERENCE_MAX_HELPERS	16
+#define INTERFERENCE_MEM_SIZE		(16 * 1024 * 1024)
+
+static pid_t interference_pids[INTERFERENCE_MAX_HELPERS];
+static int num_interference;
 long long int sig_stat;
-static void __attribute__((noreturn)) signal_helper_process(pid_t pid)
-{
-	/* Interrupt the parent process at 500Hz, just to be annoying */
-	while (1) {
-		usleep(1000 * 1000 / 500);
-		if (kill(pid, SIGUSR1)) /* Parent has died, so must we. */
-			exit(0);
-	}
-}
 
 static void sig_handler(int i)
 {
 	sig_stat++;
 }
 
-void drmtest_fork_signal_helper(void)
+static void interference_burn_us(unsigned us)
 {
-	pid_t pid;
+	struct timeval start, now;
 
-	signal(SIGUSR1, sig_handler);
-	pid = fork();
-	if (pid == 0) {
-		signal_helper_process(getppid());
-		return;
+	gettimeofday(&start, NULL);
+	do {
+		gettimeofday(&now, NULL);
+	} while ((now.tv_sec - start.tv_sec) * 1000000 +
+		 now.tv_usec - start.tv_usec < us);
+}
+
+static void __attribute__((noreturn))
+interference_process(enum drmtest_interference type, pid_t pid,
+		     unsigned rate_hz, int seq)
+{
+	int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	char *mem = NULL;
+
+	if (type == INTERFERENCE_MEMORY) {
+		mem = malloc(INTERFERENCE_MEM_SIZE);
+		if (mem == NULL)
+			exit(1);
 	}
 
-	signal_helper = pid;
+	while (1) {
+		usleep(1000 * 1000 / rate_hz);
+
+		/* Parent has died, so must we. */
+		if (kill(pid, type == INTERFERENCE_SIGNAL ? SIGUSR1 : 0))
+			exit(0);
+
+		switch (type) {
+		case INTERFERENCE_SIGNAL:
+			break;
+		case INTERFERENCE_CPU:
+			interference_burn_us(1000);
+			break;
+		case INTERFERENCE_MEMORY:
+			memset(mem, seq, INTERFERENCE_MEM_SIZE);
+			break;
+		case INTERFERENCE_MIGRATE: {
+			cpu_set_t set;
+
+			CPU_ZERO(&set);
+			CPU_SET(seq % ncpus, &set);
+			sched_setaffinity(0, sizeof(set), &set);
+			interference_burn_us(1000);
+			break;
+		}
+		}
+		seq++;
+	}
 }
 
-void drmtest_stop_signal_helper(void)
+int drmtest_fork_interference(enum drmtest_interference type,
+			      int num_helpers, unsigned rate_hz)
 {
-	if (signal_helper != -1)
-		kill(signal_helper, SIGQUIT);
+	int i;
 
-	if (sig_stat)
-		fprintf(stderr, "signal handler called %llu times\n", sig_stat);
+	if (num_helpers < 1 || rate_hz < 1 ||
+	    num_interference + num_helpers > INTERFERENCE_MAX_HELPERS)
+		return -1;
 
-	signal_helper = -1;
-}
+	if (type == INTERFERENCE_SIGNAL)
+		signal(SIGUSR1, sig_handler);
 
-/* subtests helpers */
-static bool list_subtests = false;
-static char *run_single_subtest = NULL;
+	for (i = 0; i < num_helpers; i++) {
+		pid_t pid = fork();
+
+		if (pid == -1)
+			return -1;
+		if (pid == 0)
+			interference_process(type, getppid(), rate_hz, i);
+
+		interference_pids[num_interference++] = pid;
+	}
+
+	return 0;
+}
+
+void drmtest_stop_interference(void)
+{
+	int i;
+
+	for (i = 0; i < num_interference; i++)
+		kill(interference_pids[i], SIGQUIT);
+	num_interference = 0;
+
+	if (sig_stat)
+		fprintf(stderr, "signal handler called %llu times\n", sig_stat);
+}
+
+void drmtest_fork_signal_helper(void)
+{
+	/* Interrupt the parent process at 500Hz, just to be annoying */
+	drmtest_fork_interference(INTERFERENCE_SIGNAL, 1, 500);
+}
+
+void drmtest_stop_signal_helper(void)
+{
+	drmtest_stop_interference();
+}
+
+/* Pre-forked worker pool; see drmtest.h for the dispatch protocol. */
+
+static void __attribute__((noreturn))
+pool_worker_process(drmtest_pool_fn fn, int worker, bool own_fd,
+		    int task_fd, int done_fd)
+{
+	uint64_t arg;
+	ssize_t ret;
+	int fd = -1;
+
+	if (own_fd)
+		fd = drm_open_any();
+
+	while ((ret = read(task_fd, &arg, sizeof(arg))) == sizeof(arg)) {
+		char status = fn(fd, worker, arg) ? 1 : 0;
+
+		if (write(done_fd, &status, 1) != 1)
+			exit(1);
+	}
+
+	/* a zero-length read means the parent closed the pipe: normal
+	 * shutdown.  Anything else is a torn dispatch. */
+	exit(ret == 0 ? 0 : 1);
+}
+
+/* Reap one completion, blocking until a busy worker reports.  A worker
+ * whose status pipe hits EOF died mid-task (assert in the callback);
+ * it is retired and counted as a failure. */
+static int pool_collect(struct drmtest_pool *pool)
+{
+	struct drmtest_pool_worker *w;
+	fd_set readable;
+	int i, nfds = 0;
+
+	FD_ZERO(&readable);
+	for (i = 0; i < pool->num_workers; i++) {
+		w = &pool->workers[i];
+		if (!w->busy)
+			continue;
+		FD_SET(w->done_fd, &readable);
+		if (w->done_fd >= nfds)
+			nfds = w->done_fd + 1;
+	}
+	if (nfds == 0)
+		return -1;
+
+	if (select(nfds, &readable, NULL, NULL, NULL) < 0)
+		return -1;
+
+	for (i = 0; i < pool->num_workers; i++) {
+		char status;
+
+		w = &pool->workers[i];
+		if (!w->busy || !FD_ISSET(w->done_fd, &readable))
+			continue;
+
+		w->busy = 0;
+		if (read(w->done_fd, &status, 1) == 1) {
+			if (status)
+				pool->failures++;
+		} else {
+			waitpid(w->pid, NULL, 0);
+			close(w->task_fd);
+			close(w->done_fd);
+			w->pid = -1;
+			pool->failures++;
+		}
+		return 0;
+	}
+
+	return -1;
+}
+
+int drmtest_pool_init(struct drmtest_pool *pool, int num_workers,
+		      drmtest_pool_fn fn, bool own_fd)
+{
+	int i;
+
+	if (num_workers < 1 || num_workers > DRMTEST_POOL_MAX_WORKERS)
+		return -1;
+
+	memset(pool, 0, sizeof(*pool));
+	pool->num_workers = num_workers;
+
+	/* writing to a retired worker's pipe must fail with EPIPE so
+	 * dispatch can count the failure and retry elsewhere, not kill
+	 * the whole test with SIGPIPE */
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < num_workers; i++) {
+		struct drmtest_pool_worker *w = &pool->workers[i];
+		int task[2], done[2];
+		pid_t pid;
+
+		if (pipe(task) || pipe(done))
+			return -1;
+
+		pid = fork();
+		if (pid == -1)
+			return -1;
+		if (pid == 0) {
+			int j;
+
+			/* drop the inherited ends of the earlier workers'
+			 * pipes, or their EOF-on-close shutdown never
+			 * fires while this sibling lives */
+			for (j = 0; j < i; j++) {
+				close(pool->workers[j].task_fd);
+				close(pool->workers[j].done_fd);
+			}
+			close(task[1]);
+			close(done[0]);
+			pool_worker_process(fn, i, own_fd, task[0], done[1]);
+		}
+
+		close(task[0]);
+		close(done[1]);
+		w->pid = pid;
+		w->task_fd = task[1];
+		w->done_fd = done[0];
+	}
+
+	return 0;
+}
+
+int drmtest_pool_dispatch(struct drmtest_pool *pool, uint64_t arg)
+{
+	struct drmtest_pool_worker *w;
+	int i;
+
+retry:
+	for (i = 0; i < pool->num_workers; i++) {
+		w = &pool->workers[i];
+		if (w->pid == -1 || w->busy)
+			continue;
+
+		if (write(w->task_fd, &arg, sizeof(arg)) != sizeof(arg)) {
+			waitpid(w->pid, NULL, 0);
+			close(w->task_fd);
+			close(w->done_fd);
+			w->pid = -1;
+			pool->failures++;
+			continue;
+		}
+		w->busy = 1;
+		return 0;
+	}
+
+	if (pool_collect(pool) == 0)
+		goto retry;
+
+	return -1;
+}
+
+int drmtest_pool_wait(struct drmtest_pool *pool)
+{
+	while (pool_collect(pool) == 0)
+		;
+
+	return pool->failures;
+}
+
+/* Futex rendezvous; see drmtest.h for the contract.
+ *
+ * A generation-counted barrier in a shared anonymous page.  The last
+ * process to arrive resets the arrival count and skew bookkeeping,
+ * bumps the generation and wakes everyone with one FUTEX_WAKE, so the
+ * release is a single kernel broadcast rather than a chain of pipe
+ * reads.  Each waiter timestamps itself on the way out and folds that
+ * into shared min/max for the skew report.  Reusing the barrier is
+ * safe: a process must leave release N (updating the stats) before it
+ * can arrive at release N+1, so the stats are complete before the
+ * next releaser resets them. */
+struct drmtest_rendezvous {
+	int nproc;
+	volatile int arrived;
+	volatile unsigned generation;
+	volatile long long wake_min, wake_max;	/* µs, last release */
+};
+
+static long long rendezvous_now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ll + tv.tv_usec;
+}
+
+static void rendezvous_futex(volatile unsigned *addr, int op, unsigned val)
+{
+	syscall(SYS_futex, (unsigned *)addr, op, val, NULL, NULL, 0);
+}
+
+struct drmtest_rendezvous *drmtest_rendezvous_create(int nproc)
+{
+	struct drmtest_rendezvous *r;
+
+	if (nproc < 2)
+		return NULL;
+
+	r = mmap(NULL, sizeof(*r), PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (r == MAP_FAILED)
+		return NULL;
+
+	r->nproc = nproc;
+	r->wake_min = LLONG_MAX;
+	r->wake_max = 0;
+
+	return r;
+}
+
+void drmtest_rendezvous_wait(struct drmtest_rendezvous *r)
+{
+	unsigned gen = r->generation;
+	long long now, seen;
+
+	if (__sync_add_and_fetch(&r->arrived, 1) == r->nproc) {
+		/* last one in releases the whole field */
+		r->arrived = 0;
+		r->wake_min = LLONG_MAX;
+		r->wake_max = 0;
+		__sync_synchronize();
+		r->generation = gen + 1;
+		rendezvous_futex(&r->generation, FUTEX_WAKE, INT_MAX);
+	} else {
+		while (r->generation == gen)
+			rendezvous_futex(&r->generation, FUTEX_WAIT, gen);
+	}
+
+	now = rendezvous_now_us();
+	while (now < (seen = r->wake_min))
+		if (__sync_bool_compare_and_swap(&r->wake_min, seen, now))
+			break;
+	while (now > (seen = r->wake_max))
+		if (__sync_bool_compare_and_swap(&r->wake_max, seen, now))
+			break;
+}
+
+long long drmtest_rendezvous_skew_us(struct drmtest_rendezvous *r)
+{
+	if (r->wake_min == LLONG_MAX || r->wake_max == 0)
+		return -1;
+
+	return r->wake_max - r->wake_min;
+}
+
+void drmtest_rendezvous_destroy(struct drmtest_rendezvous *r)
+{
+	munmap(r, sizeof(*r));
+}
+
+/* Asynchronous error-state spooler.
+ *
+ * By the time someone remembers to save i915_error_state after a test
+ * blew up, the next hang has usually overwritten it.  The failure
+ * paths below snapshot it automatically: a detached grandchild streams
+ * the (potentially multi-gigabyte) debugfs read through gzip into a
+ * per-test spool file while the dying test finishes its cleanup
+ * unblocked.  INTEL_ERROR_SPOOL names the spool directory (default
+ * /tmp, "0" disables). */
+
+static void __attribute__((noreturn))
+spool_stream(const char *src, const char *base)
+{
+	static char buf[65536];
+	char path[640];
+	ssize_t n;
+	int in, out;
+
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		_exit(1);
+
+	snprintf(path, sizeof(path), "%s.gz", base);
+	out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0)
+		_exit(1);
+
+	dup2(in, STDIN_FILENO);
+	dup2(out, STDOUT_FILENO);
+	execlp("gzip", "gzip", "-cf", (char *)NULL);
+
+	/* no gzip on the box: spool raw rather than not at all */
+	unlink(path);
+	close(out);
+	out = open(base, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0)
+		_exit(1);
+	while ((n = read(in, buf, sizeof(buf))) > 0)
+		if (write(out, buf, n) != n)
+			_exit(1);
+	_exit(0);
+}
+
+void drmtest_spool_error_state(const char *reason)
+{
+	char src[256], base[512], head[64], comm[32] = "test";
+	const char *dir;
+	ssize_t len;
+	pid_t pid;
+	int fd;
+
+	dir = getenv("INTEL_ERROR_SPOOL");
+	if (dir && strcmp(dir, "0") == 0)
+		return;
+	if (dir == NULL || *dir == '\0')
+		dir = "/tmp";
+
+	if (intel_debugfs_path(src, sizeof(src) - 32))
+		return;
+	strcat(src, "/i915_error_state");
+
+	/* nothing captured, nothing to spool (or to fork for) */
+	fd = open(src, O_RDONLY);
+	if (fd < 0)
+		return;
+	len = read(fd, head, sizeof(head) - 1);
+	close(fd);
+	if (len <= 0)
+		return;
+	head[len] = '\0';
+	if (strncmp(head, "no error state", 14) == 0)
+		return;
+
+	fd = open("/proc/self/comm", O_RDONLY);
+	if (fd >= 0) {
+		len = read(fd, comm, sizeof(comm) - 1);
+		close(fd);
+		if (len > 0) {
+			if (comm[len - 1] == '\n')
+				len--;
+			comm[len] = '\0';
+		}
+	}
+	snprintf(base, sizeof(base), "%s/%s-%d-%s.error-state",
+		 dir, comm, getpid(), reason);
+
+	/* Double fork so the streamer is reparented to init: the dying
+	 * test neither waits on the read nor leaves a zombie. */
+	pid = fork();
+	if (pid != 0) {
+		if (pid > 0) {
+			waitpid(pid, NULL, 0);
+			fprintf(stderr, "spooling i915 error state "
+				"to %s[.gz]\n", base);
+		}
+		return;
+	}
+
+	if (fork() != 0)
+		_exit(0);
+
+	spool_stream(src, base);
+}
+
+int drmtest_pool_fini(struct drmtest_pool *pool)
+{
+	int i;
+
+	drmtest_pool_wait(pool);
+
+	for (i = 0; i < pool->num_workers; i++) {
+		struct drmtest_pool_worker *w = &pool->workers[i];
+		int status = 0;
+
+		if (w->pid == -1)
+			continue;
+
+		close(w->task_fd);
+		waitpid(w->pid, &status, 0);
+		close(w->done_fd);
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			pool->failures++;
+	}
+	pool->num_workers = 0;
+
+	return pool->failures;
+}
+
+/* subtests helpers */
+static bool list_subtests = false;
+static char *run_single_subtest = NULL;
+
+/*
+ * Result cache backing --skip-passed.
+ *
+ * A subtest that passed earlier leaves a marker file keyed on the test
+ * binary's content hash, the running kernel and the chipset, so
+ * bisection runs only pay for subtests that failed before or whose
+ * binary/kernel/hardware combination changed.  Markers are written by an
+ * on_exit() hook and only when the process exits successfully, so a
+ * crashing or failing run never caches anything.
+ */
+static bool skip_passed = false;
+static bool cache_valid = false;
+static char cache_dir[256];
+static char cache_key[192];
+static char **executed_subtests;
+static int num_executed;
+
+static uint32_t hash_file(const char *path)
+{
+	uint32_t hash = 2166136261u;
+	unsigned char buf[8192];
+	ssize_t ret;
+	int i, fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	while ((ret = read(fd, buf, sizeof(buf))) > 0)
+		for (i = 0; i < ret; i++)
+			hash = (hash ^ buf[i]) * 16777619u;
+
+	close(fd);
+	return hash;
+}
+
+static uint32_t cache_devid(void)
+{
+	uint32_t devid = 0;
+	int fd;
+
+	fd = open("/dev/dri/card0", O_RDWR);
+	if (fd >= 0) {
+		devid = intel_get_drm_devid(fd);
+		close(fd);
+	}
+
+	return devid;
+}
+
+static void subtest_cache_store(int status, void *arg)
+{
+	char path[512];
+	int i, fd;
+
+	if (status != 0 || !cache_valid)
+		return;
+
+	for (i = 0; i < num_executed; i++) {
+		snprintf(path, sizeof(path), "%s/%s.%s", cache_dir,
+			 cache_key, executed_subtests[i]);
+		fd = open(path, O_WRONLY | O_CREAT, 0644);
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
+static void subtest_cache_init(void)
+{
+	struct utsname uts;
+	const char *home;
+	uint32_t binhash;
+
+	home = getenv("HOME");
+	if (home)
+		snprintf(cache_dir, sizeof(cache_dir),
+			 "%s/.drmtest-cache", home);
+	else
+		snprintf(cache_dir, sizeof(cache_dir),
+			 "/var/tmp/drmtest-cache");
+	mkdir(cache_dir, 0755);
+
+	binhash = hash_file("/proc/self/exe");
+	if (binhash == 0)
+		return;
+
+	if (uname(&uts))
+		return;
+
+	snprintf(cache_key, sizeof(cache_key), "%08x-%s-%04x",
+		 binhash, uts.release, cache_devid());
+
+	cache_valid = true;
+	on_exit(subtest_cache_store, NULL);
+}
+
+static bool subtest_cached_pass(const char *subtest_name)
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s/%s.%s", cache_dir,
+		 cache_key, subtest_name);
+
+	return access(path, F_OK) == 0;
+}
+
+/*
+ * Sharding for distributed runs.
+ *
+ * A subtest's identity is a hash of its name, so which shard owns it
+ * depends on nothing but the name and the shard count: every machine
+ * computes the same split without exchanging lists, and adding a
+ * subtest doesn't reshuffle the others between machines the way
+ * slicing an enumeration would.  --shard=K/N (or DRMTEST_SHARD=K/N,
+ * K counting from 1) makes this process run only its share;
+ * --shard-results=FILE (DRMTEST_SHARD_RESULTS) appends one
+ * tab-separated line per subtest decision plus a final exit record,
+ * which is what the merger joins across machines.
+ */
+static int shard_index = -1;
+static int shard_count;
+static FILE *shard_results;
+
+static uint32_t subtest_id(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+
+	return hash;
+}
+
+static void shard_log(const char *subtest_name, uint32_t id,
+		      const char *disposition)
+{
+	if (shard_results == NULL)
+		return;
+
+	fprintf(shard_results, "%s\t%s\t%08x\t%d/%d\t%s\n",
+		program_invocation_short_name, subtest_name, id,
+		shard_index + 1, shard_count, disposition);
+	fflush(shard_results);
+}
+
+static void shard_store_exit(int status, void *arg)
+{
+	if (shard_results == NULL)
+		return;
+
+	fprintf(shard_results, "%s\texit\t%08x\t%d/%d\tstatus %d\n",
+		program_invocation_short_name, 0, shard_index + 1,
+		shard_count, status);
+	fclose(shard_results);
+	shard_results = NULL;
+}
+
+static void shard_parse(const char *arg)
+{
+	int k, n;
+
+	if (sscanf(arg, "%d/%d", &k, &n) != 2 ||
+	    n < 1 || k < 1 || k > n) {
+		fprintf(stderr, "invalid shard spec '%s', want K/N\n", arg);
+		exit(1);
+	}
+
+	shard_index = k - 1;
+	shard_count = n;
+}
+
+static void shard_results_open(const char *path)
+{
+	shard_results = fopen(path, "a");
+	if (shard_results == NULL) {
+		fprintf(stderr, "can't append shard results to %s\n", path);
+		exit(1);
+	}
+	on_exit(shard_store_exit, NULL);
+}
+
+/* lazy fixture state */
+static int fixture_fd = -1;
+static uint32_t fixture_devid;
+static drm_intel_bufmgr *fixture_bufmgr;
+static struct intel_batchbuffer *fixture_batch;
+static struct timeval startup_tv;
+static bool startup_report_enabled;
+static bool first_subtest_seen;
+
+static void startup_report(const char *what)
+{
+	struct timeval now;
+
+	if (!startup_report_enabled)
+		return;
+
+	gettimeofday(&now, NULL);
+	fprintf(stderr, "startup: %.1fms to %s\n",
+		(now.tv_sec - startup_tv.tv_sec) * 1000. +
+		(now.tv_usec - startup_tv.tv_usec) / 1000., what);
+}
+
+int drmtest_fixture_fd(void)
+{
+	if (fixture_fd < 0) {
+		fixture_fd = drm_open_any();
+		startup_report("drm fd");
+	}
+
+	return fixture_fd;
+}
+
+uint32_t drmtest_fixture_devid(void)
+{
+	if (!fixture_devid)
+		fixture_devid = intel_get_drm_devid(drmtest_fixture_fd());
+
+	return fixture_devid;
+}
+
+drm_intel_bufmgr *drmtest_fixture_bufmgr(void)
+{
+	if (!fixture_bufmgr) {
+		fixture_bufmgr = drm_intel_bufmgr_gem_init(drmtest_fixture_fd(),
+							   4096);
+		assert(fixture_bufmgr);
+		startup_report("bufmgr");
+	}
+
+	return fixture_bufmgr;
+}
+
+struct intel_batchbuffer *drmtest_fixture_batch(void)
+{
+	if (!fixture_batch) {
+		fixture_batch = intel_batchbuffer_alloc(drmtest_fixture_bufmgr(),
+							drmtest_fixture_devid());
+		assert(fixture_batch);
+		startup_report("batchbuffer");
+	}
+
+	return fixture_batch;
+}
+
+void drmtest_fixture_fini(void)
+{
+	if (fixture_batch) {
+		intel_batchbuffer_free(fixture_batch);
+		fixture_batch = NULL;
+	}
+	if (fixture_bufmgr) {
+		drm_intel_bufmgr_destroy(fixture_bufmgr);
+		fixture_bufmgr = NULL;
+	}
+	if (fixture_fd >= 0) {
+		close(fixture_fd);
+		fixture_fd = -1;
+		fixture_devid = 0;
+	}
+}
 
 void drmtest_subtest_init(int argc, char **argv)
 {
@@ -524,8 +1764,15 @@ void drmtest_subtest_init(int argc, char **argv)
 	static struct option long_options[] = {
 		{"list-subtests", 0, 0, 'l'},
 		{"run-subtest", 1, 0, 'r'},
+		{"skip-passed", 0, 0, 's'},
+		{"shard", 1, 0, 'S'},
+		{"shard-results", 1, 0, 'R'},
 		{NULL, 0, 0, 0,}
 	};
+	const char *env;
+
+	gettimeofday(&startup_tv, NULL);
+	startup_report_enabled = getenv("DRMTEST_STARTUP_REPORT") != NULL;
 
 	/* supress getopt errors about unknown options */
 	opterr = 0;
@@ -533,98 +1780,593 @@ void drmtest_subtest_init(int argc, char **argv)
 			       long_options, &option_index)) != -1) {
 		switch(c) {
 		case 'l':
+			/* keep scanning so --shard can trim the list */
 			list_subtests = true;
-			goto out;
+			break;
 		case 'r':
 			run_single_subtest = strdup(optarg);
 			goto out;
+		case 's':
+			/* likewise: --shard may still follow */
+			skip_passed = true;
+			subtest_cache_init();
+			break;
+		case 'S':
+			shard_parse(optarg);
+			break;
+		case 'R':
+			shard_results_open(optarg);
+			break;
 		}
 	}
 
-out:
-	/* reset opt parsing */
-	optind = 1;
+	if (shard_count == 0 && (env = getenv("DRMTEST_SHARD")))
+		shard_parse(env);
+	if (shard_count && shard_results == NULL &&
+	    (env = getenv("DRMTEST_SHARD_RESULTS")))
+		shard_results_open(env);
+
+out:
+	/* reset opt parsing */
+	optind = 1;
+}
+
+/*
+ * Note: Testcases which use these helpers MUST NOT output anything to stdout
+ * outside of places protected by drmtest_run_subtest checks - the piglit
+ * runner adds every line to the subtest list.
+ */
+bool drmtest_run_subtest(const char *subtest_name)
+{
+	if (shard_count &&
+	    subtest_id(subtest_name) % shard_count != shard_index) {
+		if (!list_subtests)
+			shard_log(subtest_name, subtest_id(subtest_name),
+				  "other-shard");
+		return false;
+	}
+
+	if (list_subtests) {
+		printf("%s\n", subtest_name);
+		return false;
+	}
+
+	if (run_single_subtest &&
+	    strcmp(subtest_name, run_single_subtest) != 0)
+		return false;
+
+	if (skip_passed && cache_valid) {
+		if (subtest_cached_pass(subtest_name)) {
+			fprintf(stderr, "Skipping %s: cached pass\n",
+				subtest_name);
+			return false;
+		}
+
+		/* remember it for the exit-time cache writeback */
+		executed_subtests = realloc(executed_subtests,
+					    (num_executed + 1) *
+					    sizeof(char *));
+		assert(executed_subtests);
+		executed_subtests[num_executed++] = strdup(subtest_name);
+	}
+
+	if (shard_count)
+		shard_log(subtest_name, subtest_id(subtest_name), "run");
+
+	if (!first_subtest_seen) {
+		startup_report(subtest_name);
+		first_subtest_seen = true;
+	}
+
+	return true;
+}
+
+bool drmtest_only_list_subtests(void)
+{
+	return list_subtests;
+}
+
+/* other helpers */
+void drmtest_exchange_int(void *array, unsigned i, unsigned j)
+{
+	int *int_arr, tmp;
+	int_arr = array;
+
+	tmp = int_arr[i];
+	int_arr[i] = int_arr[j];
+	int_arr[j] = tmp;
+}
+
+void drmtest_permute_array(void *array, unsigned size,
+			   void (*exchange_func)(void *array,
+						 unsigned i,
+						 unsigned j))
+{
+	int i;
+
+	for (i = size - 1; i > 1; i--) {
+		/* yes, not perfectly uniform, who cares */
+		long l = random() % (i +1);
+		if (i != l)
+			exchange_func(array, i, l);
+	}
+}
+
+/* mmap-backed binary progress log.  Appending a record is a couple of
+ * stores into the mapped window, so tests calling drmtest_progress()
+ * from tight loops no longer pay fprintf plus terminal handling per
+ * iteration.  The file grows one window at a time; the header page in
+ * front carries the record count for the decoder. */
+#define PROGRESS_LOG_WINDOW 4096	/* records mapped at a time */
+
+static int progress_log_state;	/* 0 = unchecked, 1 = on, -1 = off */
+static int progress_log_fd = -1;
+static struct drmtest_progress_log_header *progress_log_hdr;
+static struct drmtest_progress_log_record *progress_log_win;
+static uint64_t progress_log_win_base;
+
+static int progress_log_enabled(void)
+{
+	const char *path;
+
+	if (progress_log_state)
+		return progress_log_state > 0;
+
+	progress_log_state = -1;
+
+	path = getenv("DRMTEST_PROGRESS_LOG");
+	if (!path || *path == '\0')
+		return 0;
+
+	progress_log_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (progress_log_fd == -1) {
+		fprintf(stderr, "can't create progress log '%s': %s\n",
+			path, strerror(errno));
+		return 0;
+	}
+
+	if (ftruncate(progress_log_fd, 4096 + PROGRESS_LOG_WINDOW *
+		      sizeof(struct drmtest_progress_log_record)))
+		return 0;
+
+	progress_log_hdr = mmap(NULL, 4096, PROT_READ | PROT_WRITE,
+				MAP_SHARED, progress_log_fd, 0);
+	if (progress_log_hdr == MAP_FAILED)
+		return 0;
+
+	progress_log_win = mmap(NULL, PROGRESS_LOG_WINDOW *
+				sizeof(struct drmtest_progress_log_record),
+				PROT_READ | PROT_WRITE, MAP_SHARED,
+				progress_log_fd, 4096);
+	if (progress_log_win == MAP_FAILED)
+		return 0;
+
+	progress_log_hdr->magic = DRMTEST_PROGRESS_LOG_MAGIC;
+	progress_log_hdr->version = DRMTEST_PROGRESS_LOG_VERSION;
+	progress_log_hdr->num_records = 0;
+
+	progress_log_state = 1;
+	return 1;
+}
+
+static void progress_log_append(const char *header, uint64_t i, uint64_t total)
+{
+	uint64_t idx = progress_log_hdr->num_records;
+	struct drmtest_progress_log_record *rec;
+	struct timeval tv;
+
+	if (idx - progress_log_win_base == PROGRESS_LOG_WINDOW) {
+		size_t win_sz = PROGRESS_LOG_WINDOW *
+			sizeof(struct drmtest_progress_log_record);
+
+		munmap(progress_log_win, win_sz);
+		progress_log_win_base = idx;
+		if (ftruncate(progress_log_fd,
+			      4096 + (idx + PROGRESS_LOG_WINDOW) *
+			      sizeof(struct drmtest_progress_log_record))) {
+			progress_log_state = -1;
+			return;
+		}
+		progress_log_win = mmap(NULL, win_sz,
+					PROT_READ | PROT_WRITE, MAP_SHARED,
+					progress_log_fd, 4096 + idx *
+					sizeof(struct drmtest_progress_log_record));
+		if (progress_log_win == MAP_FAILED) {
+			progress_log_state = -1;
+			return;
+		}
+	}
+
+	rec = &progress_log_win[idx - progress_log_win_base];
+	gettimeofday(&tv, NULL);
+	rec->time_us = tv.tv_sec * 1000000ull + tv.tv_usec;
+	rec->i = i;
+	rec->total = total;
+	strncpy(rec->header, header, sizeof(rec->header) - 1);
+	rec->header[sizeof(rec->header) - 1] = '\0';
+
+	progress_log_hdr->num_records = idx + 1;
+}
+
+static volatile int out_active;
+
+void drmtest_progress(const char *header, uint64_t i, uint64_t total)
+{
+	int divider = 200;
+
+	if (progress_log_enabled()) {
+		progress_log_append(header, i, total);
+		return;
+	}
+
+	/* with the async sink running, queue instead of hitting the
+	 * console from the timed loop */
+	if (out_active) {
+		if (i+1 >= total)
+			drmtest_out_printf("\r%s100%%\n", header);
+		else if (total / divider && i % (total / divider) == 0)
+			drmtest_out_printf("\r%s%3llu%%", header,
+				(long long unsigned) i * 100 / total);
+		return;
+	}
+
+	if (!isatty(fileno(stderr)))
+		return;
+
+	if (i+1 >= total) {
+		fprintf(stderr, "\r%s100%%\n", header);
+		return;
+	}
+
+	if (total / 200 == 0)
+		divider = 1;
+
+	/* only bother updating about every 0.5% */
+	if (i % (total / divider) == 0 || i+1 >= total) {
+		fprintf(stderr, "\r%s%3llu%%", header,
+			(long long unsigned) i * 100 / total);
+	}
+}
+
+
+/* Async output sink.  printf straight to a serial console blocks the
+ * caller for milliseconds, which throttles submission loops enough to
+ * change what a test measures.  Once started, output is formatted
+ * into a bounded ring drained by a writer thread; the producer only
+ * stalls when a full megabyte of output is pending.  The ring is
+ * single-producer (the test's timed loop) - the writer thread is the
+ * sole consumer.  A fatal signal or exit drains whatever is queued
+ * with plain write(), so crashes don't eat the tail of the log. */
+#define OUT_RING_SZ (1 << 20)	/* power of two */
+static char out_ring[OUT_RING_SZ];
+static volatile unsigned out_head, out_tail;
+static volatile int out_active;
+static pthread_t out_thread;
+
+static void out_write_all(const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(STDOUT_FILENO, buf, len);
+
+		if (ret <= 0)
+			return;
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* drain [tail, head); safe from the writer thread and, after the
+ * writer is gone, from exit paths and signal handlers */
+static void out_drain(void)
+{
+	while (out_tail != out_head) {
+		unsigned tail = out_tail;
+		unsigned chunk = out_head - tail;
+		unsigned idx = tail & (OUT_RING_SZ - 1);
+
+		if (chunk > OUT_RING_SZ - idx)
+			chunk = OUT_RING_SZ - idx;
+		out_write_all(out_ring + idx, chunk);
+		__sync_synchronize();
+		out_tail = tail + chunk;
+	}
+}
+
+static void *out_writer(void *arg)
+{
+	while (out_active) {
+		if (out_tail == out_head) {
+			usleep(2000);
+			continue;
+		}
+		out_drain();
+	}
+	out_drain();
+	return NULL;
+}
+
+static void out_crash_handler(int sig)
+{
+	out_active = 0;
+	out_drain();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+void drmtest_out_vprintf(const char *fmt, va_list ap)
+{
+	char buf[512];
+	unsigned idx;
+	int len;
+
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	if (len < 0)
+		return;
+	/* vsnprintf fills at most sizeof(buf) - 1 characters before the
+	 * NUL; clamping to sizeof(buf) would copy the NUL out too */
+	if (len > (int)sizeof(buf) - 1)
+		len = sizeof(buf) - 1;
+
+	if (!out_active) {
+		fwrite(buf, 1, len, stdout);
+		return;
+	}
+
+	/* bounded memory: block only when the ring is full */
+	while (out_head - out_tail + len > OUT_RING_SZ)
+		usleep(1000);
+
+	idx = out_head & (OUT_RING_SZ - 1);
+	if ((unsigned)len > OUT_RING_SZ - idx) {
+		memcpy(out_ring + idx, buf, OUT_RING_SZ - idx);
+		memcpy(out_ring, buf + (OUT_RING_SZ - idx),
+		       len - (OUT_RING_SZ - idx));
+	} else {
+		memcpy(out_ring + idx, buf, len);
+	}
+	__sync_synchronize();
+	out_head += len;
+}
+
+void drmtest_out_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	drmtest_out_vprintf(fmt, ap);
+	va_end(ap);
+}
+
+void drmtest_out_stop(void)
+{
+	if (!out_active)
+		return;
+	out_active = 0;
+	pthread_join(out_thread, NULL);
+	out_drain();
+}
+
+void drmtest_out_start(void)
+{
+	if (out_active)
+		return;
+	/* anything buffered in stdio must land before ring output
+	 * overtakes it */
+	fflush(stdout);
+	out_active = 1;
+	if (pthread_create(&out_thread, NULL, out_writer, NULL)) {
+		out_active = 0;
+		return;
+	}
+	atexit(drmtest_out_stop);
+	signal(SIGSEGV, out_crash_handler);
+	signal(SIGBUS, out_crash_handler);
+	signal(SIGABRT, out_crash_handler);
+}
+
+
+/* Time-budgeted iteration control.  Hardcoded iteration counts make
+ * runtimes swing wildly across generations; a budgeted loop instead
+ * runs whatever number of units fits the wall-clock budget.  The
+ * controller samples the rate early and then only looks at the clock
+ * about every 1/32nd of the budget, so the gettimeofday cost doesn't
+ * distort fast units. */
+
+static double budget_elapsed(const struct drmtest_budget *b)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - b->start.tv_sec) +
+		(now.tv_usec - b->start.tv_usec) / 1e6;
+}
+
+void drmtest_budget_start(struct drmtest_budget *b, const char *name,
+			  double default_secs)
+{
+	const char *env = getenv("DRMTEST_BUDGET");
+
+	memset(b, 0, sizeof(*b));
+	b->name = name;
+	b->budget_secs = env ? atof(env) : default_secs;
+	/* first clock probe after a handful of units calibrates the
+	 * check interval */
+	b->next_check = 8;
+	gettimeofday(&b->start, NULL);
+}
+
+int drmtest_budget_more(struct drmtest_budget *b)
+{
+	double elapsed, rate, left;
+
+	b->done++;
+	if (b->budget_secs <= 0)
+		return 1;
+	if (b->done < b->next_check)
+		return 1;
+
+	elapsed = budget_elapsed(b);
+	if (elapsed >= b->budget_secs)
+		return 0;
+
+	rate = b->done / (elapsed > 1e-6 ? elapsed : 1e-6);
+	left = b->budget_secs - elapsed;
+	if (left > b->budget_secs / 32)
+		left = b->budget_secs / 32;
+	b->next_check = b->done + (uint64_t)(rate * left) + 1;
+
+	return 1;
+}
+
+void drmtest_budget_report(struct drmtest_budget *b)
+{
+	double elapsed = budget_elapsed(b);
+
+	printf("%s: %llu units in %.2fs (%.1f/s)\n",
+	       b->name, (long long unsigned)b->done, elapsed,
+	       b->done / (elapsed > 1e-6 ? elapsed : 1e-6));
+}
+
+
+/* NUMA placement helpers.  On multi-socket machines pwrite/mmap
+ * bandwidth swings by 2x depending on which node backs the pages versus
+ * where the test thread runs, which makes benchmark numbers
+ * unreproducible unless the placement is pinned.  These are thin
+ * wrappers around the raw set_mempolicy()/mbind() syscalls so the
+ * library doesn't grow a libnuma dependency; they apply to the calling
+ * thread's future allocations (and thus to bo pages the kernel
+ * allocates on its behalf) or to an already-mapped range. */
+#define DRMTEST_MPOL_DEFAULT	0
+#define DRMTEST_MPOL_BIND	2
+#define DRMTEST_MPOL_INTERLEAVE	3
+
+int drmtest_numa_num_nodes(void)
+{
+	char path[128];
+	int node = 0;
+
+	for (;;) {
+		struct stat st;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d", node);
+		if (stat(path, &st))
+			break;
+		node++;
+	}
+
+	return node;
+}
+
+static int set_thread_mempolicy(int mode, unsigned long nodemask)
+{
+	unsigned long *maskp = mode == DRMTEST_MPOL_DEFAULT ? NULL : &nodemask;
+
+	return syscall(SYS_set_mempolicy, mode, maskp,
+		       sizeof(nodemask) * 8 + 1);
+}
+
+int drmtest_numa_bind_node(int node)
+{
+	assert(node >= 0 && node < 8 * (int)sizeof(unsigned long));
+	return set_thread_mempolicy(DRMTEST_MPOL_BIND, 1ul << node);
 }
 
-/*
- * Note: Testcases which use these helpers MUST NOT output anything to stdout
- * outside of places protected by drmtest_run_subtest checks - the piglit
- * runner adds every line to the subtest list.
- */
-bool drmtest_run_subtest(const char *subtest_name)
+int drmtest_numa_interleave(void)
 {
-	if (list_subtests) {
-		printf("%s\n", subtest_name);
-		return false;
-	}
+	int nodes = drmtest_numa_num_nodes();
 
-	if (!run_single_subtest) {
-		return true;
-	} else {
-		if (strcmp(subtest_name, run_single_subtest) == 0)
-			return true;
+	if (nodes < 2)
+		return -1;
+	return set_thread_mempolicy(DRMTEST_MPOL_INTERLEAVE,
+				    (1ul << nodes) - 1);
+}
 
-		return false;
-	}
+int drmtest_numa_local(void)
+{
+	return set_thread_mempolicy(DRMTEST_MPOL_DEFAULT, 0);
 }
 
-bool drmtest_only_list_subtests(void)
+int drmtest_numa_bind_pages(void *ptr, size_t size, int node)
 {
-	return list_subtests;
+	unsigned long nodemask = 1ul << node;
+
+	assert(node >= 0 && node < 8 * (int)sizeof(unsigned long));
+	return syscall(SYS_mbind, ptr, size, DRMTEST_MPOL_BIND, &nodemask,
+		       sizeof(nodemask) * 8 + 1, 0);
 }
 
-/* other helpers */
-void drmtest_exchange_int(void *array, unsigned i, unsigned j)
+int drmtest_numa_interleave_pages(void *ptr, size_t size)
 {
-	int *int_arr, tmp;
-	int_arr = array;
+	int nodes = drmtest_numa_num_nodes();
+	unsigned long nodemask;
 
-	tmp = int_arr[i];
-	int_arr[i] = int_arr[j];
-	int_arr[j] = tmp;
+	if (nodes < 2)
+		return -1;
+	nodemask = (1ul << nodes) - 1;
+	return syscall(SYS_mbind, ptr, size, DRMTEST_MPOL_INTERLEAVE,
+		       &nodemask, sizeof(nodemask) * 8 + 1, 0);
 }
 
-void drmtest_permute_array(void *array, unsigned size,
-			   void (*exchange_func)(void *array,
-						 unsigned i,
-						 unsigned j))
+/* mappable aperture trasher helper
+ *
+ * The actual trashing runs on a background worker thread; the callers only
+ * queue requests.  drmtest_trash_aperture() keeps its old synchronous
+ * semantics (on return, a full pass started after the call has finished),
+ * while drmtest_trash_aperture_async() is a cheap trigger for tests which
+ * interleave trashing with timing-sensitive submission and don't want the
+ * pass on their own clock. */
+drm_intel_bo **trash_bos;
+int num_trash_bos;
+
+static pthread_t trash_thread;
+static pthread_mutex_t trash_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trash_request_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t trash_done_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t trash_requested, trash_completed;
+static bool trash_in_progress, trash_stop;
+
+static void trash_aperture_pass(void)
 {
+	uint8_t *gtt_ptr;
 	int i;
 
-	for (i = size - 1; i > 1; i--) {
-		/* yes, not perfectly uniform, who cares */
-		long l = random() % (i +1);
-		if (i != l)
-			exchange_func(array, i, l);
+	for (i = 0; i < num_trash_bos; i++) {
+		drm_intel_gem_bo_map_gtt(trash_bos[i]);
+		gtt_ptr = trash_bos[i]->virtual;
+		*gtt_ptr = 0;
+		drm_intel_gem_bo_unmap_gtt(trash_bos[i]);
 	}
 }
 
-void drmtest_progress(const char *header, uint64_t i, uint64_t total)
+static void *trash_aperture_worker(void *arg)
 {
-	int divider = 200;
+	/* Pre-fill: fault in every trash bo once so the first real trash
+	 * pass doesn't pay the backing storage allocation on the test's
+	 * clock. */
+	trash_aperture_pass();
+
+	pthread_mutex_lock(&trash_lock);
+	for (;;) {
+		while (!trash_stop && trash_completed == trash_requested)
+			pthread_cond_wait(&trash_request_cond, &trash_lock);
+		if (trash_stop)
+			break;
 
-	if (!isatty(fileno(stderr)))
-		return;
+		trash_in_progress = true;
+		pthread_mutex_unlock(&trash_lock);
+		trash_aperture_pass();
+		pthread_mutex_lock(&trash_lock);
+		trash_in_progress = false;
 
-	if (i+1 >= total) {
-		fprintf(stderr, "\r%s100%%\n", header);
-		return;
+		trash_completed++;
+		pthread_cond_broadcast(&trash_done_cond);
 	}
+	pthread_mutex_unlock(&trash_lock);
 
-	if (total / 200 == 0)
-		divider = 1;
-
-	/* only bother updating about every 0.5% */
-	if (i % (total / divider) == 0 || i+1 >= total) {
-		fprintf(stderr, "\r%s%3llu%%", header,
-			(long long unsigned) i * 100 / total);
-	}
+	return NULL;
 }
 
-/* mappable aperture trasher helper */
-drm_intel_bo **trash_bos;
-int num_trash_bos;
-
 void drmtest_init_aperture_trashers(drm_intel_bufmgr *bufmgr)
 {
 	int i;
@@ -636,42 +2378,198 @@ void drmtest_init_aperture_trashers(drm_intel_bufmgr *bufmgr)
 
 	for (i = 0; i < num_trash_bos; i++)
 		trash_bos[i] = drm_intel_bo_alloc(bufmgr, "trash bo", 1024*1024, 4096);
+
+	trash_stop = false;
+	assert(pthread_create(&trash_thread, NULL,
+			      trash_aperture_worker, NULL) == 0);
 }
 
-void drmtest_trash_aperture(void)
+void drmtest_trash_aperture_async(void)
 {
-	int i;
-	uint8_t *gtt_ptr;
+	pthread_mutex_lock(&trash_lock);
+	/* Coalesce with an already pending request. */
+	if (trash_requested == trash_completed + (trash_in_progress ? 1 : 0))
+		trash_requested++;
+	pthread_cond_signal(&trash_request_cond);
+	pthread_mutex_unlock(&trash_lock);
+}
 
-	for (i = 0; i < num_trash_bos; i++) {
-		drm_intel_gem_bo_map_gtt(trash_bos[i]);
-		gtt_ptr = trash_bos[i]->virtual;
-		*gtt_ptr = 0;
-		drm_intel_gem_bo_unmap_gtt(trash_bos[i]);
-	}
+void drmtest_trash_aperture(void)
+{
+	uint64_t target;
+
+	pthread_mutex_lock(&trash_lock);
+	/* A pass already in flight may predate our request, so make sure a
+	 * complete pass starts after this point. */
+	target = trash_completed + (trash_in_progress ? 2 : 1);
+	if (trash_requested < target)
+		trash_requested = target;
+	pthread_cond_signal(&trash_request_cond);
+	while (trash_completed < target)
+		pthread_cond_wait(&trash_done_cond, &trash_lock);
+	pthread_mutex_unlock(&trash_lock);
 }
 
 void drmtest_cleanup_aperture_trashers(void)
 {
 	int i;
 
+	pthread_mutex_lock(&trash_lock);
+	trash_stop = true;
+	pthread_cond_signal(&trash_request_cond);
+	pthread_mutex_unlock(&trash_lock);
+	pthread_join(trash_thread, NULL);
+
 	for (i = 0; i < num_trash_bos; i++)
 		drm_intel_bo_unreference(trash_bos[i]);
 
 	free(trash_bos);
 }
 
+/* Calibrated aperture pressure engine.
+ *
+ * The trashers above are all-or-nothing: a pass touches every bo as fast
+ * as it can.  This engine instead maintains a target evictions/sec by
+ * pacing single-bo touches over the trash bo array.  Whether a touch
+ * actually evicted something is observed without any kernel help: a
+ * touch that had to rebind the bo costs several times the steady-state
+ * map-and-poke, so touches are classified against a running minimum and
+ * the issue rate is scaled by the observed hit fraction every window.
+ * Requires drmtest_init_aperture_trashers() to have run. */
+
+static pthread_t pressure_thread;
+static volatile int pressure_target_rate;
+static volatile bool pressure_stop_flag;
+static uint64_t pressure_touches, pressure_evictions;
+
+#define PRESSURE_WINDOW 64
+
+static double pressure_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+static void *aperture_pressure_worker(void *arg)
+{
+	double min_us = 1e9;
+	double touch_rate = 1.0;
+	int window_touches = 0, window_evictions = 0;
+	int idx = 0;
+
+	while (!pressure_stop_flag) {
+		uint8_t *gtt_ptr;
+		double t0, dt;
+		long long delay;
+		int rate = pressure_target_rate;
+
+		if (rate <= 0) {
+			usleep(10000);
+			continue;
+		}
+
+		t0 = pressure_time_us();
+		drm_intel_gem_bo_map_gtt(trash_bos[idx]);
+		gtt_ptr = trash_bos[idx]->virtual;
+		*gtt_ptr = 0;
+		drm_intel_gem_bo_unmap_gtt(trash_bos[idx]);
+		dt = pressure_time_us() - t0;
+		idx = (idx + 1) % num_trash_bos;
+
+		if (dt < min_us)
+			min_us = dt;
+		window_touches++;
+		/* a rebind is far slower than poking an already bound bo;
+		 * the constant absorbs timer noise on fast machines */
+		if (dt > 4 * min_us + 50) {
+			window_evictions++;
+			__sync_fetch_and_add(&pressure_evictions, 1);
+		}
+		__sync_fetch_and_add(&pressure_touches, 1);
+
+		if (window_touches >= PRESSURE_WINDOW) {
+			double frac = (double)window_evictions /
+				window_touches;
+
+			/* few touches evicting means the aperture has
+			 * room; issue faster to hold the eviction rate */
+			if (frac < 0.02)
+				frac = 0.02;
+			touch_rate = rate / frac;
+			if (touch_rate > 50.0 * rate)
+				touch_rate = 50.0 * rate;
+			window_touches = window_evictions = 0;
+		}
+		if (touch_rate < rate)
+			touch_rate = rate;
+
+		delay = (long long)(1e6 / touch_rate - dt);
+		if (delay > 0)
+			usleep(delay);
+	}
+
+	return NULL;
+}
+
+void drmtest_start_aperture_pressure(int evictions_per_sec)
+{
+	assert(trash_bos);
+
+	pressure_target_rate = evictions_per_sec;
+	pressure_stop_flag = false;
+	pressure_touches = pressure_evictions = 0;
+	assert(pthread_create(&pressure_thread, NULL,
+			      aperture_pressure_worker, NULL) == 0);
+}
+
+void drmtest_set_aperture_pressure(int evictions_per_sec)
+{
+	pressure_target_rate = evictions_per_sec;
+}
+
+void drmtest_aperture_pressure_stats(uint64_t *touches, uint64_t *evictions)
+{
+	if (touches)
+		*touches = pressure_touches;
+	if (evictions)
+		*evictions = pressure_evictions;
+}
+
+void drmtest_stop_aperture_pressure(void)
+{
+	pressure_stop_flag = true;
+	pthread_join(pressure_thread, NULL);
+}
+
 /* helpers to create nice-looking framebuffers */
-static cairo_surface_t *
-paint_allocate_surface(int fd, int width, int height, int depth, int bpp,
-		       bool tiled,
-		       struct kmstest_fb *fb_info)
+static cairo_format_t
+paint_format_for_depth(int depth)
+{
+	switch (depth) {
+	case 16:
+		return CAIRO_FORMAT_RGB16_565;
+	case 24:
+		return CAIRO_FORMAT_RGB24;
+#if 0
+	case 30:
+		return CAIRO_FORMAT_RGB30;
+#endif
+	case 32:
+		return CAIRO_FORMAT_ARGB32;
+	default:
+		return CAIRO_FORMAT_INVALID;
+	}
+}
+
+static bool
+fb_allocate_bo(int fd, int width, int height, int bpp, bool tiled,
+	       struct kmstest_fb *fb_info)
 {
-	cairo_format_t format;
 	struct drm_i915_gem_set_tiling set_tiling;
-	int size;
 	unsigned stride;
-	uint32_t *fb_ptr;
+	int size;
 
 	if (tiled) {
 		int v;
@@ -697,28 +2595,6 @@ paint_allocate_surface(int fd, int width, int height, int depth, int bpp,
 		size = stride * height;
 	}
 
-	switch (depth) {
-	case 16:
-		format = CAIRO_FORMAT_RGB16_565;
-		break;
-	case 24:
-		format = CAIRO_FORMAT_RGB24;
-		break;
-#if 0
-	case 30:
-		format = CAIRO_FORMAT_RGB30;
-		break;
-#endif
-	case 32:
-		format = CAIRO_FORMAT_ARGB32;
-		break;
-	default:
-		fprintf(stderr, "bad depth %d\n", depth);
-		return NULL;
-	}
-
-	assert (bpp >= depth);
-
 	fb_info->gem_handle = gem_create(fd, size);
 
 	if (tiled) {
@@ -728,18 +2604,41 @@ paint_allocate_surface(int fd, int width, int height, int depth, int bpp,
 		if (ioctl(fd, DRM_IOCTL_I915_GEM_SET_TILING, &set_tiling)) {
 			fprintf(stderr, "set tiling failed: %s (stride=%d, size=%d)\n",
 				strerror(errno), stride, size);
-			return NULL;
+			return false;
 		}
 	}
 
-	fb_ptr = gem_mmap(fd, fb_info->gem_handle, size, PROT_READ | PROT_WRITE);
-
 	fb_info->stride = stride;
 	fb_info->size = size;
 
+	return true;
+}
+
+static cairo_surface_t *
+paint_allocate_surface(int fd, int width, int height, int depth, int bpp,
+		       bool tiled,
+		       struct kmstest_fb *fb_info)
+{
+	cairo_format_t format;
+	uint32_t *fb_ptr;
+
+	format = paint_format_for_depth(depth);
+	if (format == CAIRO_FORMAT_INVALID) {
+		fprintf(stderr, "bad depth %d\n", depth);
+		return NULL;
+	}
+
+	assert (bpp >= depth);
+
+	if (!fb_allocate_bo(fd, width, height, bpp, tiled, fb_info))
+		return NULL;
+
+	fb_ptr = gem_mmap(fd, fb_info->gem_handle, fb_info->size,
+			  PROT_READ | PROT_WRITE);
+
 	return cairo_image_surface_create_for_data((unsigned char *)fb_ptr,
 						   format, width, height,
-						   stride);
+						   fb_info->stride);
 }
 
 static void
@@ -781,6 +2680,116 @@ paint_test_patterns(cairo_t *cr, int width, int height)
 	paint_color_gradient(cr, x, y, gr_width, gr_height, 1, 1, 1);
 }
 
+/* Mode-cycling tests create one fb per mode and the standard test
+ * pattern is fully determined by the fb geometry, so rasterizing it
+ * through cairo more than once per geometry is wasted time.  Keep the
+ * most recently painted patterns around (rows packed, so the cache is
+ * stride-agnostic) and blit them into new fbs on a key match. */
+struct pattern_cache {
+	int width, height;
+	int depth, bpp;
+	unsigned char *pixels;
+	struct pattern_cache *next;
+};
+
+static struct pattern_cache *pattern_cache_list;
+static int pattern_cache_count;
+
+#define PATTERN_CACHE_MAX 8
+
+static struct pattern_cache *
+pattern_cache_lookup(int width, int height, int depth, int bpp)
+{
+	struct pattern_cache *entry, **prev;
+
+	for (prev = &pattern_cache_list; (entry = *prev); prev = &entry->next) {
+		if (entry->width != width || entry->height != height ||
+		    entry->depth != depth || entry->bpp != bpp)
+			continue;
+
+		/* move to front so the eviction order stays LRU */
+		*prev = entry->next;
+		entry->next = pattern_cache_list;
+		pattern_cache_list = entry;
+		return entry;
+	}
+
+	return NULL;
+}
+
+static bool
+pattern_cache_apply(cairo_surface_t *surface,
+		    int width, int height, int depth, int bpp)
+{
+	struct pattern_cache *entry;
+	unsigned char *data;
+	int stride, row_bytes, y;
+
+	entry = pattern_cache_lookup(width, height, depth, bpp);
+	if (entry == NULL)
+		return false;
+
+	cairo_surface_flush(surface);
+	data = cairo_image_surface_get_data(surface);
+	stride = cairo_image_surface_get_stride(surface);
+	row_bytes = width * (bpp / 8);
+
+	for (y = 0; y < height; y++)
+		memcpy(data + y * stride,
+		       entry->pixels + y * row_bytes, row_bytes);
+	cairo_surface_mark_dirty(surface);
+
+	return true;
+}
+
+static void
+pattern_cache_insert(cairo_surface_t *surface,
+		     int width, int height, int depth, int bpp)
+{
+	struct pattern_cache *entry, **prev;
+	unsigned char *data;
+	int stride, row_bytes, y, count;
+
+	entry = malloc(sizeof(*entry));
+	if (entry == NULL)
+		return;
+	row_bytes = width * (bpp / 8);
+	entry->pixels = malloc(row_bytes * height);
+	if (entry->pixels == NULL) {
+		free(entry);
+		return;
+	}
+
+	cairo_surface_flush(surface);
+	data = cairo_image_surface_get_data(surface);
+	stride = cairo_image_surface_get_stride(surface);
+	for (y = 0; y < height; y++)
+		memcpy(entry->pixels + y * row_bytes,
+		       data + y * stride, row_bytes);
+
+	entry->width = width;
+	entry->height = height;
+	entry->depth = depth;
+	entry->bpp = bpp;
+	entry->next = pattern_cache_list;
+	pattern_cache_list = entry;
+
+	if (++pattern_cache_count <= PATTERN_CACHE_MAX)
+		return;
+
+	/* drop the least recently used tail entry */
+	count = 1;
+	for (prev = &pattern_cache_list; (entry = *prev); prev = &entry->next) {
+		if (count++ <= PATTERN_CACHE_MAX)
+			continue;
+		*prev = entry->next;
+		free(entry->pixels);
+		free(entry);
+		pattern_cache_count--;
+		break;
+	}
+}
+
 enum corner {
 	topleft,
 	topright,
@@ -842,37 +2851,157 @@ paint_marker(cairo_t *cr, int x, int y, char *str, enum corner text_location)
 	cairo_fill(cr);
 }
 
+/*
+ * Recycled framebuffers.
+ *
+ * A released POOLED fb keeps its AddFB id and bo and goes on a small
+ * free list; the next create with matching geometry pops it and skips
+ * allocator, set-tiling and AddFB entirely.  Entries past the cap are
+ * destroyed oldest-first.
+ */
+#define FB_POOL_MAX 16
+
+struct fb_pool_entry {
+	struct kmstest_fb fb;
+	struct fb_pool_entry *next;
+};
+
+static struct fb_pool_entry *fb_pool;
+static int fb_pool_count;
+
+static void fb_destroy(int fd, struct kmstest_fb *fb_info)
+{
+	do_or_die(drmModeRmFB(fd, fb_info->fb_id));
+	gem_close(fd, fb_info->gem_handle);
+}
+
+static bool fb_pool_get(int width, int height, int bpp, int depth,
+			unsigned flags, struct kmstest_fb *fb_info)
+{
+	struct fb_pool_entry **prev, *entry;
+
+	for (prev = &fb_pool; (entry = *prev); prev = &entry->next) {
+		if (entry->fb.width == width &&
+		    entry->fb.height == height &&
+		    entry->fb.bpp == bpp &&
+		    entry->fb.depth == depth &&
+		    (entry->fb.flags & KMSTEST_FB_TILED) ==
+		    (flags & KMSTEST_FB_TILED)) {
+			*fb_info = entry->fb;
+			*prev = entry->next;
+			free(entry);
+			fb_pool_count--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void kmstest_release_fb(int fd, struct kmstest_fb *fb_info)
+{
+	struct fb_pool_entry *entry;
+
+	if (!(fb_info->flags & KMSTEST_FB_POOLED)) {
+		fb_destroy(fd, fb_info);
+		return;
+	}
+
+	entry = malloc(sizeof(*entry));
+	assert(entry);
+	entry->fb = *fb_info;
+	entry->next = fb_pool;
+	fb_pool = entry;
+
+	if (++fb_pool_count > FB_POOL_MAX) {
+		struct fb_pool_entry **prev = &fb_pool;
+
+		while ((*prev)->next)
+			prev = &(*prev)->next;
+		fb_destroy(fd, &(*prev)->fb);
+		free(*prev);
+		*prev = NULL;
+		fb_pool_count--;
+	}
+}
+
 unsigned int kmstest_create_fb(int fd, int width, int height, int bpp,
-			       int depth, bool tiled,
+			       int depth, unsigned flags,
 			       struct kmstest_fb *fb_info,
 			       kmstest_paint_func paint_func,
 			       void *func_arg)
 {
+	bool tiled = flags & KMSTEST_FB_TILED;
 	cairo_surface_t *surface;
 	cairo_status_t status;
 	cairo_t *cr;
 	char buf[128];
 	unsigned int fb_id;
 
+	if ((flags & KMSTEST_FB_POOLED) &&
+	    fb_pool_get(width, height, bpp, depth, flags, fb_info)) {
+		fb_info->flags = flags;
+		/* recycled contents are whatever the last user drew */
+		if (paint_func && !(flags & KMSTEST_FB_NO_PAINT))
+			kmstest_repaint_fb_region(fd, fb_info, 0, 0,
+						  width, height,
+						  paint_func, func_arg);
+		return fb_info->fb_id;
+	}
+
+	fb_info->width = width;
+	fb_info->height = height;
+	fb_info->depth = depth;
+	fb_info->bpp = bpp;
+	fb_info->flags = flags;
+
+	if (flags & KMSTEST_FB_NO_PAINT) {
+		/* bare scan-out bo: no cairo, no pattern */
+		assert(fb_allocate_bo(fd, width, height, bpp, tiled,
+				      fb_info));
+
+		if (flags & KMSTEST_FB_PREFAULT) {
+			void *ptr = gem_mmap(fd, fb_info->gem_handle,
+					     fb_info->size,
+					     PROT_READ | PROT_WRITE);
+
+			assert(ptr);
+			gem_mmap_prefault(ptr, fb_info->size);
+			munmap(ptr, fb_info->size);
+		}
+
+		do_or_die(drmModeAddFB(fd, width, height, depth, bpp,
+				       fb_info->stride,
+				       fb_info->gem_handle, &fb_id));
+		fb_info->fb_id = fb_id;
+
+		return fb_id;
+	}
+
 	surface = paint_allocate_surface(fd, width, height, depth, bpp,
 					 tiled, fb_info);
 	assert(surface);
 
 	cr = cairo_create(surface);
 
-	paint_test_patterns(cr, width, height);
-
 	cairo_set_line_cap(cr, CAIRO_LINE_CAP_SQUARE);
 
-	/* Paint corner markers */
-	snprintf(buf, sizeof buf, "(%d, %d)", 0, 0);
-	paint_marker(cr, 0, 0, buf, bottomright);
-	snprintf(buf, sizeof buf, "(%d, %d)", width, 0);
-	paint_marker(cr, width, 0, buf, bottomleft);
-	snprintf(buf, sizeof buf, "(%d, %d)", 0, height);
-	paint_marker(cr, 0, height, buf, topright);
-	snprintf(buf, sizeof buf, "(%d, %d)", width, height);
-	paint_marker(cr, width, height, buf, topleft);
+	if (!pattern_cache_apply(surface, width, height, depth, bpp)) {
+		paint_test_patterns(cr, width, height);
+
+		/* Paint corner markers */
+		snprintf(buf, sizeof buf, "(%d, %d)", 0, 0);
+		paint_marker(cr, 0, 0, buf, bottomright);
+		snprintf(buf, sizeof buf, "(%d, %d)", width, 0);
+		paint_marker(cr, width, 0, buf, bottomleft);
+		snprintf(buf, sizeof buf, "(%d, %d)", 0, height);
+		paint_marker(cr, 0, height, buf, topright);
+		snprintf(buf, sizeof buf, "(%d, %d)", width, height);
+		paint_marker(cr, width, height, buf, topleft);
+
+		/* snapshot before any caller drawing lands on top */
+		pattern_cache_insert(surface, width, height, depth, bpp);
+	}
 
 	if (paint_func)
 		paint_func(cr, width, height, func_arg);
@@ -892,6 +3021,40 @@ unsigned int kmstest_create_fb(int fd, int width, int height, int bpp,
 	return fb_id;
 }
 
+/* Redraw only the given rectangle of an already-created fb.  The paint
+ * function sees the usual full-size cairo context but clipped to the
+ * dirty region, so callers animating a small area don't pay for a
+ * full-screen rasterization per update. */
+void kmstest_repaint_fb_region(int fd, struct kmstest_fb *fb_info,
+			       int x, int y, int width, int height,
+			       kmstest_paint_func paint_func, void *func_arg)
+{
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	void *fb_ptr;
+
+	fb_ptr = gem_mmap(fd, fb_info->gem_handle, fb_info->size,
+			  PROT_READ | PROT_WRITE);
+	assert(fb_ptr);
+
+	surface = cairo_image_surface_create_for_data(fb_ptr,
+				paint_format_for_depth(fb_info->depth),
+				fb_info->width, fb_info->height,
+				fb_info->stride);
+	cr = cairo_create(surface);
+
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_SQUARE);
+	cairo_rectangle(cr, x, y, width, height);
+	cairo_clip(cr);
+
+	paint_func(cr, fb_info->width, fb_info->height, func_arg);
+
+	assert(!cairo_status(cr));
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+	munmap(fb_ptr, fb_info->size);
+}
+
 void kmstest_remove_fb(int fd, int fb_id)
 {
 	do_or_die(drmModeRmFB(fd, fb_id));
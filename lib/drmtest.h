@@ -30,7 +30,9 @@
 #include <unistd.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <sys/time.h>
 #include <cairo.h>
 
 #include "xf86drm.h"
@@ -41,8 +43,11 @@ drm_intel_bo * gem_handle_to_libdrm_bo(drm_intel_bufmgr *bufmgr, int fd,
 				       const char *name, uint32_t handle);
 
 int drm_get_card(int master);
+int drm_get_cards(int *cards, int max);
 int drm_open_any(void);
 int drm_open_any_master(void);
+int drm_open_card(int card);
+int drm_open_card_fds(int card, int *fds, int count);
 
 void gem_quiescent_gpu(int fd);
 
@@ -57,11 +62,59 @@ void gem_read(int fd, uint32_t handle, uint32_t offset, void *buf, uint32_t size
 void gem_set_domain(int fd, uint32_t handle,
 		    uint32_t read_domains, uint32_t write_domain);
 void gem_sync(int fd, uint32_t handle);
+
+enum gem_wait_strategy {
+	GEM_WAIT_BLOCK,		/* gem_sync()'s SET_DOMAIN round trip */
+	GEM_WAIT_SPIN,		/* busy-poll the busy ioctl */
+	GEM_WAIT_SPIN_YIELD,	/* spin briefly, then yield between polls */
+	GEM_WAIT_TIMED,		/* timed wait ioctl, blocking fallback */
+};
+int gem_wait_for_bo(int fd, uint32_t handle, enum gem_wait_strategy strategy);
 uint32_t gem_create(int fd, int size);
+void gem_create_bulk(int fd, int size, uint32_t *handles, int count);
+void gem_close_bulk(int fd, uint32_t *handles, int count);
+
+/* Failure-tolerant allocation for pressure tests.
+ *
+ * gem_create() and friends abort on failure, which kills a test at
+ * exactly the point it set out to measure.  The gem_try_* variants
+ * return 0/NULL instead and, under GEM_RETRY_BACKOFF, first retry
+ * transient denials (ENOMEM/EAGAIN/ENOSPC) with exponential sleeps so
+ * the kernel's shrinker gets a chance to make room.  Counters record
+ * how hard the edge was fought. */
+enum gem_retry_policy {
+	GEM_RETRY_NONE,		/* single attempt, report failure */
+	GEM_RETRY_BACKOFF,	/* sleep-and-retry, doubling up to 256ms */
+};
+
+struct gem_retry_stats {
+	unsigned long attempts;
+	unsigned long denied;	/* attempts refused for lack of resources */
+	unsigned long retries;
+	unsigned long gave_up;	/* calls failed even after the policy */
+	uint64_t slept_us;	/* total backoff time */
+};
+
+void gem_retry_set_policy(enum gem_retry_policy policy, int max_retries);
+void gem_retry_get_stats(struct gem_retry_stats *stats);
+void gem_retry_reset_stats(void);
+
+uint32_t gem_try_create(int fd, int size);
+void *gem_try_mmap__gtt(int fd, uint32_t handle, int size, int prot);
+void *gem_try_mmap__cpu(int fd, uint32_t handle, int size, int prot);
 
 void *gem_mmap__gtt(int fd, uint32_t handle, int size, int prot);
 void *gem_mmap__cpu(int fd, uint32_t handle, int size, int prot);
 #define gem_mmap gem_mmap__gtt
+void gem_mmap_prefault(void *ptr, int size);
+uint64_t gem_fault_count(void);
+
+/* Opt-in MRU cache of live mappings with deferred unmap; see drmtest.c.
+ * Flush before a cached handle can be reused for a new bo. */
+void *gem_mmap_cached__gtt(int fd, uint32_t handle, int size, int prot);
+void *gem_mmap_cached__cpu(int fd, uint32_t handle, int size, int prot);
+void gem_munmap_cached(void *ptr, int size);
+void gem_mmap_cache_flush(void);
 
 uint64_t gem_aperture_size(int fd);
 uint64_t gem_mappable_aperture_size(void);
@@ -76,42 +129,209 @@ int prime_handle_to_fd(int fd, uint32_t handle);
 uint32_t prime_fd_to_handle(int fd, int dma_buf_fd);
 
 /* generally useful helpers */
+/* background interference: N forked helpers at rate_hz events/sec each */
+enum drmtest_interference {
+	INTERFERENCE_SIGNAL,
+	INTERFERENCE_CPU,
+	INTERFERENCE_MEMORY,
+	INTERFERENCE_MIGRATE,
+};
+int drmtest_fork_interference(enum drmtest_interference type,
+			      int num_helpers, unsigned rate_hz);
+void drmtest_stop_interference(void);
 void drmtest_fork_signal_helper(void);
 void drmtest_stop_signal_helper(void);
+
+/* Pre-forked worker pool: the children are forked once, ideally before
+ * the test maps its large working set, then work is dispatched over a
+ * pipe instead of paying fork+drm-reopen (and the copy-on-write storm
+ * that follows a fork with gigabytes mapped) per task.  Each worker
+ * loops reading a 64-bit task argument, runs the callback and reports
+ * its return value back; with own_fd the worker opens its own drm fd
+ * after the fork, otherwise the callback sees fd -1 and uses whatever
+ * the test captured before init.  The pool survives across subtests;
+ * drmtest_pool_wait() drains outstanding tasks and returns the failure
+ * count so far, drmtest_pool_fini() retires the children. */
+#define DRMTEST_POOL_MAX_WORKERS 16
+
+typedef int (*drmtest_pool_fn)(int fd, int worker, uint64_t arg);
+
+struct drmtest_pool_worker {
+	pid_t pid;
+	int task_fd;
+	int done_fd;
+	int busy;
+};
+
+struct drmtest_pool {
+	int num_workers;
+	int failures;
+	struct drmtest_pool_worker workers[DRMTEST_POOL_MAX_WORKERS];
+};
+
+int drmtest_pool_init(struct drmtest_pool *pool, int num_workers,
+		      drmtest_pool_fn fn, bool own_fd);
+int drmtest_pool_dispatch(struct drmtest_pool *pool, uint64_t arg);
+int drmtest_pool_wait(struct drmtest_pool *pool);
+int drmtest_pool_fini(struct drmtest_pool *pool);
+
+/* Cross-process futex rendezvous.  waitpid/pipe handshakes leave
+ * millisecond start skew between forked workers, which is useless for
+ * provoking same-microsecond concurrent access.  Create the barrier
+ * before forking (it lives in a shared anonymous page), have all nproc
+ * processes call wait - they block until the last arrives and are then
+ * released by one futex broadcast.  skew_us reports max-min release
+ * timestamp over the most recent release (query it once the waiters
+ * are known to have passed, e.g. after reaping them).  The barrier is
+ * reusable for repeated rounds. */
+struct drmtest_rendezvous;
+
+struct drmtest_rendezvous *drmtest_rendezvous_create(int nproc);
+void drmtest_rendezvous_wait(struct drmtest_rendezvous *r);
+long long drmtest_rendezvous_skew_us(struct drmtest_rendezvous *r);
+void drmtest_rendezvous_destroy(struct drmtest_rendezvous *r);
 void drmtest_exchange_int(void *array, unsigned i, unsigned j);
 void drmtest_permute_array(void *array, unsigned size,
 			   void (*exchange_func)(void *array,
 						 unsigned i,
 						 unsigned j));
 void drmtest_progress(const char *header, uint64_t i, uint64_t total);
+
+/* Async output sink: after drmtest_out_start(), drmtest_out_printf()
+ * formats into a bounded ring drained by a writer thread, so output
+ * never stalls a timed loop on a slow console.  Single producer;
+ * drmtest_progress routes through the sink (onto stdout) while it is
+ * active.  Exit and fatal signals drain the queue. */
+void drmtest_out_start(void);
+void drmtest_out_stop(void);
+void drmtest_out_printf(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+void drmtest_out_vprintf(const char *fmt, va_list ap);
+
+/* Time-budgeted iteration control: declare a wall-clock budget, then
+ * loop while drmtest_budget_more() says there's time left.  A budget
+ * of 0 disables the cap (the controller still counts and can report
+ * the achieved rate); DRMTEST_BUDGET=<secs> in the environment
+ * overrides the declared budget, so CI can stretch every budgeted
+ * loop to its time slot without per-test tuning. */
+struct drmtest_budget {
+	const char *name;
+	double budget_secs;
+	struct timeval start;
+	uint64_t done;
+	uint64_t next_check;
+};
+
+void drmtest_budget_start(struct drmtest_budget *b, const char *name,
+			  double default_secs);
+int drmtest_budget_more(struct drmtest_budget *b);
+void drmtest_budget_report(struct drmtest_budget *b);
+
+/* NUMA placement control for reproducible bandwidth numbers; all return
+ * 0 on success, -1 when the machine or kernel can't do it. */
+int drmtest_numa_num_nodes(void);
+int drmtest_numa_bind_node(int node);
+int drmtest_numa_interleave(void);
+int drmtest_numa_local(void);
+int drmtest_numa_bind_pages(void *ptr, size_t size, int node);
+int drmtest_numa_interleave_pages(void *ptr, size_t size);
+
+/* Binary progress log, written instead of terminal output when
+ * DRMTEST_PROGRESS_LOG names a file.  Fixed-size records are appended
+ * through an mmap'd window with no formatting in the hot path; use
+ * intel_progress_decode to pretty-print the result. */
+#define DRMTEST_PROGRESS_LOG_MAGIC	0x50524f47 /* 'PROG' */
+#define DRMTEST_PROGRESS_LOG_VERSION	1
+
+struct drmtest_progress_log_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t num_records;
+};
+
+struct drmtest_progress_log_record {
+	uint64_t time_us;
+	uint64_t i;
+	uint64_t total;
+	char header[40];
+};
 void drmtest_subtest_init(int argc, char **argv);
 bool drmtest_run_subtest(const char *subtest_name);
 bool drmtest_only_list_subtests(void);
 
+/* Lazy common fixture.  The getters open the device, create the bufmgr
+ * and allocate the batch on first call only and hand back the same
+ * instance afterwards, so --list-subtests sweeps and skip-heavy runs
+ * never pay for device setup.  Set DRMTEST_STARTUP_REPORT for a
+ * stderr trace of when each piece was brought up relative to process
+ * start. */
+int drmtest_fixture_fd(void);
+uint32_t drmtest_fixture_devid(void);
+drm_intel_bufmgr *drmtest_fixture_bufmgr(void);
+struct intel_batchbuffer *drmtest_fixture_batch(void);
+void drmtest_fixture_fini(void);
+
 /* helpers based upon the libdrm buffer manager */
 void drmtest_init_aperture_trashers(drm_intel_bufmgr *bufmgr);
 void drmtest_trash_aperture(void);
+void drmtest_trash_aperture_async(void);
 void drmtest_cleanup_aperture_trashers(void);
 
+/* paced background eviction pressure over the trash bos; needs
+ * drmtest_init_aperture_trashers() first */
+void drmtest_start_aperture_pressure(int evictions_per_sec);
+void drmtest_set_aperture_pressure(int evictions_per_sec);
+void drmtest_aperture_pressure_stats(uint64_t *touches, uint64_t *evictions);
+void drmtest_stop_aperture_pressure(void);
+
 /* helpers to create nice-looking framebuffers */
 struct kmstest_fb {
 	uint32_t fb_id;
 	uint32_t gem_handle;
 	unsigned stride;
 	unsigned size;
+	int width, height;
+	int depth, bpp;
+	unsigned flags;
 };
 
 typedef void (*kmstest_paint_func)(cairo_t *cr, int width, int height, void *priv);
 
+/* Allocation policy flags.  KMSTEST_FB_TILED is bit 0 on purpose: the
+ * old bool tiled argument still works unchanged.  NO_PAINT skips the
+ * cairo attachment and test pattern entirely, PREFAULT touches every
+ * page of a NO_PAINT fb so the first flip doesn't eat the faults, and
+ * POOLED recycles fb id and bo through kmstest_release_fb() instead of
+ * destroying them - flip benchmarks churning hundreds of fbs then only
+ * pay for the flips. */
+#define KMSTEST_FB_TILED	(1 << 0)
+#define KMSTEST_FB_NO_PAINT	(1 << 1)
+#define KMSTEST_FB_PREFAULT	(1 << 2)
+#define KMSTEST_FB_POOLED	(1 << 3)
+
+/* the standard test pattern is cached per fb geometry, so cycling
+ * through modes repaints each pattern at most once */
 unsigned int kmstest_create_fb(int fd, int width, int height, int bpp,
-			       int depth, bool tiled,
+			       int depth, unsigned flags,
 			       struct kmstest_fb *fb_info,
 			       kmstest_paint_func paint_func,
 			       void *func_arg);
+/* destroy, or park in the pool when the fb was created POOLED */
+void kmstest_release_fb(int fd, struct kmstest_fb *fb_info);
+void kmstest_repaint_fb_region(int fd, struct kmstest_fb *fb_info,
+			       int x, int y, int width, int height,
+			       kmstest_paint_func paint_func,
+			       void *func_arg);
 void kmstest_remove_fb(int fd, int fb_id);
 void kmstest_dump_mode(drmModeModeInfo *mode);
 int kmstest_get_pipe_from_crtc_id(int fd, int crtc_id);
 
+/* Snapshot i915_error_state into a compressed per-test spool file via a
+ * detached child, without blocking the (usually dying) caller; see
+ * drmtest.c.  Called automatically from do_or_die; hang paths in tests
+ * should call it by hand with a descriptive reason. */
+void drmtest_spool_error_state(const char *reason);
+
 inline static void _do_or_die(const char *function, int line, int ret)
 {
 	if (ret == 0)
@@ -119,6 +339,7 @@ inline static void _do_or_die(const char *function, int line, int ret)
 
 	fprintf(stderr, "%s:%d failed, ret=%d, errno=%d\n",
 		function, line, ret, errno);
+	drmtest_spool_error_state(function);
 	abort();
 }
 #define do_or_die(x) _do_or_die(__FUNCTION__, __LINE__, x)
@@ -31,328 +31,327 @@
 #include "intel_chipset.h"
 #include "intel_reg.h"
 
-struct instdone_bit instdone_bits[MAX_INSTDONE_BITS];
-int num_instdone_bits = 0;
+/* The bit lists are fixed per generation, so build them as static
+ * tables and just point at the right one for the devid.  Indices are
+ * stable for the lifetime of the process and there is no construction
+ * work at startup, which matters for tools spawned on demand when an
+ * incident is already in progress.
+ *
+ * The INST_DONE_1 unit lists are shared between several generations,
+ * hence the table fragments as macros.
+ */
 
-static void
-add_instdone_bit(uint32_t reg, uint32_t bit, const char *name)
-{
-	instdone_bits[num_instdone_bits].reg = reg;
-	instdone_bits[num_instdone_bits].bit = bit;
-	instdone_bits[num_instdone_bits].name = name;
-	num_instdone_bits++;
-}
+#define GEN3_BIT(bit, name)	{ INST_DONE, bit, name }
+#define GEN4_BIT(bit, name)	{ INST_DONE_I965, bit, name }
+#define GEN4_BIT1(bit, name)	{ INST_DONE_1, bit, name }
+#define GEN6_BIT1(bit, name)	{ GEN6_INSTDONE_1, bit, name }
+#define GEN6_BIT2(bit, name)	{ GEN6_INSTDONE_2, bit, name }
 
-static void
-gen3_instdone_bit(uint32_t bit, const char *name)
-{
-	add_instdone_bit(INST_DONE, bit, name);
-}
+#define G965_INSTDONE1_BITS \
+	GEN4_BIT1(I965_GW_CS_DONE_CR, "GW CS CR"), \
+	GEN4_BIT1(I965_SVSM_CS_DONE_CR, "SVSM CS CR"), \
+	GEN4_BIT1(I965_SVDW_CS_DONE_CR, "SVDW CS CR"), \
+	GEN4_BIT1(I965_SVDR_CS_DONE_CR, "SVDR CS CR"), \
+	GEN4_BIT1(I965_SVRW_CS_DONE_CR, "SVRW CS CR"), \
+	GEN4_BIT1(I965_SVRR_CS_DONE_CR, "SVRR CS CR"), \
+	GEN4_BIT1(I965_SVTW_CS_DONE_CR, "SVTW CS CR"), \
+	GEN4_BIT1(I965_MASM_CS_DONE_CR, "MASM CS CR"), \
+	GEN4_BIT1(I965_MASF_CS_DONE_CR, "MASF CS CR"), \
+	GEN4_BIT1(I965_MAW_CS_DONE_CR, "MAW CS CR"), \
+	GEN4_BIT1(I965_EM1_CS_DONE_CR, "EM1 CS CR"), \
+	GEN4_BIT1(I965_EM0_CS_DONE_CR, "EM0 CS CR"), \
+	GEN4_BIT1(I965_UC1_CS_DONE, "UC1 CS"), \
+	GEN4_BIT1(I965_UC0_CS_DONE, "UC0 CS"), \
+	GEN4_BIT1(I965_URB_CS_DONE, "URB CS"), \
+	GEN4_BIT1(I965_ISC_CS_DONE, "ISC CS"), \
+	GEN4_BIT1(I965_CL_CS_DONE, "CL CS"), \
+	GEN4_BIT1(I965_GS_CS_DONE, "GS CS"), \
+	GEN4_BIT1(I965_VS0_CS_DONE, "VS0 CS"), \
+	GEN4_BIT1(I965_VF_CS_DONE, "VF CS")
 
-static void
-gen4_instdone_bit(uint32_t bit, const char *name)
-{
-	add_instdone_bit(INST_DONE_I965, bit, name);
-}
+#define G4X_INSTDONE1_BITS \
+	GEN4_BIT1(G4X_BCS_DONE, "BCS"), \
+	GEN4_BIT1(G4X_CS_DONE, "CS"), \
+	GEN4_BIT1(G4X_MASF_DONE, "MASF"), \
+	GEN4_BIT1(G4X_SVDW_DONE, "SVDW"), \
+	GEN4_BIT1(G4X_SVDR_DONE, "SVDR"), \
+	GEN4_BIT1(G4X_SVRW_DONE, "SVRW"), \
+	GEN4_BIT1(G4X_SVRR_DONE, "SVRR"), \
+	GEN4_BIT1(G4X_ISC_DONE, "ISC"), \
+	GEN4_BIT1(G4X_MT_DONE, "MT"), \
+	GEN4_BIT1(G4X_RC_DONE, "RC"), \
+	GEN4_BIT1(G4X_DAP_DONE, "DAP"), \
+	GEN4_BIT1(G4X_MAWB_DONE, "MAWB"), \
+	GEN4_BIT1(G4X_MT_IDLE, "MT idle"), \
+	/* GEN4_BIT1(G4X_GBLT_BUSY, "GBLT"), */ \
+	GEN4_BIT1(G4X_SVSM_DONE, "SVSM"), \
+	GEN4_BIT1(G4X_MASM_DONE, "MASM"), \
+	GEN4_BIT1(G4X_QC_DONE, "QC"), \
+	GEN4_BIT1(G4X_FL_DONE, "FL"), \
+	GEN4_BIT1(G4X_SC_DONE, "SC"), \
+	GEN4_BIT1(G4X_DM_DONE, "DM"), \
+	GEN4_BIT1(G4X_FT_DONE, "FT"), \
+	GEN4_BIT1(G4X_DG_DONE, "DG"), \
+	GEN4_BIT1(G4X_SI_DONE, "SI"), \
+	GEN4_BIT1(G4X_SO_DONE, "SO"), \
+	GEN4_BIT1(G4X_PL_DONE, "PL"), \
+	GEN4_BIT1(G4X_WIZ_DONE, "WIZ"), \
+	GEN4_BIT1(G4X_URB_DONE, "URB"), \
+	GEN4_BIT1(G4X_SF_DONE, "SF"), \
+	GEN4_BIT1(G4X_CL_DONE, "CL"), \
+	GEN4_BIT1(G4X_GS_DONE, "GS"), \
+	GEN4_BIT1(G4X_VS0_DONE, "VS0"), \
+	GEN4_BIT1(G4X_VF_DONE, "VF")
 
-static void
-gen4_instdone1_bit(uint32_t bit, const char *name)
-{
-	add_instdone_bit(INST_DONE_1, bit, name);
-}
+#define GEN4_INSTDONE_BITS \
+	GEN4_BIT(I965_ROW_0_EU_0_DONE, "Row 0, EU 0"), \
+	GEN4_BIT(I965_ROW_0_EU_1_DONE, "Row 0, EU 1"), \
+	GEN4_BIT(I965_ROW_0_EU_2_DONE, "Row 0, EU 2"), \
+	GEN4_BIT(I965_ROW_0_EU_3_DONE, "Row 0, EU 3"), \
+	GEN4_BIT(I965_ROW_1_EU_0_DONE, "Row 1, EU 0"), \
+	GEN4_BIT(I965_ROW_1_EU_1_DONE, "Row 1, EU 1"), \
+	GEN4_BIT(I965_ROW_1_EU_2_DONE, "Row 1, EU 2"), \
+	GEN4_BIT(I965_ROW_1_EU_3_DONE, "Row 1, EU 3"), \
+	GEN4_BIT(I965_SF_DONE, "Strips and Fans"), \
+	GEN4_BIT(I965_SE_DONE, "Setup Engine"), \
+	GEN4_BIT(I965_WM_DONE, "Windowizer"), \
+	GEN4_BIT(I965_DISPATCHER_DONE, "Dispatcher"), \
+	GEN4_BIT(I965_PROJECTION_DONE, "Projection and LOD"), \
+	GEN4_BIT(I965_DG_DONE, "Dependent address generator"), \
+	GEN4_BIT(I965_QUAD_CACHE_DONE, "Texture fetch"), \
+	GEN4_BIT(I965_TEXTURE_FETCH_DONE, "Texture fetch"), \
+	GEN4_BIT(I965_TEXTURE_DECOMPRESS_DONE, "Texture decompress"), \
+	GEN4_BIT(I965_SAMPLER_CACHE_DONE, "Sampler cache"), \
+	GEN4_BIT(I965_FILTER_DONE, "Filtering"), \
+	GEN4_BIT(I965_BYPASS_DONE, "Bypass FIFO"), \
+	GEN4_BIT(I965_PS_DONE, "Pixel shader"), \
+	GEN4_BIT(I965_CC_DONE, "Color calculator"), \
+	GEN4_BIT(I965_MAP_FILTER_DONE, "Map filter"), \
+	GEN4_BIT(I965_MAP_L2_IDLE, "Map L2"), \
+	GEN4_BIT(I965_MA_ROW_0_DONE, "Message Arbiter row 0"), \
+	GEN4_BIT(I965_MA_ROW_1_DONE, "Message Arbiter row 1"), \
+	GEN4_BIT(I965_IC_ROW_0_DONE, "Instruction cache row 0"), \
+	GEN4_BIT(I965_IC_ROW_1_DONE, "Instruction cache row 1"), \
+	GEN4_BIT(I965_CP_DONE, "Command Processor")
 
-static void
-gen6_instdone1_bit(uint32_t bit, const char *name)
-{
-	add_instdone_bit(GEN6_INSTDONE_1, bit, name);
-}
+static const struct instdone_bit gen2_instdone[] = {
+	GEN3_BIT(I830_GMBUS_DONE, "GMBUS"),
+	GEN3_BIT(I830_FBC_DONE, "FBC"),
+	GEN3_BIT(I830_BINNER_DONE, "BINNER"),
+	GEN3_BIT(I830_MPEG_DONE, "MPEG"),
+	GEN3_BIT(I830_MECO_DONE, "MECO"),
+	GEN3_BIT(I830_MCD_DONE, "MCD"),
+	GEN3_BIT(I830_MCSTP_DONE, "MCSTP"),
+	GEN3_BIT(I830_CC_DONE, "CC"),
+	GEN3_BIT(I830_DG_DONE, "DG"),
+	GEN3_BIT(I830_DCMP_DONE, "DCMP"),
+	GEN3_BIT(I830_FTCH_DONE, "FTCH"),
+	GEN3_BIT(I830_IT_DONE, "IT"),
+	GEN3_BIT(I830_MG_DONE, "MG"),
+	GEN3_BIT(I830_MEC_DONE, "MEC"),
+	GEN3_BIT(I830_PC_DONE, "PC"),
+	GEN3_BIT(I830_QCC_DONE, "QCC"),
+	GEN3_BIT(I830_TB_DONE, "TB"),
+	GEN3_BIT(I830_WM_DONE, "WM"),
+	GEN3_BIT(I830_EF_DONE, "EF"),
+	GEN3_BIT(I830_BLITTER_DONE, "Blitter"),
+	GEN3_BIT(I830_MAP_L2_DONE, "Map L2 cache"),
+	GEN3_BIT(I830_SECONDARY_RING_3_DONE, "Secondary ring 3"),
+	GEN3_BIT(I830_SECONDARY_RING_2_DONE, "Secondary ring 2"),
+	GEN3_BIT(I830_SECONDARY_RING_1_DONE, "Secondary ring 1"),
+	GEN3_BIT(I830_SECONDARY_RING_0_DONE, "Secondary ring 0"),
+	GEN3_BIT(I830_PRIMARY_RING_1_DONE, "Primary ring 1"),
+	GEN3_BIT(I830_PRIMARY_RING_0_DONE, "Primary ring 0"),
+};
 
-static void
-gen6_instdone2_bit(uint32_t bit, const char *name)
-{
-	add_instdone_bit(GEN6_INSTDONE_2, bit, name);
-}
+static const struct instdone_bit gen3_instdone[] = {
+	GEN3_BIT(IDCT_DONE, "IDCT"),
+	GEN3_BIT(IQ_DONE, "IQ"),
+	GEN3_BIT(PR_DONE, "PR"),
+	GEN3_BIT(VLD_DONE, "VLD"),
+	GEN3_BIT(IP_DONE, "Instruction parser"),
+	GEN3_BIT(FBC_DONE, "Framebuffer Compression"),
+	GEN3_BIT(BINNER_DONE, "Binner"),
+	GEN3_BIT(SF_DONE, "Strips and fans"),
+	GEN3_BIT(SE_DONE, "Setup engine"),
+	GEN3_BIT(WM_DONE, "Windowizer"),
+	GEN3_BIT(IZ_DONE, "Intermediate Z"),
+	GEN3_BIT(PERSPECTIVE_INTERP_DONE, "Perspective interpolation"),
+	GEN3_BIT(DISPATCHER_DONE, "Dispatcher"),
+	GEN3_BIT(PROJECTION_DONE, "Projection and LOD"),
+	GEN3_BIT(DEPENDENT_ADDRESS_DONE, "Dependent address calculation"),
+	GEN3_BIT(TEXTURE_FETCH_DONE, "Texture fetch"),
+	GEN3_BIT(TEXTURE_DECOMPRESS_DONE, "Texture decompression"),
+	GEN3_BIT(SAMPLER_CACHE_DONE, "Sampler Cache"),
+	GEN3_BIT(FILTER_DONE, "Filtering"),
+	GEN3_BIT(BYPASS_FIFO_DONE, "Bypass FIFO"),
+	GEN3_BIT(PS_DONE, "Pixel shader"),
+	GEN3_BIT(CC_DONE, "Color calculator"),
+	GEN3_BIT(MAP_FILTER_DONE, "Map filter"),
+	GEN3_BIT(MAP_L2_IDLE, "Map L2"),
+};
 
-static void
-init_g965_instdone1(void)
-{
-	gen4_instdone1_bit(I965_GW_CS_DONE_CR, "GW CS CR");
-	gen4_instdone1_bit(I965_SVSM_CS_DONE_CR, "SVSM CS CR");
-	gen4_instdone1_bit(I965_SVDW_CS_DONE_CR, "SVDW CS CR");
-	gen4_instdone1_bit(I965_SVDR_CS_DONE_CR, "SVDR CS CR");
-	gen4_instdone1_bit(I965_SVRW_CS_DONE_CR, "SVRW CS CR");
-	gen4_instdone1_bit(I965_SVRR_CS_DONE_CR, "SVRR CS CR");
-	gen4_instdone1_bit(I965_SVTW_CS_DONE_CR, "SVTW CS CR");
-	gen4_instdone1_bit(I965_MASM_CS_DONE_CR, "MASM CS CR");
-	gen4_instdone1_bit(I965_MASF_CS_DONE_CR, "MASF CS CR");
-	gen4_instdone1_bit(I965_MAW_CS_DONE_CR, "MAW CS CR");
-	gen4_instdone1_bit(I965_EM1_CS_DONE_CR, "EM1 CS CR");
-	gen4_instdone1_bit(I965_EM0_CS_DONE_CR, "EM0 CS CR");
-	gen4_instdone1_bit(I965_UC1_CS_DONE, "UC1 CS");
-	gen4_instdone1_bit(I965_UC0_CS_DONE, "UC0 CS");
-	gen4_instdone1_bit(I965_URB_CS_DONE, "URB CS");
-	gen4_instdone1_bit(I965_ISC_CS_DONE, "ISC CS");
-	gen4_instdone1_bit(I965_CL_CS_DONE, "CL CS");
-	gen4_instdone1_bit(I965_GS_CS_DONE, "GS CS");
-	gen4_instdone1_bit(I965_VS0_CS_DONE, "VS0 CS");
-	gen4_instdone1_bit(I965_VF_CS_DONE, "VF CS");
-}
+static const struct instdone_bit g965_instdone[] = {
+	GEN4_INSTDONE_BITS,
+	G965_INSTDONE1_BITS,
+};
 
-static void
-init_g4x_instdone1(void)
-{
-	gen4_instdone1_bit(G4X_BCS_DONE, "BCS");
-	gen4_instdone1_bit(G4X_CS_DONE, "CS");
-	gen4_instdone1_bit(G4X_MASF_DONE, "MASF");
-	gen4_instdone1_bit(G4X_SVDW_DONE, "SVDW");
-	gen4_instdone1_bit(G4X_SVDR_DONE, "SVDR");
-	gen4_instdone1_bit(G4X_SVRW_DONE, "SVRW");
-	gen4_instdone1_bit(G4X_SVRR_DONE, "SVRR");
-	gen4_instdone1_bit(G4X_ISC_DONE, "ISC");
-	gen4_instdone1_bit(G4X_MT_DONE, "MT");
-	gen4_instdone1_bit(G4X_RC_DONE, "RC");
-	gen4_instdone1_bit(G4X_DAP_DONE, "DAP");
-	gen4_instdone1_bit(G4X_MAWB_DONE, "MAWB");
-	gen4_instdone1_bit(G4X_MT_IDLE, "MT idle");
-	//gen4_instdone1_bit(G4X_GBLT_BUSY, "GBLT");
-	gen4_instdone1_bit(G4X_SVSM_DONE, "SVSM");
-	gen4_instdone1_bit(G4X_MASM_DONE, "MASM");
-	gen4_instdone1_bit(G4X_QC_DONE, "QC");
-	gen4_instdone1_bit(G4X_FL_DONE, "FL");
-	gen4_instdone1_bit(G4X_SC_DONE, "SC");
-	gen4_instdone1_bit(G4X_DM_DONE, "DM");
-	gen4_instdone1_bit(G4X_FT_DONE, "FT");
-	gen4_instdone1_bit(G4X_DG_DONE, "DG");
-	gen4_instdone1_bit(G4X_SI_DONE, "SI");
-	gen4_instdone1_bit(G4X_SO_DONE, "SO");
-	gen4_instdone1_bit(G4X_PL_DONE, "PL");
-	gen4_instdone1_bit(G4X_WIZ_DONE, "WIZ");
-	gen4_instdone1_bit(G4X_URB_DONE, "URB");
-	gen4_instdone1_bit(G4X_SF_DONE, "SF");
-	gen4_instdone1_bit(G4X_CL_DONE, "CL");
-	gen4_instdone1_bit(G4X_GS_DONE, "GS");
-	gen4_instdone1_bit(G4X_VS0_DONE, "VS0");
-	gen4_instdone1_bit(G4X_VF_DONE, "VF");
-}
+static const struct instdone_bit g4x_instdone[] = {
+	GEN4_INSTDONE_BITS,
+	G4X_INSTDONE1_BITS,
+};
 
-static void
-init_gen7_instdone(void)
-{
-	gen6_instdone1_bit(1 << 19, "GAM");
-	gen6_instdone1_bit(1 << 18, "GAFM");
-	gen6_instdone1_bit(1 << 17, "TSG");
-	gen6_instdone1_bit(1 << 16, "VFE");
-	gen6_instdone1_bit(1 << 15, "GAFS");
-	gen6_instdone1_bit(1 << 14, "SVG");
-	gen6_instdone1_bit(1 << 13, "URBM");
-	gen6_instdone1_bit(1 << 12, "TDG");
-	gen6_instdone1_bit(1 << 9, "SF");
-	gen6_instdone1_bit(1 << 8, "CL");
-	gen6_instdone1_bit(1 << 7, "SOL");
-	gen6_instdone1_bit(1 << 6, "GS");
-	gen6_instdone1_bit(1 << 5, "DS");
-	gen6_instdone1_bit(1 << 4, "TE");
-	gen6_instdone1_bit(1 << 3, "HS");
-	gen6_instdone1_bit(1 << 2, "VS");
-	gen6_instdone1_bit(1 << 1, "VF");
-}
+static const struct instdone_bit gen5_instdone[] = {
+	GEN4_BIT(ILK_ROW_0_EU_0_DONE, "Row 0, EU 0"),
+	GEN4_BIT(ILK_ROW_0_EU_1_DONE, "Row 0, EU 1"),
+	GEN4_BIT(ILK_ROW_0_EU_2_DONE, "Row 0, EU 2"),
+	GEN4_BIT(ILK_ROW_0_EU_3_DONE, "Row 0, EU 3"),
+	GEN4_BIT(ILK_ROW_1_EU_0_DONE, "Row 1, EU 0"),
+	GEN4_BIT(ILK_ROW_1_EU_1_DONE, "Row 1, EU 1"),
+	GEN4_BIT(ILK_ROW_1_EU_2_DONE, "Row 1, EU 2"),
+	GEN4_BIT(ILK_ROW_1_EU_3_DONE, "Row 1, EU 3"),
+	GEN4_BIT(ILK_ROW_2_EU_0_DONE, "Row 2, EU 0"),
+	GEN4_BIT(ILK_ROW_2_EU_1_DONE, "Row 2, EU 1"),
+	GEN4_BIT(ILK_ROW_2_EU_2_DONE, "Row 2, EU 2"),
+	GEN4_BIT(ILK_ROW_2_EU_3_DONE, "Row 2, EU 3"),
+	GEN4_BIT(ILK_VCP_DONE, "VCP"),
+	GEN4_BIT(ILK_ROW_0_MATH_DONE, "Row 0 math"),
+	GEN4_BIT(ILK_ROW_1_MATH_DONE, "Row 1 math"),
+	GEN4_BIT(ILK_ROW_2_MATH_DONE, "Row 2 math"),
+	GEN4_BIT(ILK_VC1_DONE, "VC1"),
+	GEN4_BIT(ILK_ROW_0_MA_DONE, "Row 0 MA"),
+	GEN4_BIT(ILK_ROW_1_MA_DONE, "Row 1 MA"),
+	GEN4_BIT(ILK_ROW_2_MA_DONE, "Row 2 MA"),
+	GEN4_BIT(ILK_ROW_0_ISC_DONE, "Row 0 ISC"),
+	GEN4_BIT(ILK_ROW_1_ISC_DONE, "Row 1 ISC"),
+	GEN4_BIT(ILK_ROW_2_ISC_DONE, "Row 2 ISC"),
+	GEN4_BIT(ILK_VFE_DONE, "VFE"),
+	GEN4_BIT(ILK_TD_DONE, "TD"),
+	GEN4_BIT(ILK_SVTS_DONE, "SVTS"),
+	GEN4_BIT(ILK_TS_DONE, "TS"),
+	GEN4_BIT(ILK_GW_DONE, "GW"),
+	GEN4_BIT(ILK_AI_DONE, "AI"),
+	GEN4_BIT(ILK_AC_DONE, "AC"),
+	GEN4_BIT(ILK_AM_DONE, "AM"),
+	G4X_INSTDONE1_BITS,
+};
+
+static const struct instdone_bit gen6_instdone[] = {
+	/* Now called INSTDONE_1 in the docs. */
+	GEN6_BIT1(GEN6_MA_3_DONE, "Message Arbiter 3"),
+	GEN6_BIT1(GEN6_EU_32_DONE, "EU 32"),
+	GEN6_BIT1(GEN6_EU_31_DONE, "EU 31"),
+	GEN6_BIT1(GEN6_EU_30_DONE, "EU 30"),
+	GEN6_BIT1(GEN6_MA_3_DONE, "Message Arbiter 2"),
+	GEN6_BIT1(GEN6_EU_22_DONE, "EU 22"),
+	GEN6_BIT1(GEN6_EU_21_DONE, "EU 21"),
+	GEN6_BIT1(GEN6_EU_20_DONE, "EU 20"),
+	GEN6_BIT1(GEN6_MA_3_DONE, "Message Arbiter 1"),
+	GEN6_BIT1(GEN6_EU_12_DONE, "EU 12"),
+	GEN6_BIT1(GEN6_EU_11_DONE, "EU 11"),
+	GEN6_BIT1(GEN6_EU_10_DONE, "EU 10"),
+	GEN6_BIT1(GEN6_MA_3_DONE, "Message Arbiter 0"),
+	GEN6_BIT1(GEN6_EU_02_DONE, "EU 02"),
+	GEN6_BIT1(GEN6_EU_01_DONE, "EU 01"),
+	GEN6_BIT1(GEN6_EU_00_DONE, "EU 00"),
+
+	GEN6_BIT1(GEN6_IC_3_DONE, "IC 3"),
+	GEN6_BIT1(GEN6_IC_2_DONE, "IC 2"),
+	GEN6_BIT1(GEN6_IC_1_DONE, "IC 1"),
+	GEN6_BIT1(GEN6_IC_0_DONE, "IC 0"),
+	GEN6_BIT1(GEN6_ISC_10_DONE, "ISC 1/0"),
+	GEN6_BIT1(GEN6_ISC_32_DONE, "ISC 3/2"),
+
+	GEN6_BIT1(GEN6_VSC_DONE, "VSC"),
+	GEN6_BIT1(GEN6_IEF_DONE, "IEF"),
+	GEN6_BIT1(GEN6_VFE_DONE, "VFE"),
+	GEN6_BIT1(GEN6_TD_DONE, "TD"),
+	GEN6_BIT1(GEN6_TS_DONE, "TS"),
+	GEN6_BIT1(GEN6_GW_DONE, "GW"),
+	GEN6_BIT1(GEN6_HIZ_DONE, "HIZ"),
+	GEN6_BIT1(GEN6_AVS_DONE, "AVS"),
+
+	/* Now called INSTDONE_2 in the docs. */
+	GEN6_BIT2(GEN6_GAM_DONE, "GAM"),
+	GEN6_BIT2(GEN6_CS_DONE, "CS"),
+	GEN6_BIT2(GEN6_WMBE_DONE, "WMBE"),
+	GEN6_BIT2(GEN6_SVRW_DONE, "SVRW"),
+	GEN6_BIT2(GEN6_RCC_DONE, "RCC"),
+	GEN6_BIT2(GEN6_SVG_DONE, "SVG"),
+	GEN6_BIT2(GEN6_ISC_DONE, "ISC"),
+	GEN6_BIT2(GEN6_MT_DONE, "MT"),
+	GEN6_BIT2(GEN6_RCPFE_DONE, "RCPFE"),
+	GEN6_BIT2(GEN6_RCPBE_DONE, "RCPBE"),
+	GEN6_BIT2(GEN6_VDI_DONE, "VDI"),
+	GEN6_BIT2(GEN6_RCZ_DONE, "RCZ"),
+	GEN6_BIT2(GEN6_DAP_DONE, "DAP"),
+	GEN6_BIT2(GEN6_PSD_DONE, "PSD"),
+	GEN6_BIT2(GEN6_IZ_DONE, "IZ"),
+	GEN6_BIT2(GEN6_WMFE_DONE, "WMFE"),
+	GEN6_BIT2(GEN6_SVSM_DONE, "SVSM"),
+	GEN6_BIT2(GEN6_QC_DONE, "QC"),
+	GEN6_BIT2(GEN6_FL_DONE, "FL"),
+	GEN6_BIT2(GEN6_SC_DONE, "SC"),
+	GEN6_BIT2(GEN6_DM_DONE, "DM"),
+	GEN6_BIT2(GEN6_FT_DONE, "FT"),
+	GEN6_BIT2(GEN6_DG_DONE, "DG"),
+	GEN6_BIT2(GEN6_SI_DONE, "SI"),
+	GEN6_BIT2(GEN6_SO_DONE, "SO"),
+	GEN6_BIT2(GEN6_PL_DONE, "PL"),
+	GEN6_BIT2(GEN6_VME_DONE, "VME"),
+	GEN6_BIT2(GEN6_SF_DONE, "SF"),
+	GEN6_BIT2(GEN6_CL_DONE, "CL"),
+	GEN6_BIT2(GEN6_GS_DONE, "GS"),
+	GEN6_BIT2(GEN6_VS0_DONE, "VS0"),
+	GEN6_BIT2(GEN6_VF_DONE, "VF"),
+};
+
+static const struct instdone_bit gen7_instdone[] = {
+	GEN6_BIT1(1 << 19, "GAM"),
+	GEN6_BIT1(1 << 18, "GAFM"),
+	GEN6_BIT1(1 << 17, "TSG"),
+	GEN6_BIT1(1 << 16, "VFE"),
+	GEN6_BIT1(1 << 15, "GAFS"),
+	GEN6_BIT1(1 << 14, "SVG"),
+	GEN6_BIT1(1 << 13, "URBM"),
+	GEN6_BIT1(1 << 12, "TDG"),
+	GEN6_BIT1(1 << 9, "SF"),
+	GEN6_BIT1(1 << 8, "CL"),
+	GEN6_BIT1(1 << 7, "SOL"),
+	GEN6_BIT1(1 << 6, "GS"),
+	GEN6_BIT1(1 << 5, "DS"),
+	GEN6_BIT1(1 << 4, "TE"),
+	GEN6_BIT1(1 << 3, "HS"),
+	GEN6_BIT1(1 << 2, "VS"),
+	GEN6_BIT1(1 << 1, "VF"),
+};
+
+const struct instdone_bit *instdone_bits;
+int num_instdone_bits = 0;
+
+#define SELECT_TABLE(table) do { \
+	instdone_bits = table; \
+	num_instdone_bits = sizeof(table) / sizeof(table[0]); \
+} while (0)
 
 void
 init_instdone_definitions(uint32_t devid)
 {
 	if (IS_GEN7(devid)) {
-		init_gen7_instdone();
+		SELECT_TABLE(gen7_instdone);
 	} else if (IS_GEN6(devid)) {
-		/* Now called INSTDONE_1 in the docs. */
-		gen6_instdone1_bit(GEN6_MA_3_DONE, "Message Arbiter 3");
-		gen6_instdone1_bit(GEN6_EU_32_DONE, "EU 32");
-		gen6_instdone1_bit(GEN6_EU_31_DONE, "EU 31");
-		gen6_instdone1_bit(GEN6_EU_30_DONE, "EU 30");
-		gen6_instdone1_bit(GEN6_MA_3_DONE, "Message Arbiter 2");
-		gen6_instdone1_bit(GEN6_EU_22_DONE, "EU 22");
-		gen6_instdone1_bit(GEN6_EU_21_DONE, "EU 21");
-		gen6_instdone1_bit(GEN6_EU_20_DONE, "EU 20");
-		gen6_instdone1_bit(GEN6_MA_3_DONE, "Message Arbiter 1");
-		gen6_instdone1_bit(GEN6_EU_12_DONE, "EU 12");
-		gen6_instdone1_bit(GEN6_EU_11_DONE, "EU 11");
-		gen6_instdone1_bit(GEN6_EU_10_DONE, "EU 10");
-		gen6_instdone1_bit(GEN6_MA_3_DONE, "Message Arbiter 0");
-		gen6_instdone1_bit(GEN6_EU_02_DONE, "EU 02");
-		gen6_instdone1_bit(GEN6_EU_01_DONE, "EU 01");
-		gen6_instdone1_bit(GEN6_EU_00_DONE, "EU 00");
-
-		gen6_instdone1_bit(GEN6_IC_3_DONE, "IC 3");
-		gen6_instdone1_bit(GEN6_IC_2_DONE, "IC 2");
-		gen6_instdone1_bit(GEN6_IC_1_DONE, "IC 1");
-		gen6_instdone1_bit(GEN6_IC_0_DONE, "IC 0");
-		gen6_instdone1_bit(GEN6_ISC_10_DONE, "ISC 1/0");
-		gen6_instdone1_bit(GEN6_ISC_32_DONE, "ISC 3/2");
-
-		gen6_instdone1_bit(GEN6_VSC_DONE, "VSC");
-		gen6_instdone1_bit(GEN6_IEF_DONE, "IEF");
-		gen6_instdone1_bit(GEN6_VFE_DONE, "VFE");
-		gen6_instdone1_bit(GEN6_TD_DONE, "TD");
-		gen6_instdone1_bit(GEN6_TS_DONE, "TS");
-		gen6_instdone1_bit(GEN6_GW_DONE, "GW");
-		gen6_instdone1_bit(GEN6_HIZ_DONE, "HIZ");
-		gen6_instdone1_bit(GEN6_AVS_DONE, "AVS");
-
-		/* Now called INSTDONE_2 in the docs. */
-		gen6_instdone2_bit(GEN6_GAM_DONE, "GAM");
-		gen6_instdone2_bit(GEN6_CS_DONE, "CS");
-		gen6_instdone2_bit(GEN6_WMBE_DONE, "WMBE");
-		gen6_instdone2_bit(GEN6_SVRW_DONE, "SVRW");
-		gen6_instdone2_bit(GEN6_RCC_DONE, "RCC");
-		gen6_instdone2_bit(GEN6_SVG_DONE, "SVG");
-		gen6_instdone2_bit(GEN6_ISC_DONE, "ISC");
-		gen6_instdone2_bit(GEN6_MT_DONE, "MT");
-		gen6_instdone2_bit(GEN6_RCPFE_DONE, "RCPFE");
-		gen6_instdone2_bit(GEN6_RCPBE_DONE, "RCPBE");
-		gen6_instdone2_bit(GEN6_VDI_DONE, "VDI");
-		gen6_instdone2_bit(GEN6_RCZ_DONE, "RCZ");
-		gen6_instdone2_bit(GEN6_DAP_DONE, "DAP");
-		gen6_instdone2_bit(GEN6_PSD_DONE, "PSD");
-		gen6_instdone2_bit(GEN6_IZ_DONE, "IZ");
-		gen6_instdone2_bit(GEN6_WMFE_DONE, "WMFE");
-		gen6_instdone2_bit(GEN6_SVSM_DONE, "SVSM");
-		gen6_instdone2_bit(GEN6_QC_DONE, "QC");
-		gen6_instdone2_bit(GEN6_FL_DONE, "FL");
-		gen6_instdone2_bit(GEN6_SC_DONE, "SC");
-		gen6_instdone2_bit(GEN6_DM_DONE, "DM");
-		gen6_instdone2_bit(GEN6_FT_DONE, "FT");
-		gen6_instdone2_bit(GEN6_DG_DONE, "DG");
-		gen6_instdone2_bit(GEN6_SI_DONE, "SI");
-		gen6_instdone2_bit(GEN6_SO_DONE, "SO");
-		gen6_instdone2_bit(GEN6_PL_DONE, "PL");
-		gen6_instdone2_bit(GEN6_VME_DONE, "VME");
-		gen6_instdone2_bit(GEN6_SF_DONE, "SF");
-		gen6_instdone2_bit(GEN6_CL_DONE, "CL");
-		gen6_instdone2_bit(GEN6_GS_DONE, "GS");
-		gen6_instdone2_bit(GEN6_VS0_DONE, "VS0");
-		gen6_instdone2_bit(GEN6_VF_DONE, "VF");
+		SELECT_TABLE(gen6_instdone);
 	} else if (IS_GEN5(devid)) {
-		gen4_instdone_bit(ILK_ROW_0_EU_0_DONE, "Row 0, EU 0");
-		gen4_instdone_bit(ILK_ROW_0_EU_1_DONE, "Row 0, EU 1");
-		gen4_instdone_bit(ILK_ROW_0_EU_2_DONE, "Row 0, EU 2");
-		gen4_instdone_bit(ILK_ROW_0_EU_3_DONE, "Row 0, EU 3");
-		gen4_instdone_bit(ILK_ROW_1_EU_0_DONE, "Row 1, EU 0");
-		gen4_instdone_bit(ILK_ROW_1_EU_1_DONE, "Row 1, EU 1");
-		gen4_instdone_bit(ILK_ROW_1_EU_2_DONE, "Row 1, EU 2");
-		gen4_instdone_bit(ILK_ROW_1_EU_3_DONE, "Row 1, EU 3");
-		gen4_instdone_bit(ILK_ROW_2_EU_0_DONE, "Row 2, EU 0");
-		gen4_instdone_bit(ILK_ROW_2_EU_1_DONE, "Row 2, EU 1");
-		gen4_instdone_bit(ILK_ROW_2_EU_2_DONE, "Row 2, EU 2");
-		gen4_instdone_bit(ILK_ROW_2_EU_3_DONE, "Row 2, EU 3");
-		gen4_instdone_bit(ILK_VCP_DONE, "VCP");
-		gen4_instdone_bit(ILK_ROW_0_MATH_DONE, "Row 0 math");
-		gen4_instdone_bit(ILK_ROW_1_MATH_DONE, "Row 1 math");
-		gen4_instdone_bit(ILK_ROW_2_MATH_DONE, "Row 2 math");
-		gen4_instdone_bit(ILK_VC1_DONE, "VC1");
-		gen4_instdone_bit(ILK_ROW_0_MA_DONE, "Row 0 MA");
-		gen4_instdone_bit(ILK_ROW_1_MA_DONE, "Row 1 MA");
-		gen4_instdone_bit(ILK_ROW_2_MA_DONE, "Row 2 MA");
-		gen4_instdone_bit(ILK_ROW_0_ISC_DONE, "Row 0 ISC");
-		gen4_instdone_bit(ILK_ROW_1_ISC_DONE, "Row 1 ISC");
-		gen4_instdone_bit(ILK_ROW_2_ISC_DONE, "Row 2 ISC");
-		gen4_instdone_bit(ILK_VFE_DONE, "VFE");
-		gen4_instdone_bit(ILK_TD_DONE, "TD");
-		gen4_instdone_bit(ILK_SVTS_DONE, "SVTS");
-		gen4_instdone_bit(ILK_TS_DONE, "TS");
-		gen4_instdone_bit(ILK_GW_DONE, "GW");
-		gen4_instdone_bit(ILK_AI_DONE, "AI");
-		gen4_instdone_bit(ILK_AC_DONE, "AC");
-		gen4_instdone_bit(ILK_AM_DONE, "AM");
-
-		init_g4x_instdone1();
+		SELECT_TABLE(gen5_instdone);
 	} else if (IS_GEN4(devid)) {
-		gen4_instdone_bit(I965_ROW_0_EU_0_DONE, "Row 0, EU 0");
-		gen4_instdone_bit(I965_ROW_0_EU_1_DONE, "Row 0, EU 1");
-		gen4_instdone_bit(I965_ROW_0_EU_2_DONE, "Row 0, EU 2");
-		gen4_instdone_bit(I965_ROW_0_EU_3_DONE, "Row 0, EU 3");
-		gen4_instdone_bit(I965_ROW_1_EU_0_DONE, "Row 1, EU 0");
-		gen4_instdone_bit(I965_ROW_1_EU_1_DONE, "Row 1, EU 1");
-		gen4_instdone_bit(I965_ROW_1_EU_2_DONE, "Row 1, EU 2");
-		gen4_instdone_bit(I965_ROW_1_EU_3_DONE, "Row 1, EU 3");
-		gen4_instdone_bit(I965_SF_DONE, "Strips and Fans");
-		gen4_instdone_bit(I965_SE_DONE, "Setup Engine");
-		gen4_instdone_bit(I965_WM_DONE, "Windowizer");
-		gen4_instdone_bit(I965_DISPATCHER_DONE, "Dispatcher");
-		gen4_instdone_bit(I965_PROJECTION_DONE, "Projection and LOD");
-		gen4_instdone_bit(I965_DG_DONE, "Dependent address generator");
-		gen4_instdone_bit(I965_QUAD_CACHE_DONE, "Texture fetch");
-		gen4_instdone_bit(I965_TEXTURE_FETCH_DONE, "Texture fetch");
-		gen4_instdone_bit(I965_TEXTURE_DECOMPRESS_DONE, "Texture decompress");
-		gen4_instdone_bit(I965_SAMPLER_CACHE_DONE, "Sampler cache");
-		gen4_instdone_bit(I965_FILTER_DONE, "Filtering");
-		gen4_instdone_bit(I965_BYPASS_DONE, "Bypass FIFO");
-		gen4_instdone_bit(I965_PS_DONE, "Pixel shader");
-		gen4_instdone_bit(I965_CC_DONE, "Color calculator");
-		gen4_instdone_bit(I965_MAP_FILTER_DONE, "Map filter");
-		gen4_instdone_bit(I965_MAP_L2_IDLE, "Map L2");
-		gen4_instdone_bit(I965_MA_ROW_0_DONE, "Message Arbiter row 0");
-		gen4_instdone_bit(I965_MA_ROW_1_DONE, "Message Arbiter row 1");
-		gen4_instdone_bit(I965_IC_ROW_0_DONE, "Instruction cache row 0");
-		gen4_instdone_bit(I965_IC_ROW_1_DONE, "Instruction cache row 1");
-		gen4_instdone_bit(I965_CP_DONE, "Command Processor");
-
-		if (IS_G4X(devid)) {
-			init_g4x_instdone1();
-		} else {
-			init_g965_instdone1();
-		}
+		if (IS_G4X(devid))
+			SELECT_TABLE(g4x_instdone);
+		else
+			SELECT_TABLE(g965_instdone);
 	} else if (IS_GEN3(devid)) {
-		gen3_instdone_bit(IDCT_DONE, "IDCT");
-		gen3_instdone_bit(IQ_DONE, "IQ");
-		gen3_instdone_bit(PR_DONE, "PR");
-		gen3_instdone_bit(VLD_DONE, "VLD");
-		gen3_instdone_bit(IP_DONE, "Instruction parser");
-		gen3_instdone_bit(FBC_DONE, "Framebuffer Compression");
-		gen3_instdone_bit(BINNER_DONE, "Binner");
-		gen3_instdone_bit(SF_DONE, "Strips and fans");
-		gen3_instdone_bit(SE_DONE, "Setup engine");
-		gen3_instdone_bit(WM_DONE, "Windowizer");
-		gen3_instdone_bit(IZ_DONE, "Intermediate Z");
-		gen3_instdone_bit(PERSPECTIVE_INTERP_DONE, "Perspective interpolation");
-		gen3_instdone_bit(DISPATCHER_DONE, "Dispatcher");
-		gen3_instdone_bit(PROJECTION_DONE, "Projection and LOD");
-		gen3_instdone_bit(DEPENDENT_ADDRESS_DONE, "Dependent address calculation");
-		gen3_instdone_bit(TEXTURE_FETCH_DONE, "Texture fetch");
-		gen3_instdone_bit(TEXTURE_DECOMPRESS_DONE, "Texture decompression");
-		gen3_instdone_bit(SAMPLER_CACHE_DONE, "Sampler Cache");
-		gen3_instdone_bit(FILTER_DONE, "Filtering");
-		gen3_instdone_bit(BYPASS_FIFO_DONE, "Bypass FIFO");
-		gen3_instdone_bit(PS_DONE, "Pixel shader");
-		gen3_instdone_bit(CC_DONE, "Color calculator");
-		gen3_instdone_bit(MAP_FILTER_DONE, "Map filter");
-		gen3_instdone_bit(MAP_L2_IDLE, "Map L2");
+		SELECT_TABLE(gen3_instdone);
 	} else {
 		assert(IS_GEN2(devid));
-		gen3_instdone_bit(I830_GMBUS_DONE, "GMBUS");
-		gen3_instdone_bit(I830_FBC_DONE, "FBC");
-		gen3_instdone_bit(I830_BINNER_DONE, "BINNER");
-		gen3_instdone_bit(I830_MPEG_DONE, "MPEG");
-		gen3_instdone_bit(I830_MECO_DONE, "MECO");
-		gen3_instdone_bit(I830_MCD_DONE, "MCD");
-		gen3_instdone_bit(I830_MCSTP_DONE, "MCSTP");
-		gen3_instdone_bit(I830_CC_DONE, "CC");
-		gen3_instdone_bit(I830_DG_DONE, "DG");
-		gen3_instdone_bit(I830_DCMP_DONE, "DCMP");
-		gen3_instdone_bit(I830_FTCH_DONE, "FTCH");
-		gen3_instdone_bit(I830_IT_DONE, "IT");
-		gen3_instdone_bit(I830_MG_DONE, "MG");
-		gen3_instdone_bit(I830_MEC_DONE, "MEC");
-		gen3_instdone_bit(I830_PC_DONE, "PC");
-		gen3_instdone_bit(I830_QCC_DONE, "QCC");
-		gen3_instdone_bit(I830_TB_DONE, "TB");
-		gen3_instdone_bit(I830_WM_DONE, "WM");
-		gen3_instdone_bit(I830_EF_DONE, "EF");
-		gen3_instdone_bit(I830_BLITTER_DONE, "Blitter");
-		gen3_instdone_bit(I830_MAP_L2_DONE, "Map L2 cache");
-		gen3_instdone_bit(I830_SECONDARY_RING_3_DONE, "Secondary ring 3");
-		gen3_instdone_bit(I830_SECONDARY_RING_2_DONE, "Secondary ring 2");
-		gen3_instdone_bit(I830_SECONDARY_RING_1_DONE, "Secondary ring 1");
-		gen3_instdone_bit(I830_SECONDARY_RING_0_DONE, "Secondary ring 0");
-		gen3_instdone_bit(I830_PRIMARY_RING_1_DONE, "Primary ring 1");
-		gen3_instdone_bit(I830_PRIMARY_RING_0_DONE, "Primary ring 0");
+		SELECT_TABLE(gen2_instdone);
 	}
 }
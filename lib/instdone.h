@@ -35,7 +35,9 @@ struct instdone_bit {
 	const char *name;
 };
 
-extern struct instdone_bit instdone_bits[MAX_INSTDONE_BITS];
+/* points at a static per-generation table after
+ * init_instdone_definitions(); entries and indices never change */
+extern const struct instdone_bit *instdone_bits;
 extern int num_instdone_bits;
 
 void init_instdone_definitions(uint32_t devid);
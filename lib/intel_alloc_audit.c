@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <execinfo.h>
+
+#include "intel_alloc_audit.h"
+
+/* We interpose the allocation entry points with strong definitions that
+ * forward to the glibc internals rather than using the (thread-unsafe,
+ * deprecated) __malloc_hook variables.  Because libintel_tools is a
+ * static archive this object is only linked into binaries that reference
+ * the audit API, so everything else keeps plain malloc.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+
+#define AUDIT_BACKTRACE_MAX 16
+#define AUDIT_BACKTRACE_DEPTH 16
+
+static volatile int audit_armed;
+static int audit_enabled = -1;
+static int audit_backtrace;
+static unsigned long audit_allocs;
+static unsigned long audit_bytes;
+
+/* backtrace() itself allocates on some paths; the guard keeps a hit
+ * taken while reporting a hit from recursing. */
+static __thread int audit_in_hit;
+
+static void audit_hit(size_t size)
+{
+	unsigned long n;
+
+	n = __sync_add_and_fetch(&audit_allocs, 1);
+	__sync_add_and_fetch(&audit_bytes, size);
+
+	if (audit_backtrace && n <= AUDIT_BACKTRACE_MAX && !audit_in_hit) {
+		void *frames[AUDIT_BACKTRACE_DEPTH];
+		int depth;
+
+		audit_in_hit = 1;
+		fprintf(stderr, "intel_alloc_audit: %lu byte allocation "
+			"after warmup (hit #%lu)\n",
+			(unsigned long)size, n);
+		depth = backtrace(frames, AUDIT_BACKTRACE_DEPTH);
+		backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+		if (n == AUDIT_BACKTRACE_MAX)
+			fprintf(stderr, "intel_alloc_audit: further hits "
+				"counted silently\n");
+		audit_in_hit = 0;
+	}
+}
+
+void *malloc(size_t size)
+{
+	void *ptr = __libc_malloc(size);
+
+	if (audit_armed)
+		audit_hit(size);
+	return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	void *ptr = __libc_calloc(nmemb, size);
+
+	if (audit_armed)
+		audit_hit(nmemb * size);
+	return ptr;
+}
+
+void *realloc(void *old, size_t size)
+{
+	void *ptr = __libc_realloc(old, size);
+
+	/* shrinking in place still counts: steady state means no calls */
+	if (audit_armed)
+		audit_hit(size);
+	return ptr;
+}
+
+void *memalign(size_t align, size_t size)
+{
+	void *ptr = __libc_memalign(align, size);
+
+	if (audit_armed)
+		audit_hit(size);
+	return ptr;
+}
+
+static int audit_wanted(void)
+{
+	if (audit_enabled < 0) {
+		const char *env = getenv("INTEL_ALLOC_AUDIT");
+
+		audit_enabled = env && *env && strcmp(env, "0") != 0;
+		if (audit_enabled)
+			audit_backtrace = strcmp(env, "backtrace") == 0;
+	}
+
+	return audit_enabled;
+}
+
+void intel_alloc_audit_arm(void)
+{
+	void *frames[AUDIT_BACKTRACE_DEPTH];
+
+	if (!audit_wanted() || audit_armed)
+		return;
+
+	/* backtrace() lazily loads libgcc on its first call, which
+	 * allocates; take that warmup hit before arming so it is not
+	 * misreported as a leak. */
+	if (audit_backtrace)
+		backtrace(frames, AUDIT_BACKTRACE_DEPTH);
+
+	audit_armed = 1;
+}
+
+void intel_alloc_audit_disarm(void)
+{
+	audit_armed = 0;
+}
+
+unsigned long intel_alloc_audit_count(void)
+{
+	return audit_allocs;
+}
+
+unsigned long intel_alloc_audit_report(FILE *out)
+{
+	if (!audit_armed && !audit_allocs)
+		return 0;
+
+	if (audit_allocs)
+		fprintf(out, "intel_alloc_audit: %lu allocations "
+			"(%lu bytes) after warmup\n",
+			audit_allocs, audit_bytes);
+	else
+		fprintf(out, "intel_alloc_audit: steady state clean, "
+			"no allocations after warmup\n");
+
+	return audit_allocs;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_ALLOC_AUDIT_H
+#define INTEL_ALLOC_AUDIT_H
+
+#include <stdio.h>
+
+/* Steady-state allocation audit for long-running tools.
+ *
+ * A monitor that is meant to run for weeks should stop touching the heap
+ * once it has warmed up; a slow leak in the watcher is the one failure
+ * nothing else catches.  A tool declares the end of its warmup phase with
+ * intel_alloc_audit_arm(), after which every malloc/calloc/realloc/
+ * memalign is counted, and intel_alloc_audit_report() at shutdown says
+ * whether the steady state was clean.
+ *
+ * The audit only engages when INTEL_ALLOC_AUDIT is set in the
+ * environment; set it to "backtrace" to also get a stack dump for the
+ * first few offending allocations so the call site can be found.  With
+ * the variable unset the interposed allocators forward straight to libc
+ * and arm/report are no-ops, so nothing changes for normal use.
+ *
+ * Linking any of these entry points pulls the interposed allocators into
+ * the binary; tools that never call them keep plain libc malloc.
+ */
+
+void intel_alloc_audit_arm(void);
+void intel_alloc_audit_disarm(void);
+unsigned long intel_alloc_audit_count(void);
+unsigned long intel_alloc_audit_report(FILE *out);
+
+#endif /* INTEL_ALLOC_AUDIT_H */
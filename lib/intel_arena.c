@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Slab allocator for scratch_buf working sets.
+ *
+ * Creating hundreds of individual bos through drm_intel_bo_alloc pays
+ * an ioctl (and often a clflush) per object and leaves placement to the
+ * whims of the bufmgr cache, which makes benchmark timings noisy from
+ * run to run.  The arena instead carves fixed-size scratch_bufs out of
+ * a few large slab bos at explicit, monotonically increasing offsets:
+ * setup cost is one allocation and one map per slab, and placement of
+ * every buf relative to its neighbours is the same on every run.
+ *
+ * The trade-off: tiling is a property of the whole object, so
+ * sub-allocated bufs are always linear.  Callers that need per-buffer
+ * set_tiling must keep allocating individual bos.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "intel_arena.h"
+
+struct intel_arena_slab {
+	drm_intel_bo *bo;
+	void *virtual;
+	unsigned used;
+	struct intel_arena_slab *next;
+};
+
+struct intel_arena {
+	drm_intel_bufmgr *bufmgr;
+	unsigned buf_size;
+	unsigned slab_size;
+	enum intel_arena_map map_mode;
+	struct intel_arena_slab *slabs;
+};
+
+static struct intel_arena_slab *arena_new_slab(struct intel_arena *arena)
+{
+	struct intel_arena_slab *slab;
+
+	slab = calloc(1, sizeof(*slab));
+	assert(slab);
+
+	slab->bo = drm_intel_bo_alloc(arena->bufmgr, "arena slab",
+				      arena->slab_size, 4096);
+	assert(slab->bo);
+
+	switch (arena->map_mode) {
+	case INTEL_ARENA_MAP_GTT:
+		drm_intel_gem_bo_map_gtt(slab->bo);
+		slab->virtual = slab->bo->virtual;
+		break;
+	case INTEL_ARENA_MAP_CPU:
+		drm_intel_bo_map(slab->bo, 1);
+		slab->virtual = slab->bo->virtual;
+		break;
+	case INTEL_ARENA_MAP_NONE:
+		break;
+	}
+
+	slab->next = arena->slabs;
+	arena->slabs = slab;
+
+	return slab;
+}
+
+struct intel_arena *intel_arena_create(drm_intel_bufmgr *bufmgr,
+				       unsigned buf_size,
+				       unsigned bufs_per_slab,
+				       enum intel_arena_map map_mode)
+{
+	struct intel_arena *arena;
+
+	assert(bufs_per_slab > 0);
+
+	arena = calloc(1, sizeof(*arena));
+	assert(arena);
+
+	arena->bufmgr = bufmgr;
+	/* page-align so every buf can be a blt/render target */
+	arena->buf_size = (buf_size + 4095) & ~4095;
+	arena->slab_size = arena->buf_size * bufs_per_slab;
+	arena->map_mode = map_mode;
+
+	return arena;
+}
+
+/* Hand out the next buf, growing the arena by a slab when the current
+ * one is exhausted.  The buf holds its own reference on the slab bo. */
+void intel_arena_get_buf(struct intel_arena *arena, struct scratch_buf *buf)
+{
+	struct intel_arena_slab *slab = arena->slabs;
+
+	if (slab == NULL || slab->used + arena->buf_size > arena->slab_size)
+		slab = arena_new_slab(arena);
+
+	drm_intel_bo_reference(slab->bo);
+	buf->bo = slab->bo;
+	buf->offset = slab->used;
+	buf->size = arena->buf_size;
+	buf->tiling = I915_TILING_NONE;
+	buf->stride = 4096;
+	buf->data = buf->cpu_mapping = NULL;
+	buf->num_tiles = 0;
+	if (slab->virtual)
+		buf->data = (uint32_t *)((char *)slab->virtual + slab->used);
+
+	slab->used += arena->buf_size;
+}
+
+void intel_arena_free(struct intel_arena *arena)
+{
+	while (arena->slabs) {
+		struct intel_arena_slab *slab = arena->slabs;
+
+		arena->slabs = slab->next;
+		if (arena->map_mode == INTEL_ARENA_MAP_GTT)
+			drm_intel_gem_bo_unmap_gtt(slab->bo);
+		else if (arena->map_mode == INTEL_ARENA_MAP_CPU)
+			drm_intel_bo_unmap(slab->bo);
+		drm_intel_bo_unreference(slab->bo);
+		free(slab);
+	}
+	free(arena);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTEL_ARENA_H
+#define INTEL_ARENA_H
+
+#include "rendercopy.h"
+
+/* How the arena should map its slabs; sub-allocated bufs inherit a
+ * pointer into the slab mapping through scratch_buf.data. */
+enum intel_arena_map {
+	INTEL_ARENA_MAP_NONE,
+	INTEL_ARENA_MAP_GTT,
+	INTEL_ARENA_MAP_CPU,
+};
+
+struct intel_arena *intel_arena_create(drm_intel_bufmgr *bufmgr,
+				       unsigned buf_size,
+				       unsigned bufs_per_slab,
+				       enum intel_arena_map map_mode);
+void intel_arena_get_buf(struct intel_arena *arena, struct scratch_buf *buf);
+void intel_arena_free(struct intel_arena *arena);
+
+#endif /* INTEL_ARENA_H */
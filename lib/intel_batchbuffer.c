@@ -30,46 +30,313 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 
 #include "drm.h"
 #include "drmtest.h"
 #include "intel_batchbuffer.h"
 #include "intel_bufmgr.h"
 #include "intel_chipset.h"
+#include "intel_decode_tables.h"
+#include "intel_profile.h"
 #include "intel_reg.h"
 #include <i915_drm.h>
 
+/* Opt-in flush latency instrumentation.  Set INTEL_BATCH_STATS=1 to
+ * record the latency of every batch submission into a log-bucketed
+ * histogram, or INTEL_BATCH_STATS=sync to additionally wait for
+ * rendering after each flush and record the sync latency too.  The
+ * histograms are dumped to stderr at exit with tail percentiles, which
+ * a mean can't show.  Off by default so uninstrumented runs pay only a
+ * single integer test per flush.
+ */
+struct flush_hist {
+	const char *name;
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+	/* [log2 group][16 linear sub-buckets], microseconds */
+	uint64_t buckets[64][16];
+};
+
+static struct flush_hist submit_hist = { "submit" };
+static struct flush_hist sync_hist = { "sync" };
+static int batch_stats;	/* 0 = off, 1 = submit, 2 = submit + sync */
+
+/* INTEL_VALIDATE_BATCH=1 runs every flushed batch through the
+ * table-driven validator before submission; =abort additionally kills
+ * the process on the first malformed batch, while the batch contents
+ * are still around to inspect in the core. */
+static int batch_validate;	/* 0 = off, 1 = warn, 2 = abort */
+
+static uint64_t
+stats_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static void
+hist_record(struct flush_hist *h, uint64_t us)
+{
+	int msb, group, sub;
+
+	h->count++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+
+	if (us < 16) {
+		group = 0;
+		sub = us;
+	} else {
+		msb = 63 - __builtin_clzll(us);
+		group = msb - 3;
+		sub = (us >> (msb - 4)) & 15;
+	}
+	h->buckets[group][sub]++;
+}
+
+/* upper bound of the first bucket that covers the requested quantile */
+static uint64_t
+hist_percentile(struct flush_hist *h, double pct)
+{
+	uint64_t target = h->count * pct / 100.0 + 0.5;
+	uint64_t seen = 0;
+	int group, sub;
+
+	for (group = 0; group < 64; group++) {
+		for (sub = 0; sub < 16; sub++) {
+			seen += h->buckets[group][sub];
+			if (seen >= target) {
+				if (group == 0)
+					return sub + 1;
+				return (uint64_t)(16 + sub + 1) << (group - 1);
+			}
+		}
+	}
+
+	return h->max_us;
+}
+
+static void
+hist_dump(struct flush_hist *h)
+{
+	if (h->count == 0)
+		return;
+
+	fprintf(stderr,
+		"batch %s latency: %"PRIu64" flushes, mean %.1fus, "
+		"p50 %"PRIu64"us, p90 %"PRIu64"us, p99 %"PRIu64"us, "
+		"p99.9 %"PRIu64"us, max %"PRIu64"us\n",
+		h->name, h->count, (double)h->total_us / h->count,
+		hist_percentile(h, 50), hist_percentile(h, 90),
+		hist_percentile(h, 99), hist_percentile(h, 99.9),
+		h->max_us);
+}
+
+static void
+batch_stats_exit(void)
+{
+	hist_dump(&submit_hist);
+	hist_dump(&sync_hist);
+}
+
+static void
+batch_stats_init(void)
+{
+	static int initialised;
+	const char *env;
+
+	if (initialised)
+		return;
+	initialised = 1;
+
+	env = getenv("INTEL_VALIDATE_BATCH");
+	if (env && *env != '\0' && strcmp(env, "0") != 0)
+		batch_validate = strcmp(env, "abort") == 0 ? 2 : 1;
+
+	env = getenv("INTEL_BATCH_STATS");
+	if (!env || *env == '\0' || strcmp(env, "0") == 0)
+		return;
+
+	batch_stats = strcmp(env, "sync") == 0 ? 2 : 1;
+	atexit(batch_stats_exit);
+}
+
+/* Shadow batch capture (see intel_batchbuffer.h for the format).  The
+ * whole file is mapped up front so recording a batch touches no
+ * allocator and issues no syscall - being file-backed is what lets the
+ * kernel write the pages out even if we never get to exit cleanly. */
+static struct intel_batch_capture_header *capture_hdr;
+static uint8_t *capture_area;
+
+static void
+batch_capture_init(uint32_t devid)
+{
+	static int initialised;
+	const char *env;
+	uint32_t size = 64;
+	void *map;
+	int fd;
+
+	if (initialised)
+		return;
+	initialised = 1;
+
+	env = getenv("INTEL_BATCH_CAPTURE");
+	if (!env || *env == '\0')
+		return;
+
+	if (getenv("INTEL_BATCH_CAPTURE_MB"))
+		size = atoi(getenv("INTEL_BATCH_CAPTURE_MB"));
+	if (size < 1)
+		size = 1;
+	size *= 1024*1024;
+
+	fd = open(env, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "batch capture: cannot open %s: %s\n",
+			env, strerror(errno));
+		return;
+	}
+	if (ftruncate(fd, sizeof(*capture_hdr) + size)) {
+		fprintf(stderr, "batch capture: cannot size %s: %s\n",
+			env, strerror(errno));
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, sizeof(*capture_hdr) + size,
+		   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "batch capture: cannot map %s: %s\n",
+			env, strerror(errno));
+		return;
+	}
+
+	capture_hdr = map;
+	capture_hdr->magic = INTEL_BATCH_CAPTURE_MAGIC;
+	capture_hdr->version = INTEL_BATCH_CAPTURE_VERSION;
+	capture_hdr->devid = devid;
+	capture_hdr->ring_size = size;
+	capture_hdr->write_offset = 0;
+	capture_hdr->seq = 0;
+	capture_area = (uint8_t *)(capture_hdr + 1);
+}
+
+static void
+batch_capture_record(const uint8_t *buffer, unsigned int used, int ring)
+{
+	struct intel_batch_capture_record rec;
+	uint64_t off = capture_hdr->write_offset;
+	unsigned int total = sizeof(rec) + ((used + 7) & ~7);
+
+	if (total > capture_hdr->ring_size)
+		return;
+
+	if (off + total > capture_hdr->ring_size) {
+		/* zero the tail so the decoder doesn't pick up the
+		 * front half of an overwritten record there */
+		memset(capture_area + off, 0, capture_hdr->ring_size - off);
+		off = 0;
+	}
+
+	rec.magic = INTEL_BATCH_CAPTURE_REC_MAGIC;
+	rec.len = used;
+	rec.seq = capture_hdr->seq;
+	rec.time_us = stats_time_us();
+	rec.ring = ring;
+	rec.pad = 0;
+
+	memcpy(capture_area + off, &rec, sizeof(rec));
+	memcpy(capture_area + off + sizeof(rec), buffer, used);
+	memset(capture_area + off + sizeof(rec) + used, 0,
+	       total - sizeof(rec) - used);
+
+	capture_hdr->write_offset = off + total;
+	capture_hdr->seq++;
+}
+
 void
 intel_batchbuffer_reset(struct intel_batchbuffer *batch)
 {
+	int i;
+
 	if (batch->bo != NULL) {
-		drm_intel_bo_unreference(batch->bo);
+		/* Park the retired bo in the cache rather than handing it
+		 * back to the bufmgr on every flush. */
+		if (batch->bo_cache_count < BATCH_BO_CACHE_SZ)
+			batch->bo_cache[batch->bo_cache_count++] = batch->bo;
+		else
+			drm_intel_bo_unreference(batch->bo);
 		batch->bo = NULL;
 	}
 
-	batch->bo = drm_intel_bo_alloc(batch->bufmgr, "batchbuffer",
-				       BATCH_SZ, 4096);
+	/* Only recycle bos the GPU has retired; a busy bo still holds the
+	 * commands of an in-flight batch. */
+	for (i = 0; i < batch->bo_cache_count; i++) {
+		if (!drm_intel_bo_busy(batch->bo_cache[i])) {
+			batch->bo = batch->bo_cache[i];
+			batch->bo_cache[i] =
+				batch->bo_cache[--batch->bo_cache_count];
+			break;
+		}
+	}
+
+	if (batch->bo == NULL)
+		batch->bo = drm_intel_bo_alloc(batch->bufmgr, "batchbuffer",
+					       batch->size, 4096);
 
 	batch->ptr = batch->buffer;
 }
 
 struct intel_batchbuffer *
-intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr, uint32_t devid)
+intel_batchbuffer_alloc_sized(drm_intel_bufmgr *bufmgr, uint32_t devid,
+			      unsigned int size)
 {
 	struct intel_batchbuffer *batch = calloc(sizeof(*batch), 1);
 
+	assert(size >= BATCH_SZ && size <= BATCH_SZ_MAX);
+	assert((size & 4095) == 0);
+
+	batch_stats_init();
+	batch_capture_init(devid);
+
 	batch->bufmgr = bufmgr;
 	batch->devid = devid;
+	batch->caps = intel_get_device_caps(devid);
+	batch->size = size;
+	batch->buffer = malloc(size);
+	assert(batch->buffer);
 	intel_batchbuffer_reset(batch);
 
 	return batch;
 }
 
+struct intel_batchbuffer *
+intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr, uint32_t devid)
+{
+	return intel_batchbuffer_alloc_sized(bufmgr, devid, BATCH_SZ);
+}
+
 void
 intel_batchbuffer_free(struct intel_batchbuffer *batch)
 {
+	int i;
+
+	for (i = 0; i < batch->bo_cache_count; i++)
+		drm_intel_bo_unreference(batch->bo_cache[i]);
 	drm_intel_bo_unreference(batch->bo);
 	batch->bo = NULL;
+	free(batch->buffer);
 	free(batch);
 }
 
@@ -83,7 +350,7 @@ flush_on_ring_common(struct intel_batchbuffer *batch, int ring)
 	if (used == 0)
 		return 0;
 
-	if (IS_GEN5(batch->devid)) {
+	if (batch->caps->gen == 5) {
 		/* emit gen5 w/a without batch space checks - we reserve that
 		 * already. */
 		*(uint32_t *) (batch->ptr) = CMD_POLY_STIPPLE_OFFSET << 16;
@@ -100,6 +367,14 @@ flush_on_ring_common(struct intel_batchbuffer *batch, int ring)
 	/* Mark the end of the buffer. */
 	*(uint32_t *)(batch->ptr) = MI_BATCH_BUFFER_END; /* noop */
 	batch->ptr += 4;
+
+	if (batch_validate &&
+	    intel_validate_batch(intel_decode_table_get(batch->caps->gen),
+				 (uint32_t *)batch->buffer,
+				 (batch->ptr - batch->buffer) / 4) &&
+	    batch_validate > 1)
+		abort();
+
 	return batch->ptr - batch->buffer;
 }
 
@@ -107,17 +382,35 @@ void
 intel_batchbuffer_flush_on_ring(struct intel_batchbuffer *batch, int ring)
 {
 	unsigned int used = flush_on_ring_common(batch, ring);
+	uint64_t start = 0;
+	INTEL_PROFILE_BEGIN(batch_flush);
 
 	if (used == 0)
 		return;
 
+	if (capture_area)
+		batch_capture_record(batch->buffer, used, ring);
+
 	do_or_die(drm_intel_bo_subdata(batch->bo, 0, used, batch->buffer));
 
 	batch->ptr = NULL;
 
+	if (batch_stats)
+		start = stats_time_us();
+
 	do_or_die(drm_intel_bo_mrb_exec(batch->bo, used, NULL, 0, 0, ring));
 
+	if (batch_stats) {
+		hist_record(&submit_hist, stats_time_us() - start);
+		if (batch_stats > 1) {
+			start = stats_time_us();
+			drm_intel_bo_wait_rendering(batch->bo);
+			hist_record(&sync_hist, stats_time_us() - start);
+		}
+	}
+
 	intel_batchbuffer_reset(batch);
+	INTEL_PROFILE_END(batch_flush);
 }
 
 void
@@ -126,19 +419,35 @@ intel_batchbuffer_flush_with_context(struct intel_batchbuffer *batch,
 {
 	int ret;
 	unsigned int used = flush_on_ring_common(batch, I915_EXEC_RENDER);
+	uint64_t start = 0;
 
 	if (used == 0)
 		return;
 
+	if (capture_area)
+		batch_capture_record(batch->buffer, used, I915_EXEC_RENDER);
+
 	ret = drm_intel_bo_subdata(batch->bo, 0, used, batch->buffer);
 	assert(ret == 0);
 
 	batch->ptr = NULL;
 
+	if (batch_stats)
+		start = stats_time_us();
+
 	ret = drm_intel_gem_bo_context_exec(batch->bo, context, used,
 					    I915_EXEC_RENDER);
 	assert(ret == 0);
 
+	if (batch_stats) {
+		hist_record(&submit_hist, stats_time_us() - start);
+		if (batch_stats > 1) {
+			start = stats_time_us();
+			drm_intel_bo_wait_rendering(batch->bo);
+			hist_record(&sync_hist, stats_time_us() - start);
+		}
+	}
+
 	intel_batchbuffer_reset(batch);
 }
 
@@ -146,11 +455,112 @@ void
 intel_batchbuffer_flush(struct intel_batchbuffer *batch)
 {
 	int ring = 0;
-	if (HAS_BLT_RING(batch->devid))
+	if (batch->caps->has_blt)
 		ring = I915_EXEC_BLT;
 	intel_batchbuffer_flush_on_ring(batch, ring);
 }
 
+/* Ring load balancing.  A short window of bos touched by the last few
+ * submissions per ring is kept referenced; how many of them are still
+ * busy is a cheap proxy for ring occupancy (one I915_GEM_BUSY ioctl
+ * each, no register access).  Ties go to the ring with fewer submitted
+ * bytes so a ring never starves while the other drains. */
+#define BALANCE_TRACK 8
+
+static struct ring_load {
+	drm_intel_bo *recent[BALANCE_TRACK];
+	int next;
+	struct intel_ring_stats stats;
+} ring_load[INTEL_RING_COUNT];
+
+static const unsigned int ring_exec_flag[INTEL_RING_COUNT] = {
+	I915_EXEC_RENDER,
+	I915_EXEC_BLT,
+};
+
+int
+intel_ring_occupancy(int ring)
+{
+	struct ring_load *load = &ring_load[ring];
+	int i, busy = 0;
+
+	for (i = 0; i < BALANCE_TRACK; i++) {
+		if (load->recent[i] == NULL)
+			continue;
+		if (drm_intel_bo_busy(load->recent[i])) {
+			busy++;
+		} else {
+			/* retired; drop the reference so the bo recycles */
+			drm_intel_bo_unreference(load->recent[i]);
+			load->recent[i] = NULL;
+		}
+	}
+
+	return busy;
+}
+
+const struct intel_ring_stats *
+intel_ring_get_stats(int ring)
+{
+	return &ring_load[ring].stats;
+}
+
+void
+intel_ring_account(int ring, drm_intel_bo *bo, unsigned int bytes)
+{
+	struct ring_load *load = &ring_load[ring];
+
+	if (bo) {
+		if (load->recent[load->next])
+			drm_intel_bo_unreference(load->recent[load->next]);
+		load->recent[load->next] = bo; /* takes the caller's ref */
+		load->next = (load->next + 1) % BALANCE_TRACK;
+	}
+
+	load->stats.batches++;
+	load->stats.bytes += bytes;
+}
+
+int
+intel_ring_select(struct intel_batchbuffer *batch, int affinity)
+{
+	int render, blt;
+
+	if (!batch->caps->has_blt)
+		return INTEL_RING_RENDER;
+	if (affinity != INTEL_RING_ANY)
+		return affinity;
+
+	render = intel_ring_occupancy(INTEL_RING_RENDER);
+	blt = intel_ring_occupancy(INTEL_RING_BLT);
+	if (render != blt)
+		return render < blt ? INTEL_RING_RENDER : INTEL_RING_BLT;
+
+	/* both equally deep; steer by submitted bytes so neither starves */
+	return ring_load[INTEL_RING_RENDER].stats.bytes <=
+	       ring_load[INTEL_RING_BLT].stats.bytes ?
+	       INTEL_RING_RENDER : INTEL_RING_BLT;
+}
+
+void
+intel_batchbuffer_flush_balanced(struct intel_batchbuffer *batch, int affinity)
+{
+	unsigned int used = batch->ptr - batch->buffer;
+	int ring = intel_ring_select(batch, affinity);
+	drm_intel_bo *bo;
+
+	/* flush swaps in a fresh bo; hold the submitted one for tracking */
+	bo = batch->bo;
+	drm_intel_bo_reference(bo);
+
+	intel_batchbuffer_flush_on_ring(batch, ring_exec_flag[ring]);
+
+	if (used)
+		intel_ring_account(ring, bo, used);
+	else
+		drm_intel_bo_unreference(bo);
+}
+
 
 /*  This is the only way buffers get added to the validate list.
  */
@@ -162,11 +572,11 @@ intel_batchbuffer_emit_reloc(struct intel_batchbuffer *batch,
 {
 	int ret;
 
-	if (batch->ptr - batch->buffer > BATCH_SZ)
+	if ((unsigned int)(batch->ptr - batch->buffer) > batch->size)
 		printf("bad relocation ptr %p map %p offset %d size %d\n",
 		       batch->ptr, batch->buffer,
 		       (int)(batch->ptr - batch->buffer),
-		       BATCH_SZ);
+		       batch->size);
 
 	if (fenced)
 		ret = drm_intel_bo_emit_reloc_fence(batch->bo, batch->ptr - batch->buffer,
@@ -190,42 +600,54 @@ intel_batchbuffer_data(struct intel_batchbuffer *batch,
 	batch->ptr += bytes;
 }
 
-void
-intel_copy_bo(struct intel_batchbuffer *batch,
-	      drm_intel_bo *dst_bo, drm_intel_bo *src_bo,
-	      int width, int height)
+static void
+emit_copy_blit(struct intel_batchbuffer *batch,
+	       drm_intel_bo *dst_bo, uint32_t dst_pitch, int dst_x, int dst_y,
+	       drm_intel_bo *src_bo, uint32_t src_pitch, int src_x, int src_y,
+	       int width, int height, int bpp)
 {
 	uint32_t src_tiling, dst_tiling, swizzle;
-	uint32_t src_pitch, dst_pitch;
 	uint32_t cmd_bits = 0;
+	uint32_t br13 = 0;
 
 	drm_intel_bo_get_tiling(src_bo, &src_tiling, &swizzle);
 	drm_intel_bo_get_tiling(dst_bo, &dst_tiling, &swizzle);
 
-	src_pitch = width * 4;
-	if (IS_965(batch->devid) && src_tiling != I915_TILING_NONE) {
+	switch (bpp) {
+	case 8:
+		break;
+	case 16:
+		br13 |= 1 << 24;
+		break;
+	case 32:
+		br13 |= 3 << 24;
+		cmd_bits |= XY_SRC_COPY_BLT_WRITE_ALPHA |
+			XY_SRC_COPY_BLT_WRITE_RGB;
+		break;
+	default:
+		assert(0);
+	}
+
+	if (batch->caps->gen >= 4 && src_tiling != I915_TILING_NONE) {
 		src_pitch /= 4;
 		cmd_bits |= XY_SRC_COPY_BLT_SRC_TILED;
 	}
 
-	dst_pitch = width * 4;
-	if (IS_965(batch->devid) && dst_tiling != I915_TILING_NONE) {
+	if (batch->caps->gen >= 4 && dst_tiling != I915_TILING_NONE) {
 		dst_pitch /= 4;
 		cmd_bits |= XY_SRC_COPY_BLT_DST_TILED;
 	}
 
 	BEGIN_BATCH(8);
 	OUT_BATCH(XY_SRC_COPY_BLT_CMD |
-		  XY_SRC_COPY_BLT_WRITE_ALPHA |
-		  XY_SRC_COPY_BLT_WRITE_RGB |
 		  cmd_bits);
-	OUT_BATCH((3 << 24) | /* 32 bits */
+	OUT_BATCH(br13 |
 		  (0xcc << 16) | /* copy ROP */
 		  dst_pitch);
-	OUT_BATCH(0); /* dst x1,y1 */
-	OUT_BATCH((height << 16) | width); /* dst x2,y2 */
+	OUT_BATCH((dst_y << 16) | dst_x); /* dst x1,y1 */
+	OUT_BATCH(((dst_y + height) << 16) | (dst_x + width)); /* dst x2,y2 */
 	OUT_RELOC(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
-	OUT_BATCH(0); /* src x1,y1 */
+	OUT_BATCH((src_y << 16) | src_x); /* src x1,y1 */
 	OUT_BATCH(src_pitch);
 	OUT_RELOC(src_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
 	ADVANCE_BATCH();
@@ -233,9 +655,232 @@ intel_copy_bo(struct intel_batchbuffer *batch,
 	intel_batchbuffer_flush(batch);
 }
 
+void
+intel_copy_bo(struct intel_batchbuffer *batch,
+	      drm_intel_bo *dst_bo, drm_intel_bo *src_bo,
+	      int width, int height)
+{
+	emit_copy_blit(batch,
+		       dst_bo, width * 4, 0, 0,
+		       src_bo, width * 4, 0, 0,
+		       width, height, 32);
+}
+
+/* Below this many bytes the blitter setup plus ring round trip costs
+ * more than just mapping both objects and copying on the CPU. */
+#define COPY_CPU_THRESHOLD 4096
+
+static void
+copy_rect_cpu(drm_intel_bo *dst_bo, uint32_t dst_pitch, int dst_x, int dst_y,
+	      drm_intel_bo *src_bo, uint32_t src_pitch, int src_x, int src_y,
+	      int width, int height, int cpp)
+{
+	uint8_t *src, *dst;
+	int y;
+
+	do_or_die(drm_intel_bo_map(src_bo, false));
+	do_or_die(drm_intel_bo_map(dst_bo, true));
+
+	src = src_bo->virtual;
+	dst = dst_bo->virtual;
+
+	for (y = 0; y < height; y++)
+		memcpy(dst + (dst_y + y) * dst_pitch + dst_x * cpp,
+		       src + (src_y + y) * src_pitch + src_x * cpp,
+		       width * cpp);
+
+	drm_intel_bo_unmap(dst_bo);
+	drm_intel_bo_unmap(src_bo);
+}
+
+void
+intel_copy_rect(struct intel_batchbuffer *batch,
+		drm_intel_bo *dst_bo, uint32_t dst_pitch, int dst_x, int dst_y,
+		drm_intel_bo *src_bo, uint32_t src_pitch, int src_x, int src_y,
+		int width, int height, int bpp)
+{
+	uint32_t src_tiling, dst_tiling, swizzle;
+	int cpp = bpp / 8;
+
+	drm_intel_bo_get_tiling(src_bo, &src_tiling, &swizzle);
+	drm_intel_bo_get_tiling(dst_bo, &dst_tiling, &swizzle);
+
+	/* The CPU view of a tiled object doesn't match its blitted
+	 * layout, so tiling always goes to the blitter. */
+	if (src_tiling == I915_TILING_NONE &&
+	    dst_tiling == I915_TILING_NONE &&
+	    (uint64_t)width * height * cpp < COPY_CPU_THRESHOLD) {
+		/* submit anything batched up so the memcpy can't
+		 * overtake it; the maps then wait for rendering */
+		intel_batchbuffer_flush(batch);
+		copy_rect_cpu(dst_bo, dst_pitch, dst_x, dst_y,
+			      src_bo, src_pitch, src_x, src_y,
+			      width, height, cpp);
+		return;
+	}
+
+	emit_copy_blit(batch,
+		       dst_bo, dst_pitch, dst_x, dst_y,
+		       src_bo, src_pitch, src_x, src_y,
+		       width, height, bpp);
+}
+
+uint32_t *
+intel_readback_map(struct intel_readback *rb,
+		   struct intel_batchbuffer *batch,
+		   drm_intel_bo *bo, int width, int height)
+{
+	uint32_t tiling, swizzle, size;
+
+	assert(rb->mapped == NULL);
+
+	drm_intel_bo_get_tiling(bo, &tiling, &swizzle);
+	if (tiling == I915_TILING_NONE) {
+		/* no detiling needed; the cached map waits for rendering
+		 * and clflushes on non-LLC parts by itself */
+		do_or_die(drm_intel_bo_map(bo, 0));
+		rb->mapped = bo;
+		return bo->virtual;
+	}
+
+	/* one staging bo serves every readback, grown as needed */
+	size = (uint32_t)width * height * 4;
+	if (rb->linear_bo && rb->linear_size < size) {
+		drm_intel_bo_unreference(rb->linear_bo);
+		rb->linear_bo = NULL;
+	}
+	if (rb->linear_bo == NULL) {
+		rb->linear_bo = drm_intel_bo_alloc(bo->bufmgr, "readback",
+						   size, 4096);
+		rb->linear_size = size;
+	}
+
+	intel_copy_bo(batch, rb->linear_bo, bo, width, height);
+
+	do_or_die(drm_intel_bo_map(rb->linear_bo, 0));
+	rb->mapped = rb->linear_bo;
+	return rb->linear_bo->virtual;
+}
+
+void
+intel_readback_unmap(struct intel_readback *rb)
+{
+	assert(rb->mapped);
+	drm_intel_bo_unmap(rb->mapped);
+	rb->mapped = NULL;
+}
+
+void
+intel_readback_fini(struct intel_readback *rb)
+{
+	assert(rb->mapped == NULL);
+	if (rb->linear_bo) {
+		drm_intel_bo_unreference(rb->linear_bo);
+		rb->linear_bo = NULL;
+	}
+}
+
 void
 intel_batchbuffer_emit_mi_flush(struct intel_batchbuffer *batch)
 {
 	intel_batchbuffer_require_space(batch, 4);
 	intel_batchbuffer_emit_dword(batch, MI_FLUSH);
 }
+
+struct intel_batch_template *
+intel_batch_template_create(drm_intel_bufmgr *bufmgr,
+			    const uint32_t *dwords, int count)
+{
+	struct intel_batch_template *tmpl = calloc(sizeof(*tmpl), 1);
+	uint32_t tail[2] = { MI_BATCH_BUFFER_END, 0 };
+
+	assert(tmpl);
+	assert(count > 0 && count * 4 <= BATCH_SZ - 8);
+
+	tmpl->bo = drm_intel_bo_alloc(bufmgr, "batch template",
+				      BATCH_SZ, 4096);
+	assert(tmpl->bo);
+
+	/* one upload, reused by every exec */
+	do_or_die(drm_intel_bo_subdata(tmpl->bo, 0, count * 4, dwords));
+	do_or_die(drm_intel_bo_subdata(tmpl->bo, count * 4, sizeof(tail),
+				       tail));
+	tmpl->used = (count * 4 + sizeof(tail) + 7) & ~7;
+
+	return tmpl;
+}
+
+int
+intel_batch_template_add_reloc(struct intel_batch_template *tmpl,
+			       int dword, drm_intel_bo *target,
+			       uint32_t read_domains,
+			       uint32_t write_domain, uint32_t delta)
+{
+	int slot = tmpl->num_relocs;
+
+	assert(slot < INTEL_TEMPLATE_MAX_RELOCS);
+	assert(dword * 4 < tmpl->used);
+
+	tmpl->relocs[slot].dword = dword;
+	tmpl->relocs[slot].target = target;
+	tmpl->relocs[slot].read_domains = read_domains;
+	tmpl->relocs[slot].write_domain = write_domain;
+	tmpl->relocs[slot].delta = delta;
+	tmpl->num_relocs++;
+	tmpl->relocs_dirty = 1;
+
+	return slot;
+}
+
+void
+intel_batch_template_set_delta(struct intel_batch_template *tmpl,
+			       int slot, uint32_t delta)
+{
+	assert(slot < tmpl->num_relocs);
+
+	if (tmpl->relocs[slot].delta == delta)
+		return;
+
+	tmpl->relocs[slot].delta = delta;
+	tmpl->relocs_dirty = 1;
+}
+
+void
+intel_batch_template_set_dword(struct intel_batch_template *tmpl,
+			       int dword, uint32_t value)
+{
+	assert(dword * 4 < tmpl->used);
+
+	do_or_die(drm_intel_bo_subdata(tmpl->bo, dword * 4, 4, &value));
+}
+
+void
+intel_batch_template_exec(struct intel_batch_template *tmpl,
+			  unsigned int ring_flag)
+{
+	int i;
+
+	/* the kernel keeps the relocations from the previous submission,
+	 * so they only need re-emitting after an actual change */
+	if (tmpl->relocs_dirty) {
+		drm_intel_gem_bo_clear_relocs(tmpl->bo, 0);
+		for (i = 0; i < tmpl->num_relocs; i++)
+			do_or_die(drm_intel_bo_emit_reloc(tmpl->bo,
+					tmpl->relocs[i].dword * 4,
+					tmpl->relocs[i].target,
+					tmpl->relocs[i].delta,
+					tmpl->relocs[i].read_domains,
+					tmpl->relocs[i].write_domain));
+		tmpl->relocs_dirty = 0;
+	}
+
+	do_or_die(drm_intel_bo_mrb_exec(tmpl->bo, tmpl->used,
+					NULL, 0, 0, ring_flag));
+}
+
+void
+intel_batch_template_free(struct intel_batch_template *tmpl)
+{
+	drm_intel_bo_unreference(tmpl->bo);
+	free(tmpl);
+}
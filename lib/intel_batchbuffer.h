@@ -3,23 +3,36 @@
 
 #include <assert.h>
 #include "intel_bufmgr.h"
+#include "intel_chipset.h"
 
 #define BATCH_SZ 4096
+#define BATCH_SZ_MAX (256*1024)
 #define BATCH_RESERVED 16
 
+/* Retired batch bos are parked here and recycled on reset instead of
+ * round-tripping through the bufmgr for every flush. */
+#define BATCH_BO_CACHE_SZ 8
+
 struct intel_batchbuffer {
 	drm_intel_bufmgr *bufmgr;
 	uint32_t devid;
+	const struct intel_device_caps *caps;
 
 	drm_intel_bo *bo;
+	drm_intel_bo *bo_cache[BATCH_BO_CACHE_SZ];
+	int bo_cache_count;
 
-	uint8_t buffer[BATCH_SZ];
+	uint8_t *buffer;
+	unsigned int size;
 	uint8_t *ptr;
 	uint8_t *state;
 };
 
 struct intel_batchbuffer *intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr,
 						  uint32_t devid);
+struct intel_batchbuffer *intel_batchbuffer_alloc_sized(drm_intel_bufmgr *bufmgr,
+							uint32_t devid,
+							unsigned int size);
 
 void intel_batchbuffer_free(struct intel_batchbuffer *batch);
 
@@ -29,6 +42,38 @@ void intel_batchbuffer_flush_on_ring(struct intel_batchbuffer *batch, int ring);
 void intel_batchbuffer_flush_with_context(struct intel_batchbuffer *batch,
 					  drm_intel_context *context);
 
+/* Load-balanced submission for copy work.  Instead of a static ring
+ * choice, selection picks whichever of render/blt has the fewest
+ * recently submitted work items still busy - occupancy is sampled with
+ * I915_GEM_BUSY on a small window of tracked bos, so no register
+ * access is needed.  Since gen6 the blitter only lives on the blt
+ * ring, so a balanced copy pairs XY_SRC_COPY on blt with a rendercopy
+ * on render; select the ring first, emit matching commands, and either
+ * flush through flush_balanced or account self-submitting work by
+ * hand.  Pass a ring index as affinity to force a ring (the work is
+ * still counted), or INTEL_RING_ANY to balance. */
+#define INTEL_RING_RENDER	0
+#define INTEL_RING_BLT		1
+#define INTEL_RING_COUNT	2
+#define INTEL_RING_ANY		(-1)
+
+struct intel_ring_stats {
+	uint64_t batches;
+	uint64_t bytes;
+};
+
+/* pick a ring for the next piece of work; honours the affinity */
+int intel_ring_select(struct intel_batchbuffer *batch, int affinity);
+/* record work submitted outside flush_balanced (e.g. rendercopy, which
+ * submits itself); bo should be one the work writes, or NULL to only
+ * bump the counters.  Takes over the caller's reference on bo. */
+void intel_ring_account(int ring, drm_intel_bo *bo, unsigned int bytes);
+void intel_batchbuffer_flush_balanced(struct intel_batchbuffer *batch,
+				      int affinity);
+/* recently submitted work items on the ring that are still busy */
+int intel_ring_occupancy(int ring);
+const struct intel_ring_stats *intel_ring_get_stats(int ring);
+
 void intel_batchbuffer_reset(struct intel_batchbuffer *batch);
 
 void intel_batchbuffer_data(struct intel_batchbuffer *batch,
@@ -50,7 +95,8 @@ void intel_batchbuffer_emit_reloc(struct intel_batchbuffer *batch,
 static inline int
 intel_batchbuffer_space(struct intel_batchbuffer *batch)
 {
-	return (BATCH_SZ - BATCH_RESERVED) - (batch->ptr - batch->buffer);
+	return (int)(batch->size - BATCH_RESERVED) -
+		(int)(batch->ptr - batch->buffer);
 }
 
 
@@ -66,7 +112,7 @@ static inline void
 intel_batchbuffer_require_space(struct intel_batchbuffer *batch,
                                 unsigned int sz)
 {
-	assert(sz < BATCH_SZ - BATCH_RESERVED);
+	assert(sz < batch->size - BATCH_RESERVED);
 	if (intel_batchbuffer_space(batch) < sz)
 		intel_batchbuffer_flush(batch);
 }
@@ -103,6 +149,108 @@ void intel_copy_bo(struct intel_batchbuffer *batch,
 		   drm_intel_bo *dst_bo, drm_intel_bo *src_bo,
 		   int width, int height);
 
+/* Parameterized rectangle copy.  Pitches are in bytes, coordinates and
+ * width/height in pixels, bpp is 8, 16 or 32.  Small untiled copies are
+ * done with a mapped memcpy instead of a blit, so a 128-byte move
+ * doesn't pay for full blitter setup and execution; tiled or large
+ * rectangles go through XY_SRC_COPY_BLT as usual.  Either way the copy
+ * is ordered against previously batched commands. */
+void intel_copy_rect(struct intel_batchbuffer *batch,
+		     drm_intel_bo *dst_bo, uint32_t dst_pitch,
+		     int dst_x, int dst_y,
+		     drm_intel_bo *src_bo, uint32_t src_pitch,
+		     int src_x, int src_y,
+		     int width, int height, int bpp);
+
+/* Fast verification readback.  Tiled objects are detiled by blitting
+ * into a reusable linear bo which is then read through a cached CPU
+ * mapping; untiled objects skip the blit and map cached directly.
+ * Either path avoids streaming reads through an uncached GTT view,
+ * which on non-LLC parts costs more than an extra blit by an order of
+ * magnitude.  Zero-initialize the struct, then map/unmap per check and
+ * fini once at the end. */
+struct intel_readback {
+	drm_intel_bo *linear_bo;
+	uint32_t linear_size;
+	drm_intel_bo *mapped;
+};
+
+uint32_t *intel_readback_map(struct intel_readback *rb,
+			     struct intel_batchbuffer *batch,
+			     drm_intel_bo *bo, int width, int height);
+void intel_readback_unmap(struct intel_readback *rb);
+void intel_readback_fini(struct intel_readback *rb);
+
+/* Reusable batch template: the dwords are uploaded to a bo once and the
+ * same bo is resubmitted, so loops firing an identical batch skip the
+ * per-submission emission and copy.  Relocation slots are registered up
+ * front and only re-emitted when a target or delta actually changes;
+ * individual payload dwords can be patched in place (which waits for
+ * the bo to idle, so patch between syncs, not behind in-flight execs). */
+#define INTEL_TEMPLATE_MAX_RELOCS 8
+
+struct intel_batch_template {
+	drm_intel_bo *bo;
+	int used;	/* bytes, including the tail */
+
+	int num_relocs;
+	int relocs_dirty;
+	struct {
+		int dword;
+		drm_intel_bo *target;
+		uint32_t read_domains;
+		uint32_t write_domain;
+		uint32_t delta;
+	} relocs[INTEL_TEMPLATE_MAX_RELOCS];
+};
+
+struct intel_batch_template *
+intel_batch_template_create(drm_intel_bufmgr *bufmgr,
+			    const uint32_t *dwords, int count);
+int intel_batch_template_add_reloc(struct intel_batch_template *tmpl,
+				   int dword, drm_intel_bo *target,
+				   uint32_t read_domains,
+				   uint32_t write_domain, uint32_t delta);
+void intel_batch_template_set_delta(struct intel_batch_template *tmpl,
+				    int slot, uint32_t delta);
+void intel_batch_template_set_dword(struct intel_batch_template *tmpl,
+				    int dword, uint32_t value);
+void intel_batch_template_exec(struct intel_batch_template *tmpl,
+			       unsigned int ring_flag);
+void intel_batch_template_free(struct intel_batch_template *tmpl);
+
+/* Shadow batch capture.  Setting INTEL_BATCH_CAPTURE=<file> makes every
+ * flushed batch also be copied - dwords, ring and timestamp - into a
+ * fixed-size file-backed ring before submission, oldest batches being
+ * overwritten once the file is full (INTEL_BATCH_CAPTURE_MB picks the
+ * size, default 64).  The file is mmap'd once up front, so the steady
+ * state costs a memcpy and no allocation, and because the mapping is
+ * file-backed the tail of a soak run survives a GPU hang or a SIGKILL.
+ * Decode with intel_capture_decode. */
+#define INTEL_BATCH_CAPTURE_MAGIC	0x50434249 /* "IBCP" */
+#define INTEL_BATCH_CAPTURE_VERSION	1
+#define INTEL_BATCH_CAPTURE_REC_MAGIC	0x48435442 /* "BTCH" */
+
+struct intel_batch_capture_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t ring_size;	/* bytes of record area after the header */
+	uint64_t write_offset;	/* next byte to be written in the area */
+	uint64_t seq;		/* batches captured so far */
+};
+
+/* followed by len payload bytes (the batch dwords), padded to 8 bytes;
+ * a record never crosses the end of the area, the writer wraps instead */
+struct intel_batch_capture_record {
+	uint32_t magic;
+	uint32_t len;
+	uint64_t seq;
+	uint64_t time_us;
+	uint32_t ring;		/* I915_EXEC_* ring flag */
+	uint32_t pad;
+};
+
 #define I915_EXEC_CONTEXT_ID_MASK      (0xffffffff)
 #define i915_execbuffer2_set_context_id(eb2, context) \
 	(eb2).rsvd1 = context & I915_EXEC_CONTEXT_ID_MASK
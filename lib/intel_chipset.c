@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+
+#include "intel_chipset.h"
+
+/* Flattened view of the IS_GEN, IS_MOBILE and HAS_* macros, one record per
+ * device, sorted by devid.  The ring and llc flags follow from the
+ * generation except for Valleyview, which has no LLC.  When adding a
+ * PCI id above, add its row here too.
+ */
+#define CAPS(id, g, m, l) \
+	{ id, g, m, (g) >= 6, (g) >= 5, l }
+
+static const struct intel_device_caps caps_table[] = {
+	CAPS(PCI_CHIP_ILD_G,			5, 0, 0),
+	CAPS(PCI_CHIP_ILM_G,			5, 0, 0),
+	CAPS(PCI_CHIP_SANDYBRIDGE_GT1,		6, 0, 1),
+	CAPS(PCI_CHIP_SANDYBRIDGE_M_GT1,	6, 0, 1),
+	CAPS(PCI_CHIP_SANDYBRIDGE_S,		6, 0, 1),
+	CAPS(PCI_CHIP_SANDYBRIDGE_GT2,		6, 0, 1),
+	CAPS(PCI_CHIP_SANDYBRIDGE_M_GT2,	6, 0, 1),
+	CAPS(PCI_CHIP_SANDYBRIDGE_GT2_PLUS,	6, 0, 1),
+	CAPS(PCI_CHIP_SANDYBRIDGE_M_GT2_PLUS,	6, 0, 1),
+	CAPS(PCI_CHIP_IVYBRIDGE_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_IVYBRIDGE_M_GT1,		7, 1, 1),
+	CAPS(PCI_CHIP_IVYBRIDGE_S,		7, 0, 1),
+	CAPS(PCI_CHIP_IVYBRIDGE_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_IVYBRIDGE_M_GT2,		7, 1, 1),
+	CAPS(PCI_CHIP_IVYBRIDGE_S_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_M_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_S_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_M_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_S_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_GT2_PLUS,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_M_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_S_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_M_GT1,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_S_GT1,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_M_GT2,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_S_GT2,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_M_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_ULT_S_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_M_GT1,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_S_GT1,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_M_GT2,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_S_GT2,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_M_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_SDV_S_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_GT1,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_M_GT1,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_S_GT1,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_GT2,		7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_M_GT2,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_S_GT2,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_M_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_HASWELL_CRW_S_GT2_PLUS,	7, 0, 1),
+	CAPS(PCI_CHIP_VALLEYVIEW_PO,		7, 0, 0),
+	CAPS(PCI_CHIP_845_G,			2, 0, 0),
+	CAPS(PCI_CHIP_I865_G,			2, 0, 0),
+	CAPS(PCI_CHIP_I915_G,			3, 0, 0),
+	CAPS(PCI_CHIP_E7221_G,			3, 0, 0),
+	CAPS(PCI_CHIP_I915_GM,			3, 1, 0),
+	CAPS(PCI_CHIP_I945_G,			3, 0, 0),
+	CAPS(PCI_CHIP_I945_GM,			3, 1, 0),
+	CAPS(PCI_CHIP_I945_GME,			3, 1, 0),
+	CAPS(PCI_CHIP_I946_GZ,			4, 0, 0),
+	CAPS(PCI_CHIP_I965_G_1,			4, 0, 0),
+	CAPS(PCI_CHIP_I965_Q,			4, 0, 0),
+	CAPS(PCI_CHIP_I965_G,			4, 0, 0),
+	CAPS(PCI_CHIP_Q35_G,			3, 0, 0),
+	CAPS(PCI_CHIP_G33_G,			3, 0, 0),
+	CAPS(PCI_CHIP_Q33_G,			3, 0, 0),
+	CAPS(PCI_CHIP_I965_GM,			4, 1, 0),
+	CAPS(PCI_CHIP_I965_GME,			4, 1, 0),
+	CAPS(PCI_CHIP_GM45_GM,			4, 1, 0),
+	CAPS(PCI_CHIP_IGD_E_G,			4, 0, 0),
+	CAPS(PCI_CHIP_Q45_G,			4, 0, 0),
+	CAPS(PCI_CHIP_G45_G,			4, 0, 0),
+	CAPS(PCI_CHIP_G41_G,			4, 0, 0),
+	CAPS(PCI_CHIP_I830_M,			2, 0, 0),
+	CAPS(PCI_CHIP_I855_GM,			2, 1, 0),
+	CAPS(PCI_CHIP_IGD_G,			3, 1, 0),
+	CAPS(PCI_CHIP_IGD_GM,			3, 1, 0),
+};
+
+#define NUM_CAPS (sizeof(caps_table) / sizeof(caps_table[0]))
+
+const struct intel_device_caps *intel_get_device_caps(uint32_t devid)
+{
+	static const struct intel_device_caps *last;
+	static struct intel_device_caps fallback;
+	int lo = 0, hi = NUM_CAPS - 1;
+
+	if (last && last->devid == devid)
+		return last;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if (caps_table[mid].devid == devid) {
+			last = &caps_table[mid];
+			return last;
+		}
+		if (caps_table[mid].devid < devid)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	/* ids missing from the table go through the macro chains once,
+	 * so callers never see a NULL */
+	fallback.devid = devid;
+	fallback.gen = IS_GEN7(devid) ? 7 : IS_GEN6(devid) ? 6 :
+		       IS_GEN5(devid) ? 5 : IS_GEN4(devid) ? 4 :
+		       IS_GEN3(devid) ? 3 : IS_GEN2(devid) ? 2 : 0;
+	fallback.mobile = IS_MOBILE(devid);
+	fallback.has_blt = HAS_BLT_RING(devid);
+	fallback.has_bsd = HAS_BSD_RING(devid);
+	fallback.has_llc = fallback.gen >= 6 && !IS_VALLEYVIEW(devid);
+	last = &fallback;
+
+	return last;
+}
@@ -25,6 +25,11 @@
  *
  */
 
+#ifndef INTEL_CHIPSET_H
+#define INTEL_CHIPSET_H
+
+#include <stdint.h>
+
 #define PCI_CHIP_I810			0x7121
 #define PCI_CHIP_I810_DC100		0x7123
 #define PCI_CHIP_I810_E			0x7125
@@ -268,3 +273,22 @@
 
 #define IS_CRESTLINE(devid)	(devid == PCI_CHIP_I965_GM || \
 				 devid == PCI_CHIP_I965_GME)
+
+/* The macros above expand to long devid comparison chains which are
+ * re-evaluated on every use; in tight submission loops that adds up.
+ * intel_get_device_caps() resolves a devid once against a sorted table
+ * (binary search, last hit cached) and hands back one record with the
+ * commonly tested properties, for hot paths to read directly.  Never
+ * returns NULL - unknown ids are resolved through the macros. */
+struct intel_device_caps {
+	uint32_t devid;
+	uint8_t gen;
+	unsigned mobile:1;
+	unsigned has_blt:1;
+	unsigned has_bsd:1;
+	unsigned has_llc:1;
+};
+
+const struct intel_device_caps *intel_get_device_caps(uint32_t devid);
+
+#endif /* INTEL_CHIPSET_H */
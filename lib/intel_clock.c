@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <time.h>
+#include <assert.h>
+
+#include "intel_clock.h"
+
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
+
+static double ticks_per_ns;
+static uint64_t read_overhead;
+
+#if defined(__i386__) || defined(__x86_64__)
+#define HAVE_TSC 1
+static uint64_t read_tsc(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+static uint64_t read_raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t intel_clock_now(void)
+{
+#ifdef HAVE_TSC
+	return read_tsc();
+#else
+	return read_raw_ns();
+#endif
+}
+
+void intel_clock_init(void)
+{
+	uint64_t t0, t1, c0, c1;
+	int i;
+
+	if (ticks_per_ns != 0.0)
+		return;
+
+#ifdef HAVE_TSC
+	/* Spin for a few ms against CLOCK_MONOTONIC_RAW to learn the TSC
+	 * rate; the raw clock is immune to NTP slewing, so a short window
+	 * is good enough for benchmark purposes. */
+	t0 = read_raw_ns();
+	c0 = read_tsc();
+	do {
+		t1 = read_raw_ns();
+	} while (t1 - t0 < 10000000);
+	c1 = read_tsc();
+
+	ticks_per_ns = (double)(c1 - c0) / (t1 - t0);
+#else
+	ticks_per_ns = 1.0;
+#endif
+
+	/* The cheapest observed back-to-back delta is the closest we can
+	 * get to the true cost of taking one timestamp. */
+	read_overhead = UINT64_MAX;
+	for (i = 0; i < 1024; i++) {
+		c0 = intel_clock_now();
+		c1 = intel_clock_now();
+		if (c1 - c0 < read_overhead)
+			read_overhead = c1 - c0;
+	}
+}
+
+uint64_t intel_clock_overhead(void)
+{
+	intel_clock_init();
+	return read_overhead;
+}
+
+double intel_clock_to_ns(uint64_t ticks)
+{
+	intel_clock_init();
+	return ticks / ticks_per_ns;
+}
+
+double intel_clock_to_us(uint64_t ticks)
+{
+	return intel_clock_to_ns(ticks) / 1000.0;
+}
+
+void intel_clock_phase_start(struct intel_clock_phase *phase)
+{
+	intel_clock_init();
+	phase->start = intel_clock_now();
+}
+
+void intel_clock_phase_stop(struct intel_clock_phase *phase)
+{
+	uint64_t delta = intel_clock_now() - phase->start;
+
+	if (delta > read_overhead)
+		delta -= read_overhead;
+	else
+		delta = 0;
+
+	phase->total += delta;
+	phase->count++;
+}
+
+double intel_clock_phase_us(const struct intel_clock_phase *phase)
+{
+	return intel_clock_to_us(phase->total);
+}
+
+void intel_clock_hist_add(struct intel_clock_hist *hist, uint64_t ticks)
+{
+	int group, sub;
+
+	hist->count++;
+	hist->total += ticks;
+	if (ticks > hist->max)
+		hist->max = ticks;
+
+	if (ticks < 16) {
+		group = 0;
+		sub = ticks;
+	} else {
+		int msb = 63 - __builtin_clzll(ticks);
+
+		group = msb - 3;
+		sub = (ticks >> (msb - 4)) & 15;
+	}
+	if (group >= 48)
+		group = 47;
+
+	hist->buckets[group][sub]++;
+}
+
+uint64_t intel_clock_hist_percentile(const struct intel_clock_hist *hist,
+				     double pct)
+{
+	uint64_t target = hist->count * pct / 100.0;
+	uint64_t seen = 0;
+	int group, sub;
+
+	for (group = 0; group < 48; group++) {
+		for (sub = 0; sub < 16; sub++) {
+			seen += hist->buckets[group][sub];
+			if (seen > target) {
+				if (group == 0)
+					return sub + 1;
+				return (uint64_t)(16 + sub + 1) << (group - 1);
+			}
+		}
+	}
+
+	return hist->max;
+}
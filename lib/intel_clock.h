@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_CLOCK_H
+#define INTEL_CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * Shared timing core for benchmarks.  Timestamps come from the TSC
+ * where available and are calibrated once against CLOCK_MONOTONIC_RAW,
+ * giving sub-microsecond resolution that per-file gettimeofday deltas
+ * can't; the cost of taking a timestamp is self-measured at init so
+ * fine-grained phases can subtract it.
+ */
+
+/* optional - the other entry points calibrate on first use */
+void intel_clock_init(void);
+
+/* raw timestamp in clock ticks; cheap enough for inner loops */
+uint64_t intel_clock_now(void);
+
+/* ticks one intel_clock_now() call costs, for subtracting */
+uint64_t intel_clock_overhead(void);
+
+double intel_clock_to_ns(uint64_t ticks);
+double intel_clock_to_us(uint64_t ticks);
+
+/* accumulating phase timer; the read overhead is subtracted per stop */
+struct intel_clock_phase {
+	const char *name;
+	uint64_t start;
+	uint64_t total;
+	uint64_t count;
+};
+
+void intel_clock_phase_start(struct intel_clock_phase *phase);
+void intel_clock_phase_stop(struct intel_clock_phase *phase);
+double intel_clock_phase_us(const struct intel_clock_phase *phase);
+
+/* log2-bucketed latency histogram with linear sub-buckets, sized for
+ * anything from nanoseconds to minutes */
+struct intel_clock_hist {
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint64_t buckets[48][16];
+};
+
+void intel_clock_hist_add(struct intel_clock_hist *hist, uint64_t ticks);
+/* upper bound in ticks of the bucket covering the quantile */
+uint64_t intel_clock_hist_percentile(const struct intel_clock_hist *hist,
+				     double pct);
+
+#endif /* INTEL_CLOCK_H */
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "intel_crc32c.h"
+
+#define CRC32C_POLY 0x82f63b78
+
+static uint32_t crc32c_table[256];
+static int crc32c_table_built;
+
+static void crc32c_build_table(void)
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+		crc32c_table[i] = crc;
+	}
+	crc32c_table_built = 1;
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	if (!crc32c_table_built)
+		crc32c_build_table();
+
+	while (len--)
+		crc = (crc >> 8) ^ crc32c_table[(crc ^ *p++) & 0xff];
+
+	return crc;
+}
+
+#ifdef __x86_64__
+static uint32_t crc32c_hw(uint32_t crc, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len >= 4) {
+		uint32_t v = *(const uint32_t *)p;
+
+		__asm__("crc32l %1, %0" : "+r" (crc) : "rm" (v));
+		p += 4;
+		len -= 4;
+	}
+	while (len--) {
+		__asm__("crc32b %1, %0" : "+r" (crc) : "rm" (*p));
+		p++;
+	}
+
+	return crc;
+}
+
+static int have_sse4_2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	__asm__("cpuid"
+		: "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+		: "a" (1), "c" (0));
+
+	return (ecx >> 20) & 1;
+}
+#endif /* __x86_64__ */
+
+static uint32_t (*crc32c_func)(uint32_t, const void *, size_t);
+
+uint32_t intel_crc32c(uint32_t crc, const void *data, size_t len)
+{
+	if (!crc32c_func) {
+#ifdef __x86_64__
+		crc32c_func = have_sse4_2() ? crc32c_hw : crc32c_sw;
+#else
+		crc32c_func = crc32c_sw;
+#endif
+	}
+
+	return crc32c_func(crc, data, len);
+}
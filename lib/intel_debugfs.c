@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "intel_debugfs.h"
+
+/* Per-boot path cache.  Resolving the i915 debugfs or sysfs directory
+ * means probing mount points and up to 16 minors - trivial once, but
+ * minutes of pure path probing across the thousands of invocations of
+ * a CI run.  Resolved paths are stashed in /var/run (tmpfs, so the
+ * cache dies with the boot) and revalidated with a single stat before
+ * being trusted; writing the cache is best effort, non-root consumers
+ * simply keep probing. */
+#define PATH_CACHE "/var/run/intel_path_cache"
+
+static int cache_lookup(const char *key, char *path, size_t len)
+{
+	char line[160], want[32];
+	size_t want_len;
+	FILE *file;
+	int found = -1;
+
+	file = fopen(PATH_CACHE, "r");
+	if (file == NULL)
+		return -1;
+
+	snprintf(want, sizeof(want), "%s ", key);
+	want_len = strlen(want);
+	while (fgets(line, sizeof(line), file)) {
+		char *nl = strchr(line, '\n');
+
+		if (nl)
+			*nl = '\0';
+		if (strncmp(line, want, want_len) == 0 &&
+		    strlen(line + want_len) < len) {
+			strcpy(path, line + want_len);
+			found = 0;
+			break;
+		}
+	}
+	fclose(file);
+
+	return found;
+}
+
+static void cache_store(const char *key, const char *path)
+{
+	char lines[4][160];
+	char tmp[sizeof(PATH_CACHE) + 16];
+	size_t key_len = strlen(key);
+	FILE *file;
+	int i, count = 0;
+
+	/* carry over the other keys, replace ours */
+	file = fopen(PATH_CACHE, "r");
+	if (file) {
+		while (count < 4 &&
+		       fgets(lines[count], sizeof(lines[count]), file)) {
+			if (strncmp(lines[count], key, key_len) == 0 &&
+			    lines[count][key_len] == ' ')
+				continue;
+			count++;
+		}
+		fclose(file);
+	}
+
+	/* write-and-rename so a concurrent reader never sees a torn file */
+	snprintf(tmp, sizeof(tmp), "%s.%d", PATH_CACHE, getpid());
+	file = fopen(tmp, "w");
+	if (file == NULL)
+		return;
+	for (i = 0; i < count; i++)
+		fputs(lines[i], file);
+	fprintf(file, "%s %s\n", key, path);
+	if (fclose(file) == 0)
+		rename(tmp, PATH_CACHE);
+	else
+		unlink(tmp);
+}
+
+static int debugfs_valid(const char *path)
+{
+	char probe[192];
+	struct stat st;
+
+	snprintf(probe, sizeof(probe), "%s/i915_error_state", path);
+	return stat(probe, &st) == 0;
+}
+
+int intel_debugfs_path(char *path, size_t len)
+{
+	static const char *roots[] = {
+		"/sys/kernel/debug/dri",
+		"/debug/dri",
+	};
+	unsigned i;
+	int minor;
+
+	if (cache_lookup("debugfs", path, len) == 0 && debugfs_valid(path))
+		return 0;
+
+	/* the i915 minor isn't necessarily 0; probe for the directory
+	 * that actually carries the driver's files */
+	for (i = 0; i < sizeof(roots)/sizeof(roots[0]); i++) {
+		for (minor = 0; minor < 16; minor++) {
+			snprintf(path, len, "%s/%d", roots[i], minor);
+			if (debugfs_valid(path)) {
+				cache_store("debugfs", path);
+				return 0;
+			}
+		}
+	}
+
+	path[0] = '\0';
+	return -1;
+}
+
+static int sysfs_card_valid(const char *path)
+{
+	char link[192], target[192];
+	ssize_t got;
+
+	snprintf(link, sizeof(link), "%s/device/driver", path);
+	got = readlink(link, target, sizeof(target) - 1);
+	if (got < 0)
+		return 0;
+	target[got] = '\0';
+
+	return strstr(target, "i915") != NULL;
+}
+
+int intel_sysfs_card_path(char *path, size_t len)
+{
+	int minor;
+
+	if (cache_lookup("sysfs", path, len) == 0 && sysfs_card_valid(path))
+		return 0;
+
+	for (minor = 0; minor < 16; minor++) {
+		snprintf(path, len, "/sys/class/drm/card%d", minor);
+		if (sysfs_card_valid(path)) {
+			cache_store("sysfs", path);
+			return 0;
+		}
+	}
+
+	path[0] = '\0';
+	return -1;
+}
+
+int debugfs_file_open(struct debugfs_file *file, const char *name,
+		      size_t buf_size)
+{
+	char path[160];
+
+	if (intel_debugfs_path(path, sizeof(path) - strlen(name) - 2))
+		return -1;
+	strcat(path, "/");
+	strcat(path, name);
+
+	file->fd = open(path, O_RDONLY);
+	if (file->fd == -1)
+		return -1;
+
+	/* sized and touched up front so the sampling loop never faults */
+	file->buf_size = buf_size;
+	file->buf = malloc(buf_size + 1);
+	if (file->buf == NULL) {
+		close(file->fd);
+		file->fd = -1;
+		return -1;
+	}
+	memset(file->buf, 0, buf_size + 1);
+
+	return 0;
+}
+
+ssize_t debugfs_file_read(struct debugfs_file *file)
+{
+	ssize_t got;
+
+	/* pread at 0 rather than lseek+read: one syscall per sample, and
+	 * no reopen - debugfs show functions regenerate on each read */
+	got = pread(file->fd, file->buf, file->buf_size, 0);
+	if (got < 0)
+		return -errno;
+	file->buf[got] = '\0';
+
+	return got;
+}
+
+ssize_t debugfs_file_poll(struct debugfs_file *file)
+{
+	int flags = fcntl(file->fd, F_GETFL);
+	ssize_t got;
+
+	fcntl(file->fd, F_SETFL, flags | O_NONBLOCK);
+	got = debugfs_file_read(file);
+	fcntl(file->fd, F_SETFL, flags);
+
+	return got;
+}
+
+void debugfs_file_close(struct debugfs_file *file)
+{
+	if (file->fd != -1)
+		close(file->fd);
+	free(file->buf);
+	file->fd = -1;
+	file->buf = NULL;
+}
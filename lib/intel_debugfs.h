@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_DEBUGFS_H
+#define INTEL_DEBUGFS_H
+
+#include <sys/types.h>
+
+/* High-rate debugfs consumption: one open fd and one preallocated
+ * buffer per file, a single pread per sample.  Polling i915 debugfs
+ * files at kHz rates through stdio or shell cat loops spends more time
+ * in open/close and tiny buffered reads than in the kernel's show
+ * function. */
+
+struct debugfs_file {
+	int fd;
+	char *buf;
+	size_t buf_size;
+};
+
+/* Find the i915 debugfs directory, "" into @path on failure.  The
+ * result is cached per boot in /var/run and revalidated with one stat,
+ * so only the first invocation after boot pays for the probing. */
+int intel_debugfs_path(char *path, size_t len);
+
+/* same, for the i915 /sys/class/drm/cardN directory */
+int intel_sysfs_card_path(char *path, size_t len);
+
+int debugfs_file_open(struct debugfs_file *file, const char *name,
+		      size_t buf_size);
+/* one pread from offset 0; buffer is nul-terminated, returns bytes read */
+ssize_t debugfs_file_read(struct debugfs_file *file);
+/* like read, but O_NONBLOCK; returns -EAGAIN instead of blocking */
+ssize_t debugfs_file_poll(struct debugfs_file *file);
+void debugfs_file_close(struct debugfs_file *file);
+
+#endif /* INTEL_DEBUGFS_H */
@@ -0,0 +1,254 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+
+#include "intel_decode_tables.h"
+
+/* Length encodings used below:
+ *  - fixed_len for the single-dword MI commands,
+ *  - a len_mask/len_bias pair for everything carrying a DWord Length
+ *    field in the header.
+ */
+#define FIXED(n)	(n), 0, 0
+#define LEN_MI		0, 0x0000003f, 2
+#define LEN_2D		0, 0x000000ff, 2
+#define LEN_3D		0, 0x000000ff, 2
+#define LEN_GEN3_3D	0, 0x0003ffff, 2
+
+/* Client 0: MI commands, opcode in bits 28:23.  Stable across gens. */
+static const struct intel_decode_op mi_ops[] = {
+	{ 0x1f800000, 0x00 << 23, "MI_NOOP",			FIXED(1) },
+	{ 0x1f800000, 0x02 << 23, "MI_USER_INTERRUPT",		FIXED(1) },
+	{ 0x1f800000, 0x03 << 23, "MI_WAIT_FOR_EVENT",		FIXED(1) },
+	{ 0x1f800000, 0x04 << 23, "MI_FLUSH",			FIXED(1) },
+	{ 0x1f800000, 0x07 << 23, "MI_REPORT_HEAD",		FIXED(1) },
+	{ 0x1f800000, 0x0a << 23, "MI_BATCH_BUFFER_END",	FIXED(1) },
+	{ 0x1f800000, 0x16 << 23, "MI_SEMAPHORE_MBOX",		LEN_MI },
+	{ 0x1f800000, 0x18 << 23, "MI_SET_CONTEXT",		LEN_MI },
+	{ 0x1f800000, 0x20 << 23, "MI_STORE_DWORD_IMM",		LEN_MI },
+	{ 0x1f800000, 0x21 << 23, "MI_STORE_DWORD_INDEX",	LEN_MI },
+	{ 0x1f800000, 0x22 << 23, "MI_LOAD_REGISTER_IMM",	LEN_MI },
+	{ 0x1f800000, 0x24 << 23, "MI_STORE_REGISTER_MEM",	LEN_MI },
+	{ 0x1f800000, 0x26 << 23, "MI_FLUSH_DW",		LEN_MI },
+	{ 0x1f800000, 0x31 << 23, "MI_BATCH_BUFFER_START",	LEN_MI },
+};
+
+/* Client 2: 2D (blitter) commands, opcode in bits 28:22. */
+static const struct intel_decode_op blt_ops[] = {
+	{ 0x1fc00000, 0x40 << 22, "COLOR_BLT",			LEN_2D },
+	{ 0x1fc00000, 0x43 << 22, "SRC_COPY_BLT",		LEN_2D },
+	{ 0x1fc00000, 0x01 << 22, "XY_SETUP_BLT",		LEN_2D },
+	{ 0x1fc00000, 0x50 << 22, "XY_COLOR_BLT",		LEN_2D },
+	{ 0x1fc00000, 0x53 << 22, "XY_SRC_COPY_BLT",		LEN_2D },
+	{ 0x1fc00000, 0x71 << 22, "XY_MONO_SRC_COPY_IMM_BLT",	LEN_2D },
+};
+
+/* Client 3, gen2/3 style: top-level opcode in bits 28:24. */
+static const struct intel_decode_op gen3_3d_ops[] = {
+	{ 0x1f000000, 0x1f << 24, "PRIM3D",			LEN_GEN3_3D },
+	{ 0x1fff0000, (0x1d << 24) | (0x04 << 16),
+		      "3DSTATE_LOAD_STATE_IMMEDIATE_1",		LEN_3D },
+	{ 0x1fff0000, (0x1d << 24) | (0x00 << 16),
+		      "3DSTATE_MAP_STATE",			LEN_3D },
+	{ 0x1fff0000, (0x1d << 24) | (0x01 << 16),
+		      "3DSTATE_SAMPLER_STATE",			LEN_3D },
+	{ 0x1fff0000, (0x1d << 24) | (0x85 << 16),
+		      "3DSTATE_DEST_BUFFER_VARIABLES",		LEN_3D },
+	{ 0x1f000000, 0x1c << 24, "3DSTATE_SCISSOR/MISC",	FIXED(1) },
+};
+
+/* Client 3, gen4+ GFXPIPE style: opcode in bits 28:16, length in 7:0. */
+static const struct intel_decode_op gen4_3d_ops[] = {
+	{ 0x1fff0000, 0x69000000, "PIPELINE_SELECT",		FIXED(1) },
+	{ 0x1fff0000, 0x61010000, "STATE_BASE_ADDRESS",		LEN_3D },
+	{ 0x1fff0000, 0x61020000, "STATE_SIP",			LEN_3D },
+	{ 0x1fff0000, 0x76000000, "URB_FENCE",			LEN_3D },
+	{ 0x1fff0000, 0x79050000, "3DSTATE_DEPTH_BUFFER",	LEN_3D },
+	{ 0x1fff0000, 0x78000000, "3DSTATE_PIPELINED_POINTERS",	LEN_3D },
+	{ 0x1fff0000, 0x78010000, "3DSTATE_BINDING_TABLE_POINTERS", LEN_3D },
+	{ 0x1fff0000, 0x78080000, "3DSTATE_VERTEX_BUFFERS",	LEN_3D },
+	{ 0x1fff0000, 0x78090000, "3DSTATE_VERTEX_ELEMENTS",	LEN_3D },
+	{ 0x1fff0000, 0x780a0000, "3DSTATE_INDEX_BUFFER",	LEN_3D },
+	{ 0x1fff0000, 0x7a000000, "PIPE_CONTROL",		LEN_3D },
+	{ 0x1fff0000, 0x7b000000, "3DPRIMITIVE",		LEN_3D },
+};
+
+/* Client 3, gen6/7: the fixed function was split into per-stage state
+ * packets; only the ones that show up in practically every batch are
+ * named, the rest still decode with a correct length via the catch-all
+ * GFXPIPE entry. */
+static const struct intel_decode_op gen6_3d_ops[] = {
+	{ 0x1fff0000, 0x69000000, "PIPELINE_SELECT",		FIXED(1) },
+	{ 0x1fff0000, 0x61010000, "STATE_BASE_ADDRESS",		LEN_3D },
+	{ 0x1fff0000, 0x61020000, "STATE_SIP",			LEN_3D },
+	{ 0x1fff0000, 0x78080000, "3DSTATE_VERTEX_BUFFERS",	LEN_3D },
+	{ 0x1fff0000, 0x78090000, "3DSTATE_VERTEX_ELEMENTS",	LEN_3D },
+	{ 0x1fff0000, 0x780a0000, "3DSTATE_INDEX_BUFFER",	LEN_3D },
+	{ 0x1fff0000, 0x78100000, "3DSTATE_VS",			LEN_3D },
+	{ 0x1fff0000, 0x78110000, "3DSTATE_GS",			LEN_3D },
+	{ 0x1fff0000, 0x78120000, "3DSTATE_CLIP",		LEN_3D },
+	{ 0x1fff0000, 0x78130000, "3DSTATE_SF",			LEN_3D },
+	{ 0x1fff0000, 0x78140000, "3DSTATE_WM",			LEN_3D },
+	{ 0x1fff0000, 0x79050000, "3DSTATE_DEPTH_BUFFER",	LEN_3D },
+	{ 0x1fff0000, 0x7a000000, "PIPE_CONTROL",		LEN_3D },
+	{ 0x1fff0000, 0x7b000000, "3DPRIMITIVE",		LEN_3D },
+	/* catch-all so unknown state packets still skip correctly */
+	{ 0x18000000, 0x18000000, "GFXPIPE",			LEN_3D },
+};
+
+static const struct intel_decode_table gen3_table = {
+	.clients = {
+		[0] = { mi_ops, sizeof(mi_ops) / sizeof(mi_ops[0]) },
+		[2] = { blt_ops, sizeof(blt_ops) / sizeof(blt_ops[0]) },
+		[3] = { gen3_3d_ops,
+			sizeof(gen3_3d_ops) / sizeof(gen3_3d_ops[0]) },
+	},
+};
+
+static const struct intel_decode_table gen4_table = {
+	.clients = {
+		[0] = { mi_ops, sizeof(mi_ops) / sizeof(mi_ops[0]) },
+		[2] = { blt_ops, sizeof(blt_ops) / sizeof(blt_ops[0]) },
+		[3] = { gen4_3d_ops,
+			sizeof(gen4_3d_ops) / sizeof(gen4_3d_ops[0]) },
+	},
+};
+
+static const struct intel_decode_table gen6_table = {
+	.clients = {
+		[0] = { mi_ops, sizeof(mi_ops) / sizeof(mi_ops[0]) },
+		[2] = { blt_ops, sizeof(blt_ops) / sizeof(blt_ops[0]) },
+		[3] = { gen6_3d_ops,
+			sizeof(gen6_3d_ops) / sizeof(gen6_3d_ops[0]) },
+	},
+};
+
+const struct intel_decode_table *intel_decode_table_get(int gen)
+{
+	if (gen >= 6)
+		return &gen6_table;
+	if (gen >= 4)
+		return &gen4_table;
+	return &gen3_table;
+}
+
+static const struct intel_decode_op *
+decode_op_lookup(const struct intel_decode_table *table, uint32_t dword)
+{
+	const struct intel_decode_client *client =
+		&table->clients[dword >> 29];
+	int i;
+
+	for (i = 0; i < client->num_ops; i++)
+		if ((dword & client->ops[i].mask) == client->ops[i].cmd)
+			return &client->ops[i];
+
+	return NULL;
+}
+
+static int decode_op_len(const struct intel_decode_op *op, uint32_t dword)
+{
+	if (op->len_mask == 0)
+		return op->fixed_len;
+	return (dword & op->len_mask) + op->len_bias;
+}
+
+void intel_quick_decode_file(const struct intel_decode_table *table,
+			     const uint32_t *data, int count,
+			     uint32_t hw_offset, FILE *out)
+{
+	int i = 0, j, len;
+
+	while (i < count) {
+		const struct intel_decode_op *op =
+			decode_op_lookup(table, data[i]);
+
+		len = op ? decode_op_len(op, data[i]) : 1;
+		if (len < 1)
+			len = 1;
+		if (len > count - i)
+			len = count - i;
+
+		fprintf(out, "0x%08x: 0x%08x: %s\n", hw_offset + i * 4,
+			data[i], op ? op->name : "UNKNOWN");
+		for (j = 1; j < len; j++)
+			fprintf(out, "0x%08x: 0x%08x\n",
+				hw_offset + (i + j) * 4, data[i + j]);
+
+		i += len;
+	}
+}
+
+void intel_quick_decode(const struct intel_decode_table *table,
+			const uint32_t *data, int count,
+			uint32_t hw_offset)
+{
+	intel_quick_decode_file(table, data, count, hw_offset, stdout);
+}
+
+#define VALIDATE_MI_BATCH_BUFFER_END	(0xA << 23)
+
+int intel_validate_batch(const struct intel_decode_table *table,
+			 const uint32_t *data, int count)
+{
+	int i = 0, len, errors = 0;
+
+	while (i < count) {
+		const struct intel_decode_op *op =
+			decode_op_lookup(table, data[i]);
+
+		if (data[i] == VALIDATE_MI_BATCH_BUFFER_END)
+			return errors;
+
+		if (op == NULL) {
+			fprintf(stderr, "validate: unknown command 0x%08x "
+				"at dword %d\n", data[i], i);
+			errors++;
+			i++;
+			continue;
+		}
+
+		len = decode_op_len(op, data[i]);
+		if (len < 1) {
+			fprintf(stderr, "validate: %s at dword %d has "
+				"impossible length %d\n", op->name, i, len);
+			errors++;
+			i++;
+			continue;
+		}
+		if (len > count - i) {
+			fprintf(stderr, "validate: %s at dword %d runs %d "
+				"dwords past the end of the batch\n",
+				op->name, i, len - (count - i));
+			return errors + 1;
+		}
+
+		i += len;
+	}
+
+	fprintf(stderr, "validate: batch of %d dwords has no "
+		"MI_BATCH_BUFFER_END\n", count);
+	return errors + 1;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_DECODE_TABLES_H
+#define INTEL_DECODE_TABLES_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Compile-time command decode tables, one per chipset generation.
+ *
+ * These back the "quick" streaming mode of the decode tools: a table is
+ * selected once per file via intel_gen() and every subsequent dword is a
+ * straight table lookup (top-level index on the client bits, then a short
+ * scan), with no per-buffer context setup and no string resolution.  The
+ * output is a one-line mnemonic per instruction rather than the full
+ * field-by-field decode libdrm produces.
+ */
+
+struct intel_decode_op {
+	uint32_t mask;		/* opcode match: (dword & mask) == cmd */
+	uint32_t cmd;
+	const char *name;
+	int fixed_len;		/* used when len_mask is zero */
+	uint32_t len_mask;	/* else len = (dword & len_mask) + len_bias */
+	int len_bias;
+};
+
+struct intel_decode_client {
+	const struct intel_decode_op *ops;
+	int num_ops;
+};
+
+struct intel_decode_table {
+	/* indexed by the instruction client (dword >> 29) */
+	struct intel_decode_client clients[8];
+};
+
+const struct intel_decode_table *intel_decode_table_get(int gen);
+
+/* Streaming pass over a buffer: prints one line per instruction plus raw
+ * operand dwords, skipping operands by the length encoded in the header
+ * dword.  Unknown opcodes advance a single dword so the decode can't get
+ * stuck on garbage. */
+void intel_quick_decode(const struct intel_decode_table *table,
+			const uint32_t *data, int count,
+			uint32_t hw_offset);
+
+/* Same pass, but into the given stream instead of stdout, so decode
+ * output can be captured per buffer (e.g. by parallel workers writing
+ * to memstreams). */
+void intel_quick_decode_file(const struct intel_decode_table *table,
+			     const uint32_t *data, int count,
+			     uint32_t hw_offset, FILE *out);
+
+/* Single-pass client-side batch check against the same tables: every
+ * command must be a known opcode, its length field must keep it inside
+ * the batch, and the batch must terminate with MI_BATCH_BUFFER_END.
+ * Complaints go to stderr with dword offsets; the return value is the
+ * number of them.  Costs microseconds, which beats finding the same
+ * mistake via a kernel rejection or a hang plus error-state capture. */
+int intel_validate_batch(const struct intel_decode_table *table,
+			 const uint32_t *data, int count);
+
+#endif /* INTEL_DECODE_TABLES_H */
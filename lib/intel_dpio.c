@@ -29,27 +29,58 @@
 #include <stdio.h>
 #include <err.h>
 #include "intel_gpu_tools.h"
+#include "intel_wait.h"
 
-static uint32_t intel_display_reg_read(uint32_t reg)
+/* The pci device lookup walks the whole bus, so resolve the display
+ * register base once instead of on every side band access. */
+static uint32_t display_base = (uint32_t)-1;
+
+static uint32_t get_display_base(void)
 {
-	struct pci_device *dev = intel_get_pci_device();
+	if (display_base == (uint32_t)-1) {
+		struct pci_device *dev = intel_get_pci_device();
+
+		display_base = IS_VALLEYVIEW(dev->device_id) ?
+			VLV_DISPLAY_BASE : 0;
+	}
+
+	return display_base;
+}
 
-	if (IS_VALLEYVIEW(dev->device_id))
-		reg += VLV_DISPLAY_BASE;
+static uint32_t intel_display_reg_read(uint32_t reg)
+{
+	reg += get_display_base();
 	return (*(volatile uint32_t*)((volatile char*)mmio + reg));
 }
 
 static void intel_display_reg_write(uint32_t reg, uint32_t val)
 {
 	volatile uint32_t *ptr;
-	struct pci_device *dev = intel_get_pci_device();
 
-	if (IS_VALLEYVIEW(dev->device_id))
-		reg += VLV_DISPLAY_BASE;
+	reg += get_display_base();
 	ptr = (volatile uint32_t*)((volatile char*)mmio + reg);
 	*ptr = val;
 }
 
+/* Wait for the side band fabric to accept the next command.  A
+ * transaction normally completes in well under a microsecond, so the
+ * shared wait spins on the status before falling back to sleeping --
+ * otherwise every access in a sweep eats a full timer tick of slack. */
+static struct intel_wait dpio_wait;
+
+static int dpio_idle(void *unused)
+{
+	return !(intel_display_reg_read(DPIO_PKT) & DPIO_BUSY);
+}
+
+static void dpio_wait_ready(void)
+{
+	if (!dpio_wait.spin_limit)
+		intel_wait_init(&dpio_wait);
+
+	intel_wait_for(&dpio_wait, dpio_idle, NULL, 0);
+}
+
 /*
  * In SoCs like Valleyview some of the PLL & Lane control registers
  * can be accessed only through IO side band fabric called DPIO
@@ -57,19 +88,10 @@ static void intel_display_reg_write(uint32_t reg, uint32_t val)
 uint32_t
 intel_dpio_reg_read(uint32_t reg)
 {
-	/* Check whether the side band fabric is ready to accept commands */
-	do {
-		usleep(1);
-	} while (intel_display_reg_read(DPIO_PKT) & DPIO_BUSY);
-
-	intel_display_reg_write(DPIO_REG, reg);
-	intel_display_reg_write(DPIO_PKT, DPIO_RID |
-						DPIO_OP_READ | DPIO_PORTID | DPIO_BYTE);
-	do {
-		usleep(1);
-	} while (intel_display_reg_read(DPIO_PKT) & DPIO_BUSY);
-
-	return intel_display_reg_read(DPIO_DATA);
+	uint32_t val;
+
+	intel_dpio_reg_read_batch(&reg, &val, 1);
+	return val;
 }
 
 /*
@@ -79,16 +101,44 @@ intel_dpio_reg_read(uint32_t reg)
 void
 intel_dpio_reg_write(uint32_t reg, uint32_t val)
 {
-	/* Check whether the side band fabric is ready to accept commands */
-	do {
-		usleep(1);
-	} while (intel_display_reg_read(DPIO_PKT) & DPIO_BUSY);
-
-	intel_display_reg_write(DPIO_DATA, val);
-	intel_display_reg_write(DPIO_REG, reg);
-	intel_display_reg_write(DPIO_PKT, DPIO_RID |
-						DPIO_OP_WRITE | DPIO_PORTID | DPIO_BYTE);
-	do {
-		usleep(1);
-	} while (intel_display_reg_read(DPIO_PKT) & DPIO_BUSY);
+	intel_dpio_reg_write_batch(&reg, &val, 1);
+}
+
+/*
+ * Batched transactions: each transaction's trailing wait doubles as the
+ * next one's ready check, so a sweep of N registers pays for N waits
+ * instead of 2N, and the waits themselves mostly resolve in the spin
+ * phase when commands are issued back to back.
+ */
+void
+intel_dpio_reg_read_batch(const uint32_t *regs, uint32_t *vals, int count)
+{
+	int i;
+
+	dpio_wait_ready();
+
+	for (i = 0; i < count; i++) {
+		intel_display_reg_write(DPIO_REG, regs[i]);
+		intel_display_reg_write(DPIO_PKT, DPIO_RID |
+					DPIO_OP_READ | DPIO_PORTID | DPIO_BYTE);
+		dpio_wait_ready();
+		vals[i] = intel_display_reg_read(DPIO_DATA);
+	}
+}
+
+void
+intel_dpio_reg_write_batch(const uint32_t *regs, const uint32_t *vals,
+			   int count)
+{
+	int i;
+
+	dpio_wait_ready();
+
+	for (i = 0; i < count; i++) {
+		intel_display_reg_write(DPIO_DATA, vals[i]);
+		intel_display_reg_write(DPIO_REG, regs[i]);
+		intel_display_reg_write(DPIO_PKT, DPIO_RID |
+					DPIO_OP_WRITE | DPIO_PORTID | DPIO_BYTE);
+		dpio_wait_ready();
+	}
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "drm.h"
+#include "drmtest.h"
+#include "intel_batchbuffer.h"
+#include "intel_bufmgr.h"
+#include "intel_fingerprint.h"
+#include "intel_reg.h"
+#include <i915_drm.h>
+
+/* src XOR dst, GDI's SRCINVERT */
+#define FOLD_ROP 0x66
+
+/* one scratch bo serves every fingerprint, grown as needed; the folds
+ * trash it, so nothing of value lives there between calls */
+static drm_intel_bo *fold_bo;
+static uint32_t fold_size;
+
+static int is_pow2(int v)
+{
+	return v > 0 && (v & (v - 1)) == 0;
+}
+
+/* one halving fold inside the scratch bo: the right (or bottom) half is
+ * XORed onto the left (or top) half with a single blit */
+static void emit_fold(struct intel_batchbuffer *batch, uint32_t pitch,
+		      int dst_w, int dst_h, int src_x, int src_y)
+{
+	BEGIN_BATCH(8);
+	OUT_BATCH(XY_SRC_COPY_BLT_CMD |
+		  XY_SRC_COPY_BLT_WRITE_ALPHA |
+		  XY_SRC_COPY_BLT_WRITE_RGB);
+	OUT_BATCH((3 << 24) | /* 32 bits */
+		  (FOLD_ROP << 16) |
+		  pitch);
+	OUT_BATCH(0); /* dst x1,y1 */
+	OUT_BATCH((dst_h << 16) | dst_w);
+	OUT_RELOC(fold_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_BATCH((src_y << 16) | src_x);
+	OUT_BATCH(pitch);
+	OUT_RELOC(fold_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
+	ADVANCE_BATCH();
+}
+
+void
+intel_fingerprint_bo(struct intel_batchbuffer *batch, drm_intel_bo *bo,
+		     int width, int height, uint32_t digest[4])
+{
+	uint32_t pitch = width * 4;
+	uint32_t size = pitch * height;
+	int w, h;
+
+	assert(is_pow2(width) && is_pow2(height) && width >= 4);
+
+	if (fold_bo && fold_size < size) {
+		drm_intel_bo_unreference(fold_bo);
+		fold_bo = NULL;
+	}
+	if (fold_bo == NULL) {
+		fold_bo = drm_intel_bo_alloc(bo->bufmgr, "fingerprint",
+					     size, 4096);
+		fold_size = size;
+	}
+
+	/* the copy detiles, so the folds below see the linear view */
+	intel_copy_bo(batch, fold_bo, bo, width, height);
+
+	for (w = width; w > 4; w /= 2)
+		emit_fold(batch, pitch, w / 2, height, w / 2, 0);
+	for (h = height; h > 1; h /= 2)
+		emit_fold(batch, pitch, 4, h / 2, 0, h / 2);
+	intel_batchbuffer_flush(batch);
+
+	/* only these 16 bytes cross the bus */
+	do_or_die(drm_intel_bo_map(fold_bo, 0));
+	memcpy(digest, fold_bo->virtual, 16);
+	drm_intel_bo_unmap(fold_bo);
+}
+
+void
+intel_fingerprint_cpu(const uint32_t *data, int width, int height,
+		      uint32_t digest[4])
+{
+	int i;
+
+	assert(is_pow2(width) && is_pow2(height) && width >= 4);
+
+	/* with power-of-two dimensions the halving folds reduce a dword
+	 * at (x, y) to lane x & 3, so the fold order doesn't matter */
+	digest[0] = digest[1] = digest[2] = digest[3] = 0;
+	for (i = 0; i < width * height; i++)
+		digest[i & 3] ^= data[i];
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_FINGERPRINT_H
+#define INTEL_FINGERPRINT_H
+
+#include <stdint.h>
+
+#include "intel_bufmgr.h"
+
+struct intel_batchbuffer;
+
+/*
+ * GPU-side surface fingerprinting.
+ *
+ * The surface is reduced to a 128-bit digest on the GPU by XOR blits:
+ * a copy into a linear scratch bo (which also detiles), then log2
+ * halving folds with the XOR raster op until four dwords remain, and
+ * only those 16 bytes cross the bus.  For bus-bound verification loops
+ * that beats reading the whole surface back by the surface size.
+ *
+ * An XOR fold is a fingerprint, not a checksum: any single corrupt
+ * dword changes the digest, but two identical errors at fold-aliased
+ * positions cancel.  Width and height must be powers of two (width at
+ * least 4), which every blit test here already uses.
+ */
+
+/* digest of bo's width x height 32bpp contents, read back as 16 bytes */
+void intel_fingerprint_bo(struct intel_batchbuffer *batch, drm_intel_bo *bo,
+			  int width, int height, uint32_t digest[4]);
+
+/* the digest a linear surface with this content would produce, for
+ * computing expected values without any readback */
+void intel_fingerprint_cpu(const uint32_t *data, int width, int height,
+			   uint32_t digest[4]);
+
+#endif /* INTEL_FINGERPRINT_H */
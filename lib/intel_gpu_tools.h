@@ -39,20 +39,73 @@
 
 extern void *mmio;
 void intel_get_mmio(struct pci_device *pci_dev);
+/* Cross-process mapping registry; see intel_mmio.c.  Every mapper is
+ * counted in a shm descriptor, and an unbind helper can revoke the
+ * device so pollers notice before touching a stale BAR. */
+int intel_mmio_refcount(void);
+int intel_mmio_revoked(void);
+void intel_mmio_revoke(void);
+void intel_mmio_release(void);
 
 /* New style register access API */
 int intel_register_access_init(struct pci_device *pci_dev, int safe);
 void intel_register_access_fini(void);
+int intel_forcewake_get(void);
+void intel_forcewake_put(void);
 uint32_t intel_register_read(uint32_t reg);
 void intel_register_write(uint32_t reg, uint32_t val);
+
+/* Register write tracing; see intel_mmio.c.  While a trace is active
+ * every intel_register_write() appends one record; the crc field
+ * chains over the whole sequence so a replay can prove the log is the
+ * sequence that was recorded.  intel_reg_replay reads these back. */
+#define INTEL_REG_TRACE_MAGIC	0x54475249	/* "IRGT" little-endian */
+#define INTEL_REG_TRACE_VERSION	1
+
+struct intel_register_trace_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t pad;
+};
+
+struct intel_register_trace_record {
+	uint32_t reg;
+	uint32_t val;
+	uint64_t delta_us;	/* wait before this write; first is 0 */
+	uint32_t crc;		/* crc32c chained over all prior fields */
+};
+
+int intel_register_trace_start(const char *path);
+void intel_register_trace_stop(void);
+/* One-shot snapshot of a register list; see intel_mmio.c */
+struct intel_register_burst {
+	int count;
+	const volatile uint32_t **srcs;
+	uint32_t *vals;
+};
+void intel_register_burst_init(struct intel_register_burst *burst,
+			       const uint32_t *regs, int count);
+void intel_register_burst_capture(struct intel_register_burst *burst);
+void intel_register_burst_fini(struct intel_register_burst *burst);
+/* Opt-in read cache for dump-everything tools; see intel_mmio.c */
+void intel_register_cache_enable(void);
+void intel_register_cache_invalidate(void);
+void intel_register_cache_disable(void);
+uint32_t intel_register_read_cached(uint32_t reg);
 /* Following functions are relevant only for SoCs like Valleyview */
 uint32_t intel_dpio_reg_read(uint32_t reg);
 void intel_dpio_reg_write(uint32_t reg, uint32_t val);
+void intel_dpio_reg_read_batch(const uint32_t *regs, uint32_t *vals,
+			       int count);
+void intel_dpio_reg_write_batch(const uint32_t *regs, const uint32_t *vals,
+				int count);
 
 #define INTEL_RANGE_RSVD	(0<<0) /*  Shouldn't be read or written */
 #define INTEL_RANGE_READ	(1<<0)
 #define INTEL_RANGE_WRITE	(1<<1)
 #define INTEL_RANGE_RW		(INTEL_RANGE_READ | INTEL_RANGE_WRITE)
+#define INTEL_RANGE_WAKE	(1<<2) /* needs forcewake on gen6+ */
 #define INTEL_RANGE_END		(1<<31)
 
 struct intel_register_range {
@@ -101,4 +154,15 @@ void intel_check_pch(void);
 
 #define HAS_CPT (pch == PCH_CPT)
 
+/* devid, stepping and pch type resolved once per process, with the
+ * config space reads batched and the result persisted alongside the pci
+ * slot cache so later launches skip the config cycles entirely */
+struct intel_device_identity {
+	uint32_t devid;
+	uint8_t stepping;
+	enum pch_type pch_type;
+};
+
+const struct intel_device_identity *intel_get_device_identity(void);
+
 #endif /* INTEL_GPU_TOOLS_H */
@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "intel_measure.h"
+
+/* enough samples for the warmup window plus meaningful statistics */
+#define MEASURE_MIN_SAMPLES	16
+#define WARMUP_WINDOW		5
+#define WARMUP_REL_SD		0.05
+
+/* two-sided 95% t values for df 1..30; 1.96 beyond */
+static const double t95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+	2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+	2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+	2.048, 2.045, 2.042,
+};
+
+static double t95_for(int df)
+{
+	if (df < 1)
+		return 0;
+	if (df <= (int)(sizeof(t95)/sizeof(t95[0])))
+		return t95[df - 1];
+	return 1.960;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static double mean_of(const double *v, int n)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += v[i];
+	return sum / n;
+}
+
+static double sd_of(const double *v, int n, double mean)
+{
+	double var = 0;
+	int i;
+
+	if (n < 2)
+		return 0;
+	for (i = 0; i < n; i++)
+		var += (v[i] - mean) * (v[i] - mean);
+	return sqrt(var / (n - 1));
+}
+
+static double median_of(double *sorted, int n)
+{
+	if (n & 1)
+		return sorted[n / 2];
+	return (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+/* the first index where a WARMUP_WINDOW-wide slice has settled to
+ * below WARMUP_REL_SD relative deviation; the cold cache and clock
+ * ramp samples before it are not part of the steady state.  Capped at
+ * a quarter of the run so a workload that never settles still
+ * contributes most of its samples. */
+static int find_warmup(const double *v, int n)
+{
+	int w, cap = n / 4;
+
+	for (w = 0; w <= cap; w++) {
+		double m, sd;
+
+		if (w + WARMUP_WINDOW > n)
+			break;
+		m = mean_of(v + w, WARMUP_WINDOW);
+		sd = sd_of(v + w, WARMUP_WINDOW, m);
+		if (m != 0 && sd / m < WARMUP_REL_SD)
+			return w;
+	}
+
+	return cap;
+}
+
+void intel_measure_run(intel_measure_fn fn, void *data,
+		       double min_seconds, int max_samples,
+		       struct intel_measure_result *result)
+{
+	struct timeval start, now;
+	double *samples, *work;
+	double med, mad, cutoff;
+	int n = 0, kept, i;
+
+	if (max_samples < MEASURE_MIN_SAMPLES)
+		max_samples = MEASURE_MIN_SAMPLES;
+
+	samples = malloc(max_samples * sizeof(*samples));
+	work = malloc(max_samples * sizeof(*work));
+	assert(samples && work);
+
+	gettimeofday(&start, NULL);
+	while (n < max_samples) {
+		samples[n++] = fn(data);
+
+		if (n < MEASURE_MIN_SAMPLES)
+			continue;
+		gettimeofday(&now, NULL);
+		if (now.tv_sec - start.tv_sec +
+		    (now.tv_usec - start.tv_usec) / 1e6 >= min_seconds)
+			break;
+	}
+
+	memset(result, 0, sizeof(*result));
+	result->total = n;
+	result->warmup = find_warmup(samples, n);
+
+	/* outlier rejection: median +- 3 scaled MADs of the warm part */
+	kept = n - result->warmup;
+	memcpy(work, samples + result->warmup, kept * sizeof(*work));
+	qsort(work, kept, sizeof(*work), cmp_double);
+	med = median_of(work, kept);
+	for (i = 0; i < kept; i++)
+		work[i] = fabs(work[i] - med);
+	qsort(work, kept, sizeof(*work), cmp_double);
+	mad = median_of(work, kept);
+	cutoff = 3 * 1.4826 * mad;
+
+	result->min = result->max = med;
+	kept = 0;
+	for (i = result->warmup; i < n; i++) {
+		if (mad != 0 && fabs(samples[i] - med) > cutoff) {
+			result->rejected++;
+			continue;
+		}
+		work[kept++] = samples[i];
+		if (samples[i] < result->min)
+			result->min = samples[i];
+		if (samples[i] > result->max)
+			result->max = samples[i];
+	}
+
+	result->kept = kept;
+	result->mean = mean_of(work, kept);
+	result->sd = sd_of(work, kept, result->mean);
+	if (kept > 1)
+		result->ci95 = t95_for(kept - 1) * result->sd / sqrt(kept);
+
+	free(work);
+	free(samples);
+}
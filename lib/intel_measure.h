@@ -0,0 +1,57 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_MEASURE_H
+#define INTEL_MEASURE_H
+
+/* The canonical benchmark loop.
+ *
+ * intel_measure_run() calls fn() repeatedly - each call returns one
+ * sample of whatever is being measured - for at least min_seconds and
+ * at most max_samples, then discards the cold leading samples (the
+ * first point where a sliding window's relative deviation settles),
+ * rejects outliers more than three scaled median absolute deviations
+ * from the median, and reports the mean of what is left with a 95%
+ * confidence interval.  One noisy run becomes a number two kernels can
+ * be compared on.
+ */
+
+struct intel_measure_result {
+	int total;	/* samples collected */
+	int warmup;	/* leading samples discarded as cold */
+	int rejected;	/* outliers discarded */
+	int kept;	/* samples the statistics are over */
+	double mean;
+	double sd;
+	double ci95;	/* half-width of the 95% interval */
+	double min, max;	/* of the kept samples */
+};
+
+typedef double (*intel_measure_fn)(void *data);
+
+void intel_measure_run(intel_measure_fn fn, void *data,
+		       double min_seconds, int max_samples,
+		       struct intel_measure_result *result);
+
+#endif /* INTEL_MEASURE_H */
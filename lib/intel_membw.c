@@ -0,0 +1,188 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "intel_clock.h"
+#include "intel_membw.h"
+
+/* Buffers several times any LLC so the streams always miss, chunks
+ * small enough that pacing sleeps stay in the sub-millisecond range. */
+#define MEMBW_BUF_SIZE	(64 << 20)
+#define MEMBW_CHUNK	(1 << 20)
+#define MEMBW_MAX_THREADS 16
+
+struct membw_worker {
+	pthread_t thread;
+	char *buf;
+	uint64_t bytes_per_sec;	/* 0 = unpaced */
+	unsigned long long bytes_done;
+};
+
+static struct membw_worker workers[MEMBW_MAX_THREADS];
+static int num_workers;
+static volatile int membw_running;
+
+static void stream_chunk(char *dst, int size)
+{
+#ifdef __SSE2__
+	/* non-temporal stores: pressure on the bus, not the cache */
+	__m128i v = _mm_set1_epi32(0x5a5a5a5a);
+	char *end = dst + size;
+
+	while (dst < end) {
+		_mm_stream_si128((__m128i *)dst, v);
+		_mm_stream_si128((__m128i *)(dst + 16), v);
+		_mm_stream_si128((__m128i *)(dst + 32), v);
+		_mm_stream_si128((__m128i *)(dst + 48), v);
+		dst += 64;
+	}
+	_mm_sfence();
+#else
+	memset(dst, 0x5a, size);
+#endif
+}
+
+static void *membw_thread(void *arg)
+{
+	struct membw_worker *worker = arg;
+	int offset = 0;
+
+	while (membw_running) {
+		uint64_t start = intel_clock_now();
+
+		stream_chunk(worker->buf + offset, MEMBW_CHUNK);
+		worker->bytes_done += MEMBW_CHUNK;
+
+		offset += MEMBW_CHUNK;
+		if (offset >= MEMBW_BUF_SIZE)
+			offset = 0;
+
+		if (worker->bytes_per_sec) {
+			/* sleep off the rest of this chunk's time slot */
+			uint64_t budget_ns = (uint64_t)MEMBW_CHUNK *
+				1000000000ull / worker->bytes_per_sec;
+			uint64_t spent_ns =
+				intel_clock_to_ns(intel_clock_now() - start);
+
+			if (spent_ns < budget_ns)
+				usleep((budget_ns - spent_ns) / 1000);
+		}
+	}
+
+	return NULL;
+}
+
+int intel_membw_start(double gbps, int num_threads)
+{
+	uint64_t per_thread_rate = 0;
+	int i;
+
+	if (membw_running)
+		return 0;
+
+	if (num_threads <= 0)
+		num_threads = sysconf(_SC_NPROCESSORS_ONLN) / 2 ?: 1;
+	if (num_threads > MEMBW_MAX_THREADS)
+		num_threads = MEMBW_MAX_THREADS;
+
+	if (gbps > 0)
+		per_thread_rate = (uint64_t)(gbps * 1e9) / num_threads;
+
+	membw_running = 1;
+	for (i = 0; i < num_threads; i++) {
+		struct membw_worker *worker = &workers[i];
+
+		worker->buf = malloc(MEMBW_BUF_SIZE);
+		if (worker->buf == NULL)
+			break;
+		worker->bytes_per_sec = per_thread_rate;
+		worker->bytes_done = 0;
+		if (pthread_create(&worker->thread, NULL,
+				   membw_thread, worker)) {
+			free(worker->buf);
+			break;
+		}
+	}
+	num_workers = i;
+
+	if (num_workers == 0)
+		membw_running = 0;
+
+	return num_workers;
+}
+
+void intel_membw_stop(void)
+{
+	int i;
+
+	if (!membw_running)
+		return;
+
+	membw_running = 0;
+	for (i = 0; i < num_workers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		free(workers[i].buf);
+	}
+	num_workers = 0;
+}
+
+unsigned long long intel_membw_bytes(void)
+{
+	unsigned long long total = 0;
+	int i;
+
+	for (i = 0; i < num_workers; i++)
+		total += workers[i].bytes_done;
+
+	return total;
+}
+
+void intel_membw_from_env(void)
+{
+	const char *gbps_str = getenv("INTEL_MEMBW_GBPS");
+	const char *threads_str = getenv("INTEL_MEMBW_THREADS");
+	int started;
+
+	if (gbps_str == NULL || membw_running)
+		return;
+
+	started = intel_membw_start(atof(gbps_str),
+				    threads_str ? atoi(threads_str) : 0);
+	if (started)
+		fprintf(stderr, "membw: %s GB/s across %d threads\n",
+			gbps_str, started);
+
+	/* the load is meant to cover the whole test */
+	atexit(intel_membw_stop);
+}
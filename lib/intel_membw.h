@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_MEMBW_H
+#define INTEL_MEMBW_H
+
+/* Host memory bandwidth interference generator.  Worker threads stream
+ * cache-bypassing stores through large buffers, paced to a requested
+ * aggregate GB/s, so GPU latency can be measured against a memory bus
+ * that looks like production instead of an idle lab machine.
+ *
+ * Tests get it for free through drm_open_any(): set INTEL_MEMBW_GBPS
+ * (and optionally INTEL_MEMBW_THREADS) in the environment and the load
+ * runs for the lifetime of the process.  A target of 0 means flat out.
+ */
+
+/* returns actual thread count, 0 if already running or out of memory */
+int intel_membw_start(double gbps, int num_threads);
+void intel_membw_stop(void);
+/* bytes written since start, for reporting the achieved rate */
+unsigned long long intel_membw_bytes(void);
+
+/* start workers according to INTEL_MEMBW_GBPS; no-op without it */
+void intel_membw_from_env(void);
+
+#endif /* INTEL_MEMBW_H */
@@ -28,6 +28,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -37,13 +38,138 @@
 #include <errno.h>
 #include <err.h>
 #include <assert.h>
+#include <sys/file.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 
+#include "intel_debugfs.h"
 #include "intel_gpu_tools.h"
+#include "intel_profile.h"
+#include "intel_clock.h"
+#include "intel_crc32c.h"
 
 void *mmio;
+static uint32_t mmio_region_size;
+
+/*
+ * Cross-process mapping registry.
+ *
+ * Each process still owns its BAR mapping (page tables can't be
+ * shared), but a small shm descriptor tracks how many mappers exist and
+ * whether the device has been revoked.  Monitoring tools check
+ * intel_mmio_revoked() between sample batches and back off instead of
+ * poking a BAR whose device is mid-unbind, and the unbind path can see
+ * from the refcount that mappers remain.  All of it is best-effort: if
+ * shm is unavailable the tools behave exactly as before.
+ */
+#define MMIO_SHM_NAME	"/intel_mmio_shared"
+#define MMIO_SHM_MAGIC	0x494d4d4f /* "IMMO" */
+
+struct mmio_shared_desc {
+	uint32_t magic;
+	uint32_t generation;	/* bumped on every revocation */
+	int32_t refcount;
+	int32_t revoked;
+};
+
+static struct mmio_shared_desc *mmio_shared;
+static int mmio_shared_fd = -1;
+static int mmio_shared_counted;
+static uint32_t mmio_shared_gen;
+
+static void mmio_shared_attach(int as_mapper)
+{
+	struct mmio_shared_desc *desc;
+	int fd;
+
+	if (mmio_shared)
+		return;
+
+	fd = shm_open(MMIO_SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if (fd == -1)
+		return;
+	if (ftruncate(fd, sizeof(*desc))) {
+		close(fd);
+		return;
+	}
+
+	desc = mmap(NULL, sizeof(*desc), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	if (desc == MAP_FAILED) {
+		close(fd);
+		return;
+	}
+
+	flock(fd, LOCK_EX);
+	if (desc->magic != MMIO_SHM_MAGIC) {
+		desc->magic = MMIO_SHM_MAGIC;
+		desc->generation = 0;
+		desc->refcount = 0;
+		desc->revoked = 0;
+	}
+	if (as_mapper)
+		desc->refcount++;
+	mmio_shared_gen = desc->generation;
+	flock(fd, LOCK_UN);
+
+	mmio_shared = desc;
+	mmio_shared_fd = fd;
+	mmio_shared_counted = as_mapper;
+}
+
+int
+intel_mmio_refcount(void)
+{
+	if (mmio_shared == NULL)
+		return mmio != NULL;
+
+	return mmio_shared->refcount;
+}
+
+int
+intel_mmio_revoked(void)
+{
+	if (mmio_shared == NULL)
+		return 0;
+
+	return mmio_shared->revoked ||
+		mmio_shared->generation != mmio_shared_gen;
+}
+
+void
+intel_mmio_revoke(void)
+{
+	mmio_shared_attach(0);
+	if (mmio_shared == NULL)
+		return;
+
+	flock(mmio_shared_fd, LOCK_EX);
+	mmio_shared->revoked = 1;
+	mmio_shared->generation++;
+	flock(mmio_shared_fd, LOCK_UN);
+}
+
+void
+intel_mmio_release(void)
+{
+	if (mmio_shared == NULL)
+		return;
+
+	flock(mmio_shared_fd, LOCK_EX);
+	if (mmio_shared_counted && --mmio_shared->refcount == 0) {
+		/* last mapper out; a revocation is complete now */
+		mmio_shared->revoked = 0;
+		shm_unlink(MMIO_SHM_NAME);
+	}
+	flock(mmio_shared_fd, LOCK_UN);
+
+	munmap(mmio_shared, sizeof(*mmio_shared));
+	close(mmio_shared_fd);
+	mmio_shared = NULL;
+	mmio_shared_fd = -1;
+	mmio_shared_counted = 0;
+}
 
 static struct _mmio_data {
 	int inited;
@@ -52,7 +178,6 @@ static struct _mmio_data {
 	char debugfs_forcewake_path[FILENAME_MAX];
 	uint32_t i915_devid;
 	struct intel_register_map map;
-	int key;
 } mmio_data;
 
 void
@@ -109,6 +234,128 @@ intel_get_mmio(struct pci_device *pci_dev)
 			strerror(error));
 		exit(1);
 	}
+
+	mmio_region_size = mmio_size;
+
+	/* announce ourselves in the shared mapper registry */
+	mmio_shared_attach(1);
+}
+
+/*
+ * Opt-in register read cache.
+ *
+ * The BAR mapping is uncached, so every read is a full bus transaction,
+ * and dump-everything tools re-read the same status registers several
+ * times while decoding.  With the cache enabled, the 64 byte line
+ * around a register is pulled from hardware at most once per epoch and
+ * further reads are served from a malloc'd shadow; an epoch ends with
+ * intel_register_cache_invalidate().  A line is only cached when the
+ * register map declares all of it readable (everything, in unsafe
+ * mode), so side-effect reads of neighbouring registers can't sneak in.
+ * Writes always go straight to hardware and drop the line they hit.
+ */
+#define REG_CACHE_LINE_SZ	64
+
+static int reg_cache_on;
+static uint8_t *reg_cache;
+static uint8_t *reg_cache_valid;	/* one flag byte per line */
+
+void
+intel_register_cache_enable(void)
+{
+	assert(mmio_data.inited);
+	assert(mmio_region_size);
+
+	if (reg_cache_on)
+		return;
+
+	reg_cache = calloc(1, mmio_region_size);
+	reg_cache_valid = calloc(1, mmio_region_size / REG_CACHE_LINE_SZ);
+	assert(reg_cache && reg_cache_valid);
+
+	reg_cache_on = 1;
+}
+
+void
+intel_register_cache_invalidate(void)
+{
+	if (reg_cache_on)
+		memset(reg_cache_valid, 0,
+		       mmio_region_size / REG_CACHE_LINE_SZ);
+}
+
+void
+intel_register_cache_disable(void)
+{
+	if (!reg_cache_on)
+		return;
+
+	free(reg_cache_valid);
+	free(reg_cache);
+	reg_cache = NULL;
+	reg_cache_valid = NULL;
+	reg_cache_on = 0;
+}
+
+static int
+reg_cache_line_readable(uint32_t base)
+{
+	struct intel_register_range *range;
+
+	if (!mmio_data.safe)
+		return 1;
+
+	range = intel_get_register_range(mmio_data.map, base,
+					 INTEL_RANGE_READ);
+
+	return range &&
+		base + REG_CACHE_LINE_SZ <= range->base + range->size;
+}
+
+static int
+reg_cache_lookup(uint32_t reg, uint32_t *val)
+{
+	uint32_t base = reg & ~(REG_CACHE_LINE_SZ - 1);
+	uint32_t line = base / REG_CACHE_LINE_SZ;
+
+	if (!reg_cache_on || reg + 4 > mmio_region_size)
+		return 0;
+
+	if (!reg_cache_valid[line]) {
+		volatile uint32_t *hw =
+			(volatile uint32_t *)((volatile char *)mmio + base);
+		uint32_t *shadow = (uint32_t *)(reg_cache + base);
+		int i;
+
+		if (!reg_cache_line_readable(base))
+			return 0;
+
+		for (i = 0; i < REG_CACHE_LINE_SZ / 4; i++)
+			shadow[i] = hw[i];
+		reg_cache_valid[line] = 1;
+	}
+
+	*val = *(uint32_t *)(reg_cache + reg);
+	return 1;
+}
+
+/* Cache-aware INREG: serves from the shadow when the line is cacheable,
+ * otherwise reads hardware directly.  Never blocks on the safety map,
+ * so it is a drop-in replacement in dumpers that use raw INREG. */
+static void intel_register_ensure_wake(uint32_t reg);
+
+uint32_t
+intel_register_read_cached(uint32_t reg)
+{
+	uint32_t val;
+
+	if (mmio_data.inited)
+		intel_register_ensure_wake(reg);
+
+	if (reg_cache_lookup(reg, &val))
+		return val;
+
+	return *(volatile uint32_t *)((volatile char *)mmio + reg);
 }
 
 /*
@@ -116,41 +363,123 @@ intel_get_mmio(struct pci_device *pci_dev)
  * updated with the correct path.
  */
 static int
-find_debugfs_path(const char *dri_base)
+find_debugfs_path(void)
 {
 	char buf[FILENAME_MAX];
 	struct stat sb;
-	int i, ret;
 
-	for (i = 0; i < 16; i++) {
-		snprintf(buf, FILENAME_MAX, "%s/%i/name", dri_base, i);
+	/* the shared resolver caches the directory per boot */
+	if (intel_debugfs_path(buf, sizeof(buf) - 32))
+		return -1;
 
-		snprintf(mmio_data.debugfs_path, FILENAME_MAX,
-			 "%s/%i/", dri_base, i);
-		snprintf(mmio_data.debugfs_forcewake_path, FILENAME_MAX,
-			 "%s/%i/i915_forcewake_user", dri_base, i);
+	snprintf(mmio_data.debugfs_path, FILENAME_MAX, "%s/", buf);
+	snprintf(mmio_data.debugfs_forcewake_path, FILENAME_MAX,
+		 "%s/i915_forcewake_user", buf);
 
-		ret = stat(mmio_data.debugfs_forcewake_path, &sb);
-		if (ret) {
-			mmio_data.debugfs_path[0] = 0;
-			mmio_data.debugfs_forcewake_path[0] = 0;
-		} else
-			return 0;
+	if (stat(mmio_data.debugfs_forcewake_path, &sb)) {
+		mmio_data.debugfs_path[0] = 0;
+		mmio_data.debugfs_forcewake_path[0] = 0;
+		return -1;
 	}
 
-	return -1;
+	return 0;
 }
 
-static int
-get_forcewake_lock(void)
+/*
+ * Reference-counted forcewake.
+ *
+ * The kernel holds forcewake for as long as the debugfs
+ * i915_forcewake_user file stays open, so the first get opens it and the
+ * last put closes it; nested users inside one process just bump the
+ * count.  A shared flock on a well-known lock file advertises the
+ * reference, so cooperating tools (or an admin chasing an RC6 residency
+ * regression) can see that somebody is keeping the GT awake.
+ */
+#define FORCEWAKE_LOCK_PATH "/var/run/intel_forcewake.lock"
+
+static int forcewake_refcount;
+static int forcewake_fd = -1;
+static int forcewake_lock_fd = -1;
+
+int
+intel_forcewake_get(void)
 {
-	return open(mmio_data.debugfs_forcewake_path, 0);
+	if (intel_gen(mmio_data.i915_devid) < 6)
+		return 0;
+
+	if (forcewake_refcount++)
+		return 0;
+
+	if (!mmio_data.debugfs_forcewake_path[0] &&
+	    find_debugfs_path()) {
+		fprintf(stderr, "Couldn't find path to dri/debugfs entry\n");
+		forcewake_refcount--;
+		return -1;
+	}
+
+	forcewake_fd = open(mmio_data.debugfs_forcewake_path, 0);
+	if (forcewake_fd == -1) {
+		forcewake_refcount--;
+		return -1;
+	}
+
+	forcewake_lock_fd = open(FORCEWAKE_LOCK_PATH, O_RDWR | O_CREAT, 0644);
+	if (forcewake_lock_fd != -1)
+		flock(forcewake_lock_fd, LOCK_SH);
+
+	return 0;
 }
 
+/* Whether the lazy path below has taken its reference; separate from
+ * the refcount so callers holding their own explicit reference aren't
+ * double-put at fini. */
+static int forcewake_lazy_acquired;
+
+/* Only the GT half of the BAR needs forcewake; tools that stay in the
+ * always-on display ranges never pay the wakeup or perturb the power
+ * state they're inspecting.  The reference is taken on the first
+ * access to a range the map flags INTEL_RANGE_WAKE and held until
+ * intel_register_access_fini().  Unknown offsets wake too - a stale
+ * read is worse than a wakeup. */
 static void
-release_forcewake_lock(int fd)
+intel_register_ensure_wake(uint32_t reg)
 {
-	close(fd);
+	struct intel_register_range *range;
+
+	if (intel_gen(mmio_data.i915_devid) < 6)
+		return;
+	if (forcewake_refcount)
+		return;
+
+	range = intel_get_register_range(mmio_data.map, reg, 0);
+	if (range && !(range->flags & INTEL_RANGE_WAKE))
+		return;
+
+	if (intel_forcewake_get())
+		fprintf(stderr, "Couldn't get forcewake for 0x%08x; "
+			"reads may be stale\n", reg);
+	else
+		forcewake_lazy_acquired = 1;
+}
+
+void
+intel_forcewake_put(void)
+{
+	if (intel_gen(mmio_data.i915_devid) < 6)
+		return;
+
+	assert(forcewake_refcount > 0);
+	if (--forcewake_refcount)
+		return;
+
+	close(forcewake_fd);
+	forcewake_fd = -1;
+
+	if (forcewake_lock_fd != -1) {
+		flock(forcewake_lock_fd, LOCK_UN);
+		close(forcewake_lock_fd);
+		forcewake_lock_fd = -1;
+	}
 }
 
 /*
@@ -162,8 +491,6 @@ release_forcewake_lock(int fd)
 int
 intel_register_access_init(struct pci_device *pci_dev, int safe)
 {
-	int ret;
-
 	/* after old API is deprecated, remove this */
 	if (mmio == NULL)
 		intel_get_mmio(pci_dev);
@@ -175,35 +502,34 @@ intel_register_access_init(struct pci_device *pci_dev, int safe)
 
 	mmio_data.safe = safe != 0 ? true : false;
 	mmio_data.i915_devid = pci_dev->device_id;
-	if (mmio_data.safe)
+	/* gen6+ loads the map even for unsafe access: the lazy
+	 * forcewake path needs the wake classification */
+	if (mmio_data.safe ||
+	    IS_GEN6(pci_dev->device_id) || IS_GEN7(pci_dev->device_id))
 		mmio_data.map = intel_get_register_map(mmio_data.i915_devid);
 
-	if (!(IS_GEN6(pci_dev->device_id) ||
-	      IS_GEN7(pci_dev->device_id)))
-		goto done;
-
-	/* Find where the forcewake lock is */
-	ret = find_debugfs_path("/sys/kernel/debug/dri");
-	if (ret) {
-		ret = find_debugfs_path("/debug/dri");
-		if (ret) {
-			fprintf(stderr, "Couldn't find path to dri/debugfs entry\n");
-			return ret;
-		}
-	}
-	mmio_data.key = get_forcewake_lock();
-
-done:
+	/* Forcewake is taken lazily by the first access that needs it,
+	 * so startup is power-neutral for tools that only look at the
+	 * always-on ranges. */
 	mmio_data.inited++;
+
+	/* any register tool becomes traceable without code changes */
+	if (getenv("INTEL_REG_TRACE"))
+		intel_register_trace_start(getenv("INTEL_REG_TRACE"));
+
 	return 0;
 }
 
 void
 intel_register_access_fini(void)
 {
-	if (mmio_data.key)
-		release_forcewake_lock(mmio_data.key);
-	mmio_data.inited--;
+	intel_register_trace_stop();
+	if (mmio_data.inited && forcewake_lazy_acquired) {
+		intel_forcewake_put();
+		forcewake_lazy_acquired = 0;
+	}
+	if (--mmio_data.inited == 0)
+		intel_mmio_release();
 }
 
 uint32_t
@@ -211,11 +537,11 @@ intel_register_read(uint32_t reg)
 {
 	struct intel_register_range *range;
 	uint32_t ret;
+	INTEL_PROFILE_BEGIN(register_read);
 
 	assert(mmio_data.inited);
 
-	if (intel_gen(mmio_data.i915_devid) >= 6)
-		assert(mmio_data.key != -1);
+	intel_register_ensure_wake(reg);
 
 	if (!mmio_data.safe)
 		goto read_out;
@@ -232,11 +558,89 @@ intel_register_read(uint32_t reg)
 	}
 
 read_out:
+	if (reg_cache_lookup(reg, &ret))
+		goto out;
 	ret = *(volatile uint32_t *)((volatile char *)mmio + reg);
 out:
+	INTEL_PROFILE_END(register_read);
 	return ret;
 }
 
+/*
+ * Register write tracing.
+ *
+ * Debugging a modeset difference from before/after dumps loses the
+ * one thing that often matters: the order and spacing of the writes in
+ * between.  With a trace active every write that goes through
+ * intel_register_write() is appended to a binary log together with the
+ * microseconds elapsed since the previous one, and each record chains
+ * a crc32c over everything before it so a truncated or edited log is
+ * caught before anyone replays it at the hardware.  Tracing costs one
+ * clock read and one buffered write per register write, cheap enough
+ * to leave on through an entire bring-up sequence.
+ */
+static FILE *trace_file;
+static uint64_t trace_last_ticks;
+static uint32_t trace_crc;
+
+int
+intel_register_trace_start(const char *path)
+{
+	struct intel_register_trace_header hdr;
+
+	assert(mmio_data.inited);
+	assert(trace_file == NULL);
+
+	trace_file = fopen(path, "wb");
+	if (trace_file == NULL)
+		return -errno;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = INTEL_REG_TRACE_MAGIC;
+	hdr.version = INTEL_REG_TRACE_VERSION;
+	hdr.devid = mmio_data.i915_devid;
+	fwrite(&hdr, sizeof(hdr), 1, trace_file);
+
+	trace_last_ticks = 0;
+	trace_crc = 0;
+
+	return 0;
+}
+
+void
+intel_register_trace_stop(void)
+{
+	if (trace_file == NULL)
+		return;
+
+	fclose(trace_file);
+	trace_file = NULL;
+}
+
+static void
+trace_record_write(uint32_t reg, uint32_t val)
+{
+	struct intel_register_trace_record rec;
+	uint64_t now;
+
+	now = intel_clock_now();
+	rec.reg = reg;
+	rec.val = val;
+	rec.delta_us = trace_last_ticks ?
+		(uint64_t)intel_clock_to_us(now - trace_last_ticks) : 0;
+	trace_last_ticks = now;
+
+	trace_crc = intel_crc32c(trace_crc, &rec,
+				 offsetof(struct intel_register_trace_record,
+					  crc));
+	rec.crc = trace_crc;
+
+	if (fwrite(&rec, sizeof(rec), 1, trace_file) != 1) {
+		fprintf(stderr, "register trace write failed, stopping\n");
+		intel_register_trace_stop();
+	}
+}
+
 void
 intel_register_write(uint32_t reg, uint32_t val)
 {
@@ -244,8 +648,10 @@ intel_register_write(uint32_t reg, uint32_t val)
 
 	assert(mmio_data.inited);
 
-	if (intel_gen(mmio_data.i915_devid) >= 6)
-		assert(mmio_data.key != -1);
+	if (trace_file)
+		trace_record_write(reg, val);
+
+	intel_register_ensure_wake(reg);
 
 	if (!mmio_data.safe)
 		goto write_out;
@@ -260,5 +666,74 @@ intel_register_write(uint32_t reg, uint32_t val)
 	}
 
 write_out:
+	if (reg_cache_on && reg < mmio_region_size)
+		reg_cache_valid[reg / REG_CACHE_LINE_SZ] = 0;
 	*(volatile uint32_t *)((volatile char *)mmio + reg) = val;
 }
+
+/*
+ * Burst capture of a declared register list.
+ *
+ * Timing-correlated debugging (matching ring head against INSTDONE bits,
+ * say) needs all values from one moment; a read-format-read loop spreads
+ * a dump over hundreds of microseconds of snprintf.  The offsets are
+ * resolved to pointers - and checked against the safety map, once - at
+ * init time, so the capture itself is nothing but back-to-back uncached
+ * loads with no branches between them.  Registers the map blocks read as
+ * 0xffffffff, same as intel_register_read(), by aiming their source
+ * pointer at a poisoned dummy instead of hardware.
+ */
+static const uint32_t burst_blocked = 0xffffffff;
+
+void
+intel_register_burst_init(struct intel_register_burst *burst,
+			  const uint32_t *regs, int count)
+{
+	int i;
+
+	assert(mmio_data.inited);
+
+	burst->count = count;
+	burst->srcs = malloc(count * sizeof(*burst->srcs));
+	burst->vals = malloc(count * sizeof(*burst->vals));
+	assert(burst->srcs && burst->vals);
+
+	for (i = 0; i < count; i++) {
+		intel_register_ensure_wake(regs[i]);
+
+		burst->srcs[i] = (const volatile uint32_t *)
+			((volatile char *)mmio + regs[i]);
+
+		if (!mmio_data.safe)
+			continue;
+
+		if (!intel_get_register_range(mmio_data.map, regs[i],
+					      INTEL_RANGE_READ)) {
+			fprintf(stderr, "Register read blocked for safety "
+				"(*0x%08x)\n", regs[i]);
+			burst->srcs[i] = &burst_blocked;
+		}
+	}
+}
+
+void
+intel_register_burst_capture(struct intel_register_burst *burst)
+{
+	const volatile uint32_t * const *srcs = burst->srcs;
+	uint32_t *vals = burst->vals;
+	int i;
+
+	/* any forcewake the list needs was taken at init time */
+	for (i = 0; i < burst->count; i++)
+		vals[i] = *srcs[i];
+}
+
+void
+intel_register_burst_fini(struct intel_register_burst *burst)
+{
+	free(burst->srcs);
+	free(burst->vals);
+	burst->srcs = NULL;
+	burst->vals = NULL;
+	burst->count = 0;
+}
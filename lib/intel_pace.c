@@ -0,0 +1,207 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "intel_pace.h"
+#include "intel_clock.h"
+
+static void pace_reset(struct intel_pace *pace, int mode)
+{
+	memset(pace, 0, sizeof(*pace));
+	pace->mode = mode;
+	/* calibrate now - the lazy calibration spin must not land in the
+	 * middle of the schedule and put every later slot in debt */
+	intel_clock_init();
+}
+
+void
+intel_pace_init_fixed(struct intel_pace *pace, double gap_us)
+{
+	pace_reset(pace, INTEL_PACE_FIXED);
+	pace->mean_us = gap_us;
+}
+
+void
+intel_pace_init_poisson(struct intel_pace *pace, double mean_us, long seed)
+{
+	pace_reset(pace, INTEL_PACE_POISSON);
+	pace->mean_us = mean_us;
+	pace->xsubi[0] = seed;
+	pace->xsubi[1] = seed >> 16;
+	pace->xsubi[2] = 0x330e;
+}
+
+int
+intel_pace_init_trace(struct intel_pace *pace, const char *filename)
+{
+	FILE *file;
+	char line[128];
+	int allocated = 0;
+
+	pace_reset(pace, INTEL_PACE_TRACE);
+
+	file = fopen(filename, "r");
+	if (file == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), file)) {
+		char *end;
+		double gap;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		gap = strtod(line, &end);
+		if (end == line || gap < 0)
+			continue;
+
+		if (pace->trace_len == allocated) {
+			allocated = allocated ? allocated * 2 : 1024;
+			pace->trace = realloc(pace->trace,
+					      allocated * sizeof(*pace->trace));
+			if (pace->trace == NULL) {
+				fclose(file);
+				return -1;
+			}
+		}
+		pace->trace[pace->trace_len++] = gap;
+	}
+	fclose(file);
+
+	if (pace->trace_len == 0) {
+		free(pace->trace);
+		pace->trace = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+intel_pace_parse(struct intel_pace *pace, const char *desc)
+{
+	if (strncmp(desc, "fixed:", 6) == 0) {
+		double gap = strtod(desc + 6, NULL);
+
+		if (gap <= 0)
+			return -1;
+		intel_pace_init_fixed(pace, gap);
+		return 0;
+	}
+	if (strncmp(desc, "poisson:", 8) == 0) {
+		double mean = strtod(desc + 8, NULL);
+
+		if (mean <= 0)
+			return -1;
+		intel_pace_init_poisson(pace, mean, getpid());
+		return 0;
+	}
+	if (strncmp(desc, "trace:", 6) == 0)
+		return intel_pace_init_trace(pace, desc + 6);
+
+	return -1;
+}
+
+static double
+next_gap(struct intel_pace *pace)
+{
+	switch (pace->mode) {
+	case INTEL_PACE_FIXED:
+		return pace->mean_us;
+	case INTEL_PACE_POISSON:
+		/* exponential inter-arrival times make the slot stream
+		 * Poisson, bursts and lulls included */
+		return -pace->mean_us * log(1.0 - erand48(pace->xsubi));
+	case INTEL_PACE_TRACE:
+		if (pace->trace_pos == pace->trace_len)
+			pace->trace_pos = 0;
+		return pace->trace[pace->trace_pos++];
+	default:
+		return 0;
+	}
+}
+
+void
+intel_pace_wait(struct intel_pace *pace)
+{
+	double now;
+
+	if (pace->mode == INTEL_PACE_NONE)
+		return;
+
+	if (pace->start_ticks == 0) {
+		/* the first submission defines time zero */
+		pace->start_ticks = intel_clock_now();
+		pace->sched_us = next_gap(pace);
+		pace->stats.slots++;
+		return;
+	}
+
+	now = intel_clock_to_us(intel_clock_now() - pace->start_ticks);
+	if (now < pace->sched_us) {
+		double gap = pace->sched_us - now;
+
+		/* sleep the bulk, spin the tail - usleep wakes late by
+		 * most of a scheduler tick, a spin hits the slot */
+		if (gap > 1500) {
+			usleep(gap - 500);
+			pace->stats.slept_us += gap - 500;
+		}
+		do {
+			now = intel_clock_to_us(intel_clock_now() -
+						pace->start_ticks);
+		} while (now < pace->sched_us);
+	} else if (now > pace->sched_us) {
+		pace->stats.overruns++;
+		if (now - pace->sched_us > pace->stats.worst_late_us)
+			pace->stats.worst_late_us = now - pace->sched_us;
+	}
+
+	pace->stats.slots++;
+	pace->sched_us += next_gap(pace);
+}
+
+void
+intel_pace_print_stats(const struct intel_pace *pace, FILE *file)
+{
+	if (pace->mode == INTEL_PACE_NONE || pace->stats.slots == 0)
+		return;
+
+	fprintf(file, "pacing: %"PRIu64" slots, %.1fs slept, "
+		"%"PRIu64" overruns (worst %.1fus late)\n",
+		pace->stats.slots, pace->stats.slept_us / 1e6,
+		pace->stats.overruns, pace->stats.worst_late_us);
+}
+
+void
+intel_pace_fini(struct intel_pace *pace)
+{
+	free(pace->trace);
+	pace->trace = NULL;
+	pace->mode = INTEL_PACE_NONE;
+}
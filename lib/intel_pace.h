@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_PACE_H
+#define INTEL_PACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Submission pacing.  Stress loops that submit flat out exercise a duty
+ * cycle production never has; bugs whose race windows only open when
+ * the GPU regularly goes idle between submissions stay invisible at
+ * saturation.  intel_pace_wait() blocks until the next submission slot
+ * of a schedule built from fixed gaps, Poisson inter-arrival times or a
+ * recorded trace.  Slots are absolute against the start of the run so
+ * loop overhead doesn't stretch the schedule; the tail of each gap is
+ * spun rather than slept so a slot is hit to microseconds.
+ */
+
+enum intel_pace_mode {
+	INTEL_PACE_NONE,
+	INTEL_PACE_FIXED,
+	INTEL_PACE_POISSON,
+	INTEL_PACE_TRACE,
+};
+
+struct intel_pace {
+	int mode;
+	double mean_us;
+	unsigned short xsubi[3];
+
+	double *trace;		/* inter-submission gaps in microseconds */
+	int trace_len;
+	int trace_pos;
+
+	uint64_t start_ticks;
+	double sched_us;	/* absolute time of the next slot */
+
+	struct {
+		uint64_t slots;
+		uint64_t slept_us;
+		uint64_t overruns;	/* slots already past due on entry */
+		double worst_late_us;
+	} stats;
+};
+
+void intel_pace_init_fixed(struct intel_pace *pace, double gap_us);
+void intel_pace_init_poisson(struct intel_pace *pace, double mean_us,
+			     long seed);
+/* text trace, one gap in microseconds per line, '#' comments allowed;
+ * replayed in order and wrapped when exhausted.  Returns -1 on error. */
+int intel_pace_init_trace(struct intel_pace *pace, const char *filename);
+/* "fixed:<us>", "poisson:<mean us>" or "trace:<file>" */
+int intel_pace_parse(struct intel_pace *pace, const char *desc);
+
+void intel_pace_wait(struct intel_pace *pace);
+void intel_pace_print_stats(const struct intel_pace *pace, FILE *file);
+void intel_pace_fini(struct intel_pace *pace);
+
+#endif /* INTEL_PACE_H */
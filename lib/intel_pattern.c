@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "intel_pattern.h"
+
+/*
+ * The counter for position idx is seed plus idx times an odd constant
+ * (Weyl sequence), whitened by two xorshift rounds.  The multiply only
+ * happens once per call to seed the counter; the vector paths advance
+ * it by addition, and the whitening is shifts and xors throughout, so
+ * SSE2 covers it.  This isn't a cryptographic generator, just one with
+ * enough avalanche that neighbouring or aliased offsets don't produce
+ * matching dwords.
+ */
+
+#define PATTERN_WEYL 0x9e3779b9u	/* 2^32 / golden ratio, odd */
+
+static inline uint32_t pattern_whiten(uint32_t x)
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static inline uint32_t pattern_counter(uint32_t seed, uint64_t idx)
+{
+	/* fold the high half in with a different weight so offsets 4G
+	 * apart don't alias */
+	return seed + (uint32_t)idx * PATTERN_WEYL +
+		(uint32_t)(idx >> 32) * 0x85ebca6bu;
+}
+
+uint32_t intel_pattern_word(uint32_t seed, uint64_t idx)
+{
+	return pattern_whiten(pattern_counter(seed, idx));
+}
+
+static void pattern_fill_scalar(uint32_t *dst, uint32_t counter,
+				unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++) {
+		dst[i] = pattern_whiten(counter);
+		counter += PATTERN_WEYL;
+	}
+}
+
+static unsigned pattern_check_scalar(const uint32_t *src, uint32_t counter,
+				     unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++) {
+		if (src[i] != pattern_whiten(counter))
+			return i;
+		counter += PATTERN_WEYL;
+	}
+
+	return count;
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+static inline __m128i pattern_whiten_sse2(__m128i x)
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	return x;
+}
+
+static void pattern_fill_sse2(uint32_t *dst, uint32_t counter, unsigned count)
+{
+	const __m128i step = _mm_set1_epi32(4 * PATTERN_WEYL);
+	__m128i ctr = _mm_set_epi32(counter + 3 * PATTERN_WEYL,
+				    counter + 2 * PATTERN_WEYL,
+				    counter + PATTERN_WEYL,
+				    counter);
+	unsigned i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 pattern_whiten_sse2(ctr));
+		ctr = _mm_add_epi32(ctr, step);
+	}
+	pattern_fill_scalar(dst + i, counter + i * PATTERN_WEYL, count - i);
+}
+
+static unsigned pattern_check_sse2(const uint32_t *src, uint32_t counter,
+				   unsigned count)
+{
+	const __m128i step = _mm_set1_epi32(4 * PATTERN_WEYL);
+	__m128i ctr = _mm_set_epi32(counter + 3 * PATTERN_WEYL,
+				    counter + 2 * PATTERN_WEYL,
+				    counter + PATTERN_WEYL,
+				    counter);
+	unsigned i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128i data = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i cmp = _mm_cmpeq_epi32(data,
+					      pattern_whiten_sse2(ctr));
+
+		if (_mm_movemask_epi8(cmp) != 0xffff)
+			/* let the scalar path locate the exact dword */
+			return i + pattern_check_scalar(src + i,
+					counter + i * PATTERN_WEYL, 4);
+		ctr = _mm_add_epi32(ctr, step);
+	}
+
+	return i + pattern_check_scalar(src + i, counter + i * PATTERN_WEYL,
+					count - i);
+}
+#endif /* __SSE2__ */
+
+/* Dispatch table, resolved on first use, same shape as the seq kernels
+ * in intel_tile_check.c. */
+static void (*pattern_fill_func)(uint32_t *, uint32_t, unsigned);
+static unsigned (*pattern_check_func)(const uint32_t *, uint32_t, unsigned);
+
+static void pattern_dispatch_init(void)
+{
+#ifdef __SSE2__
+	pattern_fill_func = pattern_fill_sse2;
+	pattern_check_func = pattern_check_sse2;
+#else
+	pattern_fill_func = pattern_fill_scalar;
+	pattern_check_func = pattern_check_scalar;
+#endif
+}
+
+void intel_pattern_fill(uint32_t *dst, uint32_t seed, uint64_t offset,
+			unsigned count)
+{
+	if (!pattern_fill_func)
+		pattern_dispatch_init();
+	pattern_fill_func(dst, pattern_counter(seed, offset), count);
+}
+
+unsigned intel_pattern_check(const uint32_t *src, uint32_t seed,
+			     uint64_t offset, unsigned count)
+{
+	if (!pattern_check_func)
+		pattern_dispatch_init();
+	return pattern_check_func(src, pattern_counter(seed, offset), count);
+}
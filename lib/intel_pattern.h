@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_PATTERN_H
+#define INTEL_PATTERN_H
+
+#include <stdint.h>
+
+/*
+ * Counter-based pseudorandom test patterns.
+ *
+ * The dword at position idx is a pure function of (seed, idx), so any
+ * slice of a buffer can be generated or verified in isolation - no
+ * sequential state to replay, which lets verification start at an
+ * arbitrary tile and lets threads split a buffer without handoff.
+ * Unlike the sequential patterns in intel_tile_check.h the content
+ * looks like noise, so a write landing at the wrong offset can't
+ * accidentally match.
+ *
+ * Like the seq kernels these are runtime-dispatched; the vector paths
+ * produce a block of lanes per iteration from the counter alone.
+ */
+
+/* the dword the pattern takes at position idx (for spot checks) */
+uint32_t intel_pattern_word(uint32_t seed, uint64_t idx);
+
+/* dst[i] = pattern(seed, offset + i) for i in [0, count), offset and
+ * count in dwords */
+void intel_pattern_fill(uint32_t *dst, uint32_t seed, uint64_t offset,
+			unsigned count);
+
+/* Returns the index of the first dword that doesn't match
+ * pattern(seed, offset + i), or count if the whole range matches. */
+unsigned intel_pattern_check(const uint32_t *src, uint32_t seed,
+			     uint64_t offset, unsigned count);
+
+#endif /* INTEL_PATTERN_H */
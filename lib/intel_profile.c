@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "intel_profile.h"
+
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct intel_profile_site *sites;
+
+static void profile_dump(void)
+{
+	struct intel_profile_site *site;
+
+	fprintf(stderr, "%-24s %12s %14s %10s\n",
+		"profile site", "calls", "total us", "avg ns");
+	for (site = sites; site; site = site->next)
+		fprintf(stderr, "%-24s %12llu %14.1f %10.1f\n",
+			site->name, site->count,
+			intel_clock_to_ns(site->ticks) / 1e3,
+			site->count ?
+			(double)intel_clock_to_ns(site->ticks) /
+			site->count : 0.0);
+}
+
+void intel_profile_register(struct intel_profile_site *site)
+{
+	struct intel_profile_site *walk;
+
+	pthread_mutex_lock(&profile_lock);
+	/* two racing first calls may both try to register a site */
+	for (walk = sites; walk; walk = walk->next)
+		if (walk == site)
+			goto out;
+	if (sites == NULL)
+		atexit(profile_dump);
+	site->next = sites;
+	sites = site;
+out:
+	pthread_mutex_unlock(&profile_lock);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_PROFILE_H
+#define INTEL_PROFILE_H
+
+#include <stdint.h>
+
+#include "intel_clock.h"
+
+/* Permanent call-site profiling, compiled out by default.
+ *
+ * Rebuild with -DINTEL_PROFILE and every instrumented site accumulates
+ * call count and TSC cycles in static storage; a summary is printed to
+ * stderr at exit.  Without the define the macros expand to nothing, so
+ * the hot paths cost exactly what they cost before.  Usage:
+ *
+ *	INTEL_PROFILE_BEGIN(flush);
+ *	... the work ...
+ *	INTEL_PROFILE_END(flush);
+ *
+ * with BEGIN placed among the declarations.  Counters are plain adds:
+ * under concurrent callers the totals are approximate, which is fine
+ * for finding where the time goes.
+ */
+
+struct intel_profile_site {
+	const char *name;
+	unsigned long long count;
+	unsigned long long ticks;
+	struct intel_profile_site *next;
+};
+
+void intel_profile_register(struct intel_profile_site *site);
+
+#ifdef INTEL_PROFILE
+
+#define INTEL_PROFILE_BEGIN(tag) \
+	static struct intel_profile_site __prof_##tag = { #tag }; \
+	uint64_t __prof_start_##tag = intel_clock_now()
+
+#define INTEL_PROFILE_END(tag) do { \
+	uint64_t __prof_delta = intel_clock_now() - __prof_start_##tag; \
+	uint64_t __prof_oh = intel_clock_overhead(); \
+	__prof_##tag.ticks += __prof_delta > __prof_oh ? \
+		__prof_delta - __prof_oh : 0; \
+	if (__prof_##tag.count++ == 0) \
+		intel_profile_register(&__prof_##tag); \
+} while (0)
+
+#else
+
+#define INTEL_PROFILE_BEGIN(tag) do { } while (0)
+#define INTEL_PROFILE_END(tag) do { } while (0)
+
+#endif /* INTEL_PROFILE */
+
+#endif /* INTEL_PROFILE_H */
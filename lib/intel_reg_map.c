@@ -1,5 +1,5 @@
 /*
- * Copyright � 2011 Intel Corporation
+ * Copyright © 2011 Intel Corporation
  *
  * Permission is hereby granted, free of charge, to any person obtaining a
  * copy of this software and associated documentation files (the "Software"),
@@ -85,34 +85,37 @@ static struct intel_register_range gen4_register_map[] = {
 	{0x00000000, 0x00000000, INTEL_RANGE_END}
 };
 
-/* The documentation is a little sketchy on these register ranges. */
+/* The documentation is a little sketchy on these register ranges.
+ * Everything below 0x40000 is GT territory and needs forcewake held to
+ * read reliably (the same cutoff the kernel applies); the display and
+ * PCH ranges above it are always-on. */
 static struct intel_register_range gen6_gt_register_map[] = {
-	{0x00000000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00001000, 0x00000fff, INTEL_RANGE_RSVD},
-	{0x00002000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00003000, 0x000001ff, INTEL_RANGE_RW},
-	{0x00003200, 0x00000dff, INTEL_RANGE_RW},
-	{0x00004000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00005000, 0x0000017f, INTEL_RANGE_RW},
-	{0x00005180, 0x00000e7f, INTEL_RANGE_RW},
-	{0x00006000, 0x00001fff, INTEL_RANGE_RW},
-	{0x00008000, 0x000007ff, INTEL_RANGE_RW},
-	{0x00008800, 0x000000ff, INTEL_RANGE_RSVD},
-	{0x00008900, 0x000006ff, INTEL_RANGE_RW},
-	{0x00009000, 0x00000fff, INTEL_RANGE_RSVD},
-	{0x0000a000, 0x00000fff, INTEL_RANGE_RW},
-	{0x0000b000, 0x00004fff, INTEL_RANGE_RSVD},
-	{0x00010000, 0x00001fff, INTEL_RANGE_RW},
-	{0x00012000, 0x000003ff, INTEL_RANGE_RW},
-	{0x00012400, 0x00000bff, INTEL_RANGE_RW},
-	{0x00013000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00014000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00015000, 0x0000cfff, INTEL_RANGE_RW},
-	{0x00022000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00023000, 0x00000fff, INTEL_RANGE_RSVD},
-	{0x00024000, 0x00000fff, INTEL_RANGE_RW},
-	{0x00025000, 0x0000afff, INTEL_RANGE_RSVD},
-	{0x00030000, 0x0000ffff, INTEL_RANGE_RW},
+	{0x00000000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00001000, 0x00000fff, INTEL_RANGE_RSVD | INTEL_RANGE_WAKE},
+	{0x00002000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00003000, 0x000001ff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00003200, 0x00000dff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00004000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00005000, 0x0000017f, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00005180, 0x00000e7f, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00006000, 0x00001fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00008000, 0x000007ff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00008800, 0x000000ff, INTEL_RANGE_RSVD | INTEL_RANGE_WAKE},
+	{0x00008900, 0x000006ff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00009000, 0x00000fff, INTEL_RANGE_RSVD | INTEL_RANGE_WAKE},
+	{0x0000a000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x0000b000, 0x00004fff, INTEL_RANGE_RSVD | INTEL_RANGE_WAKE},
+	{0x00010000, 0x00001fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00012000, 0x000003ff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00012400, 0x00000bff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00013000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00014000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00015000, 0x0000cfff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00022000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00023000, 0x00000fff, INTEL_RANGE_RSVD | INTEL_RANGE_WAKE},
+	{0x00024000, 0x00000fff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
+	{0x00025000, 0x0000afff, INTEL_RANGE_RSVD | INTEL_RANGE_WAKE},
+	{0x00030000, 0x0000ffff, INTEL_RANGE_RW | INTEL_RANGE_WAKE},
 	{0x00040000, 0x0000ffff, INTEL_RANGE_RW},
 	{0x00050000, 0x0000ffff, INTEL_RANGE_RW},
 	{0x00060000, 0x0000ffff, INTEL_RANGE_RW},
@@ -150,11 +153,40 @@ intel_get_register_map(uint32_t devid)
 	return map;
 }
 
+/* The tables above are static, so their lengths only need counting
+ * once; full-BAR sweeps do a range lookup per offset and the repeated
+ * end-marker scan was where they spent their time. */
+static int
+register_map_count(struct intel_register_range *map)
+{
+	static struct {
+		struct intel_register_range *map;
+		int count;
+	} cache[4];
+	unsigned i;
+	int n;
+
+	for (i = 0; i < ARRAY_SIZE(cache) && cache[i].map; i++)
+		if (cache[i].map == map)
+			return cache[i].count;
+
+	for (n = 0; !(map[n].flags & INTEL_RANGE_END); n++)
+		;
+
+	if (i < ARRAY_SIZE(cache)) {
+		cache[i].count = n;
+		cache[i].map = map;
+	}
+
+	return n;
+}
+
 struct intel_register_range *
 intel_get_register_range(struct intel_register_map map, uint32_t offset, int mode)
 {
-	struct intel_register_range *range = map.map;
+	struct intel_register_range *range;
 	uint32_t align = map.alignment_mask;
+	int lo, hi;
 
 	if (offset & map.alignment_mask)
 		return NULL;
@@ -162,18 +194,27 @@ intel_get_register_range(struct intel_register_map map, uint32_t offset, int mod
 	if (offset >= map.top)
 		return NULL;
 
-	while (!(range->flags & INTEL_RANGE_END)) {
-		/*  list is assumed to be in order */
-		if (offset < range->base)
-			break;
-
-		if ( (offset >= range->base) &&
-		     (offset + align) <= (range->base + range->size)) {
-			if ((mode & range->flags) == mode)
-				return range;
-		}
-		range++;
+	lo = 0;
+	hi = register_map_count(map.map) - 1;
+	if (hi < 0)
+		return NULL;
+
+	/* lists are sorted by base; find the last range at or below
+	 * offset, then a single containment check decides */
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+
+		if (map.map[mid].base <= offset)
+			lo = mid;
+		else
+			hi = mid - 1;
 	}
 
+	range = &map.map[lo];
+	if (offset >= range->base &&
+	    offset + align <= range->base + range->size &&
+	    (mode & range->flags) == mode)
+		return range;
+
 	return NULL;
 }
@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+#include "intel_results.h"
+
+static int results_fd = -2;	/* -2 unprobed, -1 disabled */
+static char results_kernel[sizeof(((struct intel_results_record *)0)->kernel)];
+
+static int results_open(void)
+{
+	struct utsname uts;
+	const char *path;
+
+	if (results_fd != -2)
+		return results_fd;
+
+	path = getenv("INTEL_RESULTS_LOG");
+	if (path == NULL || path[0] == '\0') {
+		results_fd = -1;
+		return results_fd;
+	}
+
+	results_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (results_fd < 0) {
+		fprintf(stderr, "intel_results: can't append to %s\n", path);
+		results_fd = -1;
+		return results_fd;
+	}
+
+	if (uname(&uts) == 0)
+		strncpy(results_kernel, uts.release,
+			sizeof(results_kernel) - 1);
+
+	return results_fd;
+}
+
+void intel_results_report(uint32_t devid, const char *test,
+			  const char *metric, double value, const char *unit)
+{
+	struct intel_results_record rec;
+
+	if (results_open() < 0)
+		return;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = INTEL_RESULTS_MAGIC;
+	rec.version = INTEL_RESULTS_VERSION;
+	rec.time = time(NULL);
+	rec.devid = devid;
+	memcpy(rec.kernel, results_kernel, sizeof(rec.kernel));
+	strncpy(rec.test, test, sizeof(rec.test) - 1);
+	strncpy(rec.metric, metric, sizeof(rec.metric) - 1);
+	if (unit)
+		strncpy(rec.unit, unit, sizeof(rec.unit) - 1);
+	rec.value = value;
+
+	/* one write per record: O_APPEND keeps concurrent runs from
+	 * interleaving partial records */
+	if (write(results_fd, &rec, sizeof(rec)) != sizeof(rec))
+		fprintf(stderr, "intel_results: short write, record lost\n");
+}
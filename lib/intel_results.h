@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_RESULTS_H
+#define INTEL_RESULTS_H
+
+#include <stdint.h>
+
+/* Append-only local results log.
+ *
+ * Tests and benchmarks call intel_results_report() next to their
+ * printf; when the environment variable INTEL_RESULTS_LOG names a
+ * file, one fixed-size binary record per metric is appended there
+ * (O_APPEND, so concurrent runs interleave whole records).  With the
+ * variable unset nothing is opened or written, so the default
+ * behaviour of every binary is unchanged.  intel_results_query reads
+ * the log back and computes per-metric trends.
+ */
+
+#define INTEL_RESULTS_MAGIC	0x53455249	/* "IRES" little-endian */
+#define INTEL_RESULTS_VERSION	1
+
+struct intel_results_record {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t pad;
+	uint64_t time;		/* seconds since the epoch */
+	uint32_t devid;
+	char kernel[36];	/* uname -r, truncated */
+	char test[48];		/* binary or test id */
+	char metric[32];
+	char unit[16];
+	double value;
+};				/* 160 bytes, never shrink fields */
+
+void intel_results_report(uint32_t devid, const char *test,
+			  const char *metric, double value, const char *unit);
+
+#endif /* INTEL_RESULTS_H */
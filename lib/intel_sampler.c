@@ -0,0 +1,72 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "intel_gpu_tools.h"
+#include "intel_sampler.h"
+
+void
+intel_sampler_init(struct intel_sampler *s,
+		   const uint32_t *regs, int num_regs, int depth)
+{
+	int i;
+
+	assert(mmio);
+	assert(num_regs > 0 && depth > 0);
+
+	s->num_regs = num_regs;
+	s->depth = depth;
+
+	s->reg_ptrs = malloc(num_regs * sizeof(*s->reg_ptrs));
+	s->samples = calloc(depth * num_regs, sizeof(*s->samples));
+	if (!s->reg_ptrs || !s->samples) {
+		fprintf(stderr, "Couldn't allocate sample ring\n");
+		exit(1);
+	}
+
+	for (i = 0; i < num_regs; i++)
+		s->reg_ptrs[i] = (volatile uint32_t *)
+			((volatile char *)mmio + regs[i]);
+
+	intel_sampler_reset(s);
+}
+
+void
+intel_sampler_reset(struct intel_sampler *s)
+{
+	s->head = 0;
+	s->count = 0;
+}
+
+void
+intel_sampler_fini(struct intel_sampler *s)
+{
+	free(s->reg_ptrs);
+	free(s->samples);
+	memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_SAMPLER_H
+#define INTEL_SAMPLER_H
+
+#include <stdint.h>
+
+/*
+ * Batched MMIO sampler.
+ *
+ * Collects a fixed set of registers into a preallocated ring of sample
+ * buffers in one tight pass per tick.  The register offsets are resolved
+ * into pointers at init time so the sampling loop is nothing but a run of
+ * uncached loads, which is what you want when sampling at rates where the
+ * tool itself would otherwise perturb the workload under observation.
+ *
+ * The caller is responsible for holding forcewake (via
+ * intel_register_access_init()) for the duration of the sampling run; the
+ * sampler deliberately does no per-read safety checking.
+ */
+struct intel_sampler {
+	const volatile uint32_t **reg_ptrs;
+	int num_regs;
+
+	uint32_t *samples;	/* depth * num_regs, ring of sample buffers */
+	int depth;
+	int head;		/* slot receiving the next sample */
+	uint64_t count;		/* total samples taken since reset */
+};
+
+void intel_sampler_init(struct intel_sampler *s,
+			const uint32_t *regs, int num_regs, int depth);
+void intel_sampler_fini(struct intel_sampler *s);
+void intel_sampler_reset(struct intel_sampler *s);
+
+/* One tight pass over the register set; always inlined into the caller's
+ * sampling loop. */
+static inline void intel_sampler_sample(struct intel_sampler *s)
+{
+	uint32_t *slot = s->samples + s->head * s->num_regs;
+	int i;
+
+	for (i = 0; i < s->num_regs; i++)
+		slot[i] = *s->reg_ptrs[i];
+
+	if (++s->head == s->depth)
+		s->head = 0;
+	s->count++;
+}
+
+/* Return the sample taken @age ticks ago (0 == most recent).  Valid for
+ * age < min(count, depth). */
+static inline const uint32_t *
+intel_sampler_get(const struct intel_sampler *s, int age)
+{
+	int slot = s->head - 1 - age;
+
+	if (slot < 0)
+		slot += s->depth;
+	return s->samples + slot * s->num_regs;
+}
+
+#endif /* INTEL_SAMPLER_H */
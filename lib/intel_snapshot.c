@@ -0,0 +1,179 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "intel_gpu_tools.h"
+#include "intel_chipset.h"
+#include "intel_reg.h"
+#include "intel_snapshot.h"
+
+/* ring mmio bases; head/tail live at base + RING_HEAD / RING_TAIL */
+#define RENDER_RING_BASE	0x2030
+#define BSD_RING_BASE		0x4030
+#define GEN6_BSD_RING_BASE	0x12030
+#define BLT_RING_BASE		0x22030
+
+/* no symbolic name for this one in intel_reg.h yet */
+#define FORCEWAKE_REG		0xA18C
+
+static struct intel_gt_snapshot *snapshot_map(int create)
+{
+	struct intel_gt_snapshot *snap;
+	int fd;
+
+	fd = shm_open(GT_SNAPSHOT_SHM_NAME,
+		      create ? O_CREAT | O_RDWR : O_RDWR, 0644);
+	if (fd == -1)
+		return NULL;
+
+	if (create && ftruncate(fd, sizeof(*snap)) == -1) {
+		close(fd);
+		return NULL;
+	}
+
+	snap = mmap(NULL, sizeof(*snap), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	close(fd);
+	if (snap == MAP_FAILED)
+		return NULL;
+
+	return snap;
+}
+
+struct intel_gt_snapshot *intel_snapshot_publish(void)
+{
+	struct intel_gt_snapshot *snap;
+
+	snap = snapshot_map(1);
+	if (snap == NULL)
+		return NULL;
+
+	/* readers ignore the page until the magic lands, so order it last */
+	snap->seq = 0;
+	snap->version = GT_SNAPSHOT_VERSION;
+	__sync_synchronize();
+	snap->magic = GT_SNAPSHOT_MAGIC;
+
+	return snap;
+}
+
+static void snapshot_ring(struct intel_gt_snapshot *snap, int ring,
+			  uint32_t base)
+{
+	uint32_t head, tail;
+
+	head = intel_register_read(base + RING_HEAD) & HEAD_ADDR;
+	tail = intel_register_read(base + RING_TAIL) & TAIL_ADDR;
+
+	snap->ring_head[ring] = head;
+	snap->ring_tail[ring] = tail;
+	if (head == tail)
+		snap->rings_idle |= 1 << ring;
+}
+
+void intel_snapshot_update(struct intel_gt_snapshot *snap, uint32_t devid)
+{
+	struct timespec ts;
+
+	snap->seq++;
+	__sync_synchronize();
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	snap->ts_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	snap->devid = devid;
+
+	snap->rings_idle = 0;
+	snapshot_ring(snap, GT_SNAPSHOT_RENDER, RENDER_RING_BASE);
+	snapshot_ring(snap, GT_SNAPSHOT_BSD,
+		      intel_gen(devid) >= 6 ? GEN6_BSD_RING_BASE :
+					      BSD_RING_BASE);
+	if (HAS_BLT_RING(devid))
+		snapshot_ring(snap, GT_SNAPSHOT_BLT, BLT_RING_BASE);
+
+	if (intel_gen(devid) >= 6) {
+		snap->rpstat = intel_register_read(GEN6_RPSTAT1);
+		snap->freq_mhz = ((snap->rpstat >> 8) & 0xff) * 50;
+		snap->forcewake = intel_register_read(FORCEWAKE_REG);
+	} else {
+		snap->rpstat = 0;
+		snap->freq_mhz = 0;
+		snap->forcewake = 0;
+	}
+
+	__sync_synchronize();
+	snap->seq++;
+}
+
+void intel_snapshot_unpublish(struct intel_gt_snapshot *snap)
+{
+	munmap(snap, sizeof(*snap));
+	shm_unlink(GT_SNAPSHOT_SHM_NAME);
+}
+
+struct intel_gt_snapshot *intel_snapshot_open(void)
+{
+	struct intel_gt_snapshot *snap;
+
+	snap = snapshot_map(0);
+	if (snap == NULL)
+		return NULL;
+
+	if (snap->magic != GT_SNAPSHOT_MAGIC ||
+	    snap->version != GT_SNAPSHOT_VERSION) {
+		munmap(snap, sizeof(*snap));
+		return NULL;
+	}
+
+	return snap;
+}
+
+int intel_snapshot_read(struct intel_gt_snapshot *snap,
+			struct intel_gt_snapshot *copy)
+{
+	uint32_t seq;
+	int retry;
+
+	for (retry = 0; retry < 1000; retry++) {
+		seq = snap->seq;
+		if (seq & 1) {
+			usleep(10);
+			continue;
+		}
+		__sync_synchronize();
+		memcpy(copy, snap, sizeof(*copy));
+		__sync_synchronize();
+		if (snap->seq == seq)
+			return 0;
+	}
+
+	return -1;
+}
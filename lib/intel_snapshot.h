@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_SNAPSHOT_H
+#define INTEL_SNAPSHOT_H
+
+#include <stdint.h>
+
+/*
+ * Published GT state page.
+ *
+ * One privileged publisher (intel_forcewaked) refreshes a single shm
+ * page of GT state; any number of readers consume it with a plain page
+ * read and no MMIO of their own, so ten monitoring agents cost the
+ * hardware exactly one.  A seq counter guards the payload seqlock
+ * style: it is odd while an update is in flight and readers retry
+ * until they see the same even value on both sides of their copy.
+ */
+
+#define GT_SNAPSHOT_SHM_NAME	"/intel_gt_snapshot"
+#define GT_SNAPSHOT_MAGIC	0x47545353
+#define GT_SNAPSHOT_VERSION	1
+
+#define GT_SNAPSHOT_RENDER	0
+#define GT_SNAPSHOT_BSD		1
+#define GT_SNAPSHOT_BLT		2
+#define GT_SNAPSHOT_RINGS	3
+
+struct intel_gt_snapshot {
+	uint32_t magic;
+	uint32_t version;
+	volatile uint32_t seq;
+	uint32_t devid;
+	uint64_t ts_ns;		/* CLOCK_MONOTONIC of the last refresh */
+	uint32_t freq_mhz;	/* CAGF, 0 before gen6 */
+	uint32_t rpstat;	/* raw GEN6_RPSTAT1 */
+	uint32_t forcewake;	/* raw FORCEWAKE */
+	uint32_t rings_idle;	/* bit per ring: head == tail */
+	uint32_t ring_head[GT_SNAPSHOT_RINGS];
+	uint32_t ring_tail[GT_SNAPSHOT_RINGS];
+};
+
+/* publisher side; requires register access to be initialised */
+struct intel_gt_snapshot *intel_snapshot_publish(void);
+void intel_snapshot_update(struct intel_gt_snapshot *snap, uint32_t devid);
+void intel_snapshot_unpublish(struct intel_gt_snapshot *snap);
+
+/* reader side; NULL when nobody publishes */
+struct intel_gt_snapshot *intel_snapshot_open(void);
+/* consistent copy of the page, -1 if the publisher stalled mid-update */
+int intel_snapshot_read(struct intel_gt_snapshot *snap,
+			struct intel_gt_snapshot *copy);
+
+#endif /* INTEL_SNAPSHOT_H */
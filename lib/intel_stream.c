@@ -0,0 +1,148 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "intel_stream.h"
+
+/* Four 64KiB staging chunks: enough that the filler stays ahead of a
+ * disk-speed writer, small enough to be irrelevant to an OOM-adjacent
+ * machine.  Single producer (the filler thread), single consumer (the
+ * caller writing out), same head/tail discipline as the drmtest
+ * output ring. */
+#define STREAM_CHUNK	(64 << 10)
+#define STREAM_CHUNKS	4
+
+static char stream_ring[STREAM_CHUNKS][STREAM_CHUNK];
+static size_t stream_len[STREAM_CHUNKS];
+static volatile unsigned stream_head, stream_tail;
+static volatile int stream_err;
+
+struct stream_source {
+	intel_stream_read_fn fill;
+	void *data;
+	uint64_t size;
+};
+
+static void *stream_filler(void *arg)
+{
+	struct stream_source *src = arg;
+	uint64_t off = 0;
+
+	while (off < src->size && !stream_err) {
+		unsigned slot = stream_head % STREAM_CHUNKS;
+		size_t len = STREAM_CHUNK;
+
+		if (src->size - off < len)
+			len = src->size - off;
+
+		while (stream_head - stream_tail == STREAM_CHUNKS &&
+		       !stream_err)
+			usleep(500);
+		if (stream_err)
+			break;
+
+		if (src->fill(stream_ring[slot], off, len, src->data)) {
+			stream_err = -EIO;
+			break;
+		}
+		stream_len[slot] = len;
+
+		/* the chunk must be visible before the head moves */
+		__sync_synchronize();
+		stream_head++;
+		off += len;
+	}
+
+	return NULL;
+}
+
+static int stream_write_all(int fd, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+int intel_stream_copy(int fd, uint64_t size,
+		      intel_stream_read_fn fill, void *data)
+{
+	struct stream_source src = { fill, data, size };
+	pthread_t filler;
+	uint64_t done = 0;
+	int ret;
+
+	stream_head = stream_tail = 0;
+	stream_err = 0;
+
+	if (pthread_create(&filler, NULL, stream_filler, &src))
+		return -EAGAIN;
+
+	while (done < size && !stream_err) {
+		unsigned slot = stream_tail % STREAM_CHUNKS;
+
+		while (stream_tail == stream_head && !stream_err)
+			usleep(500);
+		if (stream_err)
+			break;
+		__sync_synchronize();
+
+		ret = stream_write_all(fd, stream_ring[slot],
+				       stream_len[slot]);
+		if (ret) {
+			stream_err = ret;
+			break;
+		}
+		done += stream_len[slot];
+		stream_tail++;
+	}
+
+	pthread_join(filler, NULL);
+
+	return stream_err;
+}
+
+static int stream_fill_mem(void *dst, uint64_t offset, size_t len, void *data)
+{
+	memcpy(dst, (const char *)data + offset, len);
+	return 0;
+}
+
+int intel_stream_copy_mem(int fd, const void *src, uint64_t size)
+{
+	return intel_stream_copy(fd, size, stream_fill_mem, (void *)src);
+}
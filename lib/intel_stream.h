@@ -0,0 +1,57 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_STREAM_H
+#define INTEL_STREAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Bounded-memory streaming copy for the capture tools.
+ *
+ * Capture often runs on the machine that is already in trouble, so
+ * staging a whole BAR or ROM image in memory competes with the very
+ * incident being captured.  intel_stream_copy() slices the source
+ * through a fixed ring of staging chunks instead: a filler thread
+ * reads the next slice while the previous one is being written out,
+ * so memory use is constant regardless of region size and the read
+ * and write sides overlap.  Short writes are retried, unlike a single
+ * giant write() which silently truncates past 2GiB.
+ *
+ * The fill callback copies len bytes at the given source offset into
+ * dst and returns 0, or non-zero to abort the copy.  Both entry
+ * points return 0 on success or -errno.  One copy at a time: the
+ * staging ring is shared static storage.
+ */
+
+typedef int (*intel_stream_read_fn)(void *dst, uint64_t offset, size_t len,
+				    void *data);
+
+int intel_stream_copy(int fd, uint64_t size,
+		      intel_stream_read_fn fill, void *data);
+
+/* source is already addressable (an mmapped BAR, a ROM staging buffer) */
+int intel_stream_copy_mem(int fd, const void *src, uint64_t size);
+
+#endif /* INTEL_STREAM_H */
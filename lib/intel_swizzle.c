@@ -0,0 +1,79 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "i915_drm.h"
+#include "intel_swizzle.h"
+
+static const struct {
+	uint32_t mode;
+	const char *name;
+	uint32_t addr_bits;	/* offset bits XORed into bit 6 */
+} swizzle_modes[] = {
+	{ I915_BIT_6_SWIZZLE_NONE, "none", 0 },
+	{ I915_BIT_6_SWIZZLE_9, "bit9", 1 << 9 },
+	{ I915_BIT_6_SWIZZLE_9_10, "bit9^10", 1 << 9 | 1 << 10 },
+	{ I915_BIT_6_SWIZZLE_9_11, "bit9^11", 1 << 9 | 1 << 11 },
+	{ I915_BIT_6_SWIZZLE_9_10_11, "bit9^10^11",
+	  1 << 9 | 1 << 10 | 1 << 11 },
+};
+
+#define NUM_SWIZZLE_MODES (sizeof(swizzle_modes)/sizeof(swizzle_modes[0]))
+
+const struct intel_swizzle_table *intel_swizzle_table_get(uint32_t swizzle_mode)
+{
+	static struct intel_swizzle_table tables[NUM_SWIZZLE_MODES];
+	static int built[NUM_SWIZZLE_MODES];
+	struct intel_swizzle_table *table;
+	unsigned i, line;
+
+	for (i = 0; i < NUM_SWIZZLE_MODES; i++)
+		if (swizzle_modes[i].mode == swizzle_mode)
+			break;
+	if (i == NUM_SWIZZLE_MODES)
+		return NULL;
+
+	table = &tables[i];
+	if (built[i])
+		return table;
+
+	table->swizzle_mode = swizzle_mode;
+	table->name = swizzle_modes[i].name;
+	for (line = 0; line < SWIZZLE_CACHELINES_PER_PAGE; line++) {
+		uint32_t offset = line << 6;
+		uint16_t x = 0;
+		int bit;
+
+		/* only bits 9-11 feed the swizzle, so the cacheline index
+		 * within the page determines the XOR completely */
+		for (bit = 9; bit <= 11; bit++)
+			if (swizzle_modes[i].addr_bits & (1 << bit))
+				x ^= ((offset >> bit) & 1) << 6;
+		table->bit6_xor[line] = x;
+	}
+	built[i] = 1;
+
+	return table;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_SWIZZLE_H
+#define INTEL_SWIZZLE_H
+
+#include <stdint.h>
+
+/* Bit6 swizzling XORs address bits 9/10/11 into bit 6 of the offset, so
+ * the effect is constant across each 64-byte cacheline and repeats with
+ * every 4KiB page.  Instead of recomputing the transform per element,
+ * look the per-cacheline XOR up in a table built once per swizzle mode
+ * and process whole cachelines at a time. */
+
+#define SWIZZLE_CACHELINES_PER_PAGE 64
+
+struct intel_swizzle_table {
+	uint32_t swizzle_mode;	/* I915_BIT_6_SWIZZLE_* */
+	const char *name;
+	/* XOR to apply to an offset, indexed by cacheline within the page */
+	uint16_t bit6_xor[SWIZZLE_CACHELINES_PER_PAGE];
+};
+
+#define swizzle_cacheline(offset) (((offset) >> 6) & \
+				   (SWIZZLE_CACHELINES_PER_PAGE - 1))
+
+/* NULL for modes the cpu can't predict (the bit17 variants depend on the
+ * physical page address) or that we don't know about */
+const struct intel_swizzle_table *intel_swizzle_table_get(uint32_t swizzle_mode);
+
+#endif /* INTEL_SWIZZLE_H */
@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "intel_tile_check.h"
+
+static void seq_fill_scalar(uint32_t *dst, uint32_t start, unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = start + i;
+}
+
+static unsigned seq_check_scalar(const uint32_t *src, uint32_t start,
+				 unsigned count)
+{
+	unsigned i;
+
+	for (i = 0; i < count; i++)
+		if (src[i] != start + i)
+			return i;
+
+	return count;
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+static void seq_fill_sse2(uint32_t *dst, uint32_t start, unsigned count)
+{
+	const __m128i four = _mm_set1_epi32(4);
+	__m128i val = _mm_set_epi32(start + 3, start + 2, start + 1, start);
+	unsigned i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		_mm_storeu_si128((__m128i *)(dst + i), val);
+		val = _mm_add_epi32(val, four);
+	}
+	seq_fill_scalar(dst + i, start + i, count - i);
+}
+
+static unsigned seq_check_sse2(const uint32_t *src, uint32_t start,
+			       unsigned count)
+{
+	const __m128i four = _mm_set1_epi32(4);
+	__m128i val = _mm_set_epi32(start + 3, start + 2, start + 1, start);
+	unsigned i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128i data = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i cmp = _mm_cmpeq_epi32(data, val);
+
+		if (_mm_movemask_epi8(cmp) != 0xffff)
+			/* let the scalar path locate the exact dword */
+			return i + seq_check_scalar(src + i, start + i, 4);
+		val = _mm_add_epi32(val, four);
+	}
+
+	return i + seq_check_scalar(src + i, start + i, count - i);
+}
+#endif /* __SSE2__ */
+
+/* Dispatch table, resolved on first use.  Wider (AVX) kernels can be
+ * slotted in here as separate translation units compiled with the
+ * appropriate -m flags. */
+static void (*seq_fill_func)(uint32_t *, uint32_t, unsigned);
+static unsigned (*seq_check_func)(const uint32_t *, uint32_t, unsigned);
+
+static void seq_dispatch_init(void)
+{
+#ifdef __SSE2__
+	seq_fill_func = seq_fill_sse2;
+	seq_check_func = seq_check_sse2;
+#else
+	seq_fill_func = seq_fill_scalar;
+	seq_check_func = seq_check_scalar;
+#endif
+}
+
+void intel_seq_fill(uint32_t *dst, uint32_t start, unsigned count)
+{
+	if (!seq_fill_func)
+		seq_dispatch_init();
+	seq_fill_func(dst, start, count);
+}
+
+unsigned intel_seq_check(const uint32_t *src, uint32_t start, unsigned count)
+{
+	if (!seq_check_func)
+		seq_dispatch_init();
+	return seq_check_func(src, start, count);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_TILE_CHECK_H
+#define INTEL_TILE_CHECK_H
+
+#include <stdint.h>
+
+/*
+ * Vectorized fill/compare kernels for the sequential dword patterns the
+ * tiled tests use (buf[i] == start + i).  Callers are expected to hoist
+ * any tiling/swizzle addressing out of their inner loops and hand these
+ * helpers one contiguous row at a time; the kernels are runtime-dispatched
+ * to the widest implementation the CPU supports.
+ */
+
+/* dst[i] = start + i for i in [0, count) */
+void intel_seq_fill(uint32_t *dst, uint32_t start, unsigned count);
+
+/* Returns the index of the first dword that doesn't match start + i, or
+ * count if the whole row matches. */
+unsigned intel_seq_check(const uint32_t *src, uint32_t start, unsigned count);
+
+#endif /* INTEL_TILE_CHECK_H */
@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "i915_drm.h"
+#include "intel_tiled_copy.h"
+
+/* gen3+ X tile: 8 rows of 512 bytes */
+#define X_TILE_WIDTH	512
+#define X_TILE_HEIGHT	8
+#define X_TILE_SIZE	4096
+
+/* bit 6 swizzling never crosses a 64 byte boundary */
+#define CHUNK		64
+
+int intel_swizzle_supported(uint32_t swizzle)
+{
+	switch (swizzle) {
+	case I915_BIT_6_SWIZZLE_NONE:
+	case I915_BIT_6_SWIZZLE_9:
+	case I915_BIT_6_SWIZZLE_9_10:
+	case I915_BIT_6_SWIZZLE_9_11:
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static unsigned swizzle_offset(unsigned offset, uint32_t swizzle)
+{
+	unsigned bit6 = 0;
+
+	switch (swizzle) {
+	case I915_BIT_6_SWIZZLE_9:
+		bit6 = (offset >> 9) & 1;
+		break;
+	case I915_BIT_6_SWIZZLE_9_10:
+		bit6 = ((offset >> 9) ^ (offset >> 10)) & 1;
+		break;
+	case I915_BIT_6_SWIZZLE_9_11:
+		bit6 = ((offset >> 9) ^ (offset >> 11)) & 1;
+		break;
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		bit6 = ((offset >> 9) ^ (offset >> 10) ^ (offset >> 11)) & 1;
+		break;
+	}
+
+	return offset ^ (bit6 << 6);
+}
+
+/* Walk the tiled surface chunk by chunk; for each 64 byte chunk compute
+ * the matching linear offset once and copy the whole chunk. */
+static void copy_blocked(char *dst, const char *src,
+			 unsigned stride, unsigned size, uint32_t swizzle,
+			 int to_tiled)
+{
+	unsigned tiles_per_row = stride / X_TILE_WIDTH;
+	unsigned t;
+
+	assert(stride % X_TILE_WIDTH == 0);
+	assert(size % X_TILE_SIZE == 0);
+	assert(intel_swizzle_supported(swizzle));
+
+	for (t = 0; t < size; t += CHUNK) {
+		unsigned tile_index = t / X_TILE_SIZE;
+		unsigned tile_off = t & (X_TILE_SIZE - 1);
+		unsigned linear =
+			(tile_index / tiles_per_row * X_TILE_HEIGHT +
+			 tile_off / X_TILE_WIDTH) * stride +
+			tile_index % tiles_per_row * X_TILE_WIDTH +
+			(tile_off & (X_TILE_WIDTH - 1));
+		unsigned tiled = swizzle_offset(t, swizzle);
+
+		if (to_tiled)
+			memcpy(dst + tiled, src + linear, CHUNK);
+		else
+			memcpy(dst + linear, src + tiled, CHUNK);
+	}
+}
+
+void intel_linear_to_tiled_x(void *tiled, const void *linear,
+			     unsigned stride, unsigned size, uint32_t swizzle)
+{
+	copy_blocked(tiled, linear, stride, size, swizzle, 1);
+}
+
+void intel_tiled_x_to_linear(void *linear, const void *tiled,
+			     unsigned stride, unsigned size, uint32_t swizzle)
+{
+	copy_blocked(linear, tiled, stride, size, swizzle, 0);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_TILED_COPY_H
+#define INTEL_TILED_COPY_H
+
+#include <stdint.h>
+
+/*
+ * Blocked software conversion between the linear and X-tiled (gen3+)
+ * layouts.  Bit 6 swizzling only ever permutes whole 64 byte chunks, so
+ * the copy walks the tiled surface one chunk at a time and memcpys each
+ * one - the address translation runs per chunk instead of per byte,
+ * which is what makes these usable on whole-of-memory tests.
+ *
+ * The stride must be a multiple of the 512 byte tile width and the size
+ * a multiple of the 4096 byte tile.
+ */
+
+/* The physical-address dependent bit 17 swizzles can't be computed from
+ * userspace; callers should fall back to fenced GTT access for those. */
+int intel_swizzle_supported(uint32_t swizzle);
+
+void intel_linear_to_tiled_x(void *tiled, const void *linear,
+			     unsigned stride, unsigned size,
+			     uint32_t swizzle);
+void intel_tiled_x_to_linear(void *linear, const void *tiled,
+			     unsigned stride, unsigned size,
+			     uint32_t swizzle);
+
+#endif /* INTEL_TILED_COPY_H */
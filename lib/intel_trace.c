@@ -0,0 +1,419 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intel_trace.h"
+
+#define TRACE_MAGIC	0x49545243 /* "ITRC" */
+#define TRACE_VERSION	1
+
+struct trace_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_streams;
+	uint32_t block_samples;
+	uint64_t dir_offset;	/* patched in on close */
+	uint64_t num_blocks;
+};
+
+struct trace_dir_entry {
+	uint64_t offset;
+	uint64_t first_time;
+	uint32_t num_samples;
+	uint32_t size;		/* encoded block size in bytes */
+};
+
+/* worst case one sample encodes to 10 bytes of time delta plus 5 bytes
+ * per stream; sized so a block buffer never overflows */
+#define BLOCK_BUF_SIZE(streams) \
+	(INTEL_TRACE_BLOCK_SAMPLES * (10 + 5 * (streams)) + 64)
+
+struct intel_trace_writer {
+	FILE *file;
+	int num_streams;
+
+	uint8_t *buf;
+	int buf_used;
+	int block_count;
+	uint64_t block_first_time;
+	uint64_t prev_time;
+	uint32_t prev_values[INTEL_TRACE_MAX_STREAMS];
+
+	struct trace_dir_entry *dir;
+	uint64_t num_blocks;
+	uint64_t dir_capacity;
+	uint64_t write_offset;
+};
+
+static int emit_varint(uint8_t *buf, uint64_t v)
+{
+	int n = 0;
+
+	while (v >= 0x80) {
+		buf[n++] = v | 0x80;
+		v >>= 7;
+	}
+	buf[n++] = v;
+	return n;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return (v >> 1) ^ -(int64_t)(v & 1);
+}
+
+struct intel_trace_writer *
+intel_trace_writer_create(const char *path,
+			  const char *const *stream_names, int num_streams)
+{
+	struct intel_trace_writer *writer;
+	struct trace_header header;
+	char name[INTEL_TRACE_STREAM_NAME_LEN];
+	int i;
+
+	assert(num_streams > 0 && num_streams <= INTEL_TRACE_MAX_STREAMS);
+
+	writer = calloc(sizeof(*writer), 1);
+	assert(writer);
+
+	writer->file = fopen(path, "w");
+	if (writer->file == NULL) {
+		free(writer);
+		return NULL;
+	}
+
+	writer->num_streams = num_streams;
+	writer->buf = malloc(BLOCK_BUF_SIZE(num_streams));
+	assert(writer->buf);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.num_streams = num_streams;
+	header.block_samples = INTEL_TRACE_BLOCK_SAMPLES;
+	fwrite(&header, sizeof(header), 1, writer->file);
+
+	for (i = 0; i < num_streams; i++) {
+		memset(name, 0, sizeof(name));
+		strncpy(name, stream_names[i], sizeof(name) - 1);
+		fwrite(name, sizeof(name), 1, writer->file);
+	}
+
+	writer->write_offset = sizeof(header) + num_streams * sizeof(name);
+
+	return writer;
+}
+
+static void flush_block(struct intel_trace_writer *writer)
+{
+	struct trace_dir_entry *entry;
+
+	if (writer->block_count == 0)
+		return;
+
+	if (writer->num_blocks == writer->dir_capacity) {
+		writer->dir_capacity = writer->dir_capacity ?
+			writer->dir_capacity * 2 : 64;
+		writer->dir = realloc(writer->dir, writer->dir_capacity *
+				      sizeof(*writer->dir));
+		assert(writer->dir);
+	}
+
+	entry = &writer->dir[writer->num_blocks++];
+	entry->offset = writer->write_offset;
+	entry->first_time = writer->block_first_time;
+	entry->num_samples = writer->block_count;
+	entry->size = writer->buf_used;
+
+	fwrite(writer->buf, writer->buf_used, 1, writer->file);
+	writer->write_offset += writer->buf_used;
+	writer->buf_used = 0;
+	writer->block_count = 0;
+}
+
+void intel_trace_write_sample(struct intel_trace_writer *writer,
+			      uint64_t time_us, const uint32_t *values)
+{
+	uint8_t *p = writer->buf + writer->buf_used;
+	int i;
+
+	if (writer->block_count == 0) {
+		/* block opener: everything raw, the delta baseline */
+		writer->block_first_time = time_us;
+		memcpy(p, &time_us, sizeof(time_us));
+		p += sizeof(time_us);
+		memcpy(p, values, writer->num_streams * sizeof(*values));
+		p += writer->num_streams * sizeof(*values);
+	} else {
+		assert(time_us >= writer->prev_time);
+		p += emit_varint(p, time_us - writer->prev_time);
+		for (i = 0; i < writer->num_streams; i++)
+			p += emit_varint(p, zigzag((int64_t)values[i] -
+					 writer->prev_values[i]));
+	}
+
+	writer->buf_used = p - writer->buf;
+	writer->prev_time = time_us;
+	memcpy(writer->prev_values, values,
+	       writer->num_streams * sizeof(*values));
+
+	if (++writer->block_count == INTEL_TRACE_BLOCK_SAMPLES)
+		flush_block(writer);
+}
+
+void intel_trace_writer_close(struct intel_trace_writer *writer)
+{
+	struct trace_header header;
+
+	flush_block(writer);
+
+	fwrite(writer->dir, sizeof(*writer->dir), writer->num_blocks,
+	       writer->file);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.num_streams = writer->num_streams;
+	header.block_samples = INTEL_TRACE_BLOCK_SAMPLES;
+	header.dir_offset = writer->write_offset;
+	header.num_blocks = writer->num_blocks;
+	rewind(writer->file);
+	fwrite(&header, sizeof(header), 1, writer->file);
+
+	fclose(writer->file);
+	free(writer->dir);
+	free(writer->buf);
+	free(writer);
+}
+
+struct intel_trace_reader {
+	FILE *file;
+	struct trace_header header;
+	char (*names)[INTEL_TRACE_STREAM_NAME_LEN];
+	struct trace_dir_entry *dir;
+
+	/* decoded samples of the loaded block */
+	uint64_t cur_block;
+	int cur_sample;
+	int cur_count;
+	uint64_t *times;
+	uint32_t *values;
+	uint8_t *buf;
+};
+
+struct intel_trace_reader *intel_trace_reader_open(const char *path)
+{
+	struct intel_trace_reader *reader;
+
+	reader = calloc(sizeof(*reader), 1);
+	assert(reader);
+
+	reader->file = fopen(path, "r");
+	if (reader->file == NULL)
+		goto err_free;
+
+	if (fread(&reader->header, sizeof(reader->header), 1,
+		  reader->file) != 1 ||
+	    reader->header.magic != TRACE_MAGIC ||
+	    reader->header.version != TRACE_VERSION ||
+	    reader->header.num_streams > INTEL_TRACE_MAX_STREAMS)
+		goto err_close;
+
+	reader->names = malloc(reader->header.num_streams *
+			       INTEL_TRACE_STREAM_NAME_LEN);
+	assert(reader->names);
+	if (fread(reader->names, INTEL_TRACE_STREAM_NAME_LEN,
+		  reader->header.num_streams, reader->file) !=
+	    reader->header.num_streams)
+		goto err_close;
+
+	reader->dir = malloc(reader->header.num_blocks *
+			     sizeof(*reader->dir));
+	assert(reader->dir || reader->header.num_blocks == 0);
+	if (fseek(reader->file, reader->header.dir_offset, SEEK_SET) ||
+	    fread(reader->dir, sizeof(*reader->dir),
+		  reader->header.num_blocks, reader->file) !=
+	    reader->header.num_blocks)
+		goto err_close;
+
+	reader->times = malloc(reader->header.block_samples *
+			       sizeof(*reader->times));
+	reader->values = malloc(reader->header.block_samples *
+				reader->header.num_streams *
+				sizeof(*reader->values));
+	reader->buf = malloc(BLOCK_BUF_SIZE(reader->header.num_streams));
+	assert(reader->times && reader->values && reader->buf);
+
+	reader->cur_block = 0;
+	reader->cur_count = 0; /* nothing decoded yet */
+
+	return reader;
+
+err_close:
+	fclose(reader->file);
+	free(reader->names);
+	free(reader->dir);
+err_free:
+	free(reader);
+	return NULL;
+}
+
+int intel_trace_reader_num_streams(const struct intel_trace_reader *reader)
+{
+	return reader->header.num_streams;
+}
+
+const char *
+intel_trace_reader_stream_name(const struct intel_trace_reader *reader,
+			       int stream)
+{
+	assert(stream >= 0 && stream < (int)reader->header.num_streams);
+	return reader->names[stream];
+}
+
+static uint64_t read_varint(const uint8_t **p)
+{
+	uint64_t v = 0;
+	int shift = 0;
+
+	while (**p & 0x80) {
+		v |= (uint64_t)(**p & 0x7f) << shift;
+		shift += 7;
+		(*p)++;
+	}
+	v |= (uint64_t)**p << shift;
+	(*p)++;
+	return v;
+}
+
+static int load_block(struct intel_trace_reader *reader, uint64_t block)
+{
+	const struct trace_dir_entry *entry;
+	const uint8_t *p;
+	uint64_t time;
+	uint32_t prev[INTEL_TRACE_MAX_STREAMS];
+	int num_streams = reader->header.num_streams;
+	int i, s;
+
+	if (block >= reader->header.num_blocks)
+		return 0;
+	entry = &reader->dir[block];
+
+	if (fseek(reader->file, entry->offset, SEEK_SET) ||
+	    fread(reader->buf, entry->size, 1, reader->file) != 1)
+		return 0;
+
+	p = reader->buf;
+	memcpy(&time, p, sizeof(time));
+	p += sizeof(time);
+	memcpy(prev, p, num_streams * sizeof(*prev));
+	p += num_streams * sizeof(*prev);
+
+	reader->times[0] = time;
+	memcpy(&reader->values[0], prev, num_streams * sizeof(*prev));
+
+	for (i = 1; i < (int)entry->num_samples; i++) {
+		time += read_varint(&p);
+		reader->times[i] = time;
+		for (s = 0; s < num_streams; s++) {
+			prev[s] += unzigzag(read_varint(&p));
+			reader->values[i * num_streams + s] = prev[s];
+		}
+	}
+
+	reader->cur_block = block;
+	reader->cur_sample = 0;
+	reader->cur_count = entry->num_samples;
+	return 1;
+}
+
+int intel_trace_reader_seek(struct intel_trace_reader *reader,
+			    uint64_t time_us)
+{
+	uint64_t lo = 0, hi = reader->header.num_blocks;
+
+	if (hi == 0)
+		return 0;
+
+	/* last block whose first sample is not after the target */
+	while (hi - lo > 1) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (reader->dir[mid].first_time <= time_us)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	if (!load_block(reader, lo))
+		return 0;
+
+	while (reader->cur_sample < reader->cur_count &&
+	       reader->times[reader->cur_sample] < time_us)
+		reader->cur_sample++;
+
+	/* target is past this block; the next one starts beyond it */
+	if (reader->cur_sample == reader->cur_count &&
+	    !load_block(reader, lo + 1))
+		return 0;
+
+	return 1;
+}
+
+int intel_trace_reader_next(struct intel_trace_reader *reader,
+			    uint64_t *time_us, uint32_t *values)
+{
+	if (reader->cur_sample == reader->cur_count &&
+	    !load_block(reader, reader->cur_count ?
+			reader->cur_block + 1 : 0))
+		return 0;
+
+	*time_us = reader->times[reader->cur_sample];
+	memcpy(values,
+	       &reader->values[reader->cur_sample *
+			       reader->header.num_streams],
+	       reader->header.num_streams * sizeof(*values));
+	reader->cur_sample++;
+	return 1;
+}
+
+void intel_trace_reader_close(struct intel_trace_reader *reader)
+{
+	fclose(reader->file);
+	free(reader->names);
+	free(reader->dir);
+	free(reader->times);
+	free(reader->values);
+	free(reader->buf);
+	free(reader);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_TRACE_H
+#define INTEL_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Shared container for register-sample traces.
+ *
+ * A trace is a set of named u32 streams sampled together.  Samples are
+ * grouped into blocks; within a block the first sample is stored raw
+ * and the rest as zigzag varint deltas per stream, which shrinks the
+ * typical mostly-idle counter trace by an order of magnitude over raw
+ * records.  A block directory at the end of the file carries the first
+ * timestamp of each block, so a reader seeks in O(log blocks) instead
+ * of decoding from the start.
+ */
+
+#define INTEL_TRACE_MAX_STREAMS		32
+#define INTEL_TRACE_STREAM_NAME_LEN	32
+#define INTEL_TRACE_BLOCK_SAMPLES	1024
+
+struct intel_trace_writer;
+struct intel_trace_reader;
+
+struct intel_trace_writer *
+intel_trace_writer_create(const char *path,
+			  const char *const *stream_names, int num_streams);
+/* values[] must hold one entry per stream; time must not go backwards */
+void intel_trace_write_sample(struct intel_trace_writer *writer,
+			      uint64_t time_us, const uint32_t *values);
+/* flushes the open block and writes the directory */
+void intel_trace_writer_close(struct intel_trace_writer *writer);
+
+struct intel_trace_reader *intel_trace_reader_open(const char *path);
+int intel_trace_reader_num_streams(const struct intel_trace_reader *reader);
+const char *intel_trace_reader_stream_name(const struct intel_trace_reader *reader,
+					   int stream);
+/* position at the first sample with time >= time_us */
+int intel_trace_reader_seek(struct intel_trace_reader *reader,
+			    uint64_t time_us);
+/* returns 1 and fills time/values, or 0 at end of trace */
+int intel_trace_reader_next(struct intel_trace_reader *reader,
+			    uint64_t *time_us, uint32_t *values);
+void intel_trace_reader_close(struct intel_trace_reader *reader);
+
+#endif /* INTEL_TRACE_H */
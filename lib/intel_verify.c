@@ -0,0 +1,260 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "drmtest.h"
+#include "intel_crc32c.h"
+#include "intel_verify.h"
+
+struct verify_entry {
+	drm_intel_bo *bo;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t crc;
+	enum intel_verify_map map_mode;
+};
+
+static struct verify_entry *verify_ring;
+static int verify_depth, verify_head, verify_tail, verify_count;
+static int verify_busy, verify_stop;
+static int verify_fd = -1;
+static pthread_t *verify_threads;
+static int verify_num_threads;
+static pthread_mutex_t verify_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t verify_not_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t verify_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t verify_idle = PTHREAD_COND_INITIALIZER;
+
+static void check_entry(struct verify_entry *e,
+			void **scratch, uint32_t *scratch_size)
+{
+	uint32_t crc;
+
+	if (e->map_mode == INTEL_VERIFY_GTT) {
+		do_or_die(drm_intel_gem_bo_map_gtt(e->bo));
+		crc = intel_crc32c(0, (char *)e->bo->virtual + e->offset,
+				   e->size);
+		drm_intel_gem_bo_unmap_gtt(e->bo);
+	} else {
+		if (*scratch_size < e->size) {
+			free(*scratch);
+			*scratch = malloc(e->size);
+			assert(*scratch);
+			*scratch_size = e->size;
+		}
+		gem_read(verify_fd, e->bo->handle, e->offset,
+			 *scratch, e->size);
+		crc = intel_crc32c(0, *scratch, e->size);
+	}
+
+	if (crc != e->crc) {
+		fprintf(stderr, "bo handle %d (offset 0x%x): "
+			"crc mismatch, expected 0x%08x, found 0x%08x\n",
+			e->bo->handle, e->offset, e->crc, crc);
+		abort();
+	}
+
+	drm_intel_bo_unreference(e->bo);
+}
+
+static void *verify_worker(void *arg)
+{
+	uint32_t scratch_size = 0;
+	void *scratch = NULL;
+
+	pthread_mutex_lock(&verify_lock);
+	for (;;) {
+		struct verify_entry entry;
+
+		while (verify_count == 0 && !verify_stop)
+			pthread_cond_wait(&verify_not_empty, &verify_lock);
+		if (verify_count == 0)
+			break;
+
+		entry = verify_ring[verify_tail];
+		verify_tail = (verify_tail + 1) % verify_depth;
+		verify_count--;
+		verify_busy++;
+		pthread_cond_signal(&verify_not_full);
+		pthread_mutex_unlock(&verify_lock);
+
+		check_entry(&entry, &scratch, &scratch_size);
+
+		pthread_mutex_lock(&verify_lock);
+		verify_busy--;
+		if (verify_count == 0 && verify_busy == 0)
+			pthread_cond_broadcast(&verify_idle);
+	}
+	pthread_mutex_unlock(&verify_lock);
+
+	free(scratch);
+	return NULL;
+}
+
+void intel_verify_init(int fd, int num_threads, int queue_depth)
+{
+	int i;
+
+	assert(verify_threads == NULL);
+	assert(num_threads > 0 && queue_depth > 0);
+
+	verify_fd = fd;
+	verify_depth = queue_depth;
+	verify_head = verify_tail = verify_count = 0;
+	verify_busy = verify_stop = 0;
+
+	verify_ring = calloc(queue_depth, sizeof(*verify_ring));
+	verify_threads = calloc(num_threads, sizeof(*verify_threads));
+	assert(verify_ring && verify_threads);
+
+	verify_num_threads = num_threads;
+	for (i = 0; i < num_threads; i++)
+		assert(pthread_create(&verify_threads[i], NULL,
+				      verify_worker, NULL) == 0);
+}
+
+void intel_verify_queue(drm_intel_bo *bo, uint32_t offset, uint32_t size,
+			uint32_t crc, enum intel_verify_map map_mode)
+{
+	struct verify_entry *e;
+
+	/* the reference keeps the bo (and its contents) alive until the
+	 * worker has finished with it */
+	drm_intel_bo_reference(bo);
+
+	pthread_mutex_lock(&verify_lock);
+	while (verify_count == verify_depth)
+		pthread_cond_wait(&verify_not_full, &verify_lock);
+
+	e = &verify_ring[verify_head];
+	e->bo = bo;
+	e->offset = offset;
+	e->size = size;
+	e->crc = crc;
+	e->map_mode = map_mode;
+	verify_head = (verify_head + 1) % verify_depth;
+	verify_count++;
+
+	pthread_cond_signal(&verify_not_empty);
+	pthread_mutex_unlock(&verify_lock);
+}
+
+void intel_verify_drain(void)
+{
+	pthread_mutex_lock(&verify_lock);
+	while (verify_count || verify_busy)
+		pthread_cond_wait(&verify_idle, &verify_lock);
+	pthread_mutex_unlock(&verify_lock);
+}
+
+void intel_verify_fini(void)
+{
+	int i;
+
+	if (verify_threads == NULL)
+		return;
+
+	pthread_mutex_lock(&verify_lock);
+	verify_stop = 1;
+	pthread_cond_broadcast(&verify_not_empty);
+	pthread_mutex_unlock(&verify_lock);
+
+	for (i = 0; i < verify_num_threads; i++)
+		pthread_join(verify_threads[i], NULL);
+
+	free(verify_threads);
+	free(verify_ring);
+	verify_threads = NULL;
+	verify_ring = NULL;
+	verify_fd = -1;
+}
+
+int intel_verify_sample_percent(void)
+{
+	static int percent = -1;
+
+	if (percent < 0) {
+		const char *env = getenv("INTEL_VERIFY_SAMPLE");
+
+		percent = env ? atoi(env) : 0;
+		if (percent < 0 || percent > 100)
+			percent = 0;
+	}
+
+	return percent;
+}
+
+void intel_verify_sample_init(struct intel_verify_sample *sample,
+			      uint32_t size, uint32_t pass, int percent)
+{
+	static uint32_t base_seed;
+	static int seed_read;
+	uint32_t seed;
+
+	if (!seed_read) {
+		const char *env = getenv("INTEL_VERIFY_SEED");
+
+		base_seed = env ? strtoul(env, NULL, 0) : 0x8f1bbcdc;
+		seed_read = 1;
+	}
+
+	sample->lines = size / INTEL_VERIFY_SPAN;
+	assert(sample->lines > 0);
+
+	/* mix the pass number so consecutive passes visit different
+	 * spans, but a rerun with the same seed visits the same ones */
+	seed = (base_seed ^ pass) * 2654435761u;
+
+	sample->start = seed % sample->lines;
+	/* any odd step is coprime with a power-of-two line count; for
+	 * other counts the walk may revisit spans, which only costs a
+	 * duplicate check */
+	sample->step = ((seed >> 16) | 1) % sample->lines;
+	if (sample->step == 0)
+		sample->step = 1;
+
+	sample->picked = ((uint64_t)sample->lines * percent + 99) / 100;
+	if (sample->picked == 0)
+		sample->picked = 1;
+	sample->idx = 0;
+}
+
+int64_t intel_verify_sample_next(struct intel_verify_sample *sample)
+{
+	uint32_t line;
+
+	if (sample->idx >= sample->picked)
+		return -1;
+
+	line = (sample->start + (uint64_t)sample->idx * sample->step) %
+		sample->lines;
+	sample->idx++;
+
+	return (int64_t)line * INTEL_VERIFY_SPAN;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_VERIFY_H
+#define INTEL_VERIFY_H
+
+#include <stdint.h>
+
+#include "intel_bufmgr.h"
+
+/* Asynchronous bo content verification.  Tests that stream many copies
+ * queue a (bo, expected crc) pair after each one and keep submitting;
+ * worker threads read the bo back and compare crcs in the background,
+ * aborting on the first mismatch.  The queue is bounded, so a submitter
+ * that outruns the readback simply blocks instead of piling up work.
+ */
+
+/* how the worker should read the bo back */
+enum intel_verify_map {
+	INTEL_VERIFY_PREAD,	/* pread through the kernel, linear bos */
+	INTEL_VERIFY_GTT,	/* gtt mapping, gives the fenced view */
+};
+
+void intel_verify_init(int fd, int num_threads, int queue_depth);
+/* takes a reference on the bo for the lifetime of the check */
+void intel_verify_queue(drm_intel_bo *bo, uint32_t offset, uint32_t size,
+			uint32_t crc, enum intel_verify_map map_mode);
+/* block until every queued check has completed */
+void intel_verify_drain(void);
+void intel_verify_fini(void);
+
+/*
+ * Sparse sampling for soak tests.
+ *
+ * Checking every byte of every buffer per pass caps how many passes a
+ * soak hour buys; the corruptions we chase are systematic, so checking
+ * a deterministic random sample of cachelines catches them with nearly
+ * the same probability at a fraction of the cost.  The sample is
+ * seeded from the pass number (plus INTEL_VERIFY_SEED if set), so a
+ * failing run replays with identical coverage.  On any sampled
+ * mismatch the caller escalates to its full verify.
+ *
+ * INTEL_VERIFY_SAMPLE=<percent> enables the mode; 0/unset means full
+ * verification as before.
+ */
+
+#define INTEL_VERIFY_SPAN 64
+
+struct intel_verify_sample {
+	uint32_t lines;		/* spans in the buffer */
+	uint32_t start, step;	/* derived from the seed */
+	uint32_t picked;	/* spans to visit */
+	uint32_t idx;
+};
+
+/* percent from INTEL_VERIFY_SAMPLE, 0 when sampling is off */
+int intel_verify_sample_percent(void);
+void intel_verify_sample_init(struct intel_verify_sample *sample,
+			      uint32_t size, uint32_t pass, int percent);
+/* byte offset of the next span to check, -1 when the sample is done */
+int64_t intel_verify_sample_next(struct intel_verify_sample *sample);
+
+#endif /* INTEL_VERIFY_H */
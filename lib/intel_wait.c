@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "intel_wait.h"
+
+static uint64_t wait_now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void intel_wait_init(struct intel_wait *wait)
+{
+	memset(wait, 0, sizeof(*wait));
+	wait->spin_limit = 100;
+	wait->min_sleep_us = 1;
+	wait->max_sleep_us = 1000;
+}
+
+int intel_wait_for(struct intel_wait *wait,
+		   int (*cond)(void *data), void *data,
+		   uint64_t timeout_us)
+{
+	uint64_t start = 0;
+	unsigned sleep_us;
+	unsigned i;
+
+	wait->waits++;
+
+	for (i = 0; i < wait->spin_limit; i++) {
+		if (cond(data)) {
+			wait->spins += i;
+			return 0;
+		}
+		intel_wait_relax();
+	}
+	wait->spins += wait->spin_limit;
+
+	if (timeout_us)
+		start = wait_now_us();
+
+	sleep_us = wait->min_sleep_us;
+	for (;;) {
+		if (cond(data))
+			return 0;
+		if (timeout_us && wait_now_us() - start >= timeout_us)
+			return cond(data) ? 0 : -1;
+
+		usleep(sleep_us);
+		wait->sleeps++;
+		wait->slept_us += sleep_us;
+
+		sleep_us *= 2;
+		if (sleep_us > wait->max_sleep_us)
+			sleep_us = wait->max_sleep_us;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_WAIT_H
+#define INTEL_WAIT_H
+
+#include <stdint.h>
+
+/* Shared busy-wait primitive: spin with the pause instruction for
+ * conditions that resolve in under a microsecond, then back off into
+ * exponentially growing sleeps for the ones that don't.  The struct
+ * doubles as the statistics record, so a caller can see how often its
+ * wait resolved in the cheap spin phase and how much time it burnt
+ * sleeping. */
+struct intel_wait {
+	/* tuning, filled with defaults by intel_wait_init() */
+	unsigned spin_limit;	/* pause spins before the first sleep */
+	unsigned min_sleep_us;	/* initial backoff sleep */
+	unsigned max_sleep_us;	/* backoff cap */
+
+	/* statistics, accumulated across calls */
+	uint64_t waits;
+	uint64_t spins;
+	uint64_t sleeps;
+	uint64_t slept_us;
+};
+
+/* the hint keeps a spinning hyperthread from starving its sibling and
+ * drops the core out of speculative memory-order recovery stalls */
+static inline void intel_wait_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#endif
+}
+
+void intel_wait_init(struct intel_wait *wait);
+
+/* spin-then-sleep until cond(data) is true; timeout_us == 0 waits
+ * forever, otherwise returns -1 once the deadline passes */
+int intel_wait_for(struct intel_wait *wait,
+		   int (*cond)(void *data), void *data,
+		   uint64_t timeout_us);
+
+#endif /* INTEL_WAIT_H */
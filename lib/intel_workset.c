@@ -0,0 +1,189 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "intel_bufmgr.h"
+#include "intel_workset.h"
+
+#define WORKSET_MAGIC	0x57534554 /* 'WSET' */
+#define WORKSET_VERSION	1
+
+struct workset_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t num_bos;
+};
+
+struct workset_record {
+	uint64_t size;
+	uint32_t tiling;
+	uint32_t stride;
+};
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+
+	while (len) {
+		ssize_t ret = read(fd, p, len);
+
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+int intel_workset_save(const char *path, uint32_t devid,
+		       const struct intel_workset_slot *slots, int count)
+{
+	struct workset_header hdr;
+	char tmp_path[4096];
+	int fd, i;
+
+	/* write-then-rename, so a crash mid-save never leaves a
+	 * truncated file that a later restore would trust */
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+	    (int)sizeof(tmp_path))
+		return -1;
+
+	fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+	if (fd < 0)
+		return -1;
+
+	hdr.magic = WORKSET_MAGIC;
+	hdr.version = WORKSET_VERSION;
+	hdr.devid = devid;
+	hdr.num_bos = count;
+	if (write_all(fd, &hdr, sizeof(hdr)))
+		goto err;
+
+	for (i = 0; i < count; i++) {
+		struct workset_record rec;
+
+		rec.size = slots[i].size;
+		rec.tiling = slots[i].tiling;
+		rec.stride = slots[i].stride;
+		if (write_all(fd, &rec, sizeof(rec)))
+			goto err;
+
+		if (drm_intel_gem_bo_map_gtt(slots[i].bo))
+			goto err;
+		if (write_all(fd, slots[i].bo->virtual, rec.size)) {
+			drm_intel_gem_bo_unmap_gtt(slots[i].bo);
+			goto err;
+		}
+		drm_intel_gem_bo_unmap_gtt(slots[i].bo);
+	}
+
+	close(fd);
+	if (rename(tmp_path, path))
+		goto err_named;
+	return 0;
+
+err:
+	close(fd);
+err_named:
+	unlink(tmp_path);
+	return -1;
+}
+
+int intel_workset_restore(const char *path, uint32_t devid,
+			  struct intel_workset_slot *slots, int count)
+{
+	struct workset_header hdr;
+	int fd, i;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (read_all(fd, &hdr, sizeof(hdr)))
+		goto err;
+	if (hdr.magic != WORKSET_MAGIC ||
+	    hdr.version != WORKSET_VERSION ||
+	    hdr.devid != devid ||
+	    hdr.num_bos != (uint32_t)count)
+		goto err;
+
+	for (i = 0; i < count; i++) {
+		struct workset_record rec;
+		uint32_t tiling;
+
+		if (read_all(fd, &rec, sizeof(rec)))
+			goto err;
+		if (rec.size > (uint64_t)slots[i].bo->size)
+			goto err;
+
+		tiling = rec.tiling;
+		if (drm_intel_bo_set_tiling(slots[i].bo, &tiling,
+					    rec.stride) ||
+		    tiling != rec.tiling)
+			goto err;
+		slots[i].tiling = rec.tiling;
+		slots[i].stride = rec.stride;
+		slots[i].size = rec.size;
+
+		/* read() straight into the mapping, so the content never
+		 * takes a detour through a bounce buffer */
+		if (drm_intel_gem_bo_map_gtt(slots[i].bo))
+			goto err;
+		if (read_all(fd, slots[i].bo->virtual, rec.size)) {
+			drm_intel_gem_bo_unmap_gtt(slots[i].bo);
+			goto err;
+		}
+		drm_intel_gem_bo_unmap_gtt(slots[i].bo);
+	}
+
+	close(fd);
+	return 0;
+
+err:
+	close(fd);
+	return -1;
+}
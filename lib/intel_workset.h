@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_WORKSET_H
+#define INTEL_WORKSET_H
+
+#include <stdint.h>
+#include "intel_bufmgr.h"
+
+/*
+ * Working-set snapshot/restore.
+ *
+ * Tests that iterate on a failure rebuild their prepared working set
+ * from scratch on every attempt.  intel_workset_save() serializes the
+ * content, tiling and stride of an array of bos to a file once;
+ * intel_workset_restore() brings an equally-shaped array of bos back to
+ * that state with bulk writes, turning minutes of setup into an
+ * I/O-bound restore.  Snapshots are keyed by devid: a file written on
+ * different hardware is rejected and the caller rebuilds (and
+ * typically re-saves).
+ *
+ * Content goes through the GTT mapping, i.e. the detiled linear view,
+ * so a snapshot doesn't depend on the swizzle mode the kernel picked.
+ *
+ * Both return 0 on success and -1 on any mismatch or I/O error, in
+ * which case restore leaves no slot half-written that the caller can't
+ * simply overwrite by rebuilding.
+ */
+
+struct intel_workset_slot {
+	drm_intel_bo *bo;
+	uint32_t tiling;
+	uint32_t stride;
+	uint64_t size;		/* content bytes, <= bo->size */
+};
+
+int intel_workset_save(const char *path, uint32_t devid,
+		       const struct intel_workset_slot *slots, int count);
+/* applies the recorded tiling/stride to each slot (and its bo) before
+ * streaming the content back in */
+int intel_workset_restore(const char *path, uint32_t devid,
+			  struct intel_workset_slot *slots, int count);
+
+#endif /* INTEL_WORKSET_H */
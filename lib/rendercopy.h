@@ -1,3 +1,6 @@
+#ifndef RENDERCOPY_H
+#define RENDERCOPY_H
+
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <stdio.h>
@@ -23,6 +26,7 @@ struct scratch_buf {
     uint32_t *data;
     uint32_t *cpu_mapping;
     uint32_t size;
+    uint32_t offset; /* byte offset into bo for sub-allocated bufs, else 0 */
     unsigned num_tiles;
 };
 
@@ -58,6 +62,17 @@ static inline unsigned buf_height(struct scratch_buf *buf)
 	return buf->size/buf->stride;
 }
 
+/* One copy in a multi-copy batch; see gen6_render_multi_copyfunc() */
+struct render_copy_op {
+	struct scratch_buf *src, *dst;
+	unsigned src_x, src_y;
+	unsigned width, height;
+	unsigned dst_x, dst_y;
+};
+
+/* per-batch depth limit: state and command space in the 4KiB batch */
+#define RENDER_MULTI_MAX 8
+
 typedef void (*render_copyfunc_t)(struct intel_batchbuffer *batch,
 				  struct scratch_buf *src, unsigned src_x, unsigned src_y,
 				  unsigned width, unsigned height,
@@ -65,10 +80,28 @@ typedef void (*render_copyfunc_t)(struct intel_batchbuffer *batch,
 
 render_copyfunc_t get_render_copyfunc(int devid);
 
-void gen7_render_copyfunc(struct intel_batchbuffer *batch,
-			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
-			  unsigned width, unsigned height,
-			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y);
+/* Packs up to RENDER_MULTI_MAX copies into a single batch, sharing one
+ * pipeline-state emission; ops within a batch must not depend on each
+ * other (no op's dst doubling as another's src).  Returns the number of
+ * copies submitted.  NULL from the lookup means the generation only has
+ * the one-copy-per-batch path. */
+typedef int (*render_multi_copyfunc_t)(struct intel_batchbuffer *batch,
+				       struct render_copy_op *ops, int n);
+render_multi_copyfunc_t get_render_multi_copyfunc(int devid);
+int gen6_render_multi_copyfunc(struct intel_batchbuffer *batch,
+			       struct render_copy_op *ops, int n);
+
+/* gen7 is specialized per variant at compile time: the ivb/hsw
+ * differences are baked into the entry points so the emission path
+ * carries no devid tests.  Pick via get_render_copyfunc(). */
+void gen7_render_copyfunc_ivb(struct intel_batchbuffer *batch,
+			      struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			      unsigned width, unsigned height,
+			      struct scratch_buf *dst, unsigned dst_x, unsigned dst_y);
+void gen7_render_copyfunc_hsw(struct intel_batchbuffer *batch,
+			      struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			      unsigned width, unsigned height,
+			      struct scratch_buf *dst, unsigned dst_x, unsigned dst_y);
 void gen6_render_copyfunc(struct intel_batchbuffer *batch,
 			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
 			  unsigned width, unsigned height,
@@ -81,3 +114,5 @@ void gen2_render_copyfunc(struct intel_batchbuffer *batch,
 			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
 			  unsigned width, unsigned height,
 			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y);
+
+#endif /* RENDERCOPY_H */
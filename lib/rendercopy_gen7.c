@@ -78,6 +78,7 @@ static uint32_t
 gen7_bind_buf(struct intel_batchbuffer *batch,
 	      struct scratch_buf *buf,
 	      uint32_t format,
+	      uint32_t swizzle,
 	      int is_dst)
 {
 	uint32_t *ss;
@@ -96,20 +97,18 @@ gen7_bind_buf(struct intel_batchbuffer *batch,
 	ss[0] = (GEN7_SURFACE_2D << GEN7_SURFACE_TYPE_SHIFT |
 		 gen7_tiling_bits(buf->tiling) |
 		format << GEN7_SURFACE_FORMAT_SHIFT);
-	ss[1] = buf->bo->offset;
+	ss[1] = buf->bo->offset + buf->offset;
 	ss[2] = ((buf_width(buf) - 1)  << GEN7_SURFACE_WIDTH_SHIFT |
 		 (buf_height(buf) - 1) << GEN7_SURFACE_HEIGHT_SHIFT);
 	ss[3] = (buf->stride - 1) << GEN7_SURFACE_PITCH_SHIFT;
 	ss[4] = 0;
 	ss[5] = 0;
 	ss[6] = 0;
-	ss[7] = 0;
-	if (IS_HASWELL(batch->devid))
-		ss[7] |= HSW_SURFACE_SWIZZLE(RED, GREEN, BLUE, ALPHA);
+	ss[7] = swizzle;
 
 	ret = drm_intel_bo_emit_reloc(batch->bo,
 				      batch_offset(batch, ss) + 4,
-				      buf->bo, 0,
+				      buf->bo, buf->offset,
 				      read_domain, write_domain);
 	assert(ret == 0);
 
@@ -204,16 +203,19 @@ static void gen7_emit_vertex_buffer(struct intel_batchbuffer *batch,
 static uint32_t
 gen7_bind_surfaces(struct intel_batchbuffer *batch,
 		   struct scratch_buf *src,
-		   struct scratch_buf *dst)
+		   struct scratch_buf *dst,
+		   uint32_t swizzle)
 {
 	uint32_t *binding_table;
 
 	binding_table = batch_alloc(batch, 8, 32);
 
 	binding_table[0] =
-		gen7_bind_buf(batch, dst, GEN7_SURFACEFORMAT_B8G8R8A8_UNORM, 1);
+		gen7_bind_buf(batch, dst, GEN7_SURFACEFORMAT_B8G8R8A8_UNORM,
+			      swizzle, 1);
 	binding_table[1] =
-		gen7_bind_buf(batch, src, GEN7_SURFACEFORMAT_B8G8R8A8_UNORM, 0);
+		gen7_bind_buf(batch, src, GEN7_SURFACEFORMAT_B8G8R8A8_UNORM,
+			      swizzle, 0);
 
 	return batch_offset(batch, binding_table);
 }
@@ -221,10 +223,11 @@ gen7_bind_surfaces(struct intel_batchbuffer *batch,
 static void
 gen7_emit_binding_table(struct intel_batchbuffer *batch,
 			struct scratch_buf *src,
-			struct scratch_buf *dst)
+			struct scratch_buf *dst,
+			uint32_t swizzle)
 {
 	OUT_BATCH(GEN7_3DSTATE_BINDING_TABLE_POINTERS_PS | (2 - 2));
-	OUT_BATCH(gen7_bind_surfaces(batch, src, dst));
+	OUT_BATCH(gen7_bind_surfaces(batch, src, dst, swizzle));
 }
 
 static void
@@ -451,15 +454,8 @@ gen7_emit_sbe(struct intel_batchbuffer *batch)
 }
 
 static void
-gen7_emit_ps(struct intel_batchbuffer *batch)
+gen7_emit_ps(struct intel_batchbuffer *batch, uint32_t threads)
 {
-	int threads;
-
-	if (IS_HASWELL(batch->devid))
-		threads = 40 << HSW_PS_MAX_THREADS_SHIFT | 1 << HSW_PS_SAMPLE_MASK_SHIFT;
-	else
-		threads = 40 << IVB_PS_MAX_THREADS_SHIFT;
-
 	OUT_BATCH(GEN7_3DSTATE_PS | (8 - 2));
 	OUT_BATCH(batch_copy(batch, ps_kernel, sizeof(ps_kernel), 64));
 	OUT_BATCH(1 << GEN7_PS_SAMPLER_COUNT_SHIFT |
@@ -512,10 +508,18 @@ gen7_emit_null_depth_buffer(struct intel_batchbuffer *batch)
 }
 
 #define BATCH_STATE_SPLIT 2048
-void gen7_render_copyfunc(struct intel_batchbuffer *batch,
-			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
-			  unsigned width, unsigned height,
-			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
+
+/* The Haswell/Ivybridge differences (surface swizzle, PS thread field
+ * layout) are folded into constants by the per-variant entry points
+ * below, so the emission path itself never tests the devid.  Always
+ * inlined into both callers; any new in-gen variation must arrive the
+ * same way, as a parameter. */
+static inline void
+gen7_render_copy(struct intel_batchbuffer *batch,
+		 struct scratch_buf *src, unsigned src_x, unsigned src_y,
+		 unsigned width, unsigned height,
+		 struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
+		 uint32_t swizzle, uint32_t ps_threads)
 {
 	uint32_t batch_end;
 
@@ -542,11 +546,11 @@ void gen7_render_copyfunc(struct intel_batchbuffer *batch,
 	gen7_emit_cc(batch);
         gen7_emit_sampler(batch);
         gen7_emit_sbe(batch);
-        gen7_emit_ps(batch);
+        gen7_emit_ps(batch, ps_threads);
         gen7_emit_vertex_elements(batch);
         gen7_emit_vertex_buffer(batch,
 				src_x, src_y, dst_x, dst_y, width, height);
-	gen7_emit_binding_table(batch, src, dst);
+	gen7_emit_binding_table(batch, src, dst, swizzle);
 	gen7_emit_drawing_rectangle(batch, dst);
 
         OUT_BATCH(GEN7_3DPRIMITIVE | (7- 2));
@@ -566,3 +570,26 @@ void gen7_render_copyfunc(struct intel_batchbuffer *batch,
 	gen7_render_flush(batch, batch_end);
 	intel_batchbuffer_reset(batch);
 }
+
+void gen7_render_copyfunc_ivb(struct intel_batchbuffer *batch,
+			      struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			      unsigned width, unsigned height,
+			      struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
+{
+	gen7_render_copy(batch, src, src_x, src_y, width, height,
+			 dst, dst_x, dst_y,
+			 0,
+			 40 << IVB_PS_MAX_THREADS_SHIFT);
+}
+
+void gen7_render_copyfunc_hsw(struct intel_batchbuffer *batch,
+			      struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			      unsigned width, unsigned height,
+			      struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
+{
+	gen7_render_copy(batch, src, src_x, src_y, width, height,
+			 dst, dst_x, dst_y,
+			 HSW_SURFACE_SWIZZLE(RED, GREEN, BLUE, ALPHA),
+			 40 << HSW_PS_MAX_THREADS_SHIFT |
+			 1 << HSW_PS_SAMPLE_MASK_SHIFT);
+}
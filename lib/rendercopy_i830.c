@@ -128,7 +128,8 @@ static void gen2_emit_target(struct intel_batchbuffer *batch,
 
 	OUT_BATCH(_3DSTATE_BUF_INFO_CMD);
 	OUT_BATCH(BUF_3D_ID_COLOR_BACK | tiling | BUF_3D_PITCH(dst->stride));
-	OUT_RELOC(dst->bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_RELOC(dst->bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
+		  dst->offset);
 
 	OUT_BATCH(_3DSTATE_DST_BUF_VARS_CMD);
 	OUT_BATCH(COLR_BUF_ARGB8888 |
@@ -156,7 +157,7 @@ static void gen2_emit_texture(struct intel_batchbuffer *batch,
 		tiling |= TM0S1_TILE_WALK;
 
 	OUT_BATCH(_3DSTATE_LOAD_STATE_IMMEDIATE_2 | LOAD_TEXTURE_MAP(unit) | 4);
-	OUT_RELOC(src->bo, I915_GEM_DOMAIN_SAMPLER, 0, 0);
+	OUT_RELOC(src->bo, I915_GEM_DOMAIN_SAMPLER, 0, src->offset);
 	OUT_BATCH((buf_height(src) - 1) << TM0S1_HEIGHT_SHIFT |
 		  (buf_width(src) - 1) << TM0S1_WIDTH_SHIFT |
 		  MAPSURF_32BIT | MT_32BIT_ARGB8888 | tiling);
@@ -239,7 +240,17 @@ render_copyfunc_t get_render_copyfunc(int devid)
 	else if (IS_GEN6(devid))
 		copy = gen6_render_copyfunc;
 	else if (IS_GEN7(devid))
-		copy = gen7_render_copyfunc;
+		copy = IS_HASWELL(devid) ? gen7_render_copyfunc_hsw :
+					   gen7_render_copyfunc_ivb;
 
 	return copy;
 }
+
+render_multi_copyfunc_t get_render_multi_copyfunc(int devid)
+{
+	/* only the gen6 backend can pack several draws per batch so far */
+	if (IS_GEN6(devid))
+		return gen6_render_multi_copyfunc;
+
+	return NULL;
+}
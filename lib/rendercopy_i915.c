@@ -74,7 +74,7 @@ void gen3_render_copyfunc(struct intel_batchbuffer *batch,
 
 		OUT_BATCH(_3DSTATE_MAP_STATE | (3 * TEX_COUNT));
 		OUT_BATCH((1 << TEX_COUNT) - 1);
-		OUT_RELOC(src->bo, I915_GEM_DOMAIN_SAMPLER, 0, 0);
+		OUT_RELOC(src->bo, I915_GEM_DOMAIN_SAMPLER, 0, src->offset);
 		OUT_BATCH(MAPSURF_32BIT | MT_32BIT_ARGB8888 |
 			  tiling_bits |
 			  (buf_height(src) - 1) << MS3_HEIGHT_SHIFT |
@@ -103,7 +103,8 @@ void gen3_render_copyfunc(struct intel_batchbuffer *batch,
 		OUT_BATCH(_3DSTATE_BUF_INFO_CMD);
 		OUT_BATCH(BUF_3D_ID_COLOR_BACK | tiling_bits |
 			  BUF_3D_PITCH(dst->stride));
-		OUT_RELOC(dst->bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+		OUT_RELOC(dst->bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
+			  dst->offset);
 
 		OUT_BATCH(_3DSTATE_DST_BUF_VARS_CMD);
 		OUT_BATCH(COLR_BUF_ARGB8888 |
@@ -0,0 +1,56 @@
+#!/bin/bash
+#
+# usage: perf-report.sh [build-dir]
+#
+# Runs the designated benchmark set with the structured results log
+# enabled, then compares the fresh run against the stored baseline and
+# highlights regressions via intel_results_query -b.  On the first run
+# (no baseline yet) the fresh log is stored as the baseline.
+#
+# Environment:
+#   INTEL_PERF_BASELINE   baseline log (default ~/.intel-perf-baseline.log)
+#   INTEL_PERF_THRESHOLD  flag threshold in percent (default 10)
+#   INTEL_PERF_REBASE=1   store this run as the new baseline afterwards
+#
+# Exits 2 when any series moved past the threshold, like the query tool.
+
+top=${1:-.}
+baseline=${INTEL_PERF_BASELINE:-$HOME/.intel-perf-baseline.log}
+threshold=${INTEL_PERF_THRESHOLD:-10}
+log=`mktemp /tmp/intel-perf-XXXXXX.log`
+
+export INTEL_RESULTS_LOG=$log
+
+run() {
+	echo "==== $* ===="
+	"$@" || echo "($1 failed or skipped)"
+	echo
+}
+
+run $top/benchmarks/intel_upload_blit
+run $top/tests/gem_gtt_speed
+run $top/tests/gem_exec_blt
+
+if [ ! -s "$log" ]; then
+	echo "no results collected (benchmarks all skipped?)"
+	rm -f "$log"
+	exit 1
+fi
+
+if [ ! -r "$baseline" ]; then
+	cp "$log" "$baseline"
+	echo "no baseline found; stored this run as $baseline"
+	rm -f "$log"
+	exit 0
+fi
+
+$top/tools/intel_results_query -f "$log" -b "$baseline" -r "$threshold"
+status=$?
+
+if [ "$INTEL_PERF_REBASE" = "1" ]; then
+	cp "$log" "$baseline"
+	echo "baseline refreshed: $baseline"
+fi
+
+rm -f "$log"
+exit $status
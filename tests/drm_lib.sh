@@ -4,21 +4,34 @@ die() {
 	exit 1
 }
 
-if [ -d /debug/dri ] ; then
-	debugfs_path=/debug/dri
-fi
+# the C tools cache the resolved path per boot; reuse it when it still
+# validates rather than re-walking the mount points
+path_cache=/var/run/intel_path_cache
 
-if [ -d /sys/kernel/debug/dri ] ; then
-	debugfs_path=/sys/kernel/debug/dri
+i915_path=x
+if [ -r $path_cache ] ; then
+	cached=`sed -n 's/^debugfs //p' $path_cache`
+	if [ -n "$cached" ] && [ -f "$cached/i915_error_state" ] ; then
+		i915_path=$cached
+	fi
 fi
 
-i915_path=x
-for dir in `ls $debugfs_path` ; do
-	if [ -f $debugfs_path/$dir/i915_error_state ] ; then
-		i915_path=$debugfs_path/$dir
-		break
+if [ $i915_path = "x" ] ; then
+	if [ -d /debug/dri ] ; then
+		debugfs_path=/debug/dri
 	fi
-done
+
+	if [ -d /sys/kernel/debug/dri ] ; then
+		debugfs_path=/sys/kernel/debug/dri
+	fi
+
+	for dir in `ls $debugfs_path` ; do
+		if [ -f $debugfs_path/$dir/i915_error_state ] ; then
+			i915_path=$debugfs_path/$dir
+			break
+		fi
+	done
+fi
 
 if [ $i915_path = "x" ] ; then
 	die " i915 debugfs path not found."
@@ -38,6 +38,7 @@
 #include "drmtest.h"
 #include "intel_bufmgr.h"
 #include "intel_batchbuffer.h"
+#include "intel_clock.h"
 #include "intel_gpu_tools.h"
 
 static drm_intel_bufmgr *bufmgr;
@@ -48,58 +49,226 @@ struct intel_batchbuffer *batch;
  * We've had reports of the X server exhausting the default rlimit of 64k vma's
  * in the kernel. libdrm has grown facilities to limit the vma caching since,
  * this checks whether they actually work.
+ *
+ * One engine drives every access path as a subtest - cpu maps, gtt
+ * maps, both per bo, and gtt maps of bos kept busy on the active list
+ * so it's the bo cache's mmaps that must get reaped.  While churning
+ * it also measures what the kernel's vma bookkeeping costs as pressure
+ * grows: sustained map/unmap rate, the vma count high-water mark from
+ * /proc/self/maps, and per-access latency reported in ten slices over
+ * the run so a scaling trend is visible, not just a total.
  */
 
-/* we do both cpu and gtt maps, so only need half of 64k to exhaust */
-#define BO_ARRAY_SIZE 35000
-drm_intel_bo *bos[BO_ARRAY_SIZE];
+enum access_mode {
+	ACCESS_CPU,
+	ACCESS_GTT,
+	ACCESS_BOTH,
+};
 
-int main(int argc, char **argv)
+/* with both cpu and gtt maps per bo, half of 64k suffices to exhaust */
+#define BO_COUNT_SINGLE 68000
+#define BO_COUNT_BOTH 35000
+drm_intel_bo *bos[BO_COUNT_SINGLE];
+
+static int vma_count(void)
 {
-	int fd;
-	int i;
-	char *ptr;
+	char line[256];
+	FILE *file;
+	int count = 0;
 
-	fd = drm_open_any();
+	file = fopen("/proc/self/maps", "r");
+	if (file == NULL)
+		return -1;
 
-	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
-	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
-	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	while (fgets(line, sizeof(line), file))
+		count++;
+	fclose(file);
 
-	drm_intel_bufmgr_gem_set_vma_cache_size(bufmgr, 500);
+	return count;
+}
 
-	for (i = 0; i < BO_ARRAY_SIZE; i++) {
-		bos[i] = drm_intel_bo_alloc(bufmgr, "mmap bo", 4096, 4096);
-		assert(bos[i]);
+static int maps_per_access(enum access_mode mode)
+{
+	return mode == ACCESS_BOTH ? 2 : 1;
+}
 
-		drm_intel_bo_map(bos[i], 1);
-		ptr = bos[i]->virtual;
+static void access_bo(drm_intel_bo *bo, enum access_mode mode)
+{
+	char *ptr;
+
+	if (mode == ACCESS_CPU || mode == ACCESS_BOTH) {
+		drm_intel_bo_map(bo, 1);
+		ptr = bo->virtual;
 		assert(ptr);
 		*ptr = 'c';
-		drm_intel_bo_unmap(bos[i]);
+		drm_intel_bo_unmap(bo);
+	}
 
-		drm_intel_gem_bo_map_gtt(bos[i]);
-		ptr = bos[i]->virtual;
+	if (mode == ACCESS_GTT || mode == ACCESS_BOTH) {
+		drm_intel_gem_bo_map_gtt(bo);
+		ptr = bo->virtual;
 		assert(ptr);
 		*ptr = 'c';
-		drm_intel_gem_bo_unmap_gtt(bos[i]);
+		drm_intel_gem_bo_unmap_gtt(bo);
 	}
+}
+
+static void churn(enum access_mode mode, int count)
+{
+	uint64_t access_ticks = 0, total_ticks;
+	long maps = 0;
+	int window = count / 10;
+	int hiwater = 0, vmas;
+	int pass, i;
+
+	printf("%9s %12s %8s\n", "bos", "access_us", "vmas");
 
-	/* and recheck whether a second map of the same still works */
-	for (i = 0; i < BO_ARRAY_SIZE; i++) {
-		bos[i] = drm_intel_bo_alloc(bufmgr, "mmap bo", 4096, 4096);
-		assert(bos[i]);
+	total_ticks = intel_clock_now();
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < count; i++) {
+			uint64_t start;
 
-		drm_intel_bo_map(bos[i], 1);
-		ptr = bos[i]->virtual;
-		assert(*ptr = 'c');
-		drm_intel_bo_unmap(bos[i]);
+			bos[i] = drm_intel_bo_alloc(bufmgr, "mmap bo",
+						    4096, 4096);
+			if (bos[i] == NULL) {
+				/* the cliff is the measurement, not a
+				 * failure: report how far we got */
+				printf("allocation cliff at %d bos, "
+				       "pass %d\n", i, pass);
+				goto out;
+			}
 
-		drm_intel_gem_bo_map_gtt(bos[i]);
-		ptr = bos[i]->virtual;
-		assert(*ptr = 'c');
-		drm_intel_gem_bo_unmap_gtt(bos[i]);
+			start = intel_clock_now();
+			access_bo(bos[i], mode);
+			access_ticks += intel_clock_now() - start;
+			maps += maps_per_access(mode);
+
+			/* one slice per decile of the first pass; the
+			 * second pass (remap of cache-recycled bos)
+			 * only contributes to the totals */
+			if (pass == 0 && (i + 1) % window == 0) {
+				vmas = vma_count();
+				if (vmas > hiwater)
+					hiwater = vmas;
+				printf("%9d %12.2f %8d\n", i + 1,
+				       intel_clock_to_us(access_ticks) /
+				       (double)window, vmas);
+				access_ticks = 0;
+			}
+		}
 	}
+out:
+	total_ticks = intel_clock_now() - total_ticks;
+
+	vmas = vma_count();
+	if (vmas > hiwater)
+		hiwater = vmas;
+
+	printf("%ld maps in %.2fs (%.0f maps/s), vma high-water %d\n",
+	       maps,
+	       intel_clock_to_us(total_ticks) / 1e6,
+	       maps / (intel_clock_to_us(total_ticks) / 1e6),
+	       hiwater);
+}
+
+/* gtt maps of bos which stay busy on the active list, so what the
+ * limiter must reap are the mmaps of unused cached bos */
+static void churn_active_cached(void)
+{
+	drm_intel_bo *load_bo;
+	char *ptr;
+	int i;
+
+	load_bo = drm_intel_bo_alloc(bufmgr, "target bo", 1024*4096, 4096);
+	assert(load_bo);
+
+	/* IMPORTANT: we need to enable buffer reuse, otherwise we won't test
+	 * the libdrm bo cache! */
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	/* put some load onto the gpu to keep the light buffers active for long
+	 * enough */
+	for (i = 0; i < 10000; i++) {
+		BEGIN_BATCH(8);
+		OUT_BATCH(XY_SRC_COPY_BLT_CMD |
+			  XY_SRC_COPY_BLT_WRITE_ALPHA |
+			  XY_SRC_COPY_BLT_WRITE_RGB);
+		OUT_BATCH((3 << 24) | /* 32 bits */
+			  (0xcc << 16) | /* copy ROP */
+			  4096);
+		OUT_BATCH(0); /* dst x1,y1 */
+		OUT_BATCH((1024 << 16) | 512);
+		OUT_RELOC(load_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+		OUT_BATCH((0 << 16) | 512); /* src x1, y1 */
+		OUT_BATCH(4096);
+		OUT_RELOC(load_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
+		ADVANCE_BATCH();
+	}
+
+#define GROUP_SZ 100
+	for (i = 0; i < BO_COUNT_SINGLE; ) {
+		int j, got = 0;
+		drm_intel_bo *bo[GROUP_SZ];
+
+		for (j = 0; j < GROUP_SZ; j++, i++) {
+			bo[j] = drm_intel_bo_alloc(bufmgr, "mmap bo", 4096, 4096);
+			if (bo[j] == NULL) {
+				printf("allocation cliff at %d bos\n", i);
+				i = BO_COUNT_SINGLE;
+				break;
+			}
+			got++;
+
+			drm_intel_gem_bo_map_gtt(bo[j]);
+			ptr = bo[j]->virtual;
+			assert(ptr);
+			*ptr = 'c';
+			drm_intel_gem_bo_unmap_gtt(bo[j]);
+
+			/* put it onto the active list ... */
+			BEGIN_BATCH(6);
+			OUT_BATCH(XY_COLOR_BLT_CMD |
+				  XY_COLOR_BLT_WRITE_ALPHA |
+				  XY_COLOR_BLT_WRITE_RGB);
+			OUT_BATCH((3 << 24) | /* 32 bits */
+				  128);
+			OUT_BATCH(0); /* dst x1,y1 */
+			OUT_BATCH((1 << 16) | 1);
+			OUT_RELOC(bo[j], I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+			OUT_BATCH(0xffffffff); /* color */
+			ADVANCE_BATCH();
+		}
+		intel_batchbuffer_flush(batch);
+
+		for (j = 0; j < got; j++)
+			drm_intel_bo_unreference(bo[j]);
+	}
+
+	printf("cached churn done, vma high-water %d\n", vma_count());
+}
+
+int main(int argc, char **argv)
+{
+	int fd;
+
+	drmtest_subtest_init(argc, argv);
+
+	fd = drm_open_any();
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+
+	drm_intel_bufmgr_gem_set_vma_cache_size(bufmgr, 500);
+
+	if (drmtest_run_subtest("cpu"))
+		churn(ACCESS_CPU, BO_COUNT_SINGLE);
+	if (drmtest_run_subtest("gtt"))
+		churn(ACCESS_GTT, BO_COUNT_SINGLE);
+	if (drmtest_run_subtest("both"))
+		churn(ACCESS_BOTH, BO_COUNT_BOTH);
+	if (drmtest_run_subtest("active-cached"))
+		churn_active_cached();
 
 	intel_batchbuffer_free(batch);
 	drm_intel_bufmgr_destroy(bufmgr);
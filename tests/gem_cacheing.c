@@ -40,6 +40,7 @@
 #include "drmtest.h"
 #include "intel_bufmgr.h"
 #include "intel_batchbuffer.h"
+#include "intel_clock.h"
 #include "intel_gpu_tools.h"
 
 /*
@@ -99,6 +100,121 @@ blt_bo_fill(drm_intel_bo *tmp_bo, drm_intel_bo *bo, uint8_t val)
 	copy_bo(tmp_bo, bo);
 }
 
+/* Decision-support benchmark: for each cacheing level and access
+ * pattern, CPU bandwidth through the cpu mmap and the cost of the
+ * next GPU access (a blit from the just-touched bo, which eats any
+ * clflush or snoop penalty the level implies).  The driver-side
+ * choice between levels is usually folklore; this prints the actual
+ * crossover on the machine at hand. */
+#define BENCH_WIDTH 512
+#define BENCH_HEIGHT 512
+#define BENCH_SIZE (BENCH_WIDTH*BENCH_HEIGHT*4)
+#define BENCH_REPS 16
+/* coprime with the cacheline count, so the walk visits every line */
+#define BENCH_RAND_STRIDE 10007
+
+static double
+bench_cpu_pass(drm_intel_bo *bo, int do_write, int randomize)
+{
+	volatile uint32_t *ptr;
+	uint32_t accum = 0;
+	uint64_t ticks;
+	unsigned lines = BENCH_SIZE / 64;
+	unsigned bytes, i, r, idx;
+
+	do_or_die(drm_intel_bo_map(bo, do_write));
+	ptr = bo->virtual;
+
+	ticks = intel_clock_now();
+	if (randomize) {
+		/* one dword per cacheline in permuted order; the
+		 * bandwidth reported is cachelines touched */
+		idx = 0;
+		for (r = 0; r < BENCH_REPS; r++) {
+			for (i = 0; i < lines; i++) {
+				idx = (idx + BENCH_RAND_STRIDE) % lines;
+				if (do_write)
+					ptr[idx * 16] = idx;
+				else
+					accum += ptr[idx * 16];
+			}
+		}
+		bytes = lines * 64;
+	} else {
+		for (r = 0; r < BENCH_REPS; r++) {
+			if (do_write)
+				for (i = 0; i < BENCH_SIZE / 4; i++)
+					ptr[i] = i;
+			else
+				for (i = 0; i < BENCH_SIZE / 4; i++)
+					accum += ptr[i];
+		}
+		bytes = BENCH_SIZE;
+	}
+	ticks = intel_clock_now() - ticks;
+
+	drm_intel_bo_unmap(bo);
+	/* keep the reads from being optimized away */
+	assert(accum != 0xdeadbeef);
+
+	return (double)bytes * BENCH_REPS /
+		(intel_clock_to_us(ticks) / 1e6) / (1024*1024);
+}
+
+static double
+bench_gpu_copy_us(drm_intel_bo *src, drm_intel_bo *dst)
+{
+	uint64_t ticks;
+
+	ticks = intel_clock_now();
+	intel_copy_bo(batch, dst, src, BENCH_WIDTH, BENCH_HEIGHT);
+	drm_intel_bo_wait_rendering(dst);
+	return intel_clock_to_us(intel_clock_now() - ticks);
+}
+
+static void
+bench_cacheing(void)
+{
+	static const struct {
+		const char *name;
+		int write, rnd;
+	} patterns[] = {
+		{ "seq-read", 0, 0 },
+		{ "seq-write", 1, 0 },
+		{ "rand-read", 0, 1 },
+		{ "rand-write", 1, 1 },
+	};
+	static const char *levels[] = { "uncached", "snooped" };
+	unsigned lvl, p;
+
+	printf("%9s %10s %12s %14s\n",
+	       "cacheing", "pattern", "cpu MiB/s", "gpu-after us");
+
+	for (lvl = 0; lvl < ARRAY_SIZE(levels); lvl++) {
+		drm_intel_bo *bo, *aux;
+		double bw, us;
+
+		bo = drm_intel_bo_alloc(bufmgr, "bench src", BENCH_SIZE, 4096);
+		aux = drm_intel_bo_alloc(bufmgr, "bench dst", BENCH_SIZE, 4096);
+		gem_set_cacheing(fd, bo->handle, lvl);
+
+		/* bind both and warm the blitter so the first measured
+		 * copy isn't paying setup costs */
+		bench_gpu_copy_us(bo, aux);
+
+		for (p = 0; p < ARRAY_SIZE(patterns); p++) {
+			bw = bench_cpu_pass(bo, patterns[p].write,
+					    patterns[p].rnd);
+			us = bench_gpu_copy_us(bo, aux);
+			printf("%9s %10s %12.0f %14.1f\n",
+			       levels[lvl], patterns[p].name, bw, us);
+		}
+
+		drm_intel_bo_unreference(aux);
+		drm_intel_bo_unreference(bo);
+	}
+}
+
 #define MAX_BLT_SIZE 128
 #define ROUNDS 1000
 #define TEST_READ 0x1
@@ -293,6 +409,11 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (drmtest_run_subtest("bench")) {
+		skipped_all = false;
+		bench_cacheing();
+	}
+
 	drmtest_cleanup_aperture_trashers();
 	drm_intel_bufmgr_destroy(bufmgr);
 
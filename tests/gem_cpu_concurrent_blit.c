@@ -41,6 +41,9 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sched.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
@@ -87,14 +90,122 @@ create_bo(drm_intel_bufmgr *bufmgr, uint32_t val, int width, int height)
 	return bo;
 }
 
+/* Forked mode: the CPU side of the race runs in pre-forked worker
+ * processes with their own drm fds, reaching the shared storage by
+ * flink name.  The pool is created before any subtest runs and serves
+ * them all, so no task pays fork or drm-reopen and a large buffer set
+ * never gets duplicated copy-on-write mid-measurement.
+ *
+ * A task argument packs the flink name in the low word and either an
+ * opcode (fill with 0xdeadbeef) or the expected value in the high
+ * word. */
+#define POOL_WORKERS	8
+#define POOL_OP_SET	(1ULL << 63)
+
+static int pool_bo_size;
+
+static uint32_t
+bo_name(drm_intel_bo *bo)
+{
+	uint32_t name;
+
+	assert(drm_intel_bo_flink(bo, &name) == 0);
+	return name;
+}
+
+static int
+pool_task(int fd, int worker, uint64_t arg)
+{
+	struct drm_gem_open open_struct;
+	uint32_t val = (arg >> 32) & 0x7fffffff;
+	uint32_t *vaddr, *p;
+	int size = pool_bo_size / 4;
+	int ret = 0;
+
+	open_struct.name = arg & 0xffffffff;
+	do_ioctl(fd, DRM_IOCTL_GEM_OPEN, &open_struct);
+
+	vaddr = gem_mmap__cpu(fd, open_struct.handle, pool_bo_size,
+			      PROT_READ | PROT_WRITE);
+	assert(vaddr);
+	gem_set_domain(fd, open_struct.handle, I915_GEM_DOMAIN_CPU,
+		       (arg & POOL_OP_SET) ? I915_GEM_DOMAIN_CPU : 0);
+
+	p = vaddr;
+	if (arg & POOL_OP_SET) {
+		while (size--)
+			*p++ = 0xdeadbeef;
+	} else {
+		while (size--)
+			if (*p++ != val)
+				ret = 1;
+	}
+
+	munmap(vaddr, pool_bo_size);
+	gem_close(fd, open_struct.handle);
+
+	return ret;
+}
+
+/* Producer/consumer mode: a second thread keeps writing fresh values
+ * into the source buffers while this thread concurrently blits them and
+ * verifies the copies, handing buffers over through a lock-free
+ * single-producer/single-consumer ring of descriptors.  Unlike the
+ * serial subtests above, source writes and blits from other buffers are
+ * genuinely in flight at the same time, which is the contention pattern
+ * of a capture pipeline.
+ *
+ * A buffer index is only recycled num_buffers frames later and the
+ * producer can run at most PC_RING_SIZE frames ahead, so as long as
+ * num_buffers >= PC_RING_SIZE a source is never rewritten before its
+ * blit has been consumed. */
+#define PC_RING_SIZE	16	/* power of two */
+#define PC_FRAMES	512
+
+struct pc_slot {
+	int buf;
+	uint32_t val;
+};
+
+static struct pc_slot pc_slots[PC_RING_SIZE];
+static volatile uint32_t pc_head, pc_tail;
+static drm_intel_bo **pc_src;
+static int pc_num_buffers, pc_width, pc_height;
+
+static void *
+pc_producer(void *arg)
+{
+	uint32_t frame;
+
+	for (frame = 0; frame < PC_FRAMES; frame++) {
+		struct pc_slot *slot;
+
+		while (pc_head - pc_tail == PC_RING_SIZE)
+			sched_yield();
+
+		slot = &pc_slots[pc_head % PC_RING_SIZE];
+		slot->buf = frame % pc_num_buffers;
+		slot->val = 0x5a000000 | frame;
+		set_bo(pc_src[slot->buf], slot->val, pc_width, pc_height);
+
+		/* publish the slot before moving the head */
+		__sync_synchronize();
+		pc_head++;
+	}
+
+	return NULL;
+}
+
 int
 main(int argc, char **argv)
 {
 	drm_intel_bufmgr *bufmgr;
 	struct intel_batchbuffer *batch;
+	struct drmtest_pool pool;
 	int num_buffers = 128, max;
 	drm_intel_bo *src[128], *dst[128], *dummy = NULL;
 	int width = 512, height = 512;
+	int have_pool = 0;
 	int fd;
 	int i;
 
@@ -111,6 +222,14 @@ main(int argc, char **argv)
 	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
 
 	if (!drmtest_only_list_subtests()) {
+		/* fork the workers before the buffer set exists so their
+		 * address spaces stay small; they reach the buffers by
+		 * flink name later */
+		pool_bo_size = 4 * width * height;
+		have_pool = drmtest_pool_init(&pool, POOL_WORKERS,
+					      pool_task, true) == 0;
+		assert(have_pool);
+
 		for (i = 0; i < num_buffers; i++) {
 			src[i] = create_bo(bufmgr, i, width, height);
 			dst[i] = create_bo(bufmgr, ~i, width, height);
@@ -150,5 +269,80 @@ main(int argc, char **argv)
 			cmp_bo(dst[i], 0xabcdabcd, width, height);
 	}
 
+	/* concurrent writes and blits on the shared buffer set */
+	if (drmtest_run_subtest("producer-consumer")) {
+		struct timeval start, end;
+		pthread_t producer;
+		uint32_t frame;
+		double secs;
+
+		assert(num_buffers >= PC_RING_SIZE);
+		pc_src = src;
+		pc_num_buffers = num_buffers;
+		pc_width = width;
+		pc_height = height;
+		pc_head = pc_tail = 0;
+
+		gettimeofday(&start, NULL);
+		assert(pthread_create(&producer, NULL, pc_producer, NULL) == 0);
+
+		for (frame = 0; frame < PC_FRAMES; frame++) {
+			struct pc_slot *slot;
+
+			while (pc_tail == pc_head)
+				sched_yield();
+			__sync_synchronize();
+
+			slot = &pc_slots[pc_tail % PC_RING_SIZE];
+			intel_copy_bo(batch, dst[slot->buf], src[slot->buf],
+				      width, height);
+			cmp_bo(dst[slot->buf], slot->val, width, height);
+
+			pc_tail++;
+		}
+
+		pthread_join(producer, NULL);
+		gettimeofday(&end, NULL);
+
+		secs = end.tv_sec - start.tv_sec +
+			(end.tv_usec - start.tv_usec) / 1e6;
+		printf("producer-consumer: %d frames in %.3f secs "
+		       "(%.1f MB/s through the blitter)\n",
+		       PC_FRAMES, secs,
+		       PC_FRAMES * 4.0 * width * height / (1024*1024) / secs);
+	}
+
+	/* overwrite-source again, but the overwriting CPUs live in the
+	 * pooled worker processes */
+	if (drmtest_run_subtest("forked-overwrite-source")) {
+		for (i = num_buffers; i--; )
+			set_bo(src[i], 0x2f000000 | i, width, height);
+		for (i = 0; i < num_buffers; i++)
+			intel_copy_bo(batch, dst[i], src[i], width, height);
+		for (i = num_buffers; i--; )
+			assert(drmtest_pool_dispatch(&pool,
+					POOL_OP_SET | bo_name(src[i])) == 0);
+		assert(drmtest_pool_wait(&pool) == 0);
+		for (i = 0; i < num_buffers; i++)
+			cmp_bo(dst[i], 0x2f000000 | i, width, height);
+	}
+
+	/* the same pool again: reads racing the blits, this time from
+	 * foreign processes */
+	if (drmtest_run_subtest("forked-early-read")) {
+		for (i = num_buffers; i--; )
+			set_bo(src[i], 0x3f000000 | i, width, height);
+		for (i = 0; i < num_buffers; i++)
+			intel_copy_bo(batch, dst[i], src[i], width, height);
+		for (i = num_buffers; i--; )
+			assert(drmtest_pool_dispatch(&pool,
+					(uint64_t)(0x3f000000 | i) << 32 |
+					bo_name(dst[i])) == 0);
+		assert(drmtest_pool_wait(&pool) == 0);
+	}
+
+	if (have_pool)
+		assert(drmtest_pool_fini(&pool) == 0);
+
 	return 0;
 }
@@ -54,6 +54,88 @@
 static drm_intel_bufmgr *bufmgr;
 struct intel_batchbuffer *batch;
 
+/*
+ * Prefetch bugs are content-dependent, so feed the prefetcher a stream
+ * of unique pages instead of one repeated pattern.  A ring of template
+ * bos holds counter-seeded pages of identified no-ops (MI_NOOP with the
+ * NOPID write enabled, payload from an LCG), generated on the host only
+ * once; each batch is then blitted from its ring slot and tagged with a
+ * per-batch dword by a second blit, so every single page the CS fetches
+ * is distinct without any per-batch host generation.  Content delivery
+ * is spot-checked by hashing a readback against the generator's output.
+ */
+#define NUM_TEMPLATES 64
+#define PAGE_DWORDS (4096/4)
+#define TAG_DWORD 16
+#define VALIDATE_INTERVAL 256
+
+#define MI_NOOP_ID(v) ((1 << 22) | ((v) & 0x3fffff))
+
+static uint32_t template_pages[NUM_TEMPLATES][PAGE_DWORDS];
+static drm_intel_bo *template_bos[NUM_TEMPLATES];
+
+static uint32_t content_lcg(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state;
+}
+
+static uint32_t page_hash(const uint32_t *page)
+{
+	uint32_t h = 2166136261u;
+	int i;
+
+	for (i = 0; i < PAGE_DWORDS; i++) {
+		h ^= page[i];
+		h *= 16777619;
+	}
+
+	return h;
+}
+
+static void generate_templates(void)
+{
+	uint32_t state = 0x8086;
+	int s, i, ret;
+
+	for (s = 0; s < NUM_TEMPLATES; s++) {
+		/* executed prefix: every dword a distinct, harmless
+		 * command the decoder still has to look at */
+		for (i = 0; i < PAGE_DWORDS - 4; i++)
+			template_pages[s][i] =
+				MI_NOOP_ID(content_lcg(&state) >> 8);
+		template_pages[s][PAGE_DWORDS - 4] = MI_BATCH_BUFFER_END;
+		template_pages[s][PAGE_DWORDS - 3] = 0;
+		template_pages[s][PAGE_DWORDS - 2] = 0;
+		template_pages[s][PAGE_DWORDS - 1] = 0;
+
+		template_bos[s] = drm_intel_bo_alloc(bufmgr, "", 4096, 4096);
+		assert(template_bos[s]);
+		ret = drm_intel_bo_subdata(template_bos[s], 0, 4096,
+					   template_pages[s]);
+		assert(ret == 0);
+	}
+}
+
+static void validate_batch(int fd, drm_intel_bo *batch_bo, int i)
+{
+	static uint32_t page[PAGE_DWORDS], expected[PAGE_DWORDS];
+	uint32_t got, want;
+
+	memcpy(expected, template_pages[i % NUM_TEMPLATES], 4096);
+	expected[TAG_DWORD] = MI_NOOP_ID(i);
+	want = page_hash(expected);
+
+	gem_read(fd, batch_bo->handle, 0, page, 4096);
+	got = page_hash(page);
+
+	if (got != want) {
+		fprintf(stderr, "batch %d content mismatch: "
+			"hash 0x%08x, expected 0x%08x\n", i, got, want);
+		exit(1);
+	}
+}
+
 static void exec(int fd, uint32_t handle)
 {
 	struct drm_i915_gem_execbuffer2 execbuf;
@@ -90,11 +172,9 @@ static void exec(int fd, uint32_t handle)
 
 int main(int argc, char **argv)
 {
-	uint32_t batch_end[4] = {MI_BATCH_BUFFER_END, 0, 0, 0};
-	int fd, i, ret;
+	int fd, i;
 	uint64_t aper_size;
 	int count;
-	drm_intel_bo *sample_batch_bo;
 
 	fd = drm_open_any();
 
@@ -119,11 +199,7 @@ int main(int argc, char **argv)
 	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
 	assert(batch);
 
-	sample_batch_bo = drm_intel_bo_alloc(bufmgr, "", 4096, 4096);
-	assert(sample_batch_bo);
-	ret = drm_intel_bo_subdata(sample_batch_bo, 4096-sizeof(batch_end),
-				   sizeof(batch_end), batch_end);
-	assert(ret == 0);
+	generate_templates();
 
 	/* fill the entire gart with batches and run them */
 	for (i = 0; i < count; i++) {
@@ -132,8 +208,8 @@ int main(int argc, char **argv)
 		batch_bo = drm_intel_bo_alloc(bufmgr, "", 4096, 4096);
 		assert(batch_bo);
 
-		/* copy the sample batch with the gpu to the new one, so that we
-		 * also test the unmappable part of the gtt. */
+		/* copy this batch's template with the gpu to the new one,
+		 * so that we also test the unmappable part of the gtt. */
 		BEGIN_BATCH(8);
 		OUT_BATCH(XY_SRC_COPY_BLT_CMD |
 			  XY_SRC_COPY_BLT_WRITE_ALPHA |
@@ -146,7 +222,23 @@ int main(int argc, char **argv)
 		OUT_RELOC(batch_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
 		OUT_BATCH((0 << 16) | 0); /* src x1, y1 */
 		OUT_BATCH(4096);
-		OUT_RELOC(sample_batch_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
+		OUT_RELOC(template_bos[i % NUM_TEMPLATES],
+			  I915_GEM_DOMAIN_RENDER, 0, 0);
+		ADVANCE_BATCH();
+
+		/* stamp the per-batch tag so no two pages the prefetcher
+		 * sees are identical, even within one ring lap */
+		BEGIN_BATCH(6);
+		OUT_BATCH(XY_COLOR_BLT_CMD |
+			  XY_COLOR_BLT_WRITE_ALPHA |
+			  XY_COLOR_BLT_WRITE_RGB);
+		OUT_BATCH((3 << 24) | /* 32 bits */
+			  (0xf0 << 16) | /* pattern ROP */
+			  4096);
+		OUT_BATCH((0 << 16) | TAG_DWORD); /* dst x1,y1 */
+		OUT_BATCH((1 << 16) | (TAG_DWORD + 1));
+		OUT_RELOC(batch_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+		OUT_BATCH(MI_NOOP_ID(i)); /* color */
 		ADVANCE_BATCH();
 
 		intel_batchbuffer_flush(batch);
@@ -158,6 +250,9 @@ int main(int argc, char **argv)
 		/* launch the newly created batch */
 		exec(fd, batch_bo->handle);
 
+		if (i % VALIDATE_INTERVAL == 0)
+			validate_batch(fd, batch_bo, i);
+
 		// leak buffers
 		//drm_intel_bo_unreference(batch_bo);
 		drmtest_progress("gem_cs_prefetch: ", i, count);
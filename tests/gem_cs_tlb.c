@@ -98,6 +98,7 @@ static void run_on_ring(int fd, unsigned ring_id, const char *ring_name)
 	uint32_t handle, handle_new;
 	uint64_t gtt_offset, gtt_offset_new;
 	uint32_t *batch_ptr, *batch_ptr_old;
+	struct drmtest_budget budget;
 	unsigned split;
 	char buf[100];
 	int i;
@@ -105,6 +106,11 @@ static void run_on_ring(int fd, unsigned ring_id, const char *ring_name)
 	sprintf(buf, "testing %s cs tlb coherency: ", ring_name);
 	skipped_all = false;
 
+	/* each split position is an independent probe, so on slow
+	 * hardware trying fewer of them trades coverage for bounded
+	 * runtime */
+	drmtest_budget_start(&budget, buf, 20);
+
 	/* Shut up gcc, too stupid. */
 	batch_ptr_old = NULL;
 	handle = 0;
@@ -141,21 +147,24 @@ static void run_on_ring(int fd, unsigned ring_id, const char *ring_name)
 		handle = handle_new;
 		gtt_offset = gtt_offset_new;
 		batch_ptr_old = batch_ptr;
-	}
 
+		if (!drmtest_budget_more(&budget))
+			break;
+	}
+	drmtest_budget_report(&budget);
 }
 
 int main(int argc, char **argv)
 {
-	int fd;
-	uint32_t devid;
+	int fd = -1;
+	uint32_t devid = 0;
 
 	drmtest_subtest_init(argc, argv);
 
-	fd = drm_open_any();
-	devid = intel_get_drm_devid(fd);
-
 	if (!drmtest_only_list_subtests()) {
+		fd = drmtest_fixture_fd();
+		devid = drmtest_fixture_devid();
+
 		/* This test is very sensitive to residual gtt_mm noise from previous
 		 * tests. Try to quiet thing down first. */
 		gem_quiescent_gpu(fd);
@@ -173,7 +182,7 @@ int main(int argc, char **argv)
 		if (HAS_BLT_RING(devid))
 			run_on_ring(fd, I915_EXEC_BLT, "blt");
 
-	close(fd);
+	drmtest_fixture_fini();
 
 	return skipped_all ? 77 : 0;
 }
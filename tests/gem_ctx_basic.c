@@ -53,6 +53,7 @@ static void init_buffer(drm_intel_bufmgr *bufmgr,
 	assert(buf->bo);
 	buf->tiling = I915_TILING_NONE;
 	buf->stride = 4096;
+	buf->offset = 0;
 }
 
 static void *work(void *arg)
@@ -93,13 +93,130 @@ dummy_reloc_loop(void)
 	}
 }
 
+/*
+ * IRQ latency probe (-i): instead of hammering the ring, submit one tiny
+ * batch at a time, block for the user interrupt and histogram the time
+ * from submit to wakeup.  The mean is uninteresting - the point is the
+ * tail, so samples land in log2-bucketed groups with linear sub-buckets
+ * for percentile extraction, and anything past 10ms is reported the
+ * moment it happens.  Made to run for hours.
+ */
+
+#define IRQ_OUTLIER_US 10000
+
+static struct {
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+	uint64_t outliers;
+	/* [log2 group][16 linear sub-buckets], microseconds */
+	uint64_t buckets[44][16];
+} irq_hist;
+
+static uint64_t probe_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static void irq_record(uint64_t us)
+{
+	int msb, group, sub;
+
+	irq_hist.count++;
+	irq_hist.total_us += us;
+	if (us > irq_hist.max_us)
+		irq_hist.max_us = us;
+
+	if (us < 16) {
+		group = 0;
+		sub = us;
+	} else {
+		msb = 63 - __builtin_clzll(us);
+		group = msb - 3;
+		sub = (us >> (msb - 4)) & 15;
+	}
+	irq_hist.buckets[group][sub]++;
+}
+
+/* upper bound of the first bucket covering the requested quantile */
+static uint64_t irq_percentile(double pct)
+{
+	uint64_t target = irq_hist.count * pct / 100.0 + 0.5;
+	uint64_t seen = 0;
+	int group, sub;
+
+	for (group = 0; group < 44; group++) {
+		for (sub = 0; sub < 16; sub++) {
+			seen += irq_hist.buckets[group][sub];
+			if (seen >= target) {
+				if (group == 0)
+					return sub + 1;
+				return (uint64_t)(16 + sub + 1) << (group - 1);
+			}
+		}
+	}
+
+	return irq_hist.max_us;
+}
+
+static void
+irq_latency_probe(int duration_sec)
+{
+	uint64_t deadline = probe_time_us() + duration_sec * 1000000ull;
+	uint64_t t0, t1;
+
+	printf("probing irq latency for %d seconds...\n", duration_sec);
+
+	do {
+		t0 = probe_time_us();
+
+		BEGIN_BATCH(4);
+		OUT_BATCH(MI_FLUSH_DW | 1);
+		OUT_BATCH(0); /* reserved */
+		OUT_RELOC(target_buffer, I915_GEM_DOMAIN_RENDER,
+				I915_GEM_DOMAIN_RENDER, 0);
+		OUT_BATCH(MI_NOOP | (1<<22) | (0xf));
+		ADVANCE_BATCH();
+		intel_batchbuffer_flush(batch);
+
+		drm_intel_bo_wait_rendering(target_buffer);
+		t1 = probe_time_us();
+
+		irq_record(t1 - t0);
+		if (t1 - t0 >= IRQ_OUTLIER_US) {
+			irq_hist.outliers++;
+			fprintf(stderr,
+				"outlier: %"PRIu64"us wait after %"PRIu64" samples\n",
+				t1 - t0, irq_hist.count);
+		}
+	} while (t1 < deadline);
+
+	printf("irq latency: %"PRIu64" waits, mean %.1fus, p50 %"PRIu64"us, "
+	       "p90 %"PRIu64"us, p99 %"PRIu64"us, p99.9 %"PRIu64"us, "
+	       "max %"PRIu64"us, %"PRIu64" outliers over %dms\n",
+	       irq_hist.count, (double)irq_hist.total_us / irq_hist.count,
+	       irq_percentile(50), irq_percentile(90), irq_percentile(99),
+	       irq_percentile(99.9), irq_hist.max_us, irq_hist.outliers,
+	       IRQ_OUTLIER_US / 1000);
+}
+
 int main(int argc, char **argv)
 {
 	int fd;
 	int devid;
+	int probe_duration = 0;
 
-	if (argc != 1) {
-		fprintf(stderr, "usage: %s\n", argv[0]);
+	if (argc == 3 && strcmp(argv[1], "-i") == 0) {
+		probe_duration = atoi(argv[2]);
+		if (probe_duration <= 0) {
+			fprintf(stderr, "invalid probe duration\n");
+			exit(-1);
+		}
+	} else if (argc != 1) {
+		fprintf(stderr, "usage: %s [-i probe_seconds]\n", argv[0]);
 		exit(-1);
 	}
 
@@ -135,7 +252,10 @@ int main(int argc, char **argv)
 		exit(-1);
 	}
 
-	dummy_reloc_loop();
+	if (probe_duration)
+		irq_latency_probe(probe_duration);
+	else
+		dummy_reloc_loop();
 
 	drm_intel_bo_unreference(target_buffer);
 	intel_batchbuffer_free(batch);
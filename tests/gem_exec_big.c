@@ -48,6 +48,7 @@
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
+#include "intel_clock.h"
 
 #define MI_BATCH_BUFFER_END	(0xA<<23)
 #define BATCH_SIZE		(1024*1024)
@@ -100,6 +101,108 @@ static int exec(int fd, uint32_t handle, uint32_t reloc_ofs)
 	return ret;
 }
 
+/*
+ * Scaling study: time the execbuf ioctl itself while sweeping the
+ * object list log-scale, first in count (many small bos, the scene
+ * export case) and then in size (one big bo, up to a chunk of the
+ * aperture).  The per-object column is the tell: flat means linear
+ * kernel bookkeeping, rising means validation has gone superlinear.
+ */
+
+#define SCALING_REPS	8
+#define MAX_OBJECTS	65536
+
+static void init_object(struct drm_i915_gem_exec_object2 *obj,
+			uint32_t handle)
+{
+	memset(obj, 0, sizeof(*obj));
+	obj->handle = handle;
+}
+
+static double time_exec(int fd, struct drm_i915_gem_exec_object2 *exec,
+			int count, int reps)
+{
+	struct drm_i915_gem_execbuffer2 execbuf;
+	uint64_t start;
+	int n;
+
+	memset(&execbuf, 0, sizeof(execbuf));
+	execbuf.buffers_ptr = (uintptr_t)exec;
+	execbuf.buffer_count = count;
+	execbuf.batch_len = 8;
+	i915_execbuffer2_set_context_id(execbuf, 0);
+
+	/* first pass binds everything; only time the steady state */
+	do_or_die(drmIoctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &execbuf));
+	gem_sync(fd, exec[count - 1].handle);
+
+	start = intel_clock_now();
+	for (n = 0; n < reps; n++)
+		do_or_die(drmIoctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2,
+				   &execbuf));
+	gem_sync(fd, exec[count - 1].handle);
+
+	return intel_clock_to_us(intel_clock_now() - start) / reps;
+}
+
+static void scaling_study(int fd)
+{
+	static struct drm_i915_gem_exec_object2 exec[MAX_OBJECTS + 1];
+	uint32_t batch[2] = {MI_BATCH_BUFFER_END};
+	uint64_t aperture = gem_aperture_size(fd);
+	uint32_t batch_handle;
+	uint64_t size;
+	int count, i;
+
+	batch_handle = gem_create(fd, 4096);
+	gem_write(fd, batch_handle, 0, batch, sizeof(batch));
+
+	printf("object count sweep (4KiB objects):\n");
+	for (count = 1; count <= MAX_OBJECTS; count <<= 1) {
+		double us;
+
+		/* previously created objects are reused; the batch is
+		 * always the last entry as execbuf requires */
+		for (i = count >> 1; i < count; i++)
+			init_object(&exec[i], gem_create(fd, 4096));
+		if (count == 1)
+			init_object(&exec[0], gem_create(fd, 4096));
+		init_object(&exec[count], batch_handle);
+
+		if ((uint64_t)count * 4096 > aperture * 3 / 4) {
+			printf("%6d objects: skipped (over aperture)\n",
+			       count);
+			break;
+		}
+
+		us = time_exec(fd, exec, count + 1, SCALING_REPS);
+		printf("%6d objects:	%10.1fµs,	%7.3fµs/object\n",
+		       count, us, us / count);
+		fflush(stdout);
+	}
+	if (count > MAX_OBJECTS)
+		count = MAX_OBJECTS;
+	for (i = 0; i < count; i++)
+		gem_close(fd, exec[i].handle);
+
+	printf("object size sweep (single object):\n");
+	for (size = 4096; size <= aperture / 4; size <<= 1) {
+		double us;
+
+		init_object(&exec[0], gem_create(fd, size));
+		init_object(&exec[1], batch_handle);
+
+		us = time_exec(fd, exec, 2, SCALING_REPS);
+		printf("%6lluKiB object:	%10.1fµs\n",
+		       (unsigned long long)size / 1024, us);
+		fflush(stdout);
+
+		gem_close(fd, exec[0].handle);
+	}
+
+	gem_close(fd, batch_handle);
+}
+
 int main(int argc, char **argv)
 {
 	uint32_t batch[2] = {MI_BATCH_BUFFER_END};
@@ -110,6 +213,12 @@ int main(int argc, char **argv)
 
 	fd = drm_open_any();
 
+	if (argc > 1 && strcmp(argv[1], "-S") == 0) {
+		scaling_study(fd);
+		close(fd);
+		return 0;
+	}
+
 	for (batch_size = BATCH_SIZE/4; batch_size <= BATCH_SIZE; batch_size += 4096) {
 		handle = gem_create(fd, batch_size);
 		gem_write(fd, handle, 0, batch, sizeof(batch));
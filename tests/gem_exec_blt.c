@@ -40,9 +40,10 @@
 #include <sys/time.h>
 #include "drm.h"
 #include "i915_drm.h"
-#include "drmtest.h"
 #include "intel_chipset.h"
-#include "intel_gpu_tools.h"
+#include "intel_measure.h"
+#include "intel_results.h"
+#include "rendercopy.h"
 
 #define OBJECT_SIZE 16384
 
@@ -166,11 +167,34 @@ static const char *bytes_per_sec(char *buf, double v)
 	return buf;
 }
 
+struct blt_measure_ctx {
+	int fd;
+	struct drm_i915_gem_execbuffer2 *execbuf;
+	uint32_t handle;
+	int loops;
+};
+
+/* one sample: a burst of loops execs and a sync, in µs per exec */
+static double blt_sample(void *data)
+{
+	struct blt_measure_ctx *ctx = data;
+	struct timeval start, end;
+
+	gettimeofday(&start, NULL);
+	if (gem_exec(ctx->fd, ctx->execbuf, ctx->loops))
+		exit(1);
+	gem_sync(ctx->fd, ctx->handle);
+	gettimeofday(&end, NULL);
+
+	return elapsed(&start, &end, ctx->loops);
+}
+
 static void run(int object_size)
 {
 	struct drm_i915_gem_execbuffer2 execbuf;
 	struct drm_i915_gem_exec_object2 exec[3];
 	struct drm_i915_gem_relocation_entry reloc[4];
+	struct blt_measure_ctx ctx;
 	uint32_t buf[20];
 	uint32_t handle, src, dst;
 	int fd, len, count;
@@ -227,30 +251,159 @@ static void run(int object_size)
 	i915_execbuffer2_set_context_id(execbuf, 0);
 	execbuf.rsvd2 = 0;
 
-	for (count = 1; count <= 1<<17; count <<= 1) {
-		struct timeval start, end;
-
-		gettimeofday(&start, NULL);
-		if (gem_exec(fd, &execbuf, count))
-			exit(1);
-		gem_sync(fd, handle);
-		gettimeofday(&end, NULL);
-		printf("Time to blt %d bytes x %6d:	%7.3fµs, %s\n",
-		       object_size, count,
-		       elapsed(&start, &end, count),
-		       bytes_per_sec((char *)buf, object_size/elapsed(&start, &end, count)*1e6));
+	ctx.fd = fd;
+	ctx.execbuf = &execbuf;
+	ctx.handle = handle;
+
+	/* one point per batching regime: single submissions are
+	 * dominated by the sync round trip, big bursts by the ring */
+	for (count = 1; count <= 4096; count <<= 4) {
+		struct intel_measure_result res;
+		char rate[32], metric[32];
+
+		ctx.loops = count;
+		intel_measure_run(blt_sample, &ctx, 0.5, 64, &res);
+		printf("Time to blt %d bytes x %6d:	%7.3f ±%.3fµs, %s "
+		       "(%d samples: %d warm-up, %d outliers)\n",
+		       object_size, count, res.mean, res.ci95,
+		       bytes_per_sec(rate, object_size/res.mean*1e6),
+		       res.total, res.warmup, res.rejected);
 		fflush(stdout);
+
+		/* one series per batching regime for the results log */
+		snprintf(metric, sizeof(metric), "%db/x%d",
+			 object_size, count);
+		intel_results_report(intel_get_drm_devid(fd), "gem_exec_blt",
+				     metric,
+				     object_size / res.mean * 1e6 /
+				     (1024 * 1024), "MiB/s");
 	}
 	gem_close(fd, handle);
 
 	close(fd);
 }
 
+/* Balanced mode: measure copy throughput with all work pinned to the
+ * blt ring, all on render (via rendercopy, since gen6 moved the
+ * blitter off the render ring), and with the library balancing between
+ * them - the last number is what a copy-heavy client can really get
+ * out of the machine when it stops treating the blt ring as the only
+ * copy engine. */
+
+#define BALANCE_SIZE	(1024*1024)
+#define BALANCE_WIDTH	512
+#define BALANCE_COPIES	512
+
+static void balanced_buf_init(struct scratch_buf *buf, drm_intel_bufmgr *bufmgr)
+{
+	buf->bo = drm_intel_bo_alloc(bufmgr, "balance", BALANCE_SIZE, 4096);
+	buf->stride = BALANCE_WIDTH * 4;
+	buf->tiling = I915_TILING_NONE;
+	buf->size = BALANCE_SIZE;
+	buf->data = buf->cpu_mapping = NULL;
+	buf->offset = 0;
+	buf->num_tiles = 0;
+}
+
+static double run_mode(struct intel_batchbuffer *batch,
+		       render_copyfunc_t render_copy,
+		       struct scratch_buf *src, struct scratch_buf *dst,
+		       int affinity)
+{
+	struct timeval start, end;
+	int i, ring;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BALANCE_COPIES; i++) {
+		ring = intel_ring_select(batch, affinity);
+		if (ring == INTEL_RING_BLT) {
+			intel_copy_bo(batch, dst->bo, src->bo,
+				      BALANCE_WIDTH,
+				      BALANCE_SIZE / (BALANCE_WIDTH * 4));
+		} else {
+			render_copy(batch, src, 0, 0,
+				    BALANCE_WIDTH,
+				    BALANCE_SIZE / (BALANCE_WIDTH * 4),
+				    dst, 0, 0);
+		}
+		/* both paths submit themselves, so only account here */
+		drm_intel_bo_reference(dst->bo);
+		intel_ring_account(ring, dst->bo, BALANCE_SIZE);
+	}
+	drm_intel_bo_wait_rendering(dst->bo);
+	gettimeofday(&end, NULL);
+
+	return (double)BALANCE_SIZE * BALANCE_COPIES /
+		elapsed(&start, &end, 1) * 1e6;
+}
+
+static void run_balanced(void)
+{
+	struct intel_batchbuffer *batch;
+	drm_intel_bufmgr *bufmgr;
+	render_copyfunc_t render_copy;
+	struct scratch_buf src, dst;
+	const struct intel_ring_stats *stats;
+	char buf[64];
+	double rate;
+	int fd, i;
+
+	static const struct {
+		const char *name;
+		int affinity;
+	} modes[] = {
+		{ "blt only", INTEL_RING_BLT },
+		{ "render only", INTEL_RING_RENDER },
+		{ "balanced", INTEL_RING_ANY },
+	};
+
+	fd = drm_open_any();
+	if (!HAS_BLT_RING(intel_get_drm_devid(fd))) {
+		printf("no blt ring, nothing to balance\n");
+		return;
+	}
+	render_copy = get_render_copyfunc(intel_get_drm_devid(fd));
+	if (render_copy == NULL) {
+		printf("no rendercopy for this generation, "
+		       "nothing to balance\n");
+		return;
+	}
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+
+	balanced_buf_init(&src, bufmgr);
+	balanced_buf_init(&dst, bufmgr);
+
+	for (i = 0; i < sizeof(modes)/sizeof(modes[0]); i++) {
+		rate = run_mode(batch, render_copy, &src, &dst,
+				modes[i].affinity);
+		printf("%-12s %s\n", modes[i].name, bytes_per_sec(buf, rate));
+	}
+
+	for (i = 0; i < INTEL_RING_COUNT; i++) {
+		stats = intel_ring_get_stats(i);
+		printf("%s: %llu copies, %llu MiB submitted\n",
+		       i == INTEL_RING_BLT ? "blt" : "render",
+		       (long long unsigned)stats->batches,
+		       (long long unsigned)stats->bytes >> 20);
+	}
+
+	drm_intel_bo_unreference(src.bo);
+	drm_intel_bo_unreference(dst.bo);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+	close(fd);
+}
+
 int main(int argc, char **argv)
 {
 	int i;
 
-	if (argc > 1) {
+	if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+		run_balanced();
+	} else if (argc > 1) {
 		for (i = 1; i < argc; i++) {
 			int object_size = atoi(argv[i]);
 			if (object_size)
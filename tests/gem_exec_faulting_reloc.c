@@ -42,6 +42,7 @@
 #include "i915_drm.h"
 #include "drmtest.h"
 #include "intel_chipset.h"
+#include "intel_clock.h"
 #include "intel_gpu_tools.h"
 
 /* Testcase: Submit patches with relocations in memory that will fault
@@ -218,8 +219,142 @@ static void run(int object_size)
 	close(fd);
 }
 
+/*
+ * Throughput study (-T): how much does the kernel's relocation copy
+ * path pay per page fault?  The same no-op batch is submitted with its
+ * reloc array in three states - resident malloc'd memory, a freshly
+ * GTT-mmapped bo that faults under copy_from_user, and the same fresh
+ * mapping prefaulted from userspace first - across a range of reloc
+ * counts.  The delta between the columns is the fault tax, per exec.
+ */
+#define TP_REPS 256
+
+static const int tp_counts[] = { 2, 8, 32, 128, 512 };
+
+static void tp_init_exec(struct drm_i915_gem_exec_object2 *exec,
+			 uint32_t handle, int num_relocs, uint64_t relocs_ptr)
+{
+	memset(exec, 0, sizeof(*exec));
+	exec->handle = handle;
+	exec->relocation_count = num_relocs;
+	exec->relocs_ptr = relocs_ptr;
+}
+
+static uint64_t tp_run(int fd, struct drm_i915_gem_execbuffer2 *execbuf,
+		       struct drm_i915_gem_exec_object2 *exec,
+		       uint32_t handle_relocs, int reloc_bytes, int mode)
+{
+	uint64_t start, total = 0;
+	void *map;
+	int i;
+
+	for (i = 0; i < TP_REPS; i++) {
+		if (mode) {
+			/* a fresh vma per submission, so every rep
+			 * faults (or prefaults) the same pages again */
+			map = gem_mmap(fd, handle_relocs, reloc_bytes,
+				       PROT_READ | PROT_WRITE);
+			assert(map);
+			if (mode == 2)
+				gem_mmap_prefault(map, reloc_bytes);
+			exec[1].relocs_ptr = (uintptr_t)map;
+		}
+
+		start = intel_clock_now();
+		gem_exec(fd, execbuf);
+		total += intel_clock_now() - start;
+
+		if (mode)
+			munmap(map, reloc_bytes);
+	}
+
+	return total;
+}
+
+static void throughput_study(int fd)
+{
+	struct drm_i915_gem_execbuffer2 execbuf;
+	struct drm_i915_gem_exec_object2 exec[2];
+	struct drm_i915_gem_relocation_entry *reloc;
+	uint32_t bbe[2] = { MI_BATCH_BUFFER_END, 0 };
+	uint32_t handle, dummy;
+	unsigned c;
+	int i;
+
+	printf("%7s %12s %12s %12s %10s\n", "relocs", "resident_us",
+	       "faulting_us", "prefault_us", "faults");
+
+	for (c = 0; c < sizeof(tp_counts)/sizeof(tp_counts[0]); c++) {
+		int num_relocs = tp_counts[c];
+		int reloc_bytes = (num_relocs * sizeof(*reloc) + 4095) & ~4095;
+		uint64_t resident, faulting, prefault, faults;
+		uint32_t handle_relocs;
+
+		handle = gem_create(fd, 4096);
+		dummy = gem_create(fd, 4096);
+		gem_write(fd, handle, 0, bbe, sizeof(bbe));
+
+		/* all relocs patch dwords past the BATCH_BUFFER_END, so
+		 * the written offsets are never executed */
+		reloc = calloc(num_relocs, sizeof(*reloc));
+		assert(reloc);
+		for (i = 0; i < num_relocs; i++) {
+			reloc[i].offset = 8 + 4 * i;
+			reloc[i].target_handle = dummy;
+			reloc[i].read_domains = I915_GEM_DOMAIN_RENDER;
+		}
+
+		handle_relocs = gem_create(fd, reloc_bytes);
+		gem_write(fd, handle_relocs, 0, reloc,
+			  num_relocs * sizeof(*reloc));
+
+		tp_init_exec(&exec[0], dummy, 0, 0);
+		tp_init_exec(&exec[1], handle, num_relocs,
+			     (uintptr_t)reloc);
+
+		memset(&execbuf, 0, sizeof(execbuf));
+		execbuf.buffers_ptr = (uintptr_t)exec;
+		execbuf.buffer_count = 2;
+		execbuf.batch_len = 8;
+		i915_execbuffer2_set_context_id(execbuf, 0);
+
+		/* bind everything once before timing */
+		gem_exec(fd, &execbuf);
+		gem_sync(fd, handle);
+
+		resident = tp_run(fd, &execbuf, exec, handle_relocs,
+				  reloc_bytes, 0);
+		faults = gem_fault_count();
+		faulting = tp_run(fd, &execbuf, exec, handle_relocs,
+				  reloc_bytes, 1);
+		faults = gem_fault_count() - faults;
+		prefault = tp_run(fd, &execbuf, exec, handle_relocs,
+				  reloc_bytes, 2);
+		gem_sync(fd, handle);
+
+		printf("%7d %12.2f %12.2f %12.2f %10.1f\n", num_relocs,
+		       intel_clock_to_us(resident) / (double)TP_REPS,
+		       intel_clock_to_us(faulting) / (double)TP_REPS,
+		       intel_clock_to_us(prefault) / (double)TP_REPS,
+		       faults / (double)TP_REPS);
+
+		free(reloc);
+		gem_close(fd, handle_relocs);
+		gem_close(fd, dummy);
+		gem_close(fd, handle);
+	}
+}
+
 int main(int argc, char **argv)
 {
+	if (argc > 1 && strcmp(argv[1], "-T") == 0) {
+		int fd = drm_open_any();
+
+		throughput_study(fd);
+		close(fd);
+		return 0;
+	}
+
 	run(OBJECT_SIZE);
 
 	return 0;
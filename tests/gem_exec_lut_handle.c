@@ -46,7 +46,7 @@
 #define LOCAL_I915_EXEC_NO_RELOC (1<<11)
 #define LOCAL_I915_EXEC_HANDLE_LUT (1<<12)
 
-#define MAX_NUM_EXEC 2048
+#define MAX_NUM_EXEC 32768
 #define MAX_NUM_RELOC 4096
 
 #define USE_LUT 0x1
@@ -55,6 +55,9 @@
 
 struct drm_i915_gem_exec_object2 gem_exec[MAX_NUM_EXEC+1];
 struct drm_i915_gem_relocation_entry gem_reloc[MAX_NUM_RELOC];
+/* reloc target indices, so presumed offsets can be repatched without
+ * rebuilding the relocation list */
+static uint16_t reloc_target[MAX_NUM_RELOC];
 
 static uint32_t state = 0x12345678;
 
@@ -67,9 +70,13 @@ hars_petruska_f54_1_random (void)
 }
 
 
-static int exec(int fd, int num_exec, int num_relocs, unsigned flags)
+static struct drm_i915_gem_execbuffer2 execbuf;
+
+/* Build the exec list and relocation table once per configuration; the
+ * timed loop then submits the prebuilt tables untouched, so the numbers
+ * isolate the kernel's handle lookup cost from our rebuild cost. */
+static void prepare(int num_exec, int num_relocs, unsigned flags)
 {
-	struct drm_i915_gem_execbuffer2 execbuf;
 	struct drm_i915_gem_exec_object2 *objects;
 	int i;
 
@@ -80,6 +87,7 @@ static int exec(int fd, int num_exec, int num_relocs, unsigned flags)
 
 	for (i = 0; i < num_relocs; i++) {
 		int target = hars_petruska_f54_1_random() % num_exec;
+		reloc_target[i] = target;
 		gem_reloc[i].offset = 1024;
 		gem_reloc[i].delta = 0;
 		gem_reloc[i].target_handle =
@@ -87,8 +95,6 @@ static int exec(int fd, int num_exec, int num_relocs, unsigned flags)
 		gem_reloc[i].read_domains = I915_GEM_DOMAIN_RENDER;
 		gem_reloc[i].write_domain = 0;
 		gem_reloc[i].presumed_offset = 0;
-		if (flags & SKIP_RELOC)
-			gem_reloc[i].presumed_offset = objects[target].offset;
 	}
 
 	execbuf.buffers_ptr = (uintptr_t)objects;
@@ -106,12 +112,35 @@ static int exec(int fd, int num_exec, int num_relocs, unsigned flags)
 		execbuf.flags |= LOCAL_I915_EXEC_NO_RELOC;
 	i915_execbuffer2_set_context_id(execbuf, 0);
 	execbuf.rsvd2 = 0;
+}
+
+/* refresh the presumed offsets from the objects' current placement so
+ * the skip-relocs and no-relocs fast paths actually engage; a patch of
+ * the prebuilt table, not a rebuild */
+static void patch_presumed_offsets(int num_exec, int num_relocs)
+{
+	struct drm_i915_gem_exec_object2 *objects;
+	int i;
+
+	objects = gem_exec + MAX_NUM_EXEC - num_exec;
+	for (i = 0; i < num_relocs; i++)
+		gem_reloc[i].presumed_offset =
+			objects[reloc_target[i]].offset;
+}
 
+static int exec_prepared(int fd)
+{
 	return drmIoctl(fd,
 			DRM_IOCTL_I915_GEM_EXECBUFFER2,
 			&execbuf);
 }
 
+static int exec(int fd, int num_exec, int num_relocs, unsigned flags)
+{
+	prepare(num_exec, num_relocs, flags);
+	return exec_prepared(fd);
+}
+
 #define ELAPSED(a,b) (1e6*((b)->tv_sec - (a)->tv_sec) + ((b)->tv_usec - (a)->tv_usec))
 int main(int argc, char **argv)
 {
@@ -151,23 +180,47 @@ int main(int argc, char **argv)
 			for (m = 1; m <= MAX_NUM_RELOC; m *= 2) {
 				struct timeval start, end;
 				double elapsed[2];
-
-				gettimeofday(&start, NULL);
-				for (count = 0; count < 1000; count++)
-					do_or_die(exec(fd, n, m, 0 | p->flags));
-				gettimeofday(&end, NULL);
-				gem_sync(fd, gem_exec[MAX_NUM_EXEC].handle);
-				elapsed[0] = ELAPSED(&start, &end) / 1000.;
-
-				gettimeofday(&start, NULL);
-				for (count = 0; count < 1000; count++)
-					do_or_die(exec(fd, n, m, USE_LUT | p->flags));
-				gettimeofday(&end, NULL);
-				gem_sync(fd, gem_exec[MAX_NUM_EXEC].handle);
-				elapsed[1] = ELAPSED(&start, &end) / 1000.;
-
-				printf("%s: buffer_count=%d, reloc_count=%d: old=%f us, lut=%f us\n",
-				       p->name, n, m, elapsed[0], elapsed[1]);
+				int reps, mode;
+
+				/* scale the repeat count so the big
+				 * configurations don't take minutes */
+				reps = 1000;
+				if (n + m > 4096)
+					reps = 1000 * 4096 / (n + m);
+
+				for (mode = 0; mode < 2; mode++) {
+					unsigned flags = p->flags;
+
+					if (mode)
+						flags |= USE_LUT;
+
+					prepare(n, m, flags);
+					/* settle placement outside the
+					 * timed loop */
+					do_or_die(exec_prepared(fd));
+					if (flags & (SKIP_RELOC | NO_RELOC))
+						patch_presumed_offsets(n, m);
+
+					gettimeofday(&start, NULL);
+					for (count = 0; count < reps; count++)
+						do_or_die(exec_prepared(fd));
+					gettimeofday(&end, NULL);
+					gem_sync(fd, gem_exec[MAX_NUM_EXEC].handle);
+					elapsed[mode] =
+						ELAPSED(&start, &end) / reps;
+				}
+
+				/* the old path looks up every exec object
+				 * and every reloc target by handle; with
+				 * the LUT the targets are array indices */
+				printf("%s: buffer_count=%d, reloc_count=%d: "
+				       "old=%f us (%.2fM lookups/s), "
+				       "lut=%f us (%.2fM lookups/s)\n",
+				       p->name, n, m,
+				       elapsed[0],
+				       (n + 1 + m) / elapsed[0],
+				       elapsed[1],
+				       (n + 1) / elapsed[1]);
 			}
 		}
 	}
@@ -26,6 +26,7 @@
  */
 
 #include <unistd.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -108,6 +109,231 @@ static void loop(int fd, uint32_t handle, unsigned ring_id, const char *ring_nam
 	}
 
 }
+/* Throughput harness: fixed-duration timed phases rather than fixed
+ * iteration counts, so a slow kernel takes the same wall time as a
+ * fast one and the numbers are comparable across machines.  Output is
+ * one key=value line per configuration for regression gating. */
+#define BENCH_WARMUP_US 200000
+#define BENCH_PHASE_US 1000000
+#define BENCH_BATCH 128
+
+static double timed_exec_phase(int fd, struct drm_i915_gem_execbuffer2 *execbuf,
+			       uint32_t handle, unsigned duration_us)
+{
+	struct timeval start, now;
+	unsigned long count = 0;
+
+	gettimeofday(&start, NULL);
+	do {
+		int i;
+
+		/* check the clock once per burst, not per exec; a noop
+		 * submission is itself only microseconds */
+		for (i = 0; i < BENCH_BATCH; i++)
+			if (drmIoctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2,
+				     execbuf))
+				exit(1);
+		count += BENCH_BATCH;
+		gettimeofday(&now, NULL);
+	} while (elapsed(&start, &now, 1) < duration_us);
+
+	/* the retirement cost belongs to the rate, so sync inside the
+	 * timed region */
+	gem_sync(fd, handle);
+	gettimeofday(&now, NULL);
+
+	return count / (elapsed(&start, &now, 1) / 1e6);
+}
+
+static uint32_t nop_batch_create(int fd, int batch_size)
+{
+	uint32_t bbe[2] = {MI_BATCH_BUFFER_END};
+	uint32_t handle;
+
+	/* gem_create gives zeroed pages and 0 is MI_NOOP, so only the
+	 * terminator needs writing */
+	handle = gem_create(fd, batch_size);
+	gem_write(fd, handle, batch_size - sizeof(bbe), bbe, sizeof(bbe));
+
+	return handle;
+}
+
+static double exec_rate(int fd, uint32_t handle, unsigned ring_id,
+			int batch_len, uint32_t target, int nreloc)
+{
+	struct drm_i915_gem_relocation_entry reloc[64];
+	struct drm_i915_gem_execbuffer2 execbuf;
+	struct drm_i915_gem_exec_object2 gem_exec[2];
+	int i, count = 0;
+
+	assert(nreloc <= 64);
+
+	memset(gem_exec, 0, sizeof(gem_exec));
+	if (nreloc) {
+		gem_exec[count].handle = target;
+		count++;
+	}
+	gem_exec[count].handle = handle;
+	gem_exec[count].relocation_count = nreloc;
+	gem_exec[count].relocs_ptr = (uintptr_t)reloc;
+	count++;
+
+	/* relocations land after the terminator, so the CS never
+	 * executes the patched addresses but the kernel still walks and
+	 * applies every entry */
+	memset(reloc, 0, sizeof(reloc));
+	for (i = 0; i < nreloc; i++) {
+		reloc[i].offset = sizeof(uint32_t) * (2 + i);
+		reloc[i].target_handle = target;
+		reloc[i].read_domains = I915_GEM_DOMAIN_RENDER;
+	}
+
+	memset(&execbuf, 0, sizeof(execbuf));
+	execbuf.buffers_ptr = (uintptr_t)gem_exec;
+	execbuf.buffer_count = count;
+	execbuf.batch_len = 8;
+	if (!nreloc)
+		execbuf.batch_len = batch_len;
+	execbuf.flags = ring_id;
+	i915_execbuffer2_set_context_id(execbuf, 0);
+
+	timed_exec_phase(fd, &execbuf, handle, BENCH_WARMUP_US);
+	return timed_exec_phase(fd, &execbuf, handle, BENCH_PHASE_US);
+}
+
+static void throughput(int fd, uint32_t devid)
+{
+	static const struct {
+		unsigned flag;
+		const char *name;
+	} rings[] = {
+		{ I915_EXEC_RENDER, "render" },
+		{ I915_EXEC_BSD, "bsd" },
+		{ I915_EXEC_BLT, "blt" },
+	};
+	uint32_t handle, target;
+	int batch_size, nreloc;
+	unsigned i;
+
+	skipped_all = false;
+
+	target = gem_create(fd, 4096);
+
+	for (i = 0; i < sizeof(rings) / sizeof(rings[0]); i++) {
+		if (rings[i].flag == I915_EXEC_BSD && !HAS_BSD_RING(devid))
+			continue;
+		if (rings[i].flag == I915_EXEC_BLT && !HAS_BLT_RING(devid))
+			continue;
+
+		for (batch_size = 4096; batch_size <= 256*1024;
+		     batch_size <<= 2) {
+			handle = nop_batch_create(fd, batch_size);
+			printf("throughput: ring=%s batch=%d relocs=0 "
+			       "execs_per_sec=%.0f\n",
+			       rings[i].name, batch_size,
+			       exec_rate(fd, handle, rings[i].flag,
+					 batch_size, 0, 0));
+			fflush(stdout);
+			gem_close(fd, handle);
+		}
+
+		/* the reloc batch terminates at its head; the entries
+		 * patch dwords beyond it that are never executed */
+		{
+			uint32_t bbe[2] = {MI_BATCH_BUFFER_END};
+
+			handle = gem_create(fd, 4096);
+			gem_write(fd, handle, 0, bbe, sizeof(bbe));
+		}
+		for (nreloc = 4; nreloc <= 64; nreloc <<= 2) {
+			printf("throughput: ring=%s batch=4096 relocs=%d "
+			       "execs_per_sec=%.0f\n",
+			       rings[i].name, nreloc,
+			       exec_rate(fd, handle, rings[i].flag,
+					 4096, target, nreloc));
+			fflush(stdout);
+		}
+		gem_close(fd, handle);
+	}
+
+	gem_close(fd, target);
+}
+
+/* Per-fd scaling: production boxes run dozens of clients per card, and
+ * single-fd throughput says nothing about the struct_mutex contention
+ * they generate.  One thread per independent fd hammers noop execbufs,
+ * doubling the fd count each pass. */
+#define MAX_FDS 16
+#define SCALING_LOOPS (1<<15)
+
+struct fd_scaling_arg {
+	int fd;
+	uint32_t handle;
+};
+
+static void *fd_scaling_thread(void *data)
+{
+	struct fd_scaling_arg *arg = data;
+
+	if (exec(arg->fd, arg->handle, SCALING_LOOPS, I915_EXEC_RENDER))
+		exit(1);
+
+	return NULL;
+}
+
+static void fd_scaling(void)
+{
+	uint32_t batch[2] = {MI_BATCH_BUFFER_END};
+	struct fd_scaling_arg args[MAX_FDS];
+	pthread_t threads[MAX_FDS];
+	double base_rate = 0.0;
+	int card, n, i;
+
+	skipped_all = false;
+
+	card = drm_get_card(0);
+
+	for (n = 1; n <= MAX_FDS; n <<= 1) {
+		struct timeval start, end;
+		int fds[MAX_FDS];
+		double secs, rate;
+
+		if (drm_open_card_fds(card, fds, n)) {
+			fprintf(stderr, "couldn't open %d fds\n", n);
+			exit(1);
+		}
+
+		for (i = 0; i < n; i++) {
+			args[i].fd = fds[i];
+			args[i].handle = gem_create(fds[i], 4096);
+			gem_write(fds[i], args[i].handle, 0, batch,
+				  sizeof(batch));
+		}
+
+		gettimeofday(&start, NULL);
+		for (i = 0; i < n; i++)
+			assert(pthread_create(&threads[i], NULL,
+					      fd_scaling_thread,
+					      &args[i]) == 0);
+		for (i = 0; i < n; i++)
+			pthread_join(threads[i], NULL);
+		gettimeofday(&end, NULL);
+
+		secs = elapsed(&start, &end, 1) / 1e6;
+		rate = (double)n * SCALING_LOOPS / secs;
+		if (n == 1)
+			base_rate = rate;
+		printf("%2d fds: %.0f execs/sec (%.2fx of single fd)\n",
+		       n, rate, rate / base_rate);
+		fflush(stdout);
+
+		for (i = 0; i < n; i++) {
+			gem_close(fds[i], args[i].handle);
+			close(fds[i]);
+		}
+	}
+}
+
 int main(int argc, char **argv)
 {
 	uint32_t batch[2] = {MI_BATCH_BUFFER_END};
@@ -134,6 +360,12 @@ int main(int argc, char **argv)
 		if (HAS_BLT_RING(devid))
 			loop(fd, handle, I915_EXEC_BLT, "blt");
 
+	if (drmtest_run_subtest("fd-scaling"))
+		fd_scaling();
+
+	if (drmtest_run_subtest("throughput"))
+		throughput(fd, devid);
+
 
 	gem_close(fd, handle);
 
@@ -40,6 +40,7 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <pthread.h>
+#include <time.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
@@ -89,6 +90,124 @@ bo_copy (void *_arg)
 	return NULL;
 }
 
+/* Contention profiler (-p): sweep thread counts from half the fence
+ * count to 4x oversubscribed, timing every page-sized access through
+ * the fenced mapping.  A page access that runs into a fence steal eats
+ * a wait plus a fresh fault, so the steal rate surfaces as the slow
+ * tail of the latency distribution - the 10ms stalls gen3 machines hit
+ * in production, as a curve against oversubscription instead of a
+ * boolean. */
+#define PROF_LOOPS 100
+#define PROF_PAGES (OBJECT_SIZE >> 12)
+#define PROF_SAMPLES (PROF_LOOPS * PROF_PAGES)
+#define PROF_MAX_THREADS 64
+
+struct prof_arg {
+	int fd;
+	int64_t *lat;
+};
+
+static int64_t
+prof_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *
+bo_profile (void *_arg)
+{
+	struct prof_arg *arg = _arg;
+	char *a, *b;
+	int n, page;
+
+	a = bo_create (arg->fd);
+	b = bo_create (arg->fd);
+
+	for (n = 0; n < PROF_LOOPS; n++) {
+		for (page = 0; page < PROF_PAGES; page++) {
+			int64_t t = prof_time_ns ();
+
+			memcpy (a + (page << 12), b + (page << 12), 4096);
+			arg->lat[n * PROF_PAGES + page] = prof_time_ns () - t;
+		}
+		sched_yield ();
+	}
+
+	munmap (a, OBJECT_SIZE);
+	munmap (b, OBJECT_SIZE);
+
+	return NULL;
+}
+
+static int
+cmp_int64 (const void *a, const void *b)
+{
+	int64_t ia = *(const int64_t *)a, ib = *(const int64_t *)b;
+
+	if (ia < ib)
+		return -1;
+	return ia > ib;
+}
+
+static void
+profile_fences (int fd, int num_fences)
+{
+	static struct prof_arg args[PROF_MAX_THREADS];
+	pthread_t threads[PROF_MAX_THREADS];
+	int64_t *merged;
+	int counts[4], t, n;
+
+	counts[0] = num_fences / 2 ?: 1;
+	counts[1] = num_fences;
+	counts[2] = num_fences * 2;
+	counts[3] = num_fences * 4;
+
+	merged = malloc (PROF_MAX_THREADS * PROF_SAMPLES * sizeof (int64_t));
+	assert (merged);
+
+	for (t = 0; t < 4; t++) {
+		int nthreads = counts[t];
+		int total, slow;
+
+		if (nthreads > PROF_MAX_THREADS)
+			nthreads = PROF_MAX_THREADS;
+
+		for (n = 0; n < nthreads; n++) {
+			args[n].fd = fd;
+			args[n].lat = merged + n * PROF_SAMPLES;
+			pthread_create (&threads[n], NULL, bo_profile,
+					&args[n]);
+		}
+		for (n = 0; n < nthreads; n++)
+			pthread_join (threads[n], NULL);
+
+		total = nthreads * PROF_SAMPLES;
+		qsort (merged, total, sizeof (int64_t), cmp_int64);
+
+		/* anything 1ms+ for a 4KiB copy means we waited for a
+		 * fence, not for memory */
+		slow = 0;
+		for (n = total - 1; n >= 0 && merged[n] >= 1000000; n--)
+			slow++;
+
+		printf ("%2d threads (%.1fx per fence): page access "
+			"p50 %6.1fus p90 %6.1fus p99 %8.1fus max %8.1fus, "
+			"%d stalls >1ms (%.2f%%)\n",
+			nthreads, (double)nthreads / num_fences,
+			merged[total / 2] / 1e3,
+			merged[total * 90 / 100] / 1e3,
+			merged[total * 99 / 100] / 1e3,
+			merged[total - 1] / 1e3,
+			slow, 100.0 * slow / total);
+		fflush (stdout);
+	}
+
+	free (merged);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -104,6 +223,12 @@ main(int argc, char **argv)
 	ret = ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp);
 	assert (ret == 0);
 
+	if (argc > 1 && strcmp (argv[1], "-p") == 0) {
+		profile_fences (fd, num_fences);
+		close (fd);
+		return 0;
+	}
+
 	printf ("creating %d threads\n", num_fences);
 	assert (num_fences < sizeof (threads) / sizeof (threads[0]));
 
@@ -25,6 +25,8 @@
  *
  */
 
+#include <unistd.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -34,6 +36,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
@@ -150,6 +153,121 @@ test_flink_lifetime(int fd)
 	assert(gem_open.handle != 0);
 }
 
+/* Namespace contention: every flink inserts into and every close of a
+ * named object removes from the single global name table, so compositor
+ * style buffer sharing funnels all clients through its lock.  Hammer
+ * the table from a growing number of threads, each on its own fd, and
+ * watch how the op rate scales. */
+#define SCALING_MAX_THREADS 16
+#define SCALING_LOOPS 4096
+
+static uint32_t anchor_names[SCALING_MAX_THREADS];
+static int scaling_nthreads;
+
+struct scaling_arg {
+	int fd;
+	int idx;
+};
+
+static void *scaling_thread(void *data)
+{
+	struct scaling_arg *arg = data;
+	struct drm_i915_gem_create create;
+	struct drm_gem_flink flink;
+	struct drm_gem_open gem_open;
+	int i, ret;
+
+	for (i = 0; i < SCALING_LOOPS; i++) {
+		/* publish a fresh name ... */
+		memset(&create, 0, sizeof(create));
+		create.size = 4096;
+		ret = ioctl(arg->fd, DRM_IOCTL_I915_GEM_CREATE, &create);
+		assert(ret == 0);
+		flink.handle = create.handle;
+		ret = ioctl(arg->fd, DRM_IOCTL_GEM_FLINK, &flink);
+		assert(ret == 0);
+
+		/* ... look up a neighbour's long-lived one ... */
+		gem_open.name = anchor_names[(arg->idx + i) %
+					     scaling_nthreads];
+		ret = ioctl(arg->fd, DRM_IOCTL_GEM_OPEN, &gem_open);
+		assert(ret == 0);
+		gem_close(arg->fd, gem_open.handle);
+
+		/* ... and retire ours, removing the name again */
+		gem_close(arg->fd, create.handle);
+	}
+
+	return NULL;
+}
+
+static void
+test_namespace_scaling(void)
+{
+	struct scaling_arg args[SCALING_MAX_THREADS];
+	pthread_t threads[SCALING_MAX_THREADS];
+	uint32_t anchors[SCALING_MAX_THREADS];
+	double base_rate = 0.0;
+	int anchor_fd, card, n, i;
+
+	card = drm_get_card(0);
+
+	/* the anchors live on their own fd so that opening them from a
+	 * worker always allocates a new handle instead of refinding (and
+	 * then destroying) the owner's */
+	anchor_fd = drm_open_any();
+	for (i = 0; i < SCALING_MAX_THREADS; i++) {
+		struct drm_gem_flink flink;
+
+		anchors[i] = gem_create(anchor_fd, 4096);
+		flink.handle = anchors[i];
+		assert(ioctl(anchor_fd, DRM_IOCTL_GEM_FLINK, &flink) == 0);
+		anchor_names[i] = flink.name;
+	}
+
+	for (n = 1; n <= SCALING_MAX_THREADS; n <<= 1) {
+		struct timeval start, end;
+		int fds[SCALING_MAX_THREADS];
+		double secs, rate;
+
+		if (drm_open_card_fds(card, fds, n)) {
+			fprintf(stderr, "couldn't open %d fds\n", n);
+			exit(1);
+		}
+
+		scaling_nthreads = n;
+		for (i = 0; i < n; i++) {
+			args[i].fd = fds[i];
+			args[i].idx = i;
+		}
+
+		gettimeofday(&start, NULL);
+		for (i = 0; i < n; i++)
+			assert(pthread_create(&threads[i], NULL,
+					      scaling_thread, &args[i]) == 0);
+		for (i = 0; i < n; i++)
+			pthread_join(threads[i], NULL);
+		gettimeofday(&end, NULL);
+
+		secs = end.tv_sec - start.tv_sec +
+			(end.tv_usec - start.tv_usec) / 1e6;
+		/* flink + open + name removal per loop */
+		rate = 3. * n * SCALING_LOOPS / secs;
+		if (n == 1)
+			base_rate = rate;
+		printf("%2d threads: %.0f name ops/sec (%.2fx of single thread)\n",
+		       n, rate, rate / base_rate);
+		fflush(stdout);
+
+		for (i = 0; i < n; i++)
+			close(fds[i]);
+	}
+
+	for (i = 0; i < SCALING_MAX_THREADS; i++)
+		gem_close(anchor_fd, anchors[i]);
+	close(anchor_fd);
+}
+
 int main(int argc, char **argv)
 {
 	int fd;
@@ -168,6 +286,8 @@ int main(int argc, char **argv)
 		test_bad_open(fd);
 	if (drmtest_run_subtest("flink-lifetime"))
 		test_flink_lifetime(fd);
+	if (drmtest_run_subtest("namespace-scaling"))
+		test_namespace_scaling();
 
 	return 0;
 }
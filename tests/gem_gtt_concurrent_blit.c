@@ -41,6 +41,11 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
@@ -90,6 +95,57 @@ create_bo(drm_intel_bufmgr *bufmgr, uint32_t val, int width, int height)
 	return bo;
 }
 
+/* Lock-free producer/consumer mode.  One thread refills source buffers
+ * through their persistent GTT mappings while the main thread blits and
+ * verifies, with handover via a single-producer/single-consumer ring of
+ * descriptors - no locks, just the ring indices and a memory barrier on
+ * publish.  This keeps CPU writes through the aperture and blitter
+ * reads genuinely concurrent on the shared set, which the serial
+ * subtests never achieve.
+ *
+ * Since the producer is at most PC_RING_SIZE frames ahead and a buffer
+ * index only repeats every num_buffers frames, a source can't be
+ * rewritten while its blit is still queued provided
+ * num_buffers >= PC_RING_SIZE. */
+#define PC_RING_SIZE	16	/* power of two */
+#define PC_FRAMES	512
+
+/* forked writers released together by the futex rendezvous */
+#define SYNC_CHILDREN	4
+
+struct pc_slot {
+	int buf;
+	uint32_t val;
+};
+
+static struct pc_slot pc_slots[PC_RING_SIZE];
+static volatile uint32_t pc_head, pc_tail;
+static drm_intel_bo **pc_src;
+static int pc_num_buffers, pc_width, pc_height;
+
+static void *
+pc_producer(void *arg)
+{
+	uint32_t frame;
+
+	for (frame = 0; frame < PC_FRAMES; frame++) {
+		struct pc_slot *slot;
+
+		while (pc_head - pc_tail == PC_RING_SIZE)
+			sched_yield();
+
+		slot = &pc_slots[pc_head % PC_RING_SIZE];
+		slot->buf = frame % pc_num_buffers;
+		slot->val = 0xc5000000 | frame;
+		set_bo(pc_src[slot->buf], slot->val, pc_width, pc_height);
+
+		__sync_synchronize();
+		pc_head++;
+	}
+
+	return NULL;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -153,5 +209,105 @@ main(int argc, char **argv)
 			cmp_bo(dst[i], 0xabcdabcd, width, height);
 	}
 
+	/* writer thread vs. blitter on the same working set */
+	if (drmtest_run_subtest("producer-consumer")) {
+		struct timeval start, end;
+		pthread_t producer;
+		uint32_t frame;
+		double secs;
+
+		assert(num_buffers >= PC_RING_SIZE);
+		pc_src = src;
+		pc_num_buffers = num_buffers;
+		pc_width = width;
+		pc_height = height;
+		pc_head = pc_tail = 0;
+
+		gettimeofday(&start, NULL);
+		assert(pthread_create(&producer, NULL, pc_producer, NULL) == 0);
+
+		for (frame = 0; frame < PC_FRAMES; frame++) {
+			struct pc_slot *slot;
+
+			while (pc_tail == pc_head)
+				sched_yield();
+			__sync_synchronize();
+
+			slot = &pc_slots[pc_tail % PC_RING_SIZE];
+			intel_copy_bo(batch, dst[slot->buf], src[slot->buf],
+				      width, height);
+			cmp_bo(dst[slot->buf], slot->val, width, height);
+
+			pc_tail++;
+		}
+
+		pthread_join(producer, NULL);
+		gettimeofday(&end, NULL);
+
+		secs = end.tv_sec - start.tv_sec +
+			(end.tv_usec - start.tv_usec) / 1e6;
+		printf("producer-consumer: %d frames in %.3f secs "
+		       "(%.1f MB/s through the blitter)\n",
+		       PC_FRAMES, secs,
+		       PC_FRAMES * 4.0 * width * height / (1024*1024) / secs);
+	}
+
+	/* true same-window concurrency: processes released together by
+	 * the futex barrier write interleaved stripes of one bo through
+	 * their own GTT mappings */
+	if (drmtest_run_subtest("synced-stripes")) {
+		struct drmtest_rendezvous *rv;
+		pid_t kids[SYNC_CHILDREN];
+		uint32_t name, *vaddr;
+		int n, j, status, dead = 0;
+
+		rv = drmtest_rendezvous_create(SYNC_CHILDREN);
+		assert(rv);
+		assert(drm_intel_bo_flink(src[0], &name) == 0);
+
+		for (n = 0; n < SYNC_CHILDREN; n++) {
+			kids[n] = fork();
+			if (kids[n] == 0) {
+				struct drm_gem_open op;
+				volatile uint32_t *ptr;
+				int cfd = drm_open_any();
+
+				op.name = name;
+				do_ioctl(cfd, DRM_IOCTL_GEM_OPEN, &op);
+				ptr = gem_mmap__gtt(cfd, op.handle,
+						    4 * width * height,
+						    PROT_READ | PROT_WRITE);
+				assert(ptr);
+				gem_set_domain(cfd, op.handle,
+					       I915_GEM_DOMAIN_GTT,
+					       I915_GEM_DOMAIN_GTT);
+
+				drmtest_rendezvous_wait(rv);
+				for (j = n; j < width * height;
+				     j += SYNC_CHILDREN)
+					ptr[j] = 0x51000000 | n;
+				exit(0);
+			}
+		}
+		for (n = 0; n < SYNC_CHILDREN; n++) {
+			waitpid(kids[n], &status, 0);
+			if (!WIFEXITED(status) || WEXITSTATUS(status))
+				dead++;
+		}
+		assert(dead == 0);
+
+		printf("synced-stripes: %d processes released within "
+		       "%lld us\n", SYNC_CHILDREN,
+		       drmtest_rendezvous_skew_us(rv));
+
+		drm_intel_gem_bo_start_gtt_access(src[0], false);
+		vaddr = src[0]->virtual;
+		for (j = 0; j < width * height; j++)
+			assert(vaddr[j] ==
+			       (0x51000000 | (j % SYNC_CHILDREN)));
+
+		drmtest_rendezvous_destroy(rv);
+	}
+
 	return 0;
 }
@@ -38,29 +38,308 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
-#include <sys/time.h>
+#include <math.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
+#include "intel_clock.h"
+#include "intel_gpu_tools.h"
+#include "intel_results.h"
 
 #define OBJECT_SIZE 16384
 
-static double elapsed(const struct timeval *start,
-		      const struct timeval *end,
-		      int loop)
+static double elapsed(uint64_t start, uint64_t end, int loop)
 {
-	return (1e6*(end->tv_sec - start->tv_sec) + (end->tv_usec - start->tv_usec))/loop;
+	return intel_clock_to_us(end - start) / loop;
+}
+
+/*
+ * Sweep mode (-S): instead of the single-size spot measurements below,
+ * walk the (path, access pattern, object size) space and emit one CSV
+ * row per point with a mean bandwidth and a 95% confidence interval
+ * over repeated runs.  Each run moves a fixed byte budget rather than a
+ * fixed iteration count, so small and large objects get comparable
+ * timing resolution.  This is the form the kernel regression gates
+ * consume; the human-readable mode is unchanged.
+ */
+
+#define SWEEP_BUDGET	(64ull << 20)	/* bytes per timed run */
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+#endif
+
+static int sweep_runs = 5;
+
+/* two-sided t values for 95%, indexed by runs - 2 (i.e. df - 1) */
+static const double t95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228
+};
+
+enum sweep_path {
+	PATH_CPU_READ,
+	PATH_CPU_WRITE,
+	PATH_GTT_READ,
+	PATH_GTT_WRITE,
+	PATH_PREAD,
+	PATH_PWRITE,
+	NUM_PATHS
+};
+
+static const char *path_name[NUM_PATHS] = {
+	"cpu-mmap-read", "cpu-mmap-write",
+	"gtt-mmap-read", "gtt-mmap-write",
+	"pread", "pwrite",
+};
+
+/* for the mmap paths: how the run walks the mapping.  stream uses
+ * memcpy/memset, u32 a word-at-a-time loop, stride64 one word per
+ * cacheline.  For pread/pwrite the patterns are transfer granularity
+ * instead: one full-size call vs. 4KiB chunks. */
+enum sweep_pattern {
+	PAT_STREAM,
+	PAT_U32,
+	PAT_STRIDE64,
+	NUM_PATTERNS
+};
+
+static const char *map_pattern_name[NUM_PATTERNS] = {
+	"stream", "u32", "stride64"
+};
+static const char *xfer_pattern_name[NUM_PATTERNS] = {
+	"full", "chunk4k", NULL
+};
+
+static uint32_t sweep_scratch_x;
+
+static uint64_t map_touch(volatile uint32_t *ptr, int size,
+			  enum sweep_pattern pat, int write,
+			  void *scratch)
+{
+	uint32_t x = 0;
+	int i, step;
+
+	switch (pat) {
+	case PAT_STREAM:
+		if (write)
+			memset((void *)ptr, 0x55, size);
+		else
+			memcpy(scratch, (void *)ptr, size);
+		return size;
+	case PAT_U32:
+		step = 1;
+		break;
+	default:
+		step = 64 / sizeof(*ptr);
+		break;
+	}
+
+	if (write)
+		for (i = 0; i < size/sizeof(*ptr); i += step)
+			ptr[i] = i;
+	else
+		for (i = 0; i < size/sizeof(*ptr); i += step)
+			x += ptr[i];
+
+	/* keep the read loop honest */
+	sweep_scratch_x += x;
+
+	/* bytes actually accessed; a cached path still pulls whole
+	 * lines for stride64, which is exactly the effect the sweep is
+	 * meant to expose */
+	return (uint64_t)(size/sizeof(*ptr) / step) * sizeof(*ptr);
+}
+
+static double sweep_one_run(int fd, uint32_t handle, int size,
+			    enum sweep_path path, enum sweep_pattern pat,
+			    void *buf, void *scratch)
+{
+	uint64_t moved = 0, start, end;
+	uint32_t *base = NULL;
+	int chunk, off;
+
+	switch (path) {
+	case PATH_CPU_READ:
+	case PATH_CPU_WRITE:
+		gem_set_domain(fd, handle,
+			       I915_GEM_DOMAIN_CPU, I915_GEM_DOMAIN_CPU);
+		base = gem_mmap__cpu(fd, handle, size, PROT_READ | PROT_WRITE);
+		break;
+	case PATH_GTT_READ:
+	case PATH_GTT_WRITE:
+		base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
+		gem_mmap_prefault(base, size);
+		break;
+	default:
+		break;
+	}
+
+	start = intel_clock_now();
+	while (moved < SWEEP_BUDGET) {
+		switch (path) {
+		case PATH_CPU_READ:
+		case PATH_GTT_READ:
+			moved += map_touch(base, size, pat, 0, scratch);
+			break;
+		case PATH_CPU_WRITE:
+		case PATH_GTT_WRITE:
+			moved += map_touch(base, size, pat, 1, scratch);
+			break;
+		case PATH_PREAD:
+		case PATH_PWRITE:
+			chunk = (pat == PAT_STREAM) ? size : 4096;
+			if (chunk > size)
+				chunk = size;
+			for (off = 0; off < size; off += chunk) {
+				if (path == PATH_PREAD)
+					gem_read(fd, handle, off,
+						 (char *)buf + off, chunk);
+				else
+					gem_write(fd, handle, off,
+						  (char *)buf + off, chunk);
+			}
+			moved += size;
+			break;
+		default:
+			break;
+		}
+	}
+	end = intel_clock_now();
+
+	if (base)
+		munmap(base, size);
+
+	return moved / (intel_clock_to_us(end - start) / 1e6) / (1024.*1024.);
+}
+
+static void run_sweep(int fd, FILE *out)
+{
+	void *buf, *scratch;
+	double *mbps;
+	uint32_t devid = intel_get_drm_devid(fd);
+	char metric[32];
+	int path, pat, size;
+
+	buf = malloc(16 << 20);
+	scratch = malloc(16 << 20);
+	mbps = malloc(sweep_runs * sizeof(*mbps));
+	assert(buf && scratch && mbps);
+	memset(buf, 0, 16 << 20);
+
+	fprintf(out, "path,pattern,size,runs,mbps_mean,mbps_ci95\n");
+
+	for (path = 0; path < NUM_PATHS; path++) {
+		const char **pat_names =
+			(path == PATH_PREAD || path == PATH_PWRITE) ?
+			xfer_pattern_name : map_pattern_name;
+
+		for (pat = 0; pat < NUM_PATTERNS; pat++) {
+			if (!pat_names[pat])
+				continue;
+
+			for (size = 4096; size <= 16 << 20; size <<= 2) {
+				uint32_t handle = gem_create(fd, size);
+				double sum = 0, var = 0, mean, sd, ci;
+				int run;
+
+				assert(handle);
+
+				/* warm-up pass outside the statistics */
+				sweep_one_run(fd, handle, size, path, pat,
+					      buf, scratch);
+
+				for (run = 0; run < sweep_runs; run++) {
+					mbps[run] = sweep_one_run(fd, handle,
+								  size, path,
+								  pat, buf,
+								  scratch);
+					sum += mbps[run];
+				}
+
+				mean = sum / sweep_runs;
+				for (run = 0; run < sweep_runs; run++)
+					var += (mbps[run] - mean) *
+						(mbps[run] - mean);
+				sd = sqrt(var / (sweep_runs - 1));
+				ci = t95[sweep_runs - 2] * sd /
+					sqrt(sweep_runs);
+
+				fprintf(out, "%s,%s,%d,%d,%.2f,%.2f\n",
+					path_name[path], pat_names[pat],
+					size, sweep_runs, mean, ci);
+				fflush(out);
+
+				snprintf(metric, sizeof(metric), "%s/%s/%dK",
+					 path_name[path], pat_names[pat],
+					 size >> 10);
+				intel_results_report(devid, "gem_gtt_speed",
+						     metric, mean, "MiB/s");
+
+				gem_close(fd, handle);
+			}
+		}
+	}
+
+	free(mbps);
+	free(scratch);
+	free(buf);
+}
+
+static int sweep_main(int argc, char **argv)
+{
+	FILE *out = stdout;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "So:r:")) != -1) {
+		switch (c) {
+		case 'S':
+			break;
+		case 'o':
+			out = fopen(optarg, "w");
+			if (!out) {
+				fprintf(stderr, "can't open %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'r':
+			sweep_runs = atoi(optarg);
+			if (sweep_runs < 2 ||
+			    sweep_runs > ARRAY_SIZE(t95) + 1) {
+				fprintf(stderr, "runs must be 2..%d\n",
+					(int)ARRAY_SIZE(t95) + 1);
+				return 1;
+			}
+			break;
+		default:
+			fprintf(stderr,
+				"usage: gem_gtt_speed [size] or "
+				"gem_gtt_speed -S [-o file] [-r runs]\n");
+			return 1;
+		}
+	}
+
+	fd = drm_open_any();
+	run_sweep(fd, out);
+	close(fd);
+
+	if (out != stdout)
+		fclose(out);
+
+	return 0;
 }
 
 int main(int argc, char **argv)
 {
-	struct timeval start, end;
+	uint64_t start, end;
 	uint8_t *buf;
 	uint32_t handle;
 	int size = OBJECT_SIZE;
 	int loop, i, tiling;
 	int fd;
 
+	if (argc > 1 && argv[1][0] == '-')
+		return sweep_main(argc, argv);
+
 	if (argc > 1)
 		size = atoi(argv[1]);
 	if (size == 0) {
@@ -101,7 +380,7 @@ int main(int argc, char **argv)
 				munmap(base, size);
 
 				/* mmap read */
-				gettimeofday(&start, NULL);
+				start = intel_clock_now();
 				for (loop = 0; loop < 1000; loop++) {
 					base = gem_mmap__cpu(fd, handle, size, PROT_READ | PROT_WRITE);
 					ptr = base;
@@ -115,12 +394,12 @@ int main(int argc, char **argv)
 
 					munmap(base, size);
 				}
-				gettimeofday(&end, NULL);
+				end = intel_clock_now();
 				printf("Time to read %dk through a CPU map:		%7.3fµs\n",
-				       size/1024, elapsed(&start, &end, loop));
+				       size/1024, elapsed(start, end, loop));
 
 				/* mmap write */
-				gettimeofday(&start, NULL);
+				start = intel_clock_now();
 				for (loop = 0; loop < 1000; loop++) {
 					base = gem_mmap__cpu(fd, handle, size, PROT_READ | PROT_WRITE);
 					ptr = base;
@@ -130,63 +409,64 @@ int main(int argc, char **argv)
 
 					munmap(base, size);
 				}
-				gettimeofday(&end, NULL);
+				end = intel_clock_now();
 				printf("Time to write %dk through a CPU map:		%7.3fµs\n",
-				       size/1024, elapsed(&start, &end, loop));
+				       size/1024, elapsed(start, end, loop));
 
-				gettimeofday(&start, NULL);
+				start = intel_clock_now();
 				for (loop = 0; loop < 1000; loop++) {
 					base = gem_mmap__cpu(fd, handle, size, PROT_READ | PROT_WRITE);
 					memset(base, 0, size);
 					munmap(base, size);
 				}
-				gettimeofday(&end, NULL);
+				end = intel_clock_now();
 				printf("Time to clear %dk through a CPU map:		%7.3fµs\n",
-				       size/1024, elapsed(&start, &end, loop));
+				       size/1024, elapsed(start, end, loop));
 
-				gettimeofday(&start, NULL);
+				start = intel_clock_now();
 				base = gem_mmap__cpu(fd, handle, size, PROT_READ | PROT_WRITE);
 				for (loop = 0; loop < 1000; loop++)
 					memset(base, 0, size);
 				munmap(base, size);
-				gettimeofday(&end, NULL);
+				end = intel_clock_now();
 				printf("Time to clear %dk through a cached CPU map:	%7.3fµs\n",
-				       size/1024, elapsed(&start, &end, loop));
+				       size/1024, elapsed(start, end, loop));
 			}
 
 			/* CPU pwrite */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++)
 				gem_write(fd, handle, 0, buf, size);
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pwrite %dk through the CPU:		%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			/* CPU pread */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++)
 				gem_read(fd, handle, 0, buf, size);
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pread %dk through the CPU:		%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 		}
 
-		/* prefault into gtt */
+		/* prefault into gtt, reporting the cold-fault cost that the
+		 * timed loops below no longer pay */
 		{
+			uint64_t faults = gem_fault_count();
 			uint32_t *base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
-			volatile uint32_t *ptr = base;
-			int x = 0;
-
-			for (i = 0; i < size/sizeof(*ptr); i++)
-				x += ptr[i];
 
-			/* force overtly clever gcc to actually compute x */
-			ptr[0] = x;
+			start = intel_clock_now();
+			gem_mmap_prefault(base, size);
+			end = intel_clock_now();
+			printf("Time to fault in %dk through a GTT map:	%7.3fµs (%lu faults)\n",
+			       size/1024, elapsed(start, end, 1),
+			       (unsigned long)(gem_fault_count() - faults));
 
 			munmap(base, size);
 		}
 		/* mmap read */
-		gettimeofday(&start, NULL);
+		start = intel_clock_now();
 		for (loop = 0; loop < 1000; loop++) {
 			uint32_t *base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
 			volatile uint32_t *ptr = base;
@@ -200,12 +480,12 @@ int main(int argc, char **argv)
 
 			munmap(base, size);
 		}
-		gettimeofday(&end, NULL);
+		end = intel_clock_now();
 		printf("Time to read %dk through a GTT map:		%7.3fµs\n",
-		       size/1024, elapsed(&start, &end, loop));
+		       size/1024, elapsed(start, end, loop));
 
 		/* mmap write */
-		gettimeofday(&start, NULL);
+		start = intel_clock_now();
 		for (loop = 0; loop < 1000; loop++) {
 			uint32_t *base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
 			volatile uint32_t *ptr = base;
@@ -215,32 +495,32 @@ int main(int argc, char **argv)
 
 			munmap(base, size);
 		}
-		gettimeofday(&end, NULL);
+		end = intel_clock_now();
 		printf("Time to write %dk through a GTT map:		%7.3fµs\n",
-		       size/1024, elapsed(&start, &end, loop));
+		       size/1024, elapsed(start, end, loop));
 
 		/* mmap clear */
-		gettimeofday(&start, NULL);
+		start = intel_clock_now();
 		for (loop = 0; loop < 1000; loop++) {
 			uint32_t *base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
 			memset(base, 0, size);
 			munmap(base, size);
 		}
-		gettimeofday(&end, NULL);
+		end = intel_clock_now();
 		printf("Time to clear %dk through a GTT map:		%7.3fµs\n",
-		       size/1024, elapsed(&start, &end, loop));
+		       size/1024, elapsed(start, end, loop));
 
-		gettimeofday(&start, NULL);{
+		start = intel_clock_now();{
 			uint32_t *base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
 			for (loop = 0; loop < 1000; loop++)
 				memset(base, 0, size);
 			munmap(base, size);
-		} gettimeofday(&end, NULL);
+		} end = intel_clock_now();
 		printf("Time to clear %dk through a cached GTT map:	%7.3fµs\n",
-		       size/1024, elapsed(&start, &end, loop));
+		       size/1024, elapsed(start, end, loop));
 
 		/* mmap read */
-		gettimeofday(&start, NULL);
+		start = intel_clock_now();
 		for (loop = 0; loop < 1000; loop++) {
 			uint32_t *base = gem_mmap(fd, handle, size, PROT_READ | PROT_WRITE);
 			volatile uint32_t *ptr = base;
@@ -254,70 +534,70 @@ int main(int argc, char **argv)
 
 			munmap(base, size);
 		}
-		gettimeofday(&end, NULL);
+		end = intel_clock_now();
 		printf("Time to read %dk (again) through a GTT map:	%7.3fµs\n",
-		       size/1024, elapsed(&start, &end, loop));
+		       size/1024, elapsed(start, end, loop));
 
 		if (tiling == I915_TILING_NONE) {
 			/* GTT pwrite */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++)
 				gem_write(fd, handle, 0, buf, size);
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pwrite %dk through the GTT:		%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			/* GTT pread */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++)
 				gem_read(fd, handle, 0, buf, size);
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pread %dk through the GTT:		%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			/* GTT pwrite, including clflush */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++) {
 				gem_write(fd, handle, 0, buf, size);
 				gem_sync(fd, handle);
 			}
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pwrite %dk through the GTT (clflush):	%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			/* GTT pread, including clflush */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++) {
 				gem_sync(fd, handle);
 				gem_read(fd, handle, 0, buf, size);
 			}
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pread %dk through the GTT (clflush):	%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			/* partial writes */
 			printf("Now partial writes.\n");
 			size /= 4;
 
 			/* partial GTT pwrite, including clflush */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++) {
 				gem_write(fd, handle, 0, buf, size);
 				gem_sync(fd, handle);
 			}
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pwrite %dk through the GTT (clflush):	%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			/* partial GTT pread, including clflush */
-			gettimeofday(&start, NULL);
+			start = intel_clock_now();
 			for (loop = 0; loop < 1000; loop++) {
 				gem_sync(fd, handle);
 				gem_read(fd, handle, 0, buf, size);
 			}
-			gettimeofday(&end, NULL);
+			end = intel_clock_now();
 			printf("Time to pread %dk through the GTT (clflush):	%7.3fµs\n",
-			       size/1024, elapsed(&start, &end, loop));
+			       size/1024, elapsed(start, end, loop));
 
 			size *= 4;
 		}
@@ -0,0 +1,352 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Testcase: innocent-client throughput under a storm of gpu hangs
+ *
+ * gem_hang injects a single hang and exits; on a shared machine the
+ * interesting question is what that hang costs everyone else.  This
+ * forks a set of innocent clients, each with its own fd, continuously
+ * submitting small synchronous blits (spread across the render and blt
+ * rings where available), plus one bad client that re-submits the
+ * gem_hang scanline-wait batch at a fixed interval.  Every client
+ * counts completed batches into a per-interval bucket in shared
+ * memory, so afterwards we can print a throughput timeline with the
+ * hang injections marked, plus per-client totals - a client that
+ * recovers much later than its peers shows up as a fairness gap.
+ *
+ * Needs a kernel with working gpu reset; like gem_hang it takes the
+ * number of a disabled pipe and lives in the HANG group, so it is
+ * never run by default.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+
+#define MAX_CLIENTS	8
+#define MAX_HANGS	64
+#define BUCKET_MS	250
+#define MAX_BUCKETS	((60 * 1000) / BUCKET_MS)
+
+#define BLIT_SIZE	(256 * 1024)
+#define BLIT_WIDTH	256
+
+struct client_stats {
+	uint32_t ops[MAX_BUCKETS];
+	uint32_t eio;
+	uint32_t total;
+};
+
+struct storm_shared {
+	volatile int stop;
+	struct client_stats clients[MAX_CLIENTS];
+	double hang_us[MAX_HANGS];
+	int num_hangs;
+};
+
+static struct storm_shared *shared;
+static double t_start_us;
+
+static int duration_s = 10;
+static int hang_interval_ms = 2000;
+static int num_clients = 4;
+static int bad_pipe;
+
+static double now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+static int exec_blit(int fd, uint32_t batch_handle, uint32_t len,
+		     uint32_t dst, uint32_t src,
+		     struct drm_i915_gem_relocation_entry *reloc,
+		     unsigned ring)
+{
+	struct drm_i915_gem_exec_object2 obj[3];
+	struct drm_i915_gem_execbuffer2 exec;
+
+	memset(obj, 0, sizeof(obj));
+	obj[0].handle = dst;
+	obj[1].handle = src;
+	obj[2].handle = batch_handle;
+	obj[2].relocation_count = 2;
+	obj[2].relocs_ptr = (uintptr_t)reloc;
+
+	memset(&exec, 0, sizeof(exec));
+	exec.buffers_ptr = (uintptr_t)obj;
+	exec.buffer_count = 3;
+	exec.batch_len = len;
+	exec.flags = ring;
+	i915_execbuffer2_set_context_id(exec, 0);
+
+	return drmIoctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &exec);
+}
+
+static void innocent_client(int id)
+{
+	struct drm_i915_gem_relocation_entry reloc[2];
+	struct client_stats *stats = &shared->clients[id];
+	uint32_t batch[10];
+	uint32_t handle, dst, src;
+	unsigned ring = 0;
+	int fd, ret;
+
+	fd = drm_open_any();
+
+	/* odd clients take the blt ring when there is one, so a reset on
+	 * one ring has innocents on the other to starve */
+	if ((id & 1) && HAS_BLT_RING(intel_get_drm_devid(fd)))
+		ring = I915_EXEC_BLT;
+
+	dst = gem_create(fd, BLIT_SIZE);
+	src = gem_create(fd, BLIT_SIZE);
+
+	batch[0] = XY_SRC_COPY_BLT_CMD |
+		   XY_SRC_COPY_BLT_WRITE_ALPHA |
+		   XY_SRC_COPY_BLT_WRITE_RGB;
+	batch[1] = (3 << 24) | (0xcc << 16) | BLIT_WIDTH*4;
+	batch[2] = 0;
+	batch[3] = ((BLIT_SIZE / (BLIT_WIDTH * 4)) << 16) | BLIT_WIDTH;
+	batch[4] = 0;
+	batch[5] = 0;
+	batch[6] = BLIT_WIDTH*4;
+	batch[7] = 0;
+	batch[8] = MI_BATCH_BUFFER_END;
+	batch[9] = MI_NOOP;
+
+	handle = gem_create(fd, 4096);
+	gem_write(fd, handle, 0, batch, sizeof(batch));
+
+	memset(reloc, 0, sizeof(reloc));
+	reloc[0].target_handle = dst;
+	reloc[0].offset = 4 * sizeof(batch[0]);
+	reloc[0].read_domains = I915_GEM_DOMAIN_RENDER;
+	reloc[0].write_domain = I915_GEM_DOMAIN_RENDER;
+	reloc[1].target_handle = src;
+	reloc[1].offset = 7 * sizeof(batch[0]);
+	reloc[1].read_domains = I915_GEM_DOMAIN_RENDER;
+
+	while (!shared->stop) {
+		int bucket;
+
+		ret = exec_blit(fd, handle, sizeof(batch), dst, src,
+				reloc, ring);
+		if (ret) {
+			if (errno == EIO || errno == EAGAIN) {
+				/* reset in progress; note it and retry */
+				stats->eio++;
+				usleep(1000);
+				continue;
+			}
+			if (errno == EBUSY) {
+				drmCommandNone(fd, DRM_I915_GEM_THROTTLE);
+				continue;
+			}
+			fprintf(stderr, "client %d: execbuf: %s\n",
+				id, strerror(errno));
+			exit(1);
+		}
+		gem_sync(fd, handle);
+
+		bucket = (now_us() - t_start_us) / (1000 * BUCKET_MS);
+		if (bucket >= 0 && bucket < MAX_BUCKETS)
+			stats->ops[bucket]++;
+		stats->total++;
+	}
+
+	close(fd);
+	exit(0);
+}
+
+static void hang_client(void)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	int cmd, fd;
+
+	fd = drm_open_any();
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+
+	cmd = bad_pipe ? MI_WAIT_FOR_PIPEB_SCAN_LINE_WINDOW :
+		MI_WAIT_FOR_PIPEA_SCAN_LINE_WINDOW;
+
+	while (!shared->stop) {
+		if (shared->num_hangs < MAX_HANGS)
+			shared->hang_us[shared->num_hangs++] =
+				now_us() - t_start_us;
+
+		/* same poison as gem_hang: wait on a scanline window of a
+		 * disabled pipe, which never signals */
+		BEGIN_BATCH(6);
+		OUT_BATCH(MI_LOAD_SCAN_LINES_INCL | (bad_pipe << 20));
+		OUT_BATCH((0 << 16) | 2048);
+		OUT_BATCH(MI_LOAD_SCAN_LINES_INCL | (bad_pipe << 20));
+		OUT_BATCH((0 << 16) | 2048);
+		OUT_BATCH(MI_WAIT_FOR_EVENT | cmd);
+		OUT_BATCH(MI_NOOP);
+		ADVANCE_BATCH();
+		intel_batchbuffer_flush(batch);
+
+		usleep(hang_interval_ms * 1000);
+	}
+
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+	close(fd);
+	exit(0);
+}
+
+static void report(void)
+{
+	int buckets = (duration_s * 1000) / BUCKET_MS;
+	uint32_t min_total = ~0u, max_total = 0;
+	int i, c, h;
+
+	printf("throughput timeline (batches per %dms, all clients):\n",
+	       BUCKET_MS);
+	h = 0;
+	for (i = 0; i < buckets && i < MAX_BUCKETS; i++) {
+		uint32_t sum = 0;
+		int hang_here = 0;
+
+		for (c = 0; c < num_clients; c++)
+			sum += shared->clients[c].ops[i];
+		while (h < shared->num_hangs &&
+		       shared->hang_us[h] < (double)(i + 1) * 1000 * BUCKET_MS) {
+			hang_here++;
+			h++;
+		}
+
+		printf("%6.2fs %6d%s\n", (i + 1) * BUCKET_MS / 1000.0, sum,
+		       hang_here ? "  <- hang injected" : "");
+	}
+
+	printf("\nper-client totals:\n");
+	for (c = 0; c < num_clients; c++) {
+		struct client_stats *stats = &shared->clients[c];
+
+		printf("client %d: %u batches, %u submissions refused\n",
+		       c, stats->total, stats->eio);
+		if (stats->total < min_total)
+			min_total = stats->total;
+		if (stats->total > max_total)
+			max_total = stats->total;
+	}
+	if (min_total)
+		printf("fairness: slowest client got %.0f%% of the fastest\n",
+		       100.0 * min_total / max_total);
+	else
+		printf("fairness: a client made no progress at all\n");
+}
+
+int main(int argc, char **argv)
+{
+	pid_t children[MAX_CLIENTS + 1];
+	int i, nchildren = 0, dead = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <disabled pipe number> "
+			"[hang_interval_ms] [duration_s] [clients]\n",
+			argv[0]);
+		exit(-1);
+	}
+	bad_pipe = atoi(argv[1]);
+	if (argc > 2)
+		hang_interval_ms = atoi(argv[2]);
+	if (argc > 3)
+		duration_s = atoi(argv[3]);
+	if (argc > 4)
+		num_clients = atoi(argv[4]);
+	if (num_clients < 1 || num_clients > MAX_CLIENTS ||
+	    hang_interval_ms < 100 ||
+	    duration_s < 1 || duration_s > (MAX_BUCKETS * BUCKET_MS) / 1000) {
+		fprintf(stderr, "parameters out of range\n");
+		exit(-1);
+	}
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(shared != MAP_FAILED);
+	memset((void *)shared, 0, sizeof(*shared));
+
+	/* a quick open up front so a missing device skips before forking */
+	close(drm_open_any());
+
+	t_start_us = now_us();
+
+	for (i = 0; i < num_clients; i++) {
+		children[nchildren] = fork();
+		if (children[nchildren] == 0)
+			innocent_client(i);
+		nchildren++;
+	}
+	children[nchildren] = fork();
+	if (children[nchildren] == 0)
+		hang_client();
+	nchildren++;
+
+	sleep(duration_s);
+	shared->stop = 1;
+
+	for (i = 0; i < nchildren; i++) {
+		int status = 0;
+
+		waitpid(children[i], &status, 0);
+		if (status)
+			dead++;
+	}
+
+	report();
+
+	if (dead) {
+		fprintf(stderr, "%d child(ren) died - reset did not recover "
+			"cleanly\n", dead);
+		drmtest_spool_error_state("hang");
+		return 1;
+	}
+
+	return 0;
+}
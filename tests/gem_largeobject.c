@@ -34,9 +34,11 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
+#include "intel_pattern.h"
 
 /* Should take 64 pages to store the page pointers on 64 bit */
 #define OBJ_SIZE (128 * 1024 * 1024)
@@ -83,13 +85,118 @@ test_large_object(int fd)
 	/* kernel should clean this up for us */
 }
 
+#define STREAM_CHUNK_SIZE (8 * 1024 * 1024)
+
+static double stream_elapsed_us(const struct timeval *start,
+				const struct timeval *end)
+{
+	return 1e6 * (end->tv_sec - start->tv_sec) +
+		(end->tv_usec - start->tv_usec);
+}
+
+static void stream_object(int fd, uint64_t obj_size, uint32_t chunk_size,
+			  uint64_t mappable)
+{
+	struct timeval start, end;
+	uint64_t ofs, prev_ofs;
+	uint32_t *wbuf, *rbuf;
+	uint32_t handle, len, prev_len;
+	double mib_s;
+
+	wbuf = malloc(chunk_size);
+	rbuf = malloc(chunk_size);
+	assert(wbuf && rbuf);
+
+	handle = gem_create(fd, obj_size);
+
+	prev_ofs = 0;
+	prev_len = 0;
+	gettimeofday(&start, NULL);
+	for (ofs = 0; ofs < obj_size; ofs += len) {
+		len = chunk_size;
+		if (obj_size - ofs < len)
+			len = obj_size - ofs;
+
+		/* the pattern is keyed on the object offset, so every
+		 * chunk is distinct and a misdirected write can't match */
+		intel_pattern_fill(wbuf, handle, ofs >> 2, len / 4);
+		gem_write(fd, handle, ofs, wbuf, len);
+
+		/* the verify trails the stream by one chunk, so the
+		 * readback of chunk N runs against the churn caused by
+		 * queueing chunk N+1 rather than on a quiesced object */
+		if (ofs) {
+			gem_read(fd, handle, prev_ofs, rbuf, prev_len);
+			assert(intel_pattern_check(rbuf, handle, prev_ofs >> 2,
+						   prev_len / 4) ==
+			       prev_len / 4);
+		}
+		prev_ofs = ofs;
+		prev_len = len;
+	}
+	gem_read(fd, handle, prev_ofs, rbuf, prev_len);
+	assert(intel_pattern_check(rbuf, handle, prev_ofs >> 2,
+				   prev_len / 4) == prev_len / 4);
+	gettimeofday(&end, NULL);
+
+	gem_close(fd, handle);
+
+	/* both directions count: obj_size written and read back */
+	mib_s = 2. * obj_size / stream_elapsed_us(&start, &end) *
+		1e6 / (1024 * 1024);
+	printf("%4llu MiB object (%s mappable), %u MiB chunks: %.1f MiB/s\n",
+	       (unsigned long long)(obj_size >> 20),
+	       obj_size > mappable ? "above" : "below",
+	       chunk_size >> 20, mib_s);
+	fflush(stdout);
+
+	free(wbuf);
+	free(rbuf);
+}
+
+static void test_streaming(int fd, uint32_t chunk_size)
+{
+	uint64_t mappable = gem_mappable_aperture_size();
+	uint64_t limit = gem_aperture_size(fd) * 3 / 4;
+	static const int quarters[] = { 1, 2, 3, 4, 5, 6, 8 };
+	uint64_t obj_size;
+	unsigned i;
+
+	printf("mappable aperture %llu MiB, total %llu MiB\n",
+	       (unsigned long long)(mappable >> 20),
+	       (unsigned long long)(gem_aperture_size(fd) >> 20));
+
+	/* walk the object size across the mappable-aperture boundary to
+	 * expose the bandwidth cliff once the object no longer fits */
+	for (i = 0; i < sizeof(quarters) / sizeof(quarters[0]); i++) {
+		obj_size = mappable / 4 * quarters[i];
+		if (obj_size > limit)
+			break;
+		stream_object(fd, obj_size, chunk_size, mappable);
+	}
+}
+
 int main(int argc, char **argv)
 {
+	uint32_t chunk_size = 0;
+	int stream = 0, argi = 1;
 	int fd;
 
+	if (argc > argi && strcmp(argv[argi], "-s") == 0) {
+		stream = 1;
+		argi++;
+	}
+	if (argc > argi)
+		chunk_size = atoi(argv[argi]) * 1024 * 1024;
+	if (chunk_size == 0)
+		chunk_size = STREAM_CHUNK_SIZE;
+
 	fd = drm_open_any();
 
-	test_large_object(fd);
+	if (stream)
+		test_streaming(fd, chunk_size);
+	else
+		test_large_object(fd);
 
 	return 0;
 }
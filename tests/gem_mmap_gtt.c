@@ -33,9 +33,11 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/time.h>
 #include "drm.h"
 #include "i915_drm.h"
 #include "drmtest.h"
@@ -144,6 +146,135 @@ test_read(int fd)
 	munmap(dst, OBJECT_SIZE);
 }
 
+/* Same copy as test_copy(), but through the lib's mapping cache the
+ * way a production client would: the second round of copies must come
+ * back as cache hits (identical pointers, no refault), so this covers
+ * the reuse profile the map-unmap-every-cycle tests above never see. */
+static void
+test_copy_cached(int fd)
+{
+	uint32_t src, dst;
+	void *src_ptr, *dst_ptr, *again;
+	int round;
+
+	src = gem_create(fd, OBJECT_SIZE);
+	dst = gem_create(fd, OBJECT_SIZE);
+
+	for (round = 0; round < 2; round++) {
+		src_ptr = gem_mmap_cached__gtt(fd, src, OBJECT_SIZE,
+					       PROT_READ | PROT_WRITE);
+		dst_ptr = gem_mmap_cached__gtt(fd, dst, OBJECT_SIZE,
+					       PROT_READ | PROT_WRITE);
+		assert(src_ptr && dst_ptr);
+
+		memcpy(dst_ptr, src_ptr, OBJECT_SIZE);
+		memcpy(src_ptr, dst_ptr, OBJECT_SIZE);
+
+		gem_munmap_cached(src_ptr, OBJECT_SIZE);
+		gem_munmap_cached(dst_ptr, OBJECT_SIZE);
+	}
+
+	/* deferred unmap means a re-request is a hit */
+	again = gem_mmap_cached__gtt(fd, src, OBJECT_SIZE,
+				     PROT_READ | PROT_WRITE);
+	assert(again == src_ptr);
+	gem_munmap_cached(again, OBJECT_SIZE);
+
+	/* handles are about to be recycled */
+	gem_mmap_cache_flush();
+	gem_close(fd, src);
+	gem_close(fd, dst);
+}
+
+/* Fault storm: T threads each take a private GTT mapping of the same
+ * bo and fault disjoint page ranges at the same time, so the kernel's
+ * GTT fault path is hit concurrently instead of in single-threaded
+ * order like the copy tests above.  Faults/sec per thread count shows
+ * how the fault handler's locking scales. */
+#define STORM_MAX_THREADS 16
+#define PAGE_SIZE 4096
+
+struct storm_arg {
+	int fd;
+	uint32_t handle;
+	int start_page, num_pages;
+};
+
+static void *
+storm_thread(void *data)
+{
+	struct storm_arg *arg = data;
+	volatile uint32_t *ptr;
+	char *map;
+	int i;
+
+	map = gem_mmap__gtt(arg->fd, arg->handle, OBJECT_SIZE,
+			    PROT_READ | PROT_WRITE);
+	assert(map != MAP_FAILED && map != NULL);
+
+	for (i = 0; i < arg->num_pages; i++) {
+		ptr = (volatile uint32_t *)
+			(map + (arg->start_page + i) * PAGE_SIZE);
+		*ptr = i;
+	}
+
+	munmap(map, OBJECT_SIZE);
+
+	return NULL;
+}
+
+static void
+test_fault_storm(int fd)
+{
+	int num_pages = OBJECT_SIZE / PAGE_SIZE;
+	struct storm_arg args[STORM_MAX_THREADS];
+	pthread_t threads[STORM_MAX_THREADS];
+	double base_rate = 0.0;
+	int max_threads, t, i;
+
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (max_threads > STORM_MAX_THREADS)
+		max_threads = STORM_MAX_THREADS;
+	if (max_threads < 1)
+		max_threads = 1;
+
+	for (t = 1; t <= max_threads; t *= 2) {
+		struct timeval start, end;
+		uint32_t handle;
+		double secs, rate;
+
+		/* fresh bo, so every page really faults */
+		handle = gem_create(fd, OBJECT_SIZE);
+
+		for (i = 0; i < t; i++) {
+			args[i].fd = fd;
+			args[i].handle = handle;
+			args[i].start_page = i * (num_pages / t);
+			args[i].num_pages = num_pages / t;
+		}
+		args[t - 1].num_pages = num_pages - args[t - 1].start_page;
+
+		gettimeofday(&start, NULL);
+		for (i = 0; i < t; i++)
+			assert(pthread_create(&threads[i], NULL,
+					      storm_thread, &args[i]) == 0);
+		for (i = 0; i < t; i++)
+			pthread_join(threads[i], NULL);
+		gettimeofday(&end, NULL);
+
+		gem_close(fd, handle);
+
+		secs = end.tv_sec - start.tv_sec +
+			(end.tv_usec - start.tv_usec) / 1e6;
+		rate = num_pages / secs;
+		if (t == 1)
+			base_rate = rate;
+		printf("fault-storm: %2d threads: %.0f faults/s "
+		       "(%.2fx of single thread)\n",
+		       t, rate, rate / base_rate);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	int fd;
@@ -154,12 +285,16 @@ int main(int argc, char **argv)
 
 	if (drmtest_run_subtest("copy"))
 		test_copy(fd);
+	if (drmtest_run_subtest("copy-cached"))
+		test_copy_cached(fd);
 	if (drmtest_run_subtest("read"))
 		test_read(fd);
 	if (drmtest_run_subtest("write"))
 		test_write(fd);
 	if (drmtest_run_subtest("write-gtt"))
 		test_write_gtt(fd);
+	if (drmtest_run_subtest("fault-storm"))
+		test_fault_storm(fd);
 
 	close(fd);
 
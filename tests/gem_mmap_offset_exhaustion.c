@@ -42,6 +42,12 @@
 
 #define OBJECT_SIZE (1024*1024)
 
+/* we have 32bit of address space, so try to fit one MB more
+ * than that. */
+#define NUM_OBJECTS (4096 + 1)
+
+static uint32_t handles[NUM_OBJECTS];
+
 /* Testcase: checks whether the kernel handles mmap offset exhaustion correctly
  *
  * Currently the kernel doesn't reap the mmap offset of purged objects, albeit
@@ -53,13 +59,10 @@
  */
 
 static void
-create_and_map_bo(int fd)
+map_bo(int fd, uint32_t handle)
 {
-	uint32_t handle;
 	char *ptr;
 
-	handle = gem_create(fd, OBJECT_SIZE);
-
 	ptr = gem_mmap(fd, handle, OBJECT_SIZE, PROT_READ | PROT_WRITE);
 
 	if (!ptr) {
@@ -85,10 +88,12 @@ int main(int argc, char **argv)
 
 	fd = drm_open_any();
 
-	/* we have 32bit of address space, so try to fit one MB more
-	 * than that. */
-	for (i = 0; i < 4096 + 1; i++)
-		create_and_map_bo(fd);
+	/* batch the object creation so the test spends its time
+	 * exhausting mmap offsets, not looping over create ioctls */
+	gem_create_bulk(fd, OBJECT_SIZE, handles, NUM_OBJECTS);
+
+	for (i = 0; i < NUM_OBJECTS; i++)
+		map_bo(fd, handles[i]);
 
 	close(fd);
 
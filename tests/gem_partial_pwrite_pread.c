@@ -253,18 +253,142 @@ static void test_partial_read_writes(void)
 	}
 }
 
-int main(int argc, char **argv)
+/* Upload-strategy sweep: for each access size from 64 bytes to the
+ * full 1MiB bo, at cacheline-aligned and deliberately misaligned
+ * offsets, measure pwrite/pread against mapped gtt access.  Whether
+ * pwrite or a gtt map wins flips with transfer size and with LLC
+ * (gen6+) vs non-LLC parts, so userspace picking a path per transfer
+ * size needs this table rather than a guess. */
+#define SWEEP_BO_SIZE (1024*1024)
+
+static drm_intel_bo *sweep_bo;
+static uint8_t *sweep_tmp;
+
+enum sweep_op {
+	OP_PWRITE,
+	OP_PREAD,
+	OP_GTT_WRITE,
+	OP_GTT_READ,
+	NUM_SWEEP_OPS,
+};
+
+static int sweep_ops(int size)
 {
-	srandom(0xdeadbeef);
+	int ops = (64*1024*1024) / size;
 
-	drmtest_subtest_init(argc, argv);
+	if (ops > 4096)
+		ops = 4096;
+	if (ops < 8)
+		ops = 8;
+
+	return ops;
+}
+
+static void sweep_access(enum sweep_op op, int ofs, int size)
+{
+	switch (op) {
+	case OP_PWRITE:
+		drm_intel_bo_subdata(sweep_bo, ofs, size, sweep_tmp);
+		break;
+	case OP_PREAD:
+		drm_intel_bo_get_subdata(sweep_bo, ofs, size, sweep_tmp);
+		break;
+	case OP_GTT_WRITE:
+		memcpy((uint8_t *)sweep_bo->virtual + ofs, sweep_tmp, size);
+		break;
+	case OP_GTT_READ:
+		memcpy(sweep_tmp, (uint8_t *)sweep_bo->virtual + ofs, size);
+		break;
+	default:
+		break;
+	}
+}
+
+static double time_access(enum sweep_op op, int size, int align, int ops)
+{
+	struct timeval start, end;
+	int range = SWEEP_BO_SIZE - size - align;
+	int mapped = op == OP_GTT_WRITE || op == OP_GTT_READ;
+	int i, ofs;
+
+	if (mapped)
+		drm_intel_gem_bo_map_gtt(sweep_bo);
+
+	/* fault in mappings and prime the kernel's shmem pages */
+	for (i = 0; i < ops / 16 + 1; i++)
+		sweep_access(op, align, size);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ops; i++) {
+		/* walk the bo page-wise so we don't just replay one
+		 * cache-hot page for the small sizes */
+		ofs = align;
+		if (range >= 4096)
+			ofs += (i % (range >> 12)) << 12;
+		sweep_access(op, ofs, size);
+	}
+	gettimeofday(&end, NULL);
 
-	fd = drm_open_any();
+	if (mapped)
+		drm_intel_gem_bo_unmap_gtt(sweep_bo);
 
-	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	return (end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1e6;
+}
+
+static void test_access_sweep(void)
+{
+	static const int aligns[] = { 0, 63 };
+	static const char *names[NUM_SWEEP_OPS] = {
+		"pwrite", "pread", "gtt-write", "gtt-read"
+	};
+	unsigned a;
+	int size, op;
+
+	sweep_bo = drm_intel_bo_alloc(bufmgr, "sweep bo", SWEEP_BO_SIZE, 4096);
+	sweep_tmp = malloc(SWEEP_BO_SIZE + 64);
+	assert(sweep_tmp);
+	memset(sweep_tmp, 0x5a, SWEEP_BO_SIZE + 64);
+
+	printf("access sweep on gen%d (devid 0x%04x), MiB/s and us/op:\n",
+	       intel_gen(devid), devid);
+	printf("%8s %5s", "size", "align");
+	for (op = 0; op < NUM_SWEEP_OPS; op++)
+		printf(" %16s", names[op]);
+	printf("\n");
+
+	for (size = 64; size <= SWEEP_BO_SIZE; size <<= 2) {
+		for (a = 0; a < sizeof(aligns)/sizeof(aligns[0]); a++) {
+			int align = size + aligns[a] > SWEEP_BO_SIZE ?
+				0 : aligns[a];
+
+			printf("%8d %5d", size, align);
+			for (op = 0; op < NUM_SWEEP_OPS; op++) {
+				int ops = sweep_ops(size);
+				double secs = time_access(op, size, align, ops);
+
+				printf(" %8.0f/%-7.2f",
+				       (double)size * ops / secs / (1024*1024),
+				       secs * 1e6 / ops);
+			}
+			printf("\n");
+
+			if (align == 0 && aligns[a] != 0)
+				break;
+		}
+	}
+
+	drm_intel_bo_unreference(sweep_bo);
+	free(sweep_tmp);
+}
+
+static void setup(void)
+{
+	fd = drmtest_fixture_fd();
+	devid = drmtest_fixture_devid();
+	bufmgr = drmtest_fixture_bufmgr();
 	//drm_intel_bufmgr_gem_enable_reuse(bufmgr);
-	devid = intel_get_drm_devid(fd);
-	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	batch = drmtest_fixture_batch();
 
 	/* overallocate the buffers we're actually using because */
 	scratch_bo = drm_intel_bo_alloc(bufmgr, "scratch bo", BO_SIZE, 4096);
@@ -272,6 +396,16 @@ int main(int argc, char **argv)
 
 	drmtest_init_aperture_trashers(bufmgr);
 	mappable_gtt_limit = gem_mappable_aperture_size();
+}
+
+int main(int argc, char **argv)
+{
+	srandom(0xdeadbeef);
+
+	drmtest_subtest_init(argc, argv);
+
+	if (!drmtest_only_list_subtests())
+		setup();
 
 	if (drmtest_run_subtest("reads"))
 		test_partial_reads();
@@ -282,10 +416,12 @@ int main(int argc, char **argv)
 	if (drmtest_run_subtest("writes-after-reads"))
 		test_partial_read_writes();
 
-	drmtest_cleanup_aperture_trashers();
-	drm_intel_bufmgr_destroy(bufmgr);
+	if (drmtest_run_subtest("sweep"))
+		test_access_sweep();
 
-	close(fd);
+	if (!drmtest_only_list_subtests())
+		drmtest_cleanup_aperture_trashers();
+	drmtest_fixture_fini();
 
 	return 0;
 }
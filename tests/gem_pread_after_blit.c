@@ -124,6 +124,65 @@ verify_small_read(drm_intel_bo *bo, uint32_t val)
 	}
 }
 
+/* Double-buffered readback: while the gpu blits frame N+1 into one dst,
+ * the cpu preads and verifies frame N out of the other.  The pread of a
+ * busy bo still waits for its own blit, but the next frame's blit runs
+ * concurrently with the verify - the overlap a screenshot service gets
+ * for free once it stops reusing a single dst. */
+#define PIPELINE_FRAMES 64
+
+static double
+now_seconds(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void
+pipeline_mode(drm_intel_bo *src1, drm_intel_bo *src2,
+	      uint32_t start1, uint32_t start2)
+{
+	drm_intel_bo *dst[2];
+	double start, t_serial, t_pipe;
+	int i;
+
+	dst[0] = drm_intel_bo_alloc(bufmgr, "dst bo 0", size, 4096);
+	dst[1] = drm_intel_bo_alloc(bufmgr, "dst bo 1", size, 4096);
+
+	/* serial baseline: single dst, read right behind each blit */
+	start = now_seconds();
+	for (i = 0; i < PIPELINE_FRAMES; i++) {
+		intel_copy_bo(batch, dst[0], (i & 1) ? src2 : src1,
+			      width, height);
+		verify_large_read(dst[0], (i & 1) ? start2 : start1);
+	}
+	t_serial = now_seconds() - start;
+
+	start = now_seconds();
+	intel_copy_bo(batch, dst[0], src1, width, height);
+	for (i = 1; i < PIPELINE_FRAMES; i++) {
+		/* queue frame i, then verify frame i-1 while it runs */
+		intel_copy_bo(batch, dst[i & 1], (i & 1) ? src2 : src1,
+			      width, height);
+		verify_large_read(dst[(i - 1) & 1],
+				  ((i - 1) & 1) ? start2 : start1);
+	}
+	i = PIPELINE_FRAMES - 1;
+	verify_large_read(dst[i & 1], (i & 1) ? start2 : start1);
+	t_pipe = now_seconds() - start;
+
+	printf("serial:    %.1f MiB/s\n",
+	       PIPELINE_FRAMES * (double)size / t_serial / (1024 * 1024));
+	printf("pipelined: %.1f MiB/s\n",
+	       PIPELINE_FRAMES * (double)size / t_pipe / (1024 * 1024));
+	printf("overlap efficiency: %.2fx\n", t_serial / t_pipe);
+
+	drm_intel_bo_unreference(dst[0]);
+	drm_intel_bo_unreference(dst[1]);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -141,6 +200,17 @@ main(int argc, char **argv)
 	src1 = create_bo(start1);
 	src2 = create_bo(start2);
 
+	if (argc > 1 && strcmp(argv[1], "-p") == 0) {
+		pipeline_mode(src1, src2, start1, start2);
+
+		drm_intel_bo_unreference(src1);
+		drm_intel_bo_unreference(src2);
+		intel_batchbuffer_free(batch);
+		drm_intel_bufmgr_destroy(bufmgr);
+		close(fd);
+		return 0;
+	}
+
 	bo = drm_intel_bo_alloc(bufmgr, "dst bo", size, 4096);
 
 	/* First, do a full-buffer read after blitting */
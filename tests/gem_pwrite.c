@@ -83,6 +83,147 @@ static const char *bytes_per_sec(char *buf, double v)
 	return buf;
 }
 
+#define PLACEMENT_LOOPS (1<<14)
+
+#define BENCH_MAX_SIZE (16*1024*1024)
+#define BENCH_TARGET (64*1024*1024)
+#define BENCH_PASSES 4
+
+static double bench_object(int fd, void *src, int object_size, int chunk_size,
+			   int cacheing, double *spread)
+{
+	struct timeval start, end;
+	double pass[BENCH_PASSES], mean = 0, min, max;
+	uint32_t handle;
+	int loops, n, i, ofs;
+
+	handle = gem_create(fd, object_size);
+	if (cacheing >= 0)
+		gem_set_cacheing(fd, handle, cacheing);
+
+	/* repeat small objects until each pass moves a fixed volume, so
+	 * the timer resolution doesn't dominate the short end of the sweep */
+	loops = BENCH_TARGET / object_size;
+	if (loops < 1)
+		loops = 1;
+
+	/* untimed warmup to allocate the backing pages */
+	for (ofs = 0; ofs < object_size; ofs += chunk_size)
+		gem_write(fd, handle, ofs, (char *)src + ofs, chunk_size);
+
+	for (n = 0; n < BENCH_PASSES; n++) {
+		gettimeofday(&start, NULL);
+		for (i = 0; i < loops; i++)
+			for (ofs = 0; ofs < object_size; ofs += chunk_size)
+				gem_write(fd, handle, ofs,
+					  (char *)src + ofs, chunk_size);
+		gettimeofday(&end, NULL);
+		pass[n] = loops * (double)object_size /
+			elapsed(&start, &end, 1) * 1e6;
+		mean += pass[n];
+	}
+	gem_close(fd, handle);
+
+	mean /= BENCH_PASSES;
+	min = max = pass[0];
+	for (n = 1; n < BENCH_PASSES; n++) {
+		if (pass[n] < min)
+			min = pass[n];
+		if (pass[n] > max)
+			max = pass[n];
+	}
+	*spread = 100. * (max - min) / mean;
+
+	return mean;
+}
+
+static void sweep_throughput(int fd, int max_size, int cacheing)
+{
+	int object_size, chunk_size;
+	double bw, spread;
+	char buf[80];
+	void *src;
+
+	src = malloc(max_size);
+	assert(src);
+	memset(src, 0xc5, max_size);
+
+	if (cacheing >= 0)
+		printf("pwrite bandwidth, cacheing level %d:\n", cacheing);
+	else
+		printf("pwrite bandwidth, default cacheing:\n");
+
+	for (object_size = 4096; object_size <= max_size; object_size <<= 2) {
+		for (chunk_size = 4096; chunk_size <= object_size; chunk_size <<= 2) {
+			bw = bench_object(fd, src, object_size, chunk_size,
+					  cacheing, &spread);
+			printf("%8d bytes in %8d byte chunks:	%s (spread %.1f%%)\n",
+			       object_size, chunk_size,
+			       bytes_per_sec(buf, bw), spread);
+			fflush(stdout);
+		}
+	}
+
+	free(src);
+}
+
+static double run_placement(int fd, void *src, int object_size)
+{
+	struct timeval start, end;
+	uint32_t handle;
+
+	/* fresh bo so its pages get allocated under the current policy */
+	handle = gem_create(fd, object_size);
+	do_gem_write(fd, handle, src, object_size, PLACEMENT_LOOPS);
+	gettimeofday(&start, NULL);
+	do_gem_write(fd, handle, src, object_size, PLACEMENT_LOOPS);
+	gettimeofday(&end, NULL);
+	gem_close(fd, handle);
+
+	return object_size / elapsed(&start, &end, PLACEMENT_LOOPS) * 1e6;
+}
+
+static void sweep_placements(int fd, int object_size)
+{
+	int nodes = drmtest_numa_num_nodes();
+	char buf[80];
+	void *src;
+	int node;
+
+	if (nodes < 2) {
+		printf("single NUMA node, nothing to sweep\n");
+		return;
+	}
+
+	/* mmap rather than malloc so mbind() can retarget the pages */
+	src = mmap(NULL, object_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(src != MAP_FAILED);
+
+	assert(drmtest_numa_local() == 0);
+	printf("Time to pwrite %d bytes, local alloc:	%s\n", object_size,
+	       bytes_per_sec(buf, run_placement(fd, src, object_size)));
+
+	for (node = 0; node < nodes; node++) {
+		if (drmtest_numa_bind_node(node) ||
+		    drmtest_numa_bind_pages(src, object_size, node)) {
+			printf("binding to node %d failed, skipping\n", node);
+			continue;
+		}
+		printf("Time to pwrite %d bytes, node %d:	%s\n",
+		       object_size, node,
+		       bytes_per_sec(buf, run_placement(fd, src, object_size)));
+	}
+
+	if (drmtest_numa_interleave() == 0 &&
+	    drmtest_numa_interleave_pages(src, object_size) == 0)
+		printf("Time to pwrite %d bytes, interleaved:	%s\n",
+		       object_size,
+		       bytes_per_sec(buf, run_placement(fd, src, object_size)));
+
+	drmtest_numa_local();
+	munmap(src, object_size);
+}
 
 int main(int argc, char **argv)
 {
@@ -90,15 +231,43 @@ int main(int argc, char **argv)
 	uint32_t buf[20];
 	uint32_t *src, dst;
 	int fd, count;
+	int sweep = 0, bench = 0, cacheing = -1, argi = 1;
 
-	if (argc > 1)
-		object_size = atoi(argv[1]);
+	while (argc > argi && argv[argi][0] == '-') {
+		if (strcmp(argv[argi], "-p") == 0)
+			sweep = 1;
+		else if (strcmp(argv[argi], "-b") == 0)
+			bench = 1;
+		else if (strcmp(argv[argi], "-c") == 0 && argc > argi + 1)
+			cacheing = atoi(argv[++argi]);
+		argi++;
+	}
+	if (argc > argi)
+		object_size = atoi(argv[argi]);
+	if (bench && object_size == 0)
+		object_size = BENCH_MAX_SIZE;
 	if (object_size == 0)
 		object_size = OBJECT_SIZE;
 	object_size = (object_size + 3) & -4;
 
 	fd = drm_open_any();
 
+	if (bench) {
+		if (cacheing >= 0 && !gem_has_cacheing(fd)) {
+			printf("no set_cacheing support, ignoring -c\n");
+			cacheing = -1;
+		}
+		sweep_throughput(fd, object_size, cacheing);
+		close(fd);
+		return 0;
+	}
+
+	if (sweep) {
+		sweep_placements(fd, object_size);
+		close(fd);
+		return 0;
+	}
+
 	dst = gem_create(fd, object_size);
 	src = malloc(object_size);
 	for (count = 1; count <= 1<<17; count <<= 1) {
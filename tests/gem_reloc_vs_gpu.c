@@ -140,6 +140,125 @@ static void emit_dummy_load(int pitch)
 	intel_batchbuffer_flush(batch);
 }
 
+/*
+ * Reloc-storm mode (-s): real captures hand the kernel execbufs with
+ * pathological relocation counts, and we need the shape of the kernel's
+ * reloc-processing curve before filing bugs against it.  All entries
+ * live in one preallocated arena and reference a variable number of
+ * distinct targets, so the sweep covers both count and duplication
+ * ratio.  A dummy load keeps the GPU busy while each storm is
+ * submitted, as in the race test proper; with the engine occupied the
+ * execbuf ioctl time is dominated by relocation processing.  The batch
+ * is a single MI_BATCH_BUFFER_END with every patched dword behind it,
+ * so the storm is never executed, only relocated.
+ */
+
+#define STORM_MAX_RELOCS (256*1024)
+#define STORM_MAX_TARGETS 4096
+#define STORM_ITERS 4
+
+static double storm_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+static void storm_mode(int fd, int ring, int pitch)
+{
+	static const int counts[] = { 1024, 8192, 65536, STORM_MAX_RELOCS };
+	static const int dup_targets[] = { 1, 64, STORM_MAX_TARGETS };
+	struct drm_i915_gem_relocation_entry *relocs;
+	struct drm_i915_gem_exec_object2 *objs;
+	struct drm_i915_gem_execbuffer2 execbuf;
+	uint32_t bbe[2] = { MI_BATCH_BUFFER_END };
+	uint32_t *targets;
+	uint32_t handle;
+	unsigned c, t;
+	int i;
+
+	relocs = malloc(STORM_MAX_RELOCS * sizeof(*relocs));
+	objs = malloc((STORM_MAX_TARGETS + 1) * sizeof(*objs));
+	targets = malloc(STORM_MAX_TARGETS * sizeof(*targets));
+	assert(relocs && objs && targets);
+
+	/* big enough that every reloc patches a distinct dword */
+	handle = gem_create(fd, STORM_MAX_RELOCS * 4 + 4096);
+	gem_write(fd, handle, 0, bbe, sizeof(bbe));
+
+	for (i = 0; i < STORM_MAX_TARGETS; i++)
+		targets[i] = gem_create(fd, 4096);
+
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		for (t = 0; t < sizeof(dup_targets) / sizeof(dup_targets[0]); t++) {
+			int count = counts[c];
+			int ntargets = dup_targets[t];
+			double total_us = 0;
+			int iter;
+
+			if (ntargets > count)
+				continue;
+
+			for (i = 0; i < ntargets; i++) {
+				memset(&objs[i], 0, sizeof(objs[i]));
+				objs[i].handle = targets[i];
+			}
+			memset(&objs[ntargets], 0, sizeof(objs[ntargets]));
+			objs[ntargets].handle = handle;
+			objs[ntargets].relocation_count = count;
+			objs[ntargets].relocs_ptr = (uintptr_t)relocs;
+
+			memset(&execbuf, 0, sizeof(execbuf));
+			execbuf.buffers_ptr = (uintptr_t)objs;
+			execbuf.buffer_count = ntargets + 1;
+			execbuf.batch_len = 8;
+			execbuf.flags = ring;
+			i915_execbuffer2_set_context_id(execbuf, 0);
+
+			/* -1 warmup iteration settles target placement */
+			for (iter = -1; iter < STORM_ITERS; iter++) {
+				double t_us;
+
+				/* stale presumed offsets force the full
+				 * lookup-and-patch path every time */
+				for (i = 0; i < count; i++) {
+					relocs[i].target_handle =
+						targets[i % ntargets];
+					relocs[i].delta = 0;
+					relocs[i].offset = 8 + 4 * (uint32_t)i;
+					relocs[i].presumed_offset = -1;
+					relocs[i].read_domains =
+						I915_GEM_DOMAIN_RENDER;
+					relocs[i].write_domain = 0;
+				}
+
+				emit_dummy_load(pitch);
+
+				t_us = storm_time_us();
+				do_ioctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2,
+					 &execbuf);
+				if (iter >= 0)
+					total_us += storm_time_us() - t_us;
+			}
+
+			printf("storm: relocs=%6d targets=%4d (dup %5dx): "
+			       "%8.2fms/execbuf, %8.0f relocs/sec\n",
+			       count, ntargets, count / ntargets,
+			       total_us / STORM_ITERS / 1000.,
+			       count * STORM_ITERS * 1e6 / total_us);
+		}
+	}
+
+	for (i = 0; i < STORM_MAX_TARGETS; i++)
+		gem_close(fd, targets[i]);
+	gem_close(fd, handle);
+
+	free(targets);
+	free(objs);
+	free(relocs);
+}
+
 #define MAX_BLT_SIZE 128
 int main(int argc, char **argv)
 {
@@ -171,6 +290,17 @@ int main(int argc, char **argv)
 	else
 		ring = 0;
 
+	if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+		storm_mode(fd, ring, pitch);
+
+		drm_intel_bo_unreference(special_bo);
+		drm_intel_bo_unreference(dummy_bo);
+		intel_batchbuffer_free(batch);
+		drm_intel_bufmgr_destroy(bufmgr);
+		close(fd);
+		return 0;
+	}
+
 	for (i = 0; i < NUM_TARGET_BOS; i++) {
 		pc_target_bo[i] = drm_intel_bo_alloc(bufmgr, "special batch", 4096, 4096);
 		emit_dummy_load(pitch);
@@ -34,6 +34,9 @@
  */
 
 #include "rendercopy.h"
+#include "intel_arena.h"
+#include "intel_crc32c.h"
+#include "intel_verify.h"
 
 #define WIDTH 512
 #define STRIDE (WIDTH*4)
@@ -42,13 +45,41 @@
 
 static uint32_t linear[WIDTH*HEIGHT];
 static render_copyfunc_t render_copy;
+static render_multi_copyfunc_t multi_copy;
+
+/* Fill one batch worth of independent copies: op k blits
+ * buf[base+2k] -> buf[base+2k+1] (mod count), so no op's destination
+ * feeds another op in the same unflushed batch.  Updates start_val to
+ * track the pattern movement and returns the next base index. */
+static int
+prepare_ops(struct render_copy_op *ops, int depth, int base, int count,
+	    struct scratch_buf *buf, uint32_t *start_val)
+{
+	int k, s, d;
+
+	for (k = 0; k < depth; k++) {
+		s = (base + 2 * k) % count;
+		d = (base + 2 * k + 1) % count;
+
+		ops[k].src = &buf[s];
+		ops[k].dst = &buf[d];
+		ops[k].src_x = ops[k].src_y = 0;
+		ops[k].dst_x = ops[k].dst_y = 0;
+		ops[k].width = WIDTH;
+		ops[k].height = HEIGHT;
+
+		start_val[d] = start_val[s];
+	}
+
+	return (base + 2 * depth) % count;
+}
 
 static void
-check_bo(int fd, uint32_t handle, uint32_t val)
+check_bo(int fd, struct scratch_buf *buf, uint32_t val)
 {
 	int i;
 
-	gem_read(fd, handle, 0, linear, sizeof(linear));
+	gem_read(fd, buf->bo->handle, buf->offset, linear, sizeof(linear));
 	for (i = 0; i < WIDTH*HEIGHT; i++) {
 		if (linear[i] != val) {
 			fprintf(stderr, "Expected 0x%08x, found 0x%08x "
@@ -64,8 +95,10 @@ int main(int argc, char **argv)
 {
 	drm_intel_bufmgr *bufmgr;
 	struct intel_batchbuffer *batch;
+	struct intel_arena *arena;
 	uint32_t *start_val;
-	drm_intel_bo **bo;
+	uint32_t *crc;
+	struct scratch_buf *buf;
 	uint32_t start = 0;
 	int i, j, fd, count;
 
@@ -87,85 +120,145 @@ int main(int argc, char **argv)
 		count = 3 * gem_aperture_size(fd) / SIZE / 2;
 	printf("Using %d 1MiB buffers\n", count);
 
-	bo = malloc(sizeof(*bo)*count);
+	buf = malloc(sizeof(*buf)*count);
 	start_val = malloc(sizeof(*start_val)*count);
+	crc = malloc(sizeof(*crc)*count);
+
+	/* carve the working set out of a few slab bos so setup is quick
+	 * and placement is identical from run to run */
+	arena = intel_arena_create(bufmgr, SIZE, 16, INTEL_ARENA_MAP_NONE);
 
 	for (i = 0; i < count; i++) {
-		bo[i] = drm_intel_bo_alloc(bufmgr, "", SIZE, 4096);
+		intel_arena_get_buf(arena, &buf[i]);
+		buf[i].stride = STRIDE;
+		buf[i].size = SIZE;
 		start_val[i] = start;
 		for (j = 0; j < WIDTH*HEIGHT; j++)
 			linear[j] = start++;
-		gem_write(fd, bo[i]->handle, 0, linear, sizeof(linear));
+		/* every pattern is written exactly once, so its crc can be
+		 * taken from the staging buffer on the way in */
+		crc[i] = intel_crc32c(0, linear, sizeof(linear));
+		gem_write(fd, buf[i].bo->handle, buf[i].offset,
+			  linear, sizeof(linear));
 	}
 
+	/* post-blit checks run asynchronously; a bo holds pattern n iff
+	 * start_val points at pattern n's first value */
+	intel_verify_init(fd, 2, 8);
+
 	printf("Verifying initialisation...\n");
 	for (i = 0; i < count; i++)
-		check_bo(fd, bo[i]->handle, start_val[i]);
+		check_bo(fd, &buf[i], start_val[i]);
 
 	printf("Cyclic blits, forward...\n");
 	for (i = 0; i < count * 4; i++) {
-		struct scratch_buf src, dst;
-
-		src.bo = bo[i % count];
-		src.stride = STRIDE;
-		src.tiling = I915_TILING_NONE;
-		src.size = SIZE;
-
-		dst.bo = bo[(i + 1) % count];
-		dst.stride = STRIDE;
-		dst.tiling = I915_TILING_NONE;
-		dst.size = SIZE;
-
-		render_copy(batch, &src, 0, 0, WIDTH, HEIGHT, &dst, 0, 0);
+		render_copy(batch, &buf[i % count], 0, 0, WIDTH, HEIGHT,
+			    &buf[(i + 1) % count], 0, 0);
 		start_val[(i + 1) % count] = start_val[i % count];
 	}
 	for (i = 0; i < count; i++)
-		check_bo(fd, bo[i]->handle, start_val[i]);
+		intel_verify_queue(buf[i].bo, buf[i].offset, sizeof(linear),
+				   crc[start_val[i] / (WIDTH*HEIGHT)],
+				   INTEL_VERIFY_PREAD);
+	intel_verify_drain();
 
 	printf("Cyclic blits, backward...\n");
 	for (i = 0; i < count * 4; i++) {
-		struct scratch_buf src, dst;
-
-		src.bo = bo[(i + 1) % count];
-		src.stride = STRIDE;
-		src.tiling = I915_TILING_NONE;
-		src.size = SIZE;
-
-		dst.bo = bo[i % count];
-		dst.stride = STRIDE;
-		dst.tiling = I915_TILING_NONE;
-		dst.size = SIZE;
-
-		render_copy(batch, &src, 0, 0, WIDTH, HEIGHT, &dst, 0, 0);
+		render_copy(batch, &buf[(i + 1) % count], 0, 0, WIDTH, HEIGHT,
+			    &buf[i % count], 0, 0);
 		start_val[i % count] = start_val[(i + 1) % count];
 	}
 	for (i = 0; i < count; i++)
-		check_bo(fd, bo[i]->handle, start_val[i]);
+		intel_verify_queue(buf[i].bo, buf[i].offset, sizeof(linear),
+				   crc[start_val[i] / (WIDTH*HEIGHT)],
+				   INTEL_VERIFY_PREAD);
+	intel_verify_drain();
 
 	printf("Random blits...\n");
 	for (i = 0; i < count * 4; i++) {
-		struct scratch_buf src, dst;
 		int s = random() % count;
 		int d = random() % count;
 
 		if (s == d)
 			continue;
 
-		src.bo = bo[s];
-		src.stride = STRIDE;
-		src.tiling = I915_TILING_NONE;
-		src.size = SIZE;
-
-		dst.bo = bo[d];
-		dst.stride = STRIDE;
-		dst.tiling = I915_TILING_NONE;
-		dst.size = SIZE;
-
-		render_copy(batch, &src, 0, 0, WIDTH, HEIGHT, &dst, 0, 0);
+		render_copy(batch, &buf[s], 0, 0, WIDTH, HEIGHT,
+			    &buf[d], 0, 0);
 		start_val[d] = start_val[s];
 	}
 	for (i = 0; i < count; i++)
-		check_bo(fd, bo[i]->handle, start_val[i]);
+		intel_verify_queue(buf[i].bo, buf[i].offset, sizeof(linear),
+				   crc[start_val[i] / (WIDTH*HEIGHT)],
+				   INTEL_VERIFY_PREAD);
+	intel_verify_drain();
+
+	multi_copy = get_render_multi_copyfunc(intel_get_drm_devid(fd));
+	if (multi_copy && count >= 2 * RENDER_MULTI_MAX) {
+		static const int depths[] = { 1, 2, 4, 8 };
+		struct render_copy_op ops[RENDER_MULTI_MAX];
+		double rate[4];
+		struct timeval tv_start, tv_end;
+		double secs;
+		int base = 0;
+		int d, best, chosen, copies;
+
+		/* Measure how much of the per-copy cost is really
+		 * per-flush overhead by resubmitting the same workload
+		 * at increasing batch depths. */
+		printf("Batched blits, depth sweep...\n");
+		for (d = 0; d < 4; d++) {
+			copies = 0;
+			gettimeofday(&tv_start, NULL);
+			while (copies < count * 4) {
+				base = prepare_ops(ops, depths[d], base,
+						   count, buf, start_val);
+				copies += multi_copy(batch, ops, depths[d]);
+			}
+			/* the ring serialises batches, so the last
+			 * destination retiring means they all have */
+			gem_sync(fd, ops[depths[d] - 1].dst->bo->handle);
+			gettimeofday(&tv_end, NULL);
+
+			secs = tv_end.tv_sec - tv_start.tv_sec +
+				(tv_end.tv_usec - tv_start.tv_usec) / 1e6;
+			rate[d] = copies / secs;
+			printf("  depth %d: %.0f copies/sec\n",
+			       depths[d], rate[d]);
+		}
+
+		best = 0;
+		for (d = 1; d < 4; d++)
+			if (rate[d] > rate[best])
+				best = d;
+		/* deeper batches stop paying off once the flush overhead
+		 * is amortised; take the shallowest depth within 10% */
+		chosen = best;
+		for (d = 0; d < best; d++) {
+			if (rate[d] >= 0.9 * rate[best]) {
+				chosen = d;
+				break;
+			}
+		}
+		printf("  using depth %d\n", depths[chosen]);
+
+		printf("Batched blits, verified at depth %d...\n",
+		       depths[chosen]);
+		for (copies = 0; copies < count * 4; ) {
+			base = prepare_ops(ops, depths[chosen], base,
+					   count, buf, start_val);
+			copies += multi_copy(batch, ops, depths[chosen]);
+		}
+		for (i = 0; i < count; i++)
+			intel_verify_queue(buf[i].bo, buf[i].offset,
+					   sizeof(linear),
+					   crc[start_val[i] / (WIDTH*HEIGHT)],
+					   INTEL_VERIFY_PREAD);
+		intel_verify_drain();
+	} else if (multi_copy) {
+		printf("Batched blits skipped, too few buffers\n");
+	}
+
+	intel_verify_fini();
 
 	return 0;
 }
@@ -34,6 +34,7 @@
  */
 
 #include "rendercopy.h"
+#include "intel_fingerprint.h"
 
 #define WIDTH 512
 #define STRIDE (WIDTH*4)
@@ -43,13 +44,15 @@
 static render_copyfunc_t render_copy;
 
 static void
-check_bo(drm_intel_bo *bo, uint32_t val)
+check_bo(struct intel_batchbuffer *batch, drm_intel_bo *bo, uint32_t val)
 {
+	/* GPU-detile into a cached staging bo instead of streaming
+	 * uncached reads through the fenced GTT view */
+	static struct intel_readback readback;
 	uint32_t *ptr;
 	int i;
 
-	do_or_die(drm_intel_gem_bo_map_gtt(bo));
-	ptr = bo->virtual;
+	ptr = intel_readback_map(&readback, batch, bo, WIDTH, HEIGHT);
 	for (i = 0; i < WIDTH*HEIGHT; i++) {
 		if (ptr[i] != val) {
 			fprintf(stderr, "Expected 0x%08x, found 0x%08x "
@@ -59,7 +62,28 @@ check_bo(drm_intel_bo *bo, uint32_t val)
 		}
 		val++;
 	}
-	drm_intel_gem_bo_unmap_gtt(bo);
+	intel_readback_unmap(&readback);
+}
+
+/* 16 bytes of digest cross the bus per bo instead of the whole
+ * megabyte; on a mismatch rerun the full readback so the failure
+ * report still has the exact offset */
+static void
+check_fp(struct intel_batchbuffer *batch, struct scratch_buf *buf,
+	 const uint32_t expect[4], uint32_t val)
+{
+	uint32_t digest[4];
+
+	intel_fingerprint_bo(batch, buf->bo, WIDTH, HEIGHT, digest);
+	if (memcmp(digest, expect, 16) == 0)
+		return;
+
+	fprintf(stderr, "fingerprint mismatch: "
+		"%08x %08x %08x %08x, expected %08x %08x %08x %08x\n",
+		digest[0], digest[1], digest[2], digest[3],
+		expect[0], expect[1], expect[2], expect[3]);
+	check_bo(batch, buf->bo, val);
+	abort();
 }
 
 int main(int argc, char **argv)
@@ -67,6 +91,7 @@ int main(int argc, char **argv)
 	drm_intel_bufmgr *bufmgr;
 	struct intel_batchbuffer *batch;
 	uint32_t *start_val;
+	uint32_t (*fp)[4];
 	struct scratch_buf *buf;
 	uint32_t start = 0;
 	int i, j, fd, count;
@@ -92,6 +117,7 @@ int main(int argc, char **argv)
 
 	buf = malloc(sizeof(*buf)*count);
 	start_val = malloc(sizeof(*start_val)*count);
+	fp = malloc(sizeof(*fp)*count);
 
 	for (i = 0; i < count; i++) {
 		uint32_t tiling = I915_TILING_X + (random() & 1);
@@ -104,6 +130,7 @@ int main(int argc, char **argv)
 		buf[i].stride = pitch;
 		buf[i].tiling = tiling;
 		buf[i].size = SIZE;
+		buf[i].offset = 0;
 
 		start_val[i] = start;
 
@@ -111,12 +138,15 @@ int main(int argc, char **argv)
 		ptr = buf[i].bo->virtual;
 		for (j = 0; j < WIDTH*HEIGHT; j++)
 			ptr[j] = start++;
+		/* the fenced view is linear, so the fingerprint of the
+		 * pattern as the detiling copy sees it matches this one */
+		intel_fingerprint_cpu(ptr, WIDTH, HEIGHT, fp[i]);
 		drm_intel_gem_bo_unmap_gtt(buf[i].bo);
 	}
 
 	printf("Verifying initialisation...\n");
 	for (i = 0; i < count; i++)
-		check_bo(buf[i].bo, start_val[i]);
+		check_bo(batch, buf[i].bo, start_val[i]);
 
 	printf("Cyclic blits, forward...\n");
 	for (i = 0; i < count * 4; i++) {
@@ -127,7 +157,8 @@ int main(int argc, char **argv)
 		start_val[dst] = start_val[src];
 	}
 	for (i = 0; i < count; i++)
-		check_bo(buf[i].bo, start_val[i]);
+		check_fp(batch, buf+i, fp[start_val[i] / (WIDTH*HEIGHT)],
+			 start_val[i]);
 
 	printf("Cyclic blits, backward...\n");
 	for (i = 0; i < count * 4; i++) {
@@ -138,7 +169,8 @@ int main(int argc, char **argv)
 		start_val[dst] = start_val[src];
 	}
 	for (i = 0; i < count; i++)
-		check_bo(buf[i].bo, start_val[i]);
+		check_fp(batch, buf+i, fp[start_val[i] / (WIDTH*HEIGHT)],
+			 start_val[i]);
 
 	printf("Random blits...\n");
 	for (i = 0; i < count * 4; i++) {
@@ -152,7 +184,8 @@ int main(int argc, char **argv)
 		start_val[dst] = start_val[src];
 	}
 	for (i = 0; i < count; i++)
-		check_bo(buf[i].bo, start_val[i]);
+		check_fp(batch, buf+i, fp[start_val[i] / (WIDTH*HEIGHT)],
+			 start_val[i]);
 
 	return 0;
 }
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <inttypes.h>
@@ -55,6 +56,29 @@ static drm_intel_bo *target_buffer;
 #define MI_COND_BATCH_BUFFER_END	(0x36<<23 | 1)
 #define MI_DO_COMPARE			(1<<21)
 
+static void
+emit_dependency_batch(int ring)
+{
+	if (ring == I915_EXEC_RENDER) {
+		BEGIN_BATCH(4);
+		OUT_BATCH(MI_COND_BATCH_BUFFER_END | MI_DO_COMPARE);
+		OUT_BATCH(0xffffffff); /* compare dword */
+		OUT_RELOC(target_buffer, I915_GEM_DOMAIN_RENDER,
+				I915_GEM_DOMAIN_RENDER, 0);
+		OUT_BATCH(MI_NOOP);
+		ADVANCE_BATCH();
+	} else {
+		BEGIN_BATCH(4);
+		OUT_BATCH(MI_FLUSH_DW | 1);
+		OUT_BATCH(0); /* reserved */
+		OUT_RELOC(target_buffer, I915_GEM_DOMAIN_RENDER,
+				I915_GEM_DOMAIN_RENDER, 0);
+		OUT_BATCH(MI_NOOP | (1<<22) | (0xf));
+		ADVANCE_BATCH();
+	}
+	intel_batchbuffer_flush_on_ring(batch, ring);
+}
+
 static void
 store_dword_loop(void)
 {
@@ -62,42 +86,161 @@ store_dword_loop(void)
 
 	srandom(0xdeadbeef);
 
-	for (i = 0; i < 0x100000; i++) {
-		int ring = random() % 3 + 1;
-
-		if (ring == I915_EXEC_RENDER) {
-			BEGIN_BATCH(4);
-			OUT_BATCH(MI_COND_BATCH_BUFFER_END | MI_DO_COMPARE);
-			OUT_BATCH(0xffffffff); /* compare dword */
-			OUT_RELOC(target_buffer, I915_GEM_DOMAIN_RENDER,
-					I915_GEM_DOMAIN_RENDER, 0);
-			OUT_BATCH(MI_NOOP);
-			ADVANCE_BATCH();
-		} else {
-			BEGIN_BATCH(4);
-			OUT_BATCH(MI_FLUSH_DW | 1);
-			OUT_BATCH(0); /* reserved */
-			OUT_RELOC(target_buffer, I915_GEM_DOMAIN_RENDER,
-					I915_GEM_DOMAIN_RENDER, 0);
-			OUT_BATCH(MI_NOOP | (1<<22) | (0xf));
-			ADVANCE_BATCH();
+	for (i = 0; i < 0x100000; i++)
+		emit_dependency_batch(random() % 3 + 1);
+
+	drm_intel_bo_map(target_buffer, 0);
+	// map to force waiting on rendering
+	drm_intel_bo_unmap(target_buffer);
+}
+
+/* Benchmark mode.  All batches write the shared target bo, so every
+ * submission to a different ring than the previous one forces the
+ * kernel to order the two rings (semaphore or flush+wait depending on
+ * the module options).  The submission mix across rings is weighted by
+ * -m, and the flush latency of ring-switching submissions is collected
+ * separately from same-ring ones so cross-ring sync stalls show up as
+ * a fat tail in the cross-ring percentiles rather than disappearing
+ * into a mean.
+ */
+static uint64_t
+bench_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static int
+cmp_latency(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static double
+latency_percentile(double *lat, int count, double pct)
+{
+	if (count == 0)
+		return 0.0;
+	return lat[(int)((count - 1) * pct / 100.0)];
+}
+
+static const char *ring_names[] = { "", "render", "bsd", "blt" };
+
+static void
+benchmark_loop(int count, const int *weights)
+{
+	double *same_lat, *cross_lat;
+	uint64_t ring_flushes[4] = { 0, 0, 0, 0 };
+	uint64_t start, t0, total_us;
+	int n_same = 0, n_cross = 0;
+	int weight_sum, prev_ring = 0;
+	int i, ring;
+
+	weight_sum = weights[1] + weights[2] + weights[3];
+	assert(weight_sum > 0);
+
+	same_lat = malloc(count * sizeof(double));
+	assert(same_lat);
+	cross_lat = malloc(count * sizeof(double));
+	assert(cross_lat);
+
+	srandom(0xdeadbeef);
+
+	start = bench_time_us();
+	for (i = 0; i < count; i++) {
+		int pick = random() % weight_sum;
+
+		for (ring = 1; ring < 3; ring++) {
+			if (pick < weights[ring])
+				break;
+			pick -= weights[ring];
 		}
-		intel_batchbuffer_flush_on_ring(batch, ring);
+
+		t0 = bench_time_us();
+		emit_dependency_batch(ring);
+		if (prev_ring && ring != prev_ring)
+			cross_lat[n_cross++] = bench_time_us() - t0;
+		else
+			same_lat[n_same++] = bench_time_us() - t0;
+
+		ring_flushes[ring]++;
+		prev_ring = ring;
 	}
 
 	drm_intel_bo_map(target_buffer, 0);
-	// map to force waiting on rendering
 	drm_intel_bo_unmap(target_buffer);
+	total_us = bench_time_us() - start;
+
+	printf("%d batches in %.3f secs (%.0f batches/s overall)\n",
+	       count, total_us / 1e6, count * 1e6 / total_us);
+	for (ring = 1; ring <= 3; ring++)
+		if (ring_flushes[ring])
+			printf("\t%s: %"PRIu64" batches (%.0f/s)\n",
+			       ring_names[ring], ring_flushes[ring],
+			       ring_flushes[ring] * 1e6 / total_us);
+
+	qsort(same_lat, n_same, sizeof(double), cmp_latency);
+	qsort(cross_lat, n_cross, sizeof(double), cmp_latency);
+
+	printf("same-ring submit latency (%d samples): "
+	       "p50 %.0fus p90 %.0fus p99 %.0fus max %.0fus\n",
+	       n_same,
+	       latency_percentile(same_lat, n_same, 50),
+	       latency_percentile(same_lat, n_same, 90),
+	       latency_percentile(same_lat, n_same, 99),
+	       latency_percentile(same_lat, n_same, 100));
+	printf("cross-ring submit latency (%d samples): "
+	       "p50 %.0fus p90 %.0fus p99 %.0fus max %.0fus\n",
+	       n_cross,
+	       latency_percentile(cross_lat, n_cross, 50),
+	       latency_percentile(cross_lat, n_cross, 90),
+	       latency_percentile(cross_lat, n_cross, 99),
+	       latency_percentile(cross_lat, n_cross, 100));
+
+	free(cross_lat);
+	free(same_lat);
 }
 
 int main(int argc, char **argv)
 {
+	int weights[4] = { 0, 1, 1, 1 };
+	int benchmark = 0;
+	int count = 0x100000;
 	int fd;
 	int devid;
+	int c;
 
-	if (argc != 1) {
-		fprintf(stderr, "usage: %s\n", argv[0]);
-		exit(-1);
+	while ((c = getopt(argc, argv, "bn:m:h")) != -1) {
+		switch (c) {
+		case 'b':
+			benchmark = 1;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'm':
+			if (sscanf(optarg, "%d:%d:%d", &weights[1],
+				   &weights[2], &weights[3]) != 3 ||
+			    weights[1] < 0 || weights[2] < 0 ||
+			    weights[3] < 0 ||
+			    weights[1] + weights[2] + weights[3] == 0) {
+				fprintf(stderr, "invalid mix \"%s\"\n",
+					optarg);
+				exit(-1);
+			}
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-b] [-n count] "
+				"[-m render:bsd:blt]\n", argv[0]);
+			exit(-1);
+		}
 	}
 
 	fd = drm_open_any();
@@ -127,7 +270,10 @@ int main(int argc, char **argv)
 		exit(-1);
 	}
 
-	store_dword_loop();
+	if (benchmark)
+		benchmark_loop(count, weights);
+	else
+		store_dword_loop();
 
 	drm_intel_bo_unreference(target_buffer);
 	intel_batchbuffer_free(batch);
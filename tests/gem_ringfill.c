@@ -46,6 +46,7 @@
 #include "i915_drm.h"
 #include "intel_bufmgr.h"
 #include "intel_batchbuffer.h"
+#include "intel_clock.h"
 #include "intel_gpu_tools.h"
 #include "rendercopy.h"
 
@@ -84,14 +85,14 @@ static void create_bo(drm_intel_bufmgr *bufmgr,
 	drm_intel_bo_unmap(b->dst);
 }
 
-static int check_bo(struct bo *b)
+static int check_bo(struct bo *b, int count)
 {
 	const uint32_t *map;
 	int i, fails = 0;
 
 	drm_intel_bo_map(b->dst, false);
 	map = b->dst->virtual;
-	for (i = 0; i < width*height; i++) {
+	for (i = 0; i < count; i++) {
 		if (map[i] != i && ++fails <= 9) {
 			int x = i % width;
 			int y = i / width;
@@ -118,6 +119,7 @@ static int check_ring(drm_intel_bufmgr *bufmgr,
 		      render_copyfunc_t copy)
 {
 	struct scratch_buf src, tmp, dst;
+	struct drmtest_budget budget;
 	struct bo bo;
 	char output[100];
 	int i;
@@ -131,6 +133,7 @@ static int check_ring(drm_intel_bufmgr *bufmgr,
 	src.tiling = 0;
 	src.data = src.cpu_mapping = NULL;
 	src.size = 4 * width * height;
+	src.offset = 0;
 	src.num_tiles = 4 * width * height;
 	dst = tmp = src;
 
@@ -151,8 +154,13 @@ static int check_ring(drm_intel_bufmgr *bufmgr,
 	 * (padding)
 	 *
 	 * So iterate just a little more than that -- if we don't fill the ring
-	 * doing this, we aren't likely to with this test.
+	 * doing this, we aren't likely to with this test.  The floor below
+	 * keeps several times the ring's capacity queued even when the time
+	 * budget is small; past the floor the budget decides how far the
+	 * pixel walk gets, and the verify covers exactly that many pixels.
 	 */
+#define RINGFILL_MIN_OPS (4 * 128*1024/8/4)
+	drmtest_budget_start(&budget, output, 30);
 	for (i = 0; i < width * height; i++) {
 		int x = i % width;
 		int y = i / width;
@@ -165,11 +173,18 @@ static int check_ring(drm_intel_bufmgr *bufmgr,
 		copy(batch, &src, 0, 0, width, height, &tmp, 0, 0);
 		/* And copy the src into dst, pixel by pixel */
 		copy(batch, &src, x, y, 1, 1, &dst, x, y);
+
+		if (!drmtest_budget_more(&budget) &&
+		    i + 1 >= RINGFILL_MIN_OPS) {
+			i++;
+			break;
+		}
 	}
+	drmtest_budget_report(&budget);
 
 	/* verify */
 	printf("verifying\n");
-	i = check_bo(&bo);
+	i = check_bo(&bo, i);
 	destroy_bo(&bo);
 
 	return i;
@@ -198,6 +213,123 @@ static void blt_copy(struct intel_batchbuffer *batch,
 	intel_batchbuffer_flush(batch);
 }
 
+/* Sustained ring-pressure benchmark: hold the ring at a target fill
+ * level with dummy loads and time a small submission at each level.
+ * The submission path is cheap while the kernel has ring space and
+ * blocks in the wait-for-space path once it doesn't; the sweep prints
+ * latency against occupancy and calls out the fill level where the
+ * jump happens, which is the throttle curve we want per kernel. */
+#define PRESSURE_STEPS		9	/* 10%..90% of the ring */
+#define PRESSURE_SAMPLES	32
+
+static uint32_t ring_occupancy(uint32_t base, int size)
+{
+	uint32_t head = INREG(base + RING_HEAD) & HEAD_ADDR;
+	uint32_t tail = INREG(base + RING_TAIL) & TAIL_ADDR;
+	int full = tail - head;
+
+	if (full < 0)
+		full += size;
+	return full;
+}
+
+static int check_pressure(drm_intel_bufmgr *bufmgr,
+			  struct intel_batchbuffer *batch)
+{
+	struct scratch_buf src, tmp, dst;
+	struct bo bo;
+	uint32_t base;
+	uint64_t base_avg = 0;
+	int size, step, throttle_pct = 0;
+
+	skipped_all = false;
+
+	/* the lib routes blits to the BLT ring on gen6+ */
+	if (IS_GEN6(batch->devid) || IS_GEN7(batch->devid))
+		base = 0x22030;
+	else
+		base = LP_RING;
+	size = (((INREG(base + RING_LEN) & RING_NR_PAGES) >> 12) + 1) * 4096;
+
+	create_bo(bufmgr, &bo, "pressure");
+
+	src.stride = 4 * width;
+	src.tiling = 0;
+	src.data = src.cpu_mapping = NULL;
+	src.size = 4 * width * height;
+	src.offset = 0;
+	src.num_tiles = 4 * width * height;
+	dst = tmp = src;
+
+	src.bo = bo.src;
+	tmp.bo = bo.tmp;
+	dst.bo = bo.dst;
+
+	printf("ring size %d bytes\n", size);
+	printf("%7s %9s %10s %10s %10s\n",
+	       "fill%", "occupancy", "min us", "avg us", "max us");
+
+	for (step = 1; step <= PRESSURE_STEPS; step++) {
+		uint32_t target = size / 10 * step;
+		uint64_t lat_sum = 0, lat_min = ~0ull, lat_max = 0;
+		uint64_t occ_sum = 0;
+		int s;
+
+		/* start each level from an empty ring */
+		drm_intel_bo_wait_rendering(bo.tmp);
+
+		for (s = 0; s < PRESSURE_SAMPLES; s++) {
+			uint64_t t, dt;
+			int attempts = 4 * size / 64;
+
+			/* top up to the target with full-size dummy
+			 * loads; near the top this blocks in the kernel
+			 * itself, so cap the attempts and take whatever
+			 * level we reached */
+			while (ring_occupancy(base, size) < target &&
+			       attempts--)
+				blt_copy(batch, &src, 0, 0, width, height,
+					 &tmp, 0, 0);
+
+			occ_sum += ring_occupancy(base, size);
+
+			t = intel_clock_now();
+			blt_copy(batch, &src, s % width, 0, 1, 1,
+				 &dst, s % width, 0);
+			dt = intel_clock_to_us(intel_clock_now() - t);
+
+			lat_sum += dt;
+			if (dt < lat_min)
+				lat_min = dt;
+			if (dt > lat_max)
+				lat_max = dt;
+		}
+
+		printf("%6d%% %9llu %10llu %10llu %10llu\n", step * 10,
+		       (long long unsigned)(occ_sum / PRESSURE_SAMPLES),
+		       (long long unsigned)lat_min,
+		       (long long unsigned)(lat_sum / PRESSURE_SAMPLES),
+		       (long long unsigned)lat_max);
+
+		if (step == 1)
+			base_avg = lat_sum / PRESSURE_SAMPLES;
+		else if (!throttle_pct && base_avg &&
+			 lat_sum / PRESSURE_SAMPLES > 5 * base_avg)
+			throttle_pct = step * 10;
+	}
+
+	if (throttle_pct)
+		printf("submission latency jumps at ~%d%% ring fill\n",
+		       throttle_pct);
+	else
+		printf("no throttle point found below 90%% ring fill\n");
+
+	drm_intel_bo_wait_rendering(bo.dst);
+	destroy_bo(&bo);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	drm_intel_bufmgr *bufmgr;
@@ -224,6 +356,11 @@ int main(int argc, char **argv)
 	if (drmtest_run_subtest("render") && copy)
 		fails += check_ring(bufmgr, batch, "render", copy);
 
+	if (drmtest_run_subtest("pressure")) {
+		intel_get_mmio(intel_get_pci_device());
+		fails += check_pressure(bufmgr, batch);
+	}
+
 	intel_batchbuffer_free(batch);
 	drm_intel_bufmgr_destroy(bufmgr);
 
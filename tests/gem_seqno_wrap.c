@@ -45,11 +45,11 @@
 #include "i915_drm.h"
 #include "intel_bufmgr.h"
 #include "intel_batchbuffer.h"
+#include "intel_debugfs.h"
 #include "intel_gpu_tools.h"
 #include "rendercopy.h"
 
 static int devid;
-static int card_index = 0;
 static uint32_t last_seqno = 0;
 
 static struct intel_batchbuffer *batch_blt;
@@ -65,6 +65,7 @@ struct option_struct {
 	int prewrap_space;
 	int random;
 	int buffers;
+	int pipelined;
 };
 
 static struct option_struct options;
@@ -80,6 +81,7 @@ static void init_buffer(drm_intel_bufmgr *bufmgr,
 	assert(buf->bo);
 	buf->tiling = I915_TILING_NONE;
 	buf->data = buf->cpu_mapping = NULL;
+	buf->offset = 0;
 	buf->num_tiles = width * height * 4;
 	buf->stride = width * 4;
 }
@@ -292,6 +294,130 @@ static int run_sync_test(int num_buffers, bool verify)
 	return failed;
 }
 
+static uint32_t calc_prewrap_val(void);
+static int write_seqno(uint32_t seqno);
+
+/* Pipelined wrap testing.  The sync test builds and tears down its
+ * whole working set, stalls for verification and quiesces the GPU on
+ * every single wrap, which caps us at a few dozen wrap points per
+ * overnight run.  Here the working set is created once, each round
+ * just moves the seqno next to the boundary and queues the render+blt
+ * copy chain without waiting, and results are only checked every
+ * PIPE_DEPTH rounds - so several wraps stay in flight between stalls
+ * and the coverage rate is bounded by the GPU, not by our readbacks.
+ */
+#define PIPE_DEPTH 8
+
+static int run_pipelined_test(int num_buffers, int rounds)
+{
+	drm_intel_bufmgr *bufmgr;
+	int max;
+	drm_intel_bo **src, **dst1, **dst2;
+	struct scratch_buf *s_src, *s_dst;
+	int width = 128, height = 128;
+	int fd;
+	int round, i;
+	int failed = 0;
+
+	fd = drm_open_any();
+	assert(fd >= 0);
+
+	gem_quiescent_gpu(fd);
+
+	devid = intel_get_drm_devid(fd);
+
+	max = gem_aperture_size (fd) / (1024 * 1024) / 2;
+	if (num_buffers > max)
+		num_buffers = max;
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+	batch_blt = intel_batchbuffer_alloc(bufmgr, devid);
+	assert(batch_blt);
+	batch_3d = intel_batchbuffer_alloc(bufmgr, devid);
+	assert(batch_3d);
+
+	src = malloc(num_buffers * sizeof(*src));
+	assert(src);
+	dst1 = malloc(num_buffers * sizeof(*dst1));
+	assert(dst1);
+	dst2 = malloc(num_buffers * sizeof(*dst2));
+	assert(dst2);
+	s_src = malloc(num_buffers * sizeof(*s_src));
+	assert(s_src);
+	s_dst = malloc(num_buffers * sizeof(*s_dst));
+	assert(s_dst);
+
+	for (i = 0; i < num_buffers; i++) {
+		src[i] = create_bo(bufmgr, i, width, height);
+		assert(src[i]);
+		dst1[i] = create_bo(bufmgr, ~i, width, height);
+		assert(dst1[i]);
+		dst2[i] = create_bo(bufmgr, ~i, width, height);
+		assert(dst2[i]);
+		init_buffer(bufmgr, &s_src[i], src[i], width, height);
+		init_buffer(bufmgr, &s_dst[i], dst1[i], width, height);
+	}
+
+	for (round = 0; rounds == 0 || round < rounds; round++) {
+		assert(write_seqno(UINT32_MAX - calc_prewrap_val()) == 0);
+
+		for (i = 0; i < num_buffers; i++)
+			render_copyfunc(&s_src[i], &s_dst[i], width, height);
+		for (i = 0; i < num_buffers; i++)
+			intel_copy_bo(batch_blt, dst2[i], dst1[i],
+				      width, height);
+
+		if ((round + 1) % PIPE_DEPTH)
+			continue;
+
+		for (i = 0; i < num_buffers; i++)
+			if (cmp_bo(dst2[i], i, width, height)) {
+				printf("buffer %d differs after round %d, "
+				       "seqno_before_round 0x%x\n",
+				       i, round, last_seqno);
+				failed = -1;
+			}
+
+		if (failed)
+			break;
+
+		/* rearm the destinations so a dropped copy in the next
+		 * window can't hide behind last window's results */
+		for (i = 0; i < num_buffers; i++) {
+			set_bo(dst1[i], ~i, width, height);
+			set_bo(dst2[i], ~i, width, height);
+		}
+
+		if (options.verbose) {
+			printf("wraps done: %d\n", round + 1);
+			fflush(stdout);
+		}
+	}
+
+	for (i = 0; i < num_buffers; i++) {
+		release_bo(src[i]);
+		release_bo(dst1[i]);
+		release_bo(dst2[i]);
+	}
+
+	intel_batchbuffer_free(batch_3d);
+	intel_batchbuffer_free(batch_blt);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	free(s_dst);
+	free(s_src);
+	free(dst2);
+	free(dst1);
+	free(src);
+
+	gem_quiescent_gpu(fd);
+
+	close(fd);
+
+	return failed;
+}
+
 static int run_cmd(char *s)
 {
 	int pid;
@@ -356,7 +482,6 @@ static int run_cmd(char *s)
 	return r;
 }
 
-static const char *dfs_base = "/sys/kernel/debug/dri";
 static const char *dfs_entry = "i915_next_seqno";
 
 static int dfs_open(int mode)
@@ -364,14 +489,18 @@ static int dfs_open(int mode)
 	char fname[FILENAME_MAX];
 	int fh;
 
-	snprintf(fname, FILENAME_MAX, "%s/%i/%s",
-		 dfs_base, card_index, dfs_entry);
+	if (intel_debugfs_path(fname, FILENAME_MAX - 32)) {
+		fprintf(stderr, "i915 debugfs path not found\n");
+		exit(77);
+	}
+	strcat(fname, "/");
+	strcat(fname, dfs_entry);
 
 	fh = open(fname, mode);
 	if (fh == -1) {
 		fprintf(stderr,
-			"error %d opening '%s/%d/%s'. too old kernel?\n",
-			errno, dfs_base, card_index, dfs_entry);
+			"error %d opening '%s'. too old kernel?\n",
+			errno, fname);
 		exit(77);
 	}
 
@@ -547,6 +676,7 @@ static void print_usage(const char *s)
 	printf("    -p --prewrap=n        set seqno to WRAP - n for each testrun\n");
 	printf("    -r --norandom         dont randomize prewrap space\n");
 	printf("    -i --buffers          number of buffers to copy\n");
+	printf("    -x --pipelined        keep several wraps in flight, verify in batches\n");
 	exit(-1);
 }
 
@@ -564,6 +694,7 @@ static void parse_options(int argc, char **argv)
 		{"prewrap", required_argument, 0, 'p'},
 		{"norandom", no_argument, 0, 'r'},
 		{"buffers", required_argument, 0, 'i'},
+		{"pipelined", no_argument, 0, 'x'},
 	};
 
 	strcpy(options.cmd, "");
@@ -575,8 +706,9 @@ static void parse_options(int argc, char **argv)
 	options.random = 1;
 	options.prewrap_space = 21;
 	options.buffers = 10;
+	options.pipelined = 0;
 
-	while((c = getopt_long(argc, argv, "c:n:bvt:dp:ri:",
+	while((c = getopt_long(argc, argv, "c:n:bvt:dp:ri:x",
 			       long_options, &option_index)) != -1) {
 		switch(c) {
 		case 'b':
@@ -613,6 +745,11 @@ static void parse_options(int argc, char **argv)
 		case 'r':
 			options.random = 0;
 			break;
+		case 'x':
+			options.pipelined = 1;
+			printf("pipelined mode, verifying every %d wraps\n",
+			       PIPE_DEPTH);
+			break;
 		case 'p':
 			options.prewrap_space = atoi(optarg);
 			printf("prewrap set to %d (0x%x)\n",
@@ -639,11 +776,11 @@ int main(int argc, char **argv)
 
 	parse_options(argc, argv);
 
-	card_index = drm_get_card(0);
-	assert(card_index != -1);
-
 	srandom(time(NULL));
 
+	if (options.pipelined)
+		return run_pipelined_test(options.buffers, options.rounds);
+
 	while(options.rounds == 0 || wcount < options.rounds) {
 		if (options.background) {
 			background_run_once();
@@ -0,0 +1,306 @@
+/*
+ * Copyright © 2009 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Authors:
+ *    Eric Anholt <eric@anholt.net>
+ *    Jesse Barnes <jbarnes@virtuousgeek.org> (based on gem_bad_blit.c)
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_chipset.h"
+#include "intel_clock.h"
+#include "intel_gpu_tools.h"
+
+static drm_intel_bufmgr *bufmgr;
+struct intel_batchbuffer *batch;
+static drm_intel_bo *target_buffer;
+static int has_ppgtt = 0;
+
+/*
+ * Testcase: Basic MI check using MI_STORE_DATA_IMM on every ring the
+ * device has, folded from the old per-ring gem_storedw_loop_{render,
+ * blt,bsd} copies, plus a concurrent multi-ring pass that measures how
+ * long each ring's store takes to become CPU-visible.
+ */
+
+struct ring {
+	const char *name;
+	unsigned exec_flag;
+};
+
+static const struct ring rings[] = {
+	{ "render", I915_EXEC_RENDER },
+	{ "blt", I915_EXEC_BLT },
+	{ "bsd", I915_EXEC_BSD },
+};
+
+#define NUM_RINGS (sizeof(rings)/sizeof(rings[0]))
+
+/* prints the skip reason itself so the caller can just move on */
+static int
+ring_usable(const struct ring *ring, uint32_t devid)
+{
+	const struct intel_device_caps *caps = intel_get_device_caps(devid);
+
+	if (ring->exec_flag == I915_EXEC_BLT && !caps->has_blt) {
+		fprintf(stderr, "no blt ring on this device, skipping\n");
+		return 0;
+	}
+
+	if (ring->exec_flag == I915_EXEC_BSD && !caps->has_bsd) {
+		fprintf(stderr, "no bsd ring on this device, skipping\n");
+		return 0;
+	}
+
+	if (ring->exec_flag == I915_EXEC_BSD && caps->gen == 6) {
+		fprintf(stderr, "MI_STORE_DATA broken on gen6 bsd, skipping\n");
+		return 0;
+	}
+
+	/* only render can fall back to MI_MEM_VIRTUAL addressing */
+	if (ring->exec_flag != I915_EXEC_RENDER && !has_ppgtt) {
+		fprintf(stderr, "no ppgtt detected, which %s requires, "
+			"skipping\n", ring->name);
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+emit_store_dword(drm_intel_bo *buffer, uint32_t offset, uint32_t val,
+		 unsigned exec_flag)
+{
+	int cmd;
+
+	cmd = MI_STORE_DWORD_IMM;
+	if (!has_ppgtt)
+		cmd |= MI_MEM_VIRTUAL;
+
+	BEGIN_BATCH(4);
+	OUT_BATCH(cmd);
+	OUT_BATCH(0); /* reserved */
+	OUT_RELOC(buffer, I915_GEM_DOMAIN_INSTRUCTION,
+		  I915_GEM_DOMAIN_INSTRUCTION, offset);
+	OUT_BATCH(val);
+	ADVANCE_BATCH();
+
+	intel_batchbuffer_flush_on_ring(batch, exec_flag);
+}
+
+static void
+store_dword_loop(const struct ring *ring, int divider)
+{
+	int i, val = 0;
+	uint32_t *buf;
+
+	printf("running storedw loop on %s with stall every %i batch\n",
+	       ring->name, divider);
+
+	for (i = 0; i < 0x100000; i++) {
+		emit_store_dword(target_buffer, 0, val, ring->exec_flag);
+
+		if (i % divider != 0)
+			goto cont;
+
+		drm_intel_bo_map(target_buffer, 0);
+
+		buf = target_buffer->virtual;
+		if (buf[0] != val) {
+			fprintf(stderr,
+				"value mismatch: cur 0x%08x, stored 0x%08x\n",
+				buf[0], val);
+			exit(-1);
+		}
+
+		drm_intel_bo_unmap(target_buffer);
+
+cont:
+		val++;
+	}
+
+	drm_intel_bo_map(target_buffer, 0);
+	buf = target_buffer->virtual;
+
+	printf("completed %d writes successfully, current value: 0x%08x\n", i,
+			buf[0]);
+	drm_intel_bo_unmap(target_buffer);
+}
+
+#define MULTI_RING_ROUNDS	1024
+#define VISIBILITY_TIMEOUT_US	1000000
+
+/* Fire a store on every usable ring at once, each targeting its own
+ * cacheline of the shared bo, and poll an uncached GTT map to see when
+ * each write lands.  A fence-free scheme that polls memory instead of
+ * waiting on requests lives or dies by these latencies. */
+static void
+multi_ring_loop(const int *usable)
+{
+	volatile uint32_t *map;
+	uint64_t total[NUM_RINGS] = { 0 };
+	uint64_t worst[NUM_RINGS] = { 0 };
+	int round, i;
+
+	printf("running concurrent storedw on all usable rings\n");
+
+	/* map up front; mapping after submission would synchronize and
+	 * hide exactly the latency we are trying to observe */
+	if (drm_intel_gem_bo_map_gtt(target_buffer)) {
+		fprintf(stderr, "failed to map target through the GTT\n");
+		exit(-1);
+	}
+	map = target_buffer->virtual;
+
+	for (round = 0; round < MULTI_RING_ROUNDS; round++) {
+		uint32_t val = round + 1;
+		uint64_t submitted;
+
+		for (i = 0; i < NUM_RINGS; i++)
+			if (usable[i])
+				emit_store_dword(target_buffer, 64 * i, val,
+						 rings[i].exec_flag);
+
+		submitted = intel_clock_now();
+
+		for (i = 0; i < NUM_RINGS; i++) {
+			uint64_t lat;
+
+			if (!usable[i])
+				continue;
+
+			while (map[16 * i] != val) {
+				if (intel_clock_to_us(intel_clock_now() -
+						      submitted) >
+				    VISIBILITY_TIMEOUT_US) {
+					fprintf(stderr,
+						"%s write not visible after "
+						"%ds\n", rings[i].name,
+						VISIBILITY_TIMEOUT_US / 1000000);
+					exit(-1);
+				}
+			}
+
+			lat = intel_clock_now() - submitted;
+			total[i] += lat;
+			if (lat > worst[i])
+				worst[i] = lat;
+		}
+	}
+
+	drm_intel_gem_bo_unmap_gtt(target_buffer);
+
+	for (i = 0; i < NUM_RINGS; i++) {
+		if (!usable[i])
+			continue;
+		printf("%s write visibility: avg %.2fµs, worst %.2fµs "
+		       "over %d rounds\n", rings[i].name,
+		       intel_clock_to_us(total[i]) / MULTI_RING_ROUNDS,
+		       intel_clock_to_us(worst[i]), MULTI_RING_ROUNDS);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int usable[NUM_RINGS];
+	int num_usable = 0;
+	int fd, i;
+	int devid;
+
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		exit(-1);
+	}
+
+	fd = drm_open_any();
+	devid = intel_get_drm_devid(fd);
+
+	has_ppgtt = gem_uses_aliasing_ppgtt(fd);
+
+	if (IS_GEN2(devid) || IS_GEN3(devid) || IS_GEN4(devid) || IS_GEN5(devid)) {
+
+		fprintf(stderr, "MI_STORE_DATA can only use GTT address on gen4+/g33 and "
+			"needs snoopable mem on pre-gen6\n");
+		return 77;
+	}
+
+	for (i = 0; i < NUM_RINGS; i++) {
+		usable[i] = ring_usable(&rings[i], devid);
+		num_usable += usable[i];
+	}
+	if (num_usable == 0)
+		return 77;
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	if (!bufmgr) {
+		fprintf(stderr, "failed to init libdrm\n");
+		exit(-1);
+	}
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	if (!batch) {
+		fprintf(stderr, "failed to create batch buffer\n");
+		exit(-1);
+	}
+
+	target_buffer = drm_intel_bo_alloc(bufmgr, "target bo", 4096, 4096);
+	if (!target_buffer) {
+		fprintf(stderr, "failed to alloc target buffer\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < NUM_RINGS; i++) {
+		if (!usable[i])
+			continue;
+
+		store_dword_loop(&rings[i], 1);
+		store_dword_loop(&rings[i], 2);
+		store_dword_loop(&rings[i], 3);
+		store_dword_loop(&rings[i], 5);
+	}
+
+	if (num_usable > 1)
+		multi_ring_loop(usable);
+
+	drm_intel_bo_unreference(target_buffer);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
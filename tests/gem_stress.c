@@ -49,7 +49,15 @@
  * In short: designed for maximum evilness.
  */
 
+#include <pthread.h>
+
 #include "rendercopy.h"
+#include "intel_arena.h"
+#include "intel_pace.h"
+#include "intel_tile_check.h"
+#include "intel_verify.h"
+#include "intel_workset.h"
+#include "intel_gpu_tools.h"
 
 #define CMD_POLY_STIPPLE_OFFSET       0x7906
 
@@ -73,6 +81,10 @@ int num_fences;
 
 drm_intel_bo *busy_bo;
 
+/* slab allocator for the scratch bufs; only usable when all buffers stay
+ * linear, since set_tiling works on whole bos */
+static struct intel_arena *buf_arena;
+
 struct option_struct {
     unsigned scratch_buf_size;
     unsigned max_dimension;
@@ -91,6 +103,7 @@ struct option_struct {
     int tile_size;
     int check_render_cpyfn;
     int use_signal_helper;
+    int num_threads;
 };
 
 struct option_struct options;
@@ -111,6 +124,24 @@ static unsigned num_total_tiles = 0;
 int fence_storm = 0;
 static int gpu_busy_load = 10;
 
+/* opt-in submission pacing; saturation hides the races that only open
+ * when the pipeline regularly drains between submissions */
+static struct intel_pace pace;
+
+/* All copy paths emit through this instead of the global batch, so the
+ * tile workers can run them concurrently, each on its own batchbuffer.
+ * The main thread points it at the shared batch. */
+static __thread struct intel_batchbuffer *worker_batch;
+
+/* Closed-loop busy load: instead of letting the open-loop power-of-two
+ * counter drift between generations, sample render ring occupancy
+ * (head != tail, as intel_gpu_top does) on every keep_gpu_busy() call
+ * and steer both the blit size and an emission duty cycle towards a
+ * target utilization percentage. */
+static int busy_target;			/* %; 0 = old open-loop behaviour */
+static int busy_emit_permille = 1000;
+static unsigned busy_samples, busy_hits;
+
 struct {
 	unsigned num_failed;
 	unsigned max_failed_reads;
@@ -123,9 +154,12 @@ static void tile2xy(struct scratch_buf *buf, unsigned tile, unsigned *x, unsigne
 	*y = ((tile*options.tile_size) / (buf->stride/sizeof(uint32_t))) * options.tile_size;
 }
 
-static void emit_blt(drm_intel_bo *src_bo, uint32_t src_tiling, unsigned src_pitch,
+static void emit_blt(struct intel_batchbuffer *batch,
+		     drm_intel_bo *src_bo, unsigned src_ofs,
+		     uint32_t src_tiling, unsigned src_pitch,
 		     unsigned src_x, unsigned src_y, unsigned w, unsigned h,
-		     drm_intel_bo *dst_bo, uint32_t dst_tiling, unsigned dst_pitch,
+		     drm_intel_bo *dst_bo, unsigned dst_ofs,
+		     uint32_t dst_tiling, unsigned dst_pitch,
 		     unsigned dst_x, unsigned dst_y)
 {
 	uint32_t cmd_bits = 0;
@@ -151,10 +185,11 @@ static void emit_blt(drm_intel_bo *src_bo, uint32_t src_tiling, unsigned src_pit
 		  dst_pitch);
 	OUT_BATCH(dst_y << 16 | dst_x);
 	OUT_BATCH((dst_y+h) << 16 | (dst_x+w));
-	OUT_RELOC_FENCED(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_RELOC_FENCED(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER,
+			 dst_ofs);
 	OUT_BATCH(src_y << 16 | src_x);
 	OUT_BATCH(src_pitch);
-	OUT_RELOC_FENCED(src_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
+	OUT_RELOC_FENCED(src_bo, I915_GEM_DOMAIN_RENDER, 0, src_ofs);
 	ADVANCE_BATCH();
 
 	if (IS_GEN6(devid) || IS_GEN7(devid)) {
@@ -168,15 +203,50 @@ static void emit_blt(drm_intel_bo *src_bo, uint32_t src_tiling, unsigned src_pit
 
 /* All this gem trashing wastes too much cpu time, so give the gpu something to
  * do to increase changes for races. */
+static void busy_load_regulate(void)
+{
+	uint32_t head, tail;
+	int measured;
+
+	head = INREG(LP_RING + RING_HEAD) & HEAD_ADDR;
+	tail = INREG(LP_RING + RING_TAIL) & TAIL_ADDR;
+	busy_hits += head != tail;
+
+	if (++busy_samples < 64)
+		return;
+
+	measured = busy_hits * 100 / busy_samples;
+	busy_samples = busy_hits = 0;
+
+	if (measured < busy_target - 2) {
+		/* grow the blits first, then the duty cycle */
+		if (gpu_busy_load < 10)
+			gpu_busy_load++;
+		else if (busy_emit_permille < 1000)
+			busy_emit_permille += 25;
+	} else if (measured > busy_target + 2) {
+		if (busy_emit_permille > 50)
+			busy_emit_permille -= 25;
+		else if (gpu_busy_load > 0)
+			gpu_busy_load--;
+	}
+}
+
 static void keep_gpu_busy(void)
 {
 	int tmp;
 
+	if (busy_target) {
+		busy_load_regulate();
+		if (random() % 1000 >= busy_emit_permille)
+			return;
+	}
+
 	tmp = 1 << gpu_busy_load;
 	assert(tmp <= 1024);
 
-	emit_blt(busy_bo, 0, 4096, 0, 0, tmp, 128,
-		 busy_bo, 0, 4096, 0, 128);
+	emit_blt(worker_batch, busy_bo, 0, 0, 4096, 0, 0, tmp, 128,
+		 busy_bo, 0, 0, 4096, 0, 128);
 }
 
 static void set_to_cpu_domain(struct scratch_buf *buf, int writing)
@@ -190,6 +260,49 @@ static void (*copyfunc)(struct scratch_buf *src, unsigned src_x, unsigned src_y,
 			struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
 			unsigned logical_tile_no);
 
+/* Sparse pass under INTEL_VERIFY_SAMPLE: check only the sampled tile
+ * rows against the pattern and refill the destination wholesale.
+ * Returns 0 on any sampled mismatch, and the caller redoes the tile
+ * with the full row-by-row verify. */
+static int cpucpy2d_sampled(uint32_t *src, unsigned src_stride,
+			    unsigned src_x, unsigned src_y,
+			    uint32_t *dst, unsigned dst_stride,
+			    unsigned dst_x, unsigned dst_y,
+			    unsigned logical_tile_no, int percent)
+{
+	struct intel_verify_sample sample;
+	int64_t offset;
+	int i;
+
+	/* one span stands for one tile row */
+	intel_verify_sample_init(&sample,
+				 options.tile_size * INTEL_VERIFY_SPAN,
+				 logical_tile_no ^ copyfunc_seq, percent);
+	while ((offset = intel_verify_sample_next(&sample)) != -1) {
+		unsigned src_ofs, expect;
+
+		i = offset / INTEL_VERIFY_SPAN;
+		src_ofs = src_x + src_stride * (src_y + i);
+		expect = logical_tile_no*options.tile_size*options.tile_size
+			+ i*options.tile_size;
+		if (intel_seq_check(&src[src_ofs], expect,
+				    options.tile_size) != options.tile_size)
+			return 0;
+	}
+
+	/* a matching tile equals the expected pattern, so generating
+	 * the destination replaces the copy as usual */
+	for (i = 0; i < options.tile_size; i++) {
+		unsigned dst_ofs = dst_x + dst_stride * (dst_y + i);
+
+		intel_seq_fill(&dst[dst_ofs],
+			       logical_tile_no*options.tile_size*options.tile_size
+			       + i*options.tile_size, options.tile_size);
+	}
+
+	return 1;
+}
+
 /* stride, x, y in units of uint32_t! */
 static void cpucpy2d(uint32_t *src, unsigned src_stride, unsigned src_x, unsigned src_y,
 		     uint32_t *dst, unsigned dst_stride, unsigned dst_x, unsigned dst_y,
@@ -197,23 +310,41 @@ static void cpucpy2d(uint32_t *src, unsigned src_stride, unsigned src_x, unsigne
 {
 	int i, j;
 	int failed = 0;
+	int percent = intel_verify_sample_percent();
+
+	if (percent &&
+	    cpucpy2d_sampled(src, src_stride, src_x, src_y,
+			     dst, dst_stride, dst_x, dst_y,
+			     logical_tile_no, percent))
+		return;
 
 	for (i = 0; i < options.tile_size; i++) {
+		unsigned dst_ofs = dst_x + dst_stride * (dst_y + i);
+		unsigned src_ofs = src_x + src_stride * (src_y + i);
+		unsigned expect = logical_tile_no*options.tile_size*options.tile_size
+		    + i*options.tile_size;
+
+		/* fast path: vectorized check of the whole row, and since a
+		 * matching row equals the expected pattern, refill the
+		 * destination instead of copying */
+		if (intel_seq_check(&src[src_ofs], expect, options.tile_size)
+		    == options.tile_size) {
+			intel_seq_fill(&dst[dst_ofs], expect,
+				       options.tile_size);
+			continue;
+		}
+
 		for (j = 0; j < options.tile_size; j++) {
-			unsigned dst_ofs = dst_x + j + dst_stride * (dst_y + i);
-			unsigned src_ofs = src_x + j + src_stride * (src_y + i);
-			unsigned expect = logical_tile_no*options.tile_size*options.tile_size
-			    + i*options.tile_size + j;
-			uint32_t tmp = src[src_ofs];
-			if (tmp != expect) {
+			uint32_t tmp = src[src_ofs + j];
+			if (tmp != expect + j) {
 			    printf("mismatch at tile %i pos %i, read %i, expected %i, diff %i\n",
-				    logical_tile_no, i*options.tile_size + j, tmp, expect, (int) tmp - expect);
+				    logical_tile_no, i*options.tile_size + j, tmp, expect + j, (int) tmp - (expect + j));
 			    if (options.trace_tile >= 0 && options.fail)
 				    exit(1);
 			    failed++;
 			}
 			/* when not aborting, correct any errors */
-			dst[dst_ofs] = expect;
+			dst[dst_ofs + j] = expect + j;
 		}
 	}
 	if (failed && options.fail)
@@ -229,7 +360,7 @@ static void cpu_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y
 			 struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
 			 unsigned logical_tile_no)
 {
-	assert(batch->ptr == batch->buffer);
+	assert(worker_batch->ptr == worker_batch->buffer);
 
 	if (options.ducttape)
 		drm_intel_bo_wait_rendering(dst->bo);
@@ -251,14 +382,15 @@ static void prw_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y
 	uint32_t tmp_tile[options.tile_size*options.tile_size];
 	int i;
 
-	assert(batch->ptr == batch->buffer);
+	assert(worker_batch->ptr == worker_batch->buffer);
 
 	if (options.ducttape)
 		drm_intel_bo_wait_rendering(dst->bo);
 
 	if (src->tiling == I915_TILING_NONE) {
 		for (i = 0; i < options.tile_size; i++) {
-			unsigned ofs = src_x*sizeof(uint32_t) + src->stride*(src_y + i);
+			unsigned ofs = src->offset +
+				src_x*sizeof(uint32_t) + src->stride*(src_y + i);
 			drm_intel_bo_get_subdata(src->bo, ofs,
 						 options.tile_size*sizeof(uint32_t),
 						 tmp_tile + options.tile_size*i);
@@ -273,7 +405,8 @@ static void prw_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y
 
 	if (dst->tiling == I915_TILING_NONE) {
 		for (i = 0; i < options.tile_size; i++) {
-			unsigned ofs = dst_x*sizeof(uint32_t) + dst->stride*(dst_y + i);
+			unsigned ofs = dst->offset +
+				dst_x*sizeof(uint32_t) + dst->stride*(dst_y + i);
 			drm_intel_bo_subdata(dst->bo, ofs,
 					     options.tile_size*sizeof(uint32_t),
 					     tmp_tile + options.tile_size*i);
@@ -298,9 +431,11 @@ static void blitter_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned s
 	if (keep_gpu_busy_counter & 1 && !fence_storm)
 		keep_gpu_busy();
 
-	emit_blt(src->bo, src->tiling, src->stride, src_x, src_y,
+	emit_blt(worker_batch, src->bo, src->offset, src->tiling, src->stride,
+		 src_x, src_y,
 		 options.tile_size, options.tile_size,
-		 dst->bo, dst->tiling, dst->stride, dst_x, dst_y);
+		 dst->bo, dst->offset, dst->tiling, dst->stride,
+		 dst_x, dst_y);
 
 	if (!(keep_gpu_busy_counter & 1) && !fence_storm)
 		keep_gpu_busy();
@@ -314,7 +449,7 @@ static void blitter_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned s
 
 	if (fence_storm <= 1) {
 		fence_storm = 0;
-		intel_batchbuffer_flush(batch);
+		intel_batchbuffer_flush(worker_batch);
 	}
 }
 
@@ -330,7 +465,7 @@ static void render_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned sr
 		keep_gpu_busy();
 
 	if (rendercopy)
-		rendercopy(batch, src, src_x, src_y,
+		rendercopy(worker_batch, src, src_x, src_y,
 		     options.tile_size, options.tile_size,
 		     dst, dst_x, dst_y);
 	else
@@ -341,7 +476,7 @@ static void render_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned sr
 		keep_gpu_busy();
 
 	keep_gpu_busy_counter++;
-	intel_batchbuffer_flush(batch);
+	intel_batchbuffer_flush(worker_batch);
 }
 
 static void next_copyfunc(int tile)
@@ -415,6 +550,45 @@ static void fan_out(void)
 		tile_permutation[i] = i;
 }
 
+/* DRMTEST_WORKSET names a snapshot file: restore the post-fan-out
+ * state from it when it matches, otherwise fan out once and save it,
+ * so repeated runs chasing one failure skip the working-set build.
+ * Returns -1 when snapshotting can't work for this configuration. */
+static int fan_out_from_snapshot(const char *path)
+{
+	struct intel_workset_slot *slots;
+	int i;
+
+	if (options.no_hw || buf_arena)
+		return -1;
+
+	slots = malloc(num_buffers * sizeof(*slots));
+	assert(slots);
+	for (i = 0; i < num_buffers; i++) {
+		slots[i].bo = buffers[current_set][i].bo;
+		slots[i].tiling = buffers[current_set][i].tiling;
+		slots[i].stride = buffers[current_set][i].stride;
+		slots[i].size = buffers[current_set][i].size;
+	}
+
+	if (intel_workset_restore(path, devid, slots, num_buffers) == 0) {
+		for (i = 0; i < num_buffers; i++) {
+			buffers[current_set][i].tiling = slots[i].tiling;
+			buffers[current_set][i].stride = slots[i].stride;
+		}
+		for (i = 0; i < num_total_tiles; i++)
+			tile_permutation[i] = i;
+		printf("restored working set from %s\n", path);
+	} else {
+		fan_out();
+		if (intel_workset_save(path, devid, slots, num_buffers) == 0)
+			printf("saved working set to %s\n", path);
+	}
+
+	free(slots);
+	return 0;
+}
+
 static void fan_in_and_check(void)
 {
 	uint32_t tmp_tile[options.tile_size*options.tile_size];
@@ -461,9 +635,14 @@ static void sanitize_stride(struct scratch_buf *buf)
 
 static void init_buffer(struct scratch_buf *buf, unsigned size)
 {
-	buf->bo = drm_intel_bo_alloc(bufmgr, "tiled bo", size, 4096);
+	if (buf_arena) {
+		intel_arena_get_buf(buf_arena, buf);
+	} else {
+		buf->bo = drm_intel_bo_alloc(bufmgr, "tiled bo", size, 4096);
+		assert(buf->bo);
+		buf->offset = 0;
+	}
 	buf->size = size;
-	assert(buf->bo);
 	buf->tiling = I915_TILING_NONE;
 	buf->stride = 4096;
 
@@ -471,7 +650,7 @@ static void init_buffer(struct scratch_buf *buf, unsigned size)
 
 	if (options.no_hw)
 		buf->data = malloc(size);
-	else {
+	else if (!buf_arena) {
 		if (options.use_cpu_maps)
 			drm_intel_bo_map(buf->bo, 1);
 		else
@@ -500,7 +679,7 @@ static void init_set(unsigned set)
 
 	drmtest_permute_array(buffers[set], num_buffers, exchange_buf);
 
-	if (current_set == 1 && options.gpu_busy_load == 0) {
+	if (current_set == 1 && options.gpu_busy_load == 0 && !busy_target) {
 		gpu_busy_load++;
 		if (gpu_busy_load > 10)
 			gpu_busy_load = 6;
@@ -557,47 +736,160 @@ static void exchange_uint(void *array, unsigned i, unsigned j)
 	i_arr[j] = i_tmp;
 }
 
-static void copy_tiles(unsigned *permutation)
+static void copy_one_tile(unsigned *permutation, int i,
+			  void (*func)(struct scratch_buf *src,
+				       unsigned src_x, unsigned src_y,
+				       struct scratch_buf *dst,
+				       unsigned dst_x, unsigned dst_y,
+				       unsigned logical_tile_no))
 {
 	unsigned src_tile, src_buf_idx, src_x, src_y;
 	unsigned dst_tile, dst_buf_idx, dst_x, dst_y;
 	struct scratch_buf *src_buf, *dst_buf;
-	int i, idx;
+	int idx;
+
+	/* tile_permutation is independent of current_permutation, so
+	 * abuse it to randomize the order of the src bos */
+	idx  = tile_permutation[i];
+	src_buf_idx = idx / options.tiles_per_buf;
+	src_tile = idx % options.tiles_per_buf;
+	src_buf = &buffers[current_set][src_buf_idx];
+
+	tile2xy(src_buf, src_tile, &src_x, &src_y);
+
+	dst_buf_idx = permutation[idx] / options.tiles_per_buf;
+	dst_tile = permutation[idx] % options.tiles_per_buf;
+	dst_buf = &buffers[target_set][dst_buf_idx];
+
+	tile2xy(dst_buf, dst_tile, &dst_x, &dst_y);
+
+	if (options.trace_tile == i)
+		printf("copying tile %i from %i (%i, %i) to %i (%i, %i)", i,
+			tile_permutation[i], src_buf_idx, src_tile,
+			permutation[idx], dst_buf_idx, dst_tile);
+
+	if (options.no_hw) {
+		cpucpy2d(src_buf->data,
+			 src_buf->stride / sizeof(uint32_t),
+			 src_x, src_y,
+			 dst_buf->data,
+			 dst_buf->stride / sizeof(uint32_t),
+			 dst_x, dst_y,
+			 i);
+	} else {
+		func(src_buf, src_x, src_y, dst_buf, dst_x, dst_y, i);
+	}
+}
+
+/* Parallel tile scheduler.  Workers pull chunks of the tile range off a
+ * shared cursor, so a worker stuck behind a slow copy simply stops
+ * claiming chunks and the others drain the rest - the same balancing a
+ * per-worker deque with stealing buys, without the races.  Each worker
+ * emits through its own batchbuffer, and the render/blit/cpu ratio is a
+ * policy knob instead of the serial modulo sequence, so the mix can
+ * mirror production. */
+#define TILE_WORKER_MAX		16
+#define TILE_WORKER_CHUNK	8
+
+static int tile_workers;		/* 0 = serial loop */
+static int copy_mix[3] = {1, 2, 1};	/* render:blit:cpu weights */
+
+static struct tile_worker {
+	pthread_t thread;
+	struct intel_batchbuffer *batch;
+	unsigned *permutation;
+	int tiles_done;
+	double secs;
+} tile_worker[TILE_WORKER_MAX];
+
+static volatile int tile_cursor;
+
+static void *tile_worker_func(void *data)
+{
+	struct tile_worker *w = data;
+	int mix_total = copy_mix[0] + copy_mix[1] + copy_mix[2];
+	struct timeval start, end;
+	int base, i;
+
+	worker_batch = w->batch;
+	w->tiles_done = 0;
+
+	gettimeofday(&start, NULL);
+	while ((base = __sync_fetch_and_add(&tile_cursor,
+					    TILE_WORKER_CHUNK)) <
+	       num_total_tiles) {
+		int top = base + TILE_WORKER_CHUNK;
+
+		if (top > num_total_tiles)
+			top = num_total_tiles;
+
+		for (i = base; i < top; i++) {
+			unsigned h = i * 2654435761u % mix_total;
+			void (*func)(struct scratch_buf *,
+				     unsigned, unsigned,
+				     struct scratch_buf *,
+				     unsigned, unsigned, unsigned);
+
+			if (h < copy_mix[0] && options.use_render)
+				func = render_copyfunc;
+			else if (h < copy_mix[0] + copy_mix[1] &&
+				 options.use_blt)
+				func = blitter_copyfunc;
+			else
+				func = cpu_copyfunc;
+
+			copy_one_tile(w->permutation, i, func);
+			w->tiles_done++;
+		}
+	}
+	gettimeofday(&end, NULL);
+
+	intel_batchbuffer_flush(w->batch);
+	w->secs = end.tv_sec - start.tv_sec +
+		(end.tv_usec - start.tv_usec) / 1e6;
+
+	return NULL;
+}
+
+static void copy_tiles_parallel(unsigned *permutation)
+{
+	int i;
+
+	tile_cursor = 0;
+	for (i = 0; i < tile_workers; i++) {
+		struct tile_worker *w = &tile_worker[i];
+
+		w->batch = intel_batchbuffer_alloc(bufmgr, devid);
+		w->permutation = permutation;
+		assert(pthread_create(&w->thread, NULL,
+				      tile_worker_func, w) == 0);
+	}
+
+	for (i = 0; i < tile_workers; i++) {
+		struct tile_worker *w = &tile_worker[i];
+
+		pthread_join(w->thread, NULL);
+		intel_batchbuffer_free(w->batch);
+		printf("worker %2d: %d tiles, %.0f tiles/sec\n", i,
+		       w->tiles_done, w->tiles_done / w->secs);
+	}
+}
+
+static void copy_tiles(unsigned *permutation)
+{
+	int i;
+
+	if (tile_workers) {
+		copy_tiles_parallel(permutation);
+		return;
+	}
+
 	for (i = 0; i < num_total_tiles; i++) {
-		/* tile_permutation is independent of current_permutation, so
-		 * abuse it to randomize the order of the src bos */
-		idx  = tile_permutation[i];
-		src_buf_idx = idx / options.tiles_per_buf;
-		src_tile = idx % options.tiles_per_buf;
-		src_buf = &buffers[current_set][src_buf_idx];
-
-		tile2xy(src_buf, src_tile, &src_x, &src_y);
-
-		dst_buf_idx = permutation[idx] / options.tiles_per_buf;
-		dst_tile = permutation[idx] % options.tiles_per_buf;
-		dst_buf = &buffers[target_set][dst_buf_idx];
-
-		tile2xy(dst_buf, dst_tile, &dst_x, &dst_y);
-
-		if (options.trace_tile == i)
-			printf("copying tile %i from %i (%i, %i) to %i (%i, %i)", i,
-				tile_permutation[i], src_buf_idx, src_tile,
-				permutation[idx], dst_buf_idx, dst_tile);
-
-		if (options.no_hw) {
-			cpucpy2d(src_buf->data,
-				 src_buf->stride / sizeof(uint32_t),
-				 src_x, src_y,
-				 dst_buf->data,
-				 dst_buf->stride / sizeof(uint32_t),
-				 dst_x, dst_y,
-				 i);
-		} else {
+		if (!options.no_hw)
 			next_copyfunc(i);
 
-			copyfunc(src_buf, src_x, src_y, dst_buf, dst_x, dst_y,
-				 i);
-		}
+		intel_pace_wait(&pace);
+		copy_one_tile(permutation, i, copyfunc);
 	}
 
 	intel_batchbuffer_flush(batch);
@@ -650,6 +942,15 @@ static void parse_options(int argc, char **argv)
 		{"tile-size", 1, 0, TILESZ},
 #define CHCK_RENDER 0xdead0003
 		{"check-render-cpyfn", 0, 0, CHCK_RENDER},
+#define BUSY_TARGET 0xdead0004
+		{"busy-target", 1, 0, BUSY_TARGET},
+#define TILE_WORKERS 0xdead0005
+		{"tile-workers", 1, 0, TILE_WORKERS},
+#define COPY_MIX 0xdead0006
+		{"copy-mix", 1, 0, COPY_MIX},
+#define PACE 0xdead0007
+		{"pace", 1, 0, PACE},
+		{"threads", 1, 0, 'n'},
 		{NULL, 0, 0, 0},
 	};
 
@@ -669,8 +970,9 @@ static void parse_options(int argc, char **argv)
 	options.tile_size = 16;
 	options.tiles_per_buf = options.scratch_buf_size / TILE_BYTES(options.tile_size);
 	options.check_render_cpyfn = 0;
+	options.num_threads = 0;
 
-	while((c = getopt_long(argc, argv, "ds:g:c:t:rbuxmo:fp:",
+	while((c = getopt_long(argc, argv, "ds:g:c:t:rbuxmo:fp:n:",
 			       long_options, &option_index)) != -1) {
 		switch(c) {
 		case 'd':
@@ -757,10 +1059,57 @@ static void parse_options(int argc, char **argv)
 			sanitize_tiles_per_buf();
 			printf("til size %i\n", options.tile_size);
 			break;
+		case BUSY_TARGET:
+			tmp = atoi(optarg);
+			if (tmp < 1 || tmp > 100)
+				printf("busy target needs to be a percentage between 1 and 100\n");
+			else {
+				printf("regulating gpu busy load to %i%%\n", tmp);
+				busy_target = tmp;
+				gpu_busy_load = 6;
+			}
+			break;
+		case TILE_WORKERS:
+			tmp = atoi(optarg);
+			if (tmp < 1 || tmp > TILE_WORKER_MAX)
+				printf("tile workers needs to be between 1 and %i\n",
+				       TILE_WORKER_MAX);
+			else {
+				printf("copying tiles with %i workers\n", tmp);
+				tile_workers = tmp;
+			}
+			break;
+		case COPY_MIX:
+			if (sscanf(optarg, "%d:%d:%d", &copy_mix[0],
+				   &copy_mix[1], &copy_mix[2]) != 3 ||
+			    copy_mix[0] < 0 || copy_mix[1] < 0 ||
+			    copy_mix[2] < 0 ||
+			    copy_mix[0] + copy_mix[1] + copy_mix[2] == 0)
+				printf("copy mix needs to be render:blit:cpu weights\n");
+			else
+				printf("using copy mix %d:%d:%d\n",
+				       copy_mix[0], copy_mix[1], copy_mix[2]);
+			break;
+		case PACE:
+			if (intel_pace_parse(&pace, optarg))
+				printf("pace needs fixed:<us>, poisson:<us> "
+				       "or trace:<file>\n");
+			else
+				printf("pacing submissions: %s\n", optarg);
+			break;
 		case CHCK_RENDER:
 			options.check_render_cpyfn = 1;
 			printf("checking render copy function\n");
 			break;
+		case 'n':
+			tmp = atoi(optarg);
+			if (tmp < 0)
+				printf("thread count needs to be non-negative\n");
+			else {
+				options.num_threads = tmp;
+				printf("using %i blitter threads\n", tmp);
+			}
+			break;
 		default:
 			printf("unkown command options\n");
 			break;
@@ -801,11 +1150,23 @@ static void init(void)
 	drm_intel_bufmgr_gem_enable_fenced_relocs(bufmgr);
 	num_fences = get_num_fences();
 	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	worker_batch = batch;
 
 	busy_bo = drm_intel_bo_alloc(bufmgr, "tiled bo", BUSY_BUF_SIZE, 4096);
 	if (options.forced_tiling >= 0)
 		gem_set_tiling(drm_fd, busy_bo->handle, options.forced_tiling, 4096);
 
+	/* When every buffer is forced linear the working set can be
+	 * carved out of a few slab bos, making setup cheap and the
+	 * layout reproducible.  The default run randomizes tiling per
+	 * buffer, which needs individual bos. */
+	if (options.forced_tiling == I915_TILING_NONE && !options.no_hw)
+		buf_arena = intel_arena_create(bufmgr,
+					       options.scratch_buf_size, 16,
+					       options.use_cpu_maps ?
+					       INTEL_ARENA_MAP_CPU :
+					       INTEL_ARENA_MAP_GTT);
+
 	for (i = 0; i < num_buffers; i++) {
 		init_buffer(&buffers[0][i], options.scratch_buf_size);
 		init_buffer(&buffers[1][i], options.scratch_buf_size);
@@ -863,8 +1224,86 @@ static void check_render_copyfunc(void)
 }
 
 
+/* Auxiliary blitter threads.  Each worker owns its batchbuffer and buffer
+ * pair outright and just hammers tiled blits between them, so the only
+ * state they share with the main coherency engine is the kernel submission
+ * path - which is exactly what we want to put under cross-thread pressure. */
+struct blt_thread {
+	pthread_t thread;
+	struct intel_batchbuffer *batch;
+	struct scratch_buf buf[2];
+};
+
+static struct blt_thread *blt_threads;
+static volatile int blt_threads_stop;
+
+static void *blt_thread_func(void *arg)
+{
+	struct blt_thread *t = arg;
+	unsigned i = 0;
+
+	while (!blt_threads_stop) {
+		struct scratch_buf *src = &t->buf[i & 1];
+		struct scratch_buf *dst = &t->buf[(i + 1) & 1];
+
+		emit_blt(t->batch, src->bo, src->offset, src->tiling,
+			 src->stride, 0, 0,
+			 options.tile_size, options.tile_size,
+			 dst->bo, dst->offset, dst->tiling, dst->stride,
+			 0, 0);
+		intel_batchbuffer_flush(t->batch);
+		i++;
+	}
+
+	return NULL;
+}
+
+static void start_blt_threads(void)
+{
+	int i;
+
+	if (options.num_threads == 0)
+		return;
+
+	blt_threads = calloc(options.num_threads, sizeof(*blt_threads));
+	assert(blt_threads);
+
+	for (i = 0; i < options.num_threads; i++) {
+		struct blt_thread *t = &blt_threads[i];
+
+		t->batch = intel_batchbuffer_alloc(bufmgr, devid);
+		init_buffer(&t->buf[0], options.scratch_buf_size);
+		init_buffer(&t->buf[1], options.scratch_buf_size);
+		assert(pthread_create(&t->thread, NULL,
+				      blt_thread_func, t) == 0);
+	}
+	printf("started %i blitter threads\n", options.num_threads);
+}
+
+static void stop_blt_threads(void)
+{
+	int i;
+
+	if (blt_threads == NULL)
+		return;
+
+	blt_threads_stop = 1;
+	for (i = 0; i < options.num_threads; i++) {
+		struct blt_thread *t = &blt_threads[i];
+
+		pthread_join(t->thread, NULL);
+		intel_batchbuffer_free(t->batch);
+		drm_intel_bo_unreference(t->buf[0].bo);
+		drm_intel_bo_unreference(t->buf[1].bo);
+	}
+	free(blt_threads);
+	blt_threads = NULL;
+}
+
 int main(int argc, char **argv)
 {
+	struct drmtest_budget budget;
+	const char *workset_path;
 	int i, j;
 	unsigned *current_permutation, *tmp_permutation;
 
@@ -873,6 +1312,9 @@ int main(int argc, char **argv)
 
 	parse_options(argc, argv);
 
+	if (busy_target)
+		intel_get_mmio(intel_get_pci_device());
+
 	/* start our little helper early before too may allocations occur */
 	if (options.use_signal_helper)
 		drmtest_fork_signal_helper();
@@ -881,6 +1323,8 @@ int main(int argc, char **argv)
 
 	check_render_copyfunc();
 
+	start_blt_threads();
+
 	tile_permutation = malloc(num_total_tiles*sizeof(uint32_t));
 	current_permutation = malloc(num_total_tiles*sizeof(uint32_t));
 	tmp_permutation = malloc(num_total_tiles*sizeof(uint32_t));
@@ -888,13 +1332,24 @@ int main(int argc, char **argv)
 	assert(current_permutation);
 	assert(tmp_permutation);
 
-	fan_out();
+	workset_path = getenv("DRMTEST_WORKSET");
+	if (!workset_path || fan_out_from_snapshot(workset_path))
+		fan_out();
+
+	/* queue per-round chatter instead of blocking the copy loop on
+	 * a slow console; atexit drains the tail on every exit path */
+	drmtest_out_start();
 
+	/* rounds are self-contained, so the budget (off unless
+	 * DRMTEST_BUDGET is set) can cut the run short after any of
+	 * them without touching the final fan-in check */
+	drmtest_budget_start(&budget, "rounds", 0);
 	for (i = 0; i < options.total_rounds; i++) {
-		printf("round %i\n", i);
+		drmtest_out_printf("round %i\n", i);
 		if (i % 64 == 63) {
 			fan_in_and_check();
-			printf("everything correct after %i rounds\n", i + 1);
+			drmtest_out_printf("everything correct after %i rounds\n",
+					   i + 1);
 		}
 
 		target_set = (current_set + 1) & 1;
@@ -913,12 +1368,20 @@ int main(int argc, char **argv)
 			tile_permutation[j] = current_permutation[tmp_permutation[j]];
 
 		current_set = target_set;
+
+		if (!drmtest_budget_more(&budget))
+			break;
 	}
+	drmtest_budget_report(&budget);
 
 	fan_in_and_check();
 
+	stop_blt_threads();
+
 	fprintf(stderr, "num failed tiles %u, max incoherent bytes %zd\n",
 		stats.num_failed, stats.max_failed_reads*sizeof(uint32_t));
+	intel_pace_print_stats(&pace, stderr);
+	intel_pace_fini(&pace);
 
 	intel_batchbuffer_free(batch);
 	drm_intel_bufmgr_destroy(bufmgr);
@@ -108,9 +108,17 @@ int main(int argc, char **argv)
 	r = drm_intel_gem_bo_map_gtt(bo);
 	assert(!r);
 
+	/* run the racing copies under scheduler pressure; the original
+	 * sigbus was timing-dependent and forced migrations shake out
+	 * more interleavings than a quiet machine would */
+	drmtest_fork_interference(INTERFERENCE_MIGRATE, 2, 100);
+	drmtest_fork_interference(INTERFERENCE_CPU, 2, 200);
+
 	r = copy_tile_threaded(bo);
 	assert(!r);
 
+	drmtest_stop_interference();
+
 	r = drm_intel_gem_bo_unmap_gtt(bo);
 	assert(!r);
 
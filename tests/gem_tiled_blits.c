@@ -89,19 +89,16 @@ create_bo(uint32_t start_val)
 	return bo;
 }
 
+/* the staging bo inside is reused across every check */
+static struct intel_readback readback;
+
 static void
 check_bo(drm_intel_bo *bo, uint32_t start_val)
 {
-	drm_intel_bo *linear_bo;
 	uint32_t *linear;
 	int i;
 
-	linear_bo = drm_intel_bo_alloc(bufmgr, "linear dst", 1024 * 1024, 4096);
-
-	intel_copy_bo(batch, linear_bo, bo, width, height);
-
-	do_or_die(drm_intel_bo_map(linear_bo, 0));
-	linear = linear_bo->virtual;
+	linear = intel_readback_map(&readback, batch, bo, width, height);
 
 	for (i = 0; i < 1024 * 1024 / 4; i++) {
 		if (linear[i] != start_val) {
@@ -112,9 +109,7 @@ check_bo(drm_intel_bo *bo, uint32_t start_val)
 		}
 		start_val++;
 	}
-	drm_intel_bo_unmap(linear_bo);
-
-	drm_intel_bo_unreference(linear_bo);
+	intel_readback_unmap(&readback);
 }
 
 int main(int argc, char **argv)
@@ -205,6 +200,7 @@ int main(int argc, char **argv)
 		bo[i] = NULL;
 	}
 
+	intel_readback_fini(&readback);
 	intel_batchbuffer_free(batch);
 	drm_intel_bufmgr_destroy(bufmgr);
 
@@ -50,6 +50,7 @@
 #include "i915_drm.h"
 #include "drmtest.h"
 #include "intel_gpu_tools.h"
+#include "intel_swizzle.h"
 
 #define WIDTH 512
 #define HEIGHT 512
@@ -96,12 +97,6 @@ create_bo(int fd)
 	return handle;
 }
 
-static int
-swizzle_bit(int bit, int offset)
-{
-	return (offset & (1 << bit)) >> (bit - 6);
-}
-
 /* Translate from a swizzled offset in the tiled buffer to the corresponding
  * value from the original linear buffer.
  */
@@ -171,63 +166,53 @@ main(int argc, char **argv)
 			len = size;
 		}
 
+		const struct intel_swizzle_table *swz;
+
+		swz = intel_swizzle_table_get(swizzle);
+		if (swz == NULL) {
+			fprintf(stderr, "Bad swizzle bits; %d\n",
+				swizzle);
+			abort();
+		}
+
 		gem_read(fd, handle, offset, linear, len);
 
 		/* Translate from offsets in the read buffer to the swizzled
 		 * address that it corresponds to.  This is the opposite of
 		 * what Mesa does (calculate offset to be read given the linear
 		 * offset it's looking for).
+		 *
+		 * The swizzle XOR is constant across each cacheline and a
+		 * cacheline never crosses a tile row, so one table lookup
+		 * and one calculate_expected() cover 16 dwords: the rest of
+		 * the cacheline follows consecutively.
 		 */
-		for (j = offset; j < offset + len; j += 4) {
-			uint32_t expected_val, found_val;
-			int swizzled_offset;
-			const char *swizzle_str;
-
-			switch (swizzle) {
-			case I915_BIT_6_SWIZZLE_NONE:
-				swizzled_offset = j;
-				swizzle_str = "none";
-				break;
-			case I915_BIT_6_SWIZZLE_9:
-				swizzled_offset = j ^
-					swizzle_bit(9, j);
-				swizzle_str = "bit9";
-				break;
-			case I915_BIT_6_SWIZZLE_9_10:
-				swizzled_offset = j ^
-					swizzle_bit(9, j) ^
-					swizzle_bit(10, j);
-				swizzle_str = "bit9^10";
-				break;
-			case I915_BIT_6_SWIZZLE_9_11:
-				swizzled_offset = j ^
-					swizzle_bit(9, j) ^
-					swizzle_bit(11, j);
-				swizzle_str = "bit9^11";
-				break;
-			case I915_BIT_6_SWIZZLE_9_10_11:
-				swizzled_offset = j ^
-					swizzle_bit(9, j) ^
-					swizzle_bit(10, j) ^
-					swizzle_bit(11, j);
-				swizzle_str = "bit9^10^11";
-				break;
-			default:
-				fprintf(stderr, "Bad swizzle bits; %d\n",
-					swizzle);
-				abort();
-			}
-			expected_val = calculate_expected(swizzled_offset);
-			found_val = linear[(j - offset) / 4];
-			if (expected_val != found_val) {
-				fprintf(stderr,
-					"Bad read [%d]: %d instead of %d at 0x%08x "
-					"for read from 0x%08x to 0x%08x, swizzle=%s\n",
-					i, found_val, expected_val, j,
-					offset, offset + len,
-					swizzle_str);
-				abort();
+		for (j = offset; j < offset + len; ) {
+			int swizzled_offset =
+				j ^ swz->bit6_xor[swizzle_cacheline(j)];
+			uint32_t expected_val =
+				calculate_expected(swizzled_offset);
+			int chunk = 64 - (j & 63);
+			int k;
+
+			if (chunk > offset + len - j)
+				chunk = offset + len - j;
+
+			for (k = 0; k < chunk / 4; k++) {
+				uint32_t found_val =
+					linear[(j - offset) / 4 + k];
+
+				if (expected_val + k != found_val) {
+					fprintf(stderr,
+						"Bad read [%d]: %d instead of %d at 0x%08x "
+						"for read from 0x%08x to 0x%08x, swizzle=%s\n",
+						i, found_val, expected_val + k,
+						j + 4*k, offset, offset + len,
+						swz->name);
+					abort();
+				}
 			}
+			j += chunk;
 		}
 	}
 
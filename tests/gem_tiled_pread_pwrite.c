@@ -59,10 +59,12 @@
 #include "i915_drm.h"
 #include "drmtest.h"
 #include "intel_gpu_tools.h"
+#include "intel_tiled_copy.h"
 
 #define WIDTH 512
 #define HEIGHT 512
 static uint32_t linear[WIDTH * HEIGHT];
+static uint32_t staging[WIDTH * HEIGHT];
 static uint32_t current_tiling_mode;
 
 #define PAGE_SIZE 4096
@@ -86,18 +88,35 @@ gem_get_tiling(int fd, uint32_t handle, uint32_t *tiling, uint32_t *swizzle)
 static uint32_t
 create_bo_and_fill(int fd)
 {
+	uint32_t tiling, swizzle;
 	uint32_t handle;
 	uint32_t *data;
 	int i;
 
 	handle = gem_create(fd, sizeof(linear));
 	gem_set_tiling(fd, handle, current_tiling_mode, WIDTH * sizeof(uint32_t));
+	gem_get_tiling(fd, handle, &tiling, &swizzle);
 
 	/* Fill the BO with dwords starting at start_val */
-	data = gem_mmap(fd, handle, sizeof(linear), PROT_READ | PROT_WRITE);
-	for (i = 0; i < WIDTH*HEIGHT; i++)
-		data[i] = i;
-	munmap(data, sizeof(linear));
+	if (intel_swizzle_supported(swizzle)) {
+		/* tile in software through a cached CPU map rather than
+		 * pushing each dword through the fenced aperture */
+		for (i = 0; i < WIDTH*HEIGHT; i++)
+			staging[i] = i;
+		data = gem_mmap__cpu(fd, handle, sizeof(linear),
+				     PROT_READ | PROT_WRITE);
+		gem_set_domain(fd, handle,
+			       I915_GEM_DOMAIN_CPU, I915_GEM_DOMAIN_CPU);
+		intel_linear_to_tiled_x(data, staging, WIDTH * sizeof(uint32_t),
+					sizeof(linear), swizzle);
+		munmap(data, sizeof(linear));
+	} else {
+		data = gem_mmap(fd, handle, sizeof(linear),
+				PROT_READ | PROT_WRITE);
+		for (i = 0; i < WIDTH*HEIGHT; i++)
+			data[i] = i;
+		munmap(data, sizeof(linear));
+	}
 
 	return handle;
 }
@@ -139,14 +158,30 @@ main(int argc, char **argv)
 		gem_write(fd, handle_target, 0, linear, sizeof(linear));
 
 		/* Check the target bo's contents. */
-		data = gem_mmap(fd, handle_target, sizeof(linear), PROT_READ | PROT_WRITE);
+		if (intel_swizzle_supported(swizzle)) {
+			/* detile in software so verification doesn't round
+			 * trip through the aperture under swap pressure */
+			data = gem_mmap__cpu(fd, handle_target, sizeof(linear),
+					     PROT_READ);
+			gem_set_domain(fd, handle_target,
+				       I915_GEM_DOMAIN_CPU, 0);
+			intel_tiled_x_to_linear(staging, data,
+						WIDTH * sizeof(uint32_t),
+						sizeof(linear), swizzle);
+			munmap(data, sizeof(linear));
+			data = staging;
+		} else {
+			data = gem_mmap(fd, handle_target, sizeof(linear),
+					PROT_READ | PROT_WRITE);
+		}
 		for (j = 0; j < WIDTH*HEIGHT; j++)
 			if (data[j] != j) {
 				fprintf(stderr, "mismatch at %i: %i\n",
 						j, data[j]);
 				exit(1);
 			}
-		munmap(data, sizeof(linear));
+		if (data != staging)
+			munmap(data, sizeof(linear));
 
 		/* Leak both bos so that we use all of system mem! */
 		gem_madvise(fd, handle_target, I915_MADV_DONTNEED);
@@ -59,6 +59,7 @@
 #include "i915_drm.h"
 #include "drmtest.h"
 #include "intel_gpu_tools.h"
+#include "intel_tiled_copy.h"
 
 #define WIDTH 512
 #define HEIGHT 512
@@ -67,20 +68,69 @@ static uint32_t current_tiling_mode;
 
 #define PAGE_SIZE 4096
 
+static uint32_t staging[WIDTH * HEIGHT];
+static uint32_t bo_swizzle;
+
+static void
+gem_get_tiling(int fd, uint32_t handle, uint32_t *tiling, uint32_t *swizzle)
+{
+	struct drm_i915_gem_get_tiling get_tiling;
+	int ret;
+
+	memset(&get_tiling, 0, sizeof(get_tiling));
+	get_tiling.handle = handle;
+
+	ret = drmIoctl(fd, DRM_IOCTL_I915_GEM_GET_TILING, &get_tiling);
+	assert(ret == 0);
+
+	*tiling = get_tiling.tiling_mode;
+	*swizzle = get_tiling.swizzle_mode;
+}
+
 static uint32_t
 create_bo_and_fill(int fd)
 {
+	uint32_t tiling;
 	uint32_t handle;
 	uint32_t *data;
 	int i;
 
-	handle = gem_create(fd, LINEAR_DWORDS);
+	handle = gem_try_create(fd, LINEAR_DWORDS);
+	if (handle == 0)
+		return 0;
 	gem_set_tiling(fd, handle, current_tiling_mode, WIDTH * sizeof(uint32_t));
+	gem_get_tiling(fd, handle, &tiling, &bo_swizzle);
 
 	/* Fill the BO with dwords starting at start_val */
-	data = gem_mmap(fd, handle, LINEAR_DWORDS, PROT_READ | PROT_WRITE);
-	if (data == NULL && errno == ENOSPC)
+	if (intel_swizzle_supported(bo_swizzle)) {
+		/* Tiling converted in software through a cached CPU map;
+		 * with more bos than ram, every aperture access would
+		 * otherwise fault a swapped-out page back in just to
+		 * linearize it. */
+		data = gem_try_mmap__cpu(fd, handle, LINEAR_DWORDS,
+					 PROT_READ | PROT_WRITE);
+		if (data == NULL) {
+			gem_close(fd, handle);
+			return 0;
+		}
+
+		gem_set_domain(fd, handle,
+			       I915_GEM_DOMAIN_CPU, I915_GEM_DOMAIN_CPU);
+		for (i = 0; i < WIDTH*HEIGHT; i++)
+			staging[i] = i;
+		intel_linear_to_tiled_x(data, staging, WIDTH * sizeof(uint32_t),
+					LINEAR_DWORDS, bo_swizzle);
+		munmap(data, LINEAR_DWORDS);
+
+		return handle;
+	}
+
+	data = gem_try_mmap__gtt(fd, handle, LINEAR_DWORDS,
+				 PROT_READ | PROT_WRITE);
+	if (data == NULL) {
+		gem_close(fd, handle);
 		return 0;
+	}
 
 	for (i = 0; i < WIDTH*HEIGHT; i++)
 		data[i] = i;
@@ -92,18 +142,158 @@ create_bo_and_fill(int fd)
 uint32_t *bo_handles;
 int *idx_arr;
 
+static double now_sec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+/* SwapTotal minus SwapFree, so the report can correlate throughput
+ * decay with how deep into swap the working set has sunk */
+static int swap_used_mb(void)
+{
+	long long total = 0, free = 0;
+	char line[128];
+	FILE *file;
+
+	file = fopen("/proc/meminfo", "r");
+	if (file == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), file)) {
+		sscanf(line, "SwapTotal: %lld kB", &total);
+		sscanf(line, "SwapFree: %lld kB", &free);
+	}
+	fclose(file);
+
+	return (total - free) / 1024;
+}
+
+/* full detile+compare is expensive, so each pass verifies every 16th
+ * bo and merely faults the rest back in one page at a time; the phase
+ * rotates with the pass number so coverage migrates over the set */
+#define THRASH_VERIFY_STRIDE 16
+
+static void
+check_bo(int fd, uint32_t handle)
+{
+	uint32_t *data;
+	int j;
+
+	if (intel_swizzle_supported(bo_swizzle)) {
+		data = gem_mmap__cpu(fd, handle, LINEAR_DWORDS, PROT_READ);
+		gem_set_domain(fd, handle,
+			       I915_GEM_DOMAIN_CPU, 0);
+		intel_tiled_x_to_linear(staging, data,
+					WIDTH * sizeof(uint32_t),
+					LINEAR_DWORDS, bo_swizzle);
+		munmap(data, LINEAR_DWORDS);
+		data = staging;
+	} else {
+		data = gem_mmap(fd, handle,
+				LINEAR_DWORDS, PROT_READ | PROT_WRITE);
+	}
+	for (j = 0; j < WIDTH*HEIGHT; j++)
+		if (data[j] != j) {
+			fprintf(stderr, "mismatch at %i: %i\n",
+					j, data[j]);
+			exit(1);
+		}
+	if (data != staging)
+		munmap(data, LINEAR_DWORDS);
+}
+
+static void
+fault_bo(int fd, uint32_t handle)
+{
+	volatile uint32_t *data;
+	uint32_t sum = 0;
+	int j;
+
+	data = gem_mmap__cpu(fd, handle, LINEAR_DWORDS, PROT_READ);
+	if (data == NULL)
+		data = gem_mmap(fd, handle, LINEAR_DWORDS,
+				PROT_READ | PROT_WRITE);
+	assert(data);
+	gem_set_domain(fd, handle, I915_GEM_DOMAIN_CPU, 0);
+
+	for (j = 0; j < LINEAR_DWORDS / 4; j += PAGE_SIZE / 4)
+		sum += data[j];
+	(void)sum;
+
+	munmap((void *)data, LINEAR_DWORDS);
+}
+
+static int
+thrash(int fd, int count, int passes)
+{
+	double t_first = 0;
+	int pass, i;
+
+	printf("thrashing %d MiB working set, %d passes\n", count, passes);
+	printf("%5s %9s %9s %9s %8s\n",
+	       "pass", "sec", "MiB/s", "decay_%", "swap_mb");
+
+	for (pass = 0; pass < passes; pass++) {
+		double t, rate;
+
+		drmtest_permute_array(idx_arr, count,
+				      drmtest_exchange_int);
+
+		t = now_sec();
+		for (i = 0; i < count; i++) {
+			uint32_t handle = bo_handles[idx_arr[i]];
+
+			if ((i + pass) % THRASH_VERIFY_STRIDE == 0)
+				check_bo(fd, handle);
+			else
+				fault_bo(fd, handle);
+		}
+		t = now_sec() - t;
+
+		rate = count / t;
+		if (pass == 0)
+			t_first = t;
+		printf("%5d %9.2f %9.1f %9.1f %8d\n",
+		       pass, t, rate, 100.0 * (t - t_first) / t_first,
+		       swap_used_mb());
+		fflush(stdout);
+	}
+
+	return 0;
+}
+
 int
 main(int argc, char **argv)
 {
+	struct gem_retry_stats retry_stats;
+	double fill_start, fill_sec;
 	int fd;
-	uint32_t *data;
-	int i, j;
+	int i;
 	int count;
+	int thrash_mode = 0, thrash_pct = 150, thrash_passes = 10;
 	current_tiling_mode = I915_TILING_X;
 
+	if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+		thrash_mode = 1;
+		if (argc > 2)
+			thrash_pct = atoi(argv[2]);
+		if (argc > 3)
+			thrash_passes = atoi(argv[3]);
+		if (thrash_pct < 100 || thrash_passes < 1) {
+			fprintf(stderr, "usage: %s -t [percent_of_ram >= 100] "
+				"[passes]\n", argv[0]);
+			exit(-1);
+		}
+	}
+
 	fd = drm_open_any();
 	/* need slightly more than total ram */
 	count = intel_get_total_ram_mb() * 11 / 10;
+	if (thrash_mode)
+		count = intel_get_total_ram_mb() * thrash_pct / 100;
 	bo_handles = calloc(count, sizeof(uint32_t));
 	assert(bo_handles);
 
@@ -120,32 +310,59 @@ main(int argc, char **argv)
 		return 77;
 	}
 
+	/* the whole overcommit has to fit, or the oom killer reaps us
+	 * instead of the test measuring anything */
+	if (thrash_mode &&
+	    intel_get_total_ram_mb() * (thrash_pct - 100) / 100 >
+	    intel_get_total_swap_mb() * 9 / 10) {
+		printf("not enough swap for %d%% of ram\n", thrash_pct);
+		return 77;
+	}
+
+	/* fill to the cliff under the retry policy; the rate we manage
+	 * right at exhaustion is part of the result, not a failure */
+	gem_retry_set_policy(GEM_RETRY_BACKOFF, 8);
+	fill_start = now_sec();
 	for (i = 0; i < count; i++) {
 		bo_handles[i] = create_bo_and_fill(fd);
 		if (bo_handles[i] == 0) {
-			printf("insufficient address space\n");
-			return 77;
+			printf("allocation cliff at %d of %d MiB\n", i, count);
+			count = i;
+			break;
 		}
 	}
+	fill_sec = now_sec() - fill_start;
+
+	gem_retry_get_stats(&retry_stats);
+	printf("filled %d MiB in %.1fs (%.1f MiB/s): "
+	       "%lu attempts, %lu denied, %lu retries "
+	       "(%.1fs backoff), %lu abandoned\n",
+	       count, fill_sec, count / fill_sec,
+	       retry_stats.attempts, retry_stats.denied, retry_stats.retries,
+	       retry_stats.slept_us / 1e6, retry_stats.gave_up);
+
+	/* with the working set no bigger than ram nothing would ever
+	 * swap, so there is still nothing to test */
+	if (count <= intel_get_total_ram_mb()) {
+		printf("insufficient address space\n");
+		return 77;
+	}
 
 	for (i = 0; i < count; i++)
 		idx_arr[i] = i;
 
+	if (thrash_mode) {
+		i = thrash(fd, count, thrash_passes);
+		close(fd);
+		return i;
+	}
+
 	drmtest_permute_array(idx_arr, count,
 			      drmtest_exchange_int);
 
-	for (i = 0; i < count/2; i++) {
+	for (i = 0; i < count/2; i++)
 		/* Check the target bo's contents. */
-		data = gem_mmap(fd, bo_handles[idx_arr[i]],
-				LINEAR_DWORDS, PROT_READ | PROT_WRITE);
-		for (j = 0; j < WIDTH*HEIGHT; j++)
-			if (data[j] != j) {
-				fprintf(stderr, "mismatch at %i: %i\n",
-						j, data[j]);
-				exit(1);
-			}
-		munmap(data, LINEAR_DWORDS);
-	}
+		check_bo(fd, bo_handles[idx_arr[i]]);
 
 	close(fd);
 
@@ -88,21 +88,7 @@ static void gem_vmap_sync(int fd, uint32_t handle)
 }
 
 static void
-gem_read(int fd, uint32_t handle, int offset, int size, void *buf)
-{
-	struct drm_i915_gem_pread pread;
-	int ret;
-
-	pread.handle = handle;
-	pread.offset = offset;
-	pread.size = size;
-	pread.data_ptr = (uintptr_t)buf;
-	ret = drmIoctl(fd, DRM_IOCTL_I915_GEM_PREAD, &pread);
-	assert(ret == 0);
-}
-
-static void
-copy(int fd, uint32_t dst, uint32_t src)
+copy(int fd, uint32_t dst, uint32_t dst_delta, uint32_t src, uint32_t src_delta)
 {
 	uint32_t batch[10];
 	struct drm_i915_gem_relocation_entry reloc[2];
@@ -130,14 +116,14 @@ copy(int fd, uint32_t dst, uint32_t src)
 	gem_write(fd, handle, 0, batch, sizeof(batch));
 
 	reloc[0].target_handle = dst;
-	reloc[0].delta = 0;
+	reloc[0].delta = dst_delta;
 	reloc[0].offset = 4 * sizeof(batch[0]);
 	reloc[0].presumed_offset = 0;
 	reloc[0].read_domains = I915_GEM_DOMAIN_RENDER;;
 	reloc[0].write_domain = I915_GEM_DOMAIN_RENDER;
 
 	reloc[1].target_handle = src;
-	reloc[1].delta = 0;
+	reloc[1].delta = src_delta;
 	reloc[1].offset = 7 * sizeof(batch[0]);
 	reloc[1].presumed_offset = 0;
 	reloc[1].read_domains = I915_GEM_DOMAIN_RENDER;;
@@ -243,6 +229,93 @@ check_gpu(int fd, uint32_t handle, uint32_t val)
 	check_cpu(linear, val);
 }
 
+/* Registration-cost isolation: the same blit loop run against (a) one
+ * big region registered once with sub-buffers addressed by reloc delta,
+ * (b) a persistent vmap handle per buffer, and (c) a fresh registration
+ * torn down around every blit.  The spread between (a)/(b) and (c) is
+ * the page pin/unpin cost, which is the number that decides whether a
+ * zero-copy capture path should hold its registrations long-term. */
+#define BENCH_BLITS 256
+
+static double
+elapsed(const struct timeval *start, const struct timeval *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_usec - start->tv_usec) / 1e6;
+}
+
+static void
+throughput(int fd)
+{
+	struct timeval start, end;
+	uint32_t *mem;
+	uint32_t src, pool, handle[2];
+	double secs;
+	int i;
+
+	mem = malloc(2 * sizeof(linear));
+	assert(mem);
+	memset(mem, 0, 2 * sizeof(linear));
+
+	src = create_bo(fd, 0);
+
+	printf("vmap blit throughput, %d blits of %zd bytes per pass:\n",
+	       BENCH_BLITS, sizeof(linear));
+
+	/* (a) pool: pages pinned once, sub-buffers are just deltas */
+	pool = gem_vmap(fd, mem, 2 * sizeof(linear), 0);
+	assert(pool);
+	copy(fd, pool, 0, src, 0);
+	gem_vmap_sync(fd, pool);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_BLITS; i++)
+		copy(fd, pool, (i & 1) * sizeof(linear), src, 0);
+	gem_vmap_sync(fd, pool);
+	gettimeofday(&end, NULL);
+	secs = elapsed(&start, &end);
+	printf("  pooled, registered once:  %8.1f blits/sec\n",
+	       BENCH_BLITS / secs);
+	gem_close(fd, pool);
+
+	/* (b) one persistent registration per buffer */
+	handle[0] = gem_vmap(fd, mem, sizeof(linear), 0);
+	handle[1] = gem_vmap(fd, mem + WIDTH*HEIGHT, sizeof(linear), 0);
+	assert(handle[0] && handle[1]);
+	copy(fd, handle[0], 0, src, 0);
+	gem_vmap_sync(fd, handle[0]);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_BLITS; i++)
+		copy(fd, handle[i & 1], 0, src, 0);
+	gem_vmap_sync(fd, handle[0]);
+	gem_vmap_sync(fd, handle[1]);
+	gettimeofday(&end, NULL);
+	secs = elapsed(&start, &end);
+	printf("  persistent per-buffer:    %8.1f blits/sec\n",
+	       BENCH_BLITS / secs);
+	gem_close(fd, handle[0]);
+	gem_close(fd, handle[1]);
+
+	/* (c) register/unregister around every blit; the sync before
+	 * close is inherent here, unpinning busy pages isn't allowed */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_BLITS; i++) {
+		uint32_t h = gem_vmap(fd, mem + (i & 1) * WIDTH*HEIGHT,
+				      sizeof(linear), 0);
+
+		assert(h);
+		copy(fd, h, 0, src, 0);
+		gem_vmap_sync(fd, h);
+		gem_close(fd, h);
+	}
+	gettimeofday(&end, NULL);
+	secs = elapsed(&start, &end);
+	printf("  re-register per blit:     %8.1f blits/sec\n",
+	       BENCH_BLITS / secs);
+
+	gem_close(fd, src);
+	free(mem);
+}
+
 static int has_vmap(int fd)
 {
 	drm_i915_getparam_t gp;
@@ -269,6 +342,11 @@ int main(int argc, char **argv)
 		return 77;
 	}
 
+	if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+		throughput(fd);
+		return 0;
+	}
+
 	count = 0;
 	if (argc > 1)
 		count = atoi(argv[1]);
@@ -311,7 +389,7 @@ int main(int argc, char **argv)
 		int src = i % count;
 		int dst = (i + 1) % count;
 
-		copy(fd, gpu[dst], cpu[src]);
+		copy(fd, gpu[dst], 0, cpu[src], 0);
 		gpu_val[dst] = cpu_val[src];
 	}
 	for (i = 0; i < count; i++)
@@ -322,7 +400,7 @@ int main(int argc, char **argv)
 		int src = (i + 1) % count;
 		int dst = i % count;
 
-		copy(fd, cpu[dst], gpu[src]);
+		copy(fd, cpu[dst], 0, gpu[src], 0);
 		cpu_val[dst] = gpu_val[src];
 	}
 	for (i = 0; i < count; i++) {
@@ -336,10 +414,10 @@ int main(int argc, char **argv)
 		int dst = random() % count;
 
 		if (random() & 1) {
-			copy(fd, gpu[dst], cpu[src]);
+			copy(fd, gpu[dst], 0, cpu[src], 0);
 			gpu_val[dst] = cpu_val[src];
 		} else {
-			copy(fd, cpu[dst], gpu[src]);
+			copy(fd, cpu[dst], 0, gpu[src], 0);
 			cpu_val[dst] = gpu_val[src];
 		}
 	}
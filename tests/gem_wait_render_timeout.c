@@ -111,6 +111,158 @@ static void blt_color_fill(struct intel_batchbuffer *batch,
 	ADVANCE_BATCH();
 }
 
+/* Wake-up latency microbenchmark (-b): submit a short fill, wait for
+ * it with each strategy in turn, and report the distribution of
+ * submit-to-wakeup times.  The GPU work per round is identical, so the
+ * spread between strategies and the fat tail within one is exactly the
+ * wake-up jitter a compositor sees per frame. */
+#define BENCH_ROUNDS 256
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+	int64_t ia = *(const int64_t *)a, ib = *(const int64_t *)b;
+
+	if (ia < ib)
+		return -1;
+	return ia > ib;
+}
+
+static void
+wait_benchmark(int fd, struct intel_batchbuffer *batch, int fill_iters)
+{
+	static const struct {
+		enum gem_wait_strategy strategy;
+		const char *name;
+	} strategies[] = {
+		{ GEM_WAIT_BLOCK,	"block" },
+		{ GEM_WAIT_SPIN,	"spin" },
+		{ GEM_WAIT_SPIN_YIELD,	"spin-yield" },
+		{ GEM_WAIT_TIMED,	"timed" },
+	};
+	int64_t lat[BENCH_ROUNDS];
+	unsigned s;
+	int i, j;
+
+	for (s = 0; s < sizeof(strategies)/sizeof(strategies[0]); s++) {
+		for (i = 0; i < BENCH_ROUNDS; i++) {
+			struct timespec start, end;
+
+			for (j = 0; j < fill_iters; j++)
+				blt_color_fill(batch, dst, BUF_PAGES);
+			intel_batchbuffer_flush(batch);
+
+			assert(clock_gettime(CLOCK_MONOTONIC_RAW,
+					     &start) == 0);
+			gem_wait_for_bo(fd, dst->handle,
+					strategies[s].strategy);
+			assert(clock_gettime(CLOCK_MONOTONIC_RAW, &end) == 0);
+
+			lat[i] = (int64_t)NSEC_PER_SEC *
+				(end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec);
+		}
+
+		qsort(lat, BENCH_ROUNDS, sizeof(lat[0]), cmp_int64);
+		printf("%-10s wait: p50 %7.1fus p90 %7.1fus p99 %7.1fus "
+		       "max %7.1fus\n", strategies[s].name,
+		       lat[BENCH_ROUNDS/2] / 1e3,
+		       lat[BENCH_ROUNDS*90/100] / 1e3,
+		       lat[BENCH_ROUNDS*99/100] / 1e3,
+		       lat[BENCH_ROUNDS-1] / 1e3);
+	}
+}
+
+/* Timeout accuracy sweep (-t): with the GPU saturated, issue timed
+ * waits from 1µs to 1s and compare requested against observed sleep.
+ * Frame budget enforcement leans on these waits, and the kernel's
+ * timer rounding at the short end is where the surprises live, so the
+ * short points get the most repetitions and we report the full error
+ * distribution rather than an average. */
+#define SWEEP_BUDGET_NS	(4 * NSEC_PER_SEC)
+#define SWEEP_MAX_REPS	1024
+#define SWEEP_MIN_REPS	8
+
+static void
+timeout_sweep(int fd, struct intel_batchbuffer *batch, int iter)
+{
+	static const uint64_t timeouts[] = {
+		1 * NSEC_PER_USEC,
+		10 * NSEC_PER_USEC,
+		100 * NSEC_PER_USEC,
+		1 * NSEC_PER_MSEC,
+		10 * NSEC_PER_MSEC,
+		100 * NSEC_PER_MSEC,
+		1 * NSEC_PER_SEC,
+	};
+	static int64_t err[SWEEP_MAX_REPS];
+	unsigned t;
+	int i, j;
+
+	printf("%12s %5s %5s %12s %12s %12s %12s\n",
+	       "requested", "reps", "early", "err_p50", "err_p90",
+	       "err_p99", "err_max");
+
+	for (t = 0; t < sizeof(timeouts)/sizeof(timeouts[0]); t++) {
+		uint64_t requested = timeouts[t];
+		int reps, early = 0;
+
+		reps = SWEEP_BUDGET_NS / requested;
+		if (reps > SWEEP_MAX_REPS)
+			reps = SWEEP_MAX_REPS;
+		if (reps < SWEEP_MIN_REPS)
+			reps = SWEEP_MIN_REPS;
+
+		for (i = 0; i < reps; i++) {
+			struct timespec start, end;
+			uint64_t timeout;
+			int ret;
+
+			/* keep the bo busy so every wait runs to
+			 * expiry; top up whenever the queue drains */
+			while (!gem_bo_busy(fd, dst2->handle)) {
+				for (j = 0; j < iter * 2; j++)
+					blt_color_fill(batch, dst2,
+						       BUF_PAGES);
+				intel_batchbuffer_flush(batch);
+			}
+
+			timeout = requested;
+			assert(clock_gettime(CLOCK_MONOTONIC_RAW,
+					     &start) == 0);
+			ret = gem_bo_wait_timeout(fd, dst2->handle,
+						  &timeout);
+			assert(clock_gettime(CLOCK_MONOTONIC_RAW,
+					     &end) == 0);
+
+			if (ret == 0) {
+				/* work completed under us; retry with
+				 * a refilled queue */
+				i--;
+				continue;
+			}
+			assert(ret == -ETIME);
+
+			err[i] = (int64_t)NSEC_PER_SEC *
+				(end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) -
+				(int64_t)requested;
+			if (err[i] < 0)
+				early++;
+		}
+
+		qsort(err, reps, sizeof(err[0]), cmp_int64);
+		printf("%9lluns %5d %5d %10.1fus %10.1fus %10.1fus %10.1fus\n",
+		       (unsigned long long)requested, reps, early,
+		       err[reps/2] / 1e3,
+		       err[reps*90/100] / 1e3,
+		       err[reps*99/100] / 1e3,
+		       err[reps-1] / 1e3);
+	}
+
+	drm_intel_bo_wait_rendering(dst2);
+}
+
 int main(int argc, char **argv)
 {
 	drm_intel_bufmgr *bufmgr;
@@ -121,6 +273,8 @@ int main(int argc, char **argv)
 				       * use less process CPU time */
 	bool done = false;
 	int i, iter = 1;
+	int benchmark = argc > 1 && strcmp(argv[1], "-b") == 0;
+	int sweep = argc > 1 && strcmp(argv[1], "-t") == 0;
 
 	fd = drm_open_any();
 
@@ -168,6 +322,18 @@ int main(int argc, char **argv)
 
 	printf("%d iters is enough work\n", iter);
 	gem_quiescent_gpu(fd);
+
+	if (benchmark) {
+		/* roughly a frame's worth of GPU work per round */
+		wait_benchmark(fd, batch, iter / 128 ?: 1);
+		return 0;
+	}
+
+	if (sweep) {
+		timeout_sweep(fd, batch, iter);
+		return 0;
+	}
+
 	if (do_signals)
 		drmtest_fork_signal_helper();
 
@@ -0,0 +1,252 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Testcase: measure recovery latency after wedging the gpu
+ *
+ * Pokes i915_wedged and then times how long until an execbuf is accepted
+ * again, and until that execbuf has actually retired, with microsecond
+ * resolution.  While the client spins, a monitor thread polls i915_wedged
+ * and i915_gem_seqno through the debugfs sampling helpers and timestamps
+ * every content change, so the printed timeline shows roughly where the
+ * kernel spent the recovery: resetting, reinitialising the rings, or
+ * sitting on blocked clients.
+ *
+ * Like the other wedging tests this may leave the machine in a state that
+ * needs a reboot on kernels where wedged is permanent, so it lives with
+ * the hang tests and is not run by default.
+ */
+
+#include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_gpu_tools.h"
+#include "intel_debugfs.h"
+
+#define MAX_EVENTS 256
+#define MONITOR_BUF 4096
+#define RECOVERY_TIMEOUT_US (10 * 1000000)
+
+struct phase_event {
+	double t_us;
+	const char *file;
+	char content[64];
+};
+
+static struct phase_event events[MAX_EVENTS];
+static int num_events;
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int monitor_stop;
+static double t_wedge_us;
+
+static double now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+static void record_event(const char *file, const char *content)
+{
+	struct phase_event *ev;
+
+	pthread_mutex_lock(&event_lock);
+	if (num_events < MAX_EVENTS) {
+		ev = &events[num_events++];
+		ev->t_us = now_us();
+		ev->file = file;
+		strncpy(ev->content, content, sizeof(ev->content) - 1);
+		ev->content[sizeof(ev->content) - 1] = '\0';
+	}
+	pthread_mutex_unlock(&event_lock);
+}
+
+static void first_line(char *buf)
+{
+	char *nl = strchr(buf, '\n');
+
+	if (nl)
+		*nl = '\0';
+}
+
+static void *monitor_thread(void *arg)
+{
+	struct debugfs_file wedged, seqno;
+	char last_wedged[MONITOR_BUF] = "";
+	char last_seqno[MONITOR_BUF] = "";
+	int have_seqno;
+
+	if (debugfs_file_open(&wedged, "i915_wedged", MONITOR_BUF))
+		return NULL;
+	/* not all kernels expose it; the wedged flag alone still gives
+	 * the reset entry/exit points */
+	have_seqno = debugfs_file_open(&seqno, "i915_gem_seqno",
+				       MONITOR_BUF) == 0;
+
+	while (!monitor_stop) {
+		if (debugfs_file_read(&wedged) > 0) {
+			first_line(wedged.buf);
+			if (strcmp(wedged.buf, last_wedged)) {
+				record_event("i915_wedged", wedged.buf);
+				strcpy(last_wedged, wedged.buf);
+			}
+		}
+		if (have_seqno && debugfs_file_read(&seqno) > 0) {
+			first_line(seqno.buf);
+			if (strcmp(seqno.buf, last_seqno)) {
+				record_event("i915_gem_seqno", seqno.buf);
+				strcpy(last_seqno, seqno.buf);
+			}
+		}
+		usleep(200);
+	}
+
+	if (have_seqno)
+		debugfs_file_close(&seqno);
+	debugfs_file_close(&wedged);
+
+	return NULL;
+}
+
+static void trigger_wedge(void)
+{
+	char path[160];
+	int fd;
+
+	if (intel_debugfs_path(path, sizeof(path) - 16)) {
+		fprintf(stderr, "i915 debugfs path not found\n");
+		exit(77);
+	}
+	strcat(path, "/i915_wedged");
+
+	fd = open(path, O_WRONLY);
+	if (fd == -1) {
+		fprintf(stderr, "can't open %s\n", path);
+		exit(77);
+	}
+
+	t_wedge_us = now_us();
+	if (write(fd, "1\n", 2) != 2) {
+		fprintf(stderr, "wedging failed\n");
+		exit(1);
+	}
+	close(fd);
+}
+
+static int try_exec(int fd, uint32_t handle)
+{
+	struct drm_i915_gem_execbuffer2 execbuf;
+	struct drm_i915_gem_exec_object2 gem_exec;
+
+	memset(&gem_exec, 0, sizeof(gem_exec));
+	gem_exec.handle = handle;
+
+	memset(&execbuf, 0, sizeof(execbuf));
+	execbuf.buffers_ptr = (uintptr_t)&gem_exec;
+	execbuf.buffer_count = 1;
+	execbuf.batch_len = 8;
+	i915_execbuffer2_set_context_id(execbuf, 0);
+
+	return drmIoctl(fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &execbuf);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t batch[2] = {MI_BATCH_BUFFER_END};
+	double t_accepted, t_retired;
+	pthread_t monitor;
+	uint32_t handle;
+	int i, fd;
+
+	fd = drm_open_any();
+
+	handle = gem_create(fd, 4096);
+	gem_write(fd, handle, 0, batch, sizeof(batch));
+
+	/* sanity: the gpu must work before we break it */
+	if (try_exec(fd, handle)) {
+		fprintf(stderr, "execbuf failed before wedging: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	gem_sync(fd, handle);
+
+	assert(pthread_create(&monitor, NULL, monitor_thread, NULL) == 0);
+
+	trigger_wedge();
+
+	/* spin on execbuf; -EIO/-EAGAIN means the kernel is still
+	 * recovering or still refusing clients */
+	for (;;) {
+		if (try_exec(fd, handle) == 0)
+			break;
+		if (errno != EIO && errno != EAGAIN) {
+			fprintf(stderr, "execbuf died with %s\n",
+				strerror(errno));
+			exit(1);
+		}
+		if (now_us() - t_wedge_us > RECOVERY_TIMEOUT_US) {
+			monitor_stop = 1;
+			pthread_join(monitor, NULL);
+			printf("no recovery within %ds - wedged is terminal "
+			       "on this kernel\n",
+			       RECOVERY_TIMEOUT_US / 1000000);
+			return 0;
+		}
+		usleep(100);
+	}
+	t_accepted = now_us();
+
+	gem_sync(fd, handle);
+	t_retired = now_us();
+
+	monitor_stop = 1;
+	pthread_join(monitor, NULL);
+
+	printf("first execbuf accepted after %.0fus, retired after %.0fus\n",
+	       t_accepted - t_wedge_us, t_retired - t_wedge_us);
+	printf("debugfs timeline (us after wedging):\n");
+	for (i = 0; i < num_events; i++)
+		printf("%10.0f %-16s %s\n", events[i].t_us - t_wedge_us,
+		       events[i].file, events[i].content);
+
+	gem_close(fd, handle);
+	close(fd);
+
+	return 0;
+}
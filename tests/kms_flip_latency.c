@@ -0,0 +1,338 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Flip-chain latency measurement.
+ *
+ * kms_flip checks that flips behave; this measures how long they take.
+ * A ring of N pre-rendered framebuffers is flipped back-to-back with
+ * nothing else in the loop - each completion event immediately issues
+ * the flip to the next fb in the chain, so the only work between flips
+ * is the ioctl itself.  The time from issuing a flip to receiving its
+ * completion event is recorded for every flip and reported as a
+ * percentile distribution per pipe, together with the sustained flip
+ * rate against the mode's refresh and a count of outliers that took
+ * more than 1.5 frames.  Outlier flips are what a user sees as a
+ * stutter, and the tail is invisible in any averaged number.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <cairo.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/select.h>
+
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_gpu_tools.h"
+#include "intel_results.h"
+
+#define MAX_FBS 8
+
+static drmModeRes *resources;
+static int drm_fd;
+static uint32_t devid;
+static int num_fbs = 4;
+static int duration = 5;
+static int outputs_tested;
+
+struct output {
+	uint32_t id;
+	drmModeConnector *connector;
+	drmModeEncoder *encoder;
+	drmModeModeInfo mode;
+	int crtc;
+	int pipe;
+	int mode_valid;
+};
+
+static unsigned long gettime_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* a bar per fb so a stuck chain is visible on the panel */
+static void paint_chain_frame(cairo_t *cr, int width, int height, void *priv)
+{
+	int frame = (long)priv;
+
+	cairo_rectangle(cr, width * frame / num_fbs, height / 2,
+			width / num_fbs, height / 8);
+	cairo_set_source_rgb(cr, (frame & 1), (frame & 2) / 2.,
+			     (frame & 4) / 4.);
+	cairo_fill(cr);
+}
+
+static void find_connector_and_mode(struct output *o, int crtc_id)
+{
+	drmModeConnector *connector;
+	drmModeEncoder *encoder = NULL;
+	int i;
+
+	o->mode_valid = 0;
+
+	connector = drmModeGetConnector(drm_fd, o->id);
+	assert(connector);
+
+	if (connector->connection != DRM_MODE_CONNECTED ||
+	    connector->count_modes == 0) {
+		drmModeFreeConnector(connector);
+		return;
+	}
+
+	o->mode = connector->modes[0];
+	for (i = 0; i < connector->count_modes; i++) {
+		if (connector->modes[i].type & DRM_MODE_TYPE_PREFERRED) {
+			o->mode = connector->modes[i];
+			break;
+		}
+	}
+
+	for (i = 0; i < connector->count_encoders; i++) {
+		encoder = drmModeGetEncoder(drm_fd, connector->encoders[i]);
+		if (encoder)
+			break;
+	}
+	if (!encoder) {
+		drmModeFreeConnector(connector);
+		return;
+	}
+
+	o->crtc = 0;
+	for (i = 0; i < resources->count_crtcs; i++) {
+		if (resources->crtcs[i] != crtc_id)
+			continue;
+		if (encoder->possible_crtcs & (1 << i))
+			o->crtc = crtc_id;
+		break;
+	}
+	if (!o->crtc) {
+		drmModeFreeEncoder(encoder);
+		drmModeFreeConnector(connector);
+		return;
+	}
+
+	o->connector = connector;
+	o->encoder = encoder;
+	o->mode_valid = 1;
+}
+
+static unsigned long flip_issue_us;
+static int flip_done;
+
+static void flip_handler(int fd, unsigned int frame, unsigned int sec,
+			 unsigned int usec, void *data)
+{
+	double *lat = data;
+
+	*lat = gettime_us() - flip_issue_us;
+	flip_done = 1;
+}
+
+static void wait_for_flip(void)
+{
+	drmEventContext evctx;
+	struct timeval timeout = { .tv_sec = 3, .tv_usec = 0 };
+	fd_set fds;
+	int ret;
+
+	memset(&evctx, 0, sizeof(evctx));
+	evctx.version = DRM_EVENT_CONTEXT_VERSION;
+	evctx.page_flip_handler = flip_handler;
+
+	flip_done = 0;
+	while (!flip_done) {
+		FD_ZERO(&fds);
+		FD_SET(drm_fd, &fds);
+		ret = select(drm_fd + 1, &fds, NULL, NULL, &timeout);
+		if (ret <= 0) {
+			fprintf(stderr, "flip event never arrived\n");
+			exit(1);
+		}
+		do_or_die(drmHandleEvent(drm_fd, &evctx));
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	if (da < db)
+		return -1;
+	return da > db;
+}
+
+static void measure_output(struct output *o)
+{
+	struct kmstest_fb fb_info[MAX_FBS];
+	unsigned int fb_ids[MAX_FBS];
+	double *lat, frame_us;
+	unsigned long start, end;
+	char metric[32];
+	long outliers = 0;
+	int flips = 0, max_flips, next, i;
+
+	printf("connector %d, pipe %d: %dx%d@%dHz, chain of %d fbs\n",
+	       o->id, o->pipe, o->mode.hdisplay, o->mode.vdisplay,
+	       o->mode.vrefresh, num_fbs);
+
+	for (i = 0; i < num_fbs; i++) {
+		fb_ids[i] = kmstest_create_fb(drm_fd, o->mode.hdisplay,
+					      o->mode.vdisplay, 32, 24, 0,
+					      &fb_info[i], paint_chain_frame,
+					      (void *)(long)i);
+		assert(fb_ids[i]);
+	}
+
+	do_or_die(drmModeSetCrtc(drm_fd, o->crtc, fb_ids[0], 0, 0,
+				 &o->id, 1, &o->mode));
+
+	/* flips can't outrun the refresh; 2x headroom for the alloc */
+	max_flips = duration * o->mode.vrefresh * 2 + 16;
+	lat = malloc(max_flips * sizeof(*lat));
+	assert(lat);
+
+	/* warm up: first flip pays for fb pinning */
+	flip_issue_us = gettime_us();
+	do_or_die(drmModePageFlip(drm_fd, o->crtc, fb_ids[1],
+				  DRM_MODE_PAGE_FLIP_EVENT, &lat[0]));
+	wait_for_flip();
+	next = 2 % num_fbs;
+
+	start = gettime_us();
+	while (flips < max_flips) {
+		flip_issue_us = gettime_us();
+		do_or_die(drmModePageFlip(drm_fd, o->crtc, fb_ids[next],
+					  DRM_MODE_PAGE_FLIP_EVENT,
+					  &lat[flips]));
+		wait_for_flip();
+		flips++;
+		next = (next + 1) % num_fbs;
+
+		if (flip_issue_us - start >= duration * 1000000ul)
+			break;
+	}
+	end = gettime_us();
+
+	frame_us = 1000000.0 / o->mode.vrefresh;
+	for (i = 0; i < flips; i++)
+		if (lat[i] > 1.5 * frame_us)
+			outliers++;
+
+	qsort(lat, flips, sizeof(*lat), cmp_double);
+	printf("  %d flips in %.2fs: %.2f flips/s (refresh %d Hz)\n",
+	       flips, (end - start) / 1e6,
+	       flips / ((end - start) / 1e6), o->mode.vrefresh);
+	printf("  latency min %6.1fus  p50 %6.1fus  p90 %6.1fus  "
+	       "p99 %6.1fus  max %8.1fus\n",
+	       lat[0], lat[flips / 2], lat[flips * 9 / 10],
+	       lat[flips * 99 / 100], lat[flips - 1]);
+	printf("  %ld outliers above 1.5 frames (%.1fus)\n",
+	       outliers, 1.5 * frame_us);
+
+	snprintf(metric, sizeof(metric), "pipe%d-p99", o->pipe);
+	intel_results_report(devid, "kms_flip_latency", metric,
+			     lat[flips * 99 / 100], "us");
+	snprintf(metric, sizeof(metric), "pipe%d-rate", o->pipe);
+	intel_results_report(devid, "kms_flip_latency", metric,
+			     flips / ((end - start) / 1e6), "flips/s");
+
+	free(lat);
+	for (i = 0; i < num_fbs; i++)
+		kmstest_remove_fb(drm_fd, fb_ids[i]);
+
+	outputs_tested++;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n fbs (2..%d)] [-t seconds]\n",
+		name, MAX_FBS);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c, cn, cr;
+
+	while ((c = getopt(argc, argv, "n:t:h")) != -1) {
+		switch (c) {
+		case 'n':
+			num_fbs = atoi(optarg);
+			break;
+		case 't':
+			duration = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (num_fbs < 2 || num_fbs > MAX_FBS || duration < 1)
+		usage(argv[0]);
+
+	drm_fd = drm_open_any();
+	devid = intel_get_drm_devid(drm_fd);
+
+	resources = drmModeGetResources(drm_fd);
+	assert(resources);
+
+	for (cn = 0; cn < resources->count_connectors; cn++) {
+		for (cr = 0; cr < resources->count_crtcs; cr++) {
+			struct output o;
+
+			memset(&o, 0, sizeof(o));
+			o.id = resources->connectors[cn];
+			o.pipe = kmstest_get_pipe_from_crtc_id(drm_fd,
+							resources->crtcs[cr]);
+
+			find_connector_and_mode(&o, resources->crtcs[cr]);
+			if (!o.mode_valid)
+				continue;
+
+			measure_output(&o);
+
+			drmModeFreeEncoder(o.encoder);
+			drmModeFreeConnector(o.connector);
+		}
+	}
+
+	drmModeFreeResources(resources);
+	close(drm_fd);
+
+	if (!outputs_tested) {
+		printf("no connected outputs, skipping\n");
+		return 77;
+	}
+
+	return 0;
+}
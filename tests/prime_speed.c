@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Benchmark: dma-buf sharing overhead between two fds of the same device
+ *
+ * Measures export and import rate, map latency on the importing side, and
+ * cross-fd copy bandwidth.  Latencies are reported as percentiles rather
+ * than averages: the sharing path takes locks in several subsystems and
+ * the occasional slow call is exactly what a frame-deadline consumer
+ * cares about.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+
+#define BO_SIZE (16*1024)
+#define COPY_SIZE (16*1024*1024)
+#define COPY_LOOPS 16
+#define LAT_SAMPLES 4096
+
+static double lat[LAT_SAMPLES];
+
+static double now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+static int cmp_latency(const void *a, const void *b)
+{
+	const double *la = a, *lb = b;
+
+	if (*la < *lb)
+		return -1;
+	return *la > *lb;
+}
+
+static void report_latency(const char *name, double *samples, int count)
+{
+	qsort(samples, count, sizeof(*samples), cmp_latency);
+	printf("%-12s min %6.1fus  p50 %6.1fus  p90 %6.1fus  p99 %6.1fus  max %8.1fus\n",
+	       name, samples[0], samples[count/2], samples[count*9/10],
+	       samples[count*99/100], samples[count-1]);
+	fflush(stdout);
+}
+
+static void bench_export_import(int fd1, int fd2)
+{
+	uint32_t handle, import;
+	int i, dma_buf_fd;
+	char *ptr;
+
+	handle = gem_create(fd1, BO_SIZE);
+
+	for (i = 0; i < LAT_SAMPLES; i++) {
+		double t = now_us();
+
+		dma_buf_fd = prime_handle_to_fd(fd1, handle);
+		lat[i] = now_us() - t;
+		close(dma_buf_fd);
+	}
+	report_latency("export", lat, LAT_SAMPLES);
+
+	dma_buf_fd = prime_handle_to_fd(fd1, handle);
+	for (i = 0; i < LAT_SAMPLES; i++) {
+		double t = now_us();
+
+		import = prime_fd_to_handle(fd2, dma_buf_fd);
+		lat[i] = now_us() - t;
+		/* drop the handle so the next pass imports afresh instead
+		 * of hitting the existing-handle lookup */
+		gem_close(fd2, import);
+	}
+	report_latency("import", lat, LAT_SAMPLES);
+
+	import = prime_fd_to_handle(fd2, dma_buf_fd);
+	for (i = 0; i < LAT_SAMPLES; i++) {
+		double t = now_us();
+
+		ptr = gem_mmap(fd2, import, BO_SIZE, PROT_READ);
+		assert(ptr);
+		/* the fault is part of the price of mapping */
+		*(volatile char *)ptr;
+		lat[i] = now_us() - t;
+		munmap(ptr, BO_SIZE);
+	}
+	report_latency("map+fault", lat, LAT_SAMPLES);
+
+	gem_close(fd2, import);
+	close(dma_buf_fd);
+	gem_close(fd1, handle);
+}
+
+static void bench_copy(int fd1, int fd2)
+{
+	uint32_t handle, import;
+	int i, dma_buf_fd;
+	double start, secs;
+	void *buf;
+
+	handle = gem_create(fd1, COPY_SIZE);
+	dma_buf_fd = prime_handle_to_fd(fd1, handle);
+	import = prime_fd_to_handle(fd2, dma_buf_fd);
+
+	buf = malloc(COPY_SIZE);
+	assert(buf);
+	memset(buf, 0x5a, COPY_SIZE);
+
+	/* warmup allocates the backing pages on both sides */
+	gem_write(fd1, handle, 0, buf, COPY_SIZE);
+	gem_read(fd2, import, 0, buf, COPY_SIZE);
+
+	start = now_us();
+	for (i = 0; i < COPY_LOOPS; i++) {
+		gem_write(fd1, handle, 0, buf, COPY_SIZE);
+		gem_read(fd2, import, 0, buf, COPY_SIZE);
+	}
+	secs = (now_us() - start) / 1e6;
+
+	printf("%-12s %.1f MiB/s (%d MiB through the shared bo, both directions)\n",
+	       "copy", 2. * COPY_LOOPS * COPY_SIZE / secs / (1024*1024),
+	       (int)(2 * COPY_LOOPS * (COPY_SIZE >> 20)));
+
+	free(buf);
+	gem_close(fd2, import);
+	close(dma_buf_fd);
+	gem_close(fd1, handle);
+}
+
+static int has_prime(int fd)
+{
+	struct drm_prime_handle args;
+	uint32_t handle;
+	int ret;
+
+	handle = gem_create(fd, BO_SIZE);
+	args.handle = handle;
+	args.flags = DRM_CLOEXEC;
+	args.fd = -1;
+	ret = drmIoctl(fd, DRM_IOCTL_PRIME_HANDLE_TO_FD, &args);
+	if (ret == 0)
+		close(args.fd);
+	gem_close(fd, handle);
+
+	return ret == 0;
+}
+
+int main(int argc, char **argv)
+{
+	int fd1, fd2;
+
+	fd1 = drm_open_any();
+	fd2 = drm_open_any();
+
+	if (!has_prime(fd1)) {
+		printf("no prime support, skipping\n");
+		return 77;
+	}
+
+	bench_export_import(fd1, fd2);
+	bench_copy(fd1, fd2);
+
+	close(fd2);
+	close(fd1);
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+#!/bin/sh
+#
+# Parallel test runner with dependency-aware scheduling.
+#
+# The suite divides into three classes:
+#  - shared: tests that only read device state (version/client queries,
+#    debugfs and sysfs readers).  These can share the GPU and are run
+#    concurrently, up to -j jobs.
+#  - exclusive: everything else.  gem_* and kms_* tests assume a quiescent
+#    GPU, so they are serialized against each other and against the
+#    shared class.
+#  - barrier: tests that leave the driver in a different state than they
+#    found it (module_reload, the ZZ_* hang tests).  These run strictly
+#    last, one at a time, matching the ordering comment in Makefile.am.
+#
+# Usage: run_parallel_tests.sh [-j jobs] [test...]
+# With no test arguments the single_kernel_tests list from the Makefile
+# is used.
+
+J=4
+while [ "$1" = "-j" ] ; do
+	shift; J=$1; shift
+done
+
+if [ $# -gt 0 ] ; then
+	tests="$*"
+else
+	tests=`make -s list-single-tests | sed -e '/TESTLIST/d'`
+fi
+
+shared=""
+exclusive=""
+barrier=""
+for t in $tests ; do
+	case "$t" in
+	ZZ_*|module_reload)
+		barrier="$barrier $t" ;;
+	getversion|getclient|getstats|debugfs_reader|sysfs_*)
+		shared="$shared $t" ;;
+	*)
+		exclusive="$exclusive $t" ;;
+	esac
+done
+
+failed=""
+passed=0
+
+# Attribute dmesg splats to the test that produced them.  Marks are per
+# test in the serialized classes; the concurrent shared class gets one
+# mark for the whole phase since attribution is ambiguous there anyway.
+DMESG_WATCH=../tools/intel_dmesg_watch
+if [ ! -x "$DMESG_WATCH" ] ; then
+	DMESG_WATCH=:
+fi
+
+report() {
+	# $1: test name, $2: exit code
+	if [ "$2" = "0" ] ; then
+		passed=`expr $passed + 1`
+		echo "PASS: $1"
+	elif [ "$2" = "77" ] ; then
+		echo "SKIP: $1"
+	else
+		failed="$failed $1"
+		echo "FAIL: $1 (exit $2)"
+	fi
+}
+
+run_one() {
+	./$1 > .$1.log 2>&1
+	echo $? > .$1.status
+}
+
+# Shared-class tests: keep up to $J in flight.
+$DMESG_WATCH -m shared-phase 2> /dev/null
+pids=""
+npids=0
+for t in $shared ; do
+	run_one $t &
+	pids="$pids $!:$t"
+	npids=`expr $npids + 1`
+	if [ $npids -ge $J ] ; then
+		wait
+		for p in $pids ; do
+			t2=${p#*:}
+			report $t2 `cat .$t2.status`
+		done
+		pids=""
+		npids=0
+	fi
+done
+wait
+for p in $pids ; do
+	t2=${p#*:}
+	report $t2 `cat .$t2.status`
+done
+$DMESG_WATCH -c 2> /dev/null || echo "DIRT: shared phase left dmesg splats"
+
+# Exclusive tests own the GPU one at a time.
+for t in $exclusive ; do
+	$DMESG_WATCH -m $t 2> /dev/null
+	./$t > .$t.log 2>&1
+	report $t $?
+	$DMESG_WATCH -c 2> /dev/null || echo "DIRT: $t left dmesg splats"
+done
+
+# Barrier tests run last, alone.
+for t in $barrier ; do
+	$DMESG_WATCH -m $t 2> /dev/null
+	./$t > .$t.log 2>&1
+	report $t $?
+	$DMESG_WATCH -c 2> /dev/null || echo "DIRT: $t left dmesg splats"
+done
+
+echo
+echo "$passed tests passed"
+if [ -n "$failed" ] ; then
+	echo "failed:$failed"
+	exit 1
+fi
+exit 0
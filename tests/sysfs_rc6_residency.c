@@ -31,6 +31,7 @@
 #include <string.h>
 #include <unistd.h>
 #include "drmtest.h"
+#include "intel_debugfs.h"
 
 #define SLEEP_DURATION 3000 // in milliseconds
 #define RC6_FUDGE 900 // in milliseconds
@@ -56,7 +57,7 @@ static unsigned int readit(const char *path)
 
 int main(int argc, char *argv[])
 {
-	const int device = drm_get_card(0);
+	char card[128];
 	char *path, *pathp, *pathpp;
 	int fd, ret;
 	unsigned int value1, value1p, value1pp, value2, value2p, value2pp;
@@ -67,7 +68,12 @@ int main(int argc, char *argv[])
 	fd = drm_open_any();
 	close(fd);
 
-	ret = asprintf(&path, "/sys/class/drm/card%d/power/rc6_enable", device);
+	if (intel_sysfs_card_path(card, sizeof(card))) {
+		printf("no i915 sysfs card directory found.\n");
+		exit(77);
+	}
+
+	ret = asprintf(&path, "%s/power/rc6_enable", card);
 	assert(ret != -1);
 
 	/* For some reason my ivb isn't idle even after syncing up with the gpu.
@@ -84,11 +90,11 @@ int main(int argc, char *argv[])
 	if (readit(path) == 0)
 		exit(EXIT_SUCCESS);
 
-	ret = asprintf(&path, "/sys/class/drm/card%d/power/rc6_residency_ms", device);
+	ret = asprintf(&path, "%s/power/rc6_residency_ms", card);
 	assert(ret != -1);
-	ret = asprintf(&pathp, "/sys/class/drm/card%d/power/rc6p_residency_ms", device);
+	ret = asprintf(&pathp, "%s/power/rc6p_residency_ms", card);
 	assert(ret != -1);
-	ret = asprintf(&pathpp, "/sys/class/drm/card%d/power/rc6pp_residency_ms", device);
+	ret = asprintf(&pathpp, "%s/power/rc6pp_residency_ms", card);
 	assert(ret != -1);
 
 	value1 = readit(path);
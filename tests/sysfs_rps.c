@@ -31,6 +31,7 @@
 #include <string.h>
 #include <unistd.h>
 #include "drmtest.h"
+#include "intel_debugfs.h"
 
 static bool verbose = false;
 static int origmin, origmax;
@@ -43,7 +44,7 @@ static int origmin, origmax;
 	} \
 } while (0);
 
-static const char sysfs_base_path[] = "/sys/class/drm/card%d/gt_%s_freq_mhz";
+static const char sysfs_base_path[] = "%s/gt_%s_freq_mhz";
 enum {
 	CUR,
 	MIN,
@@ -129,7 +130,7 @@ static void dumpit(void)
 
 int main(int argc, char *argv[])
 {
-	const int device = drm_get_card(0);
+	char card[128];
 	struct junk *junk = stuff;
 	int fd, ret;
 
@@ -140,10 +141,15 @@ int main(int argc, char *argv[])
 	fd = drm_open_any();
 	close(fd);
 
+	if (intel_sysfs_card_path(card, sizeof(card))) {
+		printf("no i915 sysfs card directory found.\n");
+		exit(77);
+	}
+
 	do {
 		int val = -1;
 		char *path;
-		ret = asprintf(&path, sysfs_base_path, device, junk->name);
+		ret = asprintf(&path, sysfs_base_path, card, junk->name);
 		assert(ret != -1);
 		junk->filp = fopen(path, junk->mode);
 		if (junk->filp == NULL) {
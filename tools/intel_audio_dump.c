@@ -31,12 +31,54 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <signal.h>
+#include <inttypes.h>
 #include <err.h>
 #include <arpa/inet.h>
+#include <sys/time.h>
 #include "intel_gpu_tools.h"
 
 static uint32_t devid;
 
+/* Trace mode: sample the audio state registers periodically and log only
+ * the transitions, with timestamps, into a small binary file.  That makes
+ * it feasible to leave the tracer running for hours and line up audio
+ * dropouts with register changes afterwards, without the read side
+ * effects and output volume of re-running the full dump in a loop.
+ *
+ * The traced sets deliberately leave out the ELD/infoframe data windows
+ * (AUD_HDMIW_HDMIEDID*, AUD_HDMIW_INFOFR*, AUD_PINW_CONNLST): reading
+ * those advances an internal access index, so polling them would corrupt
+ * the very state we are trying to observe.
+ */
+#define AUDIO_TRACE_MAGIC	0x41554454 /* "AUDT" */
+#define AUDIO_TRACE_VERSION	1
+
+struct audio_trace_reg {
+	uint32_t reg;
+	const char *name;
+};
+
+struct audio_trace_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t num_regs;
+	uint32_t period_us;
+	uint32_t pad[3];
+};
+
+struct audio_trace_name {
+	uint32_t reg;
+	char name[28];
+};
+
+struct audio_trace_record {
+	uint64_t time_us;
+	uint32_t reg_index;
+	uint32_t val;
+};
+
 
 #define BITSTO(n)		(n >= sizeof(long) * 8 ? ~0 : (1UL << (n)) - 1)
 #define BITMASK(high, low)	(BITSTO(high+1) & ~BITSTO(low))
@@ -505,6 +547,18 @@ static void dump_eaglelake(void)
     printf("\n");
 }
 
+static const struct audio_trace_reg g4x_trace_regs[] = {
+	{ AUD_CONFIG,		"AUD_CONFIG" },
+	{ AUD_PWRST,		"AUD_PWRST" },
+	{ AUD_OUT_DIG_CNVT,	"AUD_OUT_DIG_CNVT" },
+	{ AUD_OUT_CH_STR,	"AUD_OUT_CH_STR" },
+	{ AUD_OUT_STR_DESC,	"AUD_OUT_STR_DESC" },
+	{ AUD_PINW_CNTR,	"AUD_PINW_CNTR" },
+	{ AUD_CNTL_ST,		"AUD_CNTL_ST" },
+	{ AUD_HDMIW_STATUS,	"AUD_HDMIW_STATUS" },
+	{ AUD_CTS_ENABLE,	"AUD_CTS_ENABLE" },
+};
+
 #undef AUD_RID
 #undef AUD_VID_DID
 #undef AUD_PWRST
@@ -842,6 +896,23 @@ static void dump_ironlake(void)
 
 }
 
+static const struct audio_trace_reg ironlake_trace_regs[] = {
+	{ AUD_CONFIG_A,		"AUD_CONFIG_A" },
+	{ AUD_CONFIG_B,		"AUD_CONFIG_B" },
+	{ AUD_CTS_ENABLE_A,	"AUD_CTS_ENABLE_A" },
+	{ AUD_CTS_ENABLE_B,	"AUD_CTS_ENABLE_B" },
+	{ AUD_PWRST,		"AUD_PWRST" },
+	{ AUD_PORT_EN_HD_CFG,	"AUD_PORT_EN_HD_CFG" },
+	{ AUD_OUT_DIG_CNVT_A,	"AUD_OUT_DIG_CNVT_A" },
+	{ AUD_OUT_DIG_CNVT_B,	"AUD_OUT_DIG_CNVT_B" },
+	{ AUD_OUT_CH_STR,	"AUD_OUT_CH_STR" },
+	{ AUD_OUT_STR_DESC_A,	"AUD_OUT_STR_DESC_A" },
+	{ AUD_OUT_STR_DESC_B,	"AUD_OUT_STR_DESC_B" },
+	{ AUD_CNTL_ST_A,	"AUD_CNTL_ST_A" },
+	{ AUD_CNTL_ST_B,	"AUD_CNTL_ST_B" },
+	{ AUD_CNTL_ST2,		"AUD_CNTL_ST2" },
+	{ AUD_HDMIW_STATUS,	"AUD_HDMIW_STATUS" },
+};
 
 #undef AUD_CONFIG_A
 #undef AUD_MISC_CTRL_A
@@ -1370,6 +1441,30 @@ static void dump_cpt(void)
 
 }
 
+static const struct audio_trace_reg cpt_trace_regs[] = {
+	{ AUD_CONFIG_A,		"AUD_CONFIG_A" },
+	{ AUD_CONFIG_B,		"AUD_CONFIG_B" },
+	{ AUD_CONFIG_C,		"AUD_CONFIG_C" },
+	{ AUD_CTS_ENABLE_A,	"AUD_CTS_ENABLE_A" },
+	{ AUD_CTS_ENABLE_B,	"AUD_CTS_ENABLE_B" },
+	{ AUD_CTS_ENABLE_C,	"AUD_CTS_ENABLE_C" },
+	{ AUD_PWRST,		"AUD_PWRST" },
+	{ AUD_PORT_EN_HD_CFG,	"AUD_PORT_EN_HD_CFG" },
+	{ AUD_OUT_DIG_CNVT_A,	"AUD_OUT_DIG_CNVT_A" },
+	{ AUD_OUT_DIG_CNVT_B,	"AUD_OUT_DIG_CNVT_B" },
+	{ AUD_OUT_DIG_CNVT_C,	"AUD_OUT_DIG_CNVT_C" },
+	{ AUD_OUT_CH_STR,	"AUD_OUT_CH_STR" },
+	{ AUD_OUT_STR_DESC_A,	"AUD_OUT_STR_DESC_A" },
+	{ AUD_OUT_STR_DESC_B,	"AUD_OUT_STR_DESC_B" },
+	{ AUD_OUT_STR_DESC_C,	"AUD_OUT_STR_DESC_C" },
+	{ AUD_CNTL_ST_A,	"AUD_CNTL_ST_A" },
+	{ AUD_CNTL_ST_B,	"AUD_CNTL_ST_B" },
+	{ AUD_CNTL_ST_C,	"AUD_CNTL_ST_C" },
+	{ AUD_CNTRL_ST2,	"AUD_CNTRL_ST2" },
+	{ AUD_CNTRL_ST3,	"AUD_CNTRL_ST3" },
+	{ AUD_HDMIW_STATUS,	"AUD_HDMIW_STATUS" },
+};
+
 #undef AUD_CONFIG_A
 #undef AUD_MISC_CTRL_A
 #undef AUD_VID_DID
@@ -1933,36 +2028,241 @@ static void dump_hsw(void)
     printf("\n");
 }
 
+static const struct audio_trace_reg hsw_trace_regs[] = {
+	{ AUD_CONFIG_A,		"AUD_CONFIG_A" },
+	{ AUD_CONFIG_B,		"AUD_CONFIG_B" },
+	{ AUD_CONFIG_C,		"AUD_CONFIG_C" },
+	{ AUD_CTS_ENABLE_A,	"AUD_CTS_ENABLE_A" },
+	{ AUD_CTS_ENABLE_B,	"AUD_CTS_ENABLE_B" },
+	{ AUD_CTS_ENABLE_C,	"AUD_CTS_ENABLE_C" },
+	{ AUD_PWRST,		"AUD_PWRST" },
+	{ AUD_PORT_EN_HD_CFG,	"AUD_PORT_EN_HD_CFG" },
+	{ AUD_OUT_DIG_CNVT_A,	"AUD_OUT_DIG_CNVT_A" },
+	{ AUD_OUT_DIG_CNVT_B,	"AUD_OUT_DIG_CNVT_B" },
+	{ AUD_OUT_DIG_CNVT_C,	"AUD_OUT_DIG_CNVT_C" },
+	{ AUD_OUT_CHAN_MAP,	"AUD_OUT_CHAN_MAP" },
+	{ AUD_OUT_STR_DESC_A,	"AUD_OUT_STR_DESC_A" },
+	{ AUD_OUT_STR_DESC_B,	"AUD_OUT_STR_DESC_B" },
+	{ AUD_OUT_STR_DESC_C,	"AUD_OUT_STR_DESC_C" },
+	{ AUD_PIPE_CONN_SEL_CTRL, "AUD_PIPE_CONN_SEL_CTRL" },
+	{ AUD_DIP_ELD_CTRL_ST_A, "AUD_DIP_ELD_CTRL_ST_A" },
+	{ AUD_DIP_ELD_CTRL_ST_B, "AUD_DIP_ELD_CTRL_ST_B" },
+	{ AUD_DIP_ELD_CTRL_ST_C, "AUD_DIP_ELD_CTRL_ST_C" },
+	{ AUD_PIN_ELD_CP_VLD,	"AUD_PIN_ELD_CP_VLD" },
+	{ AUD_HDMIW_STATUS,	"AUD_HDMIW_STATUS" },
+};
+
+static volatile sig_atomic_t trace_stop;
+
+static void trace_sigint(int sig)
+{
+    trace_stop = 1;
+}
+
+static uint64_t trace_time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void run_trace(const char *filename, unsigned period_us,
+		      const struct audio_trace_reg *regs, unsigned num_regs)
+{
+    struct audio_trace_header hdr;
+    struct audio_trace_record rec;
+    struct audio_trace_name name;
+    uint32_t last[num_regs];
+    uint64_t samples = 0, records = 0;
+    unsigned i;
+    int primed = 0;
+    FILE *log;
+
+    log = fopen(filename, "wb");
+    if (!log)
+	    err(1, "couldn't create trace file '%s'", filename);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = AUDIO_TRACE_MAGIC;
+    hdr.version = AUDIO_TRACE_VERSION;
+    hdr.devid = devid;
+    hdr.num_regs = num_regs;
+    hdr.period_us = period_us;
+    fwrite(&hdr, sizeof(hdr), 1, log);
+
+    for (i = 0; i < num_regs; i++) {
+	    memset(&name, 0, sizeof(name));
+	    name.reg = regs[i].reg;
+	    strncpy(name.name, regs[i].name, sizeof(name.name) - 1);
+	    fwrite(&name, sizeof(name), 1, log);
+    }
+
+    signal(SIGINT, trace_sigint);
+    fprintf(stderr, "tracing %d audio registers every %uus into '%s', "
+	    "ctrl-c to stop\n", num_regs, period_us, filename);
+
+    while (!trace_stop) {
+	    int changed = 0;
+
+	    for (i = 0; i < num_regs; i++) {
+		    uint32_t val = INREG(regs[i].reg);
+
+		    if (primed && val == last[i])
+			    continue;
+
+		    rec.time_us = trace_time_us();
+		    rec.reg_index = i;
+		    rec.val = val;
+		    fwrite(&rec, sizeof(rec), 1, log);
+		    last[i] = val;
+		    changed = 1;
+		    records++;
+	    }
+	    if (changed)
+		    fflush(log);
+	    primed = 1;
+	    samples++;
+	    usleep(period_us);
+    }
+
+    fclose(log);
+    fprintf(stderr, "\n%"PRIu64" samples, %"PRIu64" transitions logged\n",
+	    samples, records);
+}
+
+static void decode_trace(const char *filename)
+{
+    struct audio_trace_header hdr;
+    struct audio_trace_record rec;
+    struct audio_trace_name *names;
+    uint64_t start_us = 0;
+    int first = 1;
+    FILE *log;
+
+    log = fopen(filename, "rb");
+    if (!log)
+	    err(1, "couldn't open trace file '%s'", filename);
+
+    if (fread(&hdr, sizeof(hdr), 1, log) != 1 ||
+	hdr.magic != AUDIO_TRACE_MAGIC)
+	    errx(1, "'%s' is not an audio trace", filename);
+    if (hdr.version != AUDIO_TRACE_VERSION)
+	    errx(1, "unsupported trace version %d", hdr.version);
+
+    names = calloc(hdr.num_regs, sizeof(*names));
+    if (fread(names, sizeof(*names), hdr.num_regs, log) != hdr.num_regs)
+	    errx(1, "truncated trace header");
+
+    printf("audio trace: devid 0x%04x, %d registers, %uus period\n\n",
+	   hdr.devid, hdr.num_regs, hdr.period_us);
+
+    while (fread(&rec, sizeof(rec), 1, log) == 1) {
+	    if (rec.reg_index >= hdr.num_regs)
+		    errx(1, "corrupt record (register index %d)",
+			 rec.reg_index);
+	    if (first) {
+		    start_us = rec.time_us;
+		    first = 0;
+	    }
+	    printf("+%10.6fs: %-24s (0x%05x) = 0x%08x\n",
+		   (rec.time_us - start_us) / 1e6,
+		   names[rec.reg_index].name,
+		   names[rec.reg_index].reg, rec.val);
+    }
+
+    free(names);
+    fclose(log);
+}
+
 int main(int argc, char **argv)
 {
 	struct pci_device *pci_dev;
+	const char *trace_file = NULL;
+	unsigned period_us = 10000;
+	int decode = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:p:dh")) != -1) {
+		switch (opt) {
+		case 't':
+			trace_file = optarg;
+			break;
+		case 'p':
+			period_us = strtoul(optarg, NULL, 0);
+			if (!period_us)
+				errx(1, "invalid sample period '%s'", optarg);
+			break;
+		case 'd':
+			decode = 1;
+			break;
+		case 'h':
+		default:
+			printf("usage: %s [-t tracefile [-p period_us]] "
+			       "[-d tracefile] [mmio dump file]\n", argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (decode) {
+		if (optind >= argc)
+			errx(1, "-d needs a trace file to decode");
+		decode_trace(argv[optind]);
+		return 0;
+	}
 
 	pci_dev = intel_get_pci_device();
 	devid = pci_dev->device_id; /* XXX not true when mapping! */
 
 	do_self_tests();
 
-	if (argc == 2)
-		intel_map_file(argv[1]);
+	if (optind < argc)
+		intel_map_file(argv[optind]);
 	else
 		intel_get_mmio(pci_dev);
 
+	if (trace_file && optind < argc)
+		errx(1, "-t needs a live device, not a dump file");
+
 	if (IS_GEN6(devid) || IS_GEN7(devid) || getenv("HAS_PCH_SPLIT")) {
 		if (IS_HASWELL(devid)) {
+			if (trace_file) {
+				run_trace(trace_file, period_us,
+					  hsw_trace_regs,
+					  ARRAY_SIZE(hsw_trace_regs));
+				return 0;
+			}
 			printf("Haswell audio registers:\n\n");
 			dump_hsw();
 			return 0;
 		}
+		intel_check_pch();
+		if (trace_file) {
+			run_trace(trace_file, period_us,
+				  cpt_trace_regs, ARRAY_SIZE(cpt_trace_regs));
+			return 0;
+		}
 		printf("%s audio registers:\n\n",
 		       IS_GEN6(devid) ? "SandyBridge" : "IvyBridge");
-		intel_check_pch();
 		dump_cpt();
 	} else if (IS_GEN5(devid)) {
+		if (trace_file) {
+			run_trace(trace_file, period_us, ironlake_trace_regs,
+				  ARRAY_SIZE(ironlake_trace_regs));
+			return 0;
+		}
 		printf("Ironlake audio registers:\n\n");
 		dump_ironlake();
 	} else if (IS_G4X(devid)) {
+		if (trace_file) {
+			run_trace(trace_file, period_us, g4x_trace_regs,
+				  ARRAY_SIZE(g4x_trace_regs));
+			return 0;
+		}
 		printf("G45 audio registers:\n\n");
 		dump_eaglelake();
+	} else if (trace_file) {
+		errx(1, "no audio trace support for devid 0x%04x", devid);
 	}
 
 	return 0;
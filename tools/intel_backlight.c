@@ -29,8 +29,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "intel_gpu_tools.h"
+#include "intel_clock.h"
 
 /* XXX PCH only today */
 
@@ -44,9 +46,89 @@ static void reg_write(uint32_t reg, uint32_t val)
 	*(volatile uint32_t *)((volatile char*)mmio + reg) = val;
 }
 
+static void set_duty_cycle(uint32_t v)
+{
+	reg_write(BLC_PWM_CPU_CTL,
+		  (reg_read(BLC_PWM_CPU_CTL) &~ BACKLIGHT_DUTY_CYCLE_MASK) | v);
+	(void) reg_read(BLC_PWM_CPU_CTL);
+}
+
+/* don't bother scheduling writes closer together than the eye (or the
+ * PWM) can resolve */
+#define RAMP_MIN_STEP_US	200
+
+/* Walk the duty cycle from its current value to the target in-process,
+ * one register write per scheduled step.  Spawning the tool once per
+ * step from a shell loop costs milliseconds of exec overhead per write
+ * and makes fades visibly steppy. */
+static void ramp(uint32_t from, uint32_t to, uint32_t max, int duration_ms)
+{
+	int delta = (int)to - (int)from;
+	uint64_t start, interval_us, worst_late = 0;
+	int steps, skips = 0, i;
+
+	steps = delta < 0 ? -delta : delta;
+	if (steps > duration_ms * 1000 / RAMP_MIN_STEP_US)
+		steps = duration_ms * 1000 / RAMP_MIN_STEP_US;
+	if (steps < 1)
+		steps = 1;
+	interval_us = duration_ms * 1000ull / steps;
+
+	intel_clock_init();
+	start = intel_clock_now();
+
+	for (i = 1; i <= steps; i++) {
+		uint64_t target_us = i * interval_us;
+		uint64_t now_us, late;
+
+		for (;;) {
+			now_us = intel_clock_to_us(intel_clock_now() - start);
+			if (now_us >= target_us)
+				break;
+			/* sleep the bulk, spin the last few usecs */
+			if (target_us - now_us > 500)
+				usleep(target_us - now_us - 500);
+		}
+
+		set_duty_cycle(from + delta * i / steps);
+
+		late = now_us - target_us;
+		if (late > worst_late)
+			worst_late = late;
+		/* a write delayed by a whole interval shows up as a
+		 * double-sized brightness jump */
+		if (late > interval_us)
+			skips++;
+	}
+
+	printf("ramped %d%% -> %d%% in %dms: %d writes, "
+	       "worst jitter %lluµs, %d flicker steps\n",
+	       from * 100 / max, to * 100 / max, duration_ms, steps,
+	       (unsigned long long)worst_late, skips);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t fade_ms] [percent]\n", name);
+	exit(1);
+}
+
 int main(int argc, char** argv)
 {
 	uint32_t current, max;
+	int duration_ms = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:h")) != -1) {
+		switch (c) {
+		case 't':
+			duration_ms = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+		}
+	}
 
 	intel_get_mmio(intel_get_pci_device());
 
@@ -55,14 +137,16 @@ int main(int argc, char** argv)
 
 	printf ("current backlight value: %d%%\n", current * 100 / max);
 
-	if (argc > 1) {
-		uint32_t v = atoi (argv[1]) * max / 100;
+	if (optind < argc) {
+		uint32_t v = atoi (argv[optind]) * max / 100;
 		if (v > max)
 			v = max;
-		reg_write(BLC_PWM_CPU_CTL,
-			  (reg_read(BLC_PWM_CPU_CTL) &~ BACKLIGHT_DUTY_CYCLE_MASK) | v);
-		(void) reg_read(BLC_PWM_CPU_CTL);
-		printf ("set backlight to %d%%\n", v * 100 / max);
+		if (duration_ms > 0) {
+			ramp(current, v, max, duration_ms);
+		} else {
+			set_duty_cycle(v);
+			printf ("set backlight to %d%%\n", v * 100 / max);
+		}
 	}
 
 	return 0;
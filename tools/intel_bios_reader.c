@@ -1,5 +1,5 @@
 /*
- * Copyright � 2006 Intel Corporation
+ * Copyright © 2006 Intel Corporation
  *
  * Permission is hereby granted, free of charge, to any person obtaining a
  * copy of this software and associated documentation files (the "Software"),
@@ -25,6 +25,7 @@
  *
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -33,6 +34,7 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
 #include "intel_bios.h"
@@ -74,9 +76,13 @@ static int tv_present;
 static int lvds_present;
 static int panel_type;
 
-static struct bdb_block *find_section(int section_id, int length)
+/* index of all BDB sections, filled in by a single walk so that
+ * individual lookups don't have to rescan the whole data block */
+static struct bdb_block section_index[256];
+static int sections_indexed;
+
+static void index_sections(int length)
 {
-	struct bdb_block *block;
 	unsigned char *base = (unsigned char *)bdb;
 	int idx = 0;
 	uint16_t total, current_size;
@@ -88,31 +94,40 @@ static struct bdb_block *find_section(int section_id, int length)
 	if (total > length)
 		total = length;
 
-	block = malloc(sizeof(*block));
-	if (!block) {
-		fprintf(stderr, "out of memory\n");
-		exit(-1);
-	}
-
-	/* walk the sections looking for section_id */
 	while (idx + 3 < total) {
 		current_id = *(base + idx);
 		current_size = *(uint16_t *)(base + idx + 1);
 		if (idx + current_size > total)
-			return NULL;
+			break;
 
-		if (current_id == section_id) {
-			block->id = current_id;
-			block->size = current_size;
-			block->data = base + idx + 3;
-			return block;
-		}
+		section_index[current_id].id = current_id;
+		section_index[current_id].size = current_size;
+		section_index[current_id].data = base + idx + 3;
 
 		idx += current_size + 3;
 	}
 
-	free(block);
-	return NULL;
+	sections_indexed = 1;
+}
+
+static struct bdb_block *find_section(int section_id, int length)
+{
+	struct bdb_block *block;
+
+	if (!sections_indexed)
+		index_sections(length);
+
+	if (!section_index[section_id].data)
+		return NULL;
+
+	block = malloc(sizeof(*block));
+	if (!block) {
+		fprintf(stderr, "out of memory\n");
+		exit(-1);
+	}
+
+	*block = section_index[section_id];
+	return block;
 }
 
 static void dump_general_features(int length)
@@ -828,27 +843,225 @@ get_device_id(unsigned char *bios)
     return device;
 }
 
+/* decoders for the individual sections, keyed by the block id they
+ * primarily describe; only the requested ones are run when a --block
+ * filter is given */
+static const struct {
+	uint8_t id;
+	void (*dump)(int length);
+} dumpers[] = {
+	{ BDB_GENERAL_FEATURES, dump_general_features },
+	{ BDB_GENERAL_DEFINITIONS, dump_general_definitions },
+	{ BDB_CHILD_DEVICE_TABLE, dump_child_devices },
+	{ BDB_LVDS_OPTIONS, dump_lvds_options },
+	{ BDB_LVDS_LFP_DATA, dump_lvds_data },
+	{ BDB_LVDS_LFP_DATA_PTRS, dump_lvds_ptr_data },
+	{ BDB_LVDS_BACKLIGHT, dump_backlight_info },
+	{ BDB_SDVO_LVDS_OPTIONS, dump_sdvo_lvds_options },
+	{ BDB_SDVO_PANEL_DTDS, dump_sdvo_panel_dtds },
+	{ BDB_DRIVER_FEATURES, dump_driver_feature },
+	{ BDB_EDP, dump_edp },
+};
+
+static uint8_t block_filter[256];
+static int filter_active;
+
+static int block_wanted(int id)
+{
+	return !filter_active || block_filter[id];
+}
+
+/* Corpus mode: the panel-compat database is rebuilt from tens of
+ * thousands of VBT dumps, and forking one reader per file makes that an
+ * hour-long job.  Scan a whole directory in-process instead: each file
+ * is mmapped, indexed once and reduced to a one-line summary of the
+ * fields the database keys on, with totals at the end. */
+
+struct corpus_stats {
+	int scanned;
+	int parsed;
+	int no_vbt;
+	int invalid;
+	int unreadable;
+};
+
+static void reset_parse_state(void)
+{
+	memset(section_index, 0, sizeof(section_index));
+	sections_indexed = 0;
+	tv_present = 0;
+	lvds_present = 0;
+	panel_type = 0;
+	bdb = NULL;
+}
+
+static void corpus_one(const char *path, struct corpus_stats *stats)
+{
+	struct vbt_header *vbt;
+	struct bdb_block *block, *data_block;
+	struct stat finfo;
+	int fd, i, vbt_off, bdb_off;
+
+	stats->scanned++;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1 || fstat(fd, &finfo) || finfo.st_size == 0) {
+		if (fd != -1)
+			close(fd);
+		stats->unreadable++;
+		return;
+	}
+
+	VBIOS = mmap(NULL, finfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (VBIOS == MAP_FAILED) {
+		stats->unreadable++;
+		return;
+	}
+
+	reset_parse_state();
+
+	for (i = 0; i + 4 < finfo.st_size; i++)
+		if (!memcmp(VBIOS + i, "$VBT", 4))
+			break;
+	if (i + 4 >= finfo.st_size) {
+		stats->no_vbt++;
+		goto out;
+	}
+	vbt_off = i;
+	vbt = (struct vbt_header *)(VBIOS + i);
+
+	bdb_off = vbt_off + vbt->bdb_offset;
+	if (bdb_off >= finfo.st_size - (int)sizeof(struct bdb_header)) {
+		stats->invalid++;
+		goto out;
+	}
+	bdb = (struct bdb_header *)(VBIOS + bdb_off);
+
+	printf("%s: VBT %d.%d BDB %d", path,
+	       vbt->version / 100, vbt->version % 100, bdb->version);
+
+	block = find_section(BDB_LVDS_OPTIONS, finfo.st_size);
+	if (block) {
+		struct bdb_lvds_options *options = block->data;
+
+		panel_type = options->panel_type;
+		printf(" panel %d", panel_type);
+		free(block);
+	}
+
+	/* preferred panel resolution, the key the database matches on */
+	data_block = NULL;
+	block = find_section(BDB_LVDS_LFP_DATA_PTRS, finfo.st_size);
+	if (block)
+		data_block = find_section(BDB_LVDS_LFP_DATA, finfo.st_size);
+	if (data_block) {
+		struct bdb_lvds_lfp_data_ptrs *ptrs = block->data;
+		int lfp_data_size = ptrs->ptr[1].fp_timing_offset -
+			ptrs->ptr[0].fp_timing_offset;
+
+		if (ptrs->lvds_entries > 0 && lfp_data_size > 0 &&
+		    (panel_type + 1) * lfp_data_size <= data_block->size) {
+			struct bdb_lvds_lfp_data *lvds_data = data_block->data;
+			struct bdb_lvds_lfp_data_entry *entry =
+				(struct bdb_lvds_lfp_data_entry *)
+				((uint8_t *)lvds_data->data +
+				 lfp_data_size * panel_type);
+
+			printf(" %dx%d", entry->fp_timing.x_res,
+			       entry->fp_timing.y_res);
+		}
+	}
+	free(data_block);
+	free(block);
+	printf("\n");
+
+	stats->parsed++;
+out:
+	munmap(VBIOS, finfo.st_size);
+	VBIOS = NULL;
+}
+
+static int run_corpus(const char *dirname)
+{
+	struct corpus_stats stats;
+	struct timeval start, end;
+	struct dirent *ent;
+	char path[4096];
+	double secs;
+	DIR *dir;
+
+	dir = opendir(dirname);
+	if (!dir) {
+		printf("Couldn't open \"%s\": %s\n", dirname, strerror(errno));
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	gettimeofday(&start, NULL);
+
+	while ((ent = readdir(dir)) != NULL) {
+		struct stat st;
+
+		snprintf(path, sizeof(path), "%s/%s", dirname, ent->d_name);
+		if (stat(path, &st) || !S_ISREG(st.st_mode))
+			continue;
+		corpus_one(path, &stats);
+	}
+	closedir(dir);
+
+	gettimeofday(&end, NULL);
+	secs = end.tv_sec - start.tv_sec + (end.tv_usec - start.tv_usec) / 1e6;
+	if (secs <= 0)
+		secs = 1e-6;
+
+	printf("corpus: %d files, %d parsed, %d without VBT, %d invalid, "
+	       "%d unreadable, %.2fs (%.0f files/sec)\n",
+	       stats.scanned, stats.parsed, stats.no_vbt, stats.invalid,
+	       stats.unreadable, secs, stats.scanned / secs);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	int fd;
 	struct vbt_header *vbt = NULL;
 	int vbt_off, bdb_off, i;
-	const char *filename = "bios";
+	const char *filename = NULL;
 	struct stat finfo;
 	struct bdb_block *block;
 	char signature[17];
 	char *devid_string;
 
-	if (argc != 2) {
-		printf("usage: %s <rom file>\n", argv[0]);
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+			unsigned long id = strtoul(argv[++i], NULL, 0);
+			if (id > 255) {
+				printf("invalid block id \"%s\"\n", argv[i]);
+				return 1;
+			}
+			block_filter[id] = 1;
+			filter_active = 1;
+		} else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+			return run_corpus(argv[++i]);
+		} else if (!filename) {
+			filename = argv[i];
+		} else {
+			filename = NULL;
+			break;
+		}
+	}
+
+	if (!filename) {
+		printf("usage: %s [--block id]... <rom file>\n"
+		       "       %s --corpus <directory>\n", argv[0], argv[0]);
 		return 1;
 	}
 
 	if ((devid_string = getenv("DEVICE")))
 	    devid = strtoul(devid_string, NULL, 0);
 
-	filename = argv[1];
-
 	fd = open(filename, O_RDONLY);
 	if (fd == -1) {
 		printf("Couldn't open \"%s\": %s\n", filename, strerror(errno));
@@ -929,19 +1142,19 @@ int main(int argc, char **argv)
 	if (devid == -1)
 	    printf("Warning: could not find PCI device ID!\n");
 
-	dump_general_features(finfo.st_size);
-	dump_general_definitions(finfo.st_size);
-	dump_child_devices(finfo.st_size);
-	dump_lvds_options(finfo.st_size);
-	dump_lvds_data(finfo.st_size);
-	dump_lvds_ptr_data(finfo.st_size);
-	dump_backlight_info(finfo.st_size);
-
-	dump_sdvo_lvds_options(finfo.st_size);
-	dump_sdvo_panel_dtds(finfo.st_size);
+	/* several blocks are indexed by the panel type from the LVDS
+	 * options block, so pick it up even when that block itself has
+	 * been filtered out */
+	block = find_section(BDB_LVDS_OPTIONS, finfo.st_size);
+	if (block) {
+		struct bdb_lvds_options *options = block->data;
+		panel_type = options->panel_type;
+		free(block);
+	}
 
-	dump_driver_feature(finfo.st_size);
-	dump_edp(finfo.st_size);
+	for (i = 0; i < sizeof(dumpers) / sizeof(dumpers[0]); i++)
+		if (block_wanted(dumpers[i].id))
+			dumpers[i].dump(finfo.st_size);
 
 	return 0;
 }
@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/* Decoder for the shadow batch capture ring written by lib/ when
+ * INTEL_BATCH_CAPTURE is set (format in intel_batchbuffer.h).  Replays
+ * the captured batches oldest first through the usual batch decoder;
+ * after a hang, the tail of this file is the submission history the
+ * kernel no longer has.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <intel_bufmgr.h>
+#include <i915_drm.h>
+
+#include "intel_gpu_tools.h"
+#include "intel_batchbuffer.h"
+#include "intel_decode_tables.h"
+
+static struct drm_intel_decode *ctx;
+static const struct intel_decode_table *quick_table;
+
+static const char *
+ring_name(uint32_t ring)
+{
+	switch (ring) {
+	case I915_EXEC_RENDER:
+		return "render";
+	case I915_EXEC_BSD:
+		return "bsd";
+	case I915_EXEC_BLT:
+		return "blt";
+	default:
+		return "default";
+	}
+}
+
+/* a stale payload dword can collide with the record magic, so insist on
+ * a sane length and a record that fits before the end of the area */
+static int
+record_valid(const uint8_t *area, uint32_t size, uint64_t off)
+{
+	const struct intel_batch_capture_record *rec;
+
+	if (off + sizeof(*rec) > size)
+		return 0;
+	rec = (const struct intel_batch_capture_record *)(area + off);
+	if (rec->magic != INTEL_BATCH_CAPTURE_REC_MAGIC)
+		return 0;
+	if (rec->len == 0 || rec->len > BATCH_SZ_MAX)
+		return 0;
+	return off + sizeof(*rec) + ((rec->len + 7) & ~7u) <= size;
+}
+
+static void
+decode_record(const struct intel_batch_capture_record *rec, uint64_t first_us)
+{
+	const uint32_t *data = (const uint32_t *)(rec + 1);
+
+	printf("batch %"PRIu64": +%.6fs, %s ring, %u dwords\n",
+	       rec->seq, (rec->time_us - first_us) / 1e6,
+	       ring_name(rec->ring), rec->len / 4);
+
+	if (quick_table) {
+		intel_quick_decode(quick_table, data, rec->len / 4, 0);
+	} else {
+		/* set_batch_pointer takes a mutable pointer but only reads */
+		drm_intel_decode_set_batch_pointer(ctx, (void *)data, 0,
+						   rec->len / 4);
+		drm_intel_decode(ctx);
+	}
+	printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct intel_batch_capture_header *hdr;
+	uint8_t *area;
+	struct stat st;
+	uint64_t off, start, first_us = 0;
+	uint64_t count = 0, skip = 0, last = 0;
+	uint32_t devid = 0;
+	int fd, c, quick = 0, headers_only = 0;
+	int pass;
+
+	static struct option long_options[] = {
+		{"devid", 1, 0, 'd'},
+		{"last", 1, 0, 'n'},
+		{"quick", 0, 0, 'q'},
+		{"summary", 0, 0, 's'},
+		{ 0 }
+	};
+
+	while ((c = getopt_long(argc, argv, "d:n:qs",
+				long_options, NULL)) != -1) {
+		switch (c) {
+		case 'd':
+			devid = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			last = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			quick = 1;
+			break;
+		case 's':
+			headers_only = 1;
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-d devid] [-n last] [-q] [-s] file\n",
+				argv[0]);
+			exit(1);
+		}
+	}
+
+	if (optind == argc)
+		errx(1, "no capture file given");
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0)
+		err(1, "cannot open %s", argv[optind]);
+	if (fstat(fd, &st))
+		err(1, "cannot stat %s", argv[optind]);
+	if (st.st_size < sizeof(*hdr))
+		errx(1, "%s is too short to be a capture file", argv[optind]);
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (hdr == MAP_FAILED)
+		err(1, "cannot map %s", argv[optind]);
+	close(fd);
+
+	if (hdr->magic != INTEL_BATCH_CAPTURE_MAGIC)
+		errx(1, "%s is not a batch capture file", argv[optind]);
+	if (hdr->version != INTEL_BATCH_CAPTURE_VERSION)
+		errx(1, "unhandled capture version %u", hdr->version);
+	if (sizeof(*hdr) + hdr->ring_size > st.st_size)
+		errx(1, "capture file truncated");
+	area = (uint8_t *)(hdr + 1);
+
+	if (devid == 0)
+		devid = hdr->devid;
+	ctx = drm_intel_decode_context_alloc(devid);
+	if (quick)
+		quick_table = intel_decode_table_get(intel_gen(devid));
+
+	printf("device 0x%04x, %"PRIu64" batches captured, "
+	       "%u MiB ring\n\n",
+	       hdr->devid, hdr->seq, hdr->ring_size >> 20);
+
+	/* Oldest surviving record: once the ring has wrapped it lives at
+	 * or just after the write offset, behind the remains of whatever
+	 * was overwritten there.  Scan forward for the first record that
+	 * still validates. */
+	start = hdr->write_offset;
+	while (start < hdr->ring_size &&
+	       !record_valid(area, hdr->ring_size, start))
+		start += 8;
+
+	/* first pass counts so -n knows where the tail begins */
+	for (pass = 0; pass < 2; pass++) {
+		int region;
+
+		if (pass == 1) {
+			skip = last && last < count ? count - last : 0;
+			count = 0;
+		}
+
+		for (region = 0; region < 2; region++) {
+			uint64_t end;
+
+			if (region == 0) {
+				off = start;
+				end = hdr->ring_size;
+			} else {
+				off = 0;
+				end = hdr->write_offset;
+			}
+
+			while (off < end &&
+			       record_valid(area, hdr->ring_size, off)) {
+				const struct intel_batch_capture_record *rec =
+					(const void *)(area + off);
+
+				if (pass == 1 && count >= skip) {
+					if (first_us == 0)
+						first_us = rec->time_us;
+					if (headers_only)
+						printf("batch %"PRIu64": "
+						       "+%.6fs, %s ring, "
+						       "%u dwords\n",
+						       rec->seq,
+						       (rec->time_us - first_us) / 1e6,
+						       ring_name(rec->ring),
+						       rec->len / 4);
+					else
+						decode_record(rec, first_us);
+				}
+				count++;
+				off += sizeof(*rec) + ((rec->len + 7) & ~7u);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Incremental kernel log scanner for the test runner.
+ *
+ * Grepping the whole dmesg once at suite end cannot say which of a
+ * hundred tests produced a splat.  This tool remembers the /dev/kmsg
+ * sequence number in a state file: the runner marks before a test and
+ * checks after it, so only the records that test emitted are scanned
+ * and any finding is attributed to it by name.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <regex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_STATE_FILE "/tmp/.intel_dmesg_watch"
+
+/* what counts as dirt; kept in sync with what ZZ_check_dmesg grepped
+ * for, plus the hangcheck and WARN signatures it missed */
+static const char *patterns[] = {
+	"\\*ERROR\\*",
+	"\\[ cut here \\]",
+	"WARNING:",
+	"[Hh]angcheck",
+	"GPU hung",
+};
+
+#define NUM_PATTERNS (sizeof(patterns)/sizeof(patterns[0]))
+
+static regex_t regs[NUM_PATTERNS];
+
+static const char *state_file(void)
+{
+	const char *env = getenv("INTEL_DMESG_WATCH_STATE");
+
+	return env ? env : DEFAULT_STATE_FILE;
+}
+
+static void compile_patterns(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_PATTERNS; i++) {
+		if (regcomp(&regs[i], patterns[i], REG_EXTENDED | REG_NOSUB)) {
+			fprintf(stderr, "bad pattern: %s\n", patterns[i]);
+			exit(1);
+		}
+	}
+}
+
+static uint64_t load_mark(char *name, size_t name_len)
+{
+	unsigned long long seq = 0;
+	char fmt[32];
+	FILE *file;
+
+	name[0] = '\0';
+	file = fopen(state_file(), "r");
+	if (file == NULL)
+		return 0;
+
+	snprintf(fmt, sizeof(fmt), "%%llu %%%zus", name_len - 1);
+	if (fscanf(file, fmt, &seq, name) < 1)
+		seq = 0;
+	fclose(file);
+
+	return seq;
+}
+
+static void save_mark(uint64_t seq, const char *name)
+{
+	FILE *file;
+
+	file = fopen(state_file(), "w");
+	if (file == NULL) {
+		perror(state_file());
+		exit(1);
+	}
+	fprintf(file, "%llu %s\n", (unsigned long long)seq,
+		name ? name : "-");
+	fclose(file);
+}
+
+/* Walk /dev/kmsg from the head.  Records newer than since_seq and
+ * matching a pattern are printed with the attribution tag; returns the
+ * number of findings and stores the newest sequence seen. */
+static int scan(uint64_t since_seq, const char *tag, uint64_t *last_seq)
+{
+	char record[8192];
+	int fd, findings = 0;
+	ssize_t len;
+
+	fd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
+	if (fd == -1) {
+		/* pre-3.5 kernel without the record interface */
+		perror("/dev/kmsg");
+		exit(77);
+	}
+
+	for (;;) {
+		unsigned long long seq;
+		char *msg;
+		int i;
+
+		len = read(fd, record, sizeof(record) - 1);
+		if (len < 0) {
+			if (errno == EPIPE)
+				continue; /* overran, reader was advanced */
+			if (errno == EAGAIN)
+				break; /* drained */
+			perror("/dev/kmsg");
+			exit(1);
+		}
+		record[len] = '\0';
+
+		if (sscanf(record, "%*u,%llu,", &seq) != 1)
+			continue;
+		*last_seq = seq;
+		if (seq <= since_seq)
+			continue;
+
+		msg = strchr(record, ';');
+		if (msg == NULL)
+			continue;
+		msg++;
+
+		for (i = 0; i < NUM_PATTERNS; i++) {
+			if (regexec(&regs[i], msg, 0, NULL, 0) == 0) {
+				printf("dmesg dirt from %s: %s", tag, msg);
+				findings++;
+				break;
+			}
+		}
+	}
+
+	close(fd);
+	return findings;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s -m <testname> | -c | -s\n"
+		"  -m  mark the current log position for <testname>\n"
+		"  -c  scan records since the mark, attribute to the marked\n"
+		"      test and advance the mark; exits 1 on findings\n"
+		"  -s  scan the whole buffer (suite-end fallback)\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char name[128];
+	uint64_t since, last = 0;
+	int findings;
+	int c;
+
+	compile_patterns();
+
+	while ((c = getopt(argc, argv, "m:csh")) != -1) {
+		switch (c) {
+		case 'm':
+			scan(UINT64_MAX, "-", &last);
+			save_mark(last, optarg);
+			return 0;
+		case 'c':
+			since = load_mark(name, sizeof(name));
+			findings = scan(since, name[0] ? name : "unknown",
+					&last);
+			save_mark(last, NULL);
+			return findings ? 1 : 0;
+		case 's':
+			findings = scan(0, "this boot", &last);
+			return findings ? 1 : 0;
+		case 'h':
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	usage(argv[0]);
+	return 1;
+}
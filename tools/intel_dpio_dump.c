@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* One-shot DPIO PHY state capture for Valleyview: sweeps the whole PHY
+ * register space through a single batched side band sequence instead of
+ * one tool invocation per register, annotates the registers we have
+ * names for, and can save/diff binary snapshots so two bring-up
+ * attempts can be compared offline.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <err.h>
+#include "intel_gpu_tools.h"
+
+/* Binary snapshot: a header and then {reg, val} pairs, devid recorded
+ * so diffs can be annotated without touching hardware. */
+#define DPIO_SNAPSHOT_MAGIC	0x53504449	/* "IDPS" */
+#define DPIO_SNAPSHOT_VERSION	1
+
+struct dpio_snapshot_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t count;		/* {reg, val} pairs following */
+};
+
+/* The blocks of the VLV DPIO PHY worth sweeping: the PLL dividers and
+ * reference controls, the per-channel lane groups, and the common
+ * calibration block.  Everything is captured by offset; the name table
+ * below annotates the registers the display code is known to program. */
+static const struct dpio_range {
+	uint32_t base, end;	/* inclusive, dword granularity */
+	const char *name;
+} dpio_ranges[] = {
+	{ 0x8000, 0x80fc, "pll" },
+	{ 0x8200, 0x82fc, "lane group 0" },
+	{ 0x8400, 0x84fc, "lane group 1" },
+	{ 0x8600, 0x86fc, "common" },
+};
+
+static const struct dpio_name {
+	uint32_t reg;
+	const char *name;
+} dpio_names[] = {
+	{ 0x800c, "DPIO_DIV_A" },
+	{ 0x8010, "DPIO_DIV_B" },
+	{ 0x8014, "DPIO_REFSFR_A" },
+	{ 0x8018, "DPIO_REFSFR_B" },
+	{ 0x801c, "DPIO_CORE_CLK_A" },
+	{ 0x8020, "DPIO_CORE_CLK_B" },
+	{ 0x8048, "DPIO_LFP_COEFF_A" },
+	{ 0x804c, "DPIO_LFP_COEFF_B" },
+	{ 0x8100, "DPIO_FASTCLK_DISABLE" },
+	{ 0x8220, "DPIO_DATA_CHANNEL1" },
+	{ 0x8420, "DPIO_DATA_CHANNEL2" },
+	{ 0x86a4, "DPIO_CALIBRATION" },
+};
+
+static const char *reg_name(uint32_t reg)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(dpio_names); i++)
+		if (dpio_names[i].reg == reg)
+			return dpio_names[i].name;
+	return "";
+}
+
+static int sweep_count(void)
+{
+	int i, count = 0;
+
+	for (i = 0; i < ARRAY_SIZE(dpio_ranges); i++)
+		count += (dpio_ranges[i].end - dpio_ranges[i].base) / 4 + 1;
+	return count;
+}
+
+static void sweep_regs(uint32_t *regs)
+{
+	uint32_t reg;
+	int i, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(dpio_ranges); i++)
+		for (reg = dpio_ranges[i].base;
+		     reg <= dpio_ranges[i].end; reg += 4)
+			regs[n++] = reg;
+}
+
+static void print_regs(const uint32_t *regs, const uint32_t *vals, int count)
+{
+	int i, r = 0;
+
+	for (i = 0; i < count; i++) {
+		if (r < ARRAY_SIZE(dpio_ranges) &&
+		    regs[i] == dpio_ranges[r].base)
+			printf("# %s block\n", dpio_ranges[r++].name);
+		printf("0x%04x : 0x%08x %s\n", regs[i], vals[i],
+		       reg_name(regs[i]));
+	}
+}
+
+static void save_snapshot(const uint32_t *regs, const uint32_t *vals,
+			  int count, uint32_t devid)
+{
+	struct dpio_snapshot_header header;
+	int i;
+
+	header.magic = DPIO_SNAPSHOT_MAGIC;
+	header.version = DPIO_SNAPSHOT_VERSION;
+	header.devid = devid;
+	header.count = count;
+
+	if (fwrite(&header, sizeof(header), 1, stdout) != 1)
+		err(1, "write");
+	for (i = 0; i < count; i++) {
+		uint32_t pair[2] = { regs[i], vals[i] };
+
+		if (fwrite(pair, sizeof(pair), 1, stdout) != 1)
+			err(1, "write");
+	}
+}
+
+static uint32_t *load_snapshot(const char *filename,
+			       struct dpio_snapshot_header *header)
+{
+	uint32_t *data;
+	ssize_t size;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(1, "%s", filename);
+
+	if (read(fd, header, sizeof(*header)) != sizeof(*header) ||
+	    header->magic != DPIO_SNAPSHOT_MAGIC)
+		errx(1, "%s: not a DPIO snapshot", filename);
+	if (header->version != DPIO_SNAPSHOT_VERSION)
+		errx(1, "%s: unknown snapshot version %d", filename,
+		     header->version);
+
+	size = header->count * 2 * sizeof(uint32_t);
+	data = malloc(size);
+	if (data == NULL)
+		err(1, "malloc");
+	if (read(fd, data, size) != size)
+		errx(1, "%s: truncated snapshot", filename);
+	close(fd);
+
+	return data;
+}
+
+static int diff_snapshots(const char *file1, const char *file2)
+{
+	struct dpio_snapshot_header h1, h2;
+	uint32_t *s1, *s2;
+	int i, changed = 0;
+
+	s1 = load_snapshot(file1, &h1);
+	s2 = load_snapshot(file2, &h2);
+
+	if (h1.count != h2.count)
+		errx(1, "snapshots cover different register sets");
+	if (h1.devid != h2.devid)
+		fprintf(stderr, "warning: snapshots from different devices "
+			"(0x%04x vs 0x%04x)\n", h1.devid, h2.devid);
+
+	for (i = 0; i < h1.count; i++) {
+		if (s1[2*i] != s2[2*i])
+			errx(1, "snapshots cover different register sets");
+		if (s1[2*i+1] == s2[2*i+1])
+			continue;
+		printf("0x%04x : 0x%08x -> 0x%08x %s\n",
+		       s1[2*i], s1[2*i+1], s2[2*i+1], reg_name(s1[2*i]));
+		changed++;
+	}
+
+	printf("%d of %d registers changed\n", changed, h1.count);
+
+	free(s1);
+	free(s2);
+	return changed != 0;
+}
+
+static void usage(const char *cmdname)
+{
+	printf("Warning : This program will work only on Valleyview\n");
+	printf("Usage: %s [-b] [-d file1 file2]\n", cmdname);
+	printf("\t (no args) : dump the PHY state with names to stdout\n");
+	printf("\t -b : write a binary snapshot to stdout\n");
+	printf("\t -d : diff two snapshots, printing changed registers\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct pci_device *dev;
+	uint32_t *regs, *vals;
+	int count, c, binary = 0;
+
+	while ((c = getopt(argc, argv, "bdh")) != -1) {
+		switch (c) {
+		case 'b':
+			binary = 1;
+			break;
+		case 'd':
+			if (argc - optind != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			return diff_snapshots(argv[optind], argv[optind + 1]);
+		default:
+			usage(argv[0]);
+			return c != 'h';
+		}
+	}
+
+	dev = intel_get_pci_device();
+	if (!IS_VALLEYVIEW(dev->device_id)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	count = sweep_count();
+	regs = malloc(count * sizeof(uint32_t));
+	vals = malloc(count * sizeof(uint32_t));
+	if (!regs || !vals)
+		err(1, "malloc");
+	sweep_regs(regs);
+
+	intel_register_access_init(dev, 0);
+	/* the whole PHY in one batched side band sequence */
+	intel_dpio_reg_read_batch(regs, vals, count);
+	intel_register_access_fini();
+
+	if (binary)
+		save_snapshot(regs, vals, count, dev->device_id);
+	else
+		print_regs(regs, vals, count);
+
+	free(regs);
+	free(vals);
+	return 0;
+}
@@ -35,34 +35,53 @@
 static void usage(char *cmdname)
 {
 	printf("Warning : This program will work only on Valleyview\n");
-	printf("Usage: %s [addr]\n", cmdname);
-	printf("\t addr : in 0xXXXX format\n");
+	printf("Usage: %s [addr] ...\n", cmdname);
+	printf("\t addr : in 0xXXXX format, several may be given\n");
 }
 
 int main(int argc, char** argv)
 {
 	int ret = 0;
-	uint32_t reg, val;
+	int i, count;
+	uint32_t *regs = NULL, *vals = NULL;
 	char *cmdname = strdup(argv[0]);
 	struct pci_device *dev = intel_get_pci_device();
 
-	if (argc != 2 || !IS_VALLEYVIEW(dev->device_id)) {
+	if (argc < 2 || !IS_VALLEYVIEW(dev->device_id)) {
 		usage(cmdname);
 		ret = 1;
 		goto out;
 	}
 
-	sscanf(argv[1], "0x%x", &reg);
+	count = argc - 1;
+	regs = malloc(count * sizeof(uint32_t));
+	vals = malloc(count * sizeof(uint32_t));
+	if (!regs || !vals)
+		err(1, "malloc");
+
+	for (i = 0; i < count; i++) {
+		if (sscanf(argv[i + 1], "0x%x", &regs[i]) != 1) {
+			usage(cmdname);
+			ret = 1;
+			goto out;
+		}
+	}
 
 	intel_register_access_init(dev, 0);
 
-	val = intel_dpio_reg_read(reg);
+	/* One mmap and one batched sweep, however many registers were
+	 * asked for. */
+	intel_dpio_reg_read_batch(regs, vals, count);
 
-	printf("Read DPIO register: 0x%x - Value : 0x%x\n", reg, val);
+	for (i = 0; i < count; i++)
+		printf("Read DPIO register: 0x%x - Value : 0x%x\n",
+		       regs[i], vals[i]);
 
 	intel_register_access_fini();
 
 out:
+	free(regs);
+	free(vals);
 	free(cmdname);
 	return ret;
 }
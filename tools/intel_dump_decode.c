@@ -37,8 +37,14 @@
 
 #include <intel_bufmgr.h>
 
+#include "intel_gpu_tools.h"
+#include "intel_decode_tables.h"
+
 struct drm_intel_decode *ctx;
 
+/* set in quick mode; decoding is then a streaming table lookup */
+static const struct intel_decode_table *quick_table;
+
 static void
 read_bin_file(const char * filename)
 {
@@ -59,8 +65,13 @@ read_bin_file(const char * filename)
 
 	offset = 0;
 	while ((ret = read (fd, buf, sizeof(buf))) > 0) {
-		drm_intel_decode_set_batch_pointer(ctx, buf, offset, ret/4);
-		drm_intel_decode(ctx);
+		if (quick_table) {
+			intel_quick_decode(quick_table, buf, ret/4, offset);
+		} else {
+			drm_intel_decode_set_batch_pointer(ctx, buf, offset,
+							   ret/4);
+			drm_intel_decode(ctx);
+		}
 		offset += ret;
 	}
 	close (fd);
@@ -113,8 +124,12 @@ read_data_file(const char * filename)
     }
 
     if (count) {
-	drm_intel_decode_set_batch_pointer(ctx, data, gtt_offset, count);
-	drm_intel_decode(ctx);
+	if (quick_table) {
+	    intel_quick_decode(quick_table, data, count, gtt_offset);
+	} else {
+	    drm_intel_decode_set_batch_pointer(ctx, data, gtt_offset, count);
+	    drm_intel_decode(ctx);
+	}
     }
 
     free (data);
@@ -162,13 +177,16 @@ main (int argc, char *argv[])
 	int option_index = 0;
 	int binary = -1;
 
+	int quick = 0;
+
 	static struct option long_options[] = {
 		{"devid", 1, 0, 'd'},
 		{"ascii", 0, 0, 'a'},
-		{"binary", 0, 0, 'b'}
+		{"binary", 0, 0, 'b'},
+		{"quick", 0, 0, 'q'}
 	};
 
-	while((c = getopt_long(argc, argv, "ab",
+	while((c = getopt_long(argc, argv, "abq",
 			       long_options, &option_index)) != -1) {
 		switch(c) {
 		case 'd':
@@ -180,6 +198,9 @@ main (int argc, char *argv[])
 		case 'a':
 			binary = 0;
 			break;
+		case 'q':
+			quick = 1;
+			break;
 		default:
 			printf("unkown command options\n");
 			break;
@@ -187,6 +208,8 @@ main (int argc, char *argv[])
 	}
 
 	ctx = drm_intel_decode_context_alloc(devid);
+	if (quick)
+		quick_table = intel_decode_table_get(intel_gen(devid));
 
 	if (optind == argc) {
 		fprintf(stderr, "no input file given\n");
@@ -40,6 +40,7 @@
  */
 
 #define _GNU_SOURCE
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -55,6 +56,19 @@
 #include "intel_chipset.h"
 #include "intel_gpu_tools.h"
 #include "instdone.h"
+#include "intel_decode_tables.h"
+
+#include <pthread.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/* -q: stream the buffers through the compiled per-gen decode tables
+ * instead of libdrm's full decoder; the table is picked once when the
+ * PCI ID line is seen. */
+static int quick;
+static const struct intel_decode_table *quick_table;
 
 static void
 print_instdone (uint32_t devid, unsigned int instdone, unsigned int instdone1)
@@ -274,25 +288,191 @@ print_fence(unsigned int devid, uint64_t fence)
 	}
 }
 
+/* Fast path for the overwhelmingly common "offset : value" dword lines.
+ * sscanf dominates the runtime when streaming multi-gigabyte error states
+ * through the decoder, so parse these by hand and only fall back to the
+ * sscanf matchers for header lines.  Returns the number of fields parsed,
+ * mirroring sscanf. */
+static int
+parse_dword_line (const char *line, uint32_t *offset, uint32_t *value)
+{
+    char *next;
+
+    *offset = strtoul (line, &next, 16);
+    if (next == line)
+	return 0;
+    while (*next == ' ')
+	next++;
+    if (*next != ':')
+	return 0;
+    line = next + 1;
+    *value = strtoul (line, &next, 16);
+    if (next == line)
+	return 1;
+    return 2;
+}
+
+/* Input buffering for streaming decode; reading an error state through
+ * the default stdio buffer costs a read syscall every few lines. */
+#define INPUT_BUF_SZ (1 << 20)
+static char input_buf[INPUT_BUF_SZ];
+
+/* The captured buffers in an error state are independent, so decode
+ * runs in three phases: a serial parse splitting the file into an
+ * ordered list of segments (header text or one captured buffer), a
+ * worker pool decoding the buffer segments into per-segment
+ * memstreams, and a serial stitch printing everything in the original
+ * order.  Only the parse and the stitch touch stdout. */
+struct decode_segment {
+    /* header text when data is NULL, otherwise a captured buffer */
+    char *text;
+    size_t text_len, text_alloced;
+
+    char *ring_name;
+    int is_batch;
+    uint32_t gtt_offset;
+    uint32_t *data;
+    int count;
+
+    char *out;		/* decoded output, filled in by a worker */
+    size_t out_len;
+};
+
+static struct decode_segment *segments;
+static int num_segments;
+
+static uint32_t decode_devid = PCI_CHIP_I855_GM;
+static uint32_t decode_acthd;
+static int have_acthd;
+static int num_decode_threads;
+
+static struct decode_segment *
+segment_new (void)
+{
+    struct decode_segment *seg;
+
+    segments = realloc (segments, (num_segments + 1) * sizeof (*segments));
+    assert (segments);
+    seg = &segments[num_segments++];
+    memset (seg, 0, sizeof (*seg));
+    return seg;
+}
+
+static struct decode_segment *
+segment_text (void)
+{
+    if (num_segments && segments[num_segments - 1].text)
+	return &segments[num_segments - 1];
+    return segment_new ();
+}
+
+static void
+segment_append_line (struct decode_segment *seg, const char *line, size_t len)
+{
+    if (seg->text_len + len + 1 > seg->text_alloced) {
+	seg->text_alloced = (seg->text_alloced + len + 1) * 2;
+	seg->text = realloc (seg->text, seg->text_alloced);
+	assert (seg->text);
+    }
+    memcpy (seg->text + seg->text_len, line, len);
+    seg->text_len += len;
+    seg->text[seg->text_len] = '\0';
+}
+
+static void *
+decode_worker (void *arg)
+{
+    int tid = *(int *) arg;
+    struct drm_intel_decode *ctx = NULL;
+    int i;
+
+    if (!quick_table) {
+	ctx = drm_intel_decode_context_alloc (decode_devid);
+	if (ctx && have_acthd)
+	    drm_intel_decode_set_head_tail (ctx, decode_acthd, 0xffffffff);
+    }
+
+    for (i = tid; i < num_segments; i += num_decode_threads) {
+	struct decode_segment *seg = &segments[i];
+	FILE *out;
+
+	if (seg->text)
+	    continue;
+
+	out = open_memstream (&seg->out, &seg->out_len);
+	assert (out);
+	if (quick_table) {
+	    intel_quick_decode_file (quick_table, seg->data, seg->count,
+				     seg->gtt_offset, out);
+	} else if (ctx) {
+	    drm_intel_decode_set_output_file (ctx, out);
+	    drm_intel_decode_set_batch_pointer (ctx, seg->data,
+						seg->gtt_offset, seg->count);
+	    drm_intel_decode (ctx);
+	}
+	fclose (out);
+    }
+
+    if (ctx)
+	drm_intel_decode_context_free (ctx);
+    return NULL;
+}
+
+/* Header-line annotations, printed at stitch time so they land in the
+ * original order relative to the decoded buffers. */
+static void
+print_header_line (const char *line)
+{
+    long long unsigned fence;
+    unsigned int reg;
+    int matched;
+
+    printf("%s", line);
+
+    matched = sscanf (line, "PCI ID: 0x%04x\n", &reg);
+    if (matched == 0)
+	    matched = sscanf (line, " PCI ID: 0x%04x\n", &reg);
+    if (matched == 1)
+	    printf("Detected GEN%i chipset\n", intel_gen(reg));
+
+    matched = sscanf (line, "  PGTBL_ER: 0x%08x\n", &reg);
+    if (matched == 1 && reg)
+	    print_pgtbl_err(reg, decode_devid);
+
+    matched = sscanf (line, "  INSTDONE: 0x%08x\n", &reg);
+    if (matched == 1)
+	print_instdone (decode_devid, reg, -1);
+
+    matched = sscanf (line, "  INSTDONE1: 0x%08x\n", &reg);
+    if (matched == 1)
+	print_instdone (decode_devid, -1, reg);
+
+    matched = sscanf (line, "  fence[%i] = %Lx\n", &reg, &fence);
+    if (matched == 2)
+	print_fence (decode_devid, fence);
+}
+
 static void
 read_data_file (FILE *file)
 {
-    struct drm_intel_decode *decode_ctx = NULL;
-    uint32_t devid = PCI_CHIP_I855_GM;
     uint32_t *data = NULL;
-    long long unsigned fence;
-    int data_size = 0, count = 0, line_number = 0, matched;
+    int data_size = 0, count = 0, matched;
     char *line = NULL;
     size_t line_size;
+    ssize_t len;
     uint32_t offset, value;
     uint32_t gtt_offset = 0, new_gtt_offset;
     const char *buffer_type[2] = {  "ringbuffer", "batchbuffer" };
     char *ring_name = NULL;
     int is_batch = 1;
+    pthread_t *threads;
+    int *tids;
+    int i;
+
+    setvbuf (file, input_buf, _IOFBF, INPUT_BUF_SZ);
 
-    while (getline (&line, &line_size, file) > 0) {
+    while ((len = getline (&line, &line_size, file)) > 0) {
 	char *dashes;
-	line_number++;
 
 	dashes = strstr(line, "---");
 	if (dashes) {
@@ -302,97 +482,70 @@ read_data_file (FILE *file)
 
 		matched = sscanf (dashes, "--- gtt_offset = 0x%08x\n",
 				  &new_gtt_offset);
+		if (matched == 0)
+			matched = sscanf (dashes, "--- ringbuffer = 0x%08x\n",
+					  &new_gtt_offset);
 		if (matched == 1) {
 			if (count) {
-				printf("%s (%s) at 0x%08x:\n",
-				       buffer_type[is_batch],
-				       ring_name,
-				       gtt_offset);
-				drm_intel_decode_set_batch_pointer(decode_ctx,
-								   data, gtt_offset,
-								   count);
-				drm_intel_decode(decode_ctx);
+				struct decode_segment *seg = segment_new ();
+
+				seg->ring_name = ring_name;
+				seg->is_batch = is_batch;
+				seg->gtt_offset = gtt_offset;
+				seg->data = data;
+				seg->count = count;
+				ring_name = NULL;
+				data = NULL;
+				data_size = 0;
 				count = 0;
 			}
 			gtt_offset = new_gtt_offset;
-			is_batch = 1;
-			free(ring_name);
-			ring_name = new_ring_name;
-			continue;
-		}
-
-		matched = sscanf (dashes, "--- ringbuffer = 0x%08x\n",
-				  &new_gtt_offset);
-		if (matched == 1) {
-			if (count) {
-				printf("%s (%s) at 0x%08x:\n",
-				       buffer_type[is_batch],
-				       ring_name,
-				       gtt_offset);
-				drm_intel_decode_set_batch_pointer(decode_ctx,
-								   data, gtt_offset,
-								   count);
-				drm_intel_decode(decode_ctx);
-				count = 0;
-			}
-			gtt_offset = new_gtt_offset;
-			is_batch = 0;
+			is_batch = strstr (dashes, "ringbuffer") == NULL;
 			free(ring_name);
 			ring_name = new_ring_name;
 			continue;
 		}
+		free(new_ring_name);
 	}
 
-	matched = sscanf (line, "%08x : %08x", &offset, &value);
+	matched = parse_dword_line (line, &offset, &value);
 	if (matched != 2) {
 	    unsigned int reg;
 
 	    /* display reg section is after the ringbuffers, don't mix them */
 	    if (count) {
-		    printf("%s (%s) at 0x%08x:\n",
-			   buffer_type[is_batch],
-			   ring_name,
-			   gtt_offset);
-		    drm_intel_decode_set_batch_pointer(decode_ctx,
-						       data, gtt_offset,
-						       count);
-		    drm_intel_decode(decode_ctx);
+		    struct decode_segment *seg = segment_new ();
+
+		    seg->ring_name = ring_name;
+		    seg->is_batch = is_batch;
+		    seg->gtt_offset = gtt_offset;
+		    seg->data = data;
+		    seg->count = count;
+		    ring_name = strdup (ring_name);
+		    data = NULL;
+		    data_size = 0;
 		    count = 0;
 	    }
 
-	    printf("%s", line);
-
+	    /* the workers need the chipset and head pointer before the
+	     * stitch prints these lines */
 	    matched = sscanf (line, "PCI ID: 0x%04x\n", &reg);
 	    if (matched == 0)
 		    matched = sscanf (line, " PCI ID: 0x%04x\n", &reg);
 	    if (matched == 1) {
-		    devid = reg;
-		    printf("Detected GEN%i chipset\n",
-			   intel_gen(devid));
-
-		    decode_ctx = drm_intel_decode_context_alloc(devid);
+		    decode_devid = reg;
+		    if (quick)
+			    quick_table =
+				    intel_decode_table_get(intel_gen(reg));
 	    }
 
 	    matched = sscanf (line, "  ACTHD: 0x%08x\n", &reg);
-	    if (matched == 1)
-		    drm_intel_decode_set_head_tail(decode_ctx, reg, 0xffffffff);
-
-	    matched = sscanf (line, "  PGTBL_ER: 0x%08x\n", &reg);
-	    if (matched == 1 && reg)
-		    print_pgtbl_err(reg, devid);
-
-	    matched = sscanf (line, "  INSTDONE: 0x%08x\n", &reg);
-	    if (matched == 1)
-		print_instdone (devid, reg, -1);
-
-	    matched = sscanf (line, "  INSTDONE1: 0x%08x\n", &reg);
-	    if (matched == 1)
-		print_instdone (devid, -1, reg);
-
-	    matched = sscanf (line, "  fence[%i] = %Lx\n", &reg, &fence); 
-	    if (matched == 2)
-		print_fence (devid, fence);
+	    if (matched == 1) {
+		    decode_acthd = reg;
+		    have_acthd = 1;
+	    }
 
+	    segment_append_line (segment_text (), line, len);
 	    continue;
 	}
 
@@ -411,21 +564,289 @@ read_data_file (FILE *file)
     }
 
     if (count) {
-	printf("%s (%s) at 0x%08x:\n",
-	       buffer_type[is_batch],
-	       ring_name,
-	       gtt_offset);
-	drm_intel_decode_set_batch_pointer(decode_ctx,
-					   data, gtt_offset,
-					   count);
-	drm_intel_decode(decode_ctx);
+	struct decode_segment *seg = segment_new ();
+
+	seg->ring_name = ring_name;
+	seg->is_batch = is_batch;
+	seg->gtt_offset = gtt_offset;
+	seg->data = data;
+	seg->count = count;
+	ring_name = NULL;
+	data = NULL;
+    }
+
+    num_decode_threads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (num_decode_threads < 1)
+	num_decode_threads = 1;
+    if (num_decode_threads > num_segments)
+	num_decode_threads = num_segments ? num_segments : 1;
+
+    threads = malloc (num_decode_threads * sizeof (*threads));
+    tids = malloc (num_decode_threads * sizeof (*tids));
+    assert (threads && tids);
+    for (i = 0; i < num_decode_threads; i++) {
+	tids[i] = i;
+	pthread_create (&threads[i], NULL, decode_worker, &tids[i]);
+    }
+    for (i = 0; i < num_decode_threads; i++)
+	pthread_join (threads[i], NULL);
+    free (threads);
+    free (tids);
+
+    for (i = 0; i < num_segments; i++) {
+	struct decode_segment *seg = &segments[i];
+
+	if (seg->text) {
+	    char *cur = seg->text;
+
+	    while (*cur) {
+		char *nl = strchr (cur, '\n');
+		size_t n = nl ? (size_t)(nl - cur) + 1 : strlen (cur);
+		char saved = cur[n];
+
+		cur[n] = '\0';
+		print_header_line (cur);
+		cur[n] = saved;
+		cur += n;
+	    }
+	    free (seg->text);
+	} else {
+	    printf("%s (%s) at 0x%08x:\n",
+		   buffer_type[seg->is_batch],
+		   seg->ring_name,
+		   seg->gtt_offset);
+	    if (seg->out)
+		fwrite (seg->out, 1, seg->out_len, stdout);
+	    free (seg->out);
+	    free (seg->data);
+	    free (seg->ring_name);
+	}
     }
+    free (segments);
+    segments = NULL;
+    num_segments = 0;
 
     free (data);
     free (line);
     free (ring_name);
 }
 
+
+#ifdef HAVE_ZLIB
+/* Error states straight off a crash spool are usually gzipped.  If the
+ * input starts with the gzip magic, inflate it into a tmpfile and hand
+ * that back, so the line parser above never has to care.  Only works on
+ * seekable files; compressed input on stdin still needs zcat. */
+static FILE *
+maybe_decompress (FILE *file)
+{
+    unsigned char in[65536], out[65536];
+    z_stream zs;
+    FILE *tmp;
+    int ret;
+
+    if (fread (in, 1, 2, file) != 2 || in[0] != 0x1f || in[1] != 0x8b) {
+	fseek (file, 0, SEEK_SET);
+	return file;
+    }
+    fseek (file, 0, SEEK_SET);
+
+    tmp = tmpfile ();
+    if (tmp == NULL)
+	err (1, "couldn't create decompression tmpfile");
+
+    memset (&zs, 0, sizeof zs);
+    /* 15+32: accept both gzip and zlib wrapping, multi-member included */
+    if (inflateInit2 (&zs, 15 + 32) != Z_OK)
+	errx (1, "inflateInit failed");
+
+    do {
+	zs.avail_in = fread (in, 1, sizeof in, file);
+	if (zs.avail_in == 0)
+	    break;
+	zs.next_in = in;
+	do {
+	    zs.avail_out = sizeof out;
+	    zs.next_out = out;
+	    ret = inflate (&zs, Z_NO_FLUSH);
+	    if (ret != Z_OK && ret != Z_STREAM_END)
+		errx (1, "inflate failed (%d): corrupt input?", ret);
+	    fwrite (out, 1, sizeof out - zs.avail_out, tmp);
+	    /* a new member may follow a member end */
+	    if (ret == Z_STREAM_END && zs.avail_in)
+		inflateReset2 (&zs, 15 + 32);
+	} while (zs.avail_out == 0 || (ret == Z_STREAM_END && zs.avail_in));
+    } while (ret != Z_STREAM_END || !feof (file));
+
+    inflateEnd (&zs);
+    fclose (file);
+    fseek (tmp, 0, SEEK_SET);
+    return tmp;
+}
+
+/* Writer mode: spool an error state into a multi-member gzip.  Each
+ * buffer section becomes its own gzip member, compressed by a small
+ * thread pool, and a plain-text .idx sidecar records the byte offset,
+ * compressed size and name of every member.  The container is still a
+ * valid .gz for zcat or for this tool, while triage can seek straight
+ * to one ring's batch and inflate only that member. */
+#define SPOOL_THREADS 4
+
+struct spool_section {
+    char *data;
+    size_t len, alloced;
+    char *comp;
+    size_t comp_len;
+    char name[64];
+};
+
+static struct spool_section *sections;
+static int num_sections;
+
+static void
+section_append (struct spool_section *sec, const char *line, size_t len)
+{
+    if (sec->len + len > sec->alloced) {
+	sec->alloced = (sec->alloced + len) * 2;
+	sec->data = realloc (sec->data, sec->alloced);
+	assert (sec->data);
+    }
+    memcpy (sec->data + sec->len, line, len);
+    sec->len += len;
+}
+
+static struct spool_section *
+section_start (const char *name)
+{
+    struct spool_section *sec;
+
+    sections = realloc (sections, (num_sections + 1) * sizeof (*sections));
+    assert (sections);
+    sec = &sections[num_sections++];
+    memset (sec, 0, sizeof (*sec));
+    strncpy (sec->name, name, sizeof (sec->name) - 1);
+    return sec;
+}
+
+static void
+compress_section (struct spool_section *sec)
+{
+    z_stream zs;
+    uLong bound;
+
+    memset (&zs, 0, sizeof zs);
+    /* 15+16: emit a standalone gzip member */
+    if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+		      8, Z_DEFAULT_STRATEGY) != Z_OK)
+	errx (1, "deflateInit failed");
+
+    bound = deflateBound (&zs, sec->len);
+    sec->comp = malloc (bound);
+    assert (sec->comp);
+
+    zs.next_in = (unsigned char *) sec->data;
+    zs.avail_in = sec->len;
+    zs.next_out = (unsigned char *) sec->comp;
+    zs.avail_out = bound;
+    if (deflate (&zs, Z_FINISH) != Z_STREAM_END)
+	errx (1, "deflate failed");
+    sec->comp_len = bound - zs.avail_out;
+    deflateEnd (&zs);
+}
+
+static void *
+spool_worker (void *arg)
+{
+    int tid = *(int *) arg;
+    int i;
+
+    for (i = tid; i < num_sections; i += SPOOL_THREADS)
+	compress_section (&sections[i]);
+
+    return NULL;
+}
+
+static void
+write_spool (FILE *file, const char *outname)
+{
+    struct spool_section *cur;
+    pthread_t threads[SPOOL_THREADS];
+    int tids[SPOOL_THREADS];
+    char *line = NULL, *idxname;
+    size_t line_size, offset = 0;
+    ssize_t len;
+    FILE *out, *idx;
+    int i;
+
+    cur = section_start ("header");
+
+    while ((len = getline (&line, &line_size, file)) > 0) {
+	char *dashes = strstr (line, "---");
+
+	if (dashes && (strstr (dashes, "gtt_offset") ||
+		       strstr (dashes, "ringbuffer"))) {
+	    char name[64];
+	    int n = dashes - line - 1;
+
+	    if (n >= (int) sizeof (name))
+		n = sizeof (name) - 1;
+	    if (n < 0)
+		n = 0;
+	    memcpy (name, line, n);
+	    name[n] = '\0';
+	    snprintf (name + n, sizeof (name) - n, " %s",
+		      strstr (dashes, "ringbuffer") ? "ringbuffer" :
+		      "batchbuffer");
+	    cur = section_start (name);
+	}
+	section_append (cur, line, len);
+    }
+    free (line);
+
+    for (i = 0; i < SPOOL_THREADS; i++) {
+	tids[i] = i;
+	pthread_create (&threads[i], NULL, spool_worker, &tids[i]);
+    }
+    for (i = 0; i < SPOOL_THREADS; i++)
+	pthread_join (threads[i], NULL);
+
+    out = fopen (outname, "wb");
+    if (out == NULL)
+	err (1, "couldn't create '%s'", outname);
+    if (asprintf (&idxname, "%s.idx", outname) == -1)
+	err (1, "asprintf");
+    idx = fopen (idxname, "w");
+    if (idx == NULL)
+	err (1, "couldn't create '%s'", idxname);
+
+    for (i = 0; i < num_sections; i++) {
+	fwrite (sections[i].comp, 1, sections[i].comp_len, out);
+	fprintf (idx, "%zu %zu %s\n", offset, sections[i].comp_len,
+		 sections[i].name);
+	offset += sections[i].comp_len;
+	free (sections[i].comp);
+	free (sections[i].data);
+    }
+
+    fclose (out);
+    fclose (idx);
+    fprintf (stderr, "%d sections, %zu bytes compressed into '%s', "
+	     "index in '%s'\n", num_sections, offset, outname, idxname);
+}
+#else
+static FILE *
+maybe_decompress (FILE *file)
+{
+    return file;
+}
+
+static void
+write_spool (FILE *file, const char *outname)
+{
+    errx (1, "compressed spooling needs a zlib build");
+}
+#endif
+
 int
 main (int argc, char *argv[])
 {
@@ -435,11 +856,25 @@ main (int argc, char *argv[])
     struct stat st;
     int error;
 
+    const char *spool_out = NULL;
+
+    if (argc > 1 && !strcmp (argv[1], "-q")) {
+	quick = 1;
+	argv++;
+	argc--;
+    }
+
+    if (argc > 2 && !strcmp (argv[1], "-z")) {
+	spool_out = argv[2];
+	argv += 2;
+	argc -= 2;
+    }
+
     if (argc > 2) {
 	fprintf (stderr,
 		 "intel_gpu_decode: Parse an Intel GPU i915_error_state\n"
 		 "Usage:\n"
-		 "\t%s [<file>]\n"
+		 "\t%s [-q] [-z <spool.gz>] [<file>]\n"
 		 "\n"
 		 "With no arguments, debugfs-dri-directory is probed for in "
 		 "/debug and \n"
@@ -511,7 +946,12 @@ main (int argc, char *argv[])
 	}
     }
 
-    read_data_file (file);
+    if (spool_out) {
+	write_spool (file, spool_out);
+    } else {
+	file = maybe_decompress (file);
+	read_data_file (file);
+    }
     fclose (file);
 
     if (filename != path)
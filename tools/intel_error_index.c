@@ -0,0 +1,540 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Corpus-scale instruction search over archived error states.
+ *
+ * Triaging a new hang against hundreds of archived dumps means asking
+ * "which of these contain this instruction sequence", and re-decoding
+ * the whole corpus through intel_error_decode for every question is
+ * the slow way.  This tool decodes each error state once into a
+ * compact index: per batch/ringbuffer, the canonical opcode stream
+ * (one entry per instruction, operands skipped via the length field,
+ * using the same per-gen tables as the quick decoder) plus a sorted
+ * list of opcode-trigram hashes for prefiltering.  Queries give a
+ * sequence of instruction header dwords; the trigram filter rejects
+ * most batches without touching their streams and survivors get an
+ * exact contiguous-subsequence check, so a corpus search answers in
+ * milliseconds.
+ *
+ *   intel_error_index -i corpus.idx error_state1 [error_state2 ...]
+ *   intel_error_index -s corpus.idx 0x7b000004 [0x78050001 ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <err.h>
+#include <sys/time.h>
+
+#include "intel_chipset.h"
+#include "intel_gpu_tools.h"
+#include "intel_decode_tables.h"
+
+#define INDEX_MAGIC 0x45494458	/* EIDX */
+#define INDEX_VERSION 1
+
+struct index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_files;
+	uint32_t num_batches;
+};
+
+struct batch_entry {
+	uint32_t file_idx;
+	uint32_t gen;
+	uint32_t gtt_offset;
+	uint32_t num_ops;
+	uint32_t num_grams;
+	char ring_name[32];
+	uint32_t *ops;		/* canonical opcode per instruction */
+	uint32_t *grams;	/* sorted unique trigram hashes */
+};
+
+static char **file_names;
+static int num_files;
+static struct batch_entry *batches;
+static int num_batches, batches_alloced;
+
+/* canonical opcode for a header dword: the table's cmd value, which is
+ * stable across operand fields; unknown dwords canonicalize to the raw
+ * value so garbage still compares equal to identical garbage */
+static uint32_t canonical_op(const struct intel_decode_table *table,
+			     uint32_t dword, int *len)
+{
+	const struct intel_decode_client *client =
+		&table->clients[dword >> 29];
+	int i;
+
+	*len = 1;
+
+	for (i = 0; i < client->num_ops; i++) {
+		const struct intel_decode_op *op = &client->ops[i];
+
+		if ((dword & op->mask) != op->cmd)
+			continue;
+
+		if (op->len_mask)
+			*len = (dword & op->len_mask) + op->len_bias;
+		else
+			*len = op->fixed_len;
+		if (*len < 1)
+			*len = 1;
+
+		return op->cmd;
+	}
+
+	return dword;
+}
+
+static int extract_ops(const struct intel_decode_table *table,
+		       const uint32_t *data, int count,
+		       uint32_t **ops_out)
+{
+	uint32_t *ops = malloc(count * sizeof(*ops));
+	int pos = 0, num = 0, len;
+
+	assert(ops);
+
+	while (pos < count) {
+		ops[num++] = canonical_op(table, data[pos], &len);
+		pos += len;
+	}
+
+	*ops_out = ops;
+	return num;
+}
+
+static uint32_t trigram_hash(const uint32_t *ops)
+{
+	uint32_t h = 2166136261u;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		h ^= ops[i];
+		h *= 16777619;
+	}
+
+	return h;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t ua = *(const uint32_t *)a, ub = *(const uint32_t *)b;
+
+	if (ua < ub)
+		return -1;
+	return ua > ub;
+}
+
+static int build_grams(const uint32_t *ops, int num_ops, uint32_t **grams_out)
+{
+	uint32_t *grams;
+	int i, n = 0;
+
+	if (num_ops < 3) {
+		*grams_out = NULL;
+		return 0;
+	}
+
+	grams = malloc((num_ops - 2) * sizeof(*grams));
+	assert(grams);
+
+	for (i = 0; i + 3 <= num_ops; i++)
+		grams[n++] = trigram_hash(&ops[i]);
+
+	qsort(grams, n, sizeof(*grams), cmp_u32);
+
+	/* unique */
+	for (i = 1; i < n; )
+		if (grams[i] == grams[i-1])
+			memmove(&grams[i], &grams[i+1],
+				(--n - i) * sizeof(*grams));
+		else
+			i++;
+
+	*grams_out = grams;
+	return n;
+}
+
+static int gram_present(const struct batch_entry *b, uint32_t hash)
+{
+	int lo = 0, hi = b->num_grams - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if (b->grams[mid] == hash)
+			return 1;
+		if (b->grams[mid] < hash)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return 0;
+}
+
+static struct batch_entry *batch_new(void)
+{
+	if (num_batches == batches_alloced) {
+		batches_alloced = batches_alloced ? batches_alloced * 2 : 64;
+		batches = realloc(batches,
+				  batches_alloced * sizeof(*batches));
+		assert(batches);
+	}
+
+	memset(&batches[num_batches], 0, sizeof(batches[num_batches]));
+	return &batches[num_batches++];
+}
+
+static void finish_segment(int file_idx, int gen, const char *ring_name,
+			   uint32_t gtt_offset, uint32_t *data, int count)
+{
+	const struct intel_decode_table *table;
+	struct batch_entry *b;
+
+	if (!count || gen < 2)
+		return;
+
+	table = intel_decode_table_get(gen);
+	if (!table)
+		return;
+
+	b = batch_new();
+	b->file_idx = file_idx;
+	b->gen = gen;
+	b->gtt_offset = gtt_offset;
+	strncpy(b->ring_name, ring_name ? ring_name : "?",
+		sizeof(b->ring_name) - 1);
+	b->num_ops = extract_ops(table, data, count, &b->ops);
+	b->num_grams = build_grams(b->ops, b->num_ops, &b->grams);
+}
+
+/* same line format read_data_file() in intel_error_decode handles:
+ * "---" separators naming each buffer, "%08x : %08x" dword lines, and
+ * a "PCI ID:" line giving the chipset */
+static void index_file(int file_idx, const char *path)
+{
+	FILE *file = fopen(path, "r");
+	uint32_t *data = NULL;
+	int data_size = 0, count = 0, gen = 0;
+	uint32_t gtt_offset = 0, new_offset, offset, value;
+	char *ring_name = NULL;
+	char *line = NULL;
+	size_t line_size = 0;
+
+	if (!file)
+		err(1, "%s", path);
+
+	while (getline(&line, &line_size, file) > 0) {
+		char *dashes = strstr(line, "---");
+
+		if (dashes) {
+			int matched;
+
+			matched = sscanf(dashes, "--- gtt_offset = 0x%08x\n",
+					 &new_offset);
+			if (matched == 0)
+				matched = sscanf(dashes,
+						 "--- ringbuffer = 0x%08x\n",
+						 &new_offset);
+			if (matched == 1) {
+				finish_segment(file_idx, gen, ring_name,
+					       gtt_offset, data, count);
+				count = 0;
+
+				free(ring_name);
+				ring_name = strndup(line, dashes - line);
+				if (dashes > line)
+					ring_name[dashes - line - 1] = '\0';
+				gtt_offset = new_offset;
+				continue;
+			}
+		}
+
+		if (sscanf(line, "%08x : %08x", &offset, &value) != 2) {
+			unsigned int reg;
+
+			finish_segment(file_idx, gen, ring_name,
+				       gtt_offset, data, count);
+			count = 0;
+
+			if (sscanf(line, "PCI ID: 0x%04x\n", &reg) == 1 ||
+			    sscanf(line, " PCI ID: 0x%04x\n", &reg) == 1)
+				gen = intel_gen(reg);
+			continue;
+		}
+
+		if (count == data_size) {
+			data_size = data_size ? data_size * 2 : 1024;
+			data = realloc(data, data_size * sizeof(*data));
+			assert(data);
+		}
+		data[count++] = value;
+	}
+
+	finish_segment(file_idx, gen, ring_name, gtt_offset, data, count);
+
+	free(ring_name);
+	free(data);
+	free(line);
+	fclose(file);
+}
+
+static void write_u32(FILE *f, uint32_t v)
+{
+	if (fwrite(&v, sizeof(v), 1, f) != 1)
+		err(1, "write");
+}
+
+static uint32_t read_u32(FILE *f)
+{
+	uint32_t v;
+
+	if (fread(&v, sizeof(v), 1, f) != 1)
+		errx(1, "truncated index");
+	return v;
+}
+
+static void save_index(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	struct index_header hdr;
+	int i;
+
+	if (!f)
+		err(1, "%s", path);
+
+	hdr.magic = INDEX_MAGIC;
+	hdr.version = INDEX_VERSION;
+	hdr.num_files = num_files;
+	hdr.num_batches = num_batches;
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+		err(1, "write");
+
+	for (i = 0; i < num_files; i++) {
+		uint32_t len = strlen(file_names[i]);
+
+		write_u32(f, len);
+		if (fwrite(file_names[i], 1, len, f) != len)
+			err(1, "write");
+	}
+
+	for (i = 0; i < num_batches; i++) {
+		struct batch_entry *b = &batches[i];
+
+		write_u32(f, b->file_idx);
+		write_u32(f, b->gen);
+		write_u32(f, b->gtt_offset);
+		write_u32(f, b->num_ops);
+		write_u32(f, b->num_grams);
+		if (fwrite(b->ring_name, 1, sizeof(b->ring_name), f) !=
+		    sizeof(b->ring_name))
+			err(1, "write");
+		if (b->num_ops &&
+		    fwrite(b->ops, sizeof(uint32_t), b->num_ops, f) !=
+		    b->num_ops)
+			err(1, "write");
+		if (b->num_grams &&
+		    fwrite(b->grams, sizeof(uint32_t), b->num_grams, f) !=
+		    b->num_grams)
+			err(1, "write");
+	}
+
+	fclose(f);
+}
+
+static void load_index(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	struct index_header hdr;
+	int i;
+
+	if (!f)
+		err(1, "%s", path);
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    hdr.magic != INDEX_MAGIC)
+		errx(1, "%s: not an error-state index", path);
+	if (hdr.version != INDEX_VERSION)
+		errx(1, "%s: index version %u, expected %u",
+		     path, hdr.version, INDEX_VERSION);
+
+	num_files = hdr.num_files;
+	file_names = calloc(num_files, sizeof(*file_names));
+	assert(file_names);
+	for (i = 0; i < num_files; i++) {
+		uint32_t len = read_u32(f);
+
+		file_names[i] = malloc(len + 1);
+		assert(file_names[i]);
+		if (fread(file_names[i], 1, len, f) != len)
+			errx(1, "truncated index");
+		file_names[i][len] = '\0';
+	}
+
+	num_batches = hdr.num_batches;
+	batches = calloc(num_batches, sizeof(*batches));
+	assert(batches);
+	for (i = 0; i < num_batches; i++) {
+		struct batch_entry *b = &batches[i];
+
+		b->file_idx = read_u32(f);
+		b->gen = read_u32(f);
+		b->gtt_offset = read_u32(f);
+		b->num_ops = read_u32(f);
+		b->num_grams = read_u32(f);
+		if (fread(b->ring_name, 1, sizeof(b->ring_name), f) !=
+		    sizeof(b->ring_name))
+			errx(1, "truncated index");
+		b->ops = malloc(b->num_ops * sizeof(uint32_t));
+		b->grams = malloc(b->num_grams * sizeof(uint32_t));
+		assert((!b->num_ops || b->ops) &&
+		       (!b->num_grams || b->grams));
+		if (b->num_ops &&
+		    fread(b->ops, sizeof(uint32_t), b->num_ops, f) !=
+		    b->num_ops)
+			errx(1, "truncated index");
+		if (b->num_grams &&
+		    fread(b->grams, sizeof(uint32_t), b->num_grams, f) !=
+		    b->num_grams)
+			errx(1, "truncated index");
+	}
+
+	fclose(f);
+}
+
+static void search_index(int argc, char **argv)
+{
+	uint32_t query[64];
+	struct timeval t0, t1;
+	int nquery = 0, i, hits = 0, scanned = 0;
+
+	if (argc < 1)
+		errx(1, "no query dwords given");
+	if (argc > 64)
+		errx(1, "query too long (max 64 instructions)");
+
+	for (i = 0; i < argc; i++)
+		query[nquery++] = strtoul(argv[i], NULL, 0);
+
+	gettimeofday(&t0, NULL);
+
+	for (i = 0; i < num_batches; i++) {
+		struct batch_entry *b = &batches[i];
+		const struct intel_decode_table *table =
+			intel_decode_table_get(b->gen);
+		uint32_t qops[64];
+		int q, pos, len;
+
+		if (!table || b->num_ops < nquery)
+			continue;
+
+		/* canonicalize the query against this batch's gen */
+		for (q = 0; q < nquery; q++)
+			qops[q] = canonical_op(table, query[q], &len);
+
+		/* trigram prefilter */
+		if (nquery >= 3) {
+			for (q = 0; q + 3 <= nquery; q++)
+				if (!gram_present(b, trigram_hash(&qops[q])))
+					break;
+			if (q + 3 <= nquery)
+				continue;
+		}
+		scanned++;
+
+		/* exact contiguous subsequence check */
+		for (pos = 0; pos + nquery <= b->num_ops; pos++) {
+			if (memcmp(&b->ops[pos], qops,
+				   nquery * sizeof(uint32_t)))
+				continue;
+
+			printf("%s: %s at 0x%08x, instruction %d of %d\n",
+			       file_names[b->file_idx], b->ring_name,
+			       b->gtt_offset, pos, b->num_ops);
+			hits++;
+			break;
+		}
+	}
+
+	gettimeofday(&t1, NULL);
+
+	fprintf(stderr, "%d matching buffers out of %d "
+		"(%d passed prefilter) in %.2fms\n",
+		hits, num_batches, scanned,
+		(t1.tv_sec - t0.tv_sec) * 1e3 +
+		(t1.tv_usec - t0.tv_usec) / 1e3);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s -i <index> <error-state>...  build index\n"
+		"       %s -s <index> <dword>...        "
+		"search for instruction sequence\n",
+		name, name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *index_path = NULL;
+	int mode = 0, c, i;
+
+	while ((c = getopt(argc, argv, "i:s:h")) != -1) {
+		switch (c) {
+		case 'i':
+		case 's':
+			mode = c;
+			index_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!mode || optind == argc)
+		usage(argv[0]);
+
+	if (mode == 'i') {
+		num_files = argc - optind;
+		file_names = &argv[optind];
+		for (i = 0; i < num_files; i++)
+			index_file(i, file_names[i]);
+		save_index(index_path);
+		printf("indexed %d batches from %d files into %s\n",
+		       num_batches, num_files, index_path);
+	} else {
+		load_index(index_path);
+		search_index(argc - optind, &argv[optind]);
+	}
+
+	return 0;
+}
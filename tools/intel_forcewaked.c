@@ -35,6 +35,7 @@
 #include <syslog.h>
 #include <unistd.h>
 #include "intel_gpu_tools.h"
+#include "intel_snapshot.h"
 
 bool daemonized;
 
@@ -52,6 +53,8 @@ help(char *prog) {
 	printf("usage: %s [options] \n\n", prog);
 	printf("Options: \n");
 	printf("    -b        Run in background/daemon mode\n");
+	printf("    -s        Also publish a GT state page in shm that\n");
+	printf("              readers can poll without their own MMIO\n");
 }
 
 static int
@@ -62,39 +65,68 @@ is_alive(void) {
 
 int main(int argc, char *argv[])
 {
-	int ret;
+	struct intel_gt_snapshot *snap = NULL;
+	struct pci_device *pci_dev;
+	bool publish = false;
+	int i, ret;
 
-	if (argc > 2 || (argc == 2 && !strncmp(argv[1], "-h", 2))) {
-		help(argv[1]);
-		exit(0);
+	for (i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "-b", 2))
+			daemonized = true;
+		else if (!strncmp(argv[i], "-s", 2))
+			publish = true;
+		else {
+			help(argv[0]);
+			exit(strncmp(argv[i], "-h", 2) ? 1 : 0);
+		}
 	}
 
-	if (argc == 2 && (!strncmp(argv[1], "-b", 2)))
-		daemonized = true;
-
 	if (daemonized) {
 		assert(daemon(0, 0) == 0);
 		openlog(argv[0], LOG_CONS | LOG_PID, LOG_USER);
 		INFO_PRINT("started daemon");
 	}
 
-	ret = intel_register_access_init(intel_get_pci_device(), 1);
+	pci_dev = intel_get_pci_device();
+	ret = intel_register_access_init(pci_dev, 1);
 	if (ret) {
 		INFO_PRINT("Couldn't init register access\n");
 		exit(1);
 	} else {
 		INFO_PRINT("Forcewake locked\n");
 	}
+
+	if (publish) {
+		snap = intel_snapshot_publish();
+		if (snap == NULL)
+			INFO_PRINT("Couldn't publish snapshot page\n");
+	}
+
 	while(1) {
 		if (!is_alive()) {
-			INFO_PRINT("gpu reset? restarting daemon\n");
-			intel_register_access_fini();
-			ret = intel_register_access_init(intel_get_pci_device(), 1);
+			/* The kernel drops the forcewake reference across a
+			 * GPU reset; cycle ours instead of redoing the whole
+			 * register access setup. */
+			INFO_PRINT("gpu reset? reacquiring forcewake\n");
+			intel_forcewake_put();
+			ret = intel_forcewake_get();
 			if (ret)
-				INFO_PRINT("Reg access init fail\n");
+				INFO_PRINT("Forcewake reacquire failed\n");
+		}
+		if (snap) {
+			/* we already hold forcewake, so the reads here cost
+			 * no extra wake events - that is the whole point of
+			 * readers polling the page instead of the hardware */
+			for (i = 0; i < 10; i++) {
+				intel_snapshot_update(snap, pci_dev->device_id);
+				usleep(100 * 1000);
+			}
+		} else {
+			sleep(1);
 		}
-		sleep(1);
 	}
+	if (snap)
+		intel_snapshot_unpublish(snap);
 	intel_register_access_fini();
 	INFO_PRINT("Forcewake unlock\n");
 
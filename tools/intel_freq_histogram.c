@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file intel_freq_histogram.c
+ *
+ * Offline reduction of intel_gpu_top -F logs into
+ * occupancy-at-frequency histograms: for each frequency the GPU
+ * actually ran at, how often and how full each ring was.  A workload
+ * that is busy mostly at the bottom bins is dispatch-limited; one
+ * pinned at the top bin with the rings full is clock-limited.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "intel_freq_log.h"
+
+/* CAGF is an 8 bit count of 50MHz steps, so every possible frequency
+ * gets its own exact bin */
+#define NUM_BINS	256
+
+static const char *ring_names[FREQLOG_NUM_RINGS] = {
+	"render", "bsd", "bsd6", "blt",
+};
+
+struct freq_bin {
+	uint64_t samples;
+	uint64_t busy[FREQLOG_NUM_RINGS];
+	uint64_t occupancy[FREQLOG_NUM_RINGS];
+};
+
+int main(int argc, char **argv)
+{
+	const struct freqlog_header *hdr;
+	const struct freqlog_record *rec;
+	struct freq_bin *bins;
+	uint64_t num_records, total = 0;
+	struct stat st;
+	void *map;
+	unsigned int b, n;
+	int i, fd;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <logfile>\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd == -1)
+		err(1, "couldn't open '%s'", argv[1]);
+	if (fstat(fd, &st))
+		err(1, "couldn't stat '%s'", argv[1]);
+	if (st.st_size < (off_t)sizeof(*hdr))
+		errx(1, "'%s' is too short to be a freq log", argv[1]);
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "couldn't map '%s'", argv[1]);
+
+	hdr = map;
+	if (hdr->magic != FREQLOG_MAGIC)
+		errx(1, "bad magic 0x%08x", hdr->magic);
+	if (hdr->version != FREQLOG_VERSION)
+		errx(1, "unsupported version %d", hdr->version);
+
+	rec = (const void *)(hdr + 1);
+	num_records = (st.st_size - sizeof(*hdr)) / sizeof(*rec);
+
+	bins = calloc(NUM_BINS, sizeof(*bins));
+	if (!bins)
+		err(1, "allocating bins");
+
+	for (n = 0; n < num_records; n++) {
+		unsigned int bin = rec[n].freq_mhz / 50;
+
+		if (bin >= NUM_BINS)
+			continue;
+		bins[bin].samples++;
+		total++;
+		for (i = 0; i < FREQLOG_NUM_RINGS; i++) {
+			uint32_t occ = rec[n].occupancy[i];
+
+			if (occ == (uint32_t)-1)
+				continue;
+			if (occ)
+				bins[bin].busy[i]++;
+			bins[bin].occupancy[i] += occ;
+		}
+	}
+
+	if (!total)
+		errx(1, "no samples in '%s'", argv[1]);
+
+	printf("%"PRIu64" samples at %u/sec (%.1fs)\n\n",
+	       num_records, hdr->samples_per_sec,
+	       (double)num_records / hdr->samples_per_sec);
+
+	printf("%6s %8s %6s", "MHz", "samples", "time%");
+	for (i = 0; i < FREQLOG_NUM_RINGS; i++)
+		if (hdr->ring_size[i])
+			printf(" %9s%% %9s", ring_names[i], "avg-bytes");
+	printf("\n");
+
+	for (b = 0; b < NUM_BINS; b++) {
+		if (!bins[b].samples)
+			continue;
+
+		printf("%6u %8"PRIu64" %6.2f", b * 50, bins[b].samples,
+		       bins[b].samples * 100.0 / total);
+		for (i = 0; i < FREQLOG_NUM_RINGS; i++) {
+			if (!hdr->ring_size[i])
+				continue;
+			printf(" %9.1f%% %9.0f",
+			       bins[b].busy[i] * 100.0 / bins[b].samples,
+			       (double)bins[b].occupancy[i] / bins[b].samples);
+		}
+		printf("\n");
+	}
+
+	free(bins);
+	munmap(map, st.st_size);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_FREQ_LOG_H
+#define INTEL_FREQ_LOG_H
+
+#include <stdint.h>
+
+/* On-disk format of intel_gpu_top -F: a header followed by one record
+ * per sample tick, each carrying the CAGF frequency and all four ring
+ * occupancies read from the same batched register sample.  Decoded by
+ * intel_freq_histogram. */
+
+#define FREQLOG_MAGIC		0x47505551	/* "GPUQ" */
+#define FREQLOG_VERSION		1
+#define FREQLOG_NUM_RINGS	4	/* render, bsd, bsd6, blt */
+
+struct freqlog_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t samples_per_sec;
+	uint32_t ring_size[FREQLOG_NUM_RINGS];
+};
+
+struct freqlog_record {
+	uint64_t time_us;
+	uint32_t freq_mhz;
+	/* bytes pending per ring, -1 when the ring doesn't exist */
+	uint32_t occupancy[FREQLOG_NUM_RINGS];
+};
+
+#endif /* INTEL_FREQ_LOG_H */
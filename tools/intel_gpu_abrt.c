@@ -0,0 +1,521 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file intel_gpu_abrt.c
+ *
+ * Bug report data collector, replacing the old shell script of the
+ * same name.  Every source (debugfs, module options, dmesg, register
+ * dump, VBIOS, X logs, ...) is independent, so each one is captured by
+ * its own forked child streaming into a pipe while the parent
+ * multiplexes them all with poll() and writes the archive.  A source
+ * that hangs - debugfs reads do exactly that during the hangs we're
+ * collecting evidence of - is killed at its deadline and whatever it
+ * produced so far is kept.  The archive is a tar written straight from
+ * the capture buffers, gzipped on the fly when zlib is available, so
+ * capture time is the slowest single source instead of the sum of all
+ * of them.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define MAX_SOURCES	256
+#define MAX_CAPTURE	(64 * 1024 * 1024)
+#define DEFAULT_BUDGET	5	/* seconds per source */
+
+#define ROM_PATH "/sys/devices/pci0000:00/0000:00:02.0/rom"
+
+enum source_type {
+	SRC_FILE,	/* stream one file */
+	SRC_CMD,	/* stream a command's stdout */
+	SRC_VBIOS,	/* enable, stream and disable the PCI ROM */
+};
+
+struct source {
+	char name[256];		/* path inside the archive */
+	enum source_type type;
+	char file[256];
+	const char *argv[4];
+
+	pid_t pid;
+	int fd;
+	char *data;
+	size_t len, alloced;
+	int done;
+};
+
+static struct source sources[MAX_SOURCES];
+static int num_sources;
+static int budget_secs = DEFAULT_BUDGET;
+static char igtdir[512];
+
+static uint64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static struct source *add_source(const char *name)
+{
+	struct source *src;
+
+	if (num_sources == MAX_SOURCES)
+		errx(1, "too many capture sources");
+
+	src = &sources[num_sources++];
+	snprintf(src->name, sizeof(src->name), "intel_gpu_abrt/%s", name);
+	return src;
+}
+
+static void add_file(const char *path, const char *name)
+{
+	struct source *src;
+
+	if (access(path, R_OK))
+		return;
+
+	src = add_source(name);
+	src->type = SRC_FILE;
+	snprintf(src->file, sizeof(src->file), "%s", path);
+}
+
+static void add_cmd(const char *name, const char *arg0, const char *arg1,
+		    int own_tool)
+{
+	struct source *src = add_source(name);
+	static char tool_paths[16][1024];
+	static int num_tool_paths;
+
+	src->type = SRC_CMD;
+	if (own_tool && igtdir[0]) {
+		char *path = tool_paths[num_tool_paths++];
+
+		snprintf(path, sizeof(tool_paths[0]), "%s/%s", igtdir, arg0);
+		src->argv[0] = path;
+	} else
+		src->argv[0] = arg0;
+	src->argv[1] = arg1;
+	src->argv[2] = NULL;
+}
+
+/* every regular file in dir becomes its own source, so one stuck file
+ * can't hold up its siblings */
+static void add_dir(const char *dir, const char *prefix)
+{
+	char path[512], name[512];
+	struct dirent *ent;
+	struct stat st;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	while ((ent = readdir(d))) {
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		if (stat(path, &st) || !S_ISREG(st.st_mode))
+			continue;
+		snprintf(name, sizeof(name), "%s/%s", prefix, ent->d_name);
+		add_file(path, name);
+	}
+	closedir(d);
+}
+
+/* child side: stream fd 0-copy-ish to stdout until EOF */
+static void stream_file(const char *path)
+{
+	char buf[65536];
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		exit(1);
+
+	while ((ret = read(fd, buf, sizeof(buf))) > 0)
+		if (write(STDOUT_FILENO, buf, ret) != ret)
+			exit(1);
+	exit(0);
+}
+
+static void stream_vbios(void)
+{
+	int fd;
+
+	fd = open(ROM_PATH, O_WRONLY);
+	if (fd < 0)
+		exit(1);
+	if (write(fd, "1", 1) != 1)
+		exit(1);
+	close(fd);
+
+	/* the disable below never runs if this hangs and we're killed,
+	 * but a ROM left enabled is harmless next to a hung GPU */
+	stream_file(ROM_PATH);
+}
+
+static void source_start(struct source *src)
+{
+	int fds[2];
+
+	if (pipe(fds))
+		err(1, "pipe");
+
+	src->pid = fork();
+	if (src->pid < 0)
+		err(1, "fork");
+	if (src->pid == 0) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+
+		switch (src->type) {
+		case SRC_FILE:
+			stream_file(src->file);
+			break;
+		case SRC_CMD:
+			execvp(src->argv[0], (char **)src->argv);
+			exit(1);
+		case SRC_VBIOS:
+			stream_vbios();
+			break;
+		}
+		exit(1);
+	}
+
+	close(fds[1]);
+	src->fd = fds[0];
+	fcntl(src->fd, F_SETFL, O_NONBLOCK);
+}
+
+static void source_finish(struct source *src, int kill_it)
+{
+	int status;
+
+	if (kill_it)
+		kill(src->pid, SIGKILL);
+	waitpid(src->pid, &status, 0);
+	close(src->fd);
+	src->fd = -1;
+	src->done = 1;
+}
+
+/* returns 0 once the source is finished */
+static int source_read(struct source *src)
+{
+	ssize_t ret;
+
+	for (;;) {
+		if (src->len + 65536 > src->alloced) {
+			src->alloced = src->alloced ? src->alloced * 2 :
+				128 * 1024;
+			src->data = realloc(src->data, src->alloced);
+			if (!src->data)
+				err(1, "capture buffer");
+		}
+
+		ret = read(src->fd, src->data + src->len,
+			   src->alloced - src->len);
+		if (ret == 0) {
+			source_finish(src, 0);
+			return 0;
+		}
+		if (ret < 0)
+			return errno == EAGAIN ? 1 : 0;
+
+		src->len += ret;
+		if (src->len >= MAX_CAPTURE) {
+			source_finish(src, 1);
+			return 0;
+		}
+	}
+}
+
+static void capture_all(void)
+{
+	struct pollfd pfds[MAX_SOURCES];
+	uint64_t deadline;
+	int i, active;
+
+	for (i = 0; i < num_sources; i++)
+		source_start(&sources[i]);
+
+	deadline = now_us() + budget_secs * 1000000ull;
+
+	for (;;) {
+		int timeout_ms = (deadline - now_us()) / 1000;
+
+		active = 0;
+		for (i = 0; i < num_sources; i++) {
+			if (sources[i].done)
+				continue;
+			pfds[active].fd = sources[i].fd;
+			pfds[active].events = POLLIN;
+			active++;
+		}
+		if (!active)
+			return;
+
+		if (timeout_ms <= 0) {
+			for (i = 0; i < num_sources; i++) {
+				if (sources[i].done)
+					continue;
+				fprintf(stderr,
+					"%s: timed out, keeping %zd bytes\n",
+					sources[i].name, sources[i].len);
+				source_finish(&sources[i], 1);
+			}
+			return;
+		}
+
+		if (poll(pfds, active, timeout_ms) < 0) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poll");
+		}
+
+		for (i = 0; i < num_sources; i++)
+			if (!sources[i].done)
+				source_read(&sources[i]);
+	}
+}
+
+/*
+ * Minimal ustar writer over the capture buffers; with zlib the stream
+ * is gzipped as it is written.
+ */
+#ifdef HAVE_ZLIB
+static gzFile tar_gz;
+#define ARCHIVE_NAME "intel_gpu_abrt.tar.gz"
+#else
+static FILE *tar_file;
+#define ARCHIVE_NAME "intel_gpu_abrt.tar"
+#endif
+
+static void tar_write(const void *buf, size_t len)
+{
+#ifdef HAVE_ZLIB
+	if (gzwrite(tar_gz, buf, len) != (int)len)
+		errx(1, "writing " ARCHIVE_NAME);
+#else
+	if (fwrite(buf, 1, len, tar_file) != len)
+		err(1, "writing " ARCHIVE_NAME);
+#endif
+}
+
+static void tar_entry(const struct source *src)
+{
+	static const char zeros[512];
+	char header[512];
+	unsigned int sum = 0;
+	int i;
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, src->name, strnlen(src->name, 99));
+	snprintf(header + 100, 8, "%07o", 0644);
+	snprintf(header + 108, 8, "%07o", 0);		/* uid */
+	snprintf(header + 116, 8, "%07o", 0);		/* gid */
+	snprintf(header + 124, 12, "%011zo", src->len);
+	snprintf(header + 136, 12, "%011lo", (long)time(NULL));
+	memset(header + 148, ' ', 8);			/* chksum */
+	header[156] = '0';				/* regular file */
+	memcpy(header + 257, "ustar  ", 7);
+
+	for (i = 0; i < 512; i++)
+		sum += (unsigned char)header[i];
+	snprintf(header + 148, 8, "%06o", sum);
+
+	tar_write(header, sizeof(header));
+	tar_write(src->data, src->len);
+	if (src->len % 512)
+		tar_write(zeros, 512 - src->len % 512);
+}
+
+static void write_archive(void)
+{
+	static const char zeros[1024];
+	int i;
+
+#ifdef HAVE_ZLIB
+	tar_gz = gzopen(ARCHIVE_NAME, "wb");
+	if (!tar_gz)
+		err(1, ARCHIVE_NAME);
+#else
+	tar_file = fopen(ARCHIVE_NAME, "w");
+	if (!tar_file)
+		err(1, ARCHIVE_NAME);
+#endif
+
+	for (i = 0; i < num_sources; i++)
+		if (sources[i].len)
+			tar_entry(&sources[i]);
+	tar_write(zeros, sizeof(zeros));
+
+#ifdef HAVE_ZLIB
+	gzclose(tar_gz);
+#else
+	fclose(tar_file);
+#endif
+}
+
+static const char *find_i915_debugfs(void)
+{
+	static char found[512];
+	const char *roots[] = { "/sys/kernel/debug/dri", "/debug/dri" };
+	char path[512];
+	struct dirent *ent;
+	unsigned int r;
+	DIR *d;
+
+	for (r = 0; r < sizeof(roots)/sizeof(roots[0]); r++) {
+		d = opendir(roots[r]);
+		if (!d)
+			continue;
+		while ((ent = readdir(d))) {
+			snprintf(path, sizeof(path),
+				 "%s/%s/i915_error_state",
+				 roots[r], ent->d_name);
+			if (access(path, F_OK) == 0) {
+				snprintf(found, sizeof(found), "%s/%s",
+					 roots[r], ent->d_name);
+				closedir(d);
+				return found;
+			}
+		}
+		closedir(d);
+	}
+
+	return NULL;
+}
+
+static void print_template(void)
+{
+	printf("%s has been created.\n"
+	       "\n"
+	       "Please attach it to https://bugs.freedesktop.org\n"
+	       "with a good bug description as suggested in this template:\n"
+	       "\n"
+	       "System environment:\n"
+	       "-- chipset:\n"
+	       "-- system architecture:\n"
+	       "-- xf86-video-intel:\n"
+	       "-- xserver:\n"
+	       "-- mesa:\n"
+	       "-- libdrm:\n"
+	       "-- kernel:\n"
+	       "-- Linux distribution:\n"
+	       "-- Machine or mobo model:\n"
+	       "-- Display connector:\n"
+	       "\n"
+	       "Reproducing steps:\n"
+	       "\n"
+	       "Additional info:\n"
+	       "\n", ARCHIVE_NAME);
+}
+
+int main(int argc, char **argv)
+{
+	const char *i915_debugfs;
+	uint64_t start;
+	char buf[1024];
+	int c;
+
+	while ((c = getopt(argc, argv, "t:h")) != -1) {
+		switch (c) {
+		case 't':
+			budget_secs = atoi(optarg);
+			if (budget_secs < 1)
+				budget_secs = DEFAULT_BUDGET;
+			break;
+		case 'h':
+		default:
+			printf("usage: %s [-t seconds]\n"
+			       "  -t   capture budget (default %d); sources "
+			       "still running at the deadline\n"
+			       "       are killed and their partial output "
+			       "kept\n", argv[0], DEFAULT_BUDGET);
+			exit(c == 'h' ? 0 : 1);
+		}
+	}
+
+	if (geteuid())
+		errx(1, "%s must be run as root", argv[0]);
+
+	snprintf(buf, sizeof(buf), "%s", argv[0]);
+	snprintf(igtdir, sizeof(igtdir), "%s", dirname(buf));
+
+	i915_debugfs = find_i915_debugfs();
+	if (!i915_debugfs)
+		errx(1, "i915 debugfs path not found");
+
+	add_dir(i915_debugfs, "debugfs");
+	add_dir("/sys/module/i915/parameters", "mod_opts");
+
+	add_file("/var/log/Xorg.0.log", "X/Xorg.0.log");
+	add_file("/var/log/Xorg.0.log.old", "X/Xorg.0.log.old");
+	add_file("/etc/X11/xorg.conf", "X/xorg.conf");
+	add_dir("/etc/X11/xorg.conf.d", "X/xorg.conf.d");
+
+	add_cmd("dmesg", "dmesg", NULL, 0);
+	add_cmd("lspci", "lspci", "-nn", 0);
+	add_cmd("X/xrandr", "xrandr", "--verbose", 0);
+	add_cmd("intel_reg_dumper.txt", "intel_reg_dumper", NULL, 1);
+	add_cmd("intel_stepping", "intel_stepping", NULL, 1);
+	add_cmd("intel_bios_dump", "intel_bios_dumper", "/dev/stdout", 1);
+
+	if (access(ROM_PATH, W_OK) == 0)
+		add_source("vbios.dump")->type = SRC_VBIOS;
+
+	start = now_us();
+	capture_all();
+	write_archive();
+	fprintf(stderr, "captured %d sources in %.2fs\n", num_sources,
+		(now_us() - start) / 1e6);
+
+	print_template();
+	return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * intel_gpu_clients: per-process attribution of GPU activity.
+ *
+ * The debugfs clients file says who holds the device open; the ring
+ * registers say whether the GPU is busy; neither alone names the
+ * process saturating it.  This samples both at high rate and pairs
+ * them: every tick the ring HEAD/TAIL pointers are read for busyness,
+ * and every client pid's /proc wchan is checked for an i915/drm wait.
+ * A process hammering the GPU spends a large share of its time blocked
+ * in throttle/wait-request, so the GPU-WAIT%% column singles out the
+ * heavy submitters among dozens of idle clients.  Attribution by wait
+ * sampling is a proxy - a client that submits little but never waits
+ * stays low - but it answers the on-call question directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include "intel_gpu_tools.h"
+#include "intel_debugfs.h"
+
+#define MAX_CLIENTS 64
+#define CLIENTS_BUF 8192
+#define WCHAN_BUF 128
+
+struct client {
+	int pid;
+	char auth;
+	char comm[32];
+	int wchan_fd;
+	uint64_t wait_samples;
+	uint64_t samples;
+	int seen;
+};
+
+struct ring {
+	const char *name;
+	uint32_t mmio;
+	int present;
+	uint64_t busy;
+};
+
+static struct client clients[MAX_CLIENTS];
+static int num_clients;
+
+static struct ring rings[] = {
+	{ "render", 0x2030 },
+	{ "bitstream", 0x4030 },
+	{ "bitstream", 0x12030 },
+	{ "blitter", 0x22030 },
+};
+#define NUM_RINGS (sizeof(rings) / sizeof(rings[0]))
+
+static struct client *find_client(int pid)
+{
+	int i;
+
+	for (i = 0; i < num_clients; i++)
+		if (clients[i].pid == pid)
+			return &clients[i];
+	return NULL;
+}
+
+static void client_open(struct client *c)
+{
+	char path[64];
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%d/comm", c->pid);
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		int len = read(fd, c->comm, sizeof(c->comm) - 1);
+
+		if (len > 0) {
+			if (c->comm[len - 1] == '\n')
+				len--;
+			c->comm[len] = '\0';
+		}
+		close(fd);
+	}
+	if (!c->comm[0])
+		strcpy(c->comm, "?");
+
+	snprintf(path, sizeof(path), "/proc/%d/wchan", c->pid);
+	c->wchan_fd = open(path, O_RDONLY);
+}
+
+static void client_close(struct client *c)
+{
+	if (c->wchan_fd >= 0)
+		close(c->wchan_fd);
+	c->wchan_fd = -1;
+}
+
+/* Refresh the client table from the debugfs clients file.  The format
+ * is one line per open file: auth flag, minor, pid, uid, magic, ioctl
+ * count; anything that doesn't scan that way (like the header) is
+ * skipped.  Known pids keep their counters and wchan fd. */
+static void scan_clients(struct debugfs_file *file)
+{
+	char *line, *next;
+	int i;
+
+	for (i = 0; i < num_clients; i++)
+		clients[i].seen = 0;
+
+	if (debugfs_file_read(file) <= 0)
+		return;
+
+	for (line = file->buf; line; line = next) {
+		struct client *c;
+		char auth;
+		int minor, pid, uid;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		if (sscanf(line, " %c %d %d %d", &auth, &minor, &pid, &uid) != 4)
+			continue;
+		if (pid <= 0)
+			continue;
+
+		c = find_client(pid);
+		if (!c) {
+			if (num_clients == MAX_CLIENTS)
+				continue;
+			c = &clients[num_clients++];
+			memset(c, 0, sizeof(*c));
+			c->pid = pid;
+			client_open(c);
+		}
+		c->auth = auth;
+		c->seen = 1;
+	}
+
+	/* drop clients that closed the device */
+	for (i = 0; i < num_clients;) {
+		if (!clients[i].seen) {
+			client_close(&clients[i]);
+			clients[i] = clients[--num_clients];
+		} else {
+			i++;
+		}
+	}
+}
+
+static void sample_rings(void)
+{
+	unsigned i;
+
+	for (i = 0; i < NUM_RINGS; i++) {
+		uint32_t head, tail;
+
+		if (!rings[i].present)
+			continue;
+
+		head = INREG(rings[i].mmio + RING_HEAD) & HEAD_ADDR;
+		tail = INREG(rings[i].mmio + RING_TAIL) & TAIL_ADDR;
+		if (head != tail)
+			rings[i].busy++;
+	}
+}
+
+static void sample_clients(void)
+{
+	char wchan[WCHAN_BUF];
+	int i;
+
+	for (i = 0; i < num_clients; i++) {
+		struct client *c = &clients[i];
+		int len;
+
+		if (c->wchan_fd < 0)
+			continue;
+
+		len = pread(c->wchan_fd, wchan, sizeof(wchan) - 1, 0);
+		if (len <= 0)
+			continue;
+		wchan[len] = '\0';
+
+		c->samples++;
+		if (strstr(wchan, "i915") || strstr(wchan, "drm"))
+			c->wait_samples++;
+	}
+}
+
+static int cmp_wait(const void *a, const void *b)
+{
+	const struct client *ca = a, *cb = b;
+	double ra = ca->samples ? (double)ca->wait_samples / ca->samples : 0;
+	double rb = cb->samples ? (double)cb->wait_samples / cb->samples : 0;
+
+	if (ra < rb)
+		return 1;
+	return ra > rb ? -1 : 0;
+}
+
+static void print_interval(int ticks)
+{
+	unsigned i;
+
+	printf("\n");
+	for (i = 0; i < NUM_RINGS; i++) {
+		if (!rings[i].present)
+			continue;
+		printf("%s %5.1f%% busy  ", rings[i].name,
+		       100. * rings[i].busy / ticks);
+		rings[i].busy = 0;
+	}
+	printf("(%d clients)\n", num_clients);
+
+	qsort(clients, num_clients, sizeof(*clients), cmp_wait);
+
+	printf("%7s %-4s %-16s %s\n", "PID", "AUTH", "COMMAND", "GPU-WAIT%");
+	for (i = 0; i < (unsigned)num_clients; i++) {
+		struct client *c = &clients[i];
+
+		printf("%7d %-4c %-16s %8.1f\n", c->pid, c->auth, c->comm,
+		       c->samples ?
+		       100. * c->wait_samples / c->samples : 0.);
+		c->wait_samples = 0;
+		c->samples = 0;
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	struct debugfs_file clients_file;
+	struct pci_device *pci_dev;
+	uint32_t devid;
+	int samples_per_sec = 1000;
+	int duration = 0, elapsed = 0;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "s:t:h")) != -1) {
+		switch (ch) {
+		case 's':
+			samples_per_sec = atoi(optarg);
+			break;
+		case 't':
+			duration = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			fprintf(stderr,
+				"usage: %s [-s samples_per_sec] [-t seconds]\n",
+				argv[0]);
+			return ch == 'h' ? 0 : 1;
+		}
+	}
+	if (samples_per_sec < 100)
+		samples_per_sec = 100;
+
+	pci_dev = intel_get_pci_device();
+	devid = pci_dev->device_id;
+	intel_register_access_init(pci_dev, 0);
+	/* ring HEAD/TAIL are sampled with raw INREG below; hold forcewake
+	 * explicitly since the lazy path only covers intel_register_read */
+	if (intel_gen(devid) >= 6)
+		intel_forcewake_get();
+
+	rings[0].present = 1;
+	if (HAS_BSD_RING(devid)) {
+		if (intel_gen(devid) >= 6)
+			rings[2].present = 1;
+		else
+			rings[1].present = 1;
+	}
+	if (HAS_BLT_RING(devid))
+		rings[3].present = 1;
+
+	if (debugfs_file_open(&clients_file, "clients", CLIENTS_BUF))
+		errx(1, "couldn't open the drm clients file - "
+		     "is debugfs mounted?");
+
+	for (;;) {
+		int tick;
+
+		scan_clients(&clients_file);
+
+		for (tick = 0; tick < samples_per_sec; tick++) {
+			sample_rings();
+			sample_clients();
+			usleep(1000000 / samples_per_sec);
+		}
+
+		print_interval(samples_per_sec);
+
+		if (duration && ++elapsed >= duration)
+			break;
+	}
+
+	debugfs_file_close(&clients_file);
+	intel_register_access_fini();
+
+	return 0;
+}
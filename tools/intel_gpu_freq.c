@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * GT frequency controller.
+ *
+ * Pins or sweeps the GPU frequency through the gt_*_freq_mhz sysfs
+ * interfaces with plain write() calls, so a benchmark harness gets its
+ * frequency locked in one exec instead of a shell loop's worth of file
+ * churn.  Requested settings are cross-checked against the hardware via
+ * RPSTAT1 when register access is available, and -H keeps a daemon
+ * around that rewrites the pin every second in case another tool or a
+ * GPU reset undoes it.
+ */
+
+#define _GNU_SOURCE
+#include <err.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "intel_debugfs.h"
+#include "intel_gpu_tools.h"
+
+enum { CUR, MIN, MAX, RP0, RP1, RPn, NUM_FREQS };
+
+static const char *freq_names[NUM_FREQS] = {
+	"cur", "min", "max", "RP0", "RP1", "RPn"
+};
+
+static int freq_fds[NUM_FREQS];
+static int orig_min = -1, orig_max = -1;
+static bool have_mmio;
+
+static int read_freq(int which)
+{
+	char buf[32];
+	ssize_t len;
+
+	len = pread(freq_fds[which], buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		err(1, "reading gt_%s_freq_mhz", freq_names[which]);
+	buf[len] = '\0';
+
+	return atoi(buf);
+}
+
+static void write_freq(int which, int mhz)
+{
+	char buf[32];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%d", mhz);
+	if (pwrite(freq_fds[which], buf, len, 0) != len)
+		err(1, "writing %d to gt_%s_freq_mhz",
+		    mhz, freq_names[which]);
+}
+
+/* min before max when lowering, max before min when raising, so the
+ * intermediate state never has min > max and gets rejected */
+static void set_range(int min, int max)
+{
+	if (min > read_freq(MAX)) {
+		write_freq(MAX, max);
+		write_freq(MIN, min);
+	} else {
+		write_freq(MIN, min);
+		write_freq(MAX, max);
+	}
+}
+
+static int mmio_freq(void)
+{
+	/* CAGF, in 50MHz units on gen6/gen7 */
+	return ((intel_register_read(GEN6_RPSTAT1) >> 8) & 0xff) * 50;
+}
+
+static void verify(int mhz)
+{
+	int cur, i;
+
+	/* the governor needs a moment, and only reports the request
+	 * while something keeps the GT awake */
+	for (i = 0; i < 50; i++) {
+		cur = read_freq(CUR);
+		if (cur == mhz)
+			break;
+		usleep(2000);
+	}
+
+	if (cur != mhz)
+		printf("warning: requested %dMHz, sysfs reports %dMHz "
+		       "(GT may be idle)\n", mhz, cur);
+
+	if (have_mmio) {
+		int hw = mmio_freq();
+
+		if (hw && hw != mhz)
+			printf("warning: RPSTAT1 reports %dMHz\n", hw);
+	}
+}
+
+static void restore_range(int sig)
+{
+	if (orig_min != -1)
+		set_range(orig_min, orig_max);
+	if (sig)
+		_exit(0);
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [options]\n\n", name);
+	printf("Options:\n");
+	printf("    -g           get current frequency settings (default)\n");
+	printf("    -p <MHz>     pin min and max to the given frequency\n");
+	printf("    -m <MHz>     set minimum frequency\n");
+	printf("    -M <MHz>     set maximum frequency\n");
+	printf("    -S <ms>      sweep RPn..RP0 in 50MHz steps, dwelling <ms> at each\n");
+	printf("    -H           hold the setting: daemonize and rewrite it every second\n");
+	printf("    -r           restore defaults (min=RPn, max=RP0)\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct pci_device *pci_dev;
+	char card[128];
+	int pin = 0, min = 0, max = 0, dwell_ms = 0;
+	bool hold = false, restore = false;
+	int i, c;
+
+	if (intel_sysfs_card_path(card, sizeof(card))) {
+		printf("no i915 sysfs card directory found\n");
+		exit(77);
+	}
+
+	for (i = 0; i < NUM_FREQS; i++) {
+		char *path;
+
+		if (asprintf(&path, "%s/gt_%s_freq_mhz",
+			     card, freq_names[i]) == -1)
+			err(1, "asprintf");
+		freq_fds[i] = open(path, i == MIN || i == MAX ?
+				   O_RDWR : O_RDONLY);
+		if (freq_fds[i] == -1) {
+			printf("no %s: kernel too old\n", path);
+			exit(77);
+		}
+		free(path);
+	}
+
+	while ((c = getopt(argc, argv, "gp:m:M:S:Hrh")) != -1) {
+		switch (c) {
+		case 'g':
+			break;
+		case 'p':
+			pin = atoi(optarg);
+			break;
+		case 'm':
+			min = atoi(optarg);
+			break;
+		case 'M':
+			max = atoi(optarg);
+			break;
+		case 'S':
+			dwell_ms = atoi(optarg);
+			break;
+		case 'H':
+			hold = true;
+			break;
+		case 'r':
+			restore = true;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	/* hardware readback is a bonus, not a requirement; RPSTAT1
+	 * only means anything from gen6 on */
+	pci_dev = intel_get_pci_device();
+	if (intel_gen(pci_dev->device_id) >= 6 &&
+	    intel_register_access_init(pci_dev, 0) == 0)
+		have_mmio = true;
+
+	orig_min = read_freq(MIN);
+	orig_max = read_freq(MAX);
+
+	if (restore) {
+		set_range(read_freq(RPn), read_freq(RP0));
+	} else if (dwell_ms) {
+		int rpn = read_freq(RPn), rp0 = read_freq(RP0);
+		int mhz;
+
+		signal(SIGINT, restore_range);
+		signal(SIGTERM, restore_range);
+		for (mhz = rpn; mhz <= rp0; mhz += 50) {
+			set_range(mhz, mhz);
+			verify(mhz);
+			printf("%dMHz\n", mhz);
+			usleep(dwell_ms * 1000);
+		}
+		restore_range(0);
+	} else if (pin || min || max) {
+		if (pin)
+			min = max = pin;
+		if (!min)
+			min = orig_min;
+		if (!max)
+			max = orig_max;
+		set_range(min, max);
+		if (min == max)
+			verify(min);
+
+		if (hold) {
+			signal(SIGINT, restore_range);
+			signal(SIGTERM, restore_range);
+			if (daemon(0, 0))
+				err(1, "daemon");
+			for (;;) {
+				/* reassert in case a reset or another
+				 * tool clobbered the pin */
+				set_range(min, max);
+				sleep(1);
+			}
+		}
+	} else {
+		for (i = 0; i < NUM_FREQS; i++)
+			printf("gt frequency %s (MHz):  %d\n",
+			       freq_names[i], read_freq(i));
+		if (have_mmio)
+			printf("RPSTAT1 readback (MHz): %d\n", mmio_freq());
+	}
+
+	if (have_mmio)
+		intel_register_access_fini();
+
+	return 0;
+}
@@ -30,14 +30,36 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
 
 #include "intel_gpu_tools.h"
+#include "intel_clock.h"
 
 #define SAMPLES_PER_SEC             10000
 
+/* Timeline record stream written with -o.  One record per interval
+ * window so GPU-busy and CPU-busy can be correlated per phase instead
+ * of collapsed into a single end-of-run ratio. */
+#define GPU_TIME_MAGIC		0x47505554 /* "GPUT" */
+#define GPU_TIME_VERSION	1
+
+struct gpu_time_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t interval_us;
+	uint32_t num_records;
+};
+
+struct gpu_time_record {
+	uint64_t time_us;	/* window end, relative to child start */
+	uint32_t busy_samples;	/* ring head != tail in this window */
+	uint32_t total_samples;
+	uint64_t cpu_time_us;	/* cumulative child user+sys time */
+};
+
 static volatile int goddo;
 
 static pid_t spawn(char **argv)
@@ -57,53 +79,188 @@ static void sighandler(int sig)
 	goddo = sig;
 }
 
+/* Cumulative user+sys time of the still-running child, in usecs.
+ * getrusage(RUSAGE_CHILDREN) only covers reaped children, so sample
+ * /proc/<pid>/stat instead. */
+static uint64_t child_cpu_us(pid_t pid)
+{
+	static long ticks_per_sec;
+	unsigned long utime, stime;
+	char path[64], line[512];
+	char *p;
+	FILE *file;
+
+	if (!ticks_per_sec)
+		ticks_per_sec = sysconf(_SC_CLK_TCK);
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	file = fopen(path, "r");
+	if (file == NULL)
+		return 0;
+	p = fgets(line, sizeof(line), file);
+	fclose(file);
+	if (p == NULL)
+		return 0;
+
+	/* comm may contain spaces; skip past the closing paren */
+	p = strrchr(line, ')');
+	if (p == NULL)
+		return 0;
+	if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+		   "%lu %lu", &utime, &stime) != 2)
+		return 0;
+
+	return (utime + stime) * 1000000ull / ticks_per_sec;
+}
+
+static uint64_t elapsed_us(uint64_t start)
+{
+	return intel_clock_to_us(intel_clock_now() - start);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-i interval_us] [-o timeline.bin] cmd [args...]\n"
+		"  -i  timeline window length in usecs (default 10000)\n"
+		"  -o  write per-window binary records to the given file;\n"
+		"      without -o the timeline is printed as text\n",
+		name);
+}
+
 int main(int argc, char **argv)
 {
 	pid_t child;
 	uint64_t ring_idle = 0, ring_time = 0;
-	struct timeval start, end;
+	uint64_t start, total_us;
 	static struct rusage rusage;
+	int interval_us = 10000;
+	int timeline = 0;
+	const char *output = NULL;
+	FILE *record_file = NULL;
+	struct gpu_time_header header;
+	struct gpu_time_record record;
+	uint32_t window_busy = 0, window_total = 0;
+	uint64_t window_end, last_cpu_us = 0;
+	uint32_t num_records = 0;
 	int status;
+	int c;
 
-	intel_get_mmio(intel_get_pci_device());
+	/* "+" stops option parsing at the command to be timed */
+	while ((c = getopt(argc, argv, "+i:o:h")) != -1) {
+		switch (c) {
+		case 'i':
+			interval_us = atoi(optarg);
+			if (interval_us < 1000)
+				interval_us = 1000;
+			timeline = 1;
+			break;
+		case 'o':
+			output = optarg;
+			timeline = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
 
-	if (argc == 1) {
-		fprintf(stderr, "usage: %s cmd [args...]\n", argv[0]);
+	if (optind == argc) {
+		usage(argv[0]);
 		return 1;
 	}
 
+	intel_get_mmio(intel_get_pci_device());
+
+	if (output) {
+		record_file = fopen(output, "w");
+		if (record_file == NULL) {
+			perror(output);
+			return 1;
+		}
+
+		/* num_records is patched in once the run is over */
+		header.magic = GPU_TIME_MAGIC;
+		header.version = GPU_TIME_VERSION;
+		header.interval_us = interval_us;
+		header.num_records = 0;
+		fwrite(&header, sizeof(header), 1, record_file);
+	}
+
 	signal(SIGCHLD, sighandler);
 	signal(SIGINT, SIG_IGN);
 	signal(SIGQUIT, SIG_IGN);
 
-	gettimeofday(&start, NULL);
-	child = spawn(argv+1);
+	start = intel_clock_now();
+	child = spawn(argv+optind);
 	if (child < 0)
 		return 127;
 
+	window_end = interval_us;
+
 	while (!goddo) {
 		uint32_t ring_head, ring_tail;
+		int busy;
 
 		ring_head = INREG(LP_RING + RING_HEAD) & HEAD_ADDR;
 		ring_tail = INREG(LP_RING + RING_TAIL) & TAIL_ADDR;
 
-		if (ring_tail == ring_head)
+		busy = ring_tail != ring_head;
+		if (!busy)
 			ring_idle++;
 		ring_time++;
 
+		if (timeline) {
+			window_busy += busy;
+			window_total++;
+
+			if (elapsed_us(start) >= window_end) {
+				uint64_t cpu_us = child_cpu_us(child);
+
+				if (record_file) {
+					record.time_us = window_end;
+					record.busy_samples = window_busy;
+					record.total_samples = window_total;
+					record.cpu_time_us = cpu_us;
+					fwrite(&record, sizeof(record), 1,
+					       record_file);
+				} else {
+					printf("+%7.3fs: GPU %5.1f%% "
+					       "CPU %5.1f%%\n",
+					       window_end / 1e6,
+					       window_busy * 100. /
+					       window_total,
+					       (cpu_us - last_cpu_us) * 100. /
+					       interval_us);
+				}
+				num_records++;
+				last_cpu_us = cpu_us;
+				window_busy = 0;
+				window_total = 0;
+				window_end += interval_us;
+			}
+		}
+
 		usleep(1000000 / SAMPLES_PER_SEC);
 	}
-	gettimeofday(&end, NULL);
-	timersub(&end, &start, &end);
+	total_us = elapsed_us(start);
 
 	waitpid(child, &status, 0);
 
+	if (record_file) {
+		header.num_records = num_records;
+		rewind(record_file);
+		fwrite(&header, sizeof(header), 1, record_file);
+		fclose(record_file);
+	}
+
 	getrusage(RUSAGE_CHILDREN, &rusage);
-	printf("user: %ld.%06lds, sys: %ld.%06lds, elapsed: %ld.%06lds, CPU: %.1f%%, GPU: %.1f%%\n",
+	printf("user: %ld.%06lds, sys: %ld.%06lds, elapsed: %.6fs, CPU: %.1f%%, GPU: %.1f%%\n",
 	       rusage.ru_utime.tv_sec, rusage.ru_utime.tv_usec,
 	       rusage.ru_stime.tv_sec, rusage.ru_stime.tv_usec,
-	       end.tv_sec, end.tv_usec,
-	       100*(rusage.ru_utime.tv_sec + 1e-6*rusage.ru_utime.tv_usec + rusage.ru_stime.tv_sec + 1e-6*rusage.ru_stime.tv_usec) / (end.tv_sec + 1e-6*end.tv_usec),
+	       total_us * 1e-6,
+	       100*(rusage.ru_utime.tv_sec + 1e-6*rusage.ru_utime.tv_usec + rusage.ru_stime.tv_sec + 1e-6*rusage.ru_stime.tv_usec) / (total_us * 1e-6),
 	       100 - ring_idle * 100. / ring_time);
 
 	return WEXITSTATUS(status);
@@ -32,8 +32,16 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <assert.h>
 #include <err.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <string.h>
@@ -42,6 +50,9 @@
 #endif
 #include "intel_gpu_tools.h"
 #include "instdone.h"
+#include "intel_alloc_audit.h"
+#include "intel_freq_log.h"
+#include "intel_sampler.h"
 
 #define  FORCEWAKE	    0xA18C
 #define  FORCEWAKE_ACK	    0x130090
@@ -53,14 +64,36 @@
 
 #define HAS_STATS_REGS(devid)		IS_965(devid)
 
+/* The sampler thread only ever increments the monotonic count; the
+ * display thread derives per-refresh deltas from its own last_count
+ * shadow, so neither side ever waits on the other. */
 struct top_bit {
-	struct instdone_bit *bit;
+	const struct instdone_bit *bit;
 	int count;
+	int last_count;
+	int period_count;
 } top_bits[MAX_NUM_TOP_BITS];
 struct top_bit *top_bits_sorted[MAX_NUM_TOP_BITS];
 
 static uint32_t instdone, instdone1;
 
+/* All registers polled in the sampling loop are collected into one batched
+ * pass per tick through an intel_sampler, so adding rings or counters
+ * doesn't add per-sample call overhead. */
+#define SAMPLER_DEPTH	64
+#define MAX_SAMPLE_REGS	16
+
+static uint32_t sample_regs[MAX_SAMPLE_REGS];
+static int num_sample_regs;
+static int instdone_idx = -1, instdone1_idx = -1;
+
+static int add_sample_reg(uint32_t reg)
+{
+	assert(num_sample_regs < MAX_SAMPLE_REGS);
+	sample_regs[num_sample_regs] = reg;
+	return num_sample_regs++;
+}
+
 static const char *bars[] = {
 	" ",
 	"▏",
@@ -121,20 +154,23 @@ gettime(void)
     return (t.tv_usec + (t.tv_sec * 1000000));
 }
 
-static int
-top_bits_sort(const void *a, const void *b)
+/* Between refreshes the counts barely move, so the previous ordering is
+ * already nearly correct and a single insertion pass is effectively
+ * O(n), vs. re-running qsort over every bit each refresh. */
+static void
+top_bits_resort(void)
 {
-	struct top_bit * const *bit_a = a;
-	struct top_bit * const *bit_b = b;
-	int a_count = (*bit_a)->count;
-	int b_count = (*bit_b)->count;
+	int i, j;
 
-	if (a_count < b_count)
-		return 1;
-	else if (a_count == b_count)
-		return 0;
-	else
-		return -1;
+	for (i = 1; i < num_instdone_bits; i++) {
+		struct top_bit *entry = top_bits_sorted[i];
+
+		for (j = i; j > 0 &&
+		     top_bits_sorted[j - 1]->period_count <
+		     entry->period_count; j--)
+			top_bits_sorted[j] = top_bits_sorted[j - 1];
+		top_bits_sorted[j] = entry;
+	}
 }
 
 static void
@@ -310,8 +346,15 @@ struct ring {
 	const char *name;
 	uint32_t mmio;
 	int head, tail, size;
+	/* monotonic, written by the sampler thread */
 	uint64_t full;
-	int idle;
+	uint64_t idle;
+	/* per-refresh deltas, maintained by the display thread */
+	uint64_t last_full, last_idle;
+	uint64_t period_full;
+	int period_idle;
+	int sample_idx;
+	int stall_head, stall_secs;
 };
 
 static uint32_t ring_read(struct ring *ring, uint32_t reg)
@@ -322,22 +365,32 @@ static uint32_t ring_read(struct ring *ring, uint32_t reg)
 static void ring_init(struct ring *ring)
 {
 	ring->size = (((ring_read(ring, RING_LEN) & RING_NR_PAGES) >> 12) + 1) * 4096;
+	if (ring->size) {
+		ring->sample_idx = add_sample_reg(ring->mmio + RING_HEAD);
+		add_sample_reg(ring->mmio + RING_TAIL);
+	}
 }
 
-static void ring_reset(struct ring *ring)
+static void ring_collect(struct ring *ring)
 {
-	ring->idle = ring->full = 0;
+	uint64_t idle = ring->idle;
+	uint64_t full = ring->full;
+
+	ring->period_idle = idle - ring->last_idle;
+	ring->period_full = full - ring->last_full;
+	ring->last_idle = idle;
+	ring->last_full = full;
 }
 
-static void ring_sample(struct ring *ring)
+static void ring_sample(struct ring *ring, const uint32_t *sample)
 {
 	int full;
 
 	if (!ring->size)
 		return;
 
-	ring->head = ring_read(ring, RING_HEAD) & HEAD_ADDR;
-	ring->tail = ring_read(ring, RING_TAIL) & TAIL_ADDR;
+	ring->head = sample[ring->sample_idx] & HEAD_ADDR;
+	ring->tail = sample[ring->sample_idx + 1] & TAIL_ADDR;
 
 	if (ring->tail == ring->head)
 		ring->idle++;
@@ -362,13 +415,13 @@ static void ring_print(struct ring *ring, unsigned long samples_per_sec)
 	if (!ring->size)
 		return;
 
-	percent_busy = 100 - 100 * ring->idle / samples_per_sec;
+	percent_busy = 100 - 100 * ring->period_idle / samples_per_sec;
 
 	len = printf("%25s busy: %3d%%: ", ring->name, percent_busy);
 	print_percentage_bar (percent_busy, len);
 	printf("%24s space: %d/%d\n",
 		   ring->name,
-		   (int)(ring->full / samples_per_sec),
+		   (int)(ring->period_full / samples_per_sec),
 		   ring->size);
 }
 
@@ -377,12 +430,540 @@ static void ring_log(struct ring *ring, unsigned long samples_per_sec,
 {
 	if (ring->size)
 		fprintf(output, "%3d\t%d\t",
-			(int)(100 - 100 * ring->idle / samples_per_sec),
-			(int)(ring->full / samples_per_sec));
+			(int)(100 - 100 * ring->period_idle / samples_per_sec),
+			(int)(ring->period_full / samples_per_sec));
 	else
 		fprintf(output, "-1\t-1\t");
 }
 
+/* Flight recorder.
+ *
+ * In recording mode every tick's raw sample vector is copied into a
+ * fixed-size ring that is allocated once up front, so the tool can run
+ * at full sampling frequency for weeks without touching the allocator.
+ * The ring is dumped to a compact binary file on SIGUSR1 or when a ring
+ * looks wedged (busy for several consecutive seconds with HEAD pinned),
+ * giving a trace of the last ~minute leading up to the stall.
+ */
+#define FLIGHT_MAGIC		0x47505546	/* "GPUF" */
+#define FLIGHT_VERSION		1
+#define FLIGHT_SLOTS		(64 * 1024)	/* power of two */
+#define FLIGHT_STALL_SECS	3
+
+struct flight_record {
+	uint64_t time_us;
+	uint32_t regs[MAX_SAMPLE_REGS];
+};
+
+struct flight_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_regs;
+	uint32_t num_records;
+	uint32_t sample_regs[MAX_SAMPLE_REGS];
+};
+
+static struct flight_record *flight_ring;
+static unsigned int flight_pos, flight_count;
+static const char *flight_path;
+static volatile sig_atomic_t flight_dump_requested;
+
+static void flight_sigusr1(int sig)
+{
+	flight_dump_requested = 1;
+}
+
+static void flight_init(const char *path)
+{
+	flight_path = path;
+	flight_ring = calloc(FLIGHT_SLOTS, sizeof(*flight_ring));
+	if (!flight_ring)
+		err(1, "allocating flight recorder ring");
+	signal(SIGUSR1, flight_sigusr1);
+}
+
+static inline void flight_record_sample(uint64_t time_us,
+					const uint32_t *sample)
+{
+	struct flight_record *record;
+
+	if (!flight_ring)
+		return;
+
+	record = &flight_ring[flight_pos];
+	record->time_us = time_us;
+	memcpy(record->regs, sample, num_sample_regs * sizeof(uint32_t));
+
+	flight_pos = (flight_pos + 1) & (FLIGHT_SLOTS - 1);
+	if (flight_count < FLIGHT_SLOTS)
+		flight_count++;
+}
+
+static void flight_dump(const char *reason)
+{
+	struct flight_header header;
+	unsigned int start, i;
+	FILE *file;
+
+	file = fopen(flight_path, "w");
+	if (file == NULL) {
+		perror(flight_path);
+		return;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = FLIGHT_MAGIC;
+	header.version = FLIGHT_VERSION;
+	header.num_regs = num_sample_regs;
+	header.num_records = flight_count;
+	memcpy(header.sample_regs, sample_regs, sizeof(sample_regs));
+	fwrite(&header, sizeof(header), 1, file);
+
+	start = (flight_pos + FLIGHT_SLOTS - flight_count) &
+		(FLIGHT_SLOTS - 1);
+	for (i = 0; i < flight_count; i++)
+		fwrite(&flight_ring[(start + i) & (FLIGHT_SLOTS - 1)],
+		       sizeof(struct flight_record), 1, file);
+
+	fclose(file);
+	fprintf(stderr, "intel_gpu_top: dumped %u flight records to %s (%s)\n",
+		flight_count, flight_path, reason);
+}
+
+/* A ring that stays busy with HEAD not moving for a few seconds straight
+ * is almost certainly wedged; that's exactly the moment the flight
+ * recorder exists for. */
+static void ring_check_stall(struct ring *ring)
+{
+	if (!flight_ring || !ring->size)
+		return;
+
+	if (ring->period_idle == 0 && ring->head == ring->stall_head) {
+		if (++ring->stall_secs == FLIGHT_STALL_SECS)
+			flight_dump(ring->name);
+	} else
+		ring->stall_secs = 0;
+
+	ring->stall_head = ring->head;
+}
+
+/* Frequency correlation log.
+ *
+ * print_clock_info() reads the clock once at startup, which can't say
+ * whether a workload is limited by dispatch or by the frequency the GPU
+ * actually ran at.  With -F, GEN6_RPSTAT1 (CAGF) joins the batched
+ * sample vector, so every tick carries frequency and per-ring occupancy
+ * read back-to-back, and the pairs are streamed as timestamped binary
+ * records: sampler thread into a ring, display thread to the file.
+ * intel_freq_histogram turns the stream into occupancy-at-frequency
+ * histograms offline; intel_freq_log.h holds the file format.
+ */
+#define FREQLOG_SLOTS		(64 * 1024)	/* power of two */
+
+static struct freqlog_record *freqlog_ring;
+static volatile unsigned int freqlog_head, freqlog_tail;
+static unsigned int freqlog_dropped;
+static const char *freqlog_path;
+static FILE *freqlog_file;
+static int rpstat_idx = -1;
+
+static void freqlog_open(int samples_per_sec, struct ring *rings[4])
+{
+	struct freqlog_header header;
+	int i;
+
+	freqlog_ring = calloc(FREQLOG_SLOTS, sizeof(*freqlog_ring));
+	if (!freqlog_ring)
+		err(1, "allocating freq log ring");
+
+	freqlog_file = fopen(freqlog_path, "w");
+	if (!freqlog_file)
+		err(1, "%s", freqlog_path);
+
+	header.magic = FREQLOG_MAGIC;
+	header.version = FREQLOG_VERSION;
+	header.samples_per_sec = samples_per_sec;
+	for (i = 0; i < 4; i++)
+		header.ring_size[i] = rings[i]->size;
+	fwrite(&header, sizeof(header), 1, freqlog_file);
+}
+
+static inline void freqlog_record_sample(uint64_t time_us,
+					 const uint32_t *sample,
+					 struct ring *rings[4])
+{
+	struct freqlog_record *record;
+	int i;
+
+	if (!freqlog_ring)
+		return;
+
+	/* a stuck consumer costs records, never sampler time */
+	if (freqlog_head - freqlog_tail == FREQLOG_SLOTS) {
+		freqlog_dropped++;
+		return;
+	}
+
+	record = &freqlog_ring[freqlog_head & (FREQLOG_SLOTS - 1)];
+	record->time_us = time_us;
+	record->freq_mhz = ((sample[rpstat_idx] >> 8) & 0xff) * 50;
+	for (i = 0; i < 4; i++) {
+		if (rings[i]->size) {
+			int full = rings[i]->tail - rings[i]->head;
+
+			if (full < 0)
+				full += rings[i]->size;
+			record->occupancy[i] = full;
+		} else
+			record->occupancy[i] = -1;
+	}
+
+	__sync_synchronize();
+	freqlog_head++;
+}
+
+static void freqlog_drain(void)
+{
+	while (freqlog_tail != freqlog_head) {
+		fwrite(&freqlog_ring[freqlog_tail & (FREQLOG_SLOTS - 1)],
+		       sizeof(struct freqlog_record), 1, freqlog_file);
+		__sync_synchronize();
+		freqlog_tail++;
+	}
+	fflush(freqlog_file);
+}
+
+/* Binary stats export for fleet collectors.
+ *
+ * A small file (put it on tmpfs) is mmap'd shared and filled with a ring
+ * of fixed-size per-period records.  The writer never does any text
+ * formatting and readers never parse; a seqlock around each publish lets
+ * the collector snapshot records without stopping the sampler.
+ */
+#define SHM_STATS_MAGIC		0x47505554	/* "GPUT" */
+#define SHM_STATS_VERSION	1
+#define SHM_STATS_SLOTS		64
+
+struct shm_stats_record {
+	uint64_t elapsed_us;
+	uint32_t ring_busy[4];		/* percent busy per ring */
+	uint32_t ring_ops[4];		/* mean bytes pending per ring */
+	uint64_t stats[STATS_COUNT];	/* pipeline counter deltas */
+};
+
+struct shm_stats_head {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_slots;
+	uint32_t record_size;
+	volatile uint64_t seq;		/* odd while a record is in flight */
+	volatile uint64_t head;		/* slot of the newest valid record */
+};
+
+static struct shm_stats_head *shm_head;
+static struct shm_stats_record *shm_records;
+
+static void shm_stats_init(const char *path)
+{
+	size_t size = sizeof(struct shm_stats_head) +
+		SHM_STATS_SLOTS * sizeof(struct shm_stats_record);
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, size) < 0) {
+		perror(path);
+		exit(1);
+	}
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+
+	shm_head = map;
+	shm_records = (struct shm_stats_record *)(shm_head + 1);
+
+	memset(map, 0, size);
+	shm_head->num_slots = SHM_STATS_SLOTS;
+	shm_head->record_size = sizeof(struct shm_stats_record);
+	shm_head->version = SHM_STATS_VERSION;
+	shm_head->magic = SHM_STATS_MAGIC;
+}
+
+static void shm_stats_publish(uint64_t elapsed_us, struct ring *rings[4],
+			      unsigned long samples_per_sec)
+{
+	struct shm_stats_record *record;
+	uint64_t slot;
+	int i;
+
+	if (!shm_head)
+		return;
+
+	slot = (shm_head->head + 1) % SHM_STATS_SLOTS;
+	record = &shm_records[slot];
+
+	shm_head->seq++;
+	__sync_synchronize();
+
+	record->elapsed_us = elapsed_us;
+	for (i = 0; i < 4; i++) {
+		if (rings[i]->size) {
+			record->ring_busy[i] = 100 -
+				100 * rings[i]->period_idle / samples_per_sec;
+			record->ring_ops[i] = rings[i]->period_full /
+				samples_per_sec;
+		} else {
+			record->ring_busy[i] = -1;
+			record->ring_ops[i] = -1;
+		}
+	}
+	for (i = 0; i < STATS_COUNT; i++)
+		record->stats[i] = stats[i] - last_stats[i];
+
+	__sync_synchronize();
+	shm_head->head = slot;
+	shm_head->seq++;
+}
+
+/* Dashboard mode.
+ *
+ * One compact screen with every ring's recent occupancy as a sparkline
+ * drawn from the same per-refresh deltas, plus the i915 interrupt rate
+ * and RC6 residency.  All history lives in fixed arrays sized at
+ * compile time, so the display costs the same whether it runs for a
+ * minute or a week, and since every ring's column comes from the same
+ * batched sample vector the timelines line up exactly - which is the
+ * whole point when staring at video+3D interference.
+ */
+#define DASH_HISTORY	60
+
+static int dashboard;
+static uint8_t dash_busy[4][DASH_HISTORY];
+static int dash_pos;
+static int irq_fd = -1;
+static uint64_t dash_last_irqs;
+static uint32_t dash_last_rc6;
+static unsigned long long dash_last_time;
+
+/* sum of the per-cpu counts on the i915 line of /proc/interrupts */
+static uint64_t read_i915_irqs(void)
+{
+	static char buf[16384];
+	uint64_t total = 0;
+	char *line, *p;
+	int len;
+
+	if (irq_fd == -1)
+		irq_fd = open("/proc/interrupts", O_RDONLY);
+	if (irq_fd == -1)
+		return 0;
+
+	len = pread(irq_fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return 0;
+	buf[len] = '\0';
+
+	line = strstr(buf, "i915");
+	if (!line)
+		return 0;
+
+	/* walk back to the start of the line, then past the "NN:" label */
+	while (line > buf && line[-1] != '\n')
+		line--;
+	p = strchr(line, ':');
+	if (!p)
+		return 0;
+	p++;
+
+	while (*p == ' ' || (*p >= '0' && *p <= '9')) {
+		if (*p == ' ') {
+			p++;
+			continue;
+		}
+		total += strtoull(p, &p, 10);
+	}
+
+	return total;
+}
+
+static void dash_update(struct ring *rings[4], unsigned long period_samples)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		int busy = 0;
+
+		if (rings[i]->size)
+			busy = 100 - 100 * rings[i]->period_idle /
+				period_samples;
+		if (busy < 0)
+			busy = 0;
+		if (busy > 100)
+			busy = 100;
+		dash_busy[i][dash_pos] = busy;
+	}
+	dash_pos = (dash_pos + 1) % DASH_HISTORY;
+}
+
+static void dash_print(struct ring *rings[4], uint32_t devid,
+		       int samples_per_sec)
+{
+	unsigned long long now = gettime();
+	double dt = (now - dash_last_time) / 1000000.0;
+	uint64_t irqs = read_i915_irqs();
+	int i, j;
+
+	if (dt <= 0)
+		dt = 1;
+
+	printf("ring occupancy (%%), %d samples/sec, last %d refreshes\n\n",
+	       samples_per_sec, DASH_HISTORY);
+
+	for (i = 0; i < 4; i++) {
+		int newest = (dash_pos + DASH_HISTORY - 1) % DASH_HISTORY;
+
+		if (!rings[i]->size)
+			continue;
+
+		printf("%10.10s %3d%% ", rings[i]->name,
+		       dash_busy[i][newest]);
+		for (j = 0; j < DASH_HISTORY; j++) {
+			int busy = dash_busy[i][(dash_pos + j) % DASH_HISTORY];
+
+			printf("%s", bars[busy * 8 / 100]);
+		}
+		printf("\n");
+	}
+
+	printf("\nirqs: %8.0f/sec", (irqs - dash_last_irqs) / dt);
+	dash_last_irqs = irqs;
+
+	if (IS_GEN6(devid) || IS_GEN7(devid)) {
+		uint32_t rc6 = INREG(RC6_RESIDENCY_TIME);
+		/* the residency counter ticks every 1.28us */
+		double pct = (rc6 - dash_last_rc6) * 1.28 / (dt * 1000000.0)
+			* 100.0;
+
+		if (pct > 100)
+			pct = 100;
+		printf("   rc6: %3.0f%%", pct);
+		dash_last_rc6 = rc6;
+	}
+	printf("\n");
+
+	dash_last_time = now;
+}
+
+/* The sampler runs on its own thread so the display side's sorting and
+ * formatting can't delay the next register read; all it shares with the
+ * display are monotonically increasing counters. */
+struct sampler_thread_args {
+	struct intel_sampler *sampler;
+	struct ring **rings;
+	int samples_per_sec;
+};
+
+static volatile unsigned long total_samples;
+static volatile unsigned long missed_samples;
+
+/* A periodic timerfd keeps its own grid in the kernel: unlike the old
+ * compute-then-usleep pacing, a slow tick doesn't shift every later
+ * tick, and any expiry we were too late to service is reported in the
+ * read count instead of silently stretching the period. */
+static int periodic_timer_open(unsigned long long interval_ns)
+{
+	struct itimerspec its;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (fd < 0)
+		err(1, "timerfd_create");
+
+	its.it_interval.tv_sec = interval_ns / 1000000000ULL;
+	its.it_interval.tv_nsec = interval_ns % 1000000000ULL;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fd, 0, &its, NULL))
+		err(1, "timerfd_settime");
+
+	return fd;
+}
+
+static int timer_epoll_open(int timer_fd)
+{
+	struct epoll_event ev;
+	int epoll_fd;
+
+	epoll_fd = epoll_create1(0);
+	if (epoll_fd < 0)
+		err(1, "epoll_create1");
+
+	ev.events = EPOLLIN;
+	ev.data.fd = timer_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev))
+		err(1, "epoll_ctl");
+
+	return epoll_fd;
+}
+
+static unsigned long long timer_epoll_wait(int epoll_fd, int timer_fd)
+{
+	unsigned long long expirations;
+	struct epoll_event ev;
+
+	while (epoll_wait(epoll_fd, &ev, 1, -1) < 0) {
+		if (errno != EINTR)
+			err(1, "epoll_wait");
+	}
+	if (read(timer_fd, &expirations, sizeof(expirations)) !=
+	    sizeof(expirations))
+		expirations = 1;
+
+	return expirations;
+}
+
+static void *sampler_thread_func(void *arg)
+{
+	struct sampler_thread_args *args = arg;
+	int timer_fd, epoll_fd;
+
+	timer_fd = periodic_timer_open(1000000000ULL / args->samples_per_sec);
+	epoll_fd = timer_epoll_open(timer_fd);
+
+	for (;;) {
+		unsigned long long expirations;
+		const uint32_t *sample;
+		int j;
+
+		expirations = timer_epoll_wait(epoll_fd, timer_fd);
+		if (expirations > 1)
+			missed_samples += expirations - 1;
+
+		intel_sampler_sample(args->sampler);
+		sample = intel_sampler_get(args->sampler, 0);
+
+		flight_record_sample(gettime(), sample);
+
+		instdone = sample[instdone_idx];
+		if (instdone1_idx >= 0)
+			instdone1 = sample[instdone1_idx];
+
+		for (j = 0; j < num_instdone_bits; j++)
+			update_idle_bit(&top_bits[j]);
+
+		for (j = 0; j < 4; j++)
+			ring_sample(args->rings[j], sample);
+
+		freqlog_record_sample(gettime(), sample, args->rings);
+
+		total_samples++;
+	}
+
+	return NULL;
+}
+
 static void
 usage(const char *appname)
 {
@@ -395,6 +976,14 @@ usage(const char *appname)
 			"[-e <command>]       command to profile\n"
 			"[-o <file>]          output statistics to file. If file is '-',"
 			"                     run in batch mode and output statistics to stdio only \n"
+			"[-S <file>]          export binary statistics via a mmap'd ring in file\n"
+			"[-d]                 dashboard mode: per-ring occupancy sparklines,\n"
+			"                     irq rate and rc6 residency on one screen\n"
+			"[-r <refreshes>]     screen refreshes per second (default 1)\n"
+			"[-R <file>]          flight-recorder mode: keep a ring of raw samples,\n"
+			"                     dumped to file on SIGUSR1 or on a detected stall\n"
+			"[-F <file>]          log correlated frequency/ring-occupancy samples\n"
+			"                     to file (gen6+); decode with intel_freq_histogram\n"
 			"[-h]                 show this help screen\n"
 			"\n",
 			appname,
@@ -420,21 +1009,43 @@ int main(int argc, char **argv)
 		.name = "blitter",
 		.mmio = 0x22030,
 	};
+	struct intel_sampler sampler;
+	struct sampler_thread_args sampler_args;
+	pthread_t sampler_thread;
+	struct ring *rings[4];
+	unsigned long last_total_samples = 0;
+	int refresh_fd, refresh_epoll_fd;
 	int i, ch;
 	int samples_per_sec = SAMPLES_PER_SEC;
+	int refreshes_per_sec = 1;
 	FILE *output = NULL;
 	double elapsed_time=0;
 	int print_headers=1;
 	pid_t child_pid=-1;
+	int audit_warmup = 2;
 	int child_stat;
 	char *cmd=NULL;
 	int interactive=1;
 
 	/* Parse options? */
-	while ((ch = getopt(argc, argv, "s:o:e:h")) != -1) {
+	while ((ch = getopt(argc, argv, "s:o:S:R:F:r:e:dh")) != -1) {
 		switch (ch) {
 		case 'e': cmd = strdup(optarg);
 			break;
+		case 'd': dashboard = 1;
+			break;
+		case 'r': refreshes_per_sec = atoi(optarg);
+			if (refreshes_per_sec < 1 || refreshes_per_sec > 60) {
+				fprintf(stderr, "Error: refreshes per second must be 1-60\n");
+				exit(1);
+			}
+			break;
+		case 'S': shm_stats_init(optarg);
+			break;
+		case 'R': flight_init(optarg);
+			break;
+		case 'F': freqlog_path = optarg;
+			break;
 		case 's': samples_per_sec = atoi(optarg);
 			if (samples_per_sec < 100) {
 				fprintf(stderr, "Error: samples per second must be >= 100\n");
@@ -503,11 +1114,23 @@ int main(int argc, char **argv)
 	for (i = 0; i < num_instdone_bits; i++) {
 		top_bits[i].bit = &instdone_bits[i];
 		top_bits[i].count = 0;
+		top_bits[i].last_count = 0;
+		top_bits[i].period_count = 0;
 		top_bits_sorted[i] = &top_bits[i];
 	}
 
-	/* Grab access to the registers */
+	/* Grab access to the registers.  The sampler reads the GT ring
+	 * registers with raw INREG, bypassing the lazy-wake path, so take
+	 * an explicit forcewake reference up front. */
 	intel_register_access_init(pci_dev, 0);
+	if (intel_gen(devid) >= 6)
+		intel_forcewake_get();
+
+	if (IS_965(devid)) {
+		instdone_idx = add_sample_reg(INST_DONE_I965);
+		instdone1_idx = add_sample_reg(INST_DONE_1);
+	} else
+		instdone_idx = add_sample_reg(INST_DONE);
 
 	ring_init(&render_ring);
 	if (IS_GEN4(devid) || IS_GEN5(devid))
@@ -517,6 +1140,15 @@ int main(int argc, char **argv)
 		ring_init(&blt_ring);
 	}
 
+	if (freqlog_path) {
+		if (!IS_GEN6(devid) && !IS_GEN7(devid))
+			errx(1, "-F needs gen6+ (no CAGF register)");
+		rpstat_idx = add_sample_reg(GEN6_RPSTAT1);
+	}
+
+	intel_sampler_init(&sampler, sample_regs, num_sample_regs,
+			   SAMPLER_DEPTH);
+
 	/* Initialize GPU stats */
 	if (HAS_STATS_REGS(devid)) {
 		for (i = 0; i < STATS_COUNT; i++) {
@@ -533,11 +1165,32 @@ int main(int argc, char **argv)
 		}
 	}
 
+	rings[0] = &render_ring;
+	rings[1] = &bsd_ring;
+	rings[2] = &bsd6_ring;
+	rings[3] = &blt_ring;
+
+	if (freqlog_path)
+		freqlog_open(samples_per_sec, rings);
+
+	sampler_args.sampler = &sampler;
+	sampler_args.rings = rings;
+	sampler_args.samples_per_sec = samples_per_sec;
+	if (pthread_create(&sampler_thread, NULL, sampler_thread_func,
+			   &sampler_args))
+		errx(1, "spawning sampler thread failed");
+
+	/* The display consumer paces itself off its own timerfd, so time
+	 * spent formatting or blocked on a slow tty never feeds back into
+	 * the refresh period - the next expiry is already armed. */
+	refresh_fd = periodic_timer_open(1000000000ULL / refreshes_per_sec);
+	dash_last_time = gettime();
+	dash_last_irqs = read_i915_irqs();
+	refresh_epoll_fd = timer_epoll_open(refresh_fd);
+
 	for (;;) {
-		int j;
-		unsigned long long t1, ti, tf, t2;
-		unsigned long long def_sleep = 1000000 / samples_per_sec;
-		unsigned long long last_samples_per_sec = samples_per_sec;
+		unsigned long long t1, t2;
+		unsigned long period_samples;
 		unsigned short int max_lines;
 		struct winsize ws;
 		char clear_screen[] = {0x1b, '[', 'H',
@@ -548,39 +1201,34 @@ int main(int argc, char **argv)
 
 		t1 = gettime();
 
-		ring_reset(&render_ring);
-		ring_reset(&bsd_ring);
-		ring_reset(&bsd6_ring);
-		ring_reset(&blt_ring);
-
-		for (i = 0; i < samples_per_sec; i++) {
-			long long interval;
-			ti = gettime();
-			if (IS_965(devid)) {
-				instdone = INREG(INST_DONE_I965);
-				instdone1 = INREG(INST_DONE_1);
-			} else
-				instdone = INREG(INST_DONE);
-
-			for (j = 0; j < num_instdone_bits; j++)
-				update_idle_bit(&top_bits[j]);
-
-			ring_sample(&render_ring);
-			ring_sample(&bsd_ring);
-			ring_sample(&bsd6_ring);
-			ring_sample(&blt_ring);
-
-			tf = gettime();
-			if (tf - t1 >= 1000000) {
-				/* We are out of sync, bail out */
-				last_samples_per_sec = i+1;
-				break;
-			}
-			interval = def_sleep - (tf - ti);
-			if (interval > 0)
-				usleep(interval);
+		timer_epoll_wait(refresh_epoll_fd, refresh_fd);
+
+		/* bail before the next register read hits a stale BAR */
+		if (intel_mmio_revoked()) {
+			fprintf(stderr, "device revoked, exiting\n");
+			break;
+		}
+
+		/* Snapshot the sampler's monotonic counters and turn them
+		 * into per-refresh deltas; the sampler never blocks on us. */
+		period_samples = total_samples - last_total_samples;
+		last_total_samples += period_samples;
+		if (period_samples == 0)
+			period_samples = 1;
+
+		for (i = 0; i < num_instdone_bits; i++) {
+			int count = top_bits[i].count;
+
+			top_bits[i].period_count =
+				count - top_bits[i].last_count;
+			top_bits[i].last_count = count;
 		}
 
+		ring_collect(&render_ring);
+		ring_collect(&bsd_ring);
+		ring_collect(&bsd6_ring);
+		ring_collect(&blt_ring);
+
 		if (HAS_STATS_REGS(devid)) {
 			for (i = 0; i < STATS_COUNT; i++) {
 				uint32_t stats_high, stats_low, stats_high_2;
@@ -596,8 +1244,7 @@ int main(int argc, char **argv)
 			}
 		}
 
-		qsort(top_bits_sorted, num_instdone_bits,
-		      sizeof(struct top_bit *), top_bits_sort);
+		top_bits_resort();
 
 		/* Limit the number of lines printed to the terminal height so the
 		 * most important info (at the top) will stay on screen. */
@@ -610,20 +1257,47 @@ int main(int argc, char **argv)
 		t2 = gettime();
 		elapsed_time += (t2 - t1) / 1000000.0;
 
-		if (interactive) {
+		if (flight_ring) {
+			ring_check_stall(&render_ring);
+			ring_check_stall(&bsd_ring);
+			ring_check_stall(&bsd6_ring);
+			ring_check_stall(&blt_ring);
+
+			if (flight_dump_requested) {
+				flight_dump_requested = 0;
+				flight_dump("SIGUSR1");
+			}
+		}
+
+		if (shm_head)
+			shm_stats_publish(t2 - t1, rings, period_samples);
+
+		if (freqlog_file)
+			freqlog_drain();
+
+		if (dashboard)
+			dash_update(rings, period_samples);
+
+		if (interactive && dashboard) {
+			printf("%s", clear_screen);
+			dash_print(rings, devid, samples_per_sec);
+		} else if (interactive) {
 			printf("%s", clear_screen);
 			print_clock_info(pci_dev);
+			if (missed_samples)
+				printf("%lu sample ticks missed\n",
+				       missed_samples);
 
-			ring_print(&render_ring, last_samples_per_sec);
-			ring_print(&bsd_ring, last_samples_per_sec);
-			ring_print(&bsd6_ring, last_samples_per_sec);
-			ring_print(&blt_ring, last_samples_per_sec);
+			ring_print(&render_ring, period_samples);
+			ring_print(&bsd_ring, period_samples);
+			ring_print(&bsd6_ring, period_samples);
+			ring_print(&blt_ring, period_samples);
 
 			printf("\n%30s  %s\n", "task", "percent busy");
 			for (i = 0; i < max_lines; i++) {
-				if (top_bits_sorted[i]->count > 0) {
-					percent = (top_bits_sorted[i]->count * 100) /
-						last_samples_per_sec;
+				if (top_bits_sorted[i]->period_count > 0) {
+					percent = (top_bits_sorted[i]->period_count * 100) /
+						period_samples;
 					len = printf("%30s: %3d%%: ",
 							 top_bits_sorted[i]->bit->name,
 							 percent);
@@ -639,7 +1313,7 @@ int main(int argc, char **argv)
 						   (long long)(stats[i] - last_stats[i]));
 					last_stats[i] = stats[i];
 				} else {
-					if (!top_bits_sorted[i]->count)
+					if (!top_bits_sorted[i]->period_count)
 						break;
 				}
 				printf("\n");
@@ -668,10 +1342,10 @@ int main(int argc, char **argv)
 
 			/* Print statistics */
 			fprintf(output, "%.2f\t", elapsed_time);
-			ring_log(&render_ring, last_samples_per_sec, output);
-			ring_log(&bsd_ring, last_samples_per_sec, output);
-			ring_log(&bsd6_ring, last_samples_per_sec, output);
-			ring_log(&blt_ring, last_samples_per_sec, output);
+			ring_log(&render_ring, period_samples, output);
+			ring_log(&bsd_ring, period_samples, output);
+			ring_log(&bsd6_ring, period_samples, output);
+			ring_log(&blt_ring, period_samples, output);
 
 			for (i = 0; i < MAX_NUM_TOP_BITS; i++) {
 				if (i < STATS_COUNT && HAS_STATS_REGS(devid)) {
@@ -686,12 +1360,17 @@ int main(int argc, char **argv)
 			fflush(output);
 		}
 
-		for (i = 0; i < num_instdone_bits; i++) {
-			top_bits_sorted[i]->count = 0;
+		/* The bit counters are monotonic now; only the stats
+		 * baselines need refreshing for the next period. */
+		for (i = 0; i < STATS_COUNT; i++)
+			last_stats[i] = stats[i];
 
-			if (i < STATS_COUNT)
-				last_stats[i] = stats[i];
-		}
+		/* The first refreshes fault in every lazy allocation
+		 * (stdio buffers, output headers, terminal state); once
+		 * those have happened the tool should be done with the
+		 * heap, so declare steady state and start auditing. */
+		if (audit_warmup && !--audit_warmup)
+			intel_alloc_audit_arm();
 
 		/* Check if child has gone */
 		if (child_pid > 0) {
@@ -707,8 +1386,22 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (freqlog_file) {
+		freqlog_drain();
+		if (freqlog_dropped)
+			fprintf(stderr, "intel_gpu_top: dropped %u freq log "
+				"records\n", freqlog_dropped);
+		fclose(freqlog_file);
+	}
+
 	fclose(output);
 
 	intel_register_access_fini();
+
+	/* Non-zero when INTEL_ALLOC_AUDIT found post-warmup allocations,
+	 * so a CI run of the monitor fails instead of leaking quietly. */
+	if (intel_alloc_audit_report(stderr))
+		return 1;
+
 	return 0;
 }
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Prints the GT state page published by intel_forcewaked -s.  Unlike
+ * the other register tools this touches no hardware at all - it only
+ * reads the shm page, so it is safe to run from any number of
+ * monitoring scripts at any rate without generating wake events.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "intel_snapshot.h"
+
+static const char *ring_names[GT_SNAPSHOT_RINGS] = {
+	"render", "bsd", "blt"
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void print_snapshot(struct intel_gt_snapshot *copy)
+{
+	int i;
+
+	printf("devid 0x%04x, sampled %.1fms ago\n", copy->devid,
+	       (now_ns() - copy->ts_ns) / 1e6);
+	if (copy->freq_mhz)
+		printf("frequency: %u MHz (RPSTAT1 0x%08x)\n",
+		       copy->freq_mhz, copy->rpstat);
+	printf("forcewake: 0x%08x\n", copy->forcewake);
+	for (i = 0; i < GT_SNAPSHOT_RINGS; i++)
+		printf("%-8s %s head 0x%08x tail 0x%08x\n", ring_names[i],
+		       copy->rings_idle & (1 << i) ? "idle" : "busy",
+		       copy->ring_head[i], copy->ring_tail[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	struct intel_gt_snapshot *snap, copy;
+	int interval_ms = 0;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "l:h")) != -1) {
+		switch (ch) {
+		case 'l':
+			interval_ms = atoi(optarg);
+			if (interval_ms < 1)
+				errx(1, "bad interval '%s'", optarg);
+			break;
+		default:
+			printf("usage: %s [-l interval_ms]\n", argv[0]);
+			exit(ch == 'h' ? 0 : 1);
+		}
+	}
+
+	snap = intel_snapshot_open();
+	if (snap == NULL)
+		errx(1, "no snapshot page; is intel_forcewaked -s running?");
+
+	for (;;) {
+		if (intel_snapshot_read(snap, &copy))
+			errx(1, "publisher stalled mid-update");
+		print_snapshot(&copy);
+
+		if (!interval_ms)
+			break;
+		printf("\n");
+		usleep(interval_ms * 1000);
+	}
+
+	return 0;
+}
@@ -31,7 +31,9 @@
 #include <stdarg.h>
 #include <pciaccess.h>
 #include <unistd.h>
+#include <sys/time.h>
 
+#include "intel_clock.h"
 #include "intel_gpu_tools.h"
 
 #define INGTT(offset) (*(volatile uint32_t *)(gtt + (offset) / (KB(4) / 4)))
@@ -39,18 +41,228 @@
 #define KB(x) ((x) * 1024)
 #define MB(x) ((x) * 1024 * 1024)
 
+/* Watch mode: snapshot every PTE into preallocated buffers and print
+ * only the entries that changed between snapshots, so GTT churn can be
+ * followed at sub-second granularity without the cost of formatting the
+ * whole table each pass. */
+static void
+watch_gtt(unsigned char *gtt, int aper_size, int interval_ms)
+{
+	int num_ptes = aper_size / KB(4);
+	uint32_t *prev, *cur, *tmp;
+	struct timeval t0, now;
+	int i;
+
+	prev = malloc(num_ptes * sizeof(uint32_t));
+	cur = malloc(num_ptes * sizeof(uint32_t));
+	if (!prev || !cur) {
+		fprintf(stderr, "Failed to allocate snapshot buffers\n");
+		exit(1);
+	}
+
+	for (i = 0; i < num_ptes; i++)
+		prev[i] = INGTT(i * KB(4));
+
+	gettimeofday(&t0, NULL);
+
+	for (;;) {
+		int changed = 0;
+
+		usleep(interval_ms * 1000);
+
+		for (i = 0; i < num_ptes; i++)
+			cur[i] = INGTT(i * KB(4));
+
+		for (i = 0; i < num_ptes; i++)
+			if (cur[i] != prev[i])
+				changed++;
+
+		gettimeofday(&now, NULL);
+		printf("---- +%ld.%03lds: %d PTEs changed\n",
+		       (long)(now.tv_sec - t0.tv_sec),
+		       (long)(now.tv_usec / 1000),
+		       changed);
+
+		/* print changed entries as coalesced runs */
+		for (i = 0; i < num_ptes; i++) {
+			int run_start = i;
+
+			if (cur[i] == prev[i])
+				continue;
+			while (i + 1 < num_ptes && cur[i + 1] != prev[i + 1])
+				i++;
+			printf("0x%08x - 0x%08x: 0x%08x -> 0x%08x "
+			       "(%d entries)\n",
+			       run_start * KB(4), i * KB(4),
+			       prev[run_start], cur[run_start],
+			       i - run_start + 1);
+		}
+		fflush(stdout);
+
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+}
+
+/* Bench mode: time PTE update cost and visibility directly, the
+ * numbers behind what gem_gtt_cpu_tlb/gem_cs_tlb only check for
+ * correctness.  All probing happens in the top quarter of the
+ * aperture and every PTE is rewritten with the value it already has
+ * (the write itself is what triggers invalidation), except for the
+ * visibility probe which swaps two entries and restores them.  Run on
+ * an idle machine; a concurrently rendering GPU will see the swap. */
+
+static uint64_t
+bench_touch_pages(volatile uint32_t *aper, int first_page, int count)
+{
+	uint64_t ticks;
+	uint32_t accum = 0;
+	int i;
+
+	ticks = intel_clock_now();
+	for (i = 0; i < count; i++)
+		accum += aper[(first_page + i) * KB(4) / 4];
+	ticks = intel_clock_now() - ticks;
+
+	/* keep the reads */
+	if (accum == 0xdeadbeef)
+		printf("\n");
+
+	return ticks;
+}
+
+static void
+bench_gtt(unsigned char *gtt, volatile uint32_t *aper, int aper_size)
+{
+	static const int counts[] = { 1, 16, 64, 256, 1024, 4096 };
+	int num_ptes = aper_size / KB(4);
+	int base = num_ptes * 3 / 4;
+	uint64_t ticks;
+	unsigned c;
+	int i, reps;
+
+	if (base + 4096 > num_ptes)
+		base = num_ptes - 4096;
+	if (base < 0) {
+		fprintf(stderr, "aperture too small to bench\n");
+		exit(1);
+	}
+
+	/* PTE rewrite cost, posting read included once at the end as
+	 * the driver would batch it */
+	reps = 4096;
+	ticks = intel_clock_now();
+	for (i = 0; i < reps; i++)
+		INGTT((base + i) * KB(4)) = INGTT((base + i) * KB(4));
+	(void)INGTT(base * KB(4));
+	ticks = intel_clock_now() - ticks;
+	printf("PTE rewrite: %.1f ns/entry (%d entries)\n",
+	       (double)intel_clock_to_ns(ticks) / reps, reps);
+
+	/* invalidation cost vs entry count: access warm, rewrite the
+	 * PTEs, access again; the delta is what the refetch costs */
+	printf("%8s %12s %12s %12s\n",
+	       "entries", "warm ns/pg", "cold ns/pg", "delta ns/pg");
+	for (c = 0; c < sizeof(counts)/sizeof(counts[0]); c++) {
+		int count = counts[c];
+		uint64_t warm, cold;
+
+		bench_touch_pages(aper, base, count); /* prime */
+		warm = bench_touch_pages(aper, base, count);
+
+		for (i = 0; i < count; i++)
+			INGTT((base + i) * KB(4)) = INGTT((base + i) * KB(4));
+		(void)INGTT(base * KB(4));
+
+		cold = bench_touch_pages(aper, base, count);
+
+		printf("%8d %12.1f %12.1f %12.1f\n", count,
+		       (double)intel_clock_to_ns(warm) / count,
+		       (double)intel_clock_to_ns(cold) / count,
+		       (double)intel_clock_to_ns(cold - warm) / count);
+	}
+
+	/* update visibility: swap two entries mapping distinct pages
+	 * with distinct content and poll through the aperture until
+	 * the new mapping is observed */
+	for (i = base; i < num_ptes - 1; i++) {
+		uint32_t pte_a = INGTT(i * KB(4));
+		uint32_t pte_b = INGTT((i + 1) * KB(4));
+		uint32_t val_a = aper[i * KB(4) / 4];
+		uint32_t val_b = aper[(i + 1) * KB(4) / 4];
+		int spins = 0;
+
+		if (pte_a == pte_b || val_a == val_b)
+			continue;
+
+		ticks = intel_clock_now();
+		INGTT(i * KB(4)) = pte_b;
+		(void)INGTT(i * KB(4));
+		while (aper[i * KB(4) / 4] != val_b && spins < 1000000)
+			spins++;
+		ticks = intel_clock_now() - ticks;
+
+		INGTT(i * KB(4)) = pte_a;
+		(void)INGTT(i * KB(4));
+
+		if (spins >= 1000000) {
+			printf("PTE swap never became visible?\n");
+		} else {
+			printf("PTE update visible after %llu ns "
+			       "(%d polls, page 0x%08x)\n",
+			       (long long unsigned)intel_clock_to_ns(ticks),
+			       spins, i * KB(4));
+		}
+		break;
+	}
+	if (i == num_ptes - 1)
+		printf("no distinct page pair found for the "
+		       "visibility probe\n");
+}
+
 int main(int argc, char **argv)
 {
 	struct pci_device *pci_dev;
 	int start, aper_size;
 	unsigned char *gtt;
 	uint32_t devid;
+	int watch = 0, bench = 0, interval_ms = 100;
+	int c;
 	int flag[] = {
 		PCI_DEV_MAP_FLAG_WRITE_COMBINE,
 		PCI_DEV_MAP_FLAG_WRITABLE,
 		0
 	}, f;
 
+	while ((c = getopt(argc, argv, "wbi:h")) != -1) {
+		switch (c) {
+		case 'w':
+			watch = 1;
+			break;
+		case 'b':
+			bench = 1;
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			if (interval_ms < 1)
+				interval_ms = 100;
+			break;
+		case 'h':
+		default:
+			printf("usage: %s [-w [-i interval_ms]] [-b]\n"
+			       "  -w    watch mode: print only PTEs that "
+			       "changed between snapshots\n"
+			       "  -i    snapshot interval in ms "
+			       "(default 100)\n"
+			       "  -b    bench mode: PTE rewrite cost, "
+			       "invalidation cost per entry count and\n"
+			       "        update visibility latency "
+			       "(idle machine recommended)\n", argv[0]);
+			exit(c == 'h' ? 0 : 1);
+		}
+	}
+
 	pci_dev = intel_get_pci_device();
 	devid = pci_dev->device_id;
 
@@ -89,6 +301,24 @@ int main(int argc, char **argv)
 
 	aper_size = pci_dev->regions[2].size;
 
+	if (bench) {
+		volatile uint32_t *aper;
+
+		if (pci_device_map_range(pci_dev,
+					 pci_dev->regions[2].base_addr,
+					 pci_dev->regions[2].size,
+					 PCI_DEV_MAP_FLAG_WRITE_COMBINE,
+					 (void **)&aper) != 0) {
+			printf("Failed to map aperture\n");
+			exit(1);
+		}
+		bench_gtt(gtt, aper, aper_size);
+		return 0;
+	}
+
+	if (watch)
+		watch_gtt(gtt, aper_size, interval_ms);
+
 	for (start = 0; start < aper_size; start += KB(4)) {
 		uint32_t start_pte = INGTT(start);
 		uint32_t end;
@@ -0,0 +1,254 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file intel_hang_detector.c
+ *
+ * Resident GPU hang watcher.  Polls i915_error_state in debugfs at
+ * sub-second intervals, and when a hang shows up immediately spools the
+ * full error state to a file, clears it so the next hang can be
+ * captured, and optionally restarts a workload command.  A cron job
+ * doing the same notices hangs minutes late, after the interesting
+ * state has often been clobbered.
+ *
+ * Everything needed at capture time - the error state buffer, the spool
+ * path, the poll buffer - is allocated up front, since hangs tend to
+ * arrive together with memory pressure.
+ */
+
+#include <assert.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "intel_debugfs.h"
+
+bool daemonized;
+
+#define INFO_PRINT(...) \
+	do { \
+		if (daemonized) \
+			syslog(LOG_INFO, ##__VA_ARGS__); \
+		else \
+			fprintf(stdout, ##__VA_ARGS__); \
+	} while(0)
+
+#define ERROR_STATE_MAX	(16 * 1024 * 1024)
+#define PROBE_SIZE	4096
+
+static char error_path[160];
+static char spool_path[256];
+static char *state_buf;
+static struct debugfs_file probe;
+
+static const char *no_error = "no error state collected";
+
+/* A hang is pending iff the first line isn't the "no error state
+ * collected" placeholder; probing just the head through the persistent
+ * debugfs reader keeps the idle poll to a single pread, the full (and
+ * expensive to generate) state is only read once we know there is one. */
+static int hang_pending(void)
+{
+	ssize_t got;
+
+	got = debugfs_file_read(&probe);
+	if (got <= 0)
+		return 0;
+
+	return strncmp(probe.buf, no_error, strlen(no_error)) != 0;
+}
+
+static void clear_error_state(void)
+{
+	int fd;
+
+	fd = open(error_path, O_WRONLY);
+	if (fd == -1)
+		return;
+	if (write(fd, "\n", 1) == -1)
+		INFO_PRINT("couldn't clear error state: %s\n",
+			   strerror(errno));
+	close(fd);
+}
+
+static void spool_error_state(const char *spool_dir, int count)
+{
+	char name[512];
+	size_t len = 0;
+	ssize_t got;
+	int fd, out;
+
+	fd = open(error_path, O_RDONLY);
+	if (fd == -1) {
+		INFO_PRINT("couldn't reopen error state: %s\n",
+			   strerror(errno));
+		return;
+	}
+
+	while (len < ERROR_STATE_MAX) {
+		got = read(fd, state_buf + len, ERROR_STATE_MAX - len);
+		if (got <= 0)
+			break;
+		len += got;
+	}
+	close(fd);
+
+	snprintf(name, sizeof(name), "%s/hang-%ld-%03d.txt",
+		 spool_dir, (long)time(NULL), count);
+	out = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out == -1) {
+		INFO_PRINT("couldn't create spool file '%s': %s\n",
+			   name, strerror(errno));
+		return;
+	}
+	if (write(out, state_buf, len) != (ssize_t)len)
+		INFO_PRINT("short write spooling '%s'\n", name);
+	close(out);
+
+	INFO_PRINT("hang #%d: %zd bytes of error state spooled to %s\n",
+		   count, len, name);
+}
+
+static void restart_workload(const char *cmd)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid == -1) {
+		INFO_PRINT("fork for workload restart failed: %s\n",
+			   strerror(errno));
+		return;
+	}
+	if (pid == 0) {
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+	INFO_PRINT("restarted workload '%s' as pid %d\n", cmd, pid);
+}
+
+static void reap_children(int sig)
+{
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+}
+
+static void help(const char *prog)
+{
+	printf("%s: watch for GPU hangs and spool i915_error_state.\n\n",
+	       prog);
+	printf("usage: %s [options]\n\n", prog);
+	printf("Options: \n");
+	printf("    -b            run in background/daemon mode\n");
+	printf("    -s <dir>      spool directory (default %s)\n",
+	       spool_path);
+	printf("    -i <ms>       poll interval in milliseconds (default 250)\n");
+	printf("    -r <command>  command to (re)start after each hang\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *restart_cmd = NULL;
+	unsigned interval_ms = 250;
+	int count = 0;
+	int opt;
+
+	strcpy(spool_path, "/var/tmp/gpu-hangs");
+
+	while ((opt = getopt(argc, argv, "bs:i:r:h")) != -1) {
+		switch (opt) {
+		case 'b':
+			daemonized = true;
+			break;
+		case 's':
+			snprintf(spool_path, sizeof(spool_path), "%s", optarg);
+			break;
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 0);
+			if (!interval_ms)
+				errx(1, "invalid poll interval '%s'", optarg);
+			break;
+		case 'r':
+			restart_cmd = optarg;
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (debugfs_file_open(&probe, "i915_error_state", PROBE_SIZE))
+		errx(1, "i915 debugfs path not found");
+	intel_debugfs_path(error_path, sizeof(error_path) - 32);
+	strcat(error_path, "/i915_error_state");
+
+	if (mkdir(spool_path, 0755) && errno != EEXIST)
+		err(1, "couldn't create spool directory '%s'", spool_path);
+
+	/* grab the capture buffer before any hang-time memory pressure */
+	state_buf = malloc(ERROR_STATE_MAX);
+	if (!state_buf)
+		err(1, "couldn't preallocate error state buffer");
+	memset(state_buf, 0, ERROR_STATE_MAX);
+
+	signal(SIGCHLD, reap_children);
+
+	if (daemonized) {
+		assert(daemon(0, 0) == 0);
+		openlog(argv[0], LOG_CONS | LOG_PID, LOG_USER);
+		INFO_PRINT("started daemon");
+	}
+
+	INFO_PRINT("watching %s every %ums, spooling to %s\n",
+		   error_path, interval_ms, spool_path);
+
+	if (hang_pending())
+		INFO_PRINT("stale error state present at startup\n");
+
+	while (1) {
+		if (hang_pending()) {
+			count++;
+			spool_error_state(spool_path, count);
+			clear_error_state();
+			if (restart_cmd)
+				restart_workload(restart_cmd);
+		}
+		usleep(interval_ms * 1000);
+	}
+
+	if (daemonized)
+		closelog();
+
+	return 0;
+}
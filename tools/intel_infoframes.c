@@ -29,7 +29,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <getopt.h>
+#include <sys/time.h>
 #include "intel_gpu_tools.h"
 
 typedef enum {
@@ -930,6 +932,113 @@ static void enable_hdmi_port(Register reg)
 	OUTREG(reg, val);
 }
 
+/* Monitor mode: keep polling the DIP control and data registers and
+ * print only the transitions.  The interesting infoframe bugs are
+ * transient - a frame's worth of corrupt DIP data between two mode
+ * changes - and re-running the tool in a loop can't see anything
+ * shorter than process startup. */
+
+static const char *dip_type_names[] = {
+	"AVI",
+	"Vendor",
+	"Gamut",
+	"SPD"
+};
+
+static double monitor_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void monitor_infoframes(int rate_hz)
+{
+	/* our own data reads cycle the buffer-index and access-address
+	 * bits, so they must be masked out of the comparison or every
+	 * sample reports a self-inflicted transition */
+	const uint32_t ctl_mask = ~(DIP_CTL_ACCESS_ADDR |
+				    DIP_CTL_BUFFER_INDEX);
+	int num_trans = gen == 4 ? 1 : 3;
+	uint32_t ctl_regs[3], last_ctl[3];
+	uint32_t last_data[3][4][16];
+	char have_data[3][4];
+	struct intel_register_burst burst;
+	useconds_t interval;
+	double t0;
+	int t, type, i;
+
+	if (rate_hz < 1)
+		rate_hz = 1;
+	if (rate_hz > 10000)
+		rate_hz = 10000;
+	interval = 1000000 / rate_hz;
+
+	for (t = 0; t < num_trans; t++)
+		ctl_regs[t] = get_dip_ctl_reg(t);
+	intel_register_burst_init(&burst, ctl_regs, num_trans);
+
+	intel_register_burst_capture(&burst);
+	for (t = 0; t < num_trans; t++)
+		last_ctl[t] = burst.vals[t] & ctl_mask;
+	memset(have_data, 0, sizeof(have_data));
+
+	printf("monitoring DIP registers at %dHz, change-only output\n",
+	       rate_hz);
+	for (t = 0; t < num_trans; t++)
+		printf("%10.6f %s ctl %08x\n", 0.,
+		       gen == 4 ? "DIP" : transcoder_names[t], last_ctl[t]);
+	fflush(stdout);
+
+	t0 = monitor_time();
+	for (;;) {
+		intel_register_burst_capture(&burst);
+
+		for (t = 0; t < num_trans; t++) {
+			const char *name = gen == 4 ? "DIP" :
+				transcoder_names[t];
+			uint32_t val = burst.vals[t] & ctl_mask;
+
+			if (val != last_ctl[t]) {
+				printf("%10.6f %s ctl %08x -> %08x\n",
+				       monitor_time() - t0, name,
+				       last_ctl[t], val);
+				last_ctl[t] = val;
+			}
+
+			for (type = 0; type < 4; type++) {
+				DipInfoFrame frame;
+
+				if (!(burst.vals[t] & (1 << (21 + type)))) {
+					have_data[t][type] = 0;
+					continue;
+				}
+
+				load_infoframe(t, &frame, type);
+				if (have_data[t][type] &&
+				    memcmp(last_data[t][type], frame.data32,
+					   sizeof(frame.data32)) == 0)
+					continue;
+
+				printf("%10.6f %s %s data:",
+				       monitor_time() - t0, name,
+				       dip_type_names[type]);
+				for (i = 0; i < 8; i++)
+					printf(" %08x", frame.data32[i]);
+				printf("\n");
+
+				memcpy(last_data[t][type], frame.data32,
+				       sizeof(frame.data32));
+				have_data[t][type] = 1;
+			}
+		}
+		fflush(stdout);
+
+		usleep(interval);
+	}
+}
+
 static void print_usage(void)
 {
 printf("Options:\n"
@@ -957,6 +1066,9 @@ printf("Options:\n"
 "          select transcoder (A, B or C)\n"
 "  -f, --infoframe\n"
 "          select infoframe (AVI, Vendor, Gamut or SPD)\n"
+"  -m, --monitor [rate]\n"
+"          poll the DIP registers of all transcoders at [rate] Hz until\n"
+"          interrupted, printing control and data transitions only\n"
 "  -h, --help\n"
 "          prints this message\n"
 "\n"
@@ -1029,7 +1141,7 @@ int main(int argc, char *argv[])
 	DipType dip = DIP_INVALID;
 	Register hdmi_port;
 
-	char short_opts[] = "dc:k:q:nNxXp:P:t:f:h";
+	char short_opts[] = "dc:k:q:nNxXp:P:t:f:m:h";
 	struct option long_opts[] = {
 		{ "dump",               no_argument,       NULL, 'd' },
 		{ "change-fields",      required_argument, NULL, 'c' },
@@ -1043,6 +1155,7 @@ int main(int argc, char *argv[])
 		{ "enable-hdmi-port",   required_argument, NULL, 'P' },
 		{ "transcoder" ,        required_argument, NULL, 't' },
 		{ "infoframe",          required_argument, NULL, 'f' },
+		{ "monitor",            required_argument, NULL, 'm' },
 		{ "help",               no_argument,       NULL, 'h' },
 	};
 
@@ -1187,6 +1300,9 @@ int main(int argc, char *argv[])
 				goto out;
 			}
 			break;
+		case 'm':
+			monitor_infoframes(atoi(optarg));
+			break;
 		case 'h':
 			print_usage();
 			break;
@@ -106,6 +106,76 @@ static int do_parse(int argc, char *argv[])
 	return 0;
 }
 
+/* Batch file: one row,bank,subbank per line, blank lines and #comments
+ * ignored.  The whole list lands in the in-memory table and reaches
+ * sysfs in the single write below, so disabling dozens of screened
+ * cells costs one read-modify-write instead of one full cycle each. */
+static void do_parse_file(const char *name)
+{
+	char line[128];
+	FILE *file;
+	int row, bank, sbank;
+	int lineno = 0;
+
+	file = fopen(name, "r");
+	if (file == NULL) {
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		lineno++;
+		if (line[0] == '\n' || line[0] == '#')
+			continue;
+		if (sscanf(line, "%d,%d,%d", &row, &bank, &sbank) != 3) {
+			fprintf(stderr, "%s:%d: malformed cell\n",
+				name, lineno);
+			exit(EXIT_FAILURE);
+		}
+		if (disable_rbs(row, bank, sbank)) {
+			fprintf(stderr, "%s:%d: can't remap %d,%d,%d\n",
+				name, lineno, row, bank, sbank);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fclose(file);
+}
+
+static void snapshot_table(const char *name)
+{
+	int fd;
+
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1 ||
+	    write(fd, l3log, sizeof(l3log)) != (ssize_t)sizeof(l3log)) {
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+}
+
+static void restore_table(const char *name)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd == -1 || fstat(fd, &st)) {
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+	if (st.st_size != (off_t)sizeof(l3log)) {
+		fprintf(stderr, "%s is not an l3 remap snapshot\n", name);
+		exit(EXIT_FAILURE);
+	}
+	if (read(fd, l3log, sizeof(l3log)) != (ssize_t)sizeof(l3log)) {
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+}
+
 int main(int argc, char *argv[])
 {
 	const int device = drm_get_card(0);
@@ -139,6 +209,14 @@ int main(int argc, char *argv[])
 		exit(EXIT_SUCCESS);
 	} else if (!strncmp("-c", argv[1], 2)) {
 		memset(l3log, 0, sizeof(l3log));
+	} else if (!strcmp("-s", argv[1]) && argc == 3) {
+		/* snapshot leaves the hardware untouched */
+		snapshot_table(argv[2]);
+		exit(EXIT_SUCCESS);
+	} else if (!strcmp("-r", argv[1]) && argc == 3) {
+		restore_table(argv[2]);
+	} else if (!strcmp("-f", argv[1]) && argc == 3) {
+		do_parse_file(argv[2]);
 	} else {
 		ret = do_parse(argc, argv);
 		if (ret != 0) {
@@ -25,17 +25,32 @@
  *
  */
 
+/* Event-driven lid and hotplug monitor.  Instead of re-reading the SWF
+ * register in a sleep loop - which misses transient states and keeps
+ * the package from idling - we block on the ACPI event interface and
+ * the kernel uevent socket, and only touch registers when an event
+ * arrives.  For lid events the register is then sampled in a tight loop
+ * until it agrees with the new ACPI state, which gives the latency from
+ * event delivery to the state becoming register-visible.
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <pciaccess.h>
 #include <err.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include "intel_gpu_tools.h"
 #include "intel_reg.h"
@@ -49,6 +64,10 @@ enum lid_status {
 
 #define ACPI_BUTTON "/proc/acpi/button/"
 #define ACPI_LID "/proc/acpi/button/lid/"
+#define ACPI_EVENT "/proc/acpi/event"
+
+/* how long we chase the register after an event before giving up */
+#define SETTLE_TIMEOUT_US 500000
 
 static int i830_lvds_acpi_lid_state(void)
 {
@@ -113,32 +132,198 @@ out:
 	return ret;
 }
 
+static uint64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static const char *lid_name(int state)
+{
+	switch (state) {
+	case LID_OPEN:
+		return "open";
+	case LID_CLOSE:
+		return "close";
+	default:
+		return "unknown";
+	}
+}
+
+static int lid_from_swf14(void)
+{
+	return INREG(SWF14) & SWF14_LID_SWITCH_EN ? LID_CLOSE : LID_OPEN;
+}
+
+static void print_status(void)
+{
+	int swf14 = INREG(SWF14);
+
+	printf("Intel LVDS Lid status:\n");
+	printf("\tSWF14(0x%x) : %s\n", swf14,
+	       swf14 & SWF14_LID_SWITCH_EN ? "close" : "open");
+	printf("\tACPI Lid state : %s\n",
+	       lid_name(i830_lvds_acpi_lid_state()));
+}
+
+/* acpid usually owns /proc/acpi/event, in which case we still get lid
+ * events as button uevents through the netlink socket */
+static int open_acpi_event(void)
+{
+	int fd = open(ACPI_EVENT, O_RDONLY);
+
+	if (fd < 0 && errno != ENOENT)
+		fprintf(stderr, "cannot open %s (%s), "
+			"relying on uevents only\n",
+			ACPI_EVENT, strerror(errno));
+	return fd;
+}
+
+static int open_uevent_socket(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* chase the register until it agrees with the new ACPI state; the spin
+ * is what turns an event timestamp into an event-to-register latency */
+static void handle_lid_event(uint64_t t0)
+{
+	int target = i830_lvds_acpi_lid_state();
+	int reg_state = lid_from_swf14();
+	uint64_t t = now_us();
+
+	if (target == LID_UNKNOWN) {
+		printf("lid event: ACPI state unknown, SWF14 says %s\n",
+		       lid_name(reg_state));
+		return;
+	}
+
+	while (reg_state != target && t - t0 < SETTLE_TIMEOUT_US) {
+		reg_state = lid_from_swf14();
+		t = now_us();
+	}
+
+	if (reg_state == target)
+		printf("lid event: %s, register visible after %.1fus\n",
+		       lid_name(target), (double)(t - t0));
+	else
+		printf("lid event: %s, register still says %s after %.1fms\n",
+		       lid_name(target), lid_name(reg_state),
+		       (t - t0) / 1000.);
+	fflush(stdout);
+}
+
+static void handle_uevent(int fd, uint32_t *hotplug_stat)
+{
+	char buf[4096];
+	uint64_t t0;
+	uint32_t stat;
+	int len, i, is_drm = 0, is_change = 0, is_button = 0;
+
+	len = recv(fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return;
+	t0 = now_us();
+	buf[len] = '\0';
+
+	/* the payload is a nul-separated property list */
+	for (i = 0; i < len; i += strlen(buf + i) + 1) {
+		if (strcmp(buf + i, "SUBSYSTEM=drm") == 0)
+			is_drm = 1;
+		if (strcmp(buf + i, "ACTION=change") == 0)
+			is_change = 1;
+		if (strstr(buf + i, "button") != NULL)
+			is_button = 1;
+	}
+
+	if (is_button) {
+		handle_lid_event(t0);
+		return;
+	}
+
+	if (!is_drm || !is_change)
+		return;
+
+	stat = INREG(PORT_HOTPLUG_STAT);
+	if (stat != *hotplug_stat) {
+		printf("hotplug event: PORT_HOTPLUG_STAT 0x%08x -> 0x%08x, "
+		       "read %.1fus after event\n",
+		       *hotplug_stat, stat, (double)(now_us() - t0));
+		*hotplug_stat = stat;
+	} else {
+		printf("hotplug event: PORT_HOTPLUG_STAT unchanged "
+		       "(0x%08x)\n", stat);
+	}
+	fflush(stdout);
+}
+
 int main(int argc, char **argv)
 {
-	int swf14, acpi_lid;
+	fd_set rfds;
+	char line[256];
+	uint32_t hotplug_stat;
+	int acpi_fd, uevent_fd, nfds;
 
 	intel_get_mmio(intel_get_pci_device());
 
+	print_status();
+	hotplug_stat = INREG(PORT_HOTPLUG_STAT);
+
+	acpi_fd = open_acpi_event();
+	uevent_fd = open_uevent_socket();
+	if (acpi_fd < 0 && uevent_fd < 0)
+		errx(1, "no event source available "
+		     "(no %s and no uevent socket)", ACPI_EVENT);
+
+	printf("waiting for lid/hotplug events...\n");
+
 	while (1) {
-		swf14 = INREG(SWF14);
+		FD_ZERO(&rfds);
+		nfds = 0;
+		if (acpi_fd >= 0) {
+			FD_SET(acpi_fd, &rfds);
+			if (acpi_fd >= nfds)
+				nfds = acpi_fd + 1;
+		}
+		if (uevent_fd >= 0) {
+			FD_SET(uevent_fd, &rfds);
+			if (uevent_fd >= nfds)
+				nfds = uevent_fd + 1;
+		}
 
-		printf("Intel LVDS Lid status:\n");
-		printf("\tSWF14(0x%x) : %s\n", swf14,
-		       swf14 & SWF14_LID_SWITCH_EN ? "close" : "open");
+		if (select(nfds, &rfds, NULL, NULL, NULL) <= 0)
+			continue;
 
-		acpi_lid = i830_lvds_acpi_lid_state();
-		switch (acpi_lid) {
-		case LID_UNKNOWN:
-			printf("\tACPI Lid state : unknown\n");
-			break;
-		case LID_OPEN:
-			printf("\tACPI Lid state : open\n");
-			break;
-		case LID_CLOSE:
-			printf("\tACPI Lid state : close\n");
-			break;
+		if (acpi_fd >= 0 && FD_ISSET(acpi_fd, &rfds)) {
+			int len = read(acpi_fd, line, sizeof(line) - 1);
+
+			if (len > 0) {
+				line[len] = '\0';
+				if (strstr(line, "button/lid"))
+					handle_lid_event(now_us());
+			}
 		}
-		sleep(2);
+
+		if (uevent_fd >= 0 && FD_ISSET(uevent_fd, &rfds))
+			handle_uevent(uevent_fd, &hotplug_stat);
 	}
+
 	return 0;
 }
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include "intel_gpu_tools.h"
 
 int gen;
@@ -41,8 +42,10 @@ uint32_t PIPESRC[]    = { 0x6001C, 0x6101C, 0x6201C };
 uint32_t PF_CTRL1[]   = { 0x68080, 0x68880, 0x69080 };
 uint32_t PF_WIN_POS[] = { 0x68070, 0x68870, 0x69070 };
 uint32_t PF_WIN_SZ[]  = { 0x68074, 0x68874, 0x69074 };
+uint32_t FRMCOUNT[]   = { 0x70040, 0x71040, 0x72040 };
 
 #define PIPECONF_ENABLE         (1 << 31)
+#define PIPECONF_STATE          (1 << 30)
 #define PIPECONF_INTERLACE_MASK (7 << 21)
 #define PIPECONF_PF_PD          (0 << 21)
 #define PIPECONF_PF_ID          (1 << 21)
@@ -242,6 +245,136 @@ static int change_screen_size(int intel_pipe, int x, int y)
 	return 0;
 }
 
+/*
+ * Churn mode: cycle fitter window sizes back to back and time how long
+ * the pipe takes to settle after each write.  The settle check polls
+ * the pipe state bit alongside the frame counter: a step counts as
+ * settled once two full frames pass with the state bit continuously
+ * set, and the reported latency is the time of the last observed
+ * instability.  Field kiosks that resize content constantly show
+ * multi-frame glitches this is meant to reproduce on the bench.
+ */
+
+#define CHURN_STEPS 4
+#define CHURN_TIMEOUT_US 500000
+
+static double churn_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return 1e6 * tv.tv_sec + tv.tv_usec;
+}
+
+/* returns the microseconds from the register write until the last
+ * observed instability, 0 if no glitch was seen, -1 on timeout */
+static double churn_settle(int intel_pipe, double t0, int *glitches)
+{
+	uint32_t clean_base = INREG(FRMCOUNT[intel_pipe]);
+	double dirty_until = t0;
+	bool glitched = false;
+
+	for (;;) {
+		double now = churn_time_us();
+		uint32_t conf = INREG(PIPECONF[intel_pipe]);
+		uint32_t frame = INREG(FRMCOUNT[intel_pipe]);
+
+		if (!(conf & PIPECONF_STATE)) {
+			/* restart the clean window on every glitch */
+			dirty_until = now;
+			clean_base = frame;
+			glitched = true;
+		}
+
+		if (frame - clean_base >= 2) {
+			if (glitched)
+				(*glitches)++;
+			return dirty_until - t0;
+		}
+
+		if (now - t0 > CHURN_TIMEOUT_US)
+			return -1;
+	}
+}
+
+static int churn_panel_fitter(int intel_pipe, int iterations)
+{
+	struct pipe_info info;
+	uint32_t saved_ctrl1, saved_pos, saved_sz;
+	uint32_t widths[CHURN_STEPS], heights[CHURN_STEPS];
+	uint32_t min_w, min_h;
+	double worst = 0, total = 0;
+	int glitches = 0, timeouts = 0;
+	int i;
+
+	read_pipe_info(intel_pipe, &info);
+	if (!info.enabled) {
+		printf("Pipe %c is not enabled\n", intel_pipe + 'A');
+		return 1;
+	}
+
+	/* smallest size the fitter can downscale to, kept even */
+	min_w = ((uint32_t)(info.src_width / 1.125) + 2) & ~1;
+	min_h = ((uint32_t)(info.src_height / 1.125) + 2) & ~1;
+	for (i = 0; i < CHURN_STEPS; i++) {
+		widths[i] = (min_w +
+			     (info.tot_width - min_w) * i / (CHURN_STEPS - 1)) & ~1;
+		heights[i] = (min_h +
+			      (info.tot_height - min_h) * i / (CHURN_STEPS - 1)) & ~1;
+	}
+
+	saved_ctrl1 = INREG(PF_CTRL1[intel_pipe]);
+	saved_pos = INREG(PF_WIN_POS[intel_pipe]);
+	saved_sz = INREG(PF_WIN_SZ[intel_pipe]);
+
+	printf("Churning pipe %c through %d reconfigurations "
+	       "(%dx%d to %dx%d)...\n", intel_pipe + 'A', iterations,
+	       widths[0], heights[0],
+	       widths[CHURN_STEPS - 1], heights[CHURN_STEPS - 1]);
+
+	for (i = 0; i < iterations; i++) {
+		int step = i % CHURN_STEPS;
+		uint32_t pos_x, pos_y, ctrl1_val;
+		double t0, settle;
+
+		pos_x = (info.tot_width - widths[step]) / 2;
+		pos_y = (info.tot_height - heights[step]) / 2;
+		if (pos_x == 1)
+			pos_x = 0;
+
+		ctrl1_val = PF_ENABLE | PF_FILTER_MED;
+		if (gen >= 7)
+			ctrl1_val |= intel_pipe << 29;
+
+		t0 = churn_time_us();
+		OUTREG(PF_CTRL1[intel_pipe], ctrl1_val);
+		OUTREG(PF_WIN_POS[intel_pipe], pos_x << 16 | pos_y);
+		OUTREG(PF_WIN_SZ[intel_pipe], widths[step] << 16 | heights[step]);
+
+		settle = churn_settle(intel_pipe, t0, &glitches);
+		if (settle < 0) {
+			timeouts++;
+			continue;
+		}
+
+		total += settle;
+		if (settle > worst)
+			worst = settle;
+	}
+
+	OUTREG(PF_CTRL1[intel_pipe], saved_ctrl1);
+	OUTREG(PF_WIN_POS[intel_pipe], saved_pos);
+	OUTREG(PF_WIN_SZ[intel_pipe], saved_sz);
+
+	printf("%d reconfigurations: %d glitched, %d timed out\n",
+	       iterations, glitches, timeouts);
+	if (iterations > timeouts)
+		printf("settle latency: avg %.0fus, worst case %.0fus\n",
+		       total / (iterations - timeouts), worst);
+
+	return timeouts ? 1 : 0;
+}
+
 static int disable_panel_fitter(int intel_pipe)
 {
 	OUTREG(PF_CTRL1[intel_pipe], 0);
@@ -256,6 +389,8 @@ static void print_usage(void)
 "  -p pipe:    pipe to be used (A, B or C)\n"
 "  -x value:   final screen width size in pixels\n"
 "  -y value:   final screen height size in pixels\n"
+"  -c count:   churn mode: cycle 'count' configurations and report how\n"
+"              long the pipe takes to settle after each one\n"
 "  -d:         disable panel fitter\n"
 "  -l:         list the current state of each pipe\n"
 "  -h:         prints this message\n");
@@ -267,6 +402,7 @@ int main (int argc, char *argv[])
 	int ret = 0;
 	char intel_pipe = '\0';
 	int x = 0, y = 0;
+	int churn = 0;
 	bool do_disable = false, do_dump = false, do_usage = false;
 	struct pci_device *pci_dev;
 	uint32_t devid;
@@ -292,7 +428,7 @@ int main (int argc, char *argv[])
 	else
 		gen = 7;
 
-	while ((opt = getopt(argc, argv, "p:x:y:dlh")) != -1) {
+	while ((opt = getopt(argc, argv, "p:x:y:c:dlh")) != -1) {
 		switch (opt) {
 		case 'p':
 			intel_pipe = optarg[0];
@@ -309,6 +445,9 @@ int main (int argc, char *argv[])
 		case 'y':
 			y = atoi(optarg);
 			break;
+		case 'c':
+			churn = atoi(optarg);
+			break;
 		case 'd':
 			do_disable = true;
 			break;
@@ -331,6 +470,8 @@ int main (int argc, char *argv[])
 	} else if (intel_pipe) {
 		if (do_disable)
 			ret = disable_panel_fitter(intel_pipe - 'A');
+		else if (churn)
+			ret = churn_panel_fitter(intel_pipe - 'A', churn);
 		else
 			ret = change_screen_size(intel_pipe - 'A', x, y);
 	} else {
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file intel_progress_decode.c
+ *
+ * Pretty-printer for the binary progress logs that the tests write when
+ * DRMTEST_PROGRESS_LOG is set.  All the formatting the tests skipped in
+ * their hot loops happens here, offline.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+
+int main(int argc, char **argv)
+{
+	const struct drmtest_progress_log_header *hdr;
+	const struct drmtest_progress_log_record *rec;
+	struct stat st;
+	uint64_t n, start_us;
+	void *map;
+	int fd;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <logfile>\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd == -1)
+		err(1, "couldn't open '%s'", argv[1]);
+	if (fstat(fd, &st))
+		err(1, "couldn't stat '%s'", argv[1]);
+	if (st.st_size < 4096)
+		errx(1, "'%s' is too short to be a progress log", argv[1]);
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "couldn't map '%s'", argv[1]);
+
+	hdr = map;
+	if (hdr->magic != DRMTEST_PROGRESS_LOG_MAGIC)
+		errx(1, "bad magic 0x%08x", hdr->magic);
+	if (hdr->version != DRMTEST_PROGRESS_LOG_VERSION)
+		errx(1, "unsupported version %d", hdr->version);
+	if (4096 + hdr->num_records * sizeof(*rec) > st.st_size)
+		errx(1, "truncated log (%"PRIu64" records claimed)",
+		     hdr->num_records);
+
+	rec = (const void *)((const char *)map + 4096);
+	start_us = hdr->num_records ? rec[0].time_us : 0;
+
+	for (n = 0; n < hdr->num_records; n++) {
+		printf("+%10.6fs: %s%"PRIu64"/%"PRIu64,
+		       (rec[n].time_us - start_us) / 1e6,
+		       rec[n].header, rec[n].i, rec[n].total);
+		if (rec[n].total)
+			printf(" (%3"PRIu64"%%)",
+			       rec[n].i * 100 / rec[n].total);
+		printf("\n");
+	}
+
+	munmap(map, st.st_size);
+	close(fd);
+
+	return 0;
+}
@@ -31,6 +31,62 @@
 static uint32_t devid;
 static int gen;
 
+/* Audit mode: one burst snapshot, machine-readable violations only.
+ *
+ * The interactive output above is useless in a boot-time fleet
+ * pipeline, and reading each register individually means the values
+ * don't even come from one moment.  In audit mode the checks run
+ * three times over: a collect pass that only records which registers
+ * this gen wants, one intel_register_burst snapshot, and a report
+ * pass evaluated against the snapshot that prints nothing but
+ * 'violation ...' lines.  Exit code 1 means a hard failure, 2 means
+ * perf-only findings, 0 means clean. */
+#define MAX_AUDIT_REGS 64
+
+static int audit, collecting;
+static uint32_t current_reg;
+static int audit_fails, audit_perfs;
+
+static struct {
+	const char *name;
+	uint32_t reg;
+	uint32_t val;
+} audit_regs[MAX_AUDIT_REGS];
+static int num_audit_regs;
+
+static struct {
+	uint32_t reg;
+	uint32_t mask;
+	uint32_t want;
+} baseline[MAX_AUDIT_REGS];
+static int num_baseline;
+
+static void
+audit_record(const char *name, uint32_t reg)
+{
+	int i;
+
+	for (i = 0; i < num_audit_regs; i++)
+		if (audit_regs[i].reg == reg)
+			return;
+	if (num_audit_regs == MAX_AUDIT_REGS)
+		errx(1, "too many audited registers");
+	audit_regs[num_audit_regs].name = name;
+	audit_regs[num_audit_regs].reg = reg;
+	num_audit_regs++;
+}
+
+static uint32_t
+audit_lookup(uint32_t reg)
+{
+	int i;
+
+	for (i = 0; i < num_audit_regs; i++)
+		if (audit_regs[i].reg == reg)
+			return audit_regs[i].val;
+	errx(1, "register 0x%x not in snapshot", reg);
+}
+
 static inline uint32_t
 read_reg(uint32_t reg)
 {
@@ -40,8 +96,17 @@ read_reg(uint32_t reg)
 static uint32_t
 read_and_print_reg(const char *name, uint32_t reg)
 {
-	uint32_t val = read_reg(reg);
+	uint32_t val;
 
+	current_reg = reg;
+	if (collecting) {
+		audit_record(name, reg);
+		return 0;
+	}
+	if (audit)
+		return audit_lookup(reg);
+
+	val = read_reg(reg);
 	printf("%s (0x%x): 0x%08x\n", name, reg, val);
 
 	return val;
@@ -52,6 +117,16 @@ check_chicken_unset(const char *name, uint32_t reg)
 {
 	uint32_t val = read_and_print_reg(name, reg);
 
+	if (collecting)
+		return;
+	if (audit) {
+		if (val != 0) {
+			printf("violation reg=0x%05x class=fail name=\"%s\" "
+			       "want=0x00000000 got=0x%08x\n", reg, name, val);
+			audit_fails++;
+		}
+		return;
+	}
 
 	if (val != 0) {
 		fprintf(stderr, "           WARN: chicken bits set\n");
@@ -63,6 +138,18 @@ check_chicken_unset(const char *name, uint32_t reg)
 static void
 check_bit(uint32_t val, int bit, const char *bitname, bool set)
 {
+	if (collecting)
+		return;
+	if (audit) {
+		if (!!(val & (1 << bit)) != set) {
+			printf("violation reg=0x%05x bit=%d class=fail "
+			       "name=\"%s\" want=%s\n", current_reg, bit,
+			       bitname, set ? "set" : "unset");
+			audit_fails++;
+		}
+		return;
+	}
+
 	if (!!(val & (1 << bit)) != set) {
 		fprintf(stderr, "  (bit %2d) FAIL: %s must be %s\n",
 			bit, bitname, set ? "set" : "unset");
@@ -74,6 +161,18 @@ check_bit(uint32_t val, int bit, const char *bitname, bool set)
 static void
 check_perf_bit(uint32_t val, int bit, const char *bitname, bool set)
 {
+	if (collecting)
+		return;
+	if (audit) {
+		if (!!(val & (1 << bit)) != set) {
+			printf("violation reg=0x%05x bit=%d class=perf "
+			       "name=\"%s\" want=%s\n", current_reg, bit,
+			       bitname, set ? "set" : "unset");
+			audit_perfs++;
+		}
+		return;
+	}
+
 	if (!!(val & (1 << bit)) != set) {
 		printf("  (bit %2d) PERF: %s should be %s\n",
 			bit, bitname, set ? "set" : "unset");
@@ -319,6 +418,19 @@ check_3d_chicken4(void)
 
 	check_perf_bit(_3d_chicken4, 6, "3D Scoreboard Hashing Enable", true);
 
+	if (collecting)
+		return;
+	if (audit) {
+		if (_3d_chicken4 & 0x0fbf) {
+			printf("violation reg=0x%05x class=fail "
+			       "name=\"3D_CHICKEN4 non-thread deps bits\" "
+			       "want=0x00000000 got=0x%08x\n", current_reg,
+			       _3d_chicken4 & 0x0fbf);
+			audit_fails++;
+		}
+		return;
+	}
+
 	if (_3d_chicken4 & 0x0fbf) {
 		fprintf(stderr,
 			"         WARN:   other non-thread deps bits set\n");
@@ -343,13 +455,92 @@ check_dpfc_control_sa(void)
 	check_bit(dpfc_control_sa, 29, "CPU Fence Enable", true);
 }
 
+static void
+load_baseline(const char *path)
+{
+	FILE *file;
+	uint32_t reg, mask, want;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+		err(1, "%s", path);
+
+	while (fscanf(file, "%x %x %x", &reg, &mask, &want) == 3) {
+		if (num_baseline == MAX_AUDIT_REGS)
+			errx(1, "too many baseline entries");
+		baseline[num_baseline].reg = reg;
+		baseline[num_baseline].mask = mask;
+		baseline[num_baseline].want = want;
+		num_baseline++;
+		audit_record("baseline", reg);
+	}
+	fclose(file);
+}
+
+static void
+check_baseline(void)
+{
+	int i;
+
+	for (i = 0; i < num_baseline; i++) {
+		uint32_t got = audit_lookup(baseline[i].reg);
+
+		if ((got & baseline[i].mask) == baseline[i].want)
+			continue;
+		printf("violation reg=0x%05x class=fail name=\"baseline\" "
+		       "mask=0x%08x want=0x%08x got=0x%08x\n",
+		       baseline[i].reg, baseline[i].mask, baseline[i].want,
+		       got & baseline[i].mask);
+		audit_fails++;
+	}
+}
+
+static void run_checks(void);
+
+static void
+run_audit(const char *baseline_path)
+{
+	struct intel_register_burst burst;
+	uint32_t regs[MAX_AUDIT_REGS];
+	int i;
+
+	collecting = 1;
+	run_checks();
+	collecting = 0;
+	if (baseline_path)
+		load_baseline(baseline_path);
+
+	for (i = 0; i < num_audit_regs; i++)
+		regs[i] = audit_regs[i].reg;
+	intel_register_burst_init(&burst, regs, num_audit_regs);
+	intel_register_burst_capture(&burst);
+	for (i = 0; i < num_audit_regs; i++)
+		audit_regs[i].val = burst.vals[i];
+	intel_register_burst_fini(&burst);
+
+	run_checks();
+	check_baseline();
+}
+
 int main(int argc, char** argv)
 {
 	struct pci_device *dev;
+	const char *baseline_path = NULL;
+
+	if (argc > 1 && strcmp(argv[1], "-a") == 0) {
+		audit = 1;
+		if (argc > 2)
+			baseline_path = argv[2];
+	}
 
 	dev = intel_get_pci_device();
 	devid = dev->device_id;
-	intel_get_mmio(dev);
+	if (audit)
+		/* the full init so the burst capture runs under forcewake
+		 * on gen6+ and sees live GT register values */
+		intel_register_access_init(dev, 0);
+	else
+		intel_get_mmio(dev);
 
 	if (IS_GEN7(devid))
 		gen = 7;
@@ -360,6 +551,19 @@ int main(int argc, char** argv)
 	else
 		gen = 4;
 
+	if (audit) {
+		run_audit(baseline_path);
+		intel_register_access_fini();
+		return audit_fails ? 1 : audit_perfs ? 2 : 0;
+	}
+
+	run_checks();
+
+	return 0;
+}
+
+static void run_checks(void)
+{
 	check_mi_mode();
 	check_gfx_mode();
 	check_gt_mode();
@@ -393,7 +597,5 @@ int main(int argc, char** argv)
 	check_chicken_unset("ECOSKPD", 0x21d0);
 
 	check_dpfc_control_sa();
-
-	return 0;
 }
 
@@ -0,0 +1,225 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file intel_reg_daemon.c
+ *
+ * Persistent register access daemon.
+ *
+ * intel_reg_read/intel_reg_write pay for PCI probing and mapping the MMIO
+ * BAR on every invocation, which dwarfs the cost of the access itself when
+ * automation pokes dozens of registers per second.  This daemon does the
+ * init once, holds the mapping open and serves batched requests over a
+ * unix socket.
+ *
+ * Protocol: newline-separated requests, any number per connection.
+ *	R <addr>		read, replies "0x<value>\n"
+ *	W <addr> <value>	write, replies "OK\n"
+ * Malformed requests get "ERR\n".  Addresses and values accept any base
+ * strtoul understands.
+ *
+ * Client mode (-c) sends the remaining arguments as one batch:
+ *	intel_reg_daemon -c R 0x2030 W 0x2030 0xdeadbeef
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <err.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "intel_gpu_tools.h"
+
+#define DEFAULT_SOCKET_PATH "/var/run/intel_reg_daemon.sock"
+
+static const char *socket_path = DEFAULT_SOCKET_PATH;
+
+static void usage(const char *cmdname)
+{
+	printf("Usage: %s [-s socket] [-c request...]\n", cmdname);
+	printf("\t -s <path> : socket path (default %s)\n",
+	       DEFAULT_SOCKET_PATH);
+	printf("\t -c : client mode; send the remaining arguments as one\n");
+	printf("\t      batch of requests (R <addr> | W <addr> <value>)\n");
+	printf("Without -c, runs as the daemon serving batched register\n");
+	printf("reads and writes over the socket.\n");
+}
+
+static void serve_client(int fd)
+{
+	FILE *in, *out;
+	char line[128];
+
+	in = fdopen(fd, "r");
+	out = fdopen(dup(fd), "w");
+	if (in == NULL || out == NULL) {
+		close(fd);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), in)) {
+		uint32_t reg, val;
+		char *arg, *end;
+
+		if (line[0] == 'R' && line[1] == ' ') {
+			reg = strtoul(line + 2, &end, 0);
+			if (end == line + 2) {
+				fputs("ERR\n", out);
+				continue;
+			}
+			fprintf(out, "0x%08x\n", intel_register_read(reg));
+		} else if (line[0] == 'W' && line[1] == ' ') {
+			arg = line + 2;
+			reg = strtoul(arg, &end, 0);
+			if (end == arg) {
+				fputs("ERR\n", out);
+				continue;
+			}
+			arg = end;
+			val = strtoul(arg, &end, 0);
+			if (end == arg) {
+				fputs("ERR\n", out);
+				continue;
+			}
+			intel_register_write(reg, val);
+			fputs("OK\n", out);
+		} else {
+			fputs("ERR\n", out);
+		}
+	}
+
+	/* One flush per batch, not per register. */
+	fclose(out);
+	fclose(in);
+}
+
+static int run_daemon(void)
+{
+	struct sockaddr_un addr;
+	int sock, client;
+
+	intel_register_access_init(intel_get_pci_device(), 0);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0)
+		err(1, "socket");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	unlink(socket_path);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		err(1, "bind(%s)", socket_path);
+	if (listen(sock, 8) < 0)
+		err(1, "listen");
+
+	signal(SIGPIPE, SIG_IGN);
+
+	while ((client = accept(sock, NULL, NULL)) >= 0)
+		serve_client(client);
+
+	intel_register_access_fini();
+	return 0;
+}
+
+static int run_client(int argc, char **argv)
+{
+	struct sockaddr_un addr;
+	char line[128];
+	FILE *out, *in;
+	int sock, i;
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0)
+		err(1, "socket");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		err(1, "connect(%s)", socket_path);
+
+	out = fdopen(dup(sock), "w");
+	in = fdopen(sock, "r");
+	if (out == NULL || in == NULL)
+		err(1, "fdopen");
+
+	/* Assemble the whole batch before the daemon sees any of it. */
+	for (i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], "R") && i + 1 < argc) {
+			fprintf(out, "R %s\n", argv[i + 1]);
+			i += 1;
+		} else if (!strcmp(argv[i], "W") && i + 2 < argc) {
+			fprintf(out, "W %s %s\n", argv[i + 1], argv[i + 2]);
+			i += 2;
+		} else {
+			fprintf(stderr, "malformed request near '%s'\n",
+				argv[i]);
+			exit(1);
+		}
+	}
+	fclose(out);
+	shutdown(sock, SHUT_WR);
+
+	while (fgets(line, sizeof(line), in))
+		fputs(line, stdout);
+	fclose(in);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int client_mode = 0;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "s:ch")) != -1) {
+		switch (ch) {
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'c':
+			client_mode = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			exit(ch == 'h' ? 0 : 1);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (client_mode)
+		return run_client(argc, argv);
+
+	if (argc != 0) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	return run_daemon();
+}
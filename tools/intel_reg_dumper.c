@@ -33,6 +33,7 @@
 #include <string.h>
 #include <err.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include "intel_gpu_tools.h"
 
 static uint32_t devid = 0;
@@ -431,13 +432,13 @@ DEBUGSTRING(i830_debug_dpll)
 	int p1, p2 = 0;
 
 	if (IS_GEN2(devid)) {
-		char is_lvds = (INREG(LVDS) & LVDS_PORT_EN) && (reg == DPLL_B);
+		char is_lvds = (intel_register_read_cached(LVDS) & LVDS_PORT_EN) && (reg == DPLL_B);
 
 		if (is_lvds) {
 			mode = "LVDS";
 			p1 = ffs((val & DPLL_FPA01_P1_POST_DIV_MASK_I830_LVDS)
 				 >> DPLL_FPA01_P1_POST_DIV_SHIFT);
-			if ((INREG(LVDS) & LVDS_CLKB_POWER_MASK) ==
+			if ((intel_register_read_cached(LVDS) & LVDS_CLKB_POWER_MASK) ==
 			    LVDS_CLKB_POWER_UP)
 				p2 = 7;
 			else
@@ -1942,13 +1943,27 @@ _intel_dump_reg(struct reg_debug *reg, uint32_t val)
 static void
 _intel_dump_regs(struct reg_debug *regs, int count)
 {
+	struct intel_register_burst burst;
+	uint32_t *offsets;
 	int i;
 
-	for (i = 0; i < count; i++) {
-		uint32_t val = INREG(regs[i].reg);
+	offsets = malloc(count * sizeof(*offsets));
+	if (offsets == NULL)
+		err(1, "malloc");
+	for (i = 0; i < count; i++)
+		offsets[i] = regs[i].reg;
 
-		_intel_dump_reg(&regs[i], val);
-	}
+	/* Burst-capture every offset first, so the dump reflects a single
+	 * point in time and the (comparatively slow) formatting doesn't
+	 * interleave with the MMIO reads. */
+	intel_register_burst_init(&burst, offsets, count);
+	intel_register_burst_capture(&burst);
+
+	for (i = 0; i < count; i++)
+		_intel_dump_reg(&regs[i], burst.vals[i]);
+
+	intel_register_burst_fini(&burst);
+	free(offsets);
 }
 
 DEBUGSTRING(gen6_rp_control)
@@ -2037,18 +2052,61 @@ decode_register_name(char *name, uint32_t val)
 	}
 }
 
+/* O(1) offset -> register lookup.  The hash is built lazily over the
+ * known_registers tables; several generations may define the same offset,
+ * so duplicates simply occupy further slots along the probe chain and
+ * lookups walk the chain to its first empty slot. */
+#define REG_HASH_SZ 2048	/* power of two, > 2x the table entries */
+
+struct reg_hash_entry {
+	struct reg_debug *reg;
+	const char *description;
+};
+static struct reg_hash_entry reg_hash[REG_HASH_SZ];
+static bool reg_hash_built;
+
+static unsigned int
+reg_hash_slot(uint32_t address)
+{
+	return (address * 2654435761u) & (REG_HASH_SZ - 1);
+}
+
 static void
-decode_register_address(int address, uint32_t val)
+build_reg_hash(void)
 {
 	int i, j;
 
 	for (i = 0; i < ARRAY_SIZE(known_registers); i++) {
 		struct reg_debug *regs = known_registers[i].regs;
 
-		for (j = 0; j < known_registers[i].count; j++)
-			if (regs[j].reg == address)
-				dump_reg(&regs[j], val,
-					 known_registers[i].description);
+		for (j = 0; j < known_registers[i].count; j++) {
+			unsigned int slot = reg_hash_slot(regs[j].reg);
+
+			while (reg_hash[slot].reg != NULL)
+				slot = (slot + 1) & (REG_HASH_SZ - 1);
+			reg_hash[slot].reg = &regs[j];
+			reg_hash[slot].description =
+				known_registers[i].description;
+		}
+	}
+
+	reg_hash_built = true;
+}
+
+static void
+decode_register_address(int address, uint32_t val)
+{
+	unsigned int slot;
+
+	if (!reg_hash_built)
+		build_reg_hash();
+
+	for (slot = reg_hash_slot(address);
+	     reg_hash[slot].reg != NULL;
+	     slot = (slot + 1) & (REG_HASH_SZ - 1)) {
+		if (reg_hash[slot].reg->reg == address)
+			dump_reg(reg_hash[slot].reg, val,
+				 reg_hash[slot].description);
 	}
 }
 
@@ -2096,10 +2154,10 @@ intel_dump_other_regs(void)
 	i830DumpIndexed(pScrn, "CR", crt + 4, crt + 5, 0, 0x24);
 #endif
 	for (disp_pipe = 0; disp_pipe <= 1; disp_pipe++) {
-		fp = INREG(disp_pipe == 0 ? FPA0 : FPB0);
-		dpll = INREG(disp_pipe == 0 ? DPLL_A : DPLL_B);
+		fp = intel_register_read_cached(disp_pipe == 0 ? FPA0 : FPB0);
+		dpll = intel_register_read_cached(disp_pipe == 0 ? DPLL_A : DPLL_B);
 		if (IS_GEN2(devid)) {
-			uint32_t lvds = INREG(LVDS);
+			uint32_t lvds = intel_register_read_cached(LVDS);
 			if (devid == PCI_CHIP_I855_GM &&
 			    (lvds & LVDS_PORT_EN) &&
 			    (lvds & LVDS_PIPEB_SELECT) == (disp_pipe << 30)) {
@@ -2157,7 +2215,7 @@ intel_dump_other_regs(void)
 				break;
 			}
 		} else {
-			uint32_t lvds = INREG(LVDS);
+			uint32_t lvds = intel_register_read_cached(LVDS);
 			if ((lvds & LVDS_PORT_EN) &&
 			    (lvds & LVDS_PIPEB_SELECT) == (disp_pipe << 30)) {
 				if ((lvds & LVDS_CLKB_POWER_MASK) ==
@@ -2272,6 +2330,127 @@ intel_dump_other_regs(void)
 	}
 }
 
+/* Ring buffer watch mode.  Instead of a one-shot dump, sample
+ * head/tail/ctl of one ring at a kHz rate into a preallocated sample
+ * ring and print only state transitions, so sub-millisecond stalls
+ * (head pinned while work is still queued) show up without the cost of
+ * re-executing the whole dumper in a shell loop.
+ */
+#define WATCH_PERIOD_US		1000	/* 1 kHz sampling */
+#define WATCH_SAMPLES		4096	/* power of two */
+#define WATCH_STALL_SAMPLES	8	/* head pinned this long == stall */
+
+struct ring_sample {
+	uint64_t us;
+	uint32_t head, tail, ctl;
+};
+
+static struct ring_sample watch_samples[WATCH_SAMPLES];
+
+static const struct {
+	const char *name;
+	uint32_t mmio;
+} watch_rings[] = {
+	{ "render", 0x2030 },
+	{ "bsd", 0x4030 },
+	{ "bsd6", 0x12030 },
+	{ "blt", 0x22030 },
+};
+
+enum ring_state {
+	RING_IDLE,
+	RING_BUSY,
+	RING_STALLED,
+};
+
+static const char *ring_state_name[] = {
+	"idle",
+	"busy",
+	"STALLED",
+};
+
+static uint64_t
+watch_gettime_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+/* head unchanged for the last WATCH_STALL_SAMPLES samples although work
+ * is still queued behind it */
+static int
+ring_head_stuck(uint32_t count)
+{
+	const struct ring_sample *newest =
+		&watch_samples[(count - 1) % WATCH_SAMPLES];
+	uint32_t i;
+
+	if (count < WATCH_STALL_SAMPLES)
+		return 0;
+
+	if (newest->head == newest->tail)
+		return 0;
+
+	for (i = 2; i <= WATCH_STALL_SAMPLES; i++)
+		if (watch_samples[(count - i) % WATCH_SAMPLES].head !=
+		    newest->head)
+			return 0;
+
+	return 1;
+}
+
+static void
+watch_ring_buf(const char *name)
+{
+	enum ring_state state = RING_IDLE;
+	uint64_t start_us;
+	uint32_t mmio = 0;
+	uint32_t count = 0;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(watch_rings) / sizeof(watch_rings[0]); i++)
+		if (strcmp(watch_rings[i].name, name) == 0)
+			mmio = watch_rings[i].mmio;
+	if (!mmio)
+		errx(1, "unknown ring \"%s\"", name);
+
+	printf("watching %s ring at %u Hz, printing state transitions "
+	       "(ctrl-c to stop)\n", name, 1000000 / WATCH_PERIOD_US);
+
+	start_us = watch_gettime_us();
+	for (;;) {
+		struct ring_sample *s = &watch_samples[count % WATCH_SAMPLES];
+		enum ring_state new_state;
+
+		s->us = watch_gettime_us();
+		s->head = intel_register_read(mmio + RING_HEAD) & HEAD_ADDR;
+		s->tail = intel_register_read(mmio + RING_TAIL) & TAIL_ADDR;
+		s->ctl = intel_register_read(mmio + RING_LEN);
+		count++;
+
+		if (ring_head_stuck(count))
+			new_state = RING_STALLED;
+		else if (s->head == s->tail)
+			new_state = RING_IDLE;
+		else
+			new_state = RING_BUSY;
+
+		if (new_state != state) {
+			printf("+%10.6fs: %s -> %s  head 0x%08x tail 0x%08x "
+			       "ctl 0x%08x\n",
+			       (s->us - start_us) / 1e6,
+			       ring_state_name[state],
+			       ring_state_name[new_state],
+			       s->head, s->tail, s->ctl);
+			state = new_state;
+		}
+
+		usleep(WATCH_PERIOD_US);
+	}
+}
+
 static void print_usage(void)
 {
 	printf("Usage: intel_reg_dumper [options] [file]\n"
@@ -2279,6 +2458,8 @@ static void print_usage(void)
 	       "Options:\n"
 	       "  -d id   when a dump file is used, use 'id' as device id (in "
 	       "hex)\n"
+	       "  -w ring watch a ring buffer (render, bsd, bsd6, blt) and "
+	       "print state transitions\n"
 	       "  -h      prints this help\n");
 }
 
@@ -2286,14 +2467,17 @@ int main(int argc, char** argv)
 {
 	struct pci_device *pci_dev;
 	int opt, n_args;
-	char *file = NULL, *reg_name = NULL;
+	char *file = NULL, *reg_name = NULL, *watch_ring = NULL;
 	uint32_t reg_val;
 
-	while ((opt = getopt(argc, argv, "d:h")) != -1) {
+	while ((opt = getopt(argc, argv, "d:w:h")) != -1) {
 		switch (opt) {
 		case 'd':
 			devid = strtol(optarg, NULL, 16);
 			break;
+		case 'w':
+			watch_ring = optarg;
+			break;
 		case 'h':
 			print_usage();
 			return 0;
@@ -2344,6 +2528,19 @@ int main(int argc, char** argv)
 			intel_check_pch();
 	}
 
+	if (watch_ring) {
+		if (file)
+			errx(1, "-w needs a live device, not a dump file");
+		watch_ring_buf(watch_ring);
+		/* not reached */
+	}
+
+	/* One-shot dump: cache register reads so each BAR line is only
+	 * fetched once even when several decoders look at the same
+	 * status register. */
+	if (!file)
+		intel_register_cache_enable();
+
 	if (HAS_PCH_SPLIT(devid)) {
 		intel_dump_regs(ironlake_debug_regs);
 	} else if (IS_945GM(devid)) {
@@ -0,0 +1,200 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Replay a register write trace recorded via intel_register_trace_start().
+ *
+ * The crc chain in the log is verified before a single write reaches
+ * the hardware, so a truncated, reordered or hand-edited trace is
+ * rejected up front.  During replay the original spacing between
+ * writes is restored: long gaps sleep most of the way and busy-wait
+ * the rest on the TSC, so the sequence lands within microseconds of
+ * the recorded timing.  Feed it a known-good bring-up trace and a
+ * misbehaving machine can be walked to the same state in seconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#include "intel_gpu_tools.h"
+#include "intel_clock.h"
+#include "intel_crc32c.h"
+
+static struct intel_register_trace_record *records;
+static int num_records;
+
+static uint32_t load_trace(const char *path)
+{
+	struct intel_register_trace_header hdr;
+	struct intel_register_trace_record rec;
+	uint32_t crc = 0;
+	size_t n;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL)
+		err(1, "%s", path);
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+		errx(1, "%s: truncated header", path);
+	if (hdr.magic != INTEL_REG_TRACE_MAGIC)
+		errx(1, "%s: not a register trace", path);
+	if (hdr.version != INTEL_REG_TRACE_VERSION)
+		errx(1, "%s: trace version %d, tool knows %d",
+		     path, hdr.version, INTEL_REG_TRACE_VERSION);
+
+	while ((n = fread(&rec, 1, sizeof(rec), f)) == sizeof(rec)) {
+		crc = intel_crc32c(crc, &rec,
+				   offsetof(struct intel_register_trace_record,
+					    crc));
+		if (rec.crc != crc)
+			errx(1, "%s: crc chain broken at record %d - "
+			     "truncated or edited trace, refusing",
+			     path, num_records);
+
+		records = realloc(records,
+				  (num_records + 1) * sizeof(*records));
+		if (!records)
+			err(1, "realloc");
+		records[num_records++] = rec;
+	}
+	if (n != 0)
+		errx(1, "%s: %zu trailing bytes after record %d",
+		     path, n, num_records);
+
+	fclose(f);
+	return hdr.devid;
+}
+
+/* wait until target_us after start: sleep the bulk of a long gap,
+ * spin the last stretch on the TSC for microsecond placement.
+ * Scheduling against the absolute start keeps timing error from
+ * accumulating over a long trace. */
+static void wait_until(uint64_t start, double target_us)
+{
+	double now_us;
+
+	for (;;) {
+		now_us = intel_clock_to_us(intel_clock_now() - start);
+		if (now_us >= target_us)
+			return;
+		if (target_us - now_us > 1000)
+			usleep(target_us - now_us - 500);
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n] [-f] trace\n"
+		"  -n  decode and print the trace, touch no hardware\n"
+		"  -f  replay even if the trace is from a different device\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct pci_device *pci_dev;
+	uint64_t total_us = 0, start, elapsed;
+	uint32_t trace_devid;
+	double worst_late = 0, sched_us;
+	int dry_run = 0, force = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "nfh")) != -1) {
+		switch (c) {
+		case 'n':
+			dry_run = 1;
+			break;
+		case 'f':
+			force = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	trace_devid = load_trace(argv[optind]);
+	for (i = 0; i < num_records; i++)
+		total_us += records[i].delta_us;
+
+	printf("%d writes over %.3fs, recorded on device 0x%04x\n",
+	       num_records, total_us / 1e6, trace_devid);
+
+	if (dry_run) {
+		uint64_t t = 0;
+
+		for (i = 0; i < num_records; i++) {
+			t += records[i].delta_us;
+			printf("%12.6fs  0x%08x <- 0x%08x\n", t / 1e6,
+			       records[i].reg, records[i].val);
+		}
+		return 0;
+	}
+
+	pci_dev = intel_get_pci_device();
+	if (pci_dev->device_id != trace_devid && !force)
+		errx(1, "trace is from 0x%04x but this is 0x%04x "
+		     "(-f to replay anyway)", trace_devid,
+		     pci_dev->device_id);
+
+	/* bring-up sequences touch registers the safety map would
+	 * block, so replay runs unfiltered */
+	if (intel_register_access_init(pci_dev, 0))
+		err(1, "register access init (needs root)");
+
+	start = intel_clock_now();
+	sched_us = 0;
+	for (i = 0; i < num_records; i++) {
+		double late;
+
+		sched_us += records[i].delta_us;
+		if (records[i].delta_us)
+			wait_until(start, sched_us);
+
+		late = intel_clock_to_us(intel_clock_now() - start) -
+			sched_us;
+		if (late > worst_late)
+			worst_late = late;
+
+		intel_register_write(records[i].reg, records[i].val);
+	}
+	elapsed = intel_clock_now() - start;
+
+	intel_register_access_fini();
+
+	printf("replayed in %.3fs (recorded %.3fs), worst write %.1fus "
+	       "behind schedule\n",
+	       intel_clock_to_us(elapsed) / 1e6, total_us / 1e6,
+	       worst_late);
+
+	return 0;
+}
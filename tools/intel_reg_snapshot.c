@@ -25,15 +25,139 @@
  */
 
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
 #include <assert.h>
+#include <err.h>
 #include "intel_gpu_tools.h"
+#include "intel_stream.h"
+
+/* Binary snapshot format: a small header followed by the raw BAR dwords.
+ * The devid is recorded so diffs can be annotated offline through
+ * intel_get_register_map() without touching the hardware. */
+#define SNAPSHOT_MAGIC		0x49534e50	/* "ISNP" */
+#define SNAPSHOT_VERSION	1
+
+struct snapshot_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t size;		/* payload bytes following the header */
+};
+
+static void usage(const char *cmdname)
+{
+	printf("Usage: %s [-b] [-d file1 file2]\n", cmdname);
+	printf("\t (no args) : write the raw MMIO BAR to stdout\n");
+	printf("\t -b : write a binary snapshot (header + dwords) to stdout\n");
+	printf("\t -d : diff two binary snapshots, printing changed offsets\n");
+}
+
+static int open_snapshot(const char *filename,
+			 struct snapshot_header *header)
+{
+	ssize_t ret;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(1, "%s", filename);
+
+	ret = read(fd, header, sizeof(*header));
+	if (ret != sizeof(*header) || header->magic != SNAPSHOT_MAGIC)
+		errx(1, "%s: not a binary register snapshot", filename);
+	if (header->version != SNAPSHOT_VERSION)
+		errx(1, "%s: unknown snapshot version %d", filename,
+		     header->version);
+
+	return fd;
+}
+
+/* Sliced compare: the snapshots are walked in fixed-size chunks so the
+ * diff never stages more than two chunks regardless of BAR size. */
+#define DIFF_CHUNK_DWORDS	(64 << 10 >> 2)
+
+static int diff_snapshots(const char *file1, const char *file2)
+{
+	static uint32_t chunk1[DIFF_CHUNK_DWORDS], chunk2[DIFF_CHUNK_DWORDS];
+	struct snapshot_header header1, header2;
+	struct intel_register_map map;
+	unsigned int i, pos, count, changed = 0;
+	int fd1, fd2;
+
+	fd1 = open_snapshot(file1, &header1);
+	fd2 = open_snapshot(file2, &header2);
+
+	if (header1.devid != header2.devid)
+		errx(1, "snapshots from different devices (0x%04x vs 0x%04x)",
+		     header1.devid, header2.devid);
+	if (header1.size != header2.size)
+		errx(1, "snapshot sizes differ (%u vs %u)",
+		     header1.size, header2.size);
+
+	map = intel_get_register_map(header1.devid);
+
+	for (pos = 0; pos < header1.size / 4; pos += count) {
+		count = header1.size / 4 - pos;
+		if (count > DIFF_CHUNK_DWORDS)
+			count = DIFF_CHUNK_DWORDS;
+
+		if (read(fd1, chunk1, count * 4) != count * 4)
+			errx(1, "%s: truncated snapshot", file1);
+		if (read(fd2, chunk2, count * 4) != count * 4)
+			errx(1, "%s: truncated snapshot", file2);
+
+		for (i = 0; i < count; i++) {
+			struct intel_register_range *range;
+			uint32_t offset = (pos + i) * 4;
+
+			if (chunk1[i] == chunk2[i])
+				continue;
+
+			range = intel_get_register_range(map, offset,
+							 INTEL_RANGE_READ);
+			printf("0x%06x: 0x%08x -> 0x%08x%s\n", offset,
+			       chunk1[i], chunk2[i],
+			       range ? "" : " (unknown/reserved range)");
+			changed++;
+		}
+	}
+
+	printf("%u dwords changed\n", changed);
+
+	close(fd1);
+	close(fd2);
+	return changed != 0;
+}
 
 int main(int argc, char** argv)
 {
 	struct pci_device *pci_dev;
 	uint32_t devid;
 	int mmio_bar;
-	int ret;
+	int binary = 0;
+	ssize_t ret;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "bdh")) != -1) {
+		switch (ch) {
+		case 'b':
+			binary = 1;
+			break;
+		case 'd':
+			if (argc - optind != 2) {
+				usage(argv[0]);
+				exit(1);
+			}
+			return diff_snapshots(argv[optind], argv[optind + 1]);
+		case 'h':
+		default:
+			usage(argv[0]);
+			exit(ch == 'h' ? 0 : 1);
+		}
+	}
 
 	pci_dev = intel_get_pci_device();
 	devid = pci_dev->device_id;
@@ -44,8 +168,24 @@ int main(int argc, char** argv)
 	else
 		mmio_bar = 0;
 
-	ret = write(1, mmio, pci_dev->regions[mmio_bar].size);
-	assert(ret > 0);
+	if (binary) {
+		struct snapshot_header header = {
+			.magic = SNAPSHOT_MAGIC,
+			.version = SNAPSHOT_VERSION,
+			.devid = devid,
+			.size = pci_dev->regions[mmio_bar].size,
+		};
+
+		ret = write(1, &header, sizeof(header));
+		assert(ret == sizeof(header));
+	}
+
+	/* stream the BAR through the bounded staging ring; a single
+	 * write() of a multi-GB region would truncate and stage nothing
+	 * for overlap */
+	ret = intel_stream_copy_mem(1, mmio, pci_dev->regions[mmio_bar].size);
+	if (ret)
+		errx(1, "writing snapshot: %s", strerror(-ret));
 
 	return 0;
 }
@@ -0,0 +1,363 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Query tool for the results log written via intel_results_report().
+ *
+ * Records are grouped into one series per (test, metric, devid) and
+ * each series is summarised with its mean, a least-squares trend slope
+ * per run, and the change of the latest run against the mean of the
+ * earlier ones; series whose latest run moved by more than the
+ * threshold are flagged for a human to look at.  The log only stores
+ * values, so the flag is direction-agnostic - a throughput collapse
+ * and a latency collapse both show up as a large change.
+ *
+ * With -b a second log is loaded as the baseline and each series is
+ * instead compared mean-against-mean with the matching baseline series;
+ * this is what `make perf-report` uses to highlight regressions against
+ * a stored good run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <err.h>
+
+#include "intel_results.h"
+
+struct series {
+	char test[sizeof(((struct intel_results_record *)0)->test)];
+	char metric[sizeof(((struct intel_results_record *)0)->metric)];
+	char unit[sizeof(((struct intel_results_record *)0)->unit)];
+	uint32_t devid;
+	double *values;
+	uint64_t *times;
+	int count, size;
+};
+
+static struct series *all_series;
+static int num_series, series_size;
+
+/* baseline log for -b, stashed aside after loading */
+static struct series *base_series;
+static int num_base;
+
+static struct series *series_get(const struct intel_results_record *rec)
+{
+	struct series *s;
+	int i;
+
+	for (i = 0; i < num_series; i++) {
+		s = &all_series[i];
+		if (s->devid == rec->devid &&
+		    strcmp(s->test, rec->test) == 0 &&
+		    strcmp(s->metric, rec->metric) == 0)
+			return s;
+	}
+
+	if (num_series == series_size) {
+		series_size = series_size ? 2 * series_size : 64;
+		all_series = realloc(all_series,
+				     series_size * sizeof(*all_series));
+		if (!all_series)
+			err(1, "realloc");
+	}
+
+	s = &all_series[num_series++];
+	memset(s, 0, sizeof(*s));
+	memcpy(s->test, rec->test, sizeof(s->test));
+	memcpy(s->metric, rec->metric, sizeof(s->metric));
+	memcpy(s->unit, rec->unit, sizeof(s->unit));
+	s->devid = rec->devid;
+
+	return s;
+}
+
+static void series_add(struct series *s, const struct intel_results_record *rec)
+{
+	if (s->count == s->size) {
+		s->size = s->size ? 2 * s->size : 16;
+		s->values = realloc(s->values, s->size * sizeof(*s->values));
+		s->times = realloc(s->times, s->size * sizeof(*s->times));
+		if (!s->values || !s->times)
+			err(1, "realloc");
+	}
+	s->values[s->count] = rec->value;
+	s->times[s->count] = rec->time;
+	s->count++;
+}
+
+static void load_log(const char *path)
+{
+	struct intel_results_record rec;
+	FILE *f;
+	size_t n;
+	long records = 0;
+
+	f = fopen(path, "rb");
+	if (!f)
+		err(1, "%s", path);
+
+	while ((n = fread(&rec, 1, sizeof(rec), f)) == sizeof(rec)) {
+		if (rec.magic != INTEL_RESULTS_MAGIC)
+			errx(1, "%s: bad magic in record %ld, log corrupt?",
+			     path, records);
+		if (rec.version != INTEL_RESULTS_VERSION)
+			errx(1, "%s: record version %d, tool knows %d",
+			     path, rec.version, INTEL_RESULTS_VERSION);
+
+		/* the strings come from an append-only file; make sure
+		 * they terminate even if the writer was buggy */
+		rec.test[sizeof(rec.test) - 1] = '\0';
+		rec.metric[sizeof(rec.metric) - 1] = '\0';
+		rec.unit[sizeof(rec.unit) - 1] = '\0';
+
+		series_add(series_get(&rec), &rec);
+		records++;
+	}
+
+	if (n != 0)
+		fprintf(stderr, "%s: %zu trailing bytes ignored "
+			"(interrupted writer?)\n", path, n);
+
+	fclose(f);
+}
+
+/* least-squares slope of value over run index */
+static double series_slope(const struct series *s)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int i;
+
+	if (s->count < 2)
+		return 0;
+
+	for (i = 0; i < s->count; i++) {
+		sx += i;
+		sy += s->values[i];
+		sxx += (double)i * i;
+		sxy += i * s->values[i];
+	}
+
+	return (s->count * sxy - sx * sy) / (s->count * sxx - sx * sx);
+}
+
+static double series_mean(const struct series *s)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < s->count; i++)
+		sum += s->values[i];
+
+	return sum / s->count;
+}
+
+static struct series *baseline_find(const struct series *s)
+{
+	struct series *b;
+	int i;
+
+	for (i = 0; i < num_base; i++) {
+		b = &base_series[i];
+		if (b->devid == s->devid &&
+		    strcmp(b->test, s->test) == 0 &&
+		    strcmp(b->metric, s->metric) == 0)
+			return b;
+	}
+
+	return NULL;
+}
+
+static int print_compare(const struct series *s, double threshold)
+{
+	struct series *b = baseline_find(s);
+	double base_mean, mean, change = 0;
+	const char *flag = "";
+	int flagged = 0;
+
+	mean = series_mean(s);
+
+	if (!b) {
+		printf("%-24s %-28s 0x%04x %12s %12.2f %8s %s  (new)\n",
+		       s->test, s->metric, s->devid, "-", mean, "-", s->unit);
+		return 0;
+	}
+
+	base_mean = series_mean(b);
+	if (base_mean != 0)
+		change = 100.0 * (mean - base_mean) / base_mean;
+	if (change >= threshold || change <= -threshold) {
+		flag = "  <-- check";
+		flagged = 1;
+	}
+
+	printf("%-24s %-28s 0x%04x %12.2f %12.2f %+7.1f%% %s%s\n",
+	       s->test, s->metric, s->devid, base_mean, mean, change,
+	       s->unit, flag);
+
+	return flagged;
+}
+
+static int print_series(const struct series *s, double threshold, int verbose)
+{
+	double prior_mean = 0, change = 0;
+	const char *flag = "";
+	int i, flagged = 0;
+
+	for (i = 0; i < s->count - 1; i++)
+		prior_mean += s->values[i];
+	if (s->count > 1) {
+		prior_mean /= s->count - 1;
+		if (prior_mean != 0)
+			change = 100.0 * (s->values[s->count - 1] - prior_mean)
+				/ prior_mean;
+		if (change >= threshold || change <= -threshold) {
+			flag = "  <-- check";
+			flagged = 1;
+		}
+	}
+
+	printf("%-24s %-28s 0x%04x %4d %12.2f %12.2f %+9.2f %+7.1f%% %s%s\n",
+	       s->test, s->metric, s->devid, s->count,
+	       s->count > 1 ? prior_mean : s->values[0],
+	       s->values[s->count - 1], series_slope(s), change,
+	       s->unit, flag);
+
+	if (verbose) {
+		for (i = 0; i < s->count; i++) {
+			time_t t = s->times[i];
+			char stamp[32];
+
+			strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S",
+				 localtime(&t));
+			printf("    %s  %12.2f %s\n",
+			       stamp, s->values[i], s->unit);
+		}
+	}
+
+	return flagged;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-f log] [-b baseline] [-t test] [-m metric] "
+		"[-r pct] [-v]\n"
+		"  -f log      results log (default $INTEL_RESULTS_LOG)\n"
+		"  -b baseline compare means against this log instead of "
+		"trending\n"
+		"  -t test     only series from this test\n"
+		"  -m metric   only series whose metric contains this string\n"
+		"  -r pct      flag threshold in percent (default 10)\n"
+		"  -v          print every run of each matching series\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = getenv("INTEL_RESULTS_LOG");
+	const char *baseline = NULL;
+	const char *test_filter = NULL, *metric_filter = NULL;
+	double threshold = 10.0;
+	int verbose = 0, flagged = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "f:b:t:m:r:vh")) != -1) {
+		switch (c) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		case 't':
+			test_filter = optarg;
+			break;
+		case 'm':
+			metric_filter = optarg;
+			break;
+		case 'r':
+			threshold = atof(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!path || !path[0])
+		errx(1, "no log: pass -f or set INTEL_RESULTS_LOG");
+
+	if (baseline) {
+		/* the loaders only know the globals; load the baseline
+		 * first and move it aside */
+		load_log(baseline);
+		base_series = all_series;
+		num_base = num_series;
+		all_series = NULL;
+		num_series = series_size = 0;
+	}
+
+	load_log(path);
+	if (!num_series) {
+		printf("%s: empty log\n", path);
+		return 0;
+	}
+
+	if (baseline)
+		printf("%-24s %-28s %-6s %12s %12s %8s\n",
+		       "test", "metric", "devid",
+		       "baseline", "current", "change");
+	else
+		printf("%-24s %-28s %-6s %4s %12s %12s %9s %8s\n",
+		       "test", "metric", "devid", "runs",
+		       "prior mean", "last", "slope/run", "change");
+
+	for (i = 0; i < num_series; i++) {
+		struct series *s = &all_series[i];
+
+		if (test_filter && strcmp(s->test, test_filter))
+			continue;
+		if (metric_filter && !strstr(s->metric, metric_filter))
+			continue;
+
+		if (baseline)
+			flagged += print_compare(s, threshold);
+		else
+			flagged += print_series(s, threshold, verbose);
+	}
+
+	if (flagged)
+		printf("%d series moved by more than %.0f%%\n",
+		       flagged, threshold);
+
+	return flagged ? 2 : 0;
+}
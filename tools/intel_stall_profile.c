@@ -0,0 +1,274 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Sampling profiler for the GPU command stream.
+ *
+ * intel_gpu_top shows which units are busy and intel_error_decode shows
+ * where ACTHD pointed after a hang, but during a live stall nobody
+ * answers "where in the command stream is the GPU spending its time".
+ * This tool samples ACTHD, ring head/tail/start and the instdone bits
+ * in one register burst per sample, attributes each busy sample to the
+ * address region being executed (the ring itself when ACTHD falls
+ * inside it, otherwise the batch page ACTHD sits in - batch contents
+ * belong to other processes, so page granularity with tight min/max
+ * offsets is as fine as a live external observer can get), and
+ * reports per-region sample counts alongside the execution units that
+ * were not done while the CS was parked there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <err.h>
+#include <sys/time.h>
+
+#include "intel_gpu_tools.h"
+#include "instdone.h"
+
+#define MAX_REGIONS 4096
+#define DEFAULT_SECONDS 5
+#define DEFAULT_RATE 10000
+
+struct region {
+	uint32_t page;		/* GTT address >> 12; ring uses the
+				 * ring-relative page plus RING_FLAG */
+	uint64_t samples;
+	uint32_t min_off, max_off;	/* ACTHD span within the page */
+	uint32_t notdone[2];	/* OR of ~instdone while here */
+};
+
+#define RING_FLAG 0x80000000u
+
+static struct region regions[MAX_REGIONS];
+static int num_regions;
+
+static uint64_t total_samples, busy_samples;
+
+static struct region *region_get(uint32_t page)
+{
+	/* open addressing; the table is far larger than any realistic
+	 * number of distinct pages one workload executes from */
+	unsigned slot = (page * 2654435761u) & (MAX_REGIONS - 1);
+	int probes;
+
+	for (probes = 0; probes < MAX_REGIONS; probes++) {
+		struct region *r = &regions[slot];
+
+		if (r->samples && r->page == page)
+			return r;
+		if (!r->samples) {
+			r->page = page;
+			r->min_off = ~0u;
+			num_regions++;
+			return r;
+		}
+		slot = (slot + 1) & (MAX_REGIONS - 1);
+	}
+
+	return NULL;
+}
+
+static int cmp_region(const void *a, const void *b)
+{
+	const struct region *ra = a, *rb = b;
+
+	if (ra->samples != rb->samples)
+		return ra->samples < rb->samples ? 1 : -1;
+	return 0;
+}
+
+static void print_units(const uint32_t *notdone)
+{
+	int i, printed = 0;
+
+	for (i = 0; i < num_instdone_bits; i++) {
+		int word = instdone_bits[i].reg == INST_DONE_1;
+
+		if (!(notdone[word] & instdone_bits[i].bit))
+			continue;
+		printf("%s%s", printed++ ? "," : "  units: ",
+		       instdone_bits[i].name);
+		if (printed >= 6) {
+			printf(",...");
+			break;
+		}
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t seconds] [-r samples/sec] [-n top]\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct pci_device *pci_dev;
+	struct intel_register_burst burst;
+	uint32_t burst_regs[8];
+	struct timeval start, now;
+	uint32_t devid, acthd_reg, instdone_reg, instdone1_reg = 0;
+	int seconds = DEFAULT_SECONDS, rate = DEFAULT_RATE, top = 20;
+	int acthd_idx, head_idx, tail_idx, start_idx, len_idx;
+	int id_idx, id1_idx = -1;
+	int nregs = 0, c, i, delay;
+
+	while ((c = getopt(argc, argv, "t:r:n:h")) != -1) {
+		switch (c) {
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'n':
+			top = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (seconds < 1 || rate < 1 || top < 1)
+		usage(argv[0]);
+
+	pci_dev = intel_get_pci_device();
+	devid = pci_dev->device_id;
+
+	if (intel_register_access_init(pci_dev, 0))
+		err(1, "register access init (needs root)");
+
+	init_instdone_definitions(devid);
+
+	if (IS_965(devid)) {
+		acthd_reg = ACTHD_I965;
+		instdone_reg = INST_DONE_I965;
+		instdone1_reg = INST_DONE_1;
+	} else {
+		acthd_reg = ACTHD;
+		instdone_reg = INST_DONE;
+	}
+
+	acthd_idx = nregs; burst_regs[nregs++] = acthd_reg;
+	head_idx = nregs; burst_regs[nregs++] = LP_RING + RING_HEAD;
+	tail_idx = nregs; burst_regs[nregs++] = LP_RING + RING_TAIL;
+	start_idx = nregs; burst_regs[nregs++] = LP_RING + RING_START;
+	len_idx = nregs; burst_regs[nregs++] = LP_RING + RING_LEN;
+	id_idx = nregs; burst_regs[nregs++] = instdone_reg;
+	if (instdone1_reg) {
+		id1_idx = nregs;
+		burst_regs[nregs++] = instdone1_reg;
+	}
+
+	intel_register_burst_init(&burst, burst_regs, nregs);
+
+	delay = 1000000 / rate;
+	printf("sampling render CS at %d Hz for %d seconds...\n",
+	       rate, seconds);
+
+	gettimeofday(&start, NULL);
+	do {
+		uint32_t acthd, head, tail, ring_start, ring_size, page;
+		struct region *r;
+
+		intel_register_burst_capture(&burst);
+		acthd = burst.vals[acthd_idx];
+		head = burst.vals[head_idx] & HEAD_ADDR;
+		tail = burst.vals[tail_idx] & TAIL_ADDR;
+		ring_start = burst.vals[start_idx] & I830_RING_START_MASK;
+		ring_size = (((burst.vals[len_idx] & RING_NR_PAGES)
+			      >> 12) + 1) * 4096;
+
+		total_samples++;
+		if (head == tail)
+			goto next;
+		busy_samples++;
+
+		if (acthd - ring_start < ring_size)
+			page = RING_FLAG | ((acthd - ring_start) >> 12);
+		else
+			page = acthd >> 12;
+
+		r = region_get(page);
+		if (r) {
+			uint32_t off = acthd & 0xfff;
+
+			r->samples++;
+			if (off < r->min_off)
+				r->min_off = off;
+			if (off > r->max_off)
+				r->max_off = off;
+			r->notdone[0] |= ~burst.vals[id_idx];
+			if (id1_idx >= 0)
+				r->notdone[1] |= ~burst.vals[id1_idx];
+		}
+
+next:
+		usleep(delay);
+		gettimeofday(&now, NULL);
+	} while ((now.tv_sec - start.tv_sec) * 1000000ll +
+		 (now.tv_usec - start.tv_usec) < seconds * 1000000ll);
+
+	intel_register_burst_fini(&burst);
+	intel_register_access_fini();
+
+	printf("%llu samples, %.1f%% busy, %d distinct regions\n",
+	       (unsigned long long)total_samples,
+	       total_samples ? 100.0 * busy_samples / total_samples : 0.0,
+	       num_regions);
+
+	if (!busy_samples)
+		return 0;
+
+	qsort(regions, MAX_REGIONS, sizeof(regions[0]), cmp_region);
+	if (top > num_regions)
+		top = num_regions;
+
+	printf("top regions by busy time:\n");
+	for (i = 0; i < top; i++) {
+		struct region *r = &regions[i];
+
+		if (!r->samples)
+			break;
+
+		if (r->page & RING_FLAG)
+			printf("%6.1f%%  ring  +0x%05x..0x%05x",
+			       100.0 * r->samples / busy_samples,
+			       ((r->page & ~RING_FLAG) << 12) | r->min_off,
+			       ((r->page & ~RING_FLAG) << 12) | r->max_off);
+		else
+			printf("%6.1f%%  batch 0x%08x..0x%08x",
+			       100.0 * r->samples / busy_samples,
+			       (r->page << 12) | r->min_off,
+			       (r->page << 12) | r->max_off);
+		print_units(r->notdone);
+		printf("\n");
+	}
+
+	return 0;
+}
@@ -166,43 +166,16 @@ print_clock_info(struct pci_device *pci_dev)
 
 int main(int argc, char **argv)
 {
-	struct pci_device *dev, *bridge;
-	int error;
+	const struct intel_device_identity *identity;
+	struct pci_device *dev;
 	uint8_t stepping;
 	const char *step_desc = "??";
 
-	error = pci_system_init();
-	if (error != 0) {
-		fprintf(stderr, "Couldn't initialize PCI system: %s\n",
-			strerror(error));
-		exit(1);
-	}
-
-	/* Grab the graphics card */
-	dev = pci_device_find_by_slot(0, 0, 2, 0);
-	if (dev == NULL)
-		errx(1, "Couldn't find graphics card");
-
-	error = pci_device_probe(dev);
-	if (error != 0) {
-		fprintf(stderr, "Couldn't probe graphics card: %s\n",
-			strerror(error));
-		exit(1);
-	}
-
-	if (dev->vendor_id != 0x8086)
-		errx(1, "Graphics card is non-intel");
-
-	bridge = pci_device_find_by_slot(0, 0, 0, 0);
-	if (dev == NULL)
-		errx(1, "Couldn't bridge");
-
-	error = pci_device_cfg_read_u8(bridge, &stepping, 8);
-	if (error != 0) {
-		fprintf(stderr, "Couldn't read revision ID: %s\n",
-			strerror(error));
-		exit(1);
-	}
+	/* finds the card, reads the bridge config window in one burst and
+	 * leaves the result cached for the other tools */
+	dev = intel_get_pci_device();
+	identity = intel_get_device_identity();
+	stepping = identity->stepping;
 
 	switch (dev->device_id) {
 	case PCI_CHIP_I915_G:
@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2012 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Text dump of an intel_trace register trace; -s/-e window the output
+ * using the trace index rather than decoding from the start. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "intel_trace.h"
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-s start_us] [-e end_us] trace-file\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct intel_trace_reader *reader;
+	uint32_t values[INTEL_TRACE_MAX_STREAMS];
+	uint64_t start_us = 0, end_us = UINT64_MAX;
+	uint64_t time_us;
+	int num_streams, i;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:e:h")) != -1) {
+		switch (c) {
+		case 's':
+			start_us = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			end_us = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	reader = intel_trace_reader_open(argv[optind]);
+	if (reader == NULL) {
+		fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+		return 1;
+	}
+
+	num_streams = intel_trace_reader_num_streams(reader);
+
+	printf("%16s", "time_us");
+	for (i = 0; i < num_streams; i++)
+		printf(" %10s", intel_trace_reader_stream_name(reader, i));
+	printf("\n");
+
+	if (start_us && !intel_trace_reader_seek(reader, start_us)) {
+		intel_trace_reader_close(reader);
+		return 0;
+	}
+
+	while (intel_trace_reader_next(reader, &time_us, values)) {
+		if (time_us > end_us)
+			break;
+		printf("%16llu", (unsigned long long)time_us);
+		for (i = 0; i < num_streams; i++)
+			printf(" 0x%08x", values[i]);
+		printf("\n");
+	}
+
+	intel_trace_reader_close(reader);
+	return 0;
+}